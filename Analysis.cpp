@@ -0,0 +1,436 @@
+// Analysis.cpp : the search output of an engine, as the latest lines found
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Analysis.h"
+#include "San.h"
+
+//WinBoard mate scores are 100000 + moves to mate
+#define THINKING_MATE_SCORE		100000
+
+static const char *SkipSpaces(const char *p)
+{
+	while(*p == ' ' || *p == '\t')
+		p++;
+	return p;
+}
+
+static int WordLength(const char *p)
+{
+	int n = 0;
+	while(p[n] != '\0' && p[n] != ' ' && p[n] != '\t' && p[n] != '\r' && p[n] != '\n')
+		n++;
+	return n;
+}
+
+static bool IsWord(const char *p, int n, const char *word)
+{
+	for(int i = 0; i < n; i++)
+	{
+		if(p[i] != word[i])
+			return false;
+	}
+	return word[n] == '\0';
+}
+
+static bool ParseNumber(const char *p, int n, long long &value)
+{
+	int i = p[0] == '-' ? 1 : 0;
+	if(i == n)
+		return false;
+	value = 0;
+	for(; i < n; i++)
+	{
+		if(p[i] < '0' || p[i] > '9')
+			return false;
+		value = value * 10 + (p[i] - '0');
+	}
+	if(p[0] == '-')
+		value = -value;
+	return true;
+}
+
+//length of the rest of the line without trailing white space
+static int RestLength(const char *p)
+{
+	int n = (int)strlen(p);
+	while(n > 0 && (p[n - 1] == ' ' || p[n - 1] == '\t' || p[n - 1] == '\r' || p[n - 1] == '\n'))
+		n--;
+	return n;
+}
+
+static void ClearInfo(ENGINEINFO &info)
+{
+	info.multiPV = 0;
+	info.depth = -1;
+	info.selDepth = -1;
+	info.scoreType = SCORE_NONE;
+	info.score = 0;
+	info.bound = BOUND_EXACT;
+	info.time = -1;
+	info.nodes = -1;
+	info.nps = -1;
+	info.hashFull = -1;
+	info.pv = NULL;
+	info.pvLength = 0;
+}
+
+bool ParseUCIInfo(const char *line, ENGINEINFO &info)
+{
+	if(strncmp(line, "info", 4) != 0 || (line[4] != ' ' && line[4] != '\t' && line[4] != '\0'))
+		return false;
+	ClearInfo(info);
+	const char *p = SkipSpaces(line + 4);
+	while(*p != '\0')
+	{
+		int n = WordLength(p);
+		if(n == 0)
+			break;
+		const char *value = SkipSpaces(p + n);
+		int length = WordLength(value);
+		long long number = 0;
+		bool numeric = ParseNumber(value, length, number);
+		if(IsWord(p, n, "pv"))
+		{
+			info.pv = value;
+			info.pvLength = RestLength(value);
+			break;
+		}
+		//the rest of the line belongs to these
+		if(IsWord(p, n, "string") || IsWord(p, n, "refutation") || IsWord(p, n, "currline"))
+			break;
+		if(IsWord(p, n, "score"))
+		{
+			//cp or mate with its value, and a bound, in any order
+			for(;;)
+			{
+				n = WordLength(value);
+				if(IsWord(value, n, "lowerbound"))
+					info.bound = BOUND_LOWER;
+				else if(IsWord(value, n, "upperbound"))
+					info.bound = BOUND_UPPER;
+				else if(IsWord(value, n, "cp") || IsWord(value, n, "mate"))
+				{
+					const char *score = SkipSpaces(value + n);
+					length = WordLength(score);
+					if(!ParseNumber(score, length, number))
+						break;
+					info.scoreType = IsWord(value, n, "cp") ? SCORE_CP : SCORE_MATE;
+					info.score = (int)number;
+					n = (int)(score + length - value);
+				}
+				else
+					break;
+				value = SkipSpaces(value + n);
+			}
+			p = value;
+			continue;
+		}
+		if(IsWord(p, n, "depth") && numeric)
+			info.depth = (int)number;
+		else if(IsWord(p, n, "seldepth") && numeric)
+			info.selDepth = (int)number;
+		else if(IsWord(p, n, "multipv") && numeric)
+			info.multiPV = (int)number;
+		else if(IsWord(p, n, "nodes") && numeric)
+			info.nodes = number;
+		else if(IsWord(p, n, "nps") && numeric)
+			info.nps = number;
+		else if(IsWord(p, n, "time") && numeric)
+			info.time = (int)number;
+		else if(IsWord(p, n, "hashfull") && numeric)
+			info.hashFull = (int)number;
+		else if(!IsWord(p, n, "currmove") && !IsWord(p, n, "currmovenumber") && !IsWord(p, n, "tbhits") &&
+			!IsWord(p, n, "sbhits") && !IsWord(p, n, "cpuload"))
+		{
+			//a word of its own
+			p = value;
+			continue;
+		}
+		p = SkipSpaces(value + length);
+	}
+	return true;
+}
+
+bool ParseThinking(const char *line, ENGINEINFO &info)
+{
+	//ply score time nodes, then optionally seldepth nps tbhits and a tab
+	//before the pv
+	long long fields[4];
+	const char *p = SkipSpaces(line);
+	for(int i = 0; i < 4; i++)
+	{
+		int n = WordLength(p);
+		if(n == 0 || !ParseNumber(p, n, fields[i]))
+			return false;
+		p += n;
+		if(*p != ' ' && *p != '\t' && (i < 3 || (*p != '\0' && *p != '\r' && *p != '\n')))
+			return false;
+		p = SkipSpaces(p);
+	}
+	if(fields[0] < 0 || fields[2] < 0 || fields[3] < 0)
+		return false;
+	ClearInfo(info);
+	info.depth = (int)fields[0];
+	info.scoreType = SCORE_CP;
+	info.score = (int)fields[1];
+	if(fields[1] > THINKING_MATE_SCORE || fields[1] < -THINKING_MATE_SCORE)
+	{
+		info.scoreType = SCORE_MATE;
+		info.score = (int)(fields[1] > 0 ? fields[1] - THINKING_MATE_SCORE : fields[1] + THINKING_MATE_SCORE);
+	}
+	info.time = (int)fields[2] * 10;
+	info.nodes = fields[3];
+	const char *tab = strchr(p, '\t');
+	if(tab != NULL)
+	{
+		long long number;
+		int n = WordLength(p);
+		if(p < tab && ParseNumber(p, n, number))
+			info.selDepth = (int)number;
+		p = SkipSpaces(p + n);
+		n = WordLength(p);
+		if(p < tab && ParseNumber(p, n, number))
+			info.nps = number;
+		p = SkipSpaces(tab);
+	}
+	info.pv = p;
+	info.pvLength = RestLength(p);
+	return true;
+}
+
+CAnalysis::CAnalysis()
+{
+	m_maxLines = ANALYSIS_MAX_LINES;
+	m_updates = 0;
+	Clear();
+}
+
+void CAnalysis::SetMaxLines(int lines)
+{
+	m_maxLines = lines < 1 ? 1 : lines > ANALYSIS_MAX_LINES ? ANALYSIS_MAX_LINES : lines;
+	if(m_count > m_maxLines)
+		m_count = m_maxLines;
+	m_updates++;
+}
+
+void CAnalysis::Clear()
+{
+	m_count = 0;
+	m_ranked = false;
+	m_depth = -1;
+	m_nodes = -1;
+	m_nps = -1;
+	m_time = -1;
+	m_hashFull = -1;
+	m_updates++;
+}
+
+bool CAnalysis::Update(const ENGINEINFO &info)
+{
+	bool changed = false;
+	if(info.scoreType != SCORE_NONE || info.pv != NULL)
+	{
+		//a new search starts from a low depth
+		if(m_count > 0 && info.depth >= 0 && info.depth < m_lines[0].depth && info.multiPV <= 1)
+			Clear();
+		if(info.multiPV > 0)
+			m_ranked = true;
+		int slot = m_ranked && info.multiPV > 0 ? info.multiPV - 1 : 0;
+		if(slot < m_maxLines)
+		{
+			if(!m_ranked)
+			{
+				int moved = m_count < m_maxLines ? m_count : m_maxLines - 1;
+				memmove(&m_lines[1], &m_lines[0], moved * sizeof(ANALYSISLINE));
+				m_count = moved + 1;
+			}
+			else if(slot >= m_count)
+			{
+				//ranks not seen yet stay empty until they come
+				for(int i = m_count; i < slot; i++)
+				{
+					m_lines[i].scoreType = SCORE_NONE;
+					m_lines[i].depth = -1;
+					m_lines[i].pv[0] = '\0';
+				}
+				m_count = slot + 1;
+			}
+			ANALYSISLINE &line = m_lines[slot];
+			line.multiPV = info.multiPV;
+			line.depth = info.depth;
+			line.selDepth = info.selDepth;
+			line.scoreType = info.scoreType;
+			line.score = info.score;
+			line.bound = info.bound;
+			line.time = info.time;
+			line.nodes = info.nodes;
+			int n = info.pv != NULL ? info.pvLength : 0;
+			if(n >= ANALYSIS_PV_SIZE)
+			{
+				n = ANALYSIS_PV_SIZE - 1;
+				while(n > 0 && info.pv[n] != ' ')
+					n--;
+			}
+			memcpy(line.pv, info.pv, n);
+			line.pv[n] = '\0';
+			changed = true;
+		}
+	}
+	if(info.depth >= 0 && info.depth != m_depth)
+	{
+		m_depth = info.depth;
+		changed = true;
+	}
+	if(info.nodes >= 0 && info.nodes != m_nodes)
+	{
+		m_nodes = info.nodes;
+		changed = true;
+	}
+	if(info.nps >= 0 && info.nps != m_nps)
+	{
+		m_nps = info.nps;
+		changed = true;
+	}
+	if(info.time >= 0 && info.time != m_time)
+	{
+		m_time = info.time;
+		changed = true;
+	}
+	if(info.hashFull >= 0 && info.hashFull != m_hashFull)
+	{
+		m_hashFull = info.hashFull;
+		changed = true;
+	}
+	if(changed)
+		m_updates++;
+	return changed;
+}
+
+//appends n characters of text to buf as far as they fit
+static void Append(char *buf, int size, int &length, const char *text, int n)
+{
+	if(length + n > size - 1)
+		n = size - 1 - length;
+	if(n > 0)
+	{
+		memcpy(buf + length, text, n);
+		length += n;
+	}
+	buf[length] = '\0';
+}
+
+int CAnalysis::FormatLine(int i, const CPosition *pos, char *buf, int size) const
+{
+	const ANALYSISLINE &line = m_lines[i];
+	int length = 0;
+	char text[64];
+	buf[0] = '\0';
+	if(line.scoreType != SCORE_NONE)
+	{
+		bool flip = pos != NULL && pos->GetSide() == SIDE_BLACK;
+		int score = flip ? -line.score : line.score;
+		int bound = line.bound;
+		if(flip && bound != BOUND_EXACT)
+			bound = bound == BOUND_LOWER ? BOUND_UPPER : BOUND_LOWER;
+		int n;
+		if(line.scoreType == SCORE_MATE)
+			n = sprintf(text, "#%d", score);
+		else
+			n = sprintf(text, "%+.2f", score / 100.0);
+		n += sprintf(text + n, "%s", bound == BOUND_LOWER ? "++" : bound == BOUND_UPPER ? "--" : "");
+		Append(buf, size, length, text, n);
+	}
+	if(line.depth >= 0)
+	{
+		int n = line.selDepth >= 0 ? sprintf(text, " %d/%d", line.depth, line.selDepth) : sprintf(text, " %d", line.depth);
+		Append(buf, size, length, text, n);
+	}
+	const char *p = SkipSpaces(line.pv);
+	if(pos == NULL)
+	{
+		if(*p != '\0')
+			Append(buf, size, length, " ", 1);
+		Append(buf, size, length, p, (int)strlen(p));
+		return length;
+	}
+	//the moves in SAN with their numbers, as far as they are legal
+	CPosition board = *pos;
+	UNDOINFO undo;
+	bool first = true;
+	while(*p != '\0')
+	{
+		int n = WordLength(p);
+		if(n == 0)
+			break;
+		CHESSMOVE move = NULL_MOVE;
+		char word[16];
+		if(n < (int)sizeof(word))
+		{
+			memcpy(word, p, n);
+			word[n] = '\0';
+			move = ParseSAN(board, word);
+		}
+		if(move == NULL_MOVE)
+		{
+			Append(buf, size, length, " ", 1);
+			Append(buf, size, length, p, RestLength(p));
+			break;
+		}
+		int k = 0;
+		if(board.GetSide() == SIDE_WHITE)
+			k = sprintf(text, " %d.", board.GetFullMoveNumber());
+		else if(first)
+			k = sprintf(text, " %d...", board.GetFullMoveNumber());
+		text[k++] = ' ';
+		k += FormatSAN(board, move, text + k);
+		Append(buf, size, length, text, k);
+		board.MakeMove(move, undo);
+		first = false;
+		p = SkipSpaces(p + n);
+	}
+	return length;
+}
+
+//"1234", "12.3 k", "1.52 M"
+static int FormatCount(long long count, char *buf)
+{
+	if(count >= 10000000)
+		return sprintf(buf, "%.1f M", count / 1e6);
+	if(count >= 1000000)
+		return sprintf(buf, "%.2f M", count / 1e6);
+	if(count >= 10000)
+		return sprintf(buf, "%.1f k", count / 1e3);
+	return sprintf(buf, "%lld ", count);
+}
+
+int CAnalysis::FormatStatus(char *buf, int size) const
+{
+	int length = 0;
+	char text[64];
+	buf[0] = '\0';
+	if(m_depth >= 0)
+		Append(buf, size, length, text, sprintf(text, "depth %d", m_depth));
+	if(m_nodes >= 0)
+	{
+		int n = sprintf(text, "%s", length > 0 ? ", " : "");
+		n += FormatCount(m_nodes, text + n);
+		n += sprintf(text + n, "nodes");
+		Append(buf, size, length, text, n);
+	}
+	if(m_nps >= 0)
+	{
+		int n = sprintf(text, "%s", length > 0 ? ", " : "");
+		n += FormatCount(m_nps, text + n);
+		n += sprintf(text + n, "nps");
+		Append(buf, size, length, text, n);
+	}
+	if(m_time >= 0)
+		Append(buf, size, length, text, sprintf(text, "%s%.1f s", length > 0 ? ", " : "", m_time / 1000.0));
+	if(m_hashFull >= 0)
+		Append(buf, size, length, text, sprintf(text, "%shash %.1f%%", length > 0 ? ", " : "", m_hashFull / 10.0));
+	return length;
+}
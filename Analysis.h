@@ -0,0 +1,105 @@
+// Analysis.h : the search output of an engine, as the latest lines found
+//
+// Like Position.h this file has no MFC dependency. UCI "info" lines and
+// WinBoard thinking output are split where they lie, without copying or
+// allocating, into an ENGINEINFO pointing into the line. CAnalysis keeps
+// the lines of the search in fixed storage: by rank for an engine that
+// numbers them (multipv), else the latest ones, newest first.
+/////////////////////////////////////////////////////////////////////////////
+
+#if !defined(ANALYSIS_H)
+#define ANALYSIS_H
+
+#include "Position.h"
+
+enum ANALYSIS_SCORE {SCORE_NONE, SCORE_CP, SCORE_MATE};
+
+enum ANALYSIS_BOUND {BOUND_EXACT, BOUND_LOWER, BOUND_UPPER};
+
+#define ANALYSIS_MAX_LINES		8
+//longer principal variations are cut after a whole move
+#define ANALYSIS_PV_SIZE		384
+
+//One line of search output. Fields the line does not have are -1 (0 for
+//multiPV, NULL for pv); scores are from the side to move, mate scores in
+//moves, negative when it is mated.
+struct ENGINEINFO
+{
+	int multiPV;
+	int depth;
+	int selDepth;
+	int scoreType;
+	int score;
+	int bound;
+	//milliseconds
+	int time;
+	long long nodes;
+	long long nps;
+	int hashFull;
+	//moves as the engine wrote them, not terminated
+	const char *pv;
+	int pvLength;
+};
+
+//Parse a UCI "info" line, or a WinBoard "depth score time nodes pv" line,
+//false when line is something else.
+bool ParseUCIInfo(const char *line, ENGINEINFO &info);
+bool ParseThinking(const char *line, ENGINEINFO &info);
+
+struct ANALYSISLINE
+{
+	int multiPV;
+	int depth;
+	int selDepth;
+	int scoreType;
+	int score;
+	int bound;
+	int time;
+	long long nodes;
+	char pv[ANALYSIS_PV_SIZE];
+};
+
+class CAnalysis
+{
+private:
+	ANALYSISLINE m_lines[ANALYSIS_MAX_LINES];
+	int m_count;
+	int m_maxLines;
+	//the engine numbers its lines
+	bool m_ranked;
+	//latest statistics of the search, from lines with or without a pv
+	int m_depth;
+	long long m_nodes;
+	long long m_nps;
+	int m_time;
+	int m_hashFull;
+	unsigned int m_updates;
+
+public:
+	CAnalysis();
+
+	//lines kept, up to ANALYSIS_MAX_LINES
+	void SetMaxLines(int lines);
+	void Clear();
+	//Takes in a parsed line, returns true when it changed the analysis. A
+	//line of lower depth than those kept starts a new search.
+	bool Update(const ENGINEINFO &info);
+
+	int GetCount() const							{ return m_count; }
+	const ANALYSISLINE &GetLine(int i) const		{ return m_lines[i]; }
+	int GetDepth() const							{ return m_depth; }
+	long long GetNodes() const						{ return m_nodes; }
+	long long GetNPS() const						{ return m_nps; }
+	int GetTime() const								{ return m_time; }
+	//changes so far, for a view to redraw only when this moved on
+	unsigned int GetUpdates() const					{ return m_updates; }
+
+	//Line i as "+0.35 18/25 e4 e5 Nf3", the score from White's side and the
+	//moves in SAN when pos, the position searched, is given. Returns the
+	//length written to buf.
+	int FormatLine(int i, const CPosition *pos, char *buf, int size) const;
+	//"depth 18, 12.3 Mnodes, 1.52 Mnps, 8.1 s"
+	int FormatStatus(char *buf, int size) const;
+};
+
+#endif
@@ -0,0 +1,77 @@
+// Checkpoint.cpp : position snapshots along a game
+//
+
+#include <stddef.h>
+
+#include "Checkpoint.h"
+
+CCheckpointList::CCheckpointList()
+{
+	m_positions = NULL;
+	m_count = m_size = 0;
+}
+
+CCheckpointList::CCheckpointList(const CCheckpointList &list)
+{
+	m_positions = NULL;
+	m_count = m_size = 0;
+	*this = list;
+}
+
+CCheckpointList::~CCheckpointList()
+{
+	delete [] m_positions;
+}
+
+CCheckpointList& CCheckpointList::operator=(const CCheckpointList &list)
+{
+	if(this == &list)
+		return *this;
+	delete [] m_positions;
+	m_positions = list.m_size > 0 ? new CPosition[list.m_size] : NULL;
+	m_size = list.m_size;
+	m_count = list.m_count;
+	for(int i = 0; i < m_count; i++)
+		m_positions[i] = list.m_positions[i];
+	return *this;
+}
+
+//Called with the position every time a move is played at ply. Snapshots of
+//later plies depend on the moves in between, so they are dropped.
+void CCheckpointList::Store(int ply, const CPosition &pos)
+{
+	if(ply < 0)
+		return;
+	int index = ply / CHECKPOINT_INTERVAL;
+	if(ply % CHECKPOINT_INTERVAL != 0 || index > m_count)
+	{
+		if(m_count > index + 1)
+			m_count = index + 1;
+		return;
+	}
+	if(index >= m_size)
+	{
+		int size = m_size > 0 ? m_size * 2 : 16;
+		CPosition *positions = new CPosition[size];
+		for(int i = 0; i < m_count; i++)
+			positions[i] = m_positions[i];
+		delete [] m_positions;
+		m_positions = positions;
+		m_size = size;
+	}
+	m_positions[index] = pos;
+	m_count = index + 1;
+}
+
+//Copies the nearest checkpoint at or before ply into pos and returns its
+//ply, or -1 when there is none.
+int CCheckpointList::Restore(int ply, CPosition &pos) const
+{
+	if(ply < 0 || m_count == 0)
+		return -1;
+	int index = ply / CHECKPOINT_INTERVAL;
+	if(index >= m_count)
+		index = m_count - 1;
+	pos = m_positions[index];
+	return index * CHECKPOINT_INTERVAL;
+}
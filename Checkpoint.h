@@ -0,0 +1,35 @@
+// Checkpoint.h : position snapshots along a game
+//
+// Like Position.h this file has no MFC dependency.
+/////////////////////////////////////////////////////////////////////////////
+
+#if !defined(CHECKPOINT_H)
+#define CHECKPOINT_H
+
+#include "Position.h"
+
+//a snapshot every this many plies, so reaching any ply replays at most
+//CHECKPOINT_INTERVAL - 1 moves
+#define CHECKPOINT_INTERVAL	16
+
+//Ply n is the position before the n-th move of the game (0 = start).
+//Only plies that are a multiple of CHECKPOINT_INTERVAL are kept.
+class CCheckpointList
+{
+private:
+	CPosition *m_positions;
+	int m_count;
+	int m_size;
+
+public:
+	CCheckpointList();
+	CCheckpointList(const CCheckpointList &list);
+	~CCheckpointList();
+	CCheckpointList& operator=(const CCheckpointList &list);
+
+	void Clear()								{ m_count = 0; }
+	void Store(int ply, const CPosition &pos);
+	int Restore(int ply, CPosition &pos) const;
+};
+
+#endif
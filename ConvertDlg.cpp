@@ -57,7 +57,7 @@ BOOL CConvertDlg::OnInitDialog()
 void CConvertDlg::OnButtonBrowse() 
 {
 	// TODO: Add your control notification handler code here
-	CFileDialog dlg(TRUE);
+	CFileDialog dlg(FALSE);
 	if(dlg.DoModal() == IDOK)
 	{
 		if(dlg.GetFileExt() == "FEN" ||
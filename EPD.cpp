@@ -0,0 +1,210 @@
+// EPD.cpp : positions with EPD operations ("bm Nf3; id \"WAC.001\";")
+//
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "EPD.h"
+#include "San.h"
+
+static const char *SkipSpaces(const char *p)
+{
+	while(*p == ' ' || *p == '\t')
+		p++;
+	return p;
+}
+
+static const char *SkipField(const char *p)
+{
+	while(*p != '\0' && *p != ' ' && *p != '\t' && *p != '\r' && *p != '\n')
+		p++;
+	return SkipSpaces(p);
+}
+
+bool ParseEPD(const char *line, EPDRECORD &record)
+{
+	record.operations.clear();
+	if(!record.pos.SetFEN(line))
+		return false;
+	//after placement, side, castling and en passant come the clocks of a
+	//FEN or the operations of an EPD
+	const char *p = SkipSpaces(line);
+	for(int i = 0; i < 4; i++)
+		p = SkipField(p);
+	if(*p >= '0' && *p <= '9')
+		return true;
+	while(*p != '\0' && *p != '\r' && *p != '\n')
+	{
+		EPDOPERATION operation;
+		const char *opcode = p;
+		while(*p != '\0' && *p != ' ' && *p != '\t' && *p != ';' && *p != '\r' && *p != '\n')
+			p++;
+		operation.opcode.assign(opcode, p - opcode);
+		p = SkipSpaces(p);
+		//up to the ';' that is not inside a string
+		const char *operands = p;
+		bool quoted = false;
+		while(*p != '\0' && *p != '\r' && *p != '\n' && (quoted || *p != ';'))
+		{
+			if(*p == '"')
+				quoted = !quoted;
+			p++;
+		}
+		const char *end = p;
+		while(end > operands && (end[-1] == ' ' || end[-1] == '\t'))
+			end--;
+		operation.operands.assign(operands, end - operands);
+		if(!operation.opcode.empty())
+			record.operations.push_back(operation);
+		if(*p == ';')
+			p++;
+		p = SkipSpaces(p);
+	}
+	const char *clock = GetEPDOperands(record, "hmvc");
+	const char *number = GetEPDOperands(record, "fmvn");
+	if(clock != NULL || number != NULL)
+	{
+		//SetFEN reads them from the fifth and sixth fields
+		char fen[100];
+		record.pos.GetFEN(fen, sizeof(fen));
+		std::string text(fen);
+		size_t fields = 0;
+		for(int i = 0; i < 4; i++)
+			fields = text.find(' ', fields) + 1;
+		text.resize(fields);
+		text += clock != NULL ? clock : "0";
+		text += ' ';
+		text += number != NULL ? number : "1";
+		record.pos.SetFEN(text.c_str());
+	}
+	return true;
+}
+
+std::string FormatEPD(const EPDRECORD &record)
+{
+	char fen[100];
+	record.pos.GetFEN(fen, sizeof(fen));
+	//the four position fields only
+	int spaces = 0;
+	char *p = fen;
+	for(; *p != '\0'; p++)
+	{
+		if(*p == ' ' && ++spaces == 4)
+			break;
+	}
+	*p = '\0';
+	std::string line(fen);
+	for(size_t i = 0; i < record.operations.size(); i++)
+	{
+		line += ' ';
+		line += record.operations[i].opcode;
+		if(!record.operations[i].operands.empty())
+		{
+			line += ' ';
+			line += record.operations[i].operands;
+		}
+		line += ';';
+	}
+	return line;
+}
+
+const char *GetEPDOperands(const EPDRECORD &record, const char *opcode)
+{
+	for(size_t i = 0; i < record.operations.size(); i++)
+	{
+		if(record.operations[i].opcode == opcode)
+			return record.operations[i].operands.c_str();
+	}
+	return NULL;
+}
+
+void SetEPDOperation(EPDRECORD &record, const char *opcode, const std::string &operands)
+{
+	for(size_t i = 0; i < record.operations.size(); i++)
+	{
+		if(record.operations[i].opcode == opcode)
+		{
+			record.operations[i].operands = operands;
+			return;
+		}
+	}
+	EPDOPERATION operation;
+	operation.opcode = opcode;
+	operation.operands = operands;
+	record.operations.push_back(operation);
+}
+
+void RemoveEPDOperation(EPDRECORD &record, const char *opcode)
+{
+	for(size_t i = 0; i < record.operations.size(); )
+	{
+		if(record.operations[i].opcode == opcode)
+			record.operations.erase(record.operations.begin() + i);
+		else
+			i++;
+	}
+}
+
+bool ParseEPDMoves(CPosition &pos, const char *operands, std::vector<CHESSMOVE> &moves)
+{
+	moves.clear();
+	const char *p = SkipSpaces(operands);
+	while(*p != '\0')
+	{
+		char san[16];
+		int n = 0;
+		while(p[n] != '\0' && p[n] != ' ' && p[n] != '\t')
+			n++;
+		if(n >= (int)sizeof(san))
+			return false;
+		memcpy(san, p, n);
+		san[n] = '\0';
+		CHESSMOVE move = ParseSAN(pos, san);
+		if(move == NULL_MOVE)
+			return false;
+		moves.push_back(move);
+		p = SkipSpaces(p + n);
+	}
+	return !moves.empty();
+}
+
+void ParseVariation(const CPosition &pos, const char *text, std::vector<CHESSMOVE> &moves)
+{
+	moves.clear();
+	CPosition board = pos;
+	UNDOINFO undo;
+	const char *p = SkipSpaces(text);
+	while(*p != '\0' && *p != '\r' && *p != '\n')
+	{
+		char san[16];
+		int n = 0;
+		while(p[n] != '\0' && p[n] != ' ' && p[n] != '\t' && p[n] != '\r' && p[n] != '\n')
+			n++;
+		if(n >= (int)sizeof(san))
+			return;
+		memcpy(san, p, n);
+		san[n] = '\0';
+		CHESSMOVE move = ParseSAN(board, san);
+		if(move == NULL_MOVE)
+			return;
+		moves.push_back(move);
+		board.MakeMove(move, undo);
+		p = SkipSpaces(p + n);
+	}
+}
+
+std::string FormatVariation(const CPosition &pos, const std::vector<CHESSMOVE> &moves)
+{
+	std::string text;
+	CPosition board = pos;
+	UNDOINFO undo;
+	char san[16];
+	for(size_t i = 0; i < moves.size(); i++)
+	{
+		if(i > 0)
+			text += ' ';
+		text.append(san, FormatSAN(board, moves[i], san));
+		board.MakeMove(moves[i], undo);
+	}
+	return text;
+}
@@ -0,0 +1,47 @@
+// EPD.h : positions with EPD operations ("bm Nf3; id \"WAC.001\";")
+//
+// Like Position.h this file has no MFC dependency. A record is the
+// position of the line and its operations in the order they came, with
+// their operands as written (quotes kept), so a line read and written
+// again keeps the operations it was not asked to change.
+/////////////////////////////////////////////////////////////////////////////
+
+#if !defined(EPD_H)
+#define EPD_H
+
+#include <string>
+#include <vector>
+
+#include "Position.h"
+
+struct EPDOPERATION
+{
+	std::string opcode;
+	std::string operands;
+};
+
+struct EPDRECORD
+{
+	CPosition pos;
+	std::vector<EPDOPERATION> operations;
+};
+
+//Reads an EPD line, or a FEN line (with its clocks and no operations).
+//hmvc and fmvn set the clocks of the position.
+bool ParseEPD(const char *line, EPDRECORD &record);
+//the four position fields and the operations, without a line end
+std::string FormatEPD(const EPDRECORD &record);
+//operands of the first operation with opcode, NULL when there is none
+const char *GetEPDOperands(const EPDRECORD &record, const char *opcode);
+//replaces the operands of opcode, or adds the operation at the end
+void SetEPDOperation(EPDRECORD &record, const char *opcode, const std::string &operands);
+void RemoveEPDOperation(EPDRECORD &record, const char *opcode);
+//Moves of a bm or am operand list, in SAN (or long algebraic) legal in
+//pos. Returns false when one is not.
+bool ParseEPDMoves(CPosition &pos, const char *operands, std::vector<CHESSMOVE> &moves);
+//the moves of a variation played from pos, as far as they are legal
+void ParseVariation(const CPosition &pos, const char *text, std::vector<CHESSMOVE> &moves);
+//moves played from pos in SAN, separated by spaces, as a pv operand
+std::string FormatVariation(const CPosition &pos, const std::vector<CHESSMOVE> &moves);
+
+#endif
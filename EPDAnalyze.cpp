@@ -0,0 +1,351 @@
+// EPDAnalyze.cpp : analyses the positions of an EPD or FEN file with an engine
+//
+// Not part of the NetChess project, build it on its own:
+//   g++ -O2 -pthread -o epdanalyze EPDAnalyze.cpp EnginePool.cpp EnginePlayer.cpp Analysis.cpp EPD.cpp EngineProcess.cpp San.cpp Position.cpp MoveGen.cpp Zobrist.cpp
+//   cl /O2 /EHsc EPDAnalyze.cpp EnginePool.cpp EnginePlayer.cpp Analysis.cpp EPD.cpp EngineProcess.cpp San.cpp Position.cpp MoveGen.cpp Zobrist.cpp
+//
+// Usage:
+//   epdanalyze -engine cmd=command [name=name] [proto=uci|xboard] [dir=directory] [option.name=value]...
+//              [-threads n] [-depth n | -nodes n | -st seconds] [-margin ms] input.epd output.epd
+// Every position of the input (EPD, or FEN one per line; blank lines and
+// lines starting with '#' are skipped) is searched to the depth, node
+// count or time given, by threads engine processes at once (1 by
+// default), and written to the output with the operations it had and
+// acd, acn, acs, ce, dm (when the side to move mates), bm and pv, in the
+// order of the input. Each result is appended to output.epd.ckpt as soon
+// as it is in, so a run that is stopped (or Ctrl-C) goes on where it was
+// when started again with the same files; the checkpoint is deleted once
+// every position is analysed. The exit code is 1 when a position could not
+// be analysed or the run was stopped, 2 on bad arguments.
+/////////////////////////////////////////////////////////////////////////////
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+
+#include "EPD.h"
+#include "EnginePool.h"
+
+//first line of a checkpoint, with the number of positions of the input
+#define CHECKPOINT_HEADER	"#netchess-epd"
+//mate scores as ce operands: 32767 less the plies to mate
+#define EPD_MATE_SCORE		32767
+
+struct BATCH
+{
+	std::vector<std::string> lines;
+	std::vector<ENGINEJOB> jobs;
+	//output lines, empty while the position is not analysed
+	std::vector<std::string> results;
+	FILE *checkpoint;
+	int done;
+	int failed;
+	int total;
+	std::chrono::steady_clock::time_point start;
+};
+
+static CEnginePool *g_pool;
+
+static double Seconds(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static void Interrupt(int)
+{
+	if(g_pool != NULL)
+		g_pool->Stop();
+}
+
+static bool HasKings(const CPosition &pos)
+{
+	return BitCount(pos.GetPieces(WHITE_KING)) == 1 && BitCount(pos.GetPieces(BLACK_KING)) == 1;
+}
+
+//the input line with the analysis of search in place of any it had
+static std::string FormatResult(const std::string &line, const ENGINESEARCH &search)
+{
+	EPDRECORD record;
+	ParseEPD(line.c_str(), record);
+	static const char *const opcodes[] = {"acd", "acn", "acs", "ce", "dm", "bm", "pv"};
+	for(size_t i = 0; i < sizeof(opcodes) / sizeof(opcodes[0]); i++)
+		RemoveEPDOperation(record, opcodes[i]);
+	char text[32];
+	if(search.depth >= 0)
+	{
+		sprintf(text, "%d", search.depth);
+		SetEPDOperation(record, "acd", text);
+	}
+	if(search.nodes >= 0)
+	{
+		sprintf(text, "%lld", search.nodes);
+		SetEPDOperation(record, "acn", text);
+	}
+	sprintf(text, "%d", (search.elapsed + 500) / 1000);
+	SetEPDOperation(record, "acs", text);
+	if(search.scoreType == SCORE_CP)
+	{
+		sprintf(text, "%d", search.score);
+		SetEPDOperation(record, "ce", text);
+	}
+	else if(search.scoreType == SCORE_MATE)
+	{
+		//mate in n moves is 2n-1 plies away, mated in n 2n
+		int plies = search.score > 0 ? 2 * search.score - 1 : -2 * search.score;
+		sprintf(text, "%d", search.score > 0 ? EPD_MATE_SCORE - plies : plies - EPD_MATE_SCORE);
+		SetEPDOperation(record, "ce", text);
+		if(search.score > 0)
+		{
+			sprintf(text, "%d", search.score);
+			SetEPDOperation(record, "dm", text);
+		}
+	}
+	std::vector<CHESSMOVE> best(1, search.move);
+	SetEPDOperation(record, "bm", FormatVariation(record.pos, best));
+	//a pv from before the engine changed its mind is not the best line
+	std::vector<CHESSMOVE> pv;
+	ParseVariation(record.pos, search.pv.c_str(), pv);
+	if(pv.empty() || pv[0] != search.move)
+		pv = best;
+	SetEPDOperation(record, "pv", FormatVariation(record.pos, pv));
+	return FormatEPD(record);
+}
+
+//called by the pool on one thread at a time
+static void SearchDone(int job, const ENGINESEARCH &search, void *param)
+{
+	BATCH *batch = (BATCH *)param;
+	if(search.reply != ENGINEREPLY_MOVE)
+	{
+		batch->failed++;
+		fprintf(stderr, "position %d: no move (%s)\n", job + 1,
+			search.reply == ENGINEREPLY_TIMEOUT ? "time out" : search.reply == ENGINEREPLY_EXITED ? "engine exited" :
+			search.reply == ENGINEREPLY_RESIGN ? "resigned" : "illegal move");
+		return;
+	}
+	batch->results[job] = FormatResult(batch->lines[job], search);
+	fprintf(batch->checkpoint, "%d %s\n", job, batch->results[job].c_str());
+	fflush(batch->checkpoint);
+	batch->done++;
+	if(batch->done % 100 == 0 || batch->done == batch->total)
+	{
+		double seconds = Seconds(batch->start);
+		fprintf(stderr, "%d/%d positions, %.1f/s\n", batch->done, batch->total,
+			seconds > 0 ? batch->done / seconds : 0.0);
+	}
+}
+
+static bool LoadPositions(const char *path, BATCH &batch)
+{
+	FILE *fp = fopen(path, "r");
+	if(fp == NULL)
+		return false;
+	char line[4096];
+	int number = 0;
+	while(fgets(line, sizeof(line), fp) != NULL)
+	{
+		number++;
+		size_t length = strlen(line);
+		while(length > 0 && (line[length - 1] == '\r' || line[length - 1] == '\n'))
+			line[--length] = '\0';
+		if(line[0] == '#' || line[0] == '\0')
+			continue;
+		EPDRECORD record;
+		if(!ParseEPD(line, record) || !HasKings(record.pos))
+		{
+			fprintf(stderr, "%s:%d: not a position, skipped\n", path, number);
+			continue;
+		}
+		ENGINEJOB job;
+		job.start = record.pos;
+		batch.lines.push_back(line);
+		batch.jobs.push_back(job);
+	}
+	fclose(fp);
+	return true;
+}
+
+//Takes the results of the checkpoint of an earlier run, false when it is
+//one of another input.
+static bool LoadCheckpoint(const char *path, BATCH &batch)
+{
+	FILE *fp = fopen(path, "r");
+	if(fp == NULL)
+		return true;
+	char line[4096];
+	bool ok = fgets(line, sizeof(line), fp) != NULL &&
+		strncmp(line, CHECKPOINT_HEADER " ", sizeof(CHECKPOINT_HEADER)) == 0 &&
+		atoi(line + sizeof(CHECKPOINT_HEADER)) == (int)batch.lines.size();
+	while(ok && fgets(line, sizeof(line), fp) != NULL)
+	{
+		//the last line of a run that was killed may be cut short
+		size_t length = strlen(line);
+		if(length == 0 || line[length - 1] != '\n')
+			break;
+		line[--length] = '\0';
+		char *text;
+		long job = strtol(line, &text, 10);
+		EPDRECORD record;
+		if(job < 0 || job >= (long)batch.lines.size() || *text != ' ' || !ParseEPD(text + 1, record) ||
+			record.pos.GetKey() != batch.jobs[job].start.GetKey())
+		{
+			ok = false;
+			break;
+		}
+		if(batch.results[job].empty())
+			batch.done++;
+		batch.results[job] = text + 1;
+	}
+	fclose(fp);
+	return ok;
+}
+
+static void Usage()
+{
+	fprintf(stderr, "usage: epdanalyze -engine cmd=command [name=name] [proto=uci|xboard] [dir=directory] [option.name=value]...\n");
+	fprintf(stderr, "                  [-threads n] [-depth n | -nodes n | -st seconds] [-margin ms] input.epd output.epd\n");
+}
+
+int main(int argc, char *argv[])
+{
+	ENGINECONFIG engine;
+	ENGINELIMITS limits;
+	memset(&limits, 0, sizeof(limits));
+	int threads = 1, margin = 1000;
+	const char *input = NULL, *output = NULL;
+	int arg = 1;
+	while(arg < argc)
+	{
+		const char *option = argv[arg++];
+		if(option[0] != '-')
+		{
+			if(input == NULL)
+				input = option;
+			else if(output == NULL)
+				output = option;
+			else
+			{
+				Usage();
+				return 2;
+			}
+			continue;
+		}
+		if(strcmp(option, "-engine") == 0)
+		{
+			arg = ParseEngineConfig(argc, argv, arg, engine);
+			if(arg == 0)
+			{
+				Usage();
+				return 2;
+			}
+			continue;
+		}
+		if(arg >= argc)
+		{
+			Usage();
+			return 2;
+		}
+		const char *value = argv[arg++];
+		if(strcmp(option, "-threads") == 0)
+			threads = atoi(value);
+		else if(strcmp(option, "-depth") == 0)
+			limits.depth = atoi(value);
+		else if(strcmp(option, "-nodes") == 0)
+			limits.nodes = strtoull(value, NULL, 10);
+		else if(strcmp(option, "-st") == 0)
+			limits.moveTime = (int)(atof(value) * 1000);
+		else if(strcmp(option, "-margin") == 0)
+			margin = atoi(value);
+		else
+		{
+			Usage();
+			return 2;
+		}
+	}
+	if(engine.command.empty() || input == NULL || output == NULL || threads < 1 ||
+		(limits.depth <= 0 && limits.nodes == 0 && limits.moveTime <= 0))
+	{
+		Usage();
+		return 2;
+	}
+
+	BATCH batch;
+	if(!LoadPositions(input, batch))
+	{
+		fprintf(stderr, "cannot read %s\n", input);
+		return 2;
+	}
+	batch.results.resize(batch.lines.size());
+	batch.done = 0;
+	batch.failed = 0;
+	std::string checkpointPath = std::string(output) + ".ckpt";
+	if(!LoadCheckpoint(checkpointPath.c_str(), batch))
+	{
+		fprintf(stderr, "%s is not of %s, delete it to start again\n", checkpointPath.c_str(), input);
+		return 2;
+	}
+	std::vector<int> order;
+	for(size_t i = 0; i < batch.results.size(); i++)
+	{
+		if(batch.results[i].empty())
+			order.push_back((int)i);
+	}
+	if(batch.done > 0)
+		fprintf(stderr, "%d of %d positions analysed before, going on\n", batch.done, (int)batch.lines.size());
+	//written again rather than appended to, without a line that was cut short
+	batch.checkpoint = fopen(checkpointPath.c_str(), "w");
+	if(batch.checkpoint == NULL)
+	{
+		fprintf(stderr, "cannot write %s\n", checkpointPath.c_str());
+		return 2;
+	}
+	fprintf(batch.checkpoint, "%s %d\n", CHECKPOINT_HEADER, (int)batch.lines.size());
+	for(size_t i = 0; i < batch.results.size(); i++)
+	{
+		if(!batch.results[i].empty())
+			fprintf(batch.checkpoint, "%d %s\n", (int)i, batch.results[i].c_str());
+	}
+	fflush(batch.checkpoint);
+	batch.total = (int)batch.lines.size();
+	batch.start = std::chrono::steady_clock::now();
+
+	CEnginePool pool;
+	pool.SetEngine(engine);
+	//a search to a depth or node count takes as long as it takes
+	pool.SetLimits(limits, limits.moveTime > 0 ? limits.moveTime + margin : -1);
+	pool.SetDoneProc(SearchDone, &batch);
+	g_pool = &pool;
+	signal(SIGINT, Interrupt);
+	bool started = pool.Run(batch.jobs, threads, &order);
+	g_pool = NULL;
+	fclose(batch.checkpoint);
+	if(!started)
+	{
+		fprintf(stderr, "cannot start %s\n", engine.command.c_str());
+		return 1;
+	}
+	fprintf(stderr, "%.1f s\n", Seconds(batch.start));
+	if(batch.done < batch.total)
+	{
+		fprintf(stderr, "%d of %d positions not analysed, run again to go on\n", batch.total - batch.done, batch.total);
+		return 1;
+	}
+
+	FILE *fp = fopen(output, "w");
+	if(fp == NULL)
+	{
+		fprintf(stderr, "cannot write %s\n", output);
+		return 1;
+	}
+	for(size_t i = 0; i < batch.results.size(); i++)
+		fprintf(fp, "%s\n", batch.results[i].c_str());
+	if(fclose(fp) != 0)
+	{
+		fprintf(stderr, "cannot write %s\n", output);
+		return 1;
+	}
+	remove(checkpointPath.c_str());
+	return 0;
+}
@@ -0,0 +1,399 @@
+// EPDTest.cpp : runs engines through an EPD test suite (WAC, STS, ...)
+//
+// Not part of the NetChess project, build it on its own:
+//   g++ -O2 -pthread -o epdtest EPDTest.cpp EnginePool.cpp EnginePlayer.cpp Analysis.cpp EPD.cpp EngineProcess.cpp San.cpp Position.cpp MoveGen.cpp Zobrist.cpp
+//   cl /O2 /EHsc EPDTest.cpp EnginePool.cpp EnginePlayer.cpp Analysis.cpp EPD.cpp EngineProcess.cpp San.cpp Position.cpp MoveGen.cpp Zobrist.cpp
+//
+// Usage:
+//   epdtest -engine cmd=command [name=name] [proto=uci|xboard] [dir=directory] [option.name=value]...
+//           [-engine ...]... [-threads n] [-st seconds] [-depth n] [-nodes n] [-margin ms]
+//           [-settle n] suite.epd...
+// Every position of the suites with a bm (best moves) or am (moves to
+// avoid) operation is searched by every engine, for 5 seconds unless
+// -st, -depth or -nodes limit it otherwise. The engines are tested at the
+// same time, each with threads processes of its own (1 by default). A
+// position is solved when the engine moves a bm move, or a move that is
+// not an am move; a search is stopped once its main line has started with
+// a right move at settle depths in a row (3 by default, 0 to always search
+// to the limit). The solve time is when the engine last changed to the
+// move it played. Each result is printed as it comes, then the solve rate
+// and the distribution of solve times of every engine. The exit code is 1
+// when an engine could not be started, 2 on bad arguments.
+/////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <thread>
+
+#include "EPD.h"
+#include "EnginePool.h"
+#include "San.h"
+
+//upper bounds of the solve time columns, in milliseconds
+static const int g_timeBounds[] = {100, 250, 500, 1000, 2000, 5000, 10000, 30000, 60000};
+#define TIME_BOUNDS		(int)(sizeof(g_timeBounds) / sizeof(g_timeBounds[0]))
+
+struct TESTPOSITION
+{
+	std::string id;
+	CPosition pos;
+	std::vector<CHESSMOVE> best;
+	std::vector<CHESSMOVE> avoid;
+	std::string text;
+};
+
+//how the search of a position is going, written on the worker thread
+//searching it only
+struct TESTSEARCH
+{
+	CHESSMOVE move;
+	//search time when the main line started with move, -1 when unknown
+	int found;
+	int lastDepth;
+	//depths in a row move was right at
+	int settled;
+};
+
+struct TESTRESULT
+{
+	bool solved;
+	int time;
+};
+
+struct ENGINETEST
+{
+	ENGINECONFIG config;
+	CEnginePool pool;
+	const std::vector<TESTPOSITION> *positions;
+	std::vector<TESTSEARCH> searches;
+	std::vector<TESTRESULT> results;
+	int settle;
+	bool started;
+};
+
+//results of the engines are printed one at a time
+static std::mutex g_outputLock;
+static int g_done;
+static int g_total;
+
+static double Seconds(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static bool IsRight(const TESTPOSITION &position, CHESSMOVE move)
+{
+	if(move == NULL_MOVE)
+		return false;
+	if(!position.best.empty())
+		return std::find(position.best.begin(), position.best.end(), move) != position.best.end();
+	return std::find(position.avoid.begin(), position.avoid.end(), move) == position.avoid.end();
+}
+
+//keeps up with the main line, stops the search once it has settled
+static void SearchInfo(int job, const ENGINEINFO &info, CEnginePlayer &player, void *param)
+{
+	ENGINETEST *test = (ENGINETEST *)param;
+	if(info.pv == NULL || info.multiPV > 1)
+		return;
+	const TESTPOSITION &position = (*test->positions)[job];
+	TESTSEARCH &search = test->searches[job];
+	char word[16];
+	int n = 0;
+	while(n < info.pvLength && n < (int)sizeof(word) - 1 && info.pv[n] != ' ' && info.pv[n] != '\t')
+	{
+		word[n] = info.pv[n];
+		n++;
+	}
+	word[n] = '\0';
+	CPosition pos = position.pos;
+	CHESSMOVE move = ParseSAN(pos, word);
+	if(move == NULL_MOVE)
+		return;
+	if(move != search.move)
+	{
+		search.move = move;
+		search.found = info.time;
+		search.lastDepth = info.depth;
+		search.settled = IsRight(position, move) ? 1 : 0;
+	}
+	else if(info.depth > search.lastDepth)
+	{
+		search.lastDepth = info.depth;
+		if(search.settled > 0)
+			search.settled++;
+	}
+	if(test->settle > 0 && search.settled >= test->settle)
+		player.StopSearch();
+}
+
+static void SearchDone(int job, const ENGINESEARCH &search, void *param)
+{
+	ENGINETEST *test = (ENGINETEST *)param;
+	const TESTPOSITION &position = (*test->positions)[job];
+	const TESTSEARCH &info = test->searches[job];
+	TESTRESULT &result = test->results[job];
+	result.solved = search.reply == ENGINEREPLY_MOVE && IsRight(position, search.move);
+	result.time = info.move == search.move && info.found >= 0 ? info.found : search.elapsed;
+	if(result.time > search.elapsed)
+		result.time = search.elapsed;
+
+	char move[16];
+	if(search.reply == ENGINEREPLY_MOVE)
+	{
+		CPosition pos = position.pos;
+		FormatSAN(pos, search.move, move);
+	}
+	else
+		strcpy(move, search.reply == ENGINEREPLY_TIMEOUT ? "(time out)" : search.reply == ENGINEREPLY_EXITED ?
+			"(exited)" : search.reply == ENGINEREPLY_RESIGN ? "(resigned)" : "(illegal)");
+	std::lock_guard<std::mutex> lock(g_outputLock);
+	g_done++;
+	if(result.solved)
+		printf("%d/%d %s %s: %s solved in %.2f s\n", g_done, g_total, position.id.c_str(),
+			test->config.name.c_str(), move, result.time / 1000.0);
+	else
+		printf("%d/%d %s %s: %s, not %s\n", g_done, g_total, position.id.c_str(),
+			test->config.name.c_str(), move, position.text.c_str());
+	fflush(stdout);
+}
+
+static void RunTest(ENGINETEST *test, const std::vector<ENGINEJOB> *jobs, int threads)
+{
+	test->started = test->pool.Run(*jobs, threads);
+}
+
+//Reads the positions with bm or am of an EPD file, false when it cannot be
+//read.
+static bool LoadSuite(const char *path, std::vector<TESTPOSITION> &positions)
+{
+	FILE *fp = fopen(path, "r");
+	if(fp == NULL)
+		return false;
+	char line[4096];
+	int number = 0;
+	while(fgets(line, sizeof(line), fp) != NULL)
+	{
+		number++;
+		if(line[0] == '#' || line[0] == '\r' || line[0] == '\n' || line[0] == '\0')
+			continue;
+		EPDRECORD record;
+		if(!ParseEPD(line, record))
+		{
+			fprintf(stderr, "%s:%d: not a position, skipped\n", path, number);
+			continue;
+		}
+		const char *best = GetEPDOperands(record, "bm");
+		const char *avoid = GetEPDOperands(record, "am");
+		if(best == NULL && avoid == NULL)
+		{
+			fprintf(stderr, "%s:%d: no bm or am, skipped\n", path, number);
+			continue;
+		}
+		TESTPOSITION position;
+		position.pos = record.pos;
+		if((best != NULL && !ParseEPDMoves(position.pos, best, position.best)) ||
+			(avoid != NULL && !ParseEPDMoves(position.pos, avoid, position.avoid)))
+		{
+			fprintf(stderr, "%s:%d: illegal bm or am, skipped\n", path, number);
+			continue;
+		}
+		//as the moves were given, for the failures
+		if(best != NULL)
+			position.text = std::string("bm ") + best;
+		if(avoid != NULL)
+			position.text += std::string(position.text.empty() ? "" : ", ") + "am " + avoid;
+		const char *id = GetEPDOperands(record, "id");
+		if(id != NULL)
+		{
+			position.id = id;
+			if(position.id.size() >= 2 && position.id[0] == '"' && position.id[position.id.size() - 1] == '"')
+				position.id = position.id.substr(1, position.id.size() - 2);
+		}
+		else
+		{
+			char text[300];
+			sprintf(text, "%.256s:%d", path, number);
+			position.id = text;
+		}
+		positions.push_back(position);
+	}
+	fclose(fp);
+	return true;
+}
+
+static void Usage()
+{
+	fprintf(stderr, "usage: epdtest -engine cmd=command [name=name] [proto=uci|xboard] [dir=directory] [option.name=value]...\n");
+	fprintf(stderr, "               [-engine ...]... [-threads n] [-st seconds] [-depth n] [-nodes n] [-margin ms]\n");
+	fprintf(stderr, "               [-settle n] suite.epd...\n");
+}
+
+int main(int argc, char *argv[])
+{
+	std::vector<ENGINECONFIG> engines;
+	std::vector<const char *> suites;
+	ENGINELIMITS limits;
+	memset(&limits, 0, sizeof(limits));
+	int threads = 1, margin = 1000, settle = 3;
+	int arg = 1;
+	while(arg < argc)
+	{
+		const char *option = argv[arg++];
+		if(option[0] != '-')
+		{
+			suites.push_back(option);
+			continue;
+		}
+		if(strcmp(option, "-engine") == 0)
+		{
+			ENGINECONFIG engine;
+			arg = ParseEngineConfig(argc, argv, arg, engine);
+			if(arg == 0)
+			{
+				Usage();
+				return 2;
+			}
+			engines.push_back(engine);
+			continue;
+		}
+		if(arg >= argc)
+		{
+			Usage();
+			return 2;
+		}
+		const char *value = argv[arg++];
+		if(strcmp(option, "-threads") == 0)
+			threads = atoi(value);
+		else if(strcmp(option, "-st") == 0)
+			limits.moveTime = (int)(atof(value) * 1000);
+		else if(strcmp(option, "-depth") == 0)
+			limits.depth = atoi(value);
+		else if(strcmp(option, "-nodes") == 0)
+			limits.nodes = strtoull(value, NULL, 10);
+		else if(strcmp(option, "-margin") == 0)
+			margin = atoi(value);
+		else if(strcmp(option, "-settle") == 0)
+			settle = atoi(value);
+		else
+		{
+			Usage();
+			return 2;
+		}
+	}
+	if(engines.empty() || suites.empty() || threads < 1 || settle < 0)
+	{
+		Usage();
+		return 2;
+	}
+	if(limits.moveTime <= 0 && limits.depth <= 0 && limits.nodes == 0)
+		limits.moveTime = 5000;
+
+	std::vector<TESTPOSITION> positions;
+	for(size_t i = 0; i < suites.size(); i++)
+	{
+		if(!LoadSuite(suites[i], positions))
+		{
+			fprintf(stderr, "cannot read %s\n", suites[i]);
+			return 2;
+		}
+	}
+	if(positions.empty())
+	{
+		fprintf(stderr, "no positions with bm or am\n");
+		return 2;
+	}
+	std::vector<ENGINEJOB> jobs(positions.size());
+	for(size_t i = 0; i < positions.size(); i++)
+		jobs[i].start = positions[i].pos;
+
+	std::vector<ENGINETEST *> tests;
+	for(size_t i = 0; i < engines.size(); i++)
+	{
+		ENGINETEST *test = new ENGINETEST;
+		test->config = engines[i];
+		test->positions = &positions;
+		TESTSEARCH search = {NULL_MOVE, -1, -1, 0};
+		test->searches.assign(positions.size(), search);
+		TESTRESULT result = {false, 0};
+		test->results.assign(positions.size(), result);
+		test->settle = settle;
+		test->started = false;
+		test->pool.SetEngine(engines[i]);
+		test->pool.SetLimits(limits, limits.moveTime > 0 ? limits.moveTime + margin : -1);
+		test->pool.SetInfoProc(SearchInfo, test);
+		test->pool.SetDoneProc(SearchDone, test);
+		tests.push_back(test);
+	}
+	g_done = 0;
+	g_total = (int)(positions.size() * engines.size());
+	printf("%d positions, %d engines with %d threads each (%u cores)\n", (int)positions.size(),
+		(int)engines.size(), threads, std::thread::hardware_concurrency());
+	fflush(stdout);
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	std::vector<std::thread> runs;
+	for(size_t i = 0; i < tests.size(); i++)
+		runs.push_back(std::thread(RunTest, tests[i], &jobs, threads));
+	for(size_t i = 0; i < runs.size(); i++)
+		runs[i].join();
+	printf("\n%d searches in %.1f s\n", g_done, Seconds(start));
+
+	bool failed = false;
+	printf("%-24s %6s %6s %7s %8s %8s\n", "engine", "solved", "total", "rate", "mean", "median");
+	for(size_t i = 0; i < tests.size(); i++)
+	{
+		ENGINETEST *test = tests[i];
+		if(!test->started)
+		{
+			printf("%-24s could not be started\n", test->config.name.c_str());
+			failed = true;
+			continue;
+		}
+		std::vector<int> times;
+		for(size_t j = 0; j < test->results.size(); j++)
+		{
+			if(test->results[j].solved)
+				times.push_back(test->results[j].time);
+		}
+		std::sort(times.begin(), times.end());
+		double mean = 0;
+		for(size_t j = 0; j < times.size(); j++)
+			mean += times[j];
+		mean = times.empty() ? 0 : mean / times.size() / 1000;
+		double median = times.empty() ? 0 : times[times.size() / 2] / 1000.0;
+		printf("%-24s %6d %6d %6.1f%% %7.2fs %7.2fs\n", test->config.name.c_str(), (int)times.size(),
+			(int)positions.size(), 100.0 * times.size() / positions.size(), mean, median);
+	}
+
+	//solved within each time, counted up
+	printf("\n%-24s", "solved within");
+	for(int i = 0; i < TIME_BOUNDS; i++)
+		printf(" %6gs", g_timeBounds[i] / 1000.0);
+	printf("\n");
+	for(size_t i = 0; i < tests.size(); i++)
+	{
+		ENGINETEST *test = tests[i];
+		if(!test->started)
+			continue;
+		printf("%-24s", test->config.name.c_str());
+		for(int j = 0; j < TIME_BOUNDS; j++)
+		{
+			int count = 0;
+			for(size_t k = 0; k < test->results.size(); k++)
+			{
+				if(test->results[k].solved && test->results[k].time < g_timeBounds[j])
+					count++;
+			}
+			printf(" %7d", count);
+		}
+		printf("\n");
+	}
+	for(size_t i = 0; i < tests.size(); i++)
+		delete tests[i];
+	return failed ? 1 : 0;
+}
@@ -3,41 +3,31 @@
 #include "stdafx.h"
 #include "Engine.h"
 #include "NetChessView.h"
-#define MAXBUF 1000
+//milliseconds the reader waits for a line before looking at m_engineFlag
+#define READ_TIMEOUT 250
 UINT ReadFromEngine(LPVOID buf)
 {
-	;
 	CEngine *ce = (CEngine*)buf;
-	char chBuf[MAXBUF];	
-	DWORD dwRead;
-	ce->m_engineFlag = TRUE;
-	CString oneLineData="";	
+	//keeps its storage from line to line, swapping it with the queue's
+	ENGINELINE line;
+	int ret = 0;
 	while(ce->m_engineFlag == TRUE)
-	{		
-		memset(chBuf,'\0',MAXBUF);
-				ReadFile( ce->m_hChildStdoutRdDup, chBuf, MAXBUF, &dwRead, 
-         NULL);
-		for(DWORD i=0;i<dwRead;i++)
+	{
+		//a line is passed on as soon as it is read
+		ret = ce->m_process.ReadLine(line.text, READ_TIMEOUT);
+		//the engine has exited
+		if(ret < 0)
+			break;
+		if(ret > 0)
 		{
-			if(chBuf[i] == '\r' || chBuf[i] == '\n')
-			{
-				ce->WriteToBoard(oneLineData);
-				oneLineData = "";
-			}
-			else
-			{
-				oneLineData += chBuf[i];
-			}
+			line.time = ce->m_process.GetReadTime();
+			ce->WriteToBoard(line);
 		}
-		
-		Sleep(100);
 	}
-	CloseHandle(ce->m_hChildStdinRd);
-	CloseHandle(ce->m_hChildStdinWrDup);
-	CloseHandle(ce->m_hChildStdoutWr);
-	CloseHandle(ce->m_hChildStdoutRdDup);	        
-
-	AfxMessageBox("Reading from Engine is stopped");
+	ce->m_engineFlag = FALSE;
+	//the view tells the user when the engine went away by itself
+	if(ret < 0 && !ce->m_closing)
+		((CNetChessView*)ce->m_pActiveView)->PostEngineMessage(ENGINE_EXITED,ce->m_engineFile);
 	return 0;
 }
 
@@ -52,72 +42,29 @@ CEngine::CEngine()
 	m_arrOptions.RemoveAll();
 	m_engineLoadedFlag = FALSE;
 	m_engineDefaultFlag = FALSE;
+	m_forceFlag = FALSE;
+	m_drainPosted = false;
+	m_closing = false;
+	m_readThread = NULL;
+	m_hWnd = NULL;
+	m_analysisShown = m_analysis.GetUpdates();
+	ResetLatency();
 }
 
 CEngine::~CEngine()
 {
+	JoinReader();
 }
 
 int CEngine::Initialize(CString enginename,CView* ncv)
 {	
-
-   SECURITY_ATTRIBUTES saAttr; 
-   BOOL fSuccess;  
    m_engineFile = enginename;
    m_pActiveView = ncv;
-// Set the bInheritHandle flag so pipe handles are inherited. 
- 
-   saAttr.nLength = sizeof(SECURITY_ATTRIBUTES); 
-   saAttr.bInheritHandle = TRUE; 
-   saAttr.lpSecurityDescriptor = NULL;  
- 
-// Create a pipe for the child process's STDOUT. 
- 
-   if (!CreatePipe(&m_hChildStdoutRd, &m_hChildStdoutWr, &saAttr, 0)) 
-   {
-      AfxMessageBox("Could not initialize engine");
-	  return -1;
-   }
- 
-// Create noninheritable read handle and close the inheritable read 
-// handle. 
- 
-    fSuccess = DuplicateHandle(GetCurrentProcess(), m_hChildStdoutRd,
-        GetCurrentProcess(), &m_hChildStdoutRdDup , 0,
-        FALSE, DUPLICATE_SAME_ACCESS);
-    if( !fSuccess )
-	{
-         AfxMessageBox("Could not initialize engine");
-		 return -1;
-	}
-    CloseHandle(m_hChildStdoutRd);
- 
-// Create a pipe for the child process's STDIN. 
- 
-   if (! CreatePipe(&m_hChildStdinRd, &m_hChildStdinWr, &saAttr, 0)) 
-   {
-         AfxMessageBox("Could not initialize engine");
-		 return -1;
-	}
- 
-// Duplicate the write handle to the pipe so it is not inherited. 
- 
-   fSuccess = DuplicateHandle(GetCurrentProcess(), m_hChildStdinWr, 
-      GetCurrentProcess(), &m_hChildStdinWrDup, 0, 
-      FALSE,                  // not inherited 
-      DUPLICATE_SAME_ACCESS); 
-    if (! fSuccess) 
-    {
-          AfxMessageBox("Could not initialize engine");
-		 return -1;
-	}
- 
-   CloseHandle(m_hChildStdinWr); 
- 
-// Now create the child process. 
-   
-   fSuccess = CreateEngineProcess();
-   if (! fSuccess) 
+   m_hWnd = ncv->GetSafeHwnd();
+   //a read thread left from the engine before must not read the new one
+   JoinReader();
+   m_closing = false;
+   if(!m_process.Start(m_engineFile))
    {
       AfxMessageBox("Could not initialize engine");
 	  return -1;
@@ -127,59 +74,12 @@ int CEngine::Initialize(CString enginename,CView* ncv)
    return 1;
 }
 
-BOOL CEngine::CreateEngineProcess(VOID)
-{
-   PROCESS_INFORMATION piProcInfo; 
-   STARTUPINFO siStartInfo;
-   BOOL bFuncRetn = FALSE; 
- 
-// Set up members of the PROCESS_INFORMATION structure. 
- 
-   ZeroMemory( &piProcInfo, sizeof(PROCESS_INFORMATION) );
- 
-// Set up members of the STARTUPINFO structure. 
- 
-   ZeroMemory( &siStartInfo, sizeof(STARTUPINFO) );
-   siStartInfo.cb = sizeof(STARTUPINFO); 
-   siStartInfo.hStdError = m_hChildStdoutWr;
-   siStartInfo.hStdOutput = m_hChildStdoutWr;
-   siStartInfo.hStdInput = m_hChildStdinRd;
-   siStartInfo.dwFlags |= STARTF_USESTDHANDLES | STARTF_USESHOWWINDOW;
-   siStartInfo.wShowWindow = SW_HIDE;
-// Create the child process. 
-    
-   bFuncRetn = CreateProcess(NULL, 
-      m_engineFile.GetBuffer(0),       // command line 
-      NULL,          // process security attributes 
-      NULL,          // primary thread security attributes 
-      TRUE,          // handles are inherited 
-      0,             // creation flags 
-      NULL,          // use parent's environment 
-      NULL,          // use parent's current directory 
-      &siStartInfo,  // STARTUPINFO pointer 
-      &piProcInfo);  // receives PROCESS_INFORMATION 
-   
-   if (bFuncRetn == 0) 
-   {
-      return -1;
-   }
-   else 
-   {   
-      CloseHandle(piProcInfo.hProcess);
-      CloseHandle(piProcInfo.hThread);
-      return bFuncRetn;
-   }
-   return -1;
-}
-
 VOID CEngine::WriteToEngine(CString data)
 {
 	if(m_engineFlag == TRUE)
 	{
 		data += "\n";
-		DWORD dwWritten;		
-		WriteFile(m_hChildStdinWrDup, data, data.GetLength(), 
-			 &dwWritten, NULL);
+		m_process.Write(data, data.GetLength());
 		data.Replace("\n","\r\n");
 		m_engineLog += data;
 	}
@@ -194,8 +94,13 @@ void CEngine::StartEngine()
 {
 	if(m_engineFlag == FALSE)
 	{
+		//one stopped before may still be waiting for a line
+		JoinReader();
 		m_engineFlag = TRUE;
-		AfxBeginThread((AFX_THREADPROC)ReadFromEngine,(LPVOID)this);
+		m_readThread = AfxBeginThread((AFX_THREADPROC)ReadFromEngine,(LPVOID)this,
+			THREAD_PRIORITY_NORMAL,0,CREATE_SUSPENDED);
+		m_readThread->m_bAutoDelete = FALSE;
+		m_readThread->ResumeThread();
 	//fxMessageBox("Engine started");		
 	}
 }
@@ -204,12 +109,29 @@ int CEngine::GetEngineFlag()
 	return m_engineFlag;
 }
 
+//Stops the read thread and waits for it, which takes at most READ_TIMEOUT.
+//Afterwards only the calling thread touches m_process.
+void CEngine::JoinReader()
+{
+	if(m_readThread == NULL)
+		return;
+	m_engineFlag = FALSE;
+	WaitForSingleObject(m_readThread->m_hThread,INFINITE);
+	delete m_readThread;
+	m_readThread = NULL;
+}
+
 void CEngine::CloseEngine()
 {
-	//find how to close the process
 	m_arrOptions.RemoveAll();
 	m_arrFeatures.RemoveAll();
-	WriteToEngine("quit");
+	//the read thread is gone before the engine is told to quit, then
+	//terminated, then killed
+	m_closing = true;
+	JoinReader();
+	m_process.Stop();
+	m_queue.Clear();
+	m_analysis.Clear();
 	
 	m_engineLoadedFlag = FALSE;
 	m_engineDefaultFlag = FALSE;
@@ -218,20 +140,74 @@ void CEngine::CloseEngine()
 	m_analyzeFlag = FALSE;
 	m_engineName = "";
 	m_engineAuthor = "";
-	m_tempString = "";
 	m_engineLog = "";
-	
-/*	CloseHandle(m_hChildStdinRd);
-	CloseHandle(m_hChildStdinWrDup);
-	CloseHandle(m_hChildStdoutWr);
-	CloseHandle(m_hChildStdoutRdDup)*/
+	ResetLatency();
 }
 
-VOID CEngine::WriteToBoard(CString str)
+//Read thread: queues line for the view, swapping the storage of a line
+//handled before into it, and wakes the view up unless it is already.
+void CEngine::WriteToBoard(ENGINELINE &line)
 {
-	m_engineLog += str + (CString)"\r\n";	
-	((CNetChessView*)((CFrameWnd*)AfxGetApp()->m_pMainWnd)->GetActiveView())->HandleEngineData(m_engineType,str);
+	//wait for the UI thread to catch up rather than lose the line
+	while(!m_queue.Push(line))
+	{
+		if(m_engineFlag == FALSE)
+			return;
+		Sleep(1);
+	}
+	if(!m_drainPosted.exchange(true))
+		::PostMessage(m_hWnd,ID_MY_MESSAGE_ENGINE_DATA,(WPARAM)this,0);
+}
+
+//UI thread: logs and handles at most max queued lines, and asks to be
+//called again when more are left.
+void CEngine::HandleQueuedLines(int max)
+{
+	m_drainPosted = false;
+	for(int i = 0; i < max && m_queue.Pop(m_drainLine); i++)
+	{
+		const char *text = m_drainLine.text.c_str();
+		m_engineLog += text;
+		m_engineLog += "\r\n";
+		RecordLatency(m_drainLine.time);
+		//search output goes to the analysis, the view shows it on a timer
+		if(ParseUCIInfo(text,m_info) || ParseThinking(text,m_info))
+		{
+			m_analysis.Update(m_info);
+			continue;
+		}
+		((CNetChessView*)m_pActiveView)->HandleEngineData(m_engineType,text);
+	}
+	if(!m_queue.IsEmpty() && !m_drainPosted.exchange(true))
+		::PostMessage(m_hWnd,ID_MY_MESSAGE_ENGINE_DATA,(WPARAM)this,0);
 }
+
+void CEngine::ResetLatency()
+{
+	m_latencyCount = 0;
+	m_latencyTotal = 0;
+	m_latencyMax = 0;
+}
+
+void CEngine::RecordLatency(std::chrono::steady_clock::time_point time)
+{
+	long long us = std::chrono::duration_cast<std::chrono::microseconds>(
+		std::chrono::steady_clock::now() - time).count();
+	m_latencyCount++;
+	m_latencyTotal += us;
+	if(us > m_latencyMax)
+		m_latencyMax = us;
+}
+
+CString CEngine::GetLatencyString()
+{
+	CString str;
+	if(m_latencyCount > 0)
+		str.Format("%d lines, latency %.2f ms average, %.2f ms worst", m_latencyCount,
+			m_latencyTotal / 1000.0 / m_latencyCount, m_latencyMax / 1000.0);
+	return str;
+}
+
 int CEngine::parseFeaturesValue(CString feature)
 {
 	for(int i= 0;i< m_arrFeatures.GetSize(); i++)
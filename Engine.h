@@ -5,7 +5,22 @@
 #define ENGINE_INCLUDE
 #include "resource.h"
 #include "EngineConfigDlg.h"
+#include "EngineProcess.h"
+#include "MessageQueue.h"
+#include "Analysis.h"
+//lines between the read thread and the UI thread
+#define ENGINE_QUEUE_SIZE	1024
+//lines the UI thread handles before letting other messages through
+#define ENGINE_DRAIN_BATCH	64
 //enum {MAXBUF=1000};
+
+//a line from the engine, and when it was read
+struct ENGINELINE
+{
+	std::string text;
+	std::chrono::steady_clock::time_point time;
+};
+
 class CEngine
 {
 public:
@@ -14,8 +29,7 @@ public:
 	int m_engineFlag;	
 	int m_engineLoadedFlag;
 	int m_engineDefaultFlag;
-	HANDLE m_hChildStdinRd, m_hChildStdinWr, m_hChildStdinWrDup, 
-		   m_hChildStdoutRd, m_hChildStdoutWr,m_hChildStdoutRdDup;	        
+	CEngineProcess m_process;
 	CString m_engineFile;
 	CView* m_pActiveView;
 	CString m_engineLog;
@@ -27,7 +41,27 @@ public:
 	CString m_engineAuthor;
 	CStringArray m_arrOptions;
 	CStringArray m_arrFeatures;
-	CString m_tempString;
+	//a WinBoard engine was sent "force" to be told book moves
+	int m_forceFlag;
+	//the read thread pushes, the UI thread pops
+	CMessageQueue<ENGINELINE,ENGINE_QUEUE_SIZE> m_queue;
+	//an ID_MY_MESSAGE_ENGINE_DATA is on its way to the view
+	std::atomic<bool> m_drainPosted;
+	//CloseEngine is ending the engine, so its output closing is expected
+	std::atomic<bool> m_closing;
+	//the read thread, the only thread reading m_process while it runs
+	CWinThread *m_readThread;
+	HWND m_hWnd;
+	ENGINELINE m_drainLine;
+	//latency probe: microseconds from reading a line from the engine to
+	//HandleEngineData
+	int m_latencyCount;
+	long long m_latencyTotal;
+	long long m_latencyMax;
+	//search output of the engine, and the update of it the view shows
+	CAnalysis m_analysis;
+	ENGINEINFO m_info;
+	unsigned int m_analysisShown;
 	
 protected:
 	
@@ -36,18 +70,22 @@ protected:
 // Attributes
 public:
 	int Initialize(CString,CView*);
-	BOOL CreateEngineProcess(VOID); 
 	VOID WriteToEngine(CString); 
-	void WriteToBoard(CString);
+	void WriteToBoard(ENGINELINE &line);
+	void HandleQueuedLines(int max);
 	//UINT ReadFromEngine(LPVOID buf);
 	void StopEngine();
 	void StartEngine();
 	void CloseEngine();
+	void JoinReader();
 	int GetEngineFlag();
 	void parseFeatures();
 	void parseFeaturesValue(CString feature,CString& value);
 	int parseFeaturesValue(CString feature);
 	void SetEngineTime(int mytime,int opponenttime);
+	void ResetLatency();
+	void RecordLatency(std::chrono::steady_clock::time_point time);
+	CString GetLatencyString();
 	int m_ping;
 	int m_setboard;
 	int m_playother;
@@ -0,0 +1,131 @@
+// EngineCheck.cpp : starts a chess engine and checks that it answers
+//
+// Not part of the NetChess project, build it on its own:
+//   g++ -O2 -o enginecheck EngineCheck.cpp EngineProcess.cpp
+//   cl /O2 /EHsc EngineCheck.cpp EngineProcess.cpp
+//
+// Usage:
+//   enginecheck [-n count] [-dir directory] [-grace ms] "engine command"
+// Starts the engine, finds out whether it speaks UCI or WinBoard, times n
+// (10 by default) isready/readyok or ping/pong round trips, then stops it
+// with quit, terminate and kill in turn, giving it the grace time for each,
+// and prints how it exited.
+/////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <string>
+
+#include "EngineProcess.h"
+
+//milliseconds an engine has to answer
+#define CHECK_TIMEOUT		5000
+
+static double Seconds(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+//Waits for a line starting with expected, printing the lines read with
+//verbose set. Returns false when the engine exits or does not answer.
+static bool WaitFor(CEngineProcess &engine, const char *expected, bool verbose)
+{
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	size_t length = strlen(expected);
+	std::string line;
+	for(;;)
+	{
+		int left = CHECK_TIMEOUT - (int)(Seconds(start) * 1000);
+		if(left <= 0 || engine.ReadLine(line, left) <= 0)
+			return false;
+		if(verbose)
+			printf("< %s\n", line.c_str());
+		if(line.compare(0, length, expected) == 0)
+			return true;
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	int count = 10, grace = ENGINE_QUIT_GRACE;
+	const char *directory = NULL;
+	int arg = 1;
+	while(arg + 2 < argc && argv[arg][0] == '-')
+	{
+		if(strcmp(argv[arg], "-n") == 0)
+			count = atoi(argv[arg + 1]);
+		else if(strcmp(argv[arg], "-dir") == 0)
+			directory = argv[arg + 1];
+		else if(strcmp(argv[arg], "-grace") == 0)
+			grace = atoi(argv[arg + 1]);
+		else
+			break;
+		arg += 2;
+	}
+	if(arg + 1 != argc)
+	{
+		printf("usage: enginecheck [-n count] [-dir directory] [-grace ms] \"engine command\"\n");
+		return 1;
+	}
+
+	CEngineProcess engine;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	if(!engine.Start(argv[arg], directory))
+	{
+		printf("cannot start %s\n", argv[arg]);
+		return 1;
+	}
+	printf("started in %.1f ms\n", Seconds(start) * 1000);
+
+	bool uci;
+	engine.WriteLine("uci");
+	if(WaitFor(engine, "uciok", true))
+		uci = true;
+	else if(engine.IsRunning())
+	{
+		//not a UCI engine, or a slow one; WinBoard engines ignore "uci"
+		engine.WriteLine("xboard");
+		engine.WriteLine("protover 2");
+		engine.WriteLine("ping 0");
+		if(!WaitFor(engine, "pong 0", true))
+		{
+			printf("no answer, exit code %d\n", engine.Stop(grace));
+			return 1;
+		}
+		uci = false;
+	}
+	else
+	{
+		printf("engine exited with code %d\n", engine.GetExitCode());
+		return 1;
+	}
+	printf("protocol %s\n", uci ? "UCI" : "WinBoard");
+
+	double total = 0, worst = 0;
+	for(int i = 1; i <= count; i++)
+	{
+		char ping[32], pong[32];
+		sprintf(ping, uci ? "isready" : "ping %d", i);
+		sprintf(pong, uci ? "readyok" : "pong %d", i);
+		start = std::chrono::steady_clock::now();
+		engine.WriteLine(ping);
+		if(!WaitFor(engine, pong, false))
+		{
+			printf("no answer to %s\n", ping);
+			break;
+		}
+		double ms = Seconds(start) * 1000;
+		total += ms;
+		if(ms > worst)
+			worst = ms;
+	}
+	if(count > 0)
+		printf("round trip %.3f ms on average, %.3f ms at worst\n", total / count, worst);
+
+	start = std::chrono::steady_clock::now();
+	int code = engine.Stop(grace);
+	printf("stopped in %.1f ms, exit code %d\n", Seconds(start) * 1000, code);
+	return 0;
+}
@@ -68,6 +68,9 @@ void CEngineLogDlg::OnTimer(UINT nIDEvent)
 	}
 	CWnd* wnd= GetDlgItem(IDC_EDIT_ENGINE_LOG);
 	wnd->PostMessage(WM_VSCROLL,SB_BOTTOM,0);
+	CString latency = m_pEngine->GetLatencyString();
+	if(!m_title.IsEmpty() && !latency.IsEmpty())
+		SetWindowText(m_title + " - " + latency);
 
 	CDialog::OnTimer(nIDEvent);
 }
@@ -24,6 +24,8 @@ public:
 	//}}AFX_DATA
 
 	CEngine *m_pEngine;
+	//the latency of the engine is shown after it
+	CString m_title;
 
 // Overrides
 	// ClassWizard generated virtual function overrides
@@ -0,0 +1,260 @@
+// EngineMatch.cpp : plays engines against each other without the board
+//
+// Not part of the NetChess project, build it on its own:
+//   g++ -O2 -pthread -o enginematch EngineMatch.cpp Tournament.cpp MatchStats.cpp EnginePlayer.cpp Analysis.cpp EngineProcess.cpp GameIndex.cpp PGNReader.cpp MappedFile.cpp San.cpp Position.cpp MoveGen.cpp Zobrist.cpp
+//   cl /O2 /EHsc EngineMatch.cpp Tournament.cpp MatchStats.cpp EnginePlayer.cpp Analysis.cpp EngineProcess.cpp GameIndex.cpp PGNReader.cpp MappedFile.cpp San.cpp Position.cpp MoveGen.cpp Zobrist.cpp
+//
+// Usage:
+//   enginematch -engine cmd=command [name=name] [proto=uci|xboard] [dir=directory] [option.name=value]...
+//               -engine ... [-gauntlet] [-rounds n] [-games n] [-concurrency n]
+//               [-tc [moves/]seconds[+increment] | -st seconds | -depth n | -nodes n] [-margin ms]
+//               [-openings file.epd|file.pgn] [-plies n] [-maxmoves n] [-event name] [-pgnout file.pgn]
+//               [-sprt elo0,elo1[,alpha,beta]]
+// Every engine plays every other (with -gauntlet the first plays all the
+// others) games games (2 by default) per round, in pairs with the same
+// opening and the colours reversed. concurrency games (1 by default) are
+// played at once, each between two engine processes of its own, so one
+// per core gives the most games without the engines slowing each other.
+// Openings are the positions of an EPD file or the first plies (8 by
+// default) of the games of a PGN file, taken in turn. Each finished game
+// is printed and appended to the -pgnout file; the standings are printed
+// at the end. Between two engines the Elo difference, LOS and SPRT of the
+// first against the second follow each pair of games; with -sprt no more
+// games are started once the test accepts either hypothesis (by default
+// 0 against 5 Elo with 5% errors). The exit code is 1 when no game could
+// be played.
+/////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <map>
+#include <thread>
+
+#include "MatchStats.h"
+#include "Tournament.h"
+
+struct MATCHOUTPUT
+{
+	CTournament *tournament;
+	FILE *pgn;
+	//two engine matches only
+	CMatchStats *stats;
+	bool sprt;
+	//half points of the first engine in the game of a pair that is over,
+	//by pair
+	std::map<int, int> pending;
+};
+
+static double Seconds(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+//called with the tournament's lock held, so the output is not interleaved
+static void GameDone(const TOURNAMENTGAME &game, void *param)
+{
+	MATCHOUTPUT *output = (MATCHOUTPUT *)param;
+	CTournament *tournament = output->tournament;
+	printf("game %d/%d: %s - %s %s {%s}\n", game.number, tournament->GetGameCount(),
+		tournament->GetEngine(game.white).name.c_str(), tournament->GetEngine(game.black).name.c_str(),
+		CTournament::GetResultString(game.result), game.reason.c_str());
+	if(output->pgn != NULL)
+	{
+		std::string pgn = tournament->FormatPGN(game);
+		fwrite(pgn.data(), 1, pgn.size(), output->pgn);
+		fflush(output->pgn);
+	}
+	if(output->stats != NULL)
+	{
+		int halfPoints = game.result == RESULT_WHITE_WINS ? 2 : game.result == RESULT_BLACK_WINS ? 0 : 1;
+		if(game.white != 0)
+			halfPoints = 2 - halfPoints;
+		//the games of a pair are numbered 2k-1 and 2k
+		int pair = (game.number - 1) / 2;
+		std::map<int, int>::iterator it = output->pending.find(pair);
+		if(it == output->pending.end())
+			output->pending[pair] = halfPoints;
+		else
+		{
+			output->stats->AddPair(it->second, halfPoints);
+			output->pending.erase(it);
+			printf("%s\n", output->stats->Format().c_str());
+			if(output->sprt && output->stats->GetSPRTResult() != SPRT_CONTINUE)
+				tournament->Stop();
+		}
+	}
+	fflush(stdout);
+}
+
+//[moves/]seconds[+increment]
+static bool ParseTimeControl(const char *text, TIMECONTROL &tc)
+{
+	const char *slash = strchr(text, '/');
+	if(slash != NULL)
+	{
+		tc.moves = atoi(text);
+		text = slash + 1;
+	}
+	char *end;
+	tc.base = (int)(strtod(text, &end) * 1000);
+	if(*end == '+')
+		tc.increment = (int)(strtod(end + 1, &end) * 1000);
+	return *end == '\0' && tc.base > 0 && tc.moves >= 0 && tc.increment >= 0;
+}
+
+static void Usage()
+{
+	fprintf(stderr, "usage: enginematch -engine cmd=command [name=name] [proto=uci|xboard] [dir=directory] [option.name=value]...\n");
+	fprintf(stderr, "                   -engine ... [-gauntlet] [-rounds n] [-games n] [-concurrency n]\n");
+	fprintf(stderr, "                   [-tc [moves/]seconds[+increment] | -st seconds | -depth n | -nodes n] [-margin ms]\n");
+	fprintf(stderr, "                   [-openings file.epd|file.pgn] [-plies n] [-maxmoves n] [-event name] [-pgnout file.pgn]\n");
+	fprintf(stderr, "                   [-sprt elo0,elo1[,alpha,beta]]\n");
+}
+
+int main(int argc, char *argv[])
+{
+	CTournament tournament;
+	CMatchStats stats;
+	bool sprt = false;
+	TIMECONTROL tc;
+	memset(&tc, 0, sizeof(tc));
+	int schedule = SCHEDULE_ROUNDROBIN, rounds = 1, games = 2, concurrency = 1, plies = 8, margin = 1000;
+	const char *openings = NULL, *pgnout = NULL;
+	int arg = 1;
+	while(arg < argc)
+	{
+		const char *option = argv[arg++];
+		if(strcmp(option, "-engine") == 0)
+		{
+			TOURNAMENTENGINE engine;
+			arg = ParseEngineConfig(argc, argv, arg, engine);
+			if(arg == 0)
+			{
+				Usage();
+				return 2;
+			}
+			tournament.AddEngine(engine);
+			continue;
+		}
+		if(strcmp(option, "-gauntlet") == 0)
+		{
+			schedule = SCHEDULE_GAUNTLET;
+			continue;
+		}
+		if(arg >= argc)
+		{
+			Usage();
+			return 2;
+		}
+		const char *value = argv[arg++];
+		if(strcmp(option, "-rounds") == 0)
+			rounds = atoi(value);
+		else if(strcmp(option, "-games") == 0)
+			games = atoi(value);
+		else if(strcmp(option, "-concurrency") == 0)
+			concurrency = atoi(value);
+		else if(strcmp(option, "-tc") == 0)
+		{
+			if(!ParseTimeControl(value, tc))
+			{
+				fprintf(stderr, "bad time control: %s\n", value);
+				return 2;
+			}
+		}
+		else if(strcmp(option, "-st") == 0)
+			tc.moveTime = (int)(atof(value) * 1000);
+		else if(strcmp(option, "-depth") == 0)
+			tc.depth = atoi(value);
+		else if(strcmp(option, "-nodes") == 0)
+			tc.nodes = strtoull(value, NULL, 10);
+		else if(strcmp(option, "-margin") == 0)
+			margin = atoi(value);
+		else if(strcmp(option, "-openings") == 0)
+			openings = value;
+		else if(strcmp(option, "-plies") == 0)
+			plies = atoi(value);
+		else if(strcmp(option, "-maxmoves") == 0)
+			tournament.SetMaxMoves(atoi(value));
+		else if(strcmp(option, "-event") == 0)
+			tournament.SetEvent(value);
+		else if(strcmp(option, "-pgnout") == 0)
+			pgnout = value;
+		else if(strcmp(option, "-sprt") == 0)
+		{
+			double elo0, elo1, alpha = SPRT_DEFAULT_ALPHA, beta = SPRT_DEFAULT_BETA;
+			int fields = sscanf(value, "%lf,%lf,%lf,%lf", &elo0, &elo1, &alpha, &beta);
+			if((fields != 2 && fields != 4) || elo1 <= elo0 || alpha <= 0 || beta <= 0 || alpha + beta >= 1)
+			{
+				fprintf(stderr, "bad SPRT: %s\n", value);
+				return 2;
+			}
+			stats.SetSPRT(elo0, elo1, alpha, beta);
+			sprt = true;
+		}
+		else
+		{
+			Usage();
+			return 2;
+		}
+	}
+	if(tournament.GetEngineCount() < 2 || rounds < 1 || games < 1 || concurrency < 1)
+	{
+		Usage();
+		return 2;
+	}
+	if(tc.base == 0 && tc.moveTime == 0 && tc.depth == 0 && tc.nodes == 0)
+	{
+		fprintf(stderr, "one of -tc, -st, -depth and -nodes is needed\n");
+		return 2;
+	}
+	if(sprt && tournament.GetEngineCount() != 2)
+	{
+		fprintf(stderr, "-sprt needs two engines\n");
+		return 2;
+	}
+	tournament.SetTimeControl(tc);
+	tournament.SetTimeMargin(margin);
+	if(openings != NULL)
+	{
+		if(!tournament.LoadOpenings(openings, plies))
+		{
+			fprintf(stderr, "%s: no openings read\n", openings);
+			return 2;
+		}
+		printf("%d openings\n", tournament.GetOpeningCount());
+	}
+
+	MATCHOUTPUT output;
+	output.tournament = &tournament;
+	output.pgn = NULL;
+	output.stats = tournament.GetEngineCount() == 2 ? &stats : NULL;
+	output.sprt = sprt;
+	if(pgnout != NULL && (output.pgn = fopen(pgnout, "a")) == NULL)
+	{
+		fprintf(stderr, "cannot open %s\n", pgnout);
+		return 2;
+	}
+	tournament.SetGameProc(GameDone, &output);
+	tournament.Schedule(schedule, rounds, games);
+	printf("%d games on %d threads (%u cores)\n", tournament.GetGameCount(), concurrency,
+		std::thread::hardware_concurrency());
+	fflush(stdout);
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	tournament.Run(concurrency);
+	if(output.pgn != NULL)
+		fclose(output.pgn);
+
+	printf("\n%d games in %.1f s\n", tournament.GetPlayed(), Seconds(start));
+	printf("%-24s %6s %6s %6s %6s %7s\n", "engine", "games", "wins", "draws", "losses", "score");
+	for(int i = 0; i < tournament.GetEngineCount(); i++)
+	{
+		const TOURNAMENTENGINE &engine = tournament.GetEngine(i);
+		double score = engine.games > 0 ? (engine.wins + engine.draws / 2.0) / engine.games : 0;
+		printf("%-24s %6d %6d %6d %6d %6.1f%%\n", engine.name.c_str(), engine.games, engine.wins,
+			engine.draws, engine.losses, score * 100);
+	}
+	return tournament.GetPlayed() > 0 ? 0 : 1;
+}
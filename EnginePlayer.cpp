@@ -0,0 +1,522 @@
+// EnginePlayer.cpp : a UCI or WinBoard engine playing moves for a game
+//
+
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+
+#include "EnginePlayer.h"
+#include "San.h"
+
+//WinBoard engines that send no features get this long to send them
+#define WINBOARD_FEATURE_TIMEOUT	2000
+//milliseconds Go waits for a line before it looks for a stop again
+#define ENGINE_STOP_POLL			100
+
+static const char g_startFEN[] = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+
+static int Milliseconds(std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end)
+{
+	return (int)std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+}
+
+static bool StartsWith(const std::string &line, const char *prefix)
+{
+	return line.compare(0, strlen(prefix), prefix) == 0;
+}
+
+static bool IsStartPosition(const CPosition &pos)
+{
+	CPosition start;
+	start.SetStartPosition();
+	return pos.GetKey() == start.GetKey();
+}
+
+int ParseEngineConfig(int argc, char *argv[], int arg, ENGINECONFIG &config)
+{
+	config.protocol = ENGINEPROTOCOL_AUTO;
+	for(; arg < argc && argv[arg][0] != '-'; arg++)
+	{
+		const char *equals = strchr(argv[arg], '=');
+		if(equals == NULL)
+			return 0;
+		std::string key(argv[arg], equals - argv[arg]);
+		const char *value = equals + 1;
+		if(key == "cmd")
+			config.command = value;
+		else if(key == "name")
+			config.name = value;
+		else if(key == "dir")
+			config.directory = value;
+		else if(key == "proto" && strcmp(value, "uci") == 0)
+			config.protocol = ENGINEPROTOCOL_UCI;
+		else if(key == "proto" && strcmp(value, "xboard") == 0)
+			config.protocol = ENGINEPROTOCOL_WINBOARD;
+		else if(key.compare(0, 7, "option.") == 0 && key.size() > 7)
+			config.options.push_back(std::make_pair(key.substr(7), std::string(value)));
+		else
+			return 0;
+	}
+	if(config.command.empty())
+		return 0;
+	if(config.name.empty())
+		config.name = config.command;
+	return arg;
+}
+
+CEnginePlayer::CEnginePlayer()
+{
+	m_protocol = ENGINEPROTOCOL_AUTO;
+	m_lineProc = NULL;
+	m_lineParam = NULL;
+	m_setboard = m_usermove = m_san = m_ping = false;
+	m_pingCount = 0;
+	m_stopSearch = false;
+	m_synced = false;
+}
+
+const char *CEnginePlayer::GetStartFEN()
+{
+	return g_startFEN;
+}
+
+void CEnginePlayer::SetLineProc(ENGINELINEPROC proc, void *param)
+{
+	m_lineProc = proc;
+	m_lineParam = param;
+}
+
+//reads the next line into m_line, as CEngineProcess::ReadLine
+int CEnginePlayer::ReadLine(int timeout)
+{
+	int ret = m_process.ReadLine(m_line, timeout);
+	if(ret > 0 && m_lineProc != NULL)
+		m_lineProc(m_line, m_lineParam);
+	return ret;
+}
+
+bool CEnginePlayer::WaitFor(const char *prefix, int timeout)
+{
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for(;;)
+	{
+		int left = timeout < 0 ? -1 : timeout - Milliseconds(start, std::chrono::steady_clock::now());
+		if(timeout >= 0 && left <= 0)
+			return false;
+		if(ReadLine(left) < 0)
+			return false;
+		if(StartsWith(m_line, prefix))
+			return true;
+	}
+}
+
+bool CEnginePlayer::Start(const char *command, int protocol, const char *directory)
+{
+	m_name.clear();
+	m_options.clear();
+	m_setboard = m_usermove = m_san = m_ping = false;
+	m_synced = false;
+	if(!m_process.Start(command, directory))
+		return false;
+	if(protocol != ENGINEPROTOCOL_WINBOARD)
+	{
+		m_process.WriteLine("uci");
+		if(StartUCI(protocol == ENGINEPROTOCOL_AUTO))
+		{
+			m_protocol = ENGINEPROTOCOL_UCI;
+			return true;
+		}
+		if(protocol == ENGINEPROTOCOL_UCI || !m_process.IsRunning())
+		{
+			m_process.Stop(0);
+			return false;
+		}
+	}
+	m_protocol = ENGINEPROTOCOL_WINBOARD;
+	if(!StartWinBoard())
+	{
+		m_process.Stop(0);
+		return false;
+	}
+	return true;
+}
+
+bool CEnginePlayer::Start(const ENGINECONFIG &config)
+{
+	if(!Start(config.command.c_str(), config.protocol, config.directory.empty() ? NULL : config.directory.c_str()))
+		return false;
+	for(size_t i = 0; i < config.options.size(); i++)
+		SetOption(config.options[i].first.c_str(), config.options[i].second.c_str());
+	NewGame();
+	return IsReady();
+}
+
+//Reads the engine's id and options up to "uciok". When guessing the
+//protocol, a WinBoard engine is given away by its complaint about "uci".
+bool CEnginePlayer::StartUCI(bool guess)
+{
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for(;;)
+	{
+		int left = ENGINE_HANDSHAKE_TIMEOUT - Milliseconds(start, std::chrono::steady_clock::now());
+		if(left <= 0 || ReadLine(left) < 0)
+			return false;
+		if(StartsWith(m_line, "uciok"))
+			return true;
+		if(StartsWith(m_line, "id name "))
+			m_name = m_line.substr(8);
+		else if(StartsWith(m_line, "option "))
+			m_options.push_back(m_line);
+		else if(guess && (StartsWith(m_line, "Error") || StartsWith(m_line, "Illegal move") ||
+			StartsWith(m_line, "feature")))
+			return false;
+	}
+}
+
+bool CEnginePlayer::StartWinBoard()
+{
+	m_process.WriteLine("xboard");
+	m_process.WriteLine("protover 2");
+	int timeout = WINBOARD_FEATURE_TIMEOUT;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for(;;)
+	{
+		int left = timeout - Milliseconds(start, std::chrono::steady_clock::now());
+		//a protocol 1 engine sends no features
+		if(left <= 0)
+			break;
+		if(ReadLine(left) < 0)
+			return false;
+		if(!StartsWith(m_line, "feature "))
+			continue;
+		ParseFeatures(m_line);
+		if(m_line.find("done=1") != std::string::npos)
+			break;
+		//the engine asks for time to start up
+		if(m_line.find("done=0") != std::string::npos)
+			timeout = ENGINE_HANDSHAKE_TIMEOUT;
+	}
+	//no pondering, and thinking output for the line procedure
+	m_process.WriteLine("easy");
+	m_process.WriteLine("post");
+	m_process.WriteLine("computer");
+	return true;
+}
+
+//Accepts the features of a "feature" line, except sigint: the engine is
+//never interrupted with a signal.
+void CEnginePlayer::ParseFeatures(const std::string &line)
+{
+	size_t pos = 8;
+	while(pos < line.size())
+	{
+		while(pos < line.size() && line[pos] == ' ')
+			pos++;
+		size_t equals = line.find('=', pos);
+		if(equals == std::string::npos)
+			break;
+		std::string name = line.substr(pos, equals - pos);
+		std::string value;
+		pos = equals + 1;
+		if(pos < line.size() && line[pos] == '"')
+		{
+			size_t end = line.find('"', pos + 1);
+			if(end == std::string::npos)
+				end = line.size();
+			value = line.substr(pos + 1, end - pos - 1);
+			pos = end + 1;
+		}
+		else
+		{
+			size_t end = line.find(' ', pos);
+			if(end == std::string::npos)
+				end = line.size();
+			value = line.substr(pos, end - pos);
+			pos = end;
+		}
+		bool on = value == "1";
+		if(name == "setboard")
+			m_setboard = on;
+		else if(name == "usermove")
+			m_usermove = on;
+		else if(name == "san")
+			m_san = on;
+		else if(name == "ping")
+			m_ping = on;
+		else if(name == "myname")
+			m_name = value;
+		std::string reply = (name == "sigint" ? "rejected " : "accepted ") + name;
+		m_process.WriteLine(reply.c_str());
+	}
+}
+
+int CEnginePlayer::Stop()
+{
+	return m_process.Stop();
+}
+
+void CEnginePlayer::SetOption(const char *name, const char *value)
+{
+	std::string line;
+	if(m_protocol == ENGINEPROTOCOL_UCI)
+		line = std::string("setoption name ") + name + " value " + value;
+	else
+		line = std::string("option ") + name + "=" + value;
+	m_process.WriteLine(line.c_str());
+}
+
+bool CEnginePlayer::IsReady(int timeout)
+{
+	if(m_protocol == ENGINEPROTOCOL_UCI)
+	{
+		m_process.WriteLine("isready");
+		return WaitFor("readyok", timeout);
+	}
+	if(!m_ping)
+		return m_process.IsRunning();
+	char ping[32];
+	sprintf(ping, "ping %d", ++m_pingCount);
+	m_process.WriteLine(ping);
+	ping[1] = 'o';
+	return WaitFor(ping, timeout);
+}
+
+void CEnginePlayer::NewGame()
+{
+	if(m_protocol == ENGINEPROTOCOL_UCI)
+		m_process.WriteLine("ucinewgame");
+	//a WinBoard engine gets "new" with the first move it is asked for
+	m_synced = false;
+}
+
+void CEnginePlayer::SetResult(const char *result, const char *reason)
+{
+	if(m_protocol != ENGINEPROTOCOL_WINBOARD)
+		return;
+	std::string line = std::string("result ") + result + " {" + reason + "}";
+	m_process.WriteLine(line.c_str());
+}
+
+void CEnginePlayer::GoUCI(const CPosition &start, const std::vector<CHESSMOVE> &moves, const ENGINELIMITS &limits)
+{
+	std::string line = "position ";
+	if(IsStartPosition(start))
+		line += "startpos";
+	else
+	{
+		char fen[100];
+		start.GetFEN(fen, sizeof(fen));
+		line += "fen ";
+		line += fen;
+	}
+	if(!moves.empty())
+		line += " moves";
+	for(size_t i = 0; i < moves.size(); i++)
+	{
+		char move[8];
+		FormatLongAlgebraic(moves[i], move);
+		line += ' ';
+		line += move;
+	}
+	m_process.WriteLine(line.c_str());
+
+	char go[160];
+	int n = sprintf(go, "go");
+	if(limits.time[SIDE_WHITE] > 0 || limits.time[SIDE_BLACK] > 0)
+		n += sprintf(go + n, " wtime %d btime %d", limits.time[SIDE_WHITE], limits.time[SIDE_BLACK]);
+	if(limits.increment[SIDE_WHITE] > 0 || limits.increment[SIDE_BLACK] > 0)
+		n += sprintf(go + n, " winc %d binc %d", limits.increment[SIDE_WHITE], limits.increment[SIDE_BLACK]);
+	if(limits.movesToGo > 0)
+		n += sprintf(go + n, " movestogo %d", limits.movesToGo);
+	if(limits.moveTime > 0)
+		n += sprintf(go + n, " movetime %d", limits.moveTime);
+	if(limits.depth > 0)
+		n += sprintf(go + n, " depth %d", limits.depth);
+	if(limits.nodes > 0)
+		n += sprintf(go + n, " nodes %llu", limits.nodes);
+	m_process.WriteLine(go);
+}
+
+void CEnginePlayer::SendMove(CHESSMOVE move)
+{
+	char text[16];
+	if(m_san)
+		FormatSAN(m_sentPosition, move, text);
+	else
+		FormatLongAlgebraic(move, text);
+	std::string line = m_usermove ? std::string("usermove ") + text : std::string(text);
+	m_process.WriteLine(line.c_str());
+	UNDOINFO undo;
+	m_sentPosition.MakeMove(move, undo);
+	m_sent.push_back(move);
+}
+
+//The engine is kept in force mode between its moves and told the moves it
+//has not seen yet, or the whole game again when it is not the one it knows.
+void CEnginePlayer::GoWinBoard(const CPosition &start, const std::vector<CHESSMOVE> &moves, const ENGINELIMITS &limits)
+{
+	char fen[100];
+	start.GetFEN(fen, sizeof(fen));
+	bool known = m_synced && m_startFEN == fen && m_sent.size() <= moves.size();
+	for(size_t i = 0; known && i < m_sent.size(); i++)
+		known = m_sent[i] == moves[i];
+	if(!known)
+	{
+		m_process.WriteLine("new");
+		m_process.WriteLine("force");
+		if(!IsStartPosition(start))
+		{
+			std::string line = std::string("setboard ") + fen;
+			m_process.WriteLine(line.c_str());
+		}
+		m_startFEN = fen;
+		m_sent.clear();
+		m_sentPosition = start;
+		m_synced = true;
+	}
+	for(size_t i = m_sent.size(); i < moves.size(); i++)
+		SendMove(moves[i]);
+
+	int side = m_sentPosition.GetSide();
+	char line[64];
+	if(limits.moveTime > 0)
+	{
+		sprintf(line, "st %d", (limits.moveTime + 999) / 1000);
+		m_process.WriteLine(line);
+	}
+	if(limits.depth > 0)
+	{
+		sprintf(line, "sd %d", limits.depth);
+		m_process.WriteLine(line);
+	}
+	if(limits.time[side] > 0)
+	{
+		//the clock the engine has now stands in for the base time
+		int seconds = limits.time[side] / 1000;
+		sprintf(line, "level %d %d:%02d %g", limits.movesToGo, seconds / 60, seconds % 60,
+			limits.increment[side] / 1000.0);
+		if(!known)
+			m_process.WriteLine(line);
+		sprintf(line, "time %d", limits.time[side] / 10);
+		m_process.WriteLine(line);
+		sprintf(line, "otim %d", limits.time[!side] / 10);
+		m_process.WriteLine(line);
+	}
+	m_process.WriteLine("go");
+}
+
+void CEnginePlayer::Go(const CPosition &start, const std::vector<CHESSMOVE> &moves, const ENGINELIMITS &limits,
+	int timeout, ENGINESEARCH &search)
+{
+	search.reply = ENGINEREPLY_TIMEOUT;
+	search.move = NULL_MOVE;
+	search.elapsed = 0;
+	search.text.clear();
+	search.depth = -1;
+	search.scoreType = SCORE_NONE;
+	search.score = 0;
+	search.nodes = -1;
+	search.pv.clear();
+	m_stopSearch = false;
+	bool stopSent = false;
+	CPosition pos = start;
+	UNDOINFO undo;
+	for(size_t i = 0; i < moves.size(); i++)
+		pos.MakeMove(moves[i], undo);
+	int side = pos.GetSide();
+
+	if(m_protocol == ENGINEPROTOCOL_UCI)
+		GoUCI(start, moves, limits);
+	else
+		GoWinBoard(start, moves, limits);
+	std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+	bool found = false;
+	while(!found)
+	{
+		int elapsed = Milliseconds(begin, std::chrono::steady_clock::now());
+		if(m_stopSearch && !stopSent)
+		{
+			m_process.WriteLine(m_protocol == ENGINEPROTOCOL_UCI ? "stop" : "?");
+			stopSent = true;
+			if(timeout < 0 || timeout > elapsed + ENGINE_STOP_TIMEOUT)
+				timeout = elapsed + ENGINE_STOP_TIMEOUT;
+		}
+		//wait in slices to see a stop asked for from another thread
+		int left = timeout < 0 ? ENGINE_STOP_POLL : timeout - elapsed;
+		int ret = left <= 0 ? 0 : ReadLine(left < ENGINE_STOP_POLL ? left : ENGINE_STOP_POLL);
+		if(ret < 0)
+		{
+			search.reply = ENGINEREPLY_EXITED;
+			break;
+		}
+		if(ret == 0 && (timeout < 0 || left > ENGINE_STOP_POLL))
+			continue;
+		if(ret == 0)
+		{
+			//out of time: ask for the move now so the engine is ready for the next command
+			m_process.WriteLine(m_protocol == ENGINEPROTOCOL_UCI ? "stop" : "?");
+			WaitFor(m_protocol == ENGINEPROTOCOL_UCI ? "bestmove" : "move", ENGINE_STOP_TIMEOUT);
+			search.reply = ENGINEREPLY_TIMEOUT;
+			m_synced = false;
+			search.elapsed = Milliseconds(begin, std::chrono::steady_clock::now());
+			return;
+		}
+		ENGINEINFO info;
+		if(m_protocol == ENGINEPROTOCOL_UCI ? ParseUCIInfo(m_line.c_str(), info) : ParseThinking(m_line.c_str(), info))
+		{
+			if(info.multiPV <= 1 && (info.scoreType != SCORE_NONE || info.pv != NULL))
+			{
+				search.depth = info.depth;
+				search.scoreType = info.scoreType;
+				search.score = info.score;
+				if(info.pv != NULL)
+					search.pv.assign(info.pv, info.pvLength);
+			}
+			if(info.nodes >= 0)
+				search.nodes = info.nodes;
+		}
+		size_t offset = std::string::npos;
+		if(m_protocol == ENGINEPROTOCOL_UCI)
+		{
+			if(StartsWith(m_line, "bestmove "))
+				offset = 9;
+		}
+		else if(StartsWith(m_line, "move "))
+			offset = 5;
+		else if(m_line.find(". ... ") != std::string::npos && m_line[0] >= '0' && m_line[0] <= '9')
+			offset = m_line.find(". ... ") + 6;
+		else if(StartsWith(m_line, "resign") ||
+			(StartsWith(m_line, "1-0") && side == SIDE_BLACK) || (StartsWith(m_line, "0-1") && side == SIDE_WHITE))
+		{
+			search.reply = ENGINEREPLY_RESIGN;
+			found = true;
+		}
+		else if(StartsWith(m_line, "Illegal move") || StartsWith(m_line, "Error"))
+		{
+			search.reply = ENGINEREPLY_ILLEGAL;
+			search.text = m_line;
+			m_synced = false;
+			found = true;
+		}
+		if(offset == std::string::npos)
+			continue;
+		size_t end = m_line.find(' ', offset);
+		search.text = m_line.substr(offset, end == std::string::npos ? std::string::npos : end - offset);
+		search.move = ParseSAN(pos, search.text.c_str());
+		search.reply = search.move == NULL_MOVE ? ENGINEREPLY_ILLEGAL : ENGINEREPLY_MOVE;
+		found = true;
+	}
+	search.elapsed = Milliseconds(begin, m_process.GetReadTime());
+	if(search.elapsed < 0)
+		search.elapsed = 0;
+	if(m_protocol == ENGINEPROTOCOL_WINBOARD && m_synced)
+	{
+		//back to force mode, with the engine's own move counted as told
+		m_process.WriteLine("force");
+		if(search.reply == ENGINEREPLY_MOVE)
+		{
+			m_sentPosition.MakeMove(search.move, undo);
+			m_sent.push_back(search.move);
+		}
+	}
+}
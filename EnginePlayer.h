@@ -0,0 +1,151 @@
+// EnginePlayer.h : a UCI or WinBoard engine playing moves for a game
+//
+// Like Position.h this file has no MFC dependency. It speaks the protocols
+// CEngine speaks for the board, over a CEngineProcess, and waits for the
+// engine's answers on the calling thread, so a thread can play a game
+// between two engines without a window.
+/////////////////////////////////////////////////////////////////////////////
+
+#if !defined(ENGINEPLAYER_H)
+#define ENGINEPLAYER_H
+
+#include <atomic>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "Analysis.h"
+#include "EngineProcess.h"
+#include "Position.h"
+
+enum ENGINE_PROTOCOL {ENGINEPROTOCOL_AUTO, ENGINEPROTOCOL_UCI, ENGINEPROTOCOL_WINBOARD};
+
+//what the engine did with its turn
+enum ENGINE_REPLY {ENGINEREPLY_MOVE, ENGINEREPLY_RESIGN, ENGINEREPLY_ILLEGAL,
+			ENGINEREPLY_TIMEOUT, ENGINEREPLY_EXITED};
+
+//milliseconds an engine has to answer "uci", "protover 2" and isready/ping
+#define ENGINE_HANDSHAKE_TIMEOUT	5000
+//and to send its move after being told to stop
+#define ENGINE_STOP_TIMEOUT			1000
+
+//Limits of a search. Clocks and increments are in milliseconds; a field
+//that is 0 is not sent.
+struct ENGINELIMITS
+{
+	int time[2];
+	int increment[2];
+	int movesToGo;
+	int moveTime;
+	int depth;
+	unsigned long long nodes;
+};
+
+struct ENGINESEARCH
+{
+	int reply;
+	//legal in the position searched when reply is ENGINEREPLY_MOVE
+	CHESSMOVE move;
+	//milliseconds from the go to the reply
+	int elapsed;
+	//the move as the engine sent it
+	std::string text;
+	//from the last line of search output of the main line, -1 and
+	//SCORE_NONE when there was none, the pv as the engine wrote it
+	int depth;
+	int scoreType;
+	int score;
+	long long nodes;
+	std::string pv;
+};
+
+//an engine as it is started, with the options it is given
+struct ENGINECONFIG
+{
+	std::string name;
+	std::string command;
+	//empty for the current one
+	std::string directory;
+	int protocol;
+	std::vector<std::pair<std::string, std::string> > options;
+};
+
+//Reads the name=value words of an engine on a command line from arg on:
+//cmd=command [name=name] [proto=uci|xboard] [dir=directory]
+//[option.name=value]... Returns the argument after them, 0 when one is
+//wrong or there is no cmd.
+int ParseEngineConfig(int argc, char *argv[], int arg, ENGINECONFIG &config);
+
+//called with every line the engine writes
+typedef void (*ENGINELINEPROC)(const std::string &line, void *param);
+
+class CEnginePlayer
+{
+private:
+	CEngineProcess m_process;
+	int m_protocol;
+	std::string m_name;
+	std::string m_line;
+	std::vector<std::string> m_options;
+	ENGINELINEPROC m_lineProc;
+	void *m_lineParam;
+	//WinBoard features
+	bool m_setboard;
+	bool m_usermove;
+	bool m_san;
+	bool m_ping;
+	int m_pingCount;
+	std::atomic<bool> m_stopSearch;
+	//what a WinBoard engine has been told of the game, in force mode
+	bool m_synced;
+	std::string m_startFEN;
+	std::vector<CHESSMOVE> m_sent;
+	CPosition m_sentPosition;
+
+	int ReadLine(int timeout);
+	bool WaitFor(const char *prefix, int timeout);
+	bool StartUCI(bool sent);
+	bool StartWinBoard();
+	void ParseFeatures(const std::string &line);
+	void SendMove(CHESSMOVE move);
+	void GoUCI(const CPosition &start, const std::vector<CHESSMOVE> &moves, const ENGINELIMITS &limits);
+	void GoWinBoard(const CPosition &start, const std::vector<CHESSMOVE> &moves, const ENGINELIMITS &limits);
+
+public:
+	CEnginePlayer();
+
+	//Starts the engine and goes through the handshake. With
+	//ENGINEPROTOCOL_AUTO an engine that does not answer "uci" is taken
+	//for a WinBoard engine.
+	bool Start(const char *command, int protocol = ENGINEPROTOCOL_AUTO, const char *directory = NULL);
+	//starts it as above, sets the options and waits until it is ready
+	bool Start(const ENGINECONFIG &config);
+	//quits the engine, returns its exit code
+	int Stop();
+	bool IsRunning()								{ return m_process.IsRunning(); }
+	int GetProtocol() const							{ return m_protocol; }
+	//the engine's "id name" or "myname" feature, empty when it has none
+	const char *GetName() const						{ return m_name.c_str(); }
+	//"option" lines of a UCI engine
+	const std::vector<std::string> &GetOptions() const	{ return m_options; }
+	void SetLineProc(ENGINELINEPROC proc, void *param);
+
+	void SetOption(const char *name, const char *value);
+	void WriteLine(const char *line)				{ m_process.WriteLine(line); }
+	bool IsReady(int timeout = ENGINE_HANDSHAKE_TIMEOUT);
+	void NewGame();
+	//Lets the engine move in the position after moves from start, waiting
+	//timeout milliseconds for it at most (-1 for as long as it takes).
+	void Go(const CPosition &start, const std::vector<CHESSMOVE> &moves, const ENGINELIMITS &limits,
+		int timeout, ENGINESEARCH &search);
+	//Lets the search Go waits for end with the move found so far. Safe to
+	//call from a line procedure or another thread.
+	void StopSearch()								{ m_stopSearch = true; }
+	//tells a WinBoard engine how the game ended ("1-0", "White mates")
+	void SetResult(const char *result, const char *reason);
+
+	//FEN of the start position, as sent to engines
+	static const char *GetStartFEN();
+};
+
+#endif
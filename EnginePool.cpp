@@ -0,0 +1,121 @@
+// EnginePool.cpp : positions searched by several engine processes at once
+//
+
+#include <string.h>
+#include <thread>
+
+#include "EnginePool.h"
+
+//what the line procedure of a worker's engine needs to know
+struct POOLWORKER
+{
+	CEnginePool *pool;
+	CEnginePlayer *player;
+	ENGINEINFOPROC proc;
+	void *param;
+	int job;
+};
+
+static void PoolLine(const std::string &line, void *param)
+{
+	POOLWORKER *worker = (POOLWORKER *)param;
+	ENGINEINFO info;
+	bool parsed = worker->player->GetProtocol() == ENGINEPROTOCOL_UCI ?
+		ParseUCIInfo(line.c_str(), info) : ParseThinking(line.c_str(), info);
+	if(parsed)
+		worker->proc(worker->job, info, *worker->player, worker->param);
+}
+
+CEnginePool::CEnginePool()
+{
+	memset(&m_limits, 0, sizeof(m_limits));
+	m_timeout = -1;
+	m_infoProc = NULL;
+	m_infoParam = NULL;
+	m_doneProc = NULL;
+	m_doneParam = NULL;
+	m_jobs = NULL;
+	m_order = NULL;
+	m_next = 0;
+	m_stopped = false;
+	m_started = 0;
+}
+
+void CEnginePool::SetLimits(const ENGINELIMITS &limits, int timeout)
+{
+	m_limits = limits;
+	m_timeout = timeout;
+}
+
+void CEnginePool::SetInfoProc(ENGINEINFOPROC proc, void *param)
+{
+	m_infoProc = proc;
+	m_infoParam = param;
+}
+
+void CEnginePool::SetDoneProc(ENGINEDONEPROC proc, void *param)
+{
+	m_doneProc = proc;
+	m_doneParam = param;
+}
+
+bool CEnginePool::Run(const std::vector<ENGINEJOB> &jobs, int threads, const std::vector<int> *order)
+{
+	m_jobs = &jobs;
+	m_order = order;
+	m_next = 0;
+	m_stopped = false;
+	m_started = 0;
+	int count = order != NULL ? (int)order->size() : (int)jobs.size();
+	if(threads > count)
+		threads = count;
+	std::vector<std::thread> workers;
+	for(int i = 0; i < threads; i++)
+		workers.push_back(std::thread(&CEnginePool::Work, this));
+	for(size_t i = 0; i < workers.size(); i++)
+		workers[i].join();
+	return m_started > 0 || threads == 0;
+}
+
+void CEnginePool::Work()
+{
+	CEnginePlayer player;
+	POOLWORKER worker;
+	worker.pool = this;
+	worker.player = &player;
+	worker.proc = m_infoProc;
+	worker.param = m_infoParam;
+	worker.job = -1;
+	if(m_infoProc != NULL)
+		player.SetLineProc(PoolLine, &worker);
+	if(!player.Start(m_config))
+		return;
+	m_started++;
+
+	int count = m_order != NULL ? (int)m_order->size() : (int)m_jobs->size();
+	ENGINESEARCH search;
+	for(;;)
+	{
+		int next = m_next++;
+		if(next >= count || m_stopped)
+			break;
+		int job = m_order != NULL ? (*m_order)[next] : next;
+		const ENGINEJOB &position = (*m_jobs)[job];
+		worker.job = job;
+		for(int attempt = 0; attempt < 2; attempt++)
+		{
+			//the engine may not be reaped yet when its output ends
+			if(attempt > 0 && !player.Start(m_config))
+				break;
+			player.Go(position.start, position.moves, m_limits, m_timeout, search);
+			if(search.reply != ENGINEREPLY_EXITED)
+				break;
+		}
+		if(m_doneProc != NULL)
+		{
+			std::lock_guard<std::mutex> lock(m_lock);
+			m_doneProc(job, search, m_doneParam);
+		}
+	}
+	player.Stop();
+}
@@ -0,0 +1,70 @@
+// EnginePool.h : positions searched by several engine processes at once
+//
+// Like Position.h this file has no MFC dependency. Every worker thread
+// starts its own process of the engine and takes the next position to
+// search as soon as it is idle, so a slow position holds up one engine
+// only. An engine that dies is started again and the position retried
+// once.
+/////////////////////////////////////////////////////////////////////////////
+
+#if !defined(ENGINEPOOL_H)
+#define ENGINEPOOL_H
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+#include "EnginePlayer.h"
+
+//a position to search: start and the moves played from it
+struct ENGINEJOB
+{
+	CPosition start;
+	std::vector<CHESSMOVE> moves;
+};
+
+//Called on the worker thread with each line of search output for job; it
+//may call player.StopSearch() to have the engine move now.
+typedef void (*ENGINEINFOPROC)(int job, const ENGINEINFO &info, CEnginePlayer &player, void *param);
+//called with every search that is over, on one thread at a time
+typedef void (*ENGINEDONEPROC)(int job, const ENGINESEARCH &search, void *param);
+
+class CEnginePool
+{
+private:
+	ENGINECONFIG m_config;
+	ENGINELIMITS m_limits;
+	int m_timeout;
+	ENGINEINFOPROC m_infoProc;
+	void *m_infoParam;
+	ENGINEDONEPROC m_doneProc;
+	void *m_doneParam;
+	const std::vector<ENGINEJOB> *m_jobs;
+	const std::vector<int> *m_order;
+	std::atomic<int> m_next;
+	std::atomic<bool> m_stopped;
+	std::atomic<int> m_started;
+	std::mutex m_lock;
+
+	void Work();
+
+public:
+	CEnginePool();
+
+	void SetEngine(const ENGINECONFIG &config)		{ m_config = config; }
+	//limits of every search, and milliseconds to wait for its move at
+	//most (-1 for as long as it takes)
+	void SetLimits(const ENGINELIMITS &limits, int timeout);
+	void SetInfoProc(ENGINEINFOPROC proc, void *param);
+	void SetDoneProc(ENGINEDONEPROC proc, void *param);
+
+	//Searches jobs (those at the indices of order when it is not NULL)
+	//with threads engines at once, returns once they are done. False when
+	//no engine could be started.
+	bool Run(const std::vector<ENGINEJOB> &jobs, int threads, const std::vector<int> *order = NULL);
+	//no more searches are started, those going on are finished
+	void Stop()										{ m_stopped = true; }
+	bool IsStopped() const							{ return m_stopped; }
+};
+
+#endif
@@ -0,0 +1,534 @@
+// EngineProcess.cpp : a chess engine running as a child process
+//
+
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "EngineProcess.h"
+
+#if !defined(_WIN32)
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#endif
+
+//while waiting for an engine to exit
+#define ENGINE_WAIT_STEP		5
+
+CEngineProcess::CEngineProcess()
+{
+#if defined(_WIN32)
+	m_process = NULL;
+	m_input = NULL;
+	m_output = NULL;
+	m_readEvent = NULL;
+	m_readPending = false;
+	m_readStart = m_readEnd = 0;
+#else
+	m_pid = -1;
+	m_input = -1;
+	m_output = -1;
+#endif
+	m_exitCode = ENGINE_RUNNING;
+	m_pendingStart = 0;
+}
+
+CEngineProcess::~CEngineProcess()
+{
+	Close();
+}
+
+//Engines are started from several threads at once. An engine started while
+//another's pipes can still be inherited would hold them open, and the
+//other's exit would go unnoticed, so starts that need it take this lock.
+static std::mutex g_startLock;
+
+#if defined(_WIN32)
+
+//The child ends of the pipes are inheritable from their creation until
+//CreateProcess returns and they are closed, g_startLock keeps every other
+//engine from being created in between.
+bool CEngineProcess::Start(const char *command, const char *directory)
+{
+	Close();
+	std::lock_guard<std::mutex> lock(g_startLock);
+	SECURITY_ATTRIBUTES sa;
+	sa.nLength = sizeof(sa);
+	sa.lpSecurityDescriptor = NULL;
+	sa.bInheritHandle = TRUE;
+	//the engine inherits its ends of the pipes, ours are not inherited
+	HANDLE childInput = NULL, childOutput = NULL;
+	if(!CreatePipe(&childInput, &m_input, &sa, 0))
+		return false;
+	SetHandleInformation(m_input, HANDLE_FLAG_INHERIT, 0);
+	//anonymous pipes cannot be read overlapped, so the output is a named
+	//pipe of its own
+	static volatile LONG pipes = 0;
+	char name[64];
+	sprintf(name, "\\\\.\\pipe\\netchess-%lu-%ld", GetCurrentProcessId(), InterlockedIncrement(&pipes));
+	m_output = CreateNamedPipeA(name, PIPE_ACCESS_INBOUND | FILE_FLAG_OVERLAPPED | FILE_FLAG_FIRST_PIPE_INSTANCE,
+		PIPE_TYPE_BYTE | PIPE_WAIT, 1, ENGINE_READ_CHUNK, ENGINE_READ_CHUNK, 0, NULL);
+	if(m_output == INVALID_HANDLE_VALUE)
+	{
+		m_output = NULL;
+		CloseHandle(childInput);
+		Close();
+		return false;
+	}
+	childOutput = CreateFileA(name, GENERIC_WRITE, 0, &sa, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	m_readEvent = CreateEventA(NULL, TRUE, FALSE, NULL);
+	if(childOutput == INVALID_HANDLE_VALUE || m_readEvent == NULL)
+	{
+		if(childOutput != INVALID_HANDLE_VALUE)
+			CloseHandle(childOutput);
+		CloseHandle(childInput);
+		Close();
+		return false;
+	}
+
+	STARTUPINFOA si;
+	PROCESS_INFORMATION pi;
+	ZeroMemory(&si, sizeof(si));
+	ZeroMemory(&pi, sizeof(pi));
+	si.cb = sizeof(si);
+	si.hStdError = childOutput;
+	si.hStdOutput = childOutput;
+	si.hStdInput = childInput;
+	si.dwFlags = STARTF_USESTDHANDLES | STARTF_USESHOWWINDOW;
+	si.wShowWindow = SW_HIDE;
+	//CreateProcess may write to the command line
+	std::vector<char> line(command, command + strlen(command) + 1);
+	BOOL ok = CreateProcessA(NULL, &line[0], NULL, NULL, TRUE, 0, NULL, directory, &si, &pi);
+	CloseHandle(childInput);
+	CloseHandle(childOutput);
+	if(!ok)
+	{
+		Close();
+		return false;
+	}
+	CloseHandle(pi.hThread);
+	m_process = pi.hProcess;
+	m_exitCode = ENGINE_RUNNING;
+	return true;
+}
+
+void CEngineProcess::Close()
+{
+	if(IsRunning())
+	{
+		TerminateProcess(m_process, 1);
+		WaitForExit(-1);
+	}
+	if(m_readPending)
+	{
+		//the read has to end before its buffer and event go
+		CancelIoEx(m_output, &m_overlapped);
+		DWORD read;
+		GetOverlappedResult(m_output, &m_overlapped, &read, TRUE);
+		m_readPending = false;
+	}
+	if(m_input != NULL)
+		CloseHandle(m_input);
+	if(m_output != NULL)
+		CloseHandle(m_output);
+	if(m_readEvent != NULL)
+		CloseHandle(m_readEvent);
+	if(m_process != NULL)
+		CloseHandle(m_process);
+	m_input = m_output = m_readEvent = m_process = NULL;
+	m_readStart = m_readEnd = 0;
+	m_exitCode = ENGINE_RUNNING;
+	m_pending.clear();
+	m_pendingStart = 0;
+}
+
+bool CEngineProcess::IsStarted() const
+{
+	return m_process != NULL;
+}
+
+bool CEngineProcess::WaitForExit(int timeout)
+{
+	if(m_exitCode != ENGINE_RUNNING)
+		return true;
+	if(WaitForSingleObject(m_process, timeout < 0 ? INFINITE : (DWORD)timeout) != WAIT_OBJECT_0)
+		return false;
+	DWORD code;
+	m_exitCode = GetExitCodeProcess(m_process, &code) ? (int)code : 1;
+	return true;
+}
+
+bool CEngineProcess::Write(const char *data, size_t length)
+{
+	while(m_input != NULL && length > 0)
+	{
+		DWORD written;
+		if(!WriteFile(m_input, data, (DWORD)length, &written, NULL))
+			return false;
+		data += written;
+		length -= written;
+	}
+	return length == 0;
+}
+
+//One overlapped read into m_readBuffer is kept going; a read with a timeout
+//waits on its event, so it returns as soon as output comes. A read that
+//times out stays pending for the next call.
+int CEngineProcess::Read(char *buf, size_t size, int timeout)
+{
+	if(m_output == NULL)
+		return -1;
+	if(m_readStart == m_readEnd)
+	{
+		if(!m_readPending)
+		{
+			ZeroMemory(&m_overlapped, sizeof(m_overlapped));
+			m_overlapped.hEvent = m_readEvent;
+			if(!ReadFile(m_output, m_readBuffer, sizeof(m_readBuffer), NULL, &m_overlapped) &&
+				GetLastError() != ERROR_IO_PENDING)
+				return -1;
+			m_readPending = true;
+		}
+		if(WaitForSingleObject(m_readEvent, timeout < 0 ? INFINITE : (DWORD)timeout) != WAIT_OBJECT_0)
+			return 0;
+		m_readPending = false;
+		DWORD read;
+		if(!GetOverlappedResult(m_output, &m_overlapped, &read, FALSE) || read == 0)
+			return -1;
+		m_readStart = 0;
+		m_readEnd = read;
+	}
+	if(size > m_readEnd - m_readStart)
+		size = m_readEnd - m_readStart;
+	memcpy(buf, m_readBuffer + m_readStart, size);
+	m_readStart += (DWORD)size;
+	return (int)size;
+}
+
+int CEngineProcess::Stop(int grace)
+{
+	if(IsRunning())
+	{
+		WriteLine("quit");
+		CloseHandle(m_input);
+		m_input = NULL;
+		if(!WaitForExit(grace))
+		{
+			TerminateProcess(m_process, 1);
+			WaitForExit(-1);
+		}
+	}
+	return GetExitCode();
+}
+
+#else
+
+//Splits a command line on spaces, keeping text in double quotes together.
+static void SplitCommand(const char *command, std::vector<std::string> &args)
+{
+	std::string arg;
+	bool quoted = false, started = false;
+	for(const char *p = command; *p != '\0'; p++)
+	{
+		if(*p == '"')
+		{
+			quoted = !quoted;
+			started = true;
+		}
+		else if(*p == ' ' && !quoted)
+		{
+			if(started)
+				args.push_back(arg);
+			arg.clear();
+			started = false;
+		}
+		else
+		{
+			arg += *p;
+			started = true;
+		}
+	}
+	if(started)
+		args.push_back(arg);
+}
+
+//Every end of every pipe is close-on-exec from the start, so an engine
+//forked meanwhile does not inherit it. The child gets its ends through
+//dup2, which clears the flag. Where pipe2 is missing the flag is set after
+//pipe, and g_startLock keeps other engines from being forked in between.
+static bool OpenPipe(int fds[2])
+{
+#if defined(__linux__)
+	return pipe2(fds, O_CLOEXEC) == 0;
+#else
+	if(pipe(fds) != 0)
+		return false;
+	fcntl(fds[0], F_SETFD, fcntl(fds[0], F_GETFD) | FD_CLOEXEC);
+	fcntl(fds[1], F_SETFD, fcntl(fds[1], F_GETFD) | FD_CLOEXEC);
+	return true;
+#endif
+}
+
+//The child reports a failed exec through a pipe that exec closes, so
+//Start knows whether the engine is running when it returns.
+bool CEngineProcess::Start(const char *command, const char *directory)
+{
+	Close();
+	std::vector<std::string> args;
+	SplitCommand(command, args);
+	if(args.empty())
+		return false;
+	std::vector<char*> argv;
+	for(size_t i = 0; i < args.size(); i++)
+		argv.push_back(&args[i][0]);
+	argv.push_back(NULL);
+
+	std::unique_lock<std::mutex> lock(g_startLock, std::defer_lock);
+#if !defined(__linux__)
+	lock.lock();
+#endif
+	int input[2], output[2], status[2];
+	if(!OpenPipe(input))
+		return false;
+	if(!OpenPipe(output))
+	{
+		close(input[0]);
+		close(input[1]);
+		return false;
+	}
+	if(!OpenPipe(status))
+	{
+		close(input[0]);
+		close(input[1]);
+		close(output[0]);
+		close(output[1]);
+		return false;
+	}
+	//a write to an engine that died fails instead of ending NetChess
+	signal(SIGPIPE, SIG_IGN);
+
+	m_pid = fork();
+	if(m_pid == 0)
+	{
+		dup2(input[0], 0);
+		dup2(output[1], 1);
+		dup2(output[1], 2);
+		close(input[0]);
+		close(output[1]);
+		int error = 0;
+		if(directory != NULL && chdir(directory) != 0)
+			error = errno;
+		else
+		{
+			execvp(argv[0], &argv[0]);
+			error = errno;
+		}
+		while(write(status[1], &error, sizeof(error)) < 0 && errno == EINTR)
+			;
+		_exit(ENGINE_NOT_STARTED);
+	}
+	if(lock.owns_lock())
+		lock.unlock();
+	close(input[0]);
+	close(output[1]);
+	close(status[1]);
+	m_input = input[1];
+	m_output = output[0];
+	m_exitCode = ENGINE_RUNNING;
+	int error = 0;
+	ssize_t n = m_pid > 0 ? read(status[0], &error, sizeof(error)) : -1;
+	close(status[0]);
+	if(m_pid < 0 || n > 0)
+	{
+		Close();
+		return false;
+	}
+	fcntl(m_output, F_SETFL, fcntl(m_output, F_GETFL) | O_NONBLOCK);
+	return true;
+}
+
+void CEngineProcess::Close()
+{
+	if(IsRunning())
+	{
+		kill(m_pid, SIGKILL);
+		WaitForExit(-1);
+	}
+	if(m_input >= 0)
+		close(m_input);
+	if(m_output >= 0)
+		close(m_output);
+	m_input = m_output = -1;
+	m_pid = -1;
+	m_exitCode = ENGINE_RUNNING;
+	m_pending.clear();
+	m_pendingStart = 0;
+}
+
+bool CEngineProcess::IsStarted() const
+{
+	return m_pid > 0;
+}
+
+bool CEngineProcess::WaitForExit(int timeout)
+{
+	if(m_exitCode != ENGINE_RUNNING)
+		return true;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for(;;)
+	{
+		int status;
+		pid_t pid = waitpid(m_pid, &status, timeout < 0 ? 0 : WNOHANG);
+		if(pid == m_pid)
+		{
+			m_exitCode = WIFEXITED(status) ? WEXITSTATUS(status) :
+				WIFSIGNALED(status) ? 128 + WTERMSIG(status) : 1;
+			return true;
+		}
+		if(pid < 0 && errno != EINTR)
+		{
+			m_exitCode = 1;
+			return true;
+		}
+		if(timeout >= 0 && std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(timeout))
+			return false;
+		if(pid == 0)
+			usleep(ENGINE_WAIT_STEP * 1000);
+	}
+}
+
+bool CEngineProcess::Write(const char *data, size_t length)
+{
+	while(m_input >= 0 && length > 0)
+	{
+		ssize_t written = write(m_input, data, length);
+		if(written < 0)
+		{
+			if(errno == EINTR)
+				continue;
+			return false;
+		}
+		data += written;
+		length -= (size_t)written;
+	}
+	return length == 0;
+}
+
+int CEngineProcess::Read(char *buf, size_t size, int timeout)
+{
+	if(m_output < 0)
+		return -1;
+	struct pollfd fd;
+	fd.fd = m_output;
+	fd.events = POLLIN;
+	fd.revents = 0;
+	int ready = poll(&fd, 1, timeout);
+	if(ready == 0 || (ready < 0 && errno == EINTR))
+		return 0;
+	if(ready < 0)
+		return -1;
+	ssize_t n = read(m_output, buf, size);
+	if(n > 0)
+		return (int)n;
+	if(n < 0 && (errno == EAGAIN || errno == EINTR))
+		return 0;
+	return -1;
+}
+
+int CEngineProcess::Stop(int grace)
+{
+	if(IsRunning())
+	{
+		WriteLine("quit");
+		close(m_input);
+		m_input = -1;
+		if(!WaitForExit(grace))
+		{
+			kill(m_pid, SIGTERM);
+			if(!WaitForExit(grace))
+			{
+				kill(m_pid, SIGKILL);
+				WaitForExit(-1);
+			}
+		}
+	}
+	return GetExitCode();
+}
+
+#endif
+
+bool CEngineProcess::IsRunning()
+{
+	return IsStarted() && GetExitCode() == ENGINE_RUNNING;
+}
+
+int CEngineProcess::GetExitCode()
+{
+	if(!IsStarted())
+		return m_exitCode == ENGINE_RUNNING ? ENGINE_NOT_STARTED : m_exitCode;
+	WaitForExit(0);
+	return m_exitCode;
+}
+
+//Lines are cut out of m_pending without moving it; what is left of it moves
+//to the front only when more output has to be read.
+int CEngineProcess::ReadLine(std::string &line, int timeout)
+{
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for(;;)
+	{
+		size_t end = m_pending.find('\n', m_pendingStart);
+		if(end != std::string::npos)
+		{
+			size_t length = end - m_pendingStart;
+			if(length > 0 && m_pending[end - 1] == '\r')
+				length--;
+			line.assign(m_pending, m_pendingStart, length);
+			m_pendingStart = end + 1;
+			return 1;
+		}
+		if(m_pendingStart > 0)
+		{
+			m_pending.erase(0, m_pendingStart);
+			m_pendingStart = 0;
+		}
+		int left = timeout;
+		if(timeout > 0)
+		{
+			left -= (int)std::chrono::duration_cast<std::chrono::milliseconds>(
+				std::chrono::steady_clock::now() - start).count();
+			if(left < 0)
+				left = 0;
+		}
+		size_t used = m_pending.size();
+		m_pending.resize(used + ENGINE_READ_CHUNK);
+		int n = Read(&m_pending[used], ENGINE_READ_CHUNK, left);
+		m_pending.resize(n > 0 ? used + n : used);
+		if(n < 0)
+		{
+			//a last line without a newline
+			if(m_pending.empty())
+				return -1;
+			line.assign(m_pending);
+			m_pending.clear();
+			return 1;
+		}
+		if(n == 0)
+			return 0;
+		m_readTime = std::chrono::steady_clock::now();
+	}
+}
+
+bool CEngineProcess::WriteLine(const char *line)
+{
+	std::string data = line;
+	data += '\n';
+	return Write(data.c_str(), data.size());
+}
@@ -0,0 +1,103 @@
+// EngineProcess.h : a chess engine running as a child process
+//
+// Like Position.h this file has no MFC dependency. The engine's standard
+// input and output are pipes to it. Win32 builds start it with
+// CreateProcess and POSIX builds with fork and exec, so engines can be
+// run without the GUI on either.
+/////////////////////////////////////////////////////////////////////////////
+
+#if !defined(ENGINEPROCESS_H)
+#define ENGINEPROCESS_H
+
+#include <stddef.h>
+#include <chrono>
+#include <string>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <sys/types.h>
+#endif
+
+//milliseconds an engine gets to exit after "quit", and after being told
+//to terminate, before it is killed
+#define ENGINE_QUIT_GRACE		1000
+//GetExitCode while the engine runs
+#define ENGINE_RUNNING			-1
+//exit code of an engine that could not be started
+#define ENGINE_NOT_STARTED		127
+//bytes ReadLine asks for at a time
+#define ENGINE_READ_CHUNK		4096
+
+class CEngineProcess
+{
+private:
+#if defined(_WIN32)
+	HANDLE m_process;
+	HANDLE m_input;
+	//the read end of a named pipe opened for overlapped reads, so a read
+	//with a timeout waits on m_readEvent instead of polling
+	HANDLE m_output;
+	HANDLE m_readEvent;
+	OVERLAPPED m_overlapped;
+	bool m_readPending;
+	//what the last read brought that Read has not returned yet, from
+	//m_readStart to m_readEnd
+	char m_readBuffer[ENGINE_READ_CHUNK];
+	DWORD m_readStart;
+	DWORD m_readEnd;
+#else
+	pid_t m_pid;
+	int m_input;
+	int m_output;
+#endif
+	int m_exitCode;
+	//output read but not yet returned by ReadLine, from m_pendingStart on
+	std::string m_pending;
+	size_t m_pendingStart;
+	std::chrono::steady_clock::time_point m_readTime;
+
+	bool WaitForExit(int timeout);
+
+public:
+	CEngineProcess();
+	~CEngineProcess();
+
+	//Starts the engine with command line command in directory, the current
+	//directory when it is NULL. POSIX builds split the command line on
+	//spaces, keeping text in double quotes together.
+	bool Start(const char *command, const char *directory = NULL);
+	//releases the pipes and the process, killing the engine if it runs
+	void Close();
+	bool IsStarted() const;
+	bool IsRunning();
+	//exit code once the engine has exited (128 + the signal when a signal
+	//ended it), ENGINE_RUNNING before
+	int GetExitCode();
+
+	bool Write(const char *data, size_t length);
+	//writes line and a newline
+	bool WriteLine(const char *line);
+	//Reads what the engine has written to buf, waiting at most timeout
+	//milliseconds for something to come (0 does not wait, -1 waits as long
+	//as it takes). Returns the bytes read, 0 when nothing came in time and
+	//-1 once the engine has closed its output.
+	int Read(char *buf, size_t size, int timeout);
+	//Like Read for one line, without its "\n" or "\r\n". Returns 1 for a
+	//line, 0 when no whole line came in time and -1 once the engine has
+	//closed its output. line keeps its storage from call to call.
+	int ReadLine(std::string &line, int timeout);
+	//when the output holding the last line ReadLine returned was read
+	std::chrono::steady_clock::time_point GetReadTime() const	{ return m_readTime; }
+
+	//Sends "quit" and waits grace milliseconds for the engine to exit, then
+	//tells it to terminate and waits again, then kills it. Returns the exit
+	//code. The output can still be read after.
+	int Stop(int grace = ENGINE_QUIT_GRACE);
+
+private:
+	CEngineProcess(const CEngineProcess &);
+	CEngineProcess& operator=(const CEngineProcess &);
+};
+
+#endif
@@ -0,0 +1,167 @@
+// GameAnnotator.cpp : engine evaluation, best line and NAG of every ply of a game
+//
+
+#include <math.h>
+#include <stdio.h>
+
+#include "GameAnnotator.h"
+#include "EPD.h"
+#include "MoveGen.h"
+#include "San.h"
+
+CGameAnnotator::CGameAnnotator()
+{
+	m_done = 0;
+	m_progressProc = NULL;
+	m_progressParam = NULL;
+}
+
+//called by the pool on one thread at a time
+void CGameAnnotator::SearchDone(int job, const ENGINESEARCH &search, void *param)
+{
+	CGameAnnotator *annotator = (CGameAnnotator *)param;
+	annotator->m_searches[job] = search;
+	annotator->m_done++;
+	if(annotator->m_progressProc != NULL)
+		annotator->m_progressProc(annotator->m_done, annotator->GetCount(), annotator->m_progressParam);
+}
+
+bool CGameAnnotator::Run(const CPosition &start, const std::vector<CHESSMOVE> &moves, int threads)
+{
+	m_moves = moves;
+	m_jobs.clear();
+	m_searches.clear();
+	m_done = 0;
+	ENGINEJOB job;
+	job.start = start;
+	ENGINESEARCH unsearched;
+	unsearched.reply = ENGINEREPLY_EXITED;
+	unsearched.move = NULL_MOVE;
+	unsearched.elapsed = 0;
+	unsearched.depth = -1;
+	unsearched.scoreType = SCORE_NONE;
+	unsearched.score = 0;
+	unsearched.nodes = -1;
+	//a position without legal moves is over and not searched
+	std::vector<int> order;
+	CPosition pos = start;
+	UNDOINFO undo;
+	for(size_t i = 0; i <= moves.size(); i++)
+	{
+		CMoveList list;
+		if(GenerateLegalMoves(pos, list) > 0)
+			order.push_back((int)i);
+		m_jobs.push_back(job);
+		m_searches.push_back(unsearched);
+		if(i == moves.size())
+			break;
+		pos.MakeMove(moves[i], undo);
+		job.moves.push_back(moves[i]);
+	}
+	m_done = (int)(m_jobs.size() - order.size());
+	m_pool.SetDoneProc(SearchDone, this);
+	return m_pool.Run(m_jobs, threads, &order);
+}
+
+void CGameAnnotator::GetPosition(int i, CPosition &pos)
+{
+	pos = m_jobs[i].start;
+	UNDOINFO undo;
+	for(size_t k = 0; k < m_jobs[i].moves.size(); k++)
+		pos.MakeMove(m_jobs[i].moves[k], undo);
+}
+
+bool CGameAnnotator::GetExpectedScore(int i, double &score)
+{
+	const ENGINESEARCH &search = m_searches[i];
+	if(search.reply == ENGINEREPLY_MOVE && search.scoreType == SCORE_CP)
+		score = 1 / (1 + pow(10.0, -search.score / 400.0));
+	else if(search.reply == ENGINEREPLY_MOVE && search.scoreType == SCORE_MATE)
+		score = search.score > 0 ? 1 : 0;
+	else
+	{
+		//mated or stalemated
+		CPosition pos;
+		GetPosition(i, pos);
+		CMoveList list;
+		if(GenerateLegalMoves(pos, list) > 0)
+			return false;
+		score = pos.IsInCheck() ? 0 : 0.5;
+	}
+	return true;
+}
+
+//"+0.35/18", "#-3/22" from White's point of view, empty when unknown
+std::string CGameAnnotator::FormatScore(int i)
+{
+	const ENGINESEARCH &search = m_searches[i];
+	if(search.reply != ENGINEREPLY_MOVE || search.scoreType == SCORE_NONE)
+		return std::string();
+	int side = m_jobs[i].start.GetSide();
+	if(m_jobs[i].moves.size() % 2 == 1)
+		side = !side;
+	int score = side == SIDE_BLACK ? -search.score : search.score;
+	char text[32];
+	int n;
+	if(search.scoreType == SCORE_MATE)
+		n = sprintf(text, "#%d", score);
+	else
+		n = sprintf(text, "%+.2f", score / 100.0);
+	if(search.depth >= 0)
+		sprintf(text + n, "/%d", search.depth);
+	return std::string(text);
+}
+
+void CGameAnnotator::GetAnnotation(int ply, PLYANNOTATION &annotation)
+{
+	annotation.nag = 0;
+	annotation.comment = FormatScore(ply + 1);
+	const ENGINESEARCH &search = m_searches[ply];
+	if(search.reply != ENGINEREPLY_MOVE || search.move == m_moves[ply])
+		return;
+
+	//the side moving scores 1 - the score of its opponent after the move
+	double before, after;
+	if(GetExpectedScore(ply, before) && GetExpectedScore(ply + 1, after))
+	{
+		double loss = before - (1 - after);
+		if(loss >= ANNOTATE_BLUNDER)
+			annotation.nag = NAG_BLUNDER;
+		else if(loss >= ANNOTATE_MISTAKE)
+			annotation.nag = NAG_MISTAKE;
+		else if(loss >= ANNOTATE_INACCURACY)
+			annotation.nag = NAG_INACCURACY;
+	}
+
+	//the engine's line, from its move on as far as it is legal
+	CPosition pos;
+	GetPosition(ply, pos);
+	UNDOINFO undo;
+	std::vector<CHESSMOVE> line;
+	ParseVariation(pos, search.pv.c_str(), line);
+	if(line.empty() || line[0] != search.move)
+		line.assign(1, search.move);
+	if(line.size() > ANNOTATE_LINE_PLIES)
+		line.resize(ANNOTATE_LINE_PLIES);
+	std::string text = annotation.comment.empty() ? "best:" : annotation.comment + " best:";
+	char san[16];
+	char number[16];
+	for(size_t k = 0; k < line.size(); k++)
+	{
+		if(pos.GetSide() == SIDE_WHITE)
+			sprintf(number, " %d.", pos.GetFullMoveNumber());
+		else if(k == 0)
+			sprintf(number, " %d...", pos.GetFullMoveNumber());
+		else
+			number[0] = '\0';
+		text += number;
+		text += ' ';
+		FormatSAN(pos, line[k], san);
+		text += san;
+		pos.MakeMove(line[k], undo);
+	}
+	std::string score = FormatScore(ply);
+	if(!score.empty())
+		text += " (" + score + ")";
+	annotation.comment = text;
+}
@@ -0,0 +1,83 @@
+// GameAnnotator.h : engine evaluation, best line and NAG of every ply of a game
+//
+// Like Position.h this file has no MFC dependency. The position before
+// every ply, and the one the game ends in, are searched on their own by a
+// CEnginePool, so a game is annotated by as many engines at once as there
+// are threads. A move is marked by how much it lowers the expected score
+// of the side making it, from the evaluations before and after it, so a
+// lost pawn counts for less when the game is already decided.
+/////////////////////////////////////////////////////////////////////////////
+
+#if !defined(GAMEANNOTATOR_H)
+#define GAMEANNOTATOR_H
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include "EnginePool.h"
+
+//the standard move NAGs
+#define NAG_MISTAKE			2
+#define NAG_BLUNDER			4
+#define NAG_INACCURACY		6
+
+//drop in the expected score of the side moving that makes the move an
+//inaccuracy, a mistake or a blunder
+#define ANNOTATE_INACCURACY	0.10
+#define ANNOTATE_MISTAKE	0.20
+#define ANNOTATE_BLUNDER	0.30
+//plies of the best line written
+#define ANNOTATE_LINE_PLIES	8
+
+//called on a pool thread as each position is searched
+typedef void (*ANNOTATEPROGRESSPROC)(int done, int count, void *param);
+
+struct PLYANNOTATION
+{
+	//0 when the move is not marked
+	int nag;
+	//"+0.35/18", with "best: 14. Nf3 Bd7 (+1.10)" when the engine prefers
+	//another move; empty when the position after the move was not searched
+	std::string comment;
+};
+
+class CGameAnnotator
+{
+private:
+	CEnginePool m_pool;
+	//position before ply i, the last one after the last ply
+	std::vector<ENGINEJOB> m_jobs;
+	std::vector<ENGINESEARCH> m_searches;
+	std::vector<CHESSMOVE> m_moves;
+	std::atomic<int> m_done;
+	ANNOTATEPROGRESSPROC m_progressProc;
+	void *m_progressParam;
+
+	static void SearchDone(int job, const ENGINESEARCH &search, void *param);
+	void GetPosition(int i, CPosition &pos);
+	//expected score of the side to move in position i, false when unknown
+	bool GetExpectedScore(int i, double &score);
+	std::string FormatScore(int i);
+
+public:
+	CGameAnnotator();
+
+	void SetEngine(const ENGINECONFIG &config)		{ m_pool.SetEngine(config); }
+	//see CEnginePool::SetLimits
+	void SetLimits(const ENGINELIMITS &limits, int timeout)	{ m_pool.SetLimits(limits, timeout); }
+	void SetProgressProc(ANNOTATEPROGRESSPROC proc, void *param)	{ m_progressProc = proc; m_progressParam = param; }
+	//Searches the positions of the moves played from start with threads
+	//engines at once, returns once they are done. False when no engine
+	//could be started.
+	bool Run(const CPosition &start, const std::vector<CHESSMOVE> &moves, int threads);
+	//no more positions are searched, those being searched are finished
+	void Stop()										{ m_pool.Stop(); }
+	//positions searched so far, of GetCount; safe to call during Run
+	int GetDone() const								{ return m_done; }
+	int GetCount() const							{ return (int)m_jobs.size(); }
+	//the annotation of the move at ply after Run
+	void GetAnnotation(int ply, PLYANNOTATION &annotation);
+};
+
+#endif
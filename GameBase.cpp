@@ -0,0 +1,557 @@
+// GameBase.cpp : binary game database with a position index
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <string>
+#include <unordered_map>
+
+#include "GameBase.h"
+#include "GameIndex.h"
+#include "PGNReader.h"
+#include "San.h"
+
+static const char g_baseMagic[4] = {'N', 'C', 'D', 'B'};
+#define GAMEBASE_VERSION		1
+//position entries sorted in memory before they go to the scratch file
+#define GAMEBASE_RUN			(4 * 1024 * 1024)
+//entries read from each sorted run at a time while merging
+#define GAMEBASE_MERGE_BUFFER	8192
+//hits mapped at a time
+#define GAMEBASE_WINDOW			(1024 * 1024)
+#define GAMEBASE_BUCKETS		(1 << GAMEBASE_BUCKET_BITS)
+
+static const char *g_columnTags[GAMEBASE_NAME_COLUMNS] =
+	{"White", "Black", "Event", "Site", "Date", "Round", "FEN"};
+
+//position reached by a game while building
+struct GAMEBASEENTRY
+{
+	BITBOARD key;
+	unsigned int game;
+	unsigned int ply;
+};
+
+static bool EntryLess(const GAMEBASEENTRY &a, const GAMEBASEENTRY &b)
+{
+	if(a.key != b.key)
+		return a.key < b.key;
+	if(a.game != b.game)
+		return a.game < b.game;
+	return a.ply < b.ply;
+}
+
+static bool Seek(FILE *fp, unsigned long long offset)
+{
+#if defined(_WIN32)
+	return _fseeki64(fp, (long long)offset, SEEK_SET) == 0;
+#else
+	return fseeko(fp, (off_t)offset, SEEK_SET) == 0;
+#endif
+}
+
+//pads the file to a multiple of 8 bytes so the next section is aligned
+static void Align(FILE *fp, unsigned long long &offset)
+{
+	while(offset % 8 != 0)
+	{
+		fputc('\0', fp);
+		offset++;
+	}
+}
+
+//names are stored once, id 0 is the empty name
+class CNameTable
+{
+private:
+	std::unordered_map<std::string, unsigned int> m_ids;
+
+public:
+	std::string m_text;
+	std::vector<unsigned int> m_offsets;
+
+	CNameTable()
+	{
+		m_text.assign(1, '\0');
+		m_offsets.push_back(0);
+	}
+
+	unsigned int Add(const char *name, int length)
+	{
+		if(name == NULL || length <= 0)
+			return 0;
+		if(length > GAMEINDEX_MAX_STRING)
+			length = GAMEINDEX_MAX_STRING;
+		std::pair<std::unordered_map<std::string, unsigned int>::iterator, bool> added =
+			m_ids.insert(std::make_pair(std::string(name, length), (unsigned int)m_offsets.size()));
+		if(added.second)
+		{
+			m_offsets.push_back((unsigned int)m_text.size());
+			m_text.append(name, length);
+			m_text += '\0';
+		}
+		return added.first->second;
+	}
+};
+
+//one sorted run of the scratch file being merged
+struct MERGERUN
+{
+	unsigned long long next;
+	unsigned long long end;
+	std::vector<GAMEBASEENTRY> buffer;
+	size_t pos;
+};
+
+static bool FillRun(FILE *fp, MERGERUN &run)
+{
+	run.pos = 0;
+	run.buffer.clear();
+	if(run.next == run.end)
+		return false;
+	size_t count = run.end - run.next < GAMEBASE_MERGE_BUFFER ? (size_t)(run.end - run.next) : GAMEBASE_MERGE_BUFFER;
+	run.buffer.resize(count);
+	if(!Seek(fp, run.next * sizeof(GAMEBASEENTRY)) ||
+		fread(&run.buffer[0], sizeof(GAMEBASEENTRY), count, fp) != count)
+	{
+		run.buffer.clear();
+		return false;
+	}
+	run.next += count;
+	return true;
+}
+
+//Sorts the positions of whole games and writes them to the scratch file.
+//A game is never split between runs, so dropping the repeats of a key in a
+//run keeps only the first ply each game reached it.
+static void FlushRun(FILE *fp, std::vector<GAMEBASEENTRY> &entries,
+	std::vector<unsigned long long> &runs)
+{
+	if(entries.empty())
+		return;
+	std::sort(entries.begin(), entries.end(), EntryLess);
+	size_t kept = 0;
+	for(size_t i = 0; i < entries.size(); i++)
+	{
+		if(kept > 0 && entries[kept - 1].key == entries[i].key && entries[kept - 1].game == entries[i].game)
+			continue;
+		entries[kept++] = entries[i];
+	}
+	fwrite(&entries[0], sizeof(GAMEBASEENTRY), kept, fp);
+	runs.push_back(runs.back() + kept);
+	entries.clear();
+}
+
+//Merges the runs into the hit table, written to fp, and the key table,
+//written to keyfp. Fills buckets and the hit and key counts.
+static bool MergeRuns(FILE *runfp, std::vector<unsigned long long> &runs, FILE *fp, FILE *keyfp,
+	std::vector<unsigned long long> &buckets, GAMEBASEHEADER &header)
+{
+	std::vector<MERGERUN> merge(runs.size() - 1);
+	std::vector<unsigned int> heap;
+	for(size_t i = 0; i < merge.size(); i++)
+	{
+		merge[i].next = runs[i];
+		merge[i].end = runs[i + 1];
+		if(FillRun(runfp, merge[i]))
+			heap.push_back((unsigned int)i);
+	}
+	//smallest entry on top
+	struct RunGreater
+	{
+		std::vector<MERGERUN> *runs;
+		bool operator()(unsigned int a, unsigned int b) const
+		{
+			MERGERUN &ra = (*runs)[a];
+			MERGERUN &rb = (*runs)[b];
+			return EntryLess(rb.buffer[rb.pos], ra.buffer[ra.pos]);
+		}
+	} greater = {&merge};
+	std::make_heap(heap.begin(), heap.end(), greater);
+
+	buckets.assign(GAMEBASE_BUCKETS + 1, 0);
+	unsigned int nextBucket = 0;
+	header.hits = header.keys = 0;
+	bool first = true;
+	BITBOARD last = 0;
+	while(!heap.empty())
+	{
+		std::pop_heap(heap.begin(), heap.end(), greater);
+		MERGERUN &run = merge[heap.back()];
+		const GAMEBASEENTRY &entry = run.buffer[run.pos];
+		if(first || entry.key != last)
+		{
+			unsigned int bucket = (unsigned int)(entry.key >> (64 - GAMEBASE_BUCKET_BITS));
+			while(nextBucket <= bucket)
+				buckets[nextBucket++] = header.keys;
+			GAMEBASEKEY key = {entry.key, header.hits};
+			fwrite(&key, sizeof(key), 1, keyfp);
+			header.keys++;
+			last = entry.key;
+			first = false;
+		}
+		GAMEBASEHIT hit = {entry.game, entry.ply};
+		fwrite(&hit, sizeof(hit), 1, fp);
+		header.hits++;
+		if(++run.pos < run.buffer.size() || FillRun(runfp, run))
+			std::push_heap(heap.begin(), heap.end(), greater);
+		else
+			heap.pop_back();
+	}
+	while(nextBucket <= GAMEBASE_BUCKETS)
+		buckets[nextBucket++] = header.keys;
+	//the end of the hits of the last key
+	GAMEBASEKEY end = {~(BITBOARD)0, header.hits};
+	fwrite(&end, sizeof(end), 1, keyfp);
+	return ferror(runfp) == 0 && ferror(keyfp) == 0;
+}
+
+CGameBase::CGameBase()
+{
+	memset(&m_header, 0, sizeof(m_header));
+}
+
+//The games are read in one pass. Moves go straight to the database after
+//the header, the columns and names are kept in memory and the positions
+//are sorted in runs on a scratch file, then merged into the index.
+bool CGameBase::Build(const char *path, const char *dbpath,
+	GAMEBASEPROGRESSPROC proc, void *param)
+{
+	GAMEBASEHEADER header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, g_baseMagic, sizeof(header.magic));
+	header.version = GAMEBASE_VERSION;
+	CPGNReader reader;
+	if(!CGameIndex::GetSourceStamp(path, header.sourceSize, header.sourceTime) || !reader.Open(path))
+		return false;
+
+	char runpath[1024], keypath[1024];
+	sprintf(runpath, "%.1000s~", dbpath);
+	sprintf(keypath, "%.1000s~~", dbpath);
+	FILE *fp = fopen(dbpath, "wb");
+	FILE *runfp = fp != NULL ? fopen(runpath, "w+b") : NULL;
+	FILE *keyfp = runfp != NULL ? fopen(keypath, "w+b") : NULL;
+	if(keyfp == NULL)
+	{
+		if(runfp != NULL)
+			fclose(runfp);
+		if(fp != NULL)
+			fclose(fp);
+		remove(runpath);
+		remove(dbpath);
+		return false;
+	}
+	fwrite(&header, sizeof(header), 1, fp);
+
+	std::vector<unsigned int> columns[GAMEBASE_COLUMNS];
+	std::vector<unsigned long long> starts;
+	CNameTable names;
+	std::vector<GAMEBASEENTRY> entries;
+	entries.reserve(GAMEBASE_RUN);
+	std::vector<unsigned long long> runs(1, 0);
+	std::vector<CHESSMOVE> line;
+	CPosition pos;
+	UNDOINFO undo;
+	while(reader.NextGame())
+	{
+		unsigned int values[GAMEBASE_COLUMNS];
+		memset(values, 0, sizeof(values));
+		GAMEBASEENTRY entry = {0, header.games, 0};
+		pos.SetStartPosition();
+		line.clear();
+		bool ok = true, movetext = false;
+		int depth = 0;
+		PGNTOKEN token;
+		int type;
+		while((type = reader.NextToken(token)) != PGN_END)
+		{
+			if(type == PGN_TAG)
+			{
+				for(int c = 0; c < GAMEBASE_NAME_COLUMNS; c++)
+				{
+					if(token.length == (int)strlen(g_columnTags[c]) &&
+						strncmp(token.text, g_columnTags[c], token.length) == 0)
+						values[c] = names.Add(token.value, token.valueLength);
+				}
+				if(token.value == NULL)
+					continue;
+				std::string value(token.value, token.valueLength);
+				if(token.length == 8 && strncmp(token.text, "WhiteElo", 8) == 0)
+					values[COLUMN_WHITE_ELO] = (unsigned int)atoi(value.c_str());
+				else if(token.length == 8 && strncmp(token.text, "BlackElo", 8) == 0)
+					values[COLUMN_BLACK_ELO] = (unsigned int)atoi(value.c_str());
+				else if(token.length == 6 && strncmp(token.text, "Result", 6) == 0)
+					values[COLUMN_RESULT] = CGameIndex::ParseResult(token.value, token.valueLength);
+				else if(token.length == 3 && strncmp(token.text, "FEN", 3) == 0 && !pos.SetFEN(value.c_str()))
+					ok = false;
+				continue;
+			}
+			if(!movetext)
+			{
+				movetext = true;
+				if(ok)
+				{
+					entry.key = pos.GetKey();
+					entries.push_back(entry);
+				}
+			}
+			if(type == PGN_VARIATION_START)
+				depth++;
+			else if(type == PGN_VARIATION_END && depth > 0)
+				depth--;
+			else if(type == PGN_SAN && depth == 0 && ok)
+			{
+				char san[16];
+				int n = token.length < (int)sizeof(san) - 1 ? token.length : (int)sizeof(san) - 1;
+				memcpy(san, token.text, n);
+				san[n] = '\0';
+				CHESSMOVE move = ParseSAN(pos, san);
+				if(move == NULL_MOVE)
+				{
+					//the moves up to a bad one are kept
+					ok = false;
+					continue;
+				}
+				pos.MakeMove(move, undo);
+				line.push_back(move);
+				entry.key = pos.GetKey();
+				entry.ply = (unsigned int)line.size();
+				entries.push_back(entry);
+			}
+		}
+		if(!movetext && ok)
+		{
+			entry.key = pos.GetKey();
+			entries.push_back(entry);
+		}
+		values[COLUMN_PLIES] = (unsigned int)line.size();
+		for(int c = 0; c < GAMEBASE_COLUMNS; c++)
+			columns[c].push_back(values[c]);
+		starts.push_back(header.moves);
+		if(!line.empty())
+			fwrite(&line[0], sizeof(CHESSMOVE), line.size(), fp);
+		header.moves += line.size();
+		header.games++;
+		if(proc != NULL && header.games % GAMEBASE_PROGRESS_GAMES == 0)
+			proc(header.games, reader.GetOffset(), header.sourceSize, param);
+		if(entries.size() >= GAMEBASE_RUN)
+			FlushRun(runfp, entries, runs);
+	}
+	FlushRun(runfp, entries, runs);
+	starts.push_back(header.moves);
+	header.names = (unsigned int)names.m_offsets.size();
+	names.m_offsets.push_back((unsigned int)names.m_text.size());
+
+	unsigned long long offset = sizeof(header) + header.moves * sizeof(CHESSMOVE);
+	Align(fp, offset);
+	header.columns = offset;
+	for(int c = 0; c < GAMEBASE_COLUMNS; c++)
+	{
+		if(header.games > 0)
+			fwrite(&columns[c][0], sizeof(unsigned int), header.games, fp);
+		offset += (unsigned long long)header.games * sizeof(unsigned int);
+	}
+	Align(fp, offset);
+	header.starts = offset;
+	fwrite(&starts[0], sizeof(unsigned long long), starts.size(), fp);
+	offset += starts.size() * sizeof(unsigned long long);
+	header.nameOffsets = offset;
+	fwrite(&names.m_offsets[0], sizeof(unsigned int), names.m_offsets.size(), fp);
+	offset += names.m_offsets.size() * sizeof(unsigned int);
+	header.nameText = offset;
+	fwrite(names.m_text.data(), 1, names.m_text.size(), fp);
+	offset += names.m_text.size();
+	Align(fp, offset);
+
+	std::vector<unsigned long long> buckets;
+	header.hitTable = offset;
+	bool ok = MergeRuns(runfp, runs, fp, keyfp, buckets, header);
+	fclose(runfp);
+	remove(runpath);
+	offset += header.hits * sizeof(GAMEBASEHIT);
+	header.keyTable = offset;
+	fseek(keyfp, 0, SEEK_SET);
+	char buf[65536];
+	size_t n;
+	while((n = fread(buf, 1, sizeof(buf), keyfp)) > 0)
+		fwrite(buf, 1, n, fp);
+	fclose(keyfp);
+	remove(keypath);
+	offset += (header.keys + 1) * sizeof(GAMEBASEKEY);
+	header.buckets = offset;
+	fwrite(&buckets[0], sizeof(unsigned long long), buckets.size(), fp);
+
+	fseek(fp, 0, SEEK_SET);
+	fwrite(&header, sizeof(header), 1, fp);
+	if(ferror(fp) != 0)
+		ok = false;
+	if(fclose(fp) != 0)
+		ok = false;
+	if(!ok)
+		remove(dbpath);
+	return ok;
+}
+
+bool CGameBase::Load(const char *dbpath)
+{
+	Close();
+	if(!m_file.Open(dbpath) || !m_names.Open(dbpath) || !m_keys.Open(dbpath) || !m_hits.Open(dbpath))
+	{
+		Close();
+		return false;
+	}
+	const GAMEBASEHEADER *header = (const GAMEBASEHEADER *)m_file.Map(0, sizeof(GAMEBASEHEADER));
+	if(header == NULL || m_file.GetSize() < sizeof(GAMEBASEHEADER) ||
+		memcmp(header->magic, g_baseMagic, sizeof(header->magic)) != 0 ||
+		header->version != GAMEBASE_VERSION ||
+		header->buckets + (GAMEBASE_BUCKETS + 1) * sizeof(unsigned long long) != m_file.GetSize())
+	{
+		Close();
+		return false;
+	}
+	m_header = *header;
+	const unsigned long long *buckets = (const unsigned long long *)m_file.Map(m_header.buckets,
+		(GAMEBASE_BUCKETS + 1) * sizeof(unsigned long long));
+	if(buckets == NULL)
+	{
+		Close();
+		return false;
+	}
+	m_buckets.assign(buckets, buckets + GAMEBASE_BUCKETS + 1);
+	return true;
+}
+
+bool CGameBase::Open(const char *path, GAMEBASEPROGRESSPROC proc, void *param)
+{
+	char dbpath[1024];
+	sprintf(dbpath, "%.1000s.ncdb", path);
+	unsigned long long size;
+	long long time;
+	if(!CGameIndex::GetSourceStamp(path, size, time))
+		return false;
+	if(!Load(dbpath) || m_header.sourceSize != size || m_header.sourceTime != time)
+	{
+		Close();
+		if(!Build(path, dbpath, proc, param) || !Load(dbpath))
+		{
+			Close();
+			return false;
+		}
+	}
+	return true;
+}
+
+void CGameBase::Close()
+{
+	m_file.Close();
+	m_names.Close();
+	m_keys.Close();
+	m_hits.Close();
+	memset(&m_header, 0, sizeof(m_header));
+	m_buckets.clear();
+}
+
+unsigned int CGameBase::GetColumn(unsigned int game, int column)
+{
+	if(!IsOpen() || game >= m_header.games || column < 0 || column >= GAMEBASE_COLUMNS)
+		return 0;
+	const unsigned int *value = (const unsigned int *)m_file.Map(m_header.columns +
+		((unsigned long long)column * m_header.games + game) * sizeof(unsigned int), sizeof(unsigned int));
+	return value != NULL ? *value : 0;
+}
+
+const char *CGameBase::GetName(unsigned int id)
+{
+	if(!IsOpen() || id == 0 || id >= m_header.names)
+		return "";
+	const unsigned int *offset = (const unsigned int *)m_names.Map(m_header.nameOffsets +
+		(unsigned long long)id * sizeof(unsigned int), sizeof(unsigned int));
+	if(offset == NULL)
+		return "";
+	const char *name = m_names.Map(m_header.nameText + *offset, GAMEINDEX_MAX_STRING + 1);
+	return name != NULL ? name : "";
+}
+
+bool CGameBase::GetStartPosition(unsigned int game, CPosition &pos)
+{
+	unsigned int fen = GetColumn(game, COLUMN_FEN);
+	if(fen == 0)
+	{
+		pos.SetStartPosition();
+		return true;
+	}
+	return pos.SetFEN(GetName(fen));
+}
+
+int CGameBase::GetMoves(unsigned int game, CHESSMOVE *moves, int size)
+{
+	if(!IsOpen() || game >= m_header.games)
+		return 0;
+	const unsigned long long *starts = (const unsigned long long *)m_file.Map(m_header.starts +
+		(unsigned long long)game * sizeof(unsigned long long), 2 * sizeof(unsigned long long));
+	if(starts == NULL)
+		return 0;
+	unsigned long long first = starts[0];
+	unsigned long long count = starts[1] - starts[0];
+	if(count > (unsigned long long)size)
+		count = size;
+	if(count == 0)
+		return 0;
+	const CHESSMOVE *line = (const CHESSMOVE *)m_file.Map(sizeof(GAMEBASEHEADER) +
+		first * sizeof(CHESSMOVE), (size_t)count * sizeof(CHESSMOVE));
+	if(line == NULL)
+		return 0;
+	memcpy(moves, line, (size_t)count * sizeof(CHESSMOVE));
+	return (int)count;
+}
+
+//The bucket of the key bounds a binary search over a few hundred keys at
+//most, so a lookup maps two small views whatever the size of the database.
+unsigned long long CGameBase::FindPosition(BITBOARD key, std::vector<GAMEBASEHIT> &hits, unsigned int max)
+{
+	if(!IsOpen())
+		return 0;
+	unsigned int bucket = (unsigned int)(key >> (64 - GAMEBASE_BUCKET_BITS));
+	unsigned long long low = m_buckets[bucket], high = m_buckets[bucket + 1];
+	if(low == high)
+		return 0;
+	//with the key after the bucket, the end of its last key's hits
+	const GAMEBASEKEY *keys = (const GAMEBASEKEY *)m_keys.Map(m_header.keyTable +
+		low * sizeof(GAMEBASEKEY), (size_t)(high - low + 1) * sizeof(GAMEBASEKEY));
+	if(keys == NULL)
+		return 0;
+	size_t count = (size_t)(high - low);
+	size_t found = 0;
+	while(count > 0)
+	{
+		size_t half = count / 2;
+		if(keys[found + half].key < key)
+		{
+			found += half + 1;
+			count -= half + 1;
+		}
+		else
+		{
+			count = half;
+		}
+	}
+	if(found == high - low || keys[found].key != key)
+		return 0;
+	unsigned long long first = keys[found].first;
+	unsigned long long total = keys[found + 1].first - first;
+	unsigned long long wanted = total < max ? total : max;
+	while(wanted > 0)
+	{
+		size_t n = wanted < GAMEBASE_WINDOW ? (size_t)wanted : GAMEBASE_WINDOW;
+		const GAMEBASEHIT *window = (const GAMEBASEHIT *)m_hits.Map(m_header.hitTable +
+			first * sizeof(GAMEBASEHIT), n * sizeof(GAMEBASEHIT));
+		if(window == NULL)
+			break;
+		hits.insert(hits.end(), window, window + n);
+		first += n;
+		wanted -= n;
+	}
+	return total;
+}
@@ -0,0 +1,121 @@
+// GameBase.h : binary game database with a position index
+//
+// Like Position.h this file has no MFC dependency. The database is written
+// next to a PGN file as <file>.ncdb and holds, per game, the main line as
+// packed CHESSMOVEs and the header fields in columns, with the names
+// stored once. Every position reached is indexed by its Zobrist key, so
+// the games that reached a position are found without reading any PGN.
+/////////////////////////////////////////////////////////////////////////////
+
+#if !defined(GAMEBASE_H)
+#define GAMEBASE_H
+
+#include <vector>
+
+#include "MappedFile.h"
+#include "Position.h"
+
+//One unsigned int per game each. The first GAMEBASE_NAME_COLUMNS are ids
+//in the name table, 0 being the empty name; a game starting from the
+//standard position has no FEN. The result is a GAMEINDEX_RESULT.
+enum GAMEBASE_COLUMN {COLUMN_WHITE, COLUMN_BLACK, COLUMN_EVENT, COLUMN_SITE,
+			COLUMN_DATE, COLUMN_ROUND, COLUMN_FEN,
+			COLUMN_WHITE_ELO, COLUMN_BLACK_ELO, COLUMN_RESULT, COLUMN_PLIES,
+			GAMEBASE_COLUMNS};
+
+#define GAMEBASE_NAME_COLUMNS	(COLUMN_FEN + 1)
+
+//top bits of a key that pick its bucket in the position index
+#define GAMEBASE_BUCKET_BITS	16
+
+struct GAMEBASEHEADER
+{
+	char magic[4];
+	unsigned int version;
+	unsigned long long sourceSize;
+	long long sourceTime;
+	unsigned int games;
+	unsigned int names;
+	unsigned long long moves;
+	//game and ply entries, and the distinct positions they are under
+	unsigned long long hits;
+	unsigned long long keys;
+	//file offsets of the sections, the moves start after the header
+	unsigned long long columns;
+	unsigned long long starts;
+	unsigned long long nameOffsets;
+	unsigned long long nameText;
+	unsigned long long hitTable;
+	unsigned long long keyTable;
+	unsigned long long buckets;
+};
+
+//a game that reached a position, and the ply before which it was reached
+//first; ply 0 is the start position
+struct GAMEBASEHIT
+{
+	unsigned int game;
+	unsigned int ply;
+};
+
+//called by Build every GAMEBASE_PROGRESS_GAMES games with the games read
+//and how far into the PGN file of size bytes the reader is
+typedef void (*GAMEBASEPROGRESSPROC)(unsigned int games, unsigned long long offset,
+	unsigned long long size, void *param);
+
+#define GAMEBASE_PROGRESS_GAMES	1024
+
+//distinct position, its hits run from first up to the first of the next key
+struct GAMEBASEKEY
+{
+	BITBOARD key;
+	unsigned long long first;
+};
+
+class CGameBase
+{
+private:
+	//columns, moves and names
+	CMappedFile m_file;
+	CMappedFile m_names;
+	//position index
+	CMappedFile m_keys;
+	CMappedFile m_hits;
+	GAMEBASEHEADER m_header;
+	//index of the first key of every bucket, and the key count at the end
+	std::vector<unsigned long long> m_buckets;
+
+public:
+	CGameBase();
+
+	//Opens the database of the PGN file at path, building it when it is
+	//missing or older than the file. The games are numbered as CGameIndex
+	//numbers them.
+	bool Open(const char *path, GAMEBASEPROGRESSPROC proc = NULL, void *param = NULL);
+	//opens a database file on its own
+	bool Load(const char *dbpath);
+	void Close();
+	bool IsOpen() const							{ return m_file.IsOpen(); }
+	unsigned int GetCount() const				{ return IsOpen() ? m_header.games : 0; }
+	unsigned int GetNameCount() const			{ return IsOpen() ? m_header.names : 0; }
+	unsigned long long GetPositionCount() const	{ return IsOpen() ? m_header.keys : 0; }
+
+	unsigned int GetColumn(unsigned int game, int column);
+	//name table entry, valid until the next GetName
+	const char *GetName(unsigned int id);
+	//position before the first move of game
+	bool GetStartPosition(unsigned int game, CPosition &pos);
+	//main line of game, returns the plies written to moves
+	int GetMoves(unsigned int game, CHESSMOVE *moves, int size);
+
+	//Appends to hits the games that reached the position with key, in game
+	//order, at most max of them. Returns the number of games that reached
+	//it, which can be more than were appended.
+	unsigned long long FindPosition(BITBOARD key, std::vector<GAMEBASEHIT> &hits,
+		unsigned int max = 0xffffffff);
+
+	static bool Build(const char *path, const char *dbpath,
+		GAMEBASEPROGRESSPROC proc = NULL, void *param = NULL);
+};
+
+#endif
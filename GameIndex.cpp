@@ -0,0 +1,280 @@
+// GameIndex.cpp : sidecar index of the games in a PGN, FEN or EPD file
+//
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include "GameIndex.h"
+#include "PGNReader.h"
+
+static const char g_indexMagic[4] = {'N', 'C', 'G', 'I'};
+#define GAMEINDEX_VERSION	1
+//entries mapped at a time
+#define GAMEINDEX_WINDOW	4096
+
+bool CGameIndex::GetSourceStamp(const char *path, unsigned long long &size, long long &time)
+{
+#if defined(_WIN32)
+	struct __stat64 st;
+	if(_stat64(path, &st) != 0)
+		return false;
+#else
+	struct stat st;
+	if(stat(path, &st) != 0)
+		return false;
+#endif
+	size = (unsigned long long)st.st_size;
+	time = (long long)st.st_mtime;
+	return true;
+}
+
+//appends str to the string table and returns its offset
+static unsigned int AddString(FILE *fp, unsigned int &size, const char *str, int length)
+{
+	if(str == NULL || length <= 0)
+		return 0;
+	if(length > GAMEINDEX_MAX_STRING)
+		length = GAMEINDEX_MAX_STRING;
+	unsigned int offset = size;
+	fwrite(str, 1, length, fp);
+	fputc('\0', fp);
+	size += length + 1;
+	return offset;
+}
+
+int CGameIndex::ParseResult(const char *text, int length)
+{
+	if(length == 3 && strncmp(text, "1-0", 3) == 0)
+		return RESULT_WHITE_WINS;
+	if(length == 3 && strncmp(text, "0-1", 3) == 0)
+		return RESULT_BLACK_WINS;
+	if(length == 7 && strncmp(text, "1/2-1/2", 7) == 0)
+		return RESULT_DRAW;
+	return RESULT_UNKNOWN;
+}
+
+CGameIndex::CGameIndex()
+{
+	memset(&m_header, 0, sizeof(m_header));
+	m_entries = NULL;
+	m_first = m_inView = 0;
+}
+
+//Entries go straight to the index file, tag values to a scratch file that
+//is appended as the string table, so building takes no memory per game.
+bool CGameIndex::Build(const char *path, const char *indexpath, int format)
+{
+	GAMEINDEXHEADER header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, g_indexMagic, sizeof(header.magic));
+	header.version = GAMEINDEX_VERSION;
+	header.format = format;
+	if(!GetSourceStamp(path, header.sourceSize, header.sourceTime))
+		return false;
+
+	char scratchpath[1024];
+	sprintf(scratchpath, "%.1000s~", indexpath);
+	FILE *fp = fopen(indexpath, "wb");
+	FILE *scratch = fp != NULL ? fopen(scratchpath, "w+b") : NULL;
+	if(scratch == NULL)
+	{
+		if(fp != NULL)
+			fclose(fp);
+		return false;
+	}
+	fwrite(&header, sizeof(header), 1, fp);
+	//offset 0 is the empty string
+	fputc('\0', scratch);
+	unsigned int strings = 1;
+
+	GAMEINDEXENTRY entry;
+	memset(&entry, 0, sizeof(entry));
+	if(format == GAMEINDEX_PGN)
+	{
+		CPGNReader reader;
+		if(!reader.Open(path))
+		{
+			fclose(scratch);
+			fclose(fp);
+			remove(scratchpath);
+			return false;
+		}
+		while(reader.NextGame())
+		{
+			PGNTOKEN token;
+			int type;
+			memset(&entry, 0, sizeof(entry));
+			entry.offset = reader.GetGameOffset();
+			while((type = reader.NextToken(token)) != PGN_END)
+			{
+				if(type != PGN_TAG)
+					continue;
+				if(token.length == 5 && strncmp(token.text, "White", 5) == 0)
+					entry.white = AddString(scratch, strings, token.value, token.valueLength);
+				else if(token.length == 5 && strncmp(token.text, "Black", 5) == 0)
+					entry.black = AddString(scratch, strings, token.value, token.valueLength);
+				else if(token.length == 5 && strncmp(token.text, "Event", 5) == 0)
+					entry.event = AddString(scratch, strings, token.value, token.valueLength);
+				else if(token.length == 4 && strncmp(token.text, "Date", 4) == 0)
+					entry.date = AddString(scratch, strings, token.value, token.valueLength);
+				else if(token.length == 6 && strncmp(token.text, "Result", 6) == 0 && token.value != NULL)
+					entry.result = (unsigned char)ParseResult(token.value, token.valueLength);
+			}
+			entry.length = (unsigned int)reader.GetGameLength();
+			fwrite(&entry, sizeof(entry), 1, fp);
+			header.count++;
+		}
+	}
+	else
+	{
+		//one entry per non-blank line, lines are looked at a window at a time
+		CMappedFile source;
+		if(!source.Open(path))
+		{
+			fclose(scratch);
+			fclose(fp);
+			remove(scratchpath);
+			return false;
+		}
+		unsigned long long offset = 0;
+		while(offset < source.GetSize())
+		{
+			unsigned long long left = source.GetSize() - offset;
+			size_t size = left < PGN_WINDOW ? (size_t)left : PGN_WINDOW;
+			const char *data = source.Map(offset, size);
+			if(data == NULL)
+				break;
+			const char *line = data;
+			const char *end = data + size;
+			for(const char *p = data; p <= end; p++)
+			{
+				if(p < end && *p != '\n')
+					continue;
+				//the last line of a window is only complete at the end of the file
+				if(p == end && size < left)
+					break;
+				const char *last = p;
+				while(last > line && (last[-1] == '\r' || last[-1] == ' ' || last[-1] == '\t'))
+					last--;
+				if(last > line)
+				{
+					entry.offset = offset + (line - data);
+					entry.length = (unsigned int)(last - line);
+					fwrite(&entry, sizeof(entry), 1, fp);
+					header.count++;
+				}
+				line = p + 1;
+			}
+			//a line longer than the window is skipped
+			offset += line > data ? (unsigned long long)(line - data) : size;
+		}
+	}
+
+	header.strings = sizeof(header) + (unsigned long long)header.count * sizeof(GAMEINDEXENTRY);
+	fseek(scratch, 0, SEEK_SET);
+	char buf[65536];
+	size_t n;
+	while((n = fread(buf, 1, sizeof(buf), scratch)) > 0)
+		fwrite(buf, 1, n, fp);
+	fclose(scratch);
+	remove(scratchpath);
+	fseek(fp, 0, SEEK_SET);
+	fwrite(&header, sizeof(header), 1, fp);
+	bool ok = ferror(fp) == 0;
+	if(fclose(fp) != 0)
+		ok = false;
+	if(!ok)
+		remove(indexpath);
+	return ok;
+}
+
+bool CGameIndex::Load(const char *indexpath)
+{
+	m_index.Close();
+	m_strings.Close();
+	m_entries = NULL;
+	m_first = m_inView = 0;
+	if(!m_index.Open(indexpath) || !m_strings.Open(indexpath))
+		return false;
+	const GAMEINDEXHEADER *header = (const GAMEINDEXHEADER *)m_index.Map(0, sizeof(GAMEINDEXHEADER));
+	if(header == NULL || m_index.GetSize() < sizeof(GAMEINDEXHEADER))
+		return false;
+	m_header = *header;
+	if(memcmp(m_header.magic, g_indexMagic, sizeof(m_header.magic)) != 0 ||
+		m_header.version != GAMEINDEX_VERSION || m_header.strings > m_index.GetSize() ||
+		m_header.strings != sizeof(GAMEINDEXHEADER) + (unsigned long long)m_header.count * sizeof(GAMEINDEXENTRY))
+		return false;
+	return true;
+}
+
+bool CGameIndex::Open(const char *path, int format)
+{
+	Close();
+	char indexpath[1024];
+	sprintf(indexpath, "%.1000s.idx", path);
+	unsigned long long size;
+	long long time;
+	if(!GetSourceStamp(path, size, time) || !m_source.Open(path))
+		return false;
+	if(!Load(indexpath) || m_header.sourceSize != size || m_header.sourceTime != time ||
+		(int)m_header.format != format)
+	{
+		m_index.Close();
+		m_strings.Close();
+		if(!Build(path, indexpath, format) || !Load(indexpath))
+		{
+			Close();
+			return false;
+		}
+	}
+	return true;
+}
+
+void CGameIndex::Close()
+{
+	m_source.Close();
+	m_index.Close();
+	m_strings.Close();
+	memset(&m_header, 0, sizeof(m_header));
+	m_entries = NULL;
+	m_first = m_inView = 0;
+}
+
+bool CGameIndex::GetEntry(unsigned int game, GAMEINDEXENTRY &entry)
+{
+	if(!IsOpen() || game >= m_header.count)
+		return false;
+	if(m_entries == NULL || game < m_first || game >= m_first + m_inView)
+	{
+		m_first = game - game % GAMEINDEX_WINDOW;
+		m_inView = m_header.count - m_first < GAMEINDEX_WINDOW ? m_header.count - m_first : GAMEINDEX_WINDOW;
+		m_entries = (const GAMEINDEXENTRY *)m_index.Map(sizeof(GAMEINDEXHEADER) +
+			(unsigned long long)m_first * sizeof(GAMEINDEXENTRY), m_inView * sizeof(GAMEINDEXENTRY));
+		if(m_entries == NULL)
+			return false;
+	}
+	entry = m_entries[game - m_first];
+	return true;
+}
+
+const char *CGameIndex::GetGame(unsigned int game, unsigned int &length)
+{
+	GAMEINDEXENTRY entry;
+	length = 0;
+	if(!GetEntry(game, entry))
+		return NULL;
+	const char *text = m_source.Map(entry.offset, entry.length);
+	if(text != NULL)
+		length = entry.length;
+	return text;
+}
+
+const char *CGameIndex::GetString(unsigned int offset)
+{
+	if(!IsOpen() || offset == 0 || m_header.strings + offset >= m_strings.GetSize())
+		return "";
+	const char *str = m_strings.Map(m_header.strings + offset, GAMEINDEX_MAX_STRING + 1);
+	return str != NULL ? str : "";
+}
@@ -0,0 +1,84 @@
+// GameIndex.h : sidecar index of the games in a PGN, FEN or EPD file
+//
+// Like Position.h this file has no MFC dependency. The index is written
+// next to the file as <file>.idx the first time the file is opened and is
+// rebuilt when the file's size or time changes. Only small views of the
+// index and of the file are mapped, whatever their size.
+/////////////////////////////////////////////////////////////////////////////
+
+#if !defined(GAMEINDEX_H)
+#define GAMEINDEX_H
+
+#include "MappedFile.h"
+
+//PGN games, or one FEN/EPD position per line
+enum GAMEINDEX_FORMAT {GAMEINDEX_PGN, GAMEINDEX_LINES};
+
+enum GAMEINDEX_RESULT {RESULT_UNKNOWN, RESULT_WHITE_WINS, RESULT_BLACK_WINS, RESULT_DRAW};
+
+//tag values longer than this are cut in the index
+#define GAMEINDEX_MAX_STRING	255
+
+struct GAMEINDEXHEADER
+{
+	char magic[4];
+	unsigned int version;
+	unsigned long long sourceSize;
+	long long sourceTime;
+	unsigned int format;
+	unsigned int count;
+	//file offset of the string table, the entries start after the header
+	unsigned long long strings;
+};
+
+struct GAMEINDEXENTRY
+{
+	unsigned long long offset;
+	unsigned int length;
+	//offsets into the string table, 0 is the empty string
+	unsigned int white;
+	unsigned int black;
+	unsigned int event;
+	unsigned int date;
+	unsigned char result;
+	unsigned char reserved[3];
+};
+
+class CGameIndex
+{
+private:
+	CMappedFile m_source;
+	CMappedFile m_index;
+	CMappedFile m_strings;
+	GAMEINDEXHEADER m_header;
+	//entries m_first .. m_first + m_inView - 1 are in view
+	const GAMEINDEXENTRY *m_entries;
+	unsigned int m_first;
+	unsigned int m_inView;
+
+	bool Load(const char *indexpath);
+
+public:
+	CGameIndex();
+
+	//opens path with its index, building the index when it is missing or stale
+	bool Open(const char *path, int format);
+	void Close();
+	bool IsOpen() const							{ return m_source.IsOpen(); }
+	int GetFormat() const						{ return (int)m_header.format; }
+	unsigned int GetCount() const				{ return m_source.IsOpen() ? m_header.count : 0; }
+
+	bool GetEntry(unsigned int game, GAMEINDEXENTRY &entry);
+	//text of the game, valid until the next GetGame
+	const char *GetGame(unsigned int game, unsigned int &length);
+	//string table entry, valid until the next GetString
+	const char *GetString(unsigned int offset);
+
+	static bool Build(const char *path, const char *indexpath, int format);
+	//size and modification time of path, to tell when it changed
+	static bool GetSourceStamp(const char *path, unsigned long long &size, long long &time);
+	//GAMEINDEX_RESULT of a Result tag value
+	static int ParseResult(const char *text, int length);
+};
+
+#endif
@@ -0,0 +1,153 @@
+// GameSearch.cpp : finds the games of a PGN file that reached a position
+//
+// Not part of the NetChess project, build it on its own:
+//   g++ -O2 -o gamesearch GameSearch.cpp GameBase.cpp GameIndex.cpp PGNReader.cpp MappedFile.cpp San.cpp Position.cpp MoveGen.cpp Zobrist.cpp
+//   cl /O2 /EHsc GameSearch.cpp GameBase.cpp GameIndex.cpp PGNReader.cpp MappedFile.cpp San.cpp Position.cpp MoveGen.cpp Zobrist.cpp
+//
+// Usage:
+//   gamesearch [-list n] file.pgn [fen]
+//   gamesearch -bench n file.pgn
+// Opens the <file>.ncdb database of the file, building it first when it is
+// missing or stale, and lists the games that reached the position (the
+// start position by default). -bench looks up n positions taken from the
+// games themselves and reports the average time of a lookup.
+/////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <string>
+
+#include "GameBase.h"
+#include "GameIndex.h"
+
+static unsigned int g_seed = 1;
+
+static unsigned int NextRandom()
+{
+	g_seed = g_seed * 1103515245 + 12345;
+	return (g_seed >> 16) & 0x7fff;
+}
+
+static double Seconds(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static const char *GetResultString(unsigned int result)
+{
+	switch(result)
+	{
+	case RESULT_WHITE_WINS:
+		return "1-0";
+	case RESULT_BLACK_WINS:
+		return "0-1";
+	case RESULT_DRAW:
+		return "1/2-1/2";
+	}
+	return "*";
+}
+
+//key of the position after a random number of moves of a random game
+static bool GetRandomKey(CGameBase &base, BITBOARD &key)
+{
+	CHESSMOVE moves[1024];
+	unsigned int game = (NextRandom() << 15 | NextRandom()) % base.GetCount();
+	CPosition pos;
+	if(!base.GetStartPosition(game, pos))
+		return false;
+	int plies = base.GetMoves(game, moves, 1024);
+	int ply = plies > 0 ? NextRandom() % (plies + 1) : 0;
+	UNDOINFO undo;
+	for(int i = 0; i < ply; i++)
+		pos.MakeMove(moves[i], undo);
+	key = pos.GetKey();
+	return true;
+}
+
+int main(int argc, char *argv[])
+{
+	int list = 20, bench = 0;
+	int arg = 1;
+	for(; arg + 1 < argc && argv[arg][0] == '-'; arg += 2)
+	{
+		if(strcmp(argv[arg], "-list") == 0)
+			list = atoi(argv[arg + 1]);
+		else if(strcmp(argv[arg], "-bench") == 0)
+			bench = atoi(argv[arg + 1]);
+		else
+			break;
+	}
+	if(arg >= argc || argc - arg > 2 || list < 0 || bench < 0)
+	{
+		fprintf(stderr, "usage: gamesearch [-list n] file.pgn [fen]\n");
+		fprintf(stderr, "       gamesearch -bench n file.pgn\n");
+		return 2;
+	}
+	CPosition pos;
+	pos.SetStartPosition();
+	if(arg + 1 < argc && !pos.SetFEN(argv[arg + 1]))
+	{
+		fprintf(stderr, "bad FEN: %s\n", argv[arg + 1]);
+		return 2;
+	}
+
+	CGameBase base;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	if(!base.Open(argv[arg]))
+	{
+		fprintf(stderr, "%s: cannot open or build the database\n", argv[arg]);
+		return 1;
+	}
+	printf("%u games, %llu positions, %u names, opened in %.3f s\n", base.GetCount(),
+		base.GetPositionCount(), base.GetNameCount(), Seconds(start));
+	if(base.GetCount() == 0)
+		return 0;
+
+	if(bench > 0)
+	{
+		std::vector<BITBOARD> keys;
+		for(int i = 0; i < bench; i++)
+		{
+			BITBOARD key;
+			if(GetRandomKey(base, key))
+				keys.push_back(key);
+		}
+		std::vector<GAMEBASEHIT> hits;
+		unsigned long long found = 0, missed = 0;
+		start = std::chrono::steady_clock::now();
+		for(size_t i = 0; i < keys.size(); i++)
+		{
+			hits.clear();
+			unsigned long long n = base.FindPosition(keys[i], hits);
+			found += n;
+			if(n == 0)
+				missed++;
+		}
+		double elapsed = Seconds(start);
+		printf("%u lookups, %.1f games per position, %.3f us per lookup\n", (unsigned int)keys.size(),
+			keys.empty() ? 0.0 : (double)found / keys.size(), keys.empty() ? 0.0 : elapsed * 1e6 / keys.size());
+		if(missed)
+			printf("%llu position(s) were not found\n", missed);
+		return missed ? 1 : 0;
+	}
+
+	std::vector<GAMEBASEHIT> hits;
+	start = std::chrono::steady_clock::now();
+	unsigned long long total = base.FindPosition(pos.GetKey(), hits);
+	double elapsed = Seconds(start);
+	printf("%llu games reached the position, found in %.3f ms\n", total, elapsed * 1e3);
+	for(size_t i = 0; i < hits.size() && (int)i < list; i++)
+	{
+		unsigned int game = hits[i].game;
+		//a name is only valid until the next GetName
+		std::string white = base.GetName(base.GetColumn(game, COLUMN_WHITE));
+		std::string black = base.GetName(base.GetColumn(game, COLUMN_BLACK));
+		std::string event = base.GetName(base.GetColumn(game, COLUMN_EVENT));
+		printf("%7u  ply %-3u %s - %s, %s %s  %s\n", game + 1, hits[i].ply, white.c_str(), black.c_str(),
+			event.c_str(), base.GetName(base.GetColumn(game, COLUMN_DATE)),
+			GetResultString(base.GetColumn(game, COLUMN_RESULT)));
+	}
+	return 0;
+}
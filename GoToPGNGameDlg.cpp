@@ -23,6 +23,9 @@ CGoToPGNGameDlg::CGoToPGNGameDlg(CWnd* pParent /*=NULL*/)
 	m_static_game_number = _T("");
 	m_edit_game_number = 0;
 	//}}AFX_DATA_INIT
+	m_PGNFileIndex = 0;
+	m_PGNIndex = NULL;
+	m_hits = NULL;
 	m_edit_game_number =m_PGNFileIndex;
 }
 
@@ -52,12 +55,26 @@ END_MESSAGE_MAP()
 /////////////////////////////////////////////////////////////////////////////
 // CGoToPGNGameDlg message handlers
 
+CString CGoToPGNGameDlg::GetGame(int index)
+{
+	unsigned int length;
+	if(m_hits != NULL)
+		index = (int)(*m_hits)[index].game;
+	const char *text = m_PGNIndex->GetGame(index,length);
+	return text == NULL ? CString("") : CString(text,length);
+}
+
+int CGoToPGNGameDlg::GetCount()
+{
+	return m_hits != NULL ? (int)m_hits->size() : (int)m_PGNIndex->GetCount();
+}
+
 void CGoToPGNGameDlg::OnButtonFirst() 
 {
 	// TODO: Add your control notification handler code here
 	m_PGNFileIndex = 0;	
-	m_edit_pgn_data = m_PGNFileData.GetAt(m_PGNFileIndex);
-	m_static_game_number.Format("of %d",m_PGNFileData.GetSize());
+	m_edit_pgn_data = GetGame(m_PGNFileIndex);
+	m_static_game_number.Format("of %d",GetCount());
 	m_edit_game_number =m_PGNFileIndex+1;
 	UpdateData(FALSE);
 }
@@ -65,9 +82,9 @@ void CGoToPGNGameDlg::OnButtonFirst()
 void CGoToPGNGameDlg::OnButtonLast() 
 {
 	// TODO: Add your control notification handler code here
-	m_PGNFileIndex = m_PGNFileData.GetSize()-1;
-	m_edit_pgn_data = m_PGNFileData.GetAt(m_PGNFileIndex);
-	m_static_game_number.Format("of %d",m_PGNFileData.GetSize());
+	m_PGNFileIndex = GetCount()-1;
+	m_edit_pgn_data = GetGame(m_PGNFileIndex);
+	m_static_game_number.Format("of %d",GetCount());
 	m_edit_game_number =m_PGNFileIndex+1;
 	UpdateData(FALSE);
 }
@@ -76,11 +93,11 @@ void CGoToPGNGameDlg::OnButtonNext()
 {
 	// TODO: Add your control notification handler code here
 	m_PGNFileIndex++;
-	if(m_PGNFileIndex >= m_PGNFileData.GetSize())
-		m_PGNFileIndex = m_PGNFileData.GetSize()-1;	
+	if(m_PGNFileIndex >= GetCount())
+		m_PGNFileIndex = GetCount()-1;	
 
-	m_edit_pgn_data = m_PGNFileData.GetAt(m_PGNFileIndex);
-	m_static_game_number.Format("of %d",m_PGNFileData.GetSize());
+	m_edit_pgn_data = GetGame(m_PGNFileIndex);
+	m_static_game_number.Format("of %d",GetCount());
 	m_edit_game_number =m_PGNFileIndex+1;
 	UpdateData(FALSE);
 
@@ -92,8 +109,8 @@ void CGoToPGNGameDlg::OnButtonPrev()
 	m_PGNFileIndex--;
 	if(m_PGNFileIndex < 0)
 		m_PGNFileIndex = 0;
-	m_edit_pgn_data = m_PGNFileData.GetAt(m_PGNFileIndex);
-	m_static_game_number.Format("of %d",m_PGNFileData.GetSize());
+	m_edit_pgn_data = GetGame(m_PGNFileIndex);
+	m_static_game_number.Format("of %d",GetCount());
 	m_edit_game_number =m_PGNFileIndex+1;
 	UpdateData(FALSE);	
 }
@@ -105,11 +122,11 @@ BOOL CGoToPGNGameDlg::OnInitDialog()
 	// TODO: Add extra initialization here	
 	if(m_PGNFileIndex < 0)
 		m_PGNFileIndex = 0;
-	if(m_PGNFileIndex >= m_PGNFileData.GetSize())
-		m_PGNFileIndex = m_PGNFileData.GetSize()-1;
+	if(m_PGNFileIndex >= GetCount())
+		m_PGNFileIndex = GetCount()-1;
 	m_edit_game_number =m_PGNFileIndex+1;
-	m_edit_pgn_data = m_PGNFileData.GetAt(m_PGNFileIndex);
-	m_static_game_number.Format("of %d",m_PGNFileData.GetSize());
+	m_edit_pgn_data = GetGame(m_PGNFileIndex);
+	m_static_game_number.Format("of %d",GetCount());
 	UpdateData(FALSE);
 	return TRUE;  // return TRUE unless you set the focus to a control
 	              // EXCEPTION: OCX Property Pages should return FALSE
@@ -124,12 +141,12 @@ BOOL CGoToPGNGameDlg::OnInitDialog()
 	
 	// TODO: Add your control notification handler code here
 	UpdateData(FALSE);
-	if(m_edit_game_number > 0 && m_edit_game_number < m_PGNFileData.GetSize())
+	if(m_edit_game_number > 0 && m_edit_game_number < (int)m_PGNIndex->GetCount())
 	{
 		m_PGNFileIndex = 0;	
 		m_edit_game_number =m_PGNFileIndex+1;
-		m_edit_pgn_data = m_PGNFileData.GetAt(m_PGNFileIndex);
-		m_static_game_number.Format("of %d",m_PGNFileData.GetSize());
+		m_edit_pgn_data = GetGame(m_PGNFileIndex);
+		m_static_game_number.Format("of %d",(int)m_PGNIndex->GetCount());
 	}
 }*/
 
@@ -137,14 +154,14 @@ void CGoToPGNGameDlg::OnButtonGo()
 {
 	// TODO: Add your control notification handler code here	
 	UpdateData(TRUE);
-	if(m_edit_game_number > 0 && m_edit_game_number < m_PGNFileData.GetSize())
+	if(m_edit_game_number > 0 && m_edit_game_number < GetCount())
 	{
 		m_PGNFileIndex = 0;	
 		m_PGNFileIndex = m_edit_game_number-1;
 		if(m_PGNFileIndex < 0)
 			m_PGNFileIndex = 0;
-		m_edit_pgn_data = m_PGNFileData.GetAt(m_PGNFileIndex);
-		m_static_game_number.Format("of %d",m_PGNFileData.GetSize());
+		m_edit_pgn_data = GetGame(m_PGNFileIndex);
+		m_static_game_number.Format("of %d",GetCount());
 		UpdateData(FALSE);
 	}
 }
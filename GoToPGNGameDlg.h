@@ -10,12 +10,17 @@
 /////////////////////////////////////////////////////////////////////////////
 // CGoToPGNGameDlg dialog
 
+#include "GameIndex.h"
+#include "GameBase.h"
+
 class CGoToPGNGameDlg : public CDialog
 {
 // Construction
 public:
 	CGoToPGNGameDlg(CWnd* pParent = NULL);   // standard constructor
-	CStringArray m_PGNFileData;
+	CGameIndex *m_PGNIndex;
+	//when set only these games are browsed and m_PGNFileIndex is an index in it
+	const std::vector<GAMEBASEHIT> *m_hits;
 	int m_PGNFileIndex;
 // Dialog Data
 	//{{AFX_DATA(CGoToPGNGameDlg)
@@ -47,6 +52,8 @@ protected:
 	afx_msg void OnKeyDown(UINT nChar, UINT nRepCnt, UINT nFlags);
 	//}}AFX_MSG
 	DECLARE_MESSAGE_MAP()
+	CString GetGame(int index);
+	int GetCount();
 };
 
 //{{AFX_INSERT_LOCATION}}
@@ -0,0 +1,127 @@
+// GotoBench.cpp : cost of jumping to a ply of a long game
+//
+// Not part of the NetChess project, build it on its own:
+//   g++ -O2 -o gotobench GotoBench.cpp Position.cpp MoveGen.cpp Zobrist.cpp Checkpoint.cpp
+//   cl /O2 /EHsc GotoBench.cpp Position.cpp MoveGen.cpp Zobrist.cpp Checkpoint.cpp
+//
+// Usage:
+//   gotobench [plies] [jumps]
+// Plays a random game of the given length (default 300 plies), then jumps
+// to random plies the way the view used to (take every move back, replay
+// from the start) and from the nearest CCheckpointList snapshot. Only the
+// position work is timed; the view also redrew the board and rebuilt the
+// engine position for every ply it stepped through.
+/////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "MoveGen.h"
+#include "Checkpoint.h"
+
+static unsigned int g_seed = 1;
+
+static unsigned int NextRandom()
+{
+	g_seed = g_seed * 1103515245 + 12345;
+	return (g_seed >> 16) & 0x7fff;
+}
+
+static double ElapsedSeconds(clock_t start)
+{
+	return (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+//random legal moves from the start position until plies are played,
+//starting over when a game ends early
+static void PlayRandomGame(CPosition &pos, CHESSMOVE *moves, UNDOINFO *undo,
+	BITBOARD *keys, CCheckpointList &checkpoints, int plies)
+{
+	for(;;)
+	{
+		pos.SetStartPosition();
+		checkpoints.Clear();
+		int ply;
+		for(ply = 0; ply < plies; ply++)
+		{
+			CMoveList list;
+			if(GenerateLegalMoves(pos, list) == 0)
+				break;
+			keys[ply] = pos.GetKey();
+			checkpoints.Store(ply, pos);
+			moves[ply] = list[NextRandom() % list.GetSize()];
+			pos.MakeMove(moves[ply], undo[ply]);
+		}
+		keys[ply] = pos.GetKey();
+		if(ply == plies)
+			return;
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	int plies = argc >= 2 ? atoi(argv[1]) : 300;
+	int jumps = argc >= 3 ? atoi(argv[2]) : 100000;
+	if(plies <= 0 || jumps <= 0)
+	{
+		fprintf(stderr, "usage: gotobench [plies] [jumps]\n");
+		return 2;
+	}
+	CHESSMOVE *moves = new CHESSMOVE[plies];
+	UNDOINFO *undo = new UNDOINFO[plies];
+	BITBOARD *keys = new BITBOARD[plies + 1];
+	int *targets = new int[jumps];
+	CCheckpointList checkpoints;
+	CPosition pos;
+	PlayRandomGame(pos, moves, undo, keys, checkpoints, plies);
+	for(int i = 0; i < jumps; i++)
+		targets[i] = NextRandom() % (plies + 1);
+
+	//the old GOTO: undo back to the start, then redo up to the target
+	int errors = 0;
+	int current = plies;
+	unsigned long long steps = 0;
+	clock_t start = clock();
+	for(int i = 0; i < jumps; i++)
+	{
+		while(current > 0)
+		{
+			current--;
+			pos.UnmakeMove(moves[current], undo[current]);
+		}
+		for(; current < targets[i]; current++)
+			pos.MakeMove(moves[current], undo[current]);
+		steps += targets[i] + (i == 0 ? plies : targets[i - 1]);
+		if(pos.GetKey() != keys[current])
+			errors++;
+	}
+	double replay = ElapsedSeconds(start);
+
+	//from the nearest checkpoint
+	unsigned long long replayed = 0;
+	start = clock();
+	for(int i = 0; i < jumps; i++)
+	{
+		int ply = checkpoints.Restore(targets[i], pos);
+		replayed += targets[i] - ply;
+		for(; ply < targets[i]; ply++)
+			pos.MakeMove(moves[ply], undo[ply]);
+		if(pos.GetKey() != keys[targets[i]])
+			errors++;
+	}
+	double checkpoint = ElapsedSeconds(start);
+
+	printf("%d plies, %d jumps, checkpoint every %d plies\n", plies, jumps, CHECKPOINT_INTERVAL);
+	printf("undo/redo from start: %6.1f moves, %8.3f us per GOTO\n",
+		(double)steps / jumps, replay * 1e6 / jumps);
+	printf("nearest checkpoint:   %6.1f moves, %8.3f us per GOTO\n",
+		(double)replayed / jumps, checkpoint * 1e6 / jumps);
+	if(errors)
+		printf("%d position(s) did not match\n", errors);
+	delete [] moves;
+	delete [] undo;
+	delete [] keys;
+	delete [] targets;
+	return errors ? 1 : 0;
+}
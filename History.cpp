@@ -1,30 +1,51 @@
 #include "stdafx.h"
 #include "History.h"
+#include "San.h"
 
 #ifdef _DEBUG
 #define new DEBUG_NEW
 #undef THIS_FILE
 static char THIS_FILE[] = __FILE__;
 #endif
+//POSITION_PIECE order, see Position.h
+static const char g_historyPieceIds[] = "PNBRQKpnbrqk";
+static const PIECE_TYPE g_historyPieceTypes[] = {PAWN,KNIGHT,BISHOP,ROOK,QUEEN,KING};
+
+static unsigned char PieceIdToCode(int pieceid)
+{
+	const char *p = pieceid > 0 ? strchr(g_historyPieceIds, pieceid) : NULL;
+	return (unsigned char)(p == NULL ? NO_PIECE : p - g_historyPieceIds);
+}
+
+static void CodeToPiece(int code, int &pieceid, PIECE_TYPE &piece_type, COLOR_TYPE &color_type)
+{
+	if(code == NO_PIECE)
+	{
+		pieceid = -1;
+		piece_type = BLANK;
+		color_type = NONE;
+		return;
+	}
+	pieceid = g_historyPieceIds[code];
+	piece_type = g_historyPieceTypes[PieceType(code)];
+	color_type = PieceSide(code) == SIDE_WHITE ? WHITE : BLACK;
+}
+
 CHistory::CHistory()
 {
-	m_piece_side = BOTTOM;
-	m_from_piece_type = BLANK;
-	m_from_color_type = NONE;
-	m_from_pieceid = -1;
-	m_from_row_id = 0;
-	m_from_col_id = 0;
-	m_to_piece_type = BLANK;
-	m_to_color_type = NONE;
-	m_to_pieceid = -1;
-	m_to_row_id = 0;
-	m_to_col_id = 0;
-	memset(&m_comment,'\0',1024);
+	m_move = NULL_MOVE;
+	m_fromPiece = m_toPiece = NO_PIECE;
+	m_pieceMoveAction = 0;
 	m_halfMoveCount = 0;
+	m_nag = 0;
+	m_comment = m_moveInfo = m_variation = -1;
+	memset(&m_undo,0,sizeof(m_undo));
+	m_key = 0;
 }
 CHistory::~CHistory()
 {
 }
+//rows and columns are board cells with white at the bottom
 void CHistory::SetHistory(
 	 PIECE_SIDE piece_side,
 	 PIECE_TYPE from_piece_type,
@@ -39,21 +60,13 @@ void CHistory::SetHistory(
 	 int to_col_id)
 
 {
-	m_piece_side = piece_side;
-	m_from_piece_type = from_piece_type;
-	m_from_color_type=from_color_type;
-	m_from_pieceid=from_pieceid;
-	m_from_row_id=from_row_id;
-	m_from_col_id=from_col_id;
-	m_to_piece_type=to_piece_type;
-	m_to_color_type=to_color_type;
-	m_to_pieceid=to_pieceid;
-	m_to_row_id=to_row_id;
-	m_to_col_id=to_col_id;
-//	m_specialAction = NOTHING;
-	memset(m_comment,'\0',1024);
-	memset(m_moveInfo,'\0',1024);
+	m_move = EncodeMove(MakeSquare(from_col_id,7-from_row_id),MakeSquare(to_col_id,7-to_row_id));
+	m_fromPiece = PieceIdToCode(from_pieceid);
+	m_toPiece = PieceIdToCode(to_pieceid);
+	m_pieceMoveAction = 0;
+	m_comment = m_moveInfo = m_variation = -1;
 	m_halfMoveCount = 0;
+	m_nag = 0;
 }
 
 void CHistory::GetHistory(
@@ -69,35 +82,38 @@ void CHistory::GetHistory(
 	 int &to_row_id,
 	 int &to_col_id)
 {
-	piece_side = m_piece_side;
-	from_piece_type = m_from_piece_type;
-	from_color_type=m_from_color_type;
-	from_pieceid=m_from_pieceid;
-	from_row_id=m_from_row_id;
-	from_col_id=m_from_col_id;
-	to_piece_type=m_to_piece_type;
-	to_color_type=m_to_color_type;
-	to_pieceid=m_to_pieceid;
-	to_row_id=m_to_row_id;
-	to_col_id=m_to_col_id;
+	piece_side = BOTTOM;
+	CodeToPiece(m_fromPiece,from_pieceid,from_piece_type,from_color_type);
+	from_row_id = 7 - SquareRank(GetMoveFrom(m_move));
+	from_col_id = SquareFile(GetMoveFrom(m_move));
+	CodeToPiece(m_toPiece,to_pieceid,to_piece_type,to_color_type);
+	to_row_id = 7 - SquareRank(GetMoveTo(m_move));
+	to_col_id = SquareFile(GetMoveTo(m_move));
 }
-void CHistory::SetComment(char str[1024])
+//the full move once it is played on CPosition, key is the one before it
+void CHistory::SetMove(CHESSMOVE move, BITBOARD key)
 {
-	memset(m_comment,'\0',1024);
-	memcpy(m_comment,str,1024);
+	m_move = move;
+	m_key = key;
 }
-void CHistory::SetComment(CString& str)
+//applies the entry to pos, a manual edit just sets its square
+void CHistory::Play(CPosition &pos)
 {
-	memset(m_comment,'\0',1024);
-	strcpy_s(m_comment,str.GetBuffer(0));
+	if(IsManualEdit())
+		pos.PutPiece(GetMoveTo(m_move),m_fromPiece);
+	else
+		pos.MakeMove(m_move,m_undo);
 }
-void CHistory::GetComment(CString& cmt)
+void CHistory::TakeBack(CPosition &pos)
 {
-	cmt.Format("%s",m_comment);
+	if(IsManualEdit())
+		pos.PutPiece(GetMoveTo(m_move),m_toPiece);
+	else
+		pos.UnmakeMove(m_move,m_undo);
 }
 void CHistory::SetHalfMoveCount(int cnt)
 {
-	m_halfMoveCount = cnt;
+	m_halfMoveCount = (short)cnt;
 }
 void CHistory::GetHalfMoveCount(int& cnt)
 {
@@ -107,43 +123,9 @@ int CHistory::GetHalfMoveCount()
 {
 	return m_halfMoveCount;
 }
-CString CHistory::GetComment()
-{
-	CString str;
-	str.Format("%s",m_comment);
-	return str;
-}
-void CHistory::SetMoveInfo(char str[1024])
-{
-	memset(m_moveInfo,'\0',1024);
-	memcpy(m_moveInfo,str,1024);
-}
-void CHistory::SetMoveInfo(CString str)
-{
-	memset(m_moveInfo,'\0',1024);
-	memcpy(m_moveInfo,str.GetBuffer(0),str.GetLength());
-}
-void CHistory::GetMoveInfo(CString& info)
-{
-	info.Format("%s",m_moveInfo);
-}
-CString CHistory::GetMoveInfo()
-{
-	CString str;
-	str.Format("%s",m_moveInfo);
-	return str;
-}
-void CHistory::SetSpecialAction(int action)
-{
-	m_specialAction = action;	 
-}
-int CHistory::GetSpecialAction()
-{
-	return m_specialAction;
-}
 void CHistory::SetPieceMoveAction(unsigned int action)
 {
-	m_pieceMoveAction = action;
+	m_pieceMoveAction = (unsigned short)action;
 }
 unsigned int CHistory::GetPieceMoveAction()
 {
@@ -194,6 +176,250 @@ BOOL CHistory::GetCheckFlag()
 }
 COLOR_TYPE CHistory::GetFromPieceColorType()
 {
-	return m_from_color_type;
+	if(m_fromPiece == NO_PIECE)
+		return NONE;
+	return PieceSide(m_fromPiece) == SIDE_WHITE ? WHITE : BLACK;
 }
 
+CGameRecord::CGameRecord()
+{
+	m_entries.SetSize(0,64);
+	m_arena.SetSize(0,1024);
+	m_variations.SetSize(0,64);
+	m_gameComment = -1;
+}
+void CGameRecord::RemoveAll()
+{
+	m_entries.RemoveAll();
+	m_arena.RemoveAll();
+	m_variations.RemoveAll();
+	m_gameComment = -1;
+	m_checkpoints.Clear();
+}
+CHistory& CGameRecord::operator[](int ply)
+{
+	if(ply >= m_entries.GetSize())
+		m_entries.SetSize(ply + 1,64);
+	return m_entries[ply];
+}
+//a string that fits over the old one reuses its place, otherwise it is
+//appended. Empty strings take no space.
+void CGameRecord::SetString(int &offset, const char *str)
+{
+	int len = str == NULL ? 0 : (int)strlen(str);
+	if(len == 0)
+	{
+		offset = -1;
+		return;
+	}
+	if(offset < 0 || (int)strlen(&m_arena[offset]) < len)
+	{
+		offset = (int)m_arena.GetSize();
+		m_arena.SetSize(offset + len + 1,1024);
+	}
+	memcpy(&m_arena[offset],str,len + 1);
+}
+CString CGameRecord::GetString(int offset)
+{
+	if(offset < 0)
+		return CString("");
+	return CString(&m_arena[offset]);
+}
+void CGameRecord::SetComment(int ply, const char *comment)
+{
+	SetString(ply < 0 ? m_gameComment : (*this)[ply].m_comment,comment);
+}
+CString CGameRecord::GetComment(int ply)
+{
+	return GetString(ply < 0 ? m_gameComment : (*this)[ply].m_comment);
+}
+void CGameRecord::SetMoveInfo(int ply, const char *info)
+{
+	SetString((*this)[ply].m_moveInfo,info);
+}
+CString CGameRecord::GetMoveInfo(int ply)
+{
+	return GetString((*this)[ply].m_moveInfo);
+}
+int CGameRecord::GetVariation(int ply)
+{
+	if(ply < 0 || ply >= m_entries.GetSize())
+		return -1;
+	return m_entries[ply].m_variation;
+}
+//links node after the last line in the alternative chain starting at first
+void CGameRecord::AddAlternative(int &first, int node)
+{
+	if(first == -1)
+	{
+		first = node;
+		return;
+	}
+	int k = first;
+	while(m_variations[k].alternative != -1)
+		k = m_variations[k].alternative;
+	m_variations[k].alternative = node;
+}
+//Reads moves, comments and nested variations up to the closing ')' of the
+//line and returns its first node. Move numbers, NAGs and results are
+//skipped. pos is played along the line and taken back before returning.
+int CGameRecord::ParseLine(CPosition &pos, const char *&text, BOOL &ok)
+{
+	CArray<UNDOINFO,UNDOINFO&> undo;
+	CArray<int,int> line;
+	int first = -1;
+	CString comment;
+	while(*text != '\0' && *text != ')')
+	{
+		if(isspace((unsigned char)*text))
+		{
+			text++;
+		}
+		else if(*text == '{' || *text == ';')
+		{
+			char end = *text == '{' ? '}' : '\n';
+			const char *start = ++text;
+			while(*text != '\0' && *text != end)
+				text++;
+			comment = CString(start,(int)(text - start));
+			comment.TrimLeft();
+			comment.TrimRight();
+			if(*text != '\0')
+				text++;
+			//a comment before the first move is kept with that move
+			if(line.GetSize() > 0)
+			{
+				SetString(m_variations[line[line.GetSize()-1]].comment,comment);
+				comment.Empty();
+			}
+		}
+		else if(*text == '(')
+		{
+			text++;
+			if(line.GetSize() == 0)
+			{
+				//nothing to be an alternative to, drop it
+				int depth = 1;
+				for(;*text != '\0' && depth > 0;text++)
+					depth += *text == '(' ? 1 : *text == ')' ? -1 : 0;
+				continue;
+			}
+			int last = line[line.GetSize()-1];
+			pos.UnmakeMove(m_variations[last].move,undo[undo.GetSize()-1]);
+			int node = ParseLine(pos,text,ok);
+			pos.MakeMove(m_variations[last].move,undo[undo.GetSize()-1]);
+			if(*text == ')')
+				text++;
+			if(node != -1)
+				AddAlternative(m_variations[last].alternative,node);
+		}
+		else if(*text == '$' || *text == '!' || *text == '?' || *text == '*' ||
+			(*text >= '0' && *text <= '9' && text[1] != '-'))
+		{
+			//NAG, move number or result
+			text++;
+			while(*text != '\0' && !isspace((unsigned char)*text) && strchr("(){;",*text) == NULL &&
+				!(text[-1] == '.' && *text != '.'))
+				text++;
+		}
+		else
+		{
+			char san[16];
+			int n = 0;
+			for(;*text != '\0' && !isspace((unsigned char)*text) && strchr("(){;",*text) == NULL;text++)
+			{
+				if(n < (int)sizeof(san) - 1)
+					san[n++] = *text;
+			}
+			san[n] = '\0';
+			CHESSMOVE move = n > 0 ? ParseSAN(pos,san) : NULL_MOVE;
+			if(move == NULL_MOVE)
+			{
+				//"1-0", "0-1" and "1/2-1/2" end the line, anything else is an error
+				if(strchr("01",san[0]) == NULL)
+					ok = FALSE;
+				int depth = 0;
+				for(;*text != '\0' && (depth > 0 || *text != ')');text++)
+					depth += *text == '(' ? 1 : *text == ')' ? -1 : 0;
+				break;
+			}
+			VARIATIONMOVE node;
+			node.move = move;
+			node.comment = -1;
+			node.next = node.alternative = -1;
+			SetString(node.comment,comment);
+			comment.Empty();
+			int index = (int)m_variations.Add(node);
+			if(line.GetSize() > 0)
+				m_variations[line[line.GetSize()-1]].next = index;
+			else
+				first = index;
+			line.Add(index);
+			UNDOINFO info;
+			pos.MakeMove(move,info);
+			undo.Add(info);
+		}
+	}
+	for(int i = (int)line.GetSize() - 1;i >= 0;i--)
+		pos.UnmakeMove(m_variations[line[i]].move,undo[i]);
+	return first;
+}
+BOOL CGameRecord::AddVariation(int ply, CPosition &pos, const char *movetext)
+{
+	BOOL ok = TRUE;
+	int node = ParseLine(pos,movetext,ok);
+	if(node != -1)
+		AddAlternative((*this)[ply].m_variation,node);
+	return ok;
+}
+//writes the line starting at node, with the sub-lines of its later moves
+void CGameRecord::WriteLine(CString &str, int node, CPosition &pos)
+{
+	CArray<UNDOINFO,UNDOINFO&> undo;
+	CArray<int,int> line;
+	BOOL number = TRUE;
+	CString text;
+	str += "(";
+	for(int k = node;k != -1;k = m_variations[k].next)
+	{
+		if(pos.GetSide() == SIDE_WHITE)
+			text.Format("%d. ",pos.GetFullMoveNumber());
+		else if(number)
+			text.Format("%d... ",pos.GetFullMoveNumber());
+		else
+			text.Empty();
+		char san[MAX_SAN];
+		FormatSAN(pos,m_variations[k].move,san);
+		str += (k == node ? "" : " ") + text + san;
+		number = FALSE;
+		if(m_variations[k].comment != -1)
+		{
+			str += " {" + GetString(m_variations[k].comment) + "}";
+			number = TRUE;
+		}
+		//the alternatives of the first move are its siblings, written by the caller
+		for(int alt = k == node ? -1 : m_variations[k].alternative;alt != -1;alt = m_variations[alt].alternative)
+		{
+			str += " ";
+			WriteLine(str,alt,pos);
+			number = TRUE;
+		}
+		UNDOINFO info;
+		pos.MakeMove(m_variations[k].move,info);
+		undo.Add(info);
+		line.Add(k);
+	}
+	for(int i = (int)line.GetSize() - 1;i >= 0;i--)
+		pos.UnmakeMove(m_variations[line[i]].move,undo[i]);
+	str += ")";
+}
+CString CGameRecord::GetVariationString(int ply, CPosition &pos)
+{
+	CString str;
+	for(int node = GetVariation(ply);node != -1;node = m_variations[node].alternative)
+	{
+		str += " ";
+		WriteLine(str,node,pos);
+	}
+	return str;
+}
@@ -1,26 +1,43 @@
 #if !defined(HISTORY_H)
 #define HISTORY_H
 
+#include "Checkpoint.h"
+
+//One move of a variation. The moves of a line are chained by next;
+//alternative is the first move of another line played instead of this one,
+//so a line starting here lists its siblings and a later move its sub-lines.
+struct VARIATIONMOVE
+{
+	CHESSMOVE move;
+	int comment;
+	int next;
+	int alternative;
+};
+
+//One ply of the game record. The move is kept as a packed 16 bit CHESSMOVE
+//(from, to, promotion/special flag) next to the UNDOINFO that takes it back
+//on CPosition. The pieces on both squares are stored as POSITION_PIECE codes
+//so GetHistory can still hand out ids, types and colours. A manual edit
+//changes one square, so its from and to squares are the same.
 class CHistory
 {
-private:	 
-	 PIECE_SIDE m_piece_side;
-	 PIECE_TYPE m_from_piece_type;
-	 COLOR_TYPE m_from_color_type;
-	 int m_from_pieceid;
-	 int m_from_row_id;
-	 int m_from_col_id;
-	 char m_comment[1024];
-	 char m_moveInfo[1024];
+private:
+	 CHESSMOVE m_move;
+	 unsigned char m_fromPiece;
+	 unsigned char m_toPiece;
+	 unsigned short m_pieceMoveAction;
+	 short m_halfMoveCount;
+	 //numeric annotation glyph of the move, 0 when there is none
+	 unsigned char m_nag;
+	 //offsets into the CGameRecord string arena, -1 when there is none
+	 int m_comment;
+	 int m_moveInfo;
+	 //first VARIATIONMOVE played instead of this move, -1 when there is none
+	 int m_variation;
+	 UNDOINFO m_undo;
+	 BITBOARD m_key;
 
-	 PIECE_TYPE m_to_piece_type;
-	 COLOR_TYPE m_to_color_type;
-	 int m_to_pieceid;
-	 int m_to_row_id;
-	 int m_to_col_id;
-	 int m_specialAction;
-	 unsigned int m_pieceMoveAction;
-	 int m_halfMoveCount;
+	 friend class CGameRecord;
 
 public:
 	CHistory();
@@ -29,7 +46,7 @@ public:
 	 COLOR_TYPE from_color_type,
 	 int from_pieceid,
 	 int from_row_id,
-	 int from_col_id, 
+	 int from_col_id,
 	 PIECE_TYPE to_piece_type,
 	 COLOR_TYPE to_color_type,
 	 int to_pieceid,
@@ -40,31 +57,28 @@ public:
 	 COLOR_TYPE &from_color_type,
 	 int &from_pieceid,
 	 int &from_row_id,
-	 int &from_col_id, 
+	 int &from_col_id,
 	 PIECE_TYPE &to_piece_type,
 	 COLOR_TYPE &to_color_type,
 	 int &to_pieceid,
 	 int &to_row_id,
-	 int &to_col_id);	 
- 
-	void SetSpecialAction(int act);
-	int GetSpecialAction();
+	 int &to_col_id);
+
+	void SetMove(CHESSMOVE move, BITBOARD key);
+	CHESSMOVE GetMove()						{ return m_move; }
+	UNDOINFO& GetUndoInfo()					{ return m_undo; }
+	BITBOARD GetKey()						{ return m_key; }
+	BOOL IsManualEdit()						{ return GetMoveFrom(m_move) == GetMoveTo(m_move); }
+	void Play(CPosition &pos);
+	void TakeBack(CPosition &pos);
 	void SetPieceMoveAction(unsigned int action);
-	unsigned int GetPieceMoveAction(); 
+	unsigned int GetPieceMoveAction();
 	BOOL GetAmbiguousMoveRankFlag();
 	BOOL GetAmbiguousMoveFileFlag();
 	BOOL GetEnPassentFlag();
 	BOOL GetPromotionFlag();
 	BOOL GetCastlingFlag();
 	BOOL GetCheckFlag();
-	void SetComment(char *);
-	void SetComment(CString&);
-	void GetComment(CString&);
-	CString GetComment();
-	void SetMoveInfo(char*);
-	void SetMoveInfo(CString str);
-	void GetMoveInfo(CString&);
-	CString GetMoveInfo();
 	void SetHalfMoveCount(int);
 	void GetHalfMoveCount(int&);
 	int GetHalfMoveCount();
@@ -73,4 +87,55 @@ public:
 
 protected:
 };
-#endif
\ No newline at end of file
+
+//Growable list of CHistory entries. Comments and move info are rare and
+//short, so they live in one character arena and an entry only holds an
+//offset into it. Variations hang off the main line as VARIATIONMOVE nodes
+//in a second arena; they are walked with MakeMove/UnmakeMove on one
+//CPosition rather than by copying boards.
+class CGameRecord
+{
+private:
+	CArray<CHistory,CHistory&> m_entries;
+	CArray<char,char> m_arena;
+	CArray<VARIATIONMOVE,VARIATIONMOVE&> m_variations;
+	int m_gameComment;
+	CCheckpointList m_checkpoints;
+
+	void SetString(int &offset, const char *str);
+	CString GetString(int offset);
+	int ParseLine(CPosition &pos, const char *&text, BOOL &ok);
+	void AddAlternative(int &first, int node);
+	void WriteLine(CString &str, int node, CPosition &pos);
+
+public:
+	CGameRecord();
+	void RemoveAll();
+	int GetSize()							{ return (int)m_entries.GetSize(); }
+	//grows the record when ply is past the end
+	CHistory& operator[](int ply);
+
+	//ply -1 is the comment before the first move
+	void SetComment(int ply, const char *comment);
+	CString GetComment(int ply);
+	void SetMoveInfo(int ply, const char *info);
+	CString GetMoveInfo(int ply);
+	//NAG of the move at ply ($1 to $255), 0 for none
+	void SetNAG(int ply, int nag)			{ (*this)[ply].m_nag = (unsigned char)nag; }
+	int GetNAG(int ply)						{ return (*this)[ply].m_nag; }
+
+	//pos is the position before the move at ply and is left as it was.
+	//movetext is the inside of a PGN "( ... )"; FALSE when a move could not
+	//be resolved, the moves before it are kept.
+	BOOL AddVariation(int ply, CPosition &pos, const char *movetext);
+	//every variation at ply as PGN, " (12... Nf6 13. Bd3 {...} (13. Be2) Bd7)"
+	CString GetVariationString(int ply, CPosition &pos);
+	int GetVariation(int ply);
+	const VARIATIONMOVE& GetVariationMove(int node)	{ return m_variations[node]; }
+	CString GetVariationComment(int node)			{ return GetString(m_variations[node].comment); }
+
+	//position before the move at ply, see CCheckpointList
+	void StorePosition(int ply, const CPosition &pos)	{ m_checkpoints.Store(ply,pos); }
+	int RestorePosition(int ply, CPosition &pos)		{ return m_checkpoints.Restore(ply,pos); }
+};
+#endif
@@ -25,7 +25,7 @@ CHistoryDlg::CHistoryDlg(CWnd* pParent /*=NULL*/)
 	//}}AFX_DATA_INIT
 }
 
-CHistoryDlg::CHistoryDlg(CWnd* pParent /*=NULL*/,CHistory *history,int historycount)
+CHistoryDlg::CHistoryDlg(CWnd* pParent /*=NULL*/,CGameRecord *history,int historycount)
 	: CDialog(CHistoryDlg::IDD, pParent)
 { 
 	m_edit_history = _T(""); 
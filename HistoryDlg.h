@@ -13,11 +13,11 @@
 class CHistoryDlg : public CDialog
 {
 // Construction
-	CHistory *m_History;
+	CGameRecord *m_History;
 	int m_iHistory;
 public:
 	CHistoryDlg(CWnd* pParent = NULL);   // standard constructor
-	CHistoryDlg(CWnd* pParent,CHistory*,int );   // standard constructor
+	CHistoryDlg(CWnd* pParent,CGameRecord*,int );   // standard constructor
 
 // Dialog Data
 	//{{AFX_DATA(CHistoryDlg)
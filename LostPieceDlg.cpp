@@ -82,18 +82,18 @@ void CLostPieceDlg::OnPaint()
 		int to_pieceid;
 		int to_row_id;
 		int to_col_id;
-		m_History[i].GetHistory(
+		(*m_History)[i].GetHistory(
 			piece_side,
 			from_piece_type, from_color_type,from_pieceid,
 			from_row_id,from_col_id, to_piece_type,
 			to_color_type,to_pieceid,to_row_id,
 			to_col_id);
 		//if(to_pieceid > 0 || m_History[i].GetSpecialAction() == ENPASSENT)
-		if(to_pieceid > 0 || m_History[i].GetEnPassentFlag() == TRUE)
+		if(to_pieceid > 0 || (*m_History)[i].GetEnPassentFlag() == TRUE)
 		{
 			CStatic *wnd=NULL;
 			//if(m_History[i].GetSpecialAction() == ENPASSENT)
-			if(m_History[i].GetEnPassentFlag() == TRUE)
+			if((*m_History)[i].GetEnPassentFlag() == TRUE)
 			{			 
 				to_pieceid = from_color_type == WHITE ? PAWN_BLACK: PAWN_WHITE;
 				to_color_type = from_color_type == WHITE ? BLACK: WHITE;
@@ -121,7 +121,7 @@ void CLostPieceDlg::OnPaint()
 	
 	// Do not call CDialog::OnPaint() for painting messages
 }
-void CLostPieceDlg::SetHistory(CHistory *history,int hcount)
+void CLostPieceDlg::SetHistory(CGameRecord *history,int hcount)
 {
 	m_History = history;
 	m_iHistory = hcount;
@@ -17,9 +17,9 @@ public:
 	CLostPieceDlg(CWnd* pParent = NULL);   // standard constructor
 	int m_whitePieces[16];
 	int m_blackPieces[16];
-	CHistory *m_History;
+	CGameRecord *m_History;
 	int m_iHistory;
-	void SetHistory(CHistory *history,int hcount);
+	void SetHistory(CGameRecord *history,int hcount);
 // Dialog Data
 	//{{AFX_DATA(CLostPieceDlg)
 	enum { IDD = IDD_DIALOG_LOST_PIECE };
@@ -0,0 +1,139 @@
+// MappedFile.cpp : read-only memory mapping of a file
+//
+
+#include "MappedFile.h"
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+CMappedFile::CMappedFile()
+{
+#if defined(_WIN32)
+	m_file = INVALID_HANDLE_VALUE;
+	m_mapping = NULL;
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	m_granularity = info.dwAllocationGranularity;
+#else
+	m_file = -1;
+	m_granularity = (size_t)sysconf(_SC_PAGESIZE);
+#endif
+	m_size = 0;
+	m_view = NULL;
+	m_viewSize = 0;
+}
+
+CMappedFile::~CMappedFile()
+{
+	Close();
+}
+
+bool CMappedFile::Open(const char *path)
+{
+	Close();
+#if defined(_WIN32)
+	m_file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+		FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if(m_file == INVALID_HANDLE_VALUE)
+		return false;
+	LARGE_INTEGER size;
+	if(!GetFileSizeEx(m_file, &size))
+	{
+		Close();
+		return false;
+	}
+	m_size = (unsigned long long)size.QuadPart;
+	//an empty file cannot be mapped, it is open with nothing to view
+	if(m_size > 0)
+	{
+		m_mapping = CreateFileMappingA(m_file, NULL, PAGE_READONLY, 0, 0, NULL);
+		if(m_mapping == NULL)
+		{
+			Close();
+			return false;
+		}
+	}
+#else
+	m_file = open(path, O_RDONLY);
+	if(m_file < 0)
+		return false;
+	struct stat st;
+	if(fstat(m_file, &st) != 0)
+	{
+		Close();
+		return false;
+	}
+	m_size = (unsigned long long)st.st_size;
+#endif
+	return true;
+}
+
+bool CMappedFile::IsOpen() const
+{
+#if defined(_WIN32)
+	return m_file != INVALID_HANDLE_VALUE;
+#else
+	return m_file >= 0;
+#endif
+}
+
+void CMappedFile::Unmap()
+{
+	if(m_view == NULL)
+		return;
+#if defined(_WIN32)
+	UnmapViewOfFile(m_view);
+#else
+	munmap(m_view, m_viewSize);
+#endif
+	m_view = NULL;
+	m_viewSize = 0;
+}
+
+void CMappedFile::Close()
+{
+	Unmap();
+#if defined(_WIN32)
+	if(m_mapping != NULL)
+		CloseHandle(m_mapping);
+	if(m_file != INVALID_HANDLE_VALUE)
+		CloseHandle(m_file);
+	m_mapping = NULL;
+	m_file = INVALID_HANDLE_VALUE;
+#else
+	if(m_file >= 0)
+		close(m_file);
+	m_file = -1;
+#endif
+	m_size = 0;
+}
+
+const char *CMappedFile::Map(unsigned long long offset, size_t length)
+{
+	Unmap();
+	if(!IsOpen() || offset >= m_size)
+		return NULL;
+	//views start on a multiple of the allocation granularity
+	unsigned long long start = offset - offset % m_granularity;
+	unsigned long long end = offset + length;
+	if(end > m_size || end < offset)
+		end = m_size;
+	size_t size = (size_t)(end - start);
+#if defined(_WIN32)
+	m_view = MapViewOfFile(m_mapping, FILE_MAP_READ, (DWORD)(start >> 32), (DWORD)start, size);
+#else
+	m_view = mmap(NULL, size, PROT_READ, MAP_PRIVATE, m_file, (off_t)start);
+	if(m_view == MAP_FAILED)
+		m_view = NULL;
+	else
+		madvise(m_view, size, MADV_SEQUENTIAL);
+#endif
+	if(m_view == NULL)
+		return NULL;
+	m_viewSize = size;
+	return (const char *)m_view + (size_t)(offset - start);
+}
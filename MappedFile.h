@@ -0,0 +1,51 @@
+// MappedFile.h : read-only memory mapping of a file
+//
+// Like Position.h this file has no MFC dependency. The build is 32 bit, so
+// a large file is looked at through a view of part of it at a time.
+/////////////////////////////////////////////////////////////////////////////
+
+#if !defined(MAPPEDFILE_H)
+#define MAPPEDFILE_H
+
+#include <stddef.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#endif
+
+class CMappedFile
+{
+private:
+#if defined(_WIN32)
+	HANDLE m_file;
+	HANDLE m_mapping;
+#else
+	int m_file;
+#endif
+	unsigned long long m_size;
+	void *m_view;
+	size_t m_viewSize;
+	size_t m_granularity;
+
+	void Unmap();
+
+public:
+	CMappedFile();
+	~CMappedFile();
+
+	bool Open(const char *path);
+	void Close();
+	bool IsOpen() const;
+	unsigned long long GetSize() const		{ return m_size; }
+
+	//Maps length bytes from offset (less at the end of the file) and
+	//returns the byte at offset, NULL on failure. The previous view is
+	//released, so pointers into it are no longer valid.
+	const char *Map(unsigned long long offset, size_t length);
+
+private:
+	CMappedFile(const CMappedFile &);
+	CMappedFile& operator=(const CMappedFile &);
+};
+
+#endif
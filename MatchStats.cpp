@@ -0,0 +1,196 @@
+// MatchStats.cpp : Elo, likelihood of superiority and SPRT of a match
+//
+
+#include <math.h>
+#include <stdio.h>
+
+#include "MatchStats.h"
+
+//standard normal quantile of 97.5%, for a 95% interval
+#define NORMAL_QUANTILE_95		1.959964
+//Count given to every result for the SPRT while one has not occurred yet,
+//so a few one-sided games (no variance) do not decide the test at once.
+#define SPRT_EMPTY_BIN			0.001
+//samples before the SPRT may stop, the normal approximation needs a few
+#define SPRT_MIN_SAMPLES		20
+//scores are kept this far from 0 and 1, where the Elo difference is
+//infinite, which bounds it at about 1200
+#define ELO_SCORE_EPSILON		0.001
+
+CMatchStats::CMatchStats()
+{
+	Reset();
+	SetSPRT(SPRT_DEFAULT_ELO0, SPRT_DEFAULT_ELO1, SPRT_DEFAULT_ALPHA, SPRT_DEFAULT_BETA);
+}
+
+void CMatchStats::Reset()
+{
+	m_wins = m_draws = m_losses = 0;
+	for(int i = 0; i < 5; i++)
+		m_pairs[i] = 0;
+	m_pending = -1;
+}
+
+void CMatchStats::SetSPRT(double elo0, double elo1, double alpha, double beta)
+{
+	m_elo0 = elo0;
+	m_elo1 = elo1;
+	m_alpha = alpha;
+	m_beta = beta;
+}
+
+void CMatchStats::AddGame(int halfPoints, bool paired)
+{
+	if(halfPoints == 2)
+		m_wins++;
+	else if(halfPoints == 1)
+		m_draws++;
+	else
+		m_losses++;
+	if(!paired)
+		return;
+	if(m_pending < 0)
+		m_pending = halfPoints;
+	else
+	{
+		m_pairs[m_pending + halfPoints]++;
+		m_pending = -1;
+	}
+}
+
+void CMatchStats::AddPair(int first, int second)
+{
+	int pending = m_pending;
+	m_pending = -1;
+	AddGame(first);
+	AddGame(second);
+	m_pending = pending;
+}
+
+int CMatchStats::GetMoments(double &mean, double &variance, bool regularize) const
+{
+	//samples by score per game: pairs, or single games when there are none
+	int counts[5];
+	int bins = 5, count = 0;
+	for(int i = 0; i < 5; i++)
+		count += counts[i] = m_pairs[i];
+	if(count == 0)
+	{
+		bins = 3;
+		counts[0] = m_losses;
+		counts[1] = m_draws;
+		counts[2] = m_wins;
+		count = GetGames();
+	}
+	if(count == 0)
+	{
+		mean = 0.5;
+		variance = 0;
+		return 0;
+	}
+	double extra = 0;
+	if(regularize)
+	{
+		for(int i = 0; i < bins; i++)
+		{
+			if(counts[i] == 0)
+				extra = SPRT_EMPTY_BIN;
+		}
+	}
+	double total = 0, sum = 0, squares = 0;
+	for(int i = 0; i < bins; i++)
+	{
+		double score = (double)i / (bins - 1);
+		total += counts[i] + extra;
+		sum += (counts[i] + extra) * score;
+		squares += (counts[i] + extra) * score * score;
+	}
+	mean = sum / total;
+	variance = squares / total - mean * mean;
+	if(variance < 0)
+		variance = 0;
+	return count;
+}
+
+double CMatchStats::ScoreToElo(double score)
+{
+	if(score < ELO_SCORE_EPSILON)
+		score = ELO_SCORE_EPSILON;
+	else if(score > 1 - ELO_SCORE_EPSILON)
+		score = 1 - ELO_SCORE_EPSILON;
+	return 400 * log10(score / (1 - score));
+}
+
+double CMatchStats::EloToScore(double elo)
+{
+	return 1 / (1 + pow(10.0, -elo / 400));
+}
+
+double CMatchStats::GetElo(double &lower, double &upper) const
+{
+	double mean, variance;
+	int count = GetMoments(mean, variance, false);
+	double margin = count > 0 ? NORMAL_QUANTILE_95 * sqrt(variance / count) : 0;
+	lower = ScoreToElo(mean > margin ? mean - margin : 0);
+	upper = ScoreToElo(mean + margin < 1 ? mean + margin : 1);
+	return ScoreToElo(mean);
+}
+
+double CMatchStats::GetLOS() const
+{
+	if(m_wins + m_losses == 0)
+		return 0.5;
+	return 0.5 * (1 + erf((m_wins - m_losses) / sqrt(2.0 * (m_wins + m_losses))));
+}
+
+double CMatchStats::GetLLR() const
+{
+	double mean, variance;
+	int count = GetMoments(mean, variance, true);
+	if(count == 0 || variance == 0)
+		return 0;
+	double score0 = EloToScore(m_elo0), score1 = EloToScore(m_elo1);
+	return count * (score1 - score0) * (2 * mean - score0 - score1) / (2 * variance);
+}
+
+double CMatchStats::GetLowerBound() const
+{
+	return log(m_beta / (1 - m_alpha));
+}
+
+double CMatchStats::GetUpperBound() const
+{
+	return log((1 - m_beta) / m_alpha);
+}
+
+int CMatchStats::GetSPRTResult() const
+{
+	double mean, variance;
+	if(GetMoments(mean, variance, false) < SPRT_MIN_SAMPLES)
+		return SPRT_CONTINUE;
+	double llr = GetLLR();
+	if(llr >= GetUpperBound())
+		return SPRT_ACCEPT_H1;
+	if(llr <= GetLowerBound())
+		return SPRT_ACCEPT_H0;
+	return SPRT_CONTINUE;
+}
+
+std::string CMatchStats::Format() const
+{
+	char buf[512];
+	int games = GetGames();
+	double lower, upper;
+	double elo = GetElo(lower, upper);
+	int n = sprintf(buf, "Games %d: +%d -%d =%d, %.1f%%\n", games, m_wins, m_losses, m_draws,
+		games > 0 ? (m_wins + m_draws / 2.0) * 100 / games : 0.0);
+	if(m_pairs[0] + m_pairs[1] + m_pairs[2] + m_pairs[3] + m_pairs[4] > 0)
+		n += sprintf(buf + n, "Pairs 0-2 points: %d %d %d %d %d\n", m_pairs[0], m_pairs[1],
+			m_pairs[2], m_pairs[3], m_pairs[4]);
+	n += sprintf(buf + n, "Elo %+.1f [%+.1f, %+.1f], LOS %.1f%%\n", elo, lower, upper, GetLOS() * 100);
+	int result = GetSPRTResult();
+	sprintf(buf + n, "SPRT [%g, %g]: LLR %.2f [%.2f, %.2f], %s", m_elo0, m_elo1, GetLLR(),
+		GetLowerBound(), GetUpperBound(),
+		result == SPRT_ACCEPT_H1 ? "H1 accepted" : result == SPRT_ACCEPT_H0 ? "H0 accepted" : "continue");
+	return buf;
+}
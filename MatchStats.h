@@ -0,0 +1,78 @@
+// MatchStats.h : Elo, likelihood of superiority and SPRT of a match
+//
+// Like Position.h this file has no MFC dependency. Results are counted from
+// the first engine's side. Games played in pairs (the same opening with the
+// colours reversed) are counted by the score of the pair, the pentanomial
+// model, whose variance leaves out what the opening alone decides; when
+// there are no pairs single games are used. The SPRT uses the normal
+// approximation of the log-likelihood ratio of the scores of elo0 and elo1.
+/////////////////////////////////////////////////////////////////////////////
+
+#if !defined(MATCHSTATS_H)
+#define MATCHSTATS_H
+
+#include <string>
+
+enum SPRT_RESULT {SPRT_CONTINUE, SPRT_ACCEPT_H0, SPRT_ACCEPT_H1};
+
+//the test run when no other is set: does the first engine gain 5 Elo?
+#define SPRT_DEFAULT_ELO0		0.0
+#define SPRT_DEFAULT_ELO1		5.0
+#define SPRT_DEFAULT_ALPHA		0.05
+#define SPRT_DEFAULT_BETA		0.05
+
+class CMatchStats
+{
+private:
+	int m_wins;
+	int m_draws;
+	int m_losses;
+	//pairs scoring 0, 1/2, 1, 3/2 and 2 points
+	int m_pairs[5];
+	//half points of a game AddGame has not paired yet, -1 when none
+	int m_pending;
+	double m_elo0;
+	double m_elo1;
+	double m_alpha;
+	double m_beta;
+
+	//Mean score per game and its variance per sample (pair or game),
+	//returns the number of samples.
+	int GetMoments(double &mean, double &variance, bool regularize) const;
+
+public:
+	CMatchStats();
+
+	void Reset();
+	//The tested hypotheses, H0: the first engine is elo0 stronger, H1: it
+	//is elo1 stronger, and the error rates of accepting the wrong one.
+	void SetSPRT(double elo0, double elo1, double alpha, double beta);
+	//A game scoring halfPoints (0, 1 or 2) for the first engine. Every
+	//second paired game is paired with the one before it; games not played
+	//as the two colours of one opening are added with paired false.
+	void AddGame(int halfPoints, bool paired = true);
+	//both games of a pair, for results that do not arrive in order
+	void AddPair(int first, int second);
+
+	int GetGames() const							{ return m_wins + m_draws + m_losses; }
+	int GetWins() const								{ return m_wins; }
+	int GetDraws() const							{ return m_draws; }
+	int GetLosses() const							{ return m_losses; }
+	int GetPairs(int halfPoints) const				{ return m_pairs[halfPoints]; }
+	//Elo difference of the score, and the 95% confidence interval
+	double GetElo(double &lower, double &upper) const;
+	//probability that the first engine is the stronger, from wins and losses
+	double GetLOS() const;
+	double GetLLR() const;
+	double GetLowerBound() const;
+	double GetUpperBound() const;
+	int GetSPRTResult() const;
+	//a few lines for a message box or a console
+	std::string Format() const;
+
+	//the Elo difference of a score, finite for a score of 0 or 1, and back
+	static double ScoreToElo(double score);
+	static double EloToScore(double elo);
+};
+
+#endif
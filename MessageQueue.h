@@ -0,0 +1,75 @@
+// MessageQueue.h : lock-free queue from one thread to another
+//
+// Like Position.h this file has no MFC dependency. One thread pushes and
+// one other thread pops; neither waits for the other. Items are swapped in
+// and out rather than copied, so strings in them keep their storage as
+// they go round the ring.
+/////////////////////////////////////////////////////////////////////////////
+
+#if !defined(MESSAGEQUEUE_H)
+#define MESSAGEQUEUE_H
+
+#include <stddef.h>
+#include <algorithm>
+#include <atomic>
+
+//size must be a power of 2
+template<class T, size_t size>
+class CMessageQueue
+{
+private:
+	T m_items[size];
+	//items pushed and popped so far, each written by one side only and
+	//kept on its own cache line
+	char m_pad1[64];
+	std::atomic<size_t> m_pushed;
+	char m_pad2[64];
+	std::atomic<size_t> m_popped;
+	char m_pad3[64];
+
+public:
+	CMessageQueue()
+	{
+		m_pushed.store(0);
+		m_popped.store(0);
+	}
+
+	//Producer: swaps item into the queue, false when it is full.
+	bool Push(T &item)
+	{
+		size_t pushed = m_pushed.load(std::memory_order_relaxed);
+		if(pushed - m_popped.load(std::memory_order_acquire) == size)
+			return false;
+		std::swap(m_items[pushed & (size - 1)], item);
+		m_pushed.store(pushed + 1, std::memory_order_release);
+		return true;
+	}
+
+	//Consumer: swaps the oldest item out into item, false when it is empty.
+	bool Pop(T &item)
+	{
+		size_t popped = m_popped.load(std::memory_order_relaxed);
+		if(popped == m_pushed.load(std::memory_order_acquire))
+			return false;
+		std::swap(item, m_items[popped & (size - 1)]);
+		m_popped.store(popped + 1, std::memory_order_release);
+		return true;
+	}
+
+	bool IsEmpty() const
+	{
+		return m_popped.load(std::memory_order_acquire) == m_pushed.load(std::memory_order_acquire);
+	}
+
+	//Consumer: drops everything pushed so far.
+	void Clear()
+	{
+		m_popped.store(m_pushed.load(std::memory_order_acquire), std::memory_order_release);
+	}
+
+private:
+	CMessageQueue(const CMessageQueue &);
+	CMessageQueue& operator=(const CMessageQueue &);
+};
+
+#endif
@@ -0,0 +1,168 @@
+// MoveGen.cpp : legal move generation for CPosition
+//
+
+#include "MoveGen.h"
+
+bool CMoveList::Contains(CHESSMOVE move) const
+{
+	for(int i = 0; i < m_count; i++)
+	{
+		if(m_moves[i] == move)
+			return true;
+	}
+	return false;
+}
+
+static void AddMoves(CMoveList &list, int from, BITBOARD targets)
+{
+	while(targets)
+		list.Add(EncodeMove(from, PopFirstSquare(targets)));
+}
+
+static void AddPawnMoves(CMoveList &list, int from, int to, int lastrank)
+{
+	if(SquareRank(to) == lastrank)
+	{
+		list.Add(EncodeMove(from, to, MOVEFLAG_PROMOTE_QUEEN));
+		list.Add(EncodeMove(from, to, MOVEFLAG_PROMOTE_ROOK));
+		list.Add(EncodeMove(from, to, MOVEFLAG_PROMOTE_BISHOP));
+		list.Add(EncodeMove(from, to, MOVEFLAG_PROMOTE_KNIGHT));
+	}
+	else
+	{
+		list.Add(EncodeMove(from, to));
+	}
+}
+
+//own pieces that are the only blocker between our king and an enemy slider
+static BITBOARD GetPinnedPieces(const CPosition &pos, int side, int king)
+{
+	int enemy = side ^ 1;
+	BITBOARD pinned = 0;
+	BITBOARD queens = pos.GetPieces(enemy, PT_QUEEN);
+	BITBOARD snipers = (CPosition::RookAttacks(king, 0) & (pos.GetPieces(enemy, PT_ROOK) | queens)) |
+		(CPosition::BishopAttacks(king, 0) & (pos.GetPieces(enemy, PT_BISHOP) | queens));
+	while(snipers)
+	{
+		BITBOARD blockers = CPosition::Between(king, PopFirstSquare(snipers)) & pos.GetOccupied();
+		if(blockers && (blockers & (blockers - 1)) == 0)
+			pinned |= blockers & pos.GetOccupied(side);
+	}
+	return pinned;
+}
+
+static void GenerateCastling(const CPosition &pos, CMoveList &list, int side)
+{
+	int home = side == SIDE_WHITE ? 4 : 60;
+	int enemy = side ^ 1;
+	int rook = MakePiece(side, PT_ROOK);
+	int kingside = side == SIDE_WHITE ? CASTLE_WHITE_KING : CASTLE_BLACK_KING;
+	int queenside = side == SIDE_WHITE ? CASTLE_WHITE_QUEEN : CASTLE_BLACK_QUEEN;
+	if(pos.GetPiece(home) != MakePiece(side, PT_KING))
+		return;
+	if((pos.GetCastling() & kingside) && pos.GetPiece(home + 3) == rook &&
+		(CPosition::Between(home, home + 3) & pos.GetOccupied()) == 0 &&
+		!pos.IsSquareAttacked(home + 1, enemy))
+	{
+		list.Add(EncodeMove(home, home + 2, MOVEFLAG_CASTLE));
+	}
+	if((pos.GetCastling() & queenside) && pos.GetPiece(home - 4) == rook &&
+		(CPosition::Between(home, home - 4) & pos.GetOccupied()) == 0 &&
+		!pos.IsSquareAttacked(home - 1, enemy))
+	{
+		list.Add(EncodeMove(home, home - 2, MOVEFLAG_CASTLE));
+	}
+}
+
+//Fills list with the legal moves of the side to move and returns the count.
+//Only moves that can expose the king (king moves, en passant, pinned
+//pieces, evasions) are verified by making them.
+int GenerateLegalMoves(CPosition &pos, CMoveList &list)
+{
+	list.Clear();
+	int side = pos.GetSide();
+	int enemy = side ^ 1;
+	BITBOARD all = pos.GetOccupied();
+	BITBOARD targets = ~pos.GetOccupied(side) & ~pos.GetPieces(enemy, PT_KING);
+	BITBOARD enemies = pos.GetOccupied(enemy) & targets;
+	int king = pos.GetKingSquare(side);
+	bool incheck = king != NO_SQUARE && pos.IsSquareAttacked(king, enemy);
+	BITBOARD pinned = king != NO_SQUARE ? GetPinnedPieces(pos, side, king) : 0;
+
+	int forward = side == SIDE_WHITE ? 8 : -8;
+	int startrank = side == SIDE_WHITE ? 1 : 6;
+	int lastrank = side == SIDE_WHITE ? 7 : 0;
+	int ep = pos.GetEpSquare();
+	BITBOARD pieces = pos.GetPieces(side, PT_PAWN);
+	while(pieces)
+	{
+		int from = PopFirstSquare(pieces);
+		int to = from + forward;
+		if(to >= 0 && to < 64 && (all & SquareBit(to)) == 0)
+		{
+			AddPawnMoves(list, from, to, lastrank);
+			if(SquareRank(from) == startrank && (all & SquareBit(to + forward)) == 0)
+				list.Add(EncodeMove(from, to + forward, MOVEFLAG_DOUBLEPUSH));
+		}
+		BITBOARD attacks = CPosition::PawnAttacks(side, from);
+		BITBOARD captures = attacks & enemies;
+		while(captures)
+			AddPawnMoves(list, from, PopFirstSquare(captures), lastrank);
+		if(ep != NO_SQUARE && (attacks & SquareBit(ep)) && (all & SquareBit(ep)) == 0 &&
+			pos.GetPiece(ep - forward) == MakePiece(enemy, PT_PAWN))
+		{
+			list.Add(EncodeMove(from, ep, MOVEFLAG_ENPASSANT));
+		}
+	}
+	for(int type = PT_KNIGHT; type <= PT_KING; type++)
+	{
+		int piece = MakePiece(side, type);
+		pieces = pos.GetPieces(piece);
+		while(pieces)
+		{
+			int from = PopFirstSquare(pieces);
+			AddMoves(list, from, pos.GetPieceAttacks(piece, from) & targets);
+		}
+	}
+	if(!incheck)
+		GenerateCastling(pos, list, side);
+
+	int count = 0;
+	for(int i = 0; i < list.m_count; i++)
+	{
+		CHESSMOVE move = list.m_moves[i];
+		int from = GetMoveFrom(move);
+		if(incheck || from == king || GetMoveFlag(move) == MOVEFLAG_ENPASSANT || (pinned & SquareBit(from)))
+		{
+			UNDOINFO undo;
+			pos.MakeMove(move, undo);
+			bool legal = !pos.IsInCheck(side);
+			pos.UnmakeMove(move, undo);
+			if(!legal)
+				continue;
+		}
+		list.m_moves[count++] = move;
+	}
+	list.m_count = count;
+	return count;
+}
+
+//number of leaf nodes of the legal move tree, depth plies deep
+unsigned long long Perft(CPosition &pos, int depth)
+{
+	if(depth <= 0)
+		return 1;
+	CMoveList list;
+	GenerateLegalMoves(pos, list);
+	if(depth == 1)
+		return list.m_count;
+	unsigned long long nodes = 0;
+	for(int i = 0; i < list.m_count; i++)
+	{
+		UNDOINFO undo;
+		pos.MakeMove(list.m_moves[i], undo);
+		nodes += Perft(pos, depth - 1);
+		pos.UnmakeMove(list.m_moves[i], undo);
+	}
+	return nodes;
+}
@@ -0,0 +1,31 @@
+// MoveGen.h : legal move generation for CPosition
+//
+// Like Position.h this file has no MFC dependency.
+/////////////////////////////////////////////////////////////////////////////
+
+#if !defined(MOVEGEN_H)
+#define MOVEGEN_H
+
+#include "Position.h"
+
+//no legal chess position has more than 218 moves
+#define MAX_MOVES	256
+
+class CMoveList
+{
+public:
+	CHESSMOVE m_moves[MAX_MOVES];
+	int m_count;
+
+	CMoveList()							{ m_count = 0; }
+	void Clear()						{ m_count = 0; }
+	void Add(CHESSMOVE move)			{ m_moves[m_count++] = move; }
+	int GetSize() const					{ return m_count; }
+	CHESSMOVE operator[](int i) const	{ return m_moves[i]; }
+	bool Contains(CHESSMOVE move) const;
+};
+
+int GenerateLegalMoves(CPosition &pos, CMoveList &list);
+unsigned long long Perft(CPosition &pos, int depth);
+
+#endif
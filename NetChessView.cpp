@@ -3,6 +3,8 @@
 
 #include "stdafx.h"
 #include <afxinet.h>
+#include <atomic>
+#include <thread>
 #include "NetChess.h"
 #include "Options.h"
 #include "ChessBoard.h"
@@ -40,6 +42,10 @@
 #include "MailToDlg.h"
 #include "smtp.h"
 #include "pop3.h"
+#include "PGNReader.h"
+#include "PGNPipeline.h"
+#include "San.h"
+#include "GameAnnotator.h"
 
 #ifdef _DEBUG
 #define new DEBUG_NEW
@@ -48,7 +54,6 @@ static char THIS_FILE[] = __FILE__;
 #endif
 int Globalfirsttime = 0;		
 
-CString tempString ; //going in unconventional way
 /////////////////////////////////////////////////////////////////////////////
 // CNetChessView
 void writeMessage(char *str,...);
@@ -148,6 +153,18 @@ BEGIN_MESSAGE_MAP(CNetChessView, CView)
 	ON_COMMAND(ID_FILE_CONVERT, OnFileConvert)
 	ON_COMMAND(ID_EDIT_COMMENT, OnEditComment)
 	ON_UPDATE_COMMAND_UI(ID_FILE_CONVERT, OnUpdateFileConvert)
+	ON_COMMAND(ID_FILE_CHECKPGNFILE, OnFileCheckpgnfile)
+	ON_UPDATE_COMMAND_UI(ID_FILE_CHECKPGNFILE, OnUpdateFileCheckpgnfile)
+	ON_COMMAND(ID_FILE_FINDPOSITION, OnFileFindposition)
+	ON_UPDATE_COMMAND_UI(ID_FILE_FINDPOSITION, OnUpdateFileFindposition)
+	ON_COMMAND(ID_FILE_OPENINGTREE, OnFileOpeningtree)
+	ON_UPDATE_COMMAND_UI(ID_FILE_OPENINGTREE, OnUpdateFileOpeningtree)
+	ON_COMMAND(ID_FILE_OPENINGBOOK, OnFileOpeningbook)
+	ON_UPDATE_COMMAND_UI(ID_FILE_OPENINGBOOK, OnUpdateFileOpeningbook)
+	ON_COMMAND(ID_FILE_TABLEBASES, OnFileTablebases)
+	ON_UPDATE_COMMAND_UI(ID_FILE_TABLEBASES, OnUpdateFileTablebases)
+	ON_COMMAND(ID_EDIT_ANNOTATEGAME, OnEditAnnotategame)
+	ON_UPDATE_COMMAND_UI(ID_EDIT_ANNOTATEGAME, OnUpdateEditAnnotategame)
 	ON_COMMAND(ID_FILE_LOADLASTGAME, OnFileLoadlastgame)
 	ON_UPDATE_COMMAND_UI(ID_FILE_LOADLASTGAME, OnUpdateFileLoadlastgame)
 	ON_COMMAND(ID_EDIT_COPYEPD, OnEditCopyepd)
@@ -240,7 +257,9 @@ BEGIN_MESSAGE_MAP(CNetChessView, CView)
 	ON_COMMAND(ID_FILE_PRINT_PREVIEW, CView::OnFilePrintPreview)
 	//ON_MESSAGE(ID_MY_MESSAGE_COLORDATA,OnMessageColorData)
 	//ON_MESSAGE(WM_COMMAND,OnCommand)
-	//ON_MESSAGE(ID_MY_MESSAGE_ENGINE,OnMyEngineMessage)
+	ON_MESSAGE(ID_MY_MESSAGE_ENGINE,OnEngineMessage)
+	ON_MESSAGE(ID_MY_MESSAGE_ENGINE_DATA,OnEngineData)
+	ON_MESSAGE(ID_MY_MESSAGE_PROGRESS,OnProgressMessage)
 
 		ON_COMMAND(59, OnViewReplayAll)
 		ON_UPDATE_COMMAND_UI(59, OnUpdateReplayAll)
@@ -258,6 +277,8 @@ CNetChessView::CNetChessView()
 	m_pServerSocket = NULL;
 	m_pClientICSSocket = NULL;
 	m_iHistory = -1;
+	m_matchResultPly = -1;
+	m_matchResultKey = 0;
 	m_LetterFlag = true;
 	m_NumberFlag = true;
 	m_white_on_top = false;
@@ -843,7 +864,7 @@ void CNetChessView::ShowConvertMessage(CDC &dc)
 		
 		ldc.TextOut(10,150,"Chess format convertion is in progress. This will take several minutes, please wait!");
 		CString str;
-		int total = m_PGNFileData.GetSize();	
+		int total = (int)m_PGNIndex.GetCount();	
 		str.Format("Converting %d/%d game",m_PGNFileIndex,total);
 		ldc.TextOut(10,180,str);
 		dc.BitBlt(0,0,600,600,&ldc,0,0,SRCCOPY);
@@ -1240,7 +1261,7 @@ void CNetChessView::DrawInExtendedView(CDC *dc)
 		//comment window
 		if(m_iHistory > -1)
 		{
-			m_edit_comment.SetWindowText(m_History[m_iHistory].GetComment());
+			m_edit_comment.SetWindowText(m_History.GetComment(m_iHistory));
 		}
 		else
 		{		
@@ -1355,6 +1376,7 @@ void CNetChessView::Initialize()
 	m_moveRect =0;	 
 	m_iHistory = -1;	 	 	 	 
 	m_topHistory = -1;
+	m_History.RemoveAll();
 	m_timerFlag = false;	
 	m_blackTime = m_whiteTime =  m_engineLevelDlg.m_edit_time_control == 0? 5*60: m_engineLevelDlg.m_edit_time_control*60;
 	m_elapsedTime = 0;
@@ -1419,50 +1441,14 @@ void CNetChessView::Initialize()
 
 	if(m_pClientSocket == NULL)
 		m_pieceSide = WHITE;
-	//clean the board
-	for ( int i = 0; i < 8; i++)
-	{		
-		for( int j = 0; j < 8; j++)
-		{			
-			cb[i][j].SetPieceData(-1,NONE,BLANK,PIECE_NOT_MOVING);	
-		}	
-	}
 	//setup up the board
-	cb[0][0].SetPieceData(ROOK_BLACK,BLACK,ROOK,PIECE_NOT_MOVING);
-	cb[0][1].SetPieceData(KNIGHT_BLACK,BLACK,KNIGHT,PIECE_NOT_MOVING);
-	cb[0][2].SetPieceData(BISHOP_BLACK,BLACK,BISHOP,PIECE_NOT_MOVING);
-	cb[0][3].SetPieceData(QUEEN_BLACK,BLACK,QUEEN,PIECE_NOT_MOVING);
-	cb[0][4].SetPieceData(KING_BLACK,BLACK,KING,PIECE_NOT_MOVING);
-	cb[0][5].SetPieceData(BISHOP_BLACK,BLACK,BISHOP,PIECE_NOT_MOVING);
-	cb[0][6].SetPieceData(KNIGHT_BLACK,BLACK,KNIGHT,PIECE_NOT_MOVING);
-	cb[0][7].SetPieceData(ROOK_BLACK,BLACK,ROOK,PIECE_NOT_MOVING);
-
-	for(int i=0;i<8;i++)
-	{
-		cb[0][i].SetPieceState(PIECE_NOT_MOVING);
-		cb[7][i].SetPieceState(PIECE_NOT_MOVING);
-	}
-
-	for(int i=0;i<8;i++)
-	{
-		cb[1][i].SetPieceData(PAWN_BLACK,BLACK,PAWN,PIECE_NOT_MOVING);
-		cb[6][i].SetPieceData(PAWN_WHITE,WHITE,PAWN,PIECE_NOT_MOVING);
-	}
-	 
-	cb[7][0].SetPieceData(ROOK_WHITE,WHITE,ROOK,PIECE_NOT_MOVING);
-	cb[7][1].SetPieceData(KNIGHT_WHITE,WHITE,KNIGHT,PIECE_NOT_MOVING);
-	cb[7][2].SetPieceData(BISHOP_WHITE,WHITE,BISHOP,PIECE_NOT_MOVING);
-	cb[7][3].SetPieceData(QUEEN_WHITE,WHITE,QUEEN,PIECE_NOT_MOVING);
-	cb[7][4].SetPieceData(KING_WHITE,WHITE,KING,PIECE_NOT_MOVING);
-	cb[7][5].SetPieceData(BISHOP_WHITE,WHITE,BISHOP,PIECE_NOT_MOVING);
-	cb[7][6].SetPieceData(KNIGHT_WHITE,WHITE,KNIGHT,PIECE_NOT_MOVING);
-	cb[7][7].SetPieceData(ROOK_WHITE,WHITE,ROOK,PIECE_NOT_MOVING);
+	m_position.SetStartPosition();
+	SetBoardFromPosition();
 
 	SetTimer(PIECE_SIDE_TIMER_EVENT_ID,1000,NULL);
 	SetTimer(ICS_TIMER,1000,NULL);
 	SetTimer(SAVE_TIMER_EVENT_ID,1000,NULL);
-	if(m_white_on_top == true)
-		FlipBoard();
+	SetTimer(ANALYSIS_TIMER_EVENT_ID,ANALYSIS_REFRESH_INTERVAL,NULL);
 	//DrawBoard();
 
 }
@@ -2014,6 +2000,7 @@ void CNetChessView::HandleData(unsigned char* data,int length, int flag)
 						cb[i][j].SetPieceData(pieceid,piece_color,piece_type,PIECE_NOT_MOVING);
 						totLines++;
 					}				
+					SetPositionFromBoard();
 					DrawBoard();
 				}
 				break;
@@ -2047,37 +2034,21 @@ void CNetChessView::HandleData(unsigned char* data,int length, int flag)
 				break;
 			case MOVEFIRST:
 					{
-						int total = m_iHistory;
-						for(int i=0;i<=total;i++)
-						{
-							OnEditUndoAction(0); 		
-						}					
+						GoToPly(-1);
 						DrawBoard();
 					}
 				break;
 			case MOVELAST:
 					{					
-						int total = m_topHistory;
-						for(int i=0;i<=total;i++)
-						{
-							OnEditRedoAction(0); 		
-						}					
+						GoToPly(m_topHistory);
 						DrawBoard();
 					}
 				break;
 			case GOTO:
 				{
-					int total = m_iHistory;
 					int pos;
 					memcpy(&pos,&data[1],4);				
-					for(int i=0;i<=total;i++)
-					{
-						OnEditUndoAction(0); 			
-					}	
-					for(int i=1;i<=pos;i++)
-					{
-						OnEditRedoAction(0);				
-					}
+					GoToPly(pos - 1);
 					m_demoTotal = pos;
 					DrawBoard();
 				}
@@ -2250,6 +2221,7 @@ void CNetChessView::HandleData(unsigned char* data,int length, int flag)
 					}
 
 					m_iHistory = -1;
+					SetPositionFromBoard();
 					DrawBoard();
 				}
 				break;
@@ -2505,10 +2477,9 @@ void CNetChessView::HandleEngineData(COLOR_TYPE ct,CString data)
 		//CString str = "Received message: " + data;
 		//writeMessage(str.GetBuffer(0));
 		int temp = m_iHistory;
-		tempString = data.Right(data.GetLength() - (ret+4+1));
-		writeMessage(tempString.GetBuffer(0));
-		LPARAM l = CHECK_MOVE;				
-		PostMessage(ID_MY_MESSAGE_ENGINE,0,l);
+		CString move = data.Right(data.GetLength() - (ret+4+1));
+		writeMessage(move.GetBuffer(0));
+		PostEngineMessage(CHECK_MOVE,move);
 		/*if(m_iHistory != temp)
 		{		
 			return;
@@ -2579,12 +2550,11 @@ void CNetChessView::HandleEngineData(COLOR_TYPE ct,CString data)
 	if(ret == 0)
 	{
 		int temp = m_iHistory;
-		tempString = data.Right(data.GetLength() - (ret+8+1));
-		int ret = tempString.Find(' ');
+		CString move = data.Right(data.GetLength() - (ret+8+1));
+		int ret = move.Find(' ');
 		if(ret > 0)
-			tempString = tempString.Left(ret);
-		LPARAM l = CHECK_MOVE;				
-		PostMessage(ID_MY_MESSAGE_ENGINE,0,l);
+			move = move.Left(ret);
+		PostEngineMessage(CHECK_MOVE,move);
 		if(m_iHistory != temp)
 		{		
 			return;
@@ -2651,9 +2621,7 @@ void CNetChessView::HandleEngineData(COLOR_TYPE ct,CString data)
 	if(ret > 0)
 	{
 		int temp = m_iHistory;
-		tempString = data.Right(data.GetLength() - (ret+5+1));
-		LPARAM l = CHECK_MOVE;				
-		PostMessage(ID_MY_MESSAGE_ENGINE,0,l);
+		PostEngineMessage(CHECK_MOVE,data.Right(data.GetLength() - (ret+5+1)));
 		if(m_iHistory != temp)
 		{		
 			return;
@@ -2776,12 +2744,12 @@ void CNetChessView::HandleEngineData(COLOR_TYPE ct,CString data)
 		if(ct == WHITE)
 		{
 			LPARAM l = WHITE_UCI_OPTIONS;			
-			PostMessage(ID_MY_MESSAGE_ENGINE,0,l);
+			PostEngineMessage(l,data);
 		}
 		else if(ct == BLACK)
 		{
 			LPARAM l = BLACK_UCI_OPTIONS;			
-			PostMessage(ID_MY_MESSAGE_ENGINE,0,l);
+			PostEngineMessage(l,data);
 		}	
 		return;
 	}
@@ -2792,12 +2760,12 @@ void CNetChessView::HandleEngineData(COLOR_TYPE ct,CString data)
 		if(ct == WHITE)
 		{
 			LPARAM l = WHITE_ISREADYOK;			
-			PostMessage(ID_MY_MESSAGE_ENGINE,0,l);
+			PostEngineMessage(l,data);
 		}
 		else if(ct == BLACK)
 		{
 			LPARAM l = BLACK_ISREADYOK;			
-			PostMessage(ID_MY_MESSAGE_ENGINE,0,l);
+			PostEngineMessage(l,data);
 		}	
 		return;
 	}
@@ -2806,7 +2774,7 @@ void CNetChessView::HandleEngineData(COLOR_TYPE ct,CString data)
 	if(ret == 0)
 	{
 		LPARAM l = CHECKMATE;				
-		PostMessage(ID_MY_MESSAGE_ENGINE,0,l);
+		PostEngineMessage(l,data);
 		return;
 	}
 	//check for feature command
@@ -2819,13 +2787,13 @@ void CNetChessView::HandleEngineData(COLOR_TYPE ct,CString data)
 		{			
 			m_whiteEngine.m_arrFeatures.Add(data);
 			LPARAM l = WHITE_FEATURES;				
-			PostMessage(ID_MY_MESSAGE_ENGINE,0,l);
+			PostEngineMessage(l,data);
 		}
 		else
 		{
 			m_blackEngine.m_arrFeatures.Add(data);
 			LPARAM l = BLACK_FEATURES;				
-			PostMessage(ID_MY_MESSAGE_ENGINE,0,l);
+			PostEngineMessage(l,data);
 		}
 		return;
 	}
@@ -2836,14 +2804,12 @@ void CNetChessView::HandleEngineData(COLOR_TYPE ct,CString data)
 		if(ct == WHITE)
 		{		
 			l = WHITE_WON_WHITE;
-			m_whiteEngine.m_tempString = data;
 		}
 		else
 		{
 			l = WHITE_WON_BLACK;
-			m_blackEngine.m_tempString = data;
 		}
-		PostMessage(ID_MY_MESSAGE_ENGINE,0,l);		
+		PostEngineMessage(l,data);		
 		return;
 	}
 	ret = data.Find("0-1",0);
@@ -2853,14 +2819,12 @@ void CNetChessView::HandleEngineData(COLOR_TYPE ct,CString data)
 		if(ct == WHITE)
 		{			
 			l = BLACK_WON_WHITE;				
-			m_whiteEngine.m_tempString = data;
 		}
 		else
 		{
 			l = BLACK_WON_BLACK;				
-			m_blackEngine.m_tempString = data;
 		}
-		PostMessage(ID_MY_MESSAGE_ENGINE,0,l);		
+		PostEngineMessage(l,data);		
 		return;
 	}
 	ret = data.Find("1/2-1/2",0);
@@ -2870,14 +2834,12 @@ void CNetChessView::HandleEngineData(COLOR_TYPE ct,CString data)
 		if(ct == WHITE)
 		{		
 			l = MATCH_DRAWN_WHITE;				
-			m_whiteEngine.m_tempString = data;
 		}
 		else
 		{
 			l = MATCH_DRAWN_BLACK;				
-			m_blackEngine.m_tempString = data;
 		}
-		PostMessage(ID_MY_MESSAGE_ENGINE,0,l);		
+		PostEngineMessage(l,data);		
 		return;
 	}
 	ret = data.Find("offer draw",0);
@@ -2887,14 +2849,12 @@ void CNetChessView::HandleEngineData(COLOR_TYPE ct,CString data)
 		if(ct == WHITE)
 		{		
 			l = MATCH_DRAWN_WHITE;				
-			m_whiteEngine.m_tempString = data;
 		}
 		else
 		{
 			l = MATCH_DRAWN_BLACK;				
-			m_blackEngine.m_tempString = data;
 		}
-		PostMessage(ID_MY_MESSAGE_ENGINE,0,l);		
+		PostEngineMessage(l,data);		
 		return;
 	}
 	ret = data.Find("Illegal move",0);
@@ -2904,14 +2864,12 @@ void CNetChessView::HandleEngineData(COLOR_TYPE ct,CString data)
 		if(ct == WHITE)
 		{			
 			l = ILLEGAL_MOVE_WHITE;				
-			m_whiteEngine.m_tempString = data;
 		}
 		else
 		{
 			l = ILLEGAL_MOVE_BLACK;				
-			m_blackEngine.m_tempString = data;
 		}
-		PostMessage(ID_MY_MESSAGE_ENGINE,0,l);		
+		PostEngineMessage(l,data);		
 		return;
 	}
 	ret = data.Find("illegal move",0);
@@ -2921,14 +2879,12 @@ void CNetChessView::HandleEngineData(COLOR_TYPE ct,CString data)
 		if(ct == WHITE)
 		{			
 			l = ILLEGAL_MOVE_WHITE;				
-			m_whiteEngine.m_tempString = data;
 		}
 		else
 		{
 			l = ILLEGAL_MOVE_BLACK;				
-			m_blackEngine.m_tempString = data;
 		}
-		PostMessage(ID_MY_MESSAGE_ENGINE,0,l);		
+		PostEngineMessage(l,data);		
 		return;
 	}
 	ret = data.Find("illegal user move",0);
@@ -2938,14 +2894,12 @@ void CNetChessView::HandleEngineData(COLOR_TYPE ct,CString data)
 		if(ct == WHITE)
 		{			
 			l = ILLEGAL_MOVE_WHITE;				
-			m_whiteEngine.m_tempString = data;
 		}
 		else
 		{
 			l = ILLEGAL_MOVE_BLACK;				
-			m_blackEngine.m_tempString = data;
 		}
-		PostMessage(ID_MY_MESSAGE_ENGINE,0,l);		
+		PostEngineMessage(l,data);		
 		return;
 	}
 
@@ -2956,14 +2910,12 @@ void CNetChessView::HandleEngineData(COLOR_TYPE ct,CString data)
 		if(ct == WHITE)
 		{			
 			l = ERROR_WHITE;				
-			m_whiteEngine.m_tempString = data;
 		}
 		else
 		{
 			l = ERROR_BLACK;				
-			m_blackEngine.m_tempString = data;
 		}
-		PostMessage(ID_MY_MESSAGE_ENGINE,0,l);		
+		PostEngineMessage(l,data);		
 		return;
 	}	
 	ret = data.Find("resign",0);
@@ -2973,14 +2925,12 @@ void CNetChessView::HandleEngineData(COLOR_TYPE ct,CString data)
 		if(ct == WHITE)
 		{			
 			l = RESIGN_WHITE;				
-			m_whiteEngine.m_tempString = data;
 		}
 		else
 		{
 			l = RESIGN_BLACK;				
-			m_blackEngine.m_tempString = data;
 		}
-		PostMessage(ID_MY_MESSAGE_ENGINE,0,l);		
+		PostEngineMessage(l,data);		
 		return;
 	}
 	ret = data.Find("tellopponent",0);
@@ -2990,14 +2940,12 @@ void CNetChessView::HandleEngineData(COLOR_TYPE ct,CString data)
 		if(ct == WHITE)
 		{			
 			l = TELLOPPONENT_WHITE;				
-			m_whiteEngine.m_tempString = data;
 		}
 		else
 		{
 			l = TELLOPPONENT_BLACK;				
-			m_blackEngine.m_tempString = data;
 		}
-		PostMessage(ID_MY_MESSAGE_ENGINE,0,l);		
+		PostEngineMessage(l,data);		
 		return;
 	}
 	ret = data.Find("tellothers",0);
@@ -3007,14 +2955,12 @@ void CNetChessView::HandleEngineData(COLOR_TYPE ct,CString data)
 		if(ct == WHITE)
 		{			
 			l = TELLOTHERS_WHITE;				
-			m_whiteEngine.m_tempString = data;
 		}
 		else
 		{
 			l = TELLOTHERS_BLACK;				
-			m_blackEngine.m_tempString = data;
 		}
-		PostMessage(ID_MY_MESSAGE_ENGINE,0,l);		
+		PostEngineMessage(l,data);		
 		return;
 	}	
 
@@ -3025,25 +2971,124 @@ void CNetChessView::HandleEngineData(COLOR_TYPE ct,CString data)
 		if(ct == WHITE)
 		{			
 			l = HINT_WHITE;				
-			m_whiteEngine.m_tempString = data;
 		}
 		else
 		{
 			l = HINT_BLACK;				
-			m_blackEngine.m_tempString = data;
 		}
-		PostMessage(ID_MY_MESSAGE_ENGINE,0,l);		
+		PostEngineMessage(l,data);		
 		return;
 	}	
 	//writeMessage(data.GetBuffer(0));
 }
-void CNetChessView::OnMyEngineMessage(WPARAM wParam,LPARAM lParam)
+//Handles command later on the UI thread, with text as its payload. The
+//message owns a copy of text until OnEngineMessage takes it.
+void CNetChessView::PostEngineMessage(int command,CString text)
+{
+	CString *payload = new CString(text);
+	if(!PostMessage(ID_MY_MESSAGE_ENGINE,command,(LPARAM)payload))
+		delete payload;
+}
+
+LRESULT CNetChessView::OnEngineMessage(WPARAM wParam,LPARAM lParam)
+{
+	CString *payload = (CString*)lParam;
+	CString text = *payload;
+	delete payload;
+	OnMyEngineMessage((int)wParam,text);
+	return 0;
+}
+
+//An engine's read thread has queued lines for the board
+LRESULT CNetChessView::OnEngineData(WPARAM wParam,LPARAM lParam)
+{
+	((CEngine*)wParam)->HandleQueuedLines(ENGINE_DRAIN_BATCH);
+	return 0;
+}
+
+//Shows text from a worker thread later on the UI thread: in the message
+//pane with the games or positions done so far, or as a line of the message
+//window when done is PROGRESS_LOG.
+void CNetChessView::PostProgress(CString text,int done)
+{
+	CString *payload = new CString(text);
+	if(!PostMessage(ID_MY_MESSAGE_PROGRESS,(WPARAM)done,(LPARAM)payload))
+		delete payload;
+}
+
+LRESULT CNetChessView::OnProgressMessage(WPARAM wParam,LPARAM lParam)
+{
+	CString *payload = (CString*)lParam;
+	if((int)wParam == PROGRESS_LOG)
+		writeMessage("%s",*payload);
+	else
+	{
+		SetPaneText(MESSAGEPANE,*payload,0);
+		if(m_convertFlag == TRUE)
+		{
+			m_PGNFileIndex = (int)wParam;
+			DrawBoard();
+		}
+	}
+	delete payload;
+	return 0;
+}
+
+struct VIEWWORKER
+{
+	void (*proc)(void *);
+	void *param;
+	HWND wnd;
+	std::atomic<bool> finished;
+};
+
+static void RunViewWorker(VIEWWORKER *worker)
+{
+	worker->proc(worker->param);
+	worker->finished = true;
+	//wakes the message loop of RunWorker
+	::PostMessage(worker->wnd,WM_NULL,0,0);
+}
+
+//Runs proc on a worker thread and returns once it is done. Meanwhile the
+//main window is disabled, as under a modal dialog, and messages are pumped
+//so the view repaints and shows the progress the worker posts to it.
+void CNetChessView::RunWorker(void (*proc)(void *),void *param)
+{
+	CWnd *main = AfxGetMainWnd();
+	BOOL enabled = main->IsWindowEnabled();
+	main->EnableWindow(FALSE);
+	BeginWaitCursor();
+	VIEWWORKER worker;
+	worker.proc = proc;
+	worker.param = param;
+	worker.wnd = m_hWnd;
+	worker.finished = false;
+	std::thread thread(RunViewWorker,&worker);
+	BOOL quit = FALSE;
+	while(!worker.finished && !quit)
+		quit = !AfxGetApp()->PumpMessage();
+	thread.join();
+	//the last progress the worker posted
+	MSG msg;
+	while(::PeekMessage(&msg,m_hWnd,ID_MY_MESSAGE_PROGRESS,ID_MY_MESSAGE_PROGRESS,PM_REMOVE))
+		::DispatchMessage(&msg);
+	EndWaitCursor();
+	main->EnableWindow(enabled);
+	if(quit)
+		::PostQuitMessage(0);
+}
+
+void CNetChessView::OnMyEngineMessage(int command,CString text)
 {
-	switch(lParam)
+	switch(command)
 	{
 		case CHECKMATE:
 			AfxMessageBox("Checkmate");
 			break;
+		case ENGINE_EXITED:
+			AfxMessageBox("Reading from Engine is stopped, " + text + " has exited");
+			break;
 		case WHITE_UCI_OPTIONS:
 			{
 				if(m_whiteEngine.m_arrOptions.GetSize() > 0)
@@ -3138,7 +3183,7 @@ void CNetChessView::OnMyEngineMessage(WPARAM wParam,LPARAM lParam)
 			{
 				
 				CString str;
-				str = "result " + m_whiteEngine.m_tempString;
+				str = "result " + text;
 				m_blackEngine.WriteToEngine(str);
 
 				m_pauseclockFlag = TRUE;
@@ -3151,13 +3196,13 @@ void CNetChessView::OnMyEngineMessage(WPARAM wParam,LPARAM lParam)
 				memcpy(&data1[1],str.GetBuffer(0),str.GetLength());
 				data1[0] = ENGINE_DATA;
 				SendSockData(data1,str.GetLength()+2);
-				AfxMessageBox(m_whiteEngine.m_tempString);				
+				AfxMessageBox(text + RecordMatchResult(0,text));				
 			}
 			break;
 		case BLACK_WON_BLACK:
 			{
 				CString str;
-				str = "result " + m_blackEngine.m_tempString;
+				str = "result " + text;
 				m_whiteEngine.WriteToEngine(str);
 
 				m_pauseclockFlag = TRUE;
@@ -3170,13 +3215,13 @@ void CNetChessView::OnMyEngineMessage(WPARAM wParam,LPARAM lParam)
 				memcpy(&data1[1],str.GetBuffer(0),str.GetLength());
 				data1[0] = ENGINE_DATA;
 				SendSockData(data1,str.GetLength()+2);
-				AfxMessageBox(m_blackEngine.m_tempString);
+				AfxMessageBox(text + RecordMatchResult(0,text));
 			}
 			break;
 		case WHITE_WON_WHITE:
 			{
 				CString str;				
-				str = "result " + m_whiteEngine.m_tempString;
+				str = "result " + text;
 				m_blackEngine.WriteToEngine(str);
 
 				m_pauseclockFlag = TRUE;
@@ -3189,13 +3234,13 @@ void CNetChessView::OnMyEngineMessage(WPARAM wParam,LPARAM lParam)
 				memcpy(&data1[1],str.GetBuffer(0),str.GetLength());
 				data1[0] = ENGINE_DATA;
 				SendSockData(data1,str.GetLength()+2);
-				AfxMessageBox(m_whiteEngine.m_tempString);
+				AfxMessageBox(text + RecordMatchResult(2,text));
 			}
 			break;
 		case WHITE_WON_BLACK:
 			{
 				CString str;
-				str = "result " + m_blackEngine.m_tempString;
+				str = "result " + text;
 				m_whiteEngine.WriteToEngine(str);
 
 				m_pauseclockFlag = TRUE;
@@ -3208,13 +3253,13 @@ void CNetChessView::OnMyEngineMessage(WPARAM wParam,LPARAM lParam)
 				memcpy(&data1[1],str.GetBuffer(0),str.GetLength());
 				data1[0] = ENGINE_DATA;
 				SendSockData(data1,str.GetLength()+2);
-				AfxMessageBox(m_blackEngine.m_tempString);
+				AfxMessageBox(text + RecordMatchResult(2,text));
 			}
 			break;
 		case MATCH_DRAWN_WHITE:
 			{
 				CString str;
-				str = "result " + m_whiteEngine.m_tempString;
+				str = "result " + text;
 				m_blackEngine.WriteToEngine(str);
 
 				m_pauseclockFlag = TRUE;
@@ -3227,13 +3272,13 @@ void CNetChessView::OnMyEngineMessage(WPARAM wParam,LPARAM lParam)
 				memcpy(&data1[1],str.GetBuffer(0),str.GetLength());
 				data1[0] = ENGINE_DATA;
 				SendSockData(data1,str.GetLength()+2);
-				AfxMessageBox(m_whiteEngine.m_tempString);
+				AfxMessageBox(text + RecordMatchResult(1,text));
 			}
 			break;
 		case MATCH_DRAWN_BLACK:
 			{
 				CString str;
-				str = "result " + m_blackEngine.m_tempString;
+				str = "result " + text;
 				m_whiteEngine.WriteToEngine(str);
 				m_pauseclockFlag = TRUE;
 				unsigned char data[2];
@@ -3245,7 +3290,7 @@ void CNetChessView::OnMyEngineMessage(WPARAM wParam,LPARAM lParam)
 				memcpy(&data1[1],str.GetBuffer(0),str.GetLength());
 				data1[0] = ENGINE_DATA;
 				SendSockData(data1,str.GetLength()+2);
-				AfxMessageBox(m_blackEngine.m_tempString);
+				AfxMessageBox(text + RecordMatchResult(1,text));
 			}
 			break;		
 		case ACCEPT_DRAW_WHITE:
@@ -3283,24 +3328,24 @@ void CNetChessView::OnMyEngineMessage(WPARAM wParam,LPARAM lParam)
 			}
 			break;
 		case ILLEGAL_MOVE_WHITE:
-			//AfxMessageBox(m_whiteEngine.m_tempString);
+			//AfxMessageBox(text);
 			break;
 		case ILLEGAL_MOVE_BLACK:
-			//AfxMessageBox(m_blackEngine.m_tempString);
+			//AfxMessageBox(text);
 			break;
 		case ERROR_WHITE:
-			AfxMessageBox(m_whiteEngine.m_tempString);
+			AfxMessageBox(text);
 			break;
 		case ERROR_BLACK:
-			AfxMessageBox(m_blackEngine.m_tempString);
+			AfxMessageBox(text);
 			break;
 		case HINT_BLACK:
-			//AfxMessageBox(m_blackEngine.m_tempString);
-			SetPaneText(MESSAGEPANE,m_blackEngine.m_tempString);
+			//AfxMessageBox(text);
+			SetPaneText(MESSAGEPANE,text);
 			break;
 		case HINT_WHITE:
-			SetPaneText(MESSAGEPANE,m_whiteEngine.m_tempString);
-			//AfxMessageBox(m_whiteEngine.m_tempString);
+			SetPaneText(MESSAGEPANE,text);
+			//AfxMessageBox(text);
 			break;
 		case RESIGN_WHITE:
 			{
@@ -3316,7 +3361,7 @@ void CNetChessView::OnMyEngineMessage(WPARAM wParam,LPARAM lParam)
 			memcpy(&data1[1],str.GetBuffer(0),str.GetLength());
 			data1[0] = ENGINE_DATA;
 			SendSockData(data1,str.GetLength()+2);
-			AfxMessageBox(m_whiteEngine.m_tempString);
+			AfxMessageBox(text);
 			}
 			break;
 		case RESIGN_BLACK:
@@ -3333,20 +3378,19 @@ void CNetChessView::OnMyEngineMessage(WPARAM wParam,LPARAM lParam)
 			memcpy(&data1[1],str.GetBuffer(0),str.GetLength());
 			data1[0] = ENGINE_DATA;
 			SendSockData(data1,str.GetLength()+2);
-			AfxMessageBox(m_blackEngine.m_tempString);
+			AfxMessageBox(text);
 			}
 			break;
 		case TELLOPPONENT_WHITE:
 		case TELLOTHERS_WHITE:
-			AfxMessageBox(m_whiteEngine.m_tempString);
+			AfxMessageBox(text);
 			break;
 		case TELLOPPONENT_BLACK:
 		case TELLOTHERS_BLACK:
-			AfxMessageBox(m_blackEngine.m_tempString);
+			AfxMessageBox(text);
 			break;
 		case CHECK_MOVE:			
-			PGNMove(tempString.GetBuffer(0),m_pieceSide);
-			tempString = "";
+			PGNMove(text.GetBuffer(0),m_pieceSide);
 		
 			break;
 		default:
@@ -3640,13 +3684,16 @@ void CNetChessView::SendToEngine(unsigned char *data,int length)
 				else*/
 				{
 					if(m_pieceSide == WHITE && m_whiteAsEngineFlag == TRUE && m_whiteEngineOnlyAnalyze == FALSE)
-						m_whiteEngine.WriteToEngine(move);
+						WriteEngineMove(m_whiteEngine,move);
 					if(m_pieceSide == BLACK && m_blackAsEngineFlag == TRUE && m_blackEngineOnlyAnalyze == FALSE)
-						m_blackEngine.WriteToEngine(move);
+						WriteEngineMove(m_blackEngine,move);
 				}
 			}
 			break;
 		case NEWGAME:						
+				//"new" takes the engines out of force mode
+				m_whiteEngine.m_forceFlag = FALSE;
+				m_blackEngine.m_forceFlag = FALSE;
 				if(m_whiteAsEngineFlag == TRUE)
 				{
 					if(m_whiteEngine.m_engineConfigDlg.m_chessProtocol == WB_I ||
@@ -4429,7 +4476,7 @@ CString CNetChessView::GetFileSaveString()
 			from_row_id,from_col_id, to_piece_type,
 			to_color_type,to_pieceid,to_row_id,
 			to_col_id);
-		int SpecialAction = m_History[i].GetSpecialAction();
+		int SpecialAction = 0;
 		unsigned int action = m_History[i].GetPieceMoveAction();
 		memset(cstr,'\0',500);
 		sprintf(cstr,"H %d %d %d %d %d %d %d %d %d %d %d %d %u\n",
@@ -4644,19 +4691,14 @@ void CNetChessView::SetEnginePosition(CEngine& engine, CString position)
 }
 CString CNetChessView::GetPositionString(int type, int& movecount, char &side)
 {
-	int flipflag = FALSE;
-	if(m_white_on_top == true)
-	{
-		FlipBoard();
-		flipflag = TRUE;
-	}
-
 	CString returnstr = "";
-	for(int i=0;i<8;i++)
+	for(int rank=7;rank>=0;rank--)
 	{
 		int spacecount = 0;
-		for(int j=0;j<8;j++)
+		for(int file=0;file<8;file++)
 		{
+			int i,j;
+			GetBoardCell(MakeSquare(file,rank),i,j);
 			if(cb[i][j].GetPieceId() == -1)
 				spacecount++;
 			else
@@ -4677,7 +4719,7 @@ CString CNetChessView::GetPositionString(int type, int& movecount, char &side)
 			str.Format("%d",spacecount);
 			returnstr += str;
 		}
-		if(i != 7)
+		if(rank != 0)
 			returnstr += '/';
 	}			
 	
@@ -4765,7 +4807,7 @@ CString CNetChessView::GetPositionString(int type, int& movecount, char &side)
 			if(m_optDlg.m_check_save_with_history == TRUE)
 			{
 				if(m_iHistory >= 0)
-					commentstr.Format( "c0 \"%s\";",m_History[m_iHistory].GetComment());
+					commentstr.Format( "c0 \"%s\";",m_History.GetComment(m_iHistory));
 			}
 		}
 		
@@ -4780,273 +4822,30 @@ CString CNetChessView::GetPositionString(int type, int& movecount, char &side)
 		//side = side == 'w' ? 'b' : 'w';
 		returnstr += str;		
 	}
-	if(flipflag == TRUE)
-	{
-		FlipBoard();
-		m_white_on_top = true;;
-	}
 	return returnstr;
 }
+//SAN of the move at ply i, written by FormatSAN on the position before it
 CString CNetChessView::GetSingleMoveString(int i)
 {
-	CString str;
-	PIECE_SIDE piece_side;
-	PIECE_TYPE from_piece_type;
-	COLOR_TYPE from_color_type;
-	int from_pieceid;
-	int from_row_id;
-	int from_col_id;
-	PIECE_TYPE to_piece_type;
-	COLOR_TYPE to_color_type;
-	int to_pieceid;
-	int to_row_id;
-	int to_col_id;
-	m_History[i].GetHistory(piece_side,from_piece_type,
-			from_color_type,from_pieceid,
-			from_row_id,from_col_id, to_piece_type,
-			to_color_type,to_pieceid,to_row_id,
-			to_col_id);
-		char from_type=' ';
-		switch(from_piece_type)
-		{
-			case ROOK:
-				from_type = 'R';
-				break;
-			case KNIGHT:
-				from_type = 'N';
-				break;
-			case BISHOP:
-				from_type = 'B';
-				break;
-			case QUEEN:
-				from_type = 'Q';
-				break;
-			case KING:
-				from_type = 'K';
-				break;
-			case PAWN:
-				from_type = ' ';
-				break;
-			default:
-				from_type = ' ';
-				break;
-		}
-		char to_type=' ';
-		switch(to_piece_type)
-		{
-			case ROOK:
-				to_type = 'R';
-				break;
-			case KNIGHT:
-				to_type = 'N';
-				break;
-			case BISHOP:
-				to_type = 'B';
-				break;
-			case QUEEN:
-				to_type = 'Q';
-				break;
-			case KING:
-				to_type = 'K';
-				break;
-			case PAWN:
-				to_type = ' ';
-				break;
-			default:
-				to_type = ' ';
-				break;
-		}		
-		if( m_History[i].GetCastlingFlag() == TRUE)			
-		{
-			if(from_col_id + 2 == to_col_id)
-			{
-				str.Format("O-O");
-			}
-			else
-			{
-				str.Format("O-O-O");
-			}		 
-		}
-		else
-		{			
-			if(to_pieceid == -1)
-			{
-				if(from_type==' ')
-				{						
-					if(m_History[i].GetAmbiguousMoveRankFlag() == TRUE)							
-					{
-						str.Format("%c%d%c%d",
-								from_col_id+'a',9-(from_row_id+1),
-								to_col_id+'a',
-								9-(to_row_id+1));							
-					}
-					else if(m_History[i].GetAmbiguousMoveFileFlag() == TRUE)							
-					{
-						str.Format("%c%d%c%d",
-								from_col_id+'a',9-(from_row_id+1),
-								to_col_id+'a',
-								9-(to_row_id+1));
-						
-					}
-					else if(m_History[i].GetEnPassentFlag() == TRUE)
-					{
-						str.Format("%cx%c%d",
-								from_col_id+'a',
-								to_col_id+'a',
-								9-(to_row_id+1));
-					}
-					else
-					{
-						str.Format("%c%d",							
-								to_col_id+'a',
-								9-(to_row_id+1));							
-					}
-				}
-				else
-				{						
-					if(m_History[i].GetAmbiguousMoveRankFlag() == TRUE)							
-					{
-						str.Format("%c%d%c%d",
-								from_type,9-(from_row_id+1),
-								to_col_id+'a',
-								9-(to_row_id+1));							
-					}
-					else if(m_History[i].GetAmbiguousMoveFileFlag() == TRUE)							
-					{
-						str.Format("%c%c%c%d",
-								from_type,from_col_id+'a',
-								to_col_id+'a',
-								9-(to_row_id+1));							
-					}
-					else
-					{
-						str.Format("%c%c%d",
-							from_type,
-							to_col_id+'a',
-							9-(to_row_id+1));
-					}
-				}
-			}
-			else
-			{
-				if(from_type != ' ')
-				{
-					if(m_History[i].GetAmbiguousMoveRankFlag() == TRUE)							
-					{
-						str.Format("%c%dx%c%d",
-							from_type,9-(from_row_id+1),
-							to_col_id+'a',
-							9-(to_row_id+1));
-					}
-					else if(m_History[i].GetAmbiguousMoveFileFlag() == TRUE)							
-					{
-						str.Format("%c%cx%c%d",
-							from_type,from_col_id+'a',
-							to_col_id+'a',
-							9-(to_row_id+1));
-					}
-					else
-					{
-						str.Format("%cx%c%d",
-							from_type,
-							to_col_id+'a',
-							9-(to_row_id+1));
-					}
-				}
-				else
-				{
-					if(m_BoardToICSFlag == FALSE)
-					{
-						if(m_History[i].GetAmbiguousMoveRankFlag() == TRUE)
-						{
-							str.Format("%c%dx%c%d",
-								from_col_id+'a',9-(from_row_id+1),
-								to_col_id+'a',
-								9-(to_row_id+1));
-						}
-						else if(m_History[i].GetAmbiguousMoveFileFlag() == TRUE)
-						{
-							str.Format("%c%dx%c%d",
-								from_col_id+'a',9-(from_row_id+1),
-								to_col_id+'a',
-								9-(to_row_id+1));
-						}
-						else if(m_History[i].GetEnPassentFlag() == TRUE)
-						{
-							str.Format("%cx%c%d",
-								from_col_id+'a',
-								to_col_id+'a',
-								9-(to_row_id+1));
-						}
-						else 
-						{
-							if(m_History[i].GetPromotionFlag() == TRUE)
-							{
-								str.Format("%c%d",									
-									to_col_id+'a',
-									9-(to_row_id+1));
-							}
-							else
-							{
-								str.Format("%cx%c%d",
-									from_col_id+'a',
-									to_col_id+'a',
-									9-(to_row_id+1));
-							}
-						}
-					}
-					else
-					{
-						if(m_History[i].GetEnPassentFlag() == TRUE)
-						{
-							str.Format("%cx%c%d",
-								from_col_id+'a',
-								to_col_id+'a',
-								9-(to_row_id+1));
-						}
-						else 
-						{
-							if(m_History[i].GetPromotionFlag() == TRUE)
-							{
-								str.Format("%c%d",									
-									to_col_id+'a',
-									9-(to_row_id+1));
-							}
-							else
-							{
-								str.Format("%cx%c%d",
-									from_col_id+'a',
-									to_col_id+'a',
-									9-(to_row_id+1));
-							}
-						}
-					}
-				}
-			}
-		}
-		if(m_History[i].GetPromotionFlag() == TRUE)
-		{
-
-			CString cstr;
-			cstr.Format("=%c",to_type);
-			str += cstr;
-		}
-		
-		if( m_History[i].GetCheckFlag() == TRUE)			
-		{
-			str += "+";
-		}
-	return str;
+	char san[MAX_SAN];
+	CHESSMOVE move = m_History[i].GetMove();
+	if(m_History[i].IsManualEdit())
+	{
+		//a manual edit only names the square it changed
+		sprintf(san,"%c%d",'a' + SquareFile(GetMoveTo(move)),SquareRank(GetMoveTo(move)) + 1);
+		return san;
+	}
+	CPosition pos;
+	int k = m_History.RestorePosition(i,pos);
+	if(k < 0)
+		return "";
+	for(;k < i;k++)
+		m_History[k].Play(pos);
+	FormatSAN(pos,move,san);
+	return san;
 }
 CString CNetChessView::GetSingleMoveStringOldFormat(int i)
 {
-	int flipflag = FALSE;
-	if(m_white_on_top == true)
-	{
-		FlipBoard();
-		flipflag = TRUE;
-	}
-
 	CString str;
 	PIECE_SIDE piece_side;
 	PIECE_TYPE from_piece_type;
@@ -5101,11 +4900,6 @@ CString CNetChessView::GetSingleMoveStringOldFormat(int i)
 		cstr.Format("%c",to_type);
 		str += cstr;
 	}	
-	if(flipflag == TRUE)
-	{
-		FlipBoard();
-		m_white_on_top = true;;
-	}
 
 	return str;
 }
@@ -5117,18 +4911,8 @@ CString CNetChessView::GetPositionHistoryString(int type)
 	int count=1;	
 	int total = m_iHistory;
 	
-	int flipflag = FALSE;
-	if(m_white_on_top == true)
-	{
-		FlipBoard();
-		flipflag = TRUE;
-	}
-
 	//go back to first step
-	for(int i=0;i<=total;i++)
-	{
-		OnEditUndoAction(0);
-	}
+	GoToPly(-1);
 	int k=-1;
 	char side = 'w';
 	int movecount = 0;
@@ -5139,13 +4923,6 @@ CString CNetChessView::GetPositionHistoryString(int type)
 		k++;
 	}while (k <=total);
 	
-	
-	if(flipflag == TRUE)
-	{
-		FlipBoard();
-		flipflag = FALSE;
-		m_white_on_top = true;
-	}
 	return m_edit_history;
 }
 CString CNetChessView::GetHistoryString(CStringArray& historystring,int type)
@@ -5193,11 +4970,16 @@ CString CNetChessView::GetHistoryString(CStringArray& historystring,int type)
 			m_edit_history += (CString)"[FEN \"" + str + "\"]\r\n";
 			m_edit_history += "1...";
 		}
+		if(m_optDlg.m_check_save_with_history == TRUE && m_History.GetComment(-1).GetLength() > 0)
+			m_edit_history += "{" + m_History.GetComment(-1) + "} ";
 	}
 	else
 	{
 		total = m_topHistory;
 	}
+	//position before move i, for writing its variations
+	CPosition pos;
+	BOOL annotate = type == 0 && m_History.RestorePosition(0,pos) == 0;
 	for(int i=0;i<=total;i++)
 	{		
 		str = GetSingleMoveString(i);
@@ -5216,10 +4998,11 @@ CString CNetChessView::GetHistoryString(CStringArray& historystring,int type)
 			}
 			else
 			{
-				if(m_optDlg.m_check_save_with_history == TRUE)
+				if(m_optDlg.m_check_save_with_history == TRUE && annotate == TRUE)
 				{
-					if(m_History[i].GetComment().GetLength() > 0)
-						m_edit_history += " {" + m_History[i].GetComment() + (CString)"} " + str1.Left(str1.GetLength() -1) + ".. ";
+					CString annotation = GetPGNAnnotation(i,pos);
+					if(annotation.GetLength() > 0)
+						m_edit_history += annotation + (CString)" " + str1.Left(str1.GetLength() -1) + ".. ";
 				}
 			}
 			flag = 1;
@@ -5234,13 +5017,9 @@ CString CNetChessView::GetHistoryString(CStringArray& historystring,int type)
 			}
 			else
 			{
-				if(m_optDlg.m_check_save_with_history == TRUE)
+				if(m_optDlg.m_check_save_with_history == TRUE && annotate == TRUE)
 				{
-					if(m_History[i].GetComment().GetLength() > 0)
-						m_edit_history += (CString)" " + str + (CString)" {" + m_History[i].GetComment() + " } ";
-					else
-						m_edit_history += (CString)" " + str + (CString)" ";
-
+					m_edit_history += (CString)" " + str + GetPGNAnnotation(i,pos) + (CString)" ";
 				}
 				else
 				{
@@ -5249,791 +5028,439 @@ CString CNetChessView::GetHistoryString(CStringArray& historystring,int type)
 			}
 			flag = 0;
 		}		 
+		if(annotate == TRUE)
+			m_History[i].Play(pos);
 		//UpdateData(FALSE);
 	}	
 	return m_edit_history;
 }
 
-bool CNetChessView::CheckValidMove(int x,int y)
+//maps a cb[i][j] cell to an absolute CPosition square (0 = a1)
+int CNetChessView::GetBoardSquare(int i, int j)
 {
-	//if( m_checkmove== FALSE)
-	//	return true;
-	switch(cb[m_point.x][m_point.y].GetPieceType())
+	if(m_white_on_top == true)
+		return MakeSquare(7 - j, i);
+	return MakeSquare(j, 7 - i);
+}
+
+void CNetChessView::GetBoardCell(int sq, int &i, int &j)
+{
+	if(m_white_on_top == true)
 	{
-	case PAWN:
-		{
-			if(cb[x][y].GetPieceType() == KING)
-				return false;
+		i = SquareRank(sq);
+		j = 7 - SquareFile(sq);
+	}
+	else
+	{
+		i = 7 - SquareRank(sq);
+		j = SquareFile(sq);
+	}
+}
 
-			PIECE_SIDE piece_side;
-			PIECE_TYPE from_piece_type;
-			COLOR_TYPE from_color_type;
-			int from_pieceid;
-			int from_row_id;
-			int from_col_id;
-			PIECE_TYPE to_piece_type;
-			COLOR_TYPE to_color_type;
-			int to_pieceid;
-			int to_row_id;
-			int to_col_id;
+static const char g_positionPieceIds[] = "PNBRQKpnbrqk";
 
-			if(m_white_on_top == true)
+static int PieceIdToPosition(int pieceid)
+{
+	const char *p = pieceid > 0 ? strchr(g_positionPieceIds, pieceid) : NULL;
+	return p == NULL ? NO_PIECE : (int)(p - g_positionPieceIds);
+}
+
+static int PieceTypeToPosition(int piecetype, int piececolor)
+{
+	int type;
+	switch(piecetype)
+	{
+	case PAWN:		type = PT_PAWN; break;
+	case KNIGHT:	type = PT_KNIGHT; break;
+	case BISHOP:	type = PT_BISHOP; break;
+	case ROOK:		type = PT_ROOK; break;
+	case QUEEN:		type = PT_QUEEN; break;
+	case KING:		type = PT_KING; break;
+	default:		return NO_PIECE;
+	}
+	return MakePiece(piececolor == BLACK ? SIDE_BLACK : SIDE_WHITE, type);
+}
+
+void CNetChessView::GetBoardPosition(CPosition &pos)
+{
+	pos.Clear();
+	for(int i=0;i<8;i++)
+	{
+		for(int j=0;j<8;j++)
+		{
+			int piece = PieceIdToPosition(cb[i][j].GetPieceId());
+			if(piece != NO_PIECE)
+				pos.PutPiece(GetBoardSquare(i,j),piece);
+		}
+	}
+	int castling = 0;
+	if(m_whiteKingMovedFlag == false && pos.GetPiece(4) == WHITE_KING)
+	{
+		if(m_whiteRookRank7MovedFlag == false && pos.GetPiece(7) == WHITE_ROOK)
+			castling |= CASTLE_WHITE_KING;
+		if(m_whiteRookRank1MovedFlag == false && pos.GetPiece(0) == WHITE_ROOK)
+			castling |= CASTLE_WHITE_QUEEN;
+	}
+	if(m_blackKingMovedFlag == false && pos.GetPiece(60) == BLACK_KING)
+	{
+		if(m_blackRookRank7MovedFlag == false && pos.GetPiece(63) == BLACK_ROOK)
+			castling |= CASTLE_BLACK_KING;
+		if(m_blackRookRank1MovedFlag == false && pos.GetPiece(56) == BLACK_ROOK)
+			castling |= CASTLE_BLACK_QUEEN;
+	}
+	pos.SetCastling(castling);
+
+	COLOR_TYPE side = m_player_turn == true ? m_pieceSide : (m_pieceSide == WHITE ? BLACK : WHITE);
+	if(m_iHistory >= 0)
+	{
+		PIECE_SIDE piece_side;
+		PIECE_TYPE from_piece_type, to_piece_type;
+		COLOR_TYPE from_color_type, to_color_type;
+		int from_pieceid, from_row_id, from_col_id;
+		int to_pieceid, to_row_id, to_col_id;
+		m_History[m_iHistory].GetHistory(piece_side,
+			from_piece_type,from_color_type,from_pieceid,from_row_id,from_col_id,
+			to_piece_type,to_color_type,to_pieceid,to_row_id,to_col_id);
+		side = from_color_type == WHITE ? BLACK : WHITE;
+		//history rows are stored with white at the bottom
+		if(from_pieceid == 'P' && from_row_id == 6 && to_row_id == 4)
+			pos.SetEpSquare(MakeSquare(from_col_id,2));
+		else if(from_pieceid == 'p' && from_row_id == 1 && to_row_id == 3)
+			pos.SetEpSquare(MakeSquare(from_col_id,5));
+	}
+	pos.SetSide(side == BLACK ? SIDE_BLACK : SIDE_WHITE);
+	pos.SetHalfMoveClock(m_halfMoveCount);
+	pos.SetFullMoveNumber((m_iHistory + 1) / 2 + 1);
+}
+
+//Rebuilds m_position after cb was edited directly (manual editing, FEN,
+//network data). Rule queries then run against the bitboards only.
+void CNetChessView::SetPositionFromBoard()
+{
+	GetBoardPosition(m_position);
+}
+
+//cb is only a render cache: refill every cell from m_position
+void CNetChessView::SetBoardFromPosition()
+{
+	for(int i=0;i<8;i++)
+	{
+		for(int j=0;j<8;j++)
+		{
+			int piece = m_position.GetPiece(GetBoardSquare(i,j));
+			if(piece == NO_PIECE)
 			{
-				if(cb[m_point.x][m_point.y].GetPieceColor() == BLACK)
-				{
-					if((m_point.y == y ) && (m_point.x-1 == x) && (cb[x][y].GetPieceId() <= 0)) 
-					{						
-						return true;
-					}
-					else if(m_point.y == y-1 && m_point.x-1 == x)
-					{
-						if(cb[x][y].GetPieceId() > 0)
-						{
-							return true;
-						}
-						else
-						{
-							if(m_iHistory < 0)
-								return false;			
-							m_History[m_iHistory].GetHistory(
-								piece_side,
-								from_piece_type, from_color_type,from_pieceid,
-								from_row_id,from_col_id, to_piece_type,
-								to_color_type,to_pieceid,to_row_id,
-								to_col_id);
-							//check enpassent							
-							if(from_row_id == 1 && to_row_id == 3 && from_col_id == y && m_point.x == 3 && from_pieceid == 'P')
-							{								
-								m_enpassentFlag = TRUE;
-								//m_SpecialAction = ENPASSENT;
-								return true;
-							}							 
-						}
-					}
-					else if(m_point.y == y+1 && m_point.x-1 == x)
-					{
-						if(cb[x][y].GetPieceId() > 0)
-						{
-							return true;
-						}
-						else
-						{
-							if(m_iHistory < 0)
-								return false;
-							m_History[m_iHistory].GetHistory(
-								piece_side,
-								from_piece_type, from_color_type,from_pieceid,
-								from_row_id,from_col_id, to_piece_type,
-								to_color_type,to_pieceid,to_row_id,
-								to_col_id);
-							//check enpassent
-							if(from_row_id == 1 && to_row_id == 3 && from_col_id == y && m_point.x == 3 && from_pieceid == 'P')
-							{								
-								m_enpassentFlag = TRUE;							
-								return true;
-							}
-						}
-					}
-					else if(m_point.y == y && m_point.x == 6 && m_point.x-2 == x && cb[x][y].GetPieceId() <= 0 && cb[5][y].GetPieceId() <= 0)
-					{
-						return true;
-					}
-					 
-					return false;
-				}
-				else
-				{
-					if((m_point.y == y ) && (m_point.x+1 == x) && (cb[x][y].GetPieceId() <= 0)) 
-					{
-						return true;
-					}
-					else if(m_point.y == y-1 && m_point.x+1 == x)
-					{
-						if(cb[x][y].GetPieceId() > 0)
-						{
-							return true;
-						}
-						else
-						{
-							if(m_iHistory < 0)
-								return false;
-			
-							m_History[m_iHistory].GetHistory(
-								piece_side,
-								from_piece_type, from_color_type,from_pieceid,
-								from_row_id,from_col_id, to_piece_type,
-								to_color_type,to_pieceid,to_row_id,
-								to_col_id);
-							//check enpassent
-							if(from_row_id == 6 && to_row_id == 4 && from_col_id == y && m_point.x == 3 && from_pieceid == 'p')
-							{
-								m_enpassentFlag = TRUE;
-								return true;
-							}							
-						}
-					}
-					else if(m_point.y == y+1 && m_point.x+1 == x )
-					{
-						if(cb[x][y].GetPieceId() > 0)
-						{
-							return true;
-						}
-						else
-						{
-							if(m_iHistory < 0)
-								return false;
-			
-							m_History[m_iHistory].GetHistory(
-								piece_side,
-								from_piece_type, from_color_type,from_pieceid,
-								from_row_id,from_col_id, to_piece_type,
-								to_color_type,to_pieceid,to_row_id,
-								to_col_id);
-							//check enpassent
-							if(from_row_id == 6 && to_row_id == 4 && from_col_id == y && m_point.x == 4 && from_pieceid == 'p')
-							{
-								m_enpassentFlag = TRUE;
-								return true;
-							}
-						}
-					}	
-					else if(m_point.y == y && m_point.x == 1 && m_point.x+2 == x && cb[x][y].GetPieceId() <= 0 &&cb[2][y].GetPieceId() <= 0)
-					{
-						return true;
-					}	
-				}
+				cb[i][j].SetPieceData(-1,NONE,BLANK,PIECE_NOT_MOVING);
 			}
 			else
-			{		
-				if(cb[m_point.x][m_point.y].GetPieceColor() == BLACK)
-				{
-					if((m_point.y == y ) && (m_point.x+1 == x) && (cb[x][y].GetPieceId() <= 0)) 
-					{
-						return true;
-					}
-					else if(m_point.y == y-1 && m_point.x+1 == x)
-					{
-						if(cb[x][y].GetPieceId() > 0)
-						{
-							return true;
-						}
-						else
-						{
-							if(m_iHistory < 0)
-								return false;
-			
-							m_History[m_iHistory].GetHistory(
-								piece_side,
-								from_piece_type, from_color_type,from_pieceid,
-								from_row_id,from_col_id, to_piece_type,
-								to_color_type,to_pieceid,to_row_id,
-								to_col_id);
-							//check enpassent
-							if(from_row_id == 6 && to_row_id == 4 && from_col_id == y && m_point.x == 4 && from_pieceid == 'P')
-							{
-								m_enpassentFlag = TRUE;
-								return true;
-							}						
-						}
-							 
-					}
-					else if(m_point.y == y+1 && m_point.x+1 == x )
-					{
-						if(cb[x][y].GetPieceId() > 0)
-						{
-							return true;
-						}
-						else
-						{
-							if(m_iHistory < 0)
-								return false;
-			
-							m_History[m_iHistory].GetHistory(
-								piece_side,
-								from_piece_type, from_color_type,from_pieceid,
-								from_row_id,from_col_id, to_piece_type,
-								to_color_type,to_pieceid,to_row_id,
-								to_col_id);
-							//check enpassent
-							if(from_row_id == 6 && to_row_id == 4 && from_col_id == y && m_point.x == 4 && from_pieceid == 'P')
-							{
-								m_enpassentFlag = TRUE;
-								return true;
-							}							
-						}
-					}
-					else if(m_point.y == y && m_point.x == 1 && m_point.x+2 == x && cb[x][y].GetPieceId() <= 0 && cb[2][y].GetPieceId() <= 0)
-					{
-						return true;
-					}	
-					return false;				 
-				}
-				else
-				{
-					if((m_point.y == y ) && (m_point.x-1 == x) && (cb[x][y].GetPieceId() <= 0)) 
-					{
-						return true;
-					}
-					else if(m_point.y == y-1 && m_point.x-1 == x)
-						 
-					{
-						if(cb[x][y].GetPieceId() > 0)
-						{
-							return true;
-						}
-						else
-						{
-							if(m_iHistory < 0)
-								return false;
-			
-							m_History[m_iHistory].GetHistory(
-								piece_side,
-								from_piece_type, from_color_type,from_pieceid,
-								from_row_id,from_col_id, to_piece_type,
-								to_color_type,to_pieceid,to_row_id,
-								to_col_id);
-							//check enpassent
-							if(from_row_id == 1 && to_row_id == 3 && from_col_id == y && m_point.x == 3 && from_pieceid == 'p')
-							{
-								m_enpassentFlag = TRUE;
-								return true;
-							}						
-						}
-					}
-					else if(m_point.y == y+1 && m_point.x-1 == x)						 
-					{
-						if(cb[x][y].GetPieceId() > 0)
-						{
-							return true;
-						}
-						else
-						{
-							if(m_iHistory < 0)
-								return false;
-			
-							m_History[m_iHistory].GetHistory(
-								piece_side,
-								from_piece_type, from_color_type,from_pieceid,
-								from_row_id,from_col_id, to_piece_type,
-								to_color_type,to_pieceid,to_row_id,
-								to_col_id);
-							//check enpassent
-							if(from_row_id == 1 && to_row_id == 3 && from_col_id == y && m_point.x == 3 && from_pieceid == 'p')
-							{
-								m_enpassentFlag = TRUE;
-								return true;
-							}							
-						}
-					}	
-					else if(m_point.y == y && m_point.x == 6 && m_point.x-2 == x && cb[x][y].GetPieceId() <= 0 && cb[5][y].GetPieceId() <= 0)
-					{
-						return true;
-					}	
-					return false;
-				}
-			}
-		}
-		break;
-		case ROOK:
-			if(cb[x][y].GetPieceType() == KING)
-				return false;
-			if(m_point.x == x)
-				{
-					if(m_point.y > y)
-					{
-						for(int i=y+1; i< m_point.y;i++)
-						{
-							if(cb[x][i].GetPieceId() >0)
-							{
-								return false;
-							}
-						}
-					}
-					else
-					{
-						for(int i=m_point.y+1; i< y;i++)
-						{
-							if(cb[x][i].GetPieceId() >0)
-							{
-								return false;
-							}
-						}
-					}
-				}
-				else if(m_point.y == y)
-				{
-					if(m_point.x > x)
-					{
-						for(int i=x+1; i< m_point.x;i++)
-						{
-							if(cb[i][y].GetPieceId() >0)
-							{
-								return false;
-							}
-						}
-					}
-					else
-					{
-						for(int i=m_point.x+1; i< x;i++)
-						{
-							if(cb[i][y].GetPieceId() >0)
-							{
-								return false;
-							}
-						}
-					}
-				}
-				else
-					return false;
-				if(m_white_on_top == true)
-				{				
-					if(m_point.y == 0 && m_point.x == 0)
-					{
-						cb[m_point.x][m_point.y].GetPieceColor() == BLACK?m_blackRookRank7MovedFlag = true :	m_whiteRookRank7MovedFlag = true;					 
-					}
-					else if(m_point.y == 7 && m_point.x == 0)
-					{
-						cb[m_point.x][m_point.y].GetPieceColor() == BLACK?m_blackRookRank1MovedFlag = true :	m_whiteRookRank1MovedFlag = true;					 
-					}
-				}
-				else
-				{
-					if(m_point.y == 0 && m_point.x == 7)
-					{
-						cb[m_point.x][m_point.y].GetPieceColor() == BLACK?m_blackRookRank1MovedFlag = true :	m_whiteRookRank1MovedFlag = true;					 
-					}
-					else if(m_point.y == 7 && m_point.x == 7)
-					{
- 						cb[m_point.x][m_point.y].GetPieceColor() == BLACK?m_blackRookRank7MovedFlag = true :	m_whiteRookRank7MovedFlag = true;					 
-					}
-				}
-				return true;							 
-			break;
-		case KNIGHT:
-			if(cb[x][y].GetPieceType() == KING)
-				return false;
-			if(
-				(m_point.x -2 == x && m_point.y +1 == y) ||							 
-				(m_point.x -1 == x && m_point.y+2 == y) ||
-				(m_point.x +1 == x && m_point.y+2 == y) ||
-				(m_point.x +2 == x && m_point.y+1 == y) ||
-				 
-				(m_point.x +2 == x && m_point.y-1 == y) ||
-				(m_point.x +1 == x && m_point.y-2 == y) ||
-				(m_point.x -1 == x && m_point.y-2 == y) ||
-				(m_point.x -2 == x && m_point.y-1 == y) )
 			{
-				return true;
+				COLOR_TYPE ct;
+				PIECE_TYPE pt;
+				GetPieceInfo(g_positionPieceIds[piece],ct,pt);
+				cb[i][j].SetPieceData(g_positionPieceIds[piece],ct,pt,PIECE_NOT_MOVING);
 			}
-			else return false;						 
+		}
+	}
+}
+
+//Plays move on m_position for history entry m_iHistory and keeps what
+//undo needs. The Zobrist key is updated incrementally by MakeMove.
+void CNetChessView::MakePositionMove(CHESSMOVE move)
+{
+	m_History.StorePosition(m_iHistory,m_position);
+	m_History[m_iHistory].SetMove(move,m_position.GetKey());
+	m_position.MakeMove(move,m_History[m_iHistory].GetUndoInfo());
+}
+
+//highlights the squares of history entry m_iHistory
+void CNetChessView::SetMovedRects()
+{
+	m_movedFromRect = m_movedToRect = 0;
+	if(m_iHistory < 0)
+		return;
+	CHESSMOVE move = m_History[m_iHistory].GetMove();
+	int i, j;
+	GetBoardCell(GetMoveFrom(move),i,j);
+	m_movedFromRect = cb[i][j].GetRect();
+	GetBoardCell(GetMoveTo(move),i,j);
+	m_movedToRect = cb[i][j].GetRect();
+}
+
+//Jumps to history entry ply, -1 being the position before the first move.
+//The position is rebuilt from the nearest checkpoint and the board, flags
+//and engines are updated once, where undo/redo would do it for every ply.
+void CNetChessView::GoToPly(int ply)
+{
+	if(ply > m_topHistory)
+		ply = m_topHistory;
+	if(ply < -1)
+		ply = -1;
+	if(ply == m_iHistory)
+		return;
+	//an odd number of plies changes the turn like one undo or redo
+	if(((ply - m_iHistory) & 1) != 0)
+	{
+		if(m_pClientSocket == NULL)
+		{
+			m_player_turn = true;
+			m_pieceSide = m_pieceSide == WHITE ? BLACK: WHITE;
+		}
+		else
+		{
+			m_player_turn = m_player_turn == true ? false : true;
+		}
+	}
+	int k = m_History.RestorePosition(ply + 1,m_position);
+	if(k < 0)
+	{
+		//no checkpoint, step from where we are
+		for(k = m_iHistory; k > ply; k--)
+			m_History[k].TakeBack(m_position);
+		k = m_iHistory + 1;
+	}
+	while(k <= ply)
+		m_History[k++].Play(m_position);
+	m_iHistory = ply;
+	GetMoveHistory();
+	SetBoardFromPosition();
+	SetMovedRects();
+	CString info = m_OpeningTree.IsOpen() ? GetOpeningTreeString() : "";
+	CString tablebase = GetTablebaseString();
+	if(!tablebase.IsEmpty())
+		info += (info.IsEmpty() ? "" : "  ") + tablebase;
+	if(!info.IsEmpty())
+		SetPaneText(MESSAGEPANE,info);
+
+	int movecount = m_iHistory/2;
+	char side = m_pieceSide == WHITE ? 'w' : 'b';
+	CString str = GetPositionString('F',movecount,side);
+	if(m_whiteAsEngineFlag == TRUE)
+		SetEnginePosition(m_whiteEngine, str);
+	if(m_blackAsEngineFlag == TRUE)
+		SetEnginePosition(m_blackEngine, str);
+}
+
+//How many times the current position has stood on the board. Only
+//positions since the last capture or pawn move can repeat, and a manual
+//edit ends the search.
+int CNetChessView::GetRepetitionCount()
+{
+	BITBOARD key = m_position.GetKey();
+	int count = 1;
+	int first = m_iHistory + 1 - m_position.GetHalfMoveClock();
+	for(int k = m_iHistory; k >= 0 && k >= first; k--)
+	{
+		if(m_History[k].IsManualEdit())
 			break;
-		case BISHOP:
-				if(cb[x][y].GetPieceType() == KING)
-					return false;
-				if(m_point.x > x)
-				{	int i=0,j=0;
-					if(m_point.y > y)
-					{
-						for(j=y+1,i=x+1; j< m_point.y && i < m_point.x;i++,j++)
-						{
-							if(cb[i][j].GetPieceId() >0)
-							{
-								return false;
-							}
-						}
-						if(j == m_point.y && i == m_point.x)
-							return true;
-						else
-							return false;
+		if(((m_iHistory - k) & 1) == 1 && m_History[k].GetKey() == key)
+			count++;
+	}
+	return count;
+}
 
-					}
-					else if(m_point.y < y)
-					{
-						for(j=y-1,i=x+1; j> m_point.y && i < m_point.x;i++,j--)
-						{
-							if(cb[i][j].GetPieceId() >0)
-							{
-								return false;
-							}
-						}
-						if(j == m_point.y && i == m_point.x)
-							return true;
-						else
-							return false;
-					}
-					else 
-						return false;
-				}
-				else if(m_point.x < x)
-				{
-					int i=0,j=0;
-					if(m_point.y > y)
-					{
-						for(j=m_point.y-1,i=m_point.x+1; j> y && i < x;i++,j--)
-						{
-							if(cb[i][j].GetPieceId() >0)
-							{
-								return false;
-							}
-						}
-						if(j == y && i == x)
-							return true;
-						else
-							return false;
-					}
-					else if(m_point.y < y)
-					{
-						for(j=m_point.y+1,i=m_point.x+1; j< y && i < x;i++,j++)
-						{
-							if(cb[i][j].GetPieceId() >0)
-							{
-								return false;
-							}
-						}
-						if(j == y && i == x)
-							return true;
-						else
-							return false;
-					}
-					else
-						return false;
-				}
-				else 
-					return false;
-		break;
-		case QUEEN:
-			if(cb[x][y].GetPieceType() == KING)
-				return false;
-			if(m_point.x == x)
-				{
-					if(m_point.y > y)
-					{
-						for(int i=y+1; i< m_point.y;i++)
-						{
-							if(cb[x][i].GetPieceId() >0)
-							{
-								return false;
-							}
-						}
-					}
-					else
-					{
-						for(int i=m_point.y+1; i< y;i++)
-						{
-							if(cb[x][i].GetPieceId() >0)
-							{
-								return false;
-							}
-						}
-					}
-				}
-				else if(m_point.y == y)
-				{
-					if(m_point.x > x)
-					{
-						for(int i=x+1; i< m_point.x;i++)
-						{
-							if(cb[i][y].GetPieceId() >0)
-							{
-								return false;
-							}
-						}
-					}
-					else
-					{
-						for(int i=m_point.x+1; i< x;i++)
-						{
-							if(cb[i][y].GetPieceId() >0)
-							{
-								return false;
-							}
-						}
-					}
-				}
-				else if(m_point.x > x)
-				{	int i=0,j=0;
-					if(m_point.y > y)
-					{
-						for(j=y+1,i=x+1; j< m_point.y && i < m_point.x;i++,j++)
-						{
-							if(cb[i][j].GetPieceId() >0)
-							{
-								return false;
-							}
-						}
-						if(j == m_point.y && i == m_point.x)
-							return true;
-						else
-							return false;
-
-					}
-					else if(m_point.y < y)
-					{
-						for(j=y-1,i=x+1; j> m_point.y && i < m_point.x;i++,j--)
-						{
-							if(cb[i][j].GetPieceId() >0)
-							{
-								return false;
-							}
-						}
-						if(j == m_point.y && i == m_point.x)
-							return true;
-						else
-							return false;
-					}
-					else 
-						return false;
-				}
-				else if(m_point.x < x)
-				{
-					int i=0,j=0;
-					if(m_point.y > y)
-					{
-						for(j=m_point.y-1,i=m_point.x+1; j> y && i < x;i++,j--)
-						{
-							if(cb[i][j].GetPieceId() >0)
-							{
-								return false;
-							}
-						}
-						if(j == y && i == x)
-							return true;
-						else
-							return false;
-					}
-					else if(m_point.y < y)
-					{
-						for(j=m_point.y+1,i=m_point.x+1; j< y && i < x;i++,j++)
-						{
-							if(cb[i][j].GetPieceId() >0)
-							{
-								return false;
-							}
-						}
-						if(j == y && i == x)
-							return true;
-						else
-							return false;
-					}
-					else
-						return false;
-				}
-				else 
-					return false;
-			break;
-		case KING:
-			if(cb[x][y].GetPieceType() == KING)
-			{
-				return false;
-			}
-			if((m_point.x == x && m_point.y+1 == y) ||
-				  (m_point.x+1 == x && m_point.y+1 == y) ||
-				  (m_point.x +1== x && m_point.y == y) ||
-				  (m_point.x+1 == x && m_point.y-1 == y) ||
-				  (m_point.x == x && m_point.y-1 == y) ||
-				  (m_point.x-1 == x && m_point.y -1 == y) ||
-				  (m_point.x-1 == x && m_point.y == y) ||
-				  (m_point.x -1 == x && m_point.y+1 == y))
-			{				 
-				//check for bishop check
-				//check for king check
-				//check for queen check
-				//check for rook check
-				//check for knight check
-				//check for pawn check
-				if(cb[m_point.x][m_point.y].GetPieceId() == KING_BLACK)
-				{
-					if(x-1>=0 && y-1>=0&&x+1< 8 && y+1 < 8)
-					if((cb[x-1][y-1].GetPieceId() == KING_WHITE || 
-						cb[x-1][y+1].GetPieceId() == KING_WHITE ||
-						cb[x+1][y-1].GetPieceId() == KING_WHITE || 
-						cb[x+1][y+1].GetPieceId() == KING_WHITE ||
-						cb[x-1][y].GetPieceId() == KING_WHITE || 
-						cb[x+1][y].GetPieceId() == KING_WHITE ||
-						cb[x][y-1].GetPieceId() == KING_WHITE || 
-						cb[x][y+1].GetPieceId() == KING_WHITE)) 
-					{						
-						return false;
-					}					 
-				}
-				else if(cb[m_point.x][m_point.y].GetPieceId() == KING_WHITE)
-				{
-					if(x-1>=0 && y-1>=0&&x+1< 8 && y+1 < 8)
-					if(cb[x-1][y-1].GetPieceId() == KING_BLACK ||
-						cb[x-1][y+1].GetPieceId() == KING_BLACK ||
-						cb[x+1][y-1].GetPieceId() == KING_BLACK || 
-						cb[x+1][y+1].GetPieceId() == KING_BLACK ||
-						cb[x-1][y].GetPieceId() == KING_BLACK || 
-						cb[x+1][y].GetPieceId() == KING_BLACK ||
-						cb[x][y-1].GetPieceId() == KING_BLACK ||
-						cb[x][y+1].GetPieceId() == KING_BLACK)
-					{						
-						return false;
-					}					 
-				}
-			
-				cb[m_point.x][m_point.y].GetPieceColor() == BLACK?m_blackKingMovedFlag = true :	m_whiteKingMovedFlag = true;
-				return true;
-			}
-			else if(m_white_on_top == false)
-			{	
-				COLOR_TYPE piececolor = cb[m_point.x][m_point.y].GetPieceColor();
-				if(m_point.x == x && (m_point.x == 7  || m_point.x == 0 ) && m_point.y+2 == y  && ((cb[m_point.x][m_point.y].GetPieceColor() == WHITE ? m_whiteRookRank7MovedFlag:m_blackRookRank7MovedFlag) == false) && cb[m_point.x][m_point.y+1].GetPieceId() < 0 && cb[m_point.x][m_point.y+2].GetPieceId() < 0 && cb[m_point.x][m_point.y+3].GetPieceType() == ROOK && (cb[m_point.x][m_point.y].GetPieceColor() == WHITE ? m_whiteKingMovedFlag:m_blackKingMovedFlag) == false )
-				{					 
-					cb[m_point.x][m_point.y+1].SetPieceData(cb[m_point.x][m_point.y].GetPieceId(),cb[m_point.x][m_point.y].GetPieceColor(),cb[m_point.x][m_point.y].GetPieceType(),cb[m_point.x][m_point.y].GetPieceState());
-					cb[m_point.x][m_point.y].SetPieceData(-1,NONE,BLANK,PIECE_NOT_MOVING);
-					if(CheckKingMove(m_point.x,m_point.y+1,m_point.x,m_point.y+1) == false)
-					{
-						cb[m_point.x][m_point.y].SetPieceData(cb[m_point.x][m_point.y+1].GetPieceId(),cb[m_point.x][m_point.y+1].GetPieceColor(),cb[m_point.x][m_point.y+1].GetPieceType(),cb[m_point.x][m_point.y+1].GetPieceState());
-						cb[m_point.x][m_point.y+1].SetPieceData(-1,NONE,BLANK,PIECE_NOT_MOVING);
-						return false;
-					}
-					cb[m_point.x][m_point.y].SetPieceData(cb[m_point.x][m_point.y+1].GetPieceId(),cb[m_point.x][m_point.y+1].GetPieceColor(),cb[m_point.x][m_point.y+1].GetPieceType(),cb[m_point.x][m_point.y+1].GetPieceState());
-					cb[m_point.x][m_point.y+1].SetPieceData(-1,NONE,BLANK,PIECE_NOT_MOVING);
-
-					cb[m_point.x][m_point.y+2].SetPieceData(cb[m_point.x][m_point.y].GetPieceId(),cb[m_point.x][m_point.y].GetPieceColor(),cb[m_point.x][m_point.y].GetPieceType(),cb[m_point.x][m_point.y].GetPieceState());
-					cb[m_point.x][m_point.y].SetPieceData(-1,NONE,BLANK,PIECE_NOT_MOVING);
-					if(CheckKingMove(m_point.x,m_point.y+2,m_point.x,m_point.y+2) == false)
-					{
-						cb[m_point.x][m_point.y].SetPieceData(cb[m_point.x][m_point.y+2].GetPieceId(),cb[m_point.x][m_point.y+2].GetPieceColor(),cb[m_point.x][m_point.y+2].GetPieceType(),cb[m_point.x][m_point.y+2].GetPieceState());
-						cb[m_point.x][m_point.y+2].SetPieceData(-1,NONE,BLANK,PIECE_NOT_MOVING);
-						return false;
-					}
-					
-					cb[m_point.x][m_point.y].SetPieceData(cb[m_point.x][m_point.y+2].GetPieceId(),cb[m_point.x][m_point.y+2].GetPieceColor(),cb[m_point.x][m_point.y+2].GetPieceType(),cb[m_point.x][m_point.y+2].GetPieceState());
-					cb[m_point.x][m_point.y+2].SetPieceData(-1,NONE,BLANK,PIECE_NOT_MOVING);
-					//cb[m_point.x][m_point.y].GetPieceColor() == BLACK?m_blackRookRank7MovedFlag = true :	m_whiteRookRank7MovedFlag = true;					 
-					piececolor == BLACK?m_blackKingMovedFlag = true :	m_whiteKingMovedFlag = true;
-					//m_SpecialAction = CASTLING;
-					m_castlingFlag = TRUE;
-					return true;
-				}
-				else if(m_point.x == x && (m_point.x == 7 || m_point.x == 0 ) && m_point.y-2 == y && ((cb[m_point.x][m_point.y].GetPieceColor() == WHITE ? m_whiteRookRank1MovedFlag:m_blackRookRank1MovedFlag) == false) && cb[m_point.x][m_point.y-1].GetPieceId() < 0 && cb[m_point.x][m_point.y-2].GetPieceId() < 0 && cb[m_point.x][m_point.y-3].GetPieceId() < 0 && cb[m_point.x][m_point.y-4].GetPieceType() == ROOK && (cb[m_point.x][m_point.y].GetPieceColor() == WHITE ? m_whiteKingMovedFlag:m_blackKingMovedFlag) == false)
-				{
-					/*(cb[m_point.x][m_point.y].GetPieceColor() == WHITE ? m_whiteRookRank7MovedFlag:m_blackRookRank7MovedFlag) == false */
-					cb[m_point.x][m_point.y-1].SetPieceData(cb[m_point.x][m_point.y].GetPieceId(),cb[m_point.x][m_point.y].GetPieceColor(),cb[m_point.x][m_point.y].GetPieceType(),cb[m_point.x][m_point.y].GetPieceState());
-					cb[m_point.x][m_point.y].SetPieceData(-1,NONE,BLANK,PIECE_NOT_MOVING);
-					if(CheckKingMove(m_point.x,m_point.y-1,m_point.x,m_point.y-1) == false)
-					{
-						cb[m_point.x][m_point.y].SetPieceData(cb[m_point.x][m_point.y-1].GetPieceId(),cb[m_point.x][m_point.y-1].GetPieceColor(),cb[m_point.x][m_point.y-1].GetPieceType(),cb[m_point.x][m_point.y-1].GetPieceState());
-						cb[m_point.x][m_point.y-1].SetPieceData(-1,NONE,BLANK,PIECE_NOT_MOVING);
-						return false;
-					}
-					cb[m_point.x][m_point.y].SetPieceData(cb[m_point.x][m_point.y-1].GetPieceId(),cb[m_point.x][m_point.y-1].GetPieceColor(),cb[m_point.x][m_point.y-1].GetPieceType(),cb[m_point.x][m_point.y-1].GetPieceState());
-					cb[m_point.x][m_point.y-1].SetPieceData(-1,NONE,BLANK,PIECE_NOT_MOVING);
-
-					cb[m_point.x][m_point.y-2].SetPieceData(cb[m_point.x][m_point.y].GetPieceId(),cb[m_point.x][m_point.y].GetPieceColor(),cb[m_point.x][m_point.y].GetPieceType(),cb[m_point.x][m_point.y].GetPieceState());
-					cb[m_point.x][m_point.y].SetPieceData(-1,NONE,BLANK,PIECE_NOT_MOVING);
-					if(CheckKingMove(m_point.x,m_point.y-2,m_point.x,m_point.y-2) == false)
-					{
-						cb[m_point.x][m_point.y].SetPieceData(cb[m_point.x][m_point.y-2].GetPieceId(),cb[m_point.x][m_point.y-2].GetPieceColor(),cb[m_point.x][m_point.y-2].GetPieceType(),cb[m_point.x][m_point.y-2].GetPieceState());
-						cb[m_point.x][m_point.y-2].SetPieceData(-1,NONE,BLANK,PIECE_NOT_MOVING);
-						return false;
-					}
-					cb[m_point.x][m_point.y].SetPieceData(cb[m_point.x][m_point.y-2].GetPieceId(),cb[m_point.x][m_point.y-2].GetPieceColor(),cb[m_point.x][m_point.y-2].GetPieceType(),cb[m_point.x][m_point.y-2].GetPieceState());
-					cb[m_point.x][m_point.y-2].SetPieceData(-1,NONE,BLANK,PIECE_NOT_MOVING);
-					/*********Need to check the rule***********/
-					/*cb[m_point.x][m_point.y-3].SetPieceData(cb[m_point.x][m_point.y].GetPieceId(),cb[m_point.x][m_point.y].GetPieceColor(),cb[m_point.x][m_point.y].GetPieceType(),cb[m_point.x][m_point.y].GetPieceState());
-					cb[m_point.x][m_point.y].SetPieceData(-1,NONE,BLANK,PIECE_NOT_MOVING);
- 					if(CheckKingMove(m_point.x,m_point.y-3,m_point.x,m_point.y-3) == false)
-					{
-						cb[m_point.x][m_point.y].SetPieceData(cb[m_point.x][m_point.y-3].GetPieceId(),cb[m_point.x][m_point.y-3].GetPieceColor(),cb[m_point.x][m_point.y-3].GetPieceType(),cb[m_point.x][m_point.y-3].GetPieceState());
-						cb[m_point.x][m_point.y-3].SetPieceData(-1,NONE,BLANK,PIECE_NOT_MOVING);
-						return false;
-					}
-				
-					cb[m_point.x][m_point.y].SetPieceData(cb[m_point.x][m_point.y-3].GetPieceId(),cb[m_point.x][m_point.y-3].GetPieceColor(),cb[m_point.x][m_point.y-3].GetPieceType(),cb[m_point.x][m_point.y-3].GetPieceState());
-					cb[m_point.x][m_point.y-3].SetPieceData(-1,NONE,BLANK,PIECE_NOT_MOVING);*/
-
-					piececolor == BLACK?m_blackKingMovedFlag = true :	m_whiteKingMovedFlag = true;
-					//cb[m_point.x][m_point.y].GetPieceColor() == BLACK?m_blackRookRank1MovedFlag = true :	m_whiteRookRank1MovedFlag = true;					 
-					//m_SpecialAction = CASTLING;
-					m_castlingFlag = TRUE;
-					return true;
-				}
-			}
-			else if(m_white_on_top == true)
-			{			 
-				COLOR_TYPE piececolor = cb[m_point.x][m_point.y].GetPieceColor();
-				if(m_point.x == x && (m_point.x == 7 || m_point.x == 0 ) && m_point.y-2 == y && ((cb[m_point.x][m_point.y].GetPieceColor() == WHITE ? m_whiteRookRank7MovedFlag:m_blackRookRank7MovedFlag) == false)&& cb[m_point.x][m_point.y-1].GetPieceId() < 0 && cb[m_point.x][m_point.y-2].GetPieceId() < 0 && cb[m_point.x][m_point.y-3].GetPieceType() == ROOK && (cb[m_point.x][m_point.y].GetPieceColor() == WHITE ? m_whiteKingMovedFlag:m_blackKingMovedFlag) == false)
-				{
-					
-					cb[m_point.x][m_point.y-1].SetPieceData(cb[m_point.x][m_point.y].GetPieceId(),cb[m_point.x][m_point.y].GetPieceColor(),cb[m_point.x][m_point.y].GetPieceType(),cb[m_point.x][m_point.y].GetPieceState());
-					cb[m_point.x][m_point.y].SetPieceData(-1,NONE,BLANK,PIECE_NOT_MOVING);
-					if(CheckKingMove(m_point.x,m_point.y-1,m_point.x,m_point.y-1) == false)
-					{
-						cb[m_point.x][m_point.y].SetPieceData(cb[m_point.x][m_point.y-1].GetPieceId(),cb[m_point.x][m_point.y-1].GetPieceColor(),cb[m_point.x][m_point.y-1].GetPieceType(),cb[m_point.x][m_point.y-1].GetPieceState());
-						cb[m_point.x][m_point.y-1].SetPieceData(-1,NONE,BLANK,PIECE_NOT_MOVING);
-						return false;
-					}
-					cb[m_point.x][m_point.y].SetPieceData(cb[m_point.x][m_point.y-1].GetPieceId(),cb[m_point.x][m_point.y-1].GetPieceColor(),cb[m_point.x][m_point.y-1].GetPieceType(),cb[m_point.x][m_point.y-1].GetPieceState());
-					cb[m_point.x][m_point.y-1].SetPieceData(-1,NONE,BLANK,PIECE_NOT_MOVING);
+//Ends the game as drawn after a move that leaves a threefold repetition,
+//50 moves without capture or pawn move, or material that cannot mate.
+//The result goes through the same MATCH_DRAWN handling as an engine claim.
+//Returns TRUE when the game was ended.
+BOOL CNetChessView::CheckDrawAdjudication()
+{
+	if(m_fileReadFlag == TRUE || m_iHistory < 0 || m_History[m_iHistory].IsManualEdit())
+		return FALSE;
+	CString reason;
+	if(m_position.IsInsufficientMaterial())
+	{
+		reason = "insufficient material";
+	}
+	else if(GetRepetitionCount() >= 3)
+	{
+		reason = "threefold repetition";
+	}
+	else if(m_position.GetHalfMoveClock() >= 100)
+	{
+		//a mate delivered on the 100th half move still counts
+		CMoveList list;
+		if(GenerateLegalMoves(m_position,list) == 0 && m_position.IsInCheck())
+			return FALSE;
+		reason = "50 move rule";
+	}
+	else
+	{
+		return FALSE;
+	}
+	CString result = "1/2-1/2 {Draw by " + reason + "}";
+	SetPaneText(MESSAGEPANE,"Draw by " + reason,1);
+	//the handler tells the engine to move, tell the one that just moved here
+	if(m_position.GetSide() == SIDE_BLACK)
+	{
+		m_whiteEngine.WriteToEngine("result " + result);
+		OnMyEngineMessage(MATCH_DRAWN_WHITE,result);
+	}
+	else
+	{
+		m_blackEngine.WriteToEngine("result " + result);
+		OnMyEngineMessage(MATCH_DRAWN_BLACK,result);
+	}
+	return TRUE;
+}
 
-					cb[m_point.x][m_point.y-2].SetPieceData(cb[m_point.x][m_point.y].GetPieceId(),cb[m_point.x][m_point.y].GetPieceColor(),cb[m_point.x][m_point.y].GetPieceType(),cb[m_point.x][m_point.y].GetPieceState());
-					cb[m_point.x][m_point.y].SetPieceData(-1,NONE,BLANK,PIECE_NOT_MOVING);
-					if(CheckKingMove(m_point.x,m_point.y-2,m_point.x,m_point.y-2) == false)
-					{
-						cb[m_point.x][m_point.y-2].SetPieceData(cb[m_point.x][m_point.y].GetPieceId(),cb[m_point.x][m_point.y].GetPieceColor(),cb[m_point.x][m_point.y].GetPieceType(),cb[m_point.x][m_point.y].GetPieceState());
-						cb[m_point.x][m_point.y].SetPieceData(-1,NONE,BLANK,PIECE_NOT_MOVING);
-						return false;
-					}
-					cb[m_point.x][m_point.y].SetPieceData(cb[m_point.x][m_point.y-2].GetPieceId(),cb[m_point.x][m_point.y-2].GetPieceColor(),cb[m_point.x][m_point.y-2].GetPieceType(),cb[m_point.x][m_point.y-2].GetPieceState());		 
-					cb[m_point.x][m_point.y-2].SetPieceData(-1,NONE,BLANK,PIECE_NOT_MOVING);
+//Ends an engine against engine game once the board position is in the
+//tablebases, with the result they give, as CheckDrawAdjudication does.
+void CNetChessView::CheckTablebaseAdjudication()
+{
+	if(!m_tablebase.IsOpen() || m_whiteAsEngineFlag == FALSE || m_blackAsEngineFlag == FALSE ||
+		m_fileReadFlag == TRUE || m_iHistory < 0 || m_History[m_iHistory].IsManualEdit())
+		return;
+	int wdl;
+	if(!m_tablebase.ProbeWDL(m_position,wdl))
+		return;
+	//mate and stalemate end the game on their own
+	CMoveList list;
+	if(GenerateLegalMoves(m_position,list) == 0)
+		return;
+	BOOL whiteWins = wdl == TBWDL_WIN ? m_position.GetSide() == SIDE_WHITE : m_position.GetSide() == SIDE_BLACK;
+	CString result, reason;
+	if(wdl == TBWDL_DRAW)
+	{
+		reason = "Draw by tablebase";
+		result = "1/2-1/2 {Draw by tablebase}";
+	}
+	else if(whiteWins)
+	{
+		reason = "White wins by tablebase";
+		result = "1-0 {White wins by tablebase}";
+	}
+	else
+	{
+		reason = "Black wins by tablebase";
+		result = "0-1 {Black wins by tablebase}";
+	}
+	SetPaneText(MESSAGEPANE,reason,1);
+	//the handler tells the engine to move, tell the one that just moved here
+	if(m_position.GetSide() == SIDE_BLACK)
+	{
+		m_whiteEngine.WriteToEngine("result " + result);
+		OnMyEngineMessage(wdl == TBWDL_DRAW ? MATCH_DRAWN_WHITE : whiteWins ? WHITE_WON_WHITE : BLACK_WON_WHITE,result);
+	}
+	else
+	{
+		m_blackEngine.WriteToEngine("result " + result);
+		OnMyEngineMessage(wdl == TBWDL_DRAW ? MATCH_DRAWN_BLACK : whiteWins ? WHITE_WON_BLACK : BLACK_WON_BLACK,result);
+	}
+}
 
-					piececolor == BLACK?m_blackKingMovedFlag = true :	m_whiteKingMovedFlag = true;
-				 	//cb[m_point.x][m_point.y].GetPieceColor() == BLACK?m_blackRookRank7MovedFlag = true :	m_whiteRookRank7MovedFlag = true;
-				 
-					//m_SpecialAction = CASTLING;
-					m_castlingFlag = TRUE;
-					return true;
-				}
-				else if(m_point.x == x && (m_point.x == 7 || m_point.x == 0 ) && m_point.y+2 == y && ((cb[m_point.x][m_point.y].GetPieceColor() == WHITE ? m_whiteRookRank1MovedFlag:m_blackRookRank1MovedFlag) == false)&& cb[m_point.x][m_point.y+1].GetPieceId() < 0 && cb[m_point.x][m_point.y+2].GetPieceId() < 0 && cb[m_point.x][m_point.y+3].GetPieceId() < 0 && cb[m_point.x][m_point.y+4].GetPieceType() == ROOK && (cb[m_point.x][m_point.y].GetPieceColor() == WHITE ? m_whiteKingMovedFlag:m_blackKingMovedFlag) == false)
-				{
-					cb[m_point.x][m_point.y+1].SetPieceData(cb[m_point.x][m_point.y].GetPieceId(),cb[m_point.x][m_point.y].GetPieceColor(),cb[m_point.x][m_point.y].GetPieceType(),cb[m_point.x][m_point.y].GetPieceState());
-					cb[m_point.x][m_point.y].SetPieceData(-1,NONE,BLANK,PIECE_NOT_MOVING);
-					if(CheckKingMove(m_point.x,m_point.y+1,m_point.x,m_point.y+1) == false)
-					{
-						cb[m_point.x][m_point.y].SetPieceData(cb[m_point.x][m_point.y+1].GetPieceId(),cb[m_point.x][m_point.y+1].GetPieceColor(),cb[m_point.x][m_point.y+1].GetPieceType(),cb[m_point.x][m_point.y+1].GetPieceState());
-						cb[m_point.x][m_point.y+1].SetPieceData(-1,NONE,BLANK,PIECE_NOT_MOVING);
-						return false;
-					}
-					cb[m_point.x][m_point.y].SetPieceData(cb[m_point.x][m_point.y+1].GetPieceId(),cb[m_point.x][m_point.y+1].GetPieceColor(),cb[m_point.x][m_point.y+1].GetPieceType(),cb[m_point.x][m_point.y+1].GetPieceState());
-					cb[m_point.x][m_point.y+1].SetPieceData(-1,NONE,BLANK,PIECE_NOT_MOVING);
+//The lines of the engines' analysis that changed since the last call, in
+//the message pane. Called on a timer, so an engine sending hundreds of
+//lines a second costs one redraw per interval.
+void CNetChessView::ShowAnalysis()
+{
+	CEngine *engines[2] = {&m_whiteEngine,&m_blackEngine};
+	CString str;
+	BOOL changed = FALSE;
+	for(int i = 0; i < 2; i++)
+	{
+		CEngine &engine = *engines[i];
+		if(engine.m_engineFlag == FALSE || engine.m_analysis.GetCount() == 0)
+			continue;
+		if(engine.m_analysis.GetUpdates() != engine.m_analysisShown)
+		{
+			engine.m_analysisShown = engine.m_analysis.GetUpdates();
+			changed = TRUE;
+		}
+		char buf[ANALYSIS_PV_SIZE + 64];
+		CString name = engine.m_engineName.IsEmpty() ? (i == 0 ? "White" : "Black") : engine.m_engineName;
+		str += (str.IsEmpty() ? "" : "    ") + name + ":";
+		for(int k = 0; k < engine.m_analysis.GetCount(); k++)
+		{
+			engine.m_analysis.FormatLine(k,&m_position,buf,sizeof(buf));
+			str += (k == 0 ? " " : " | ") + (CString)buf;
+		}
+		engine.m_analysis.FormatStatus(buf,sizeof(buf));
+		str += " (" + (CString)buf + ")";
+	}
+	if(changed)
+		SetPaneText(MESSAGEPANE,str);
+}
 
-					cb[m_point.x][m_point.y+2].SetPieceData(cb[m_point.x][m_point.y].GetPieceId(),cb[m_point.x][m_point.y].GetPieceColor(),cb[m_point.x][m_point.y].GetPieceType(),cb[m_point.x][m_point.y].GetPieceState());
-					cb[m_point.x][m_point.y].SetPieceData(-1,NONE,BLANK,PIECE_NOT_MOVING);
-					if(CheckKingMove(m_point.x,m_point.y+2,m_point.x,m_point.y+2) == false)
-					{
-						cb[m_point.x][m_point.y].SetPieceData(cb[m_point.x][m_point.y+2].GetPieceId(),cb[m_point.x][m_point.y+2].GetPieceColor(),cb[m_point.x][m_point.y+2].GetPieceType(),cb[m_point.x][m_point.y+2].GetPieceState());
-						cb[m_point.x][m_point.y+2].SetPieceData(-1,NONE,BLANK,PIECE_NOT_MOVING);
-						return false;
-					}
-					cb[m_point.x][m_point.y].SetPieceData(cb[m_point.x][m_point.y+2].GetPieceId(),cb[m_point.x][m_point.y+2].GetPieceColor(),cb[m_point.x][m_point.y+2].GetPieceType(),cb[m_point.x][m_point.y+2].GetPieceState());
-					cb[m_point.x][m_point.y+2].SetPieceData(-1,NONE,BLANK,PIECE_NOT_MOVING);
+//Counts the result of an engine against engine game (whiteHalfPoints 2
+//for 1-0, 1 for a draw, 0 for 0-1) in the match between the two engines,
+//which starts over when other engines play. Both engines may claim the
+//same result, it is counted once. Returns the match statistics to show
+//with the result.
+CString CNetChessView::RecordMatchResult(int whiteHalfPoints,CString text)
+{
+	if(m_whiteAsEngineFlag == FALSE || m_blackAsEngineFlag == FALSE || text.Find("offer draw",0) == 0)
+		return "";
+	CString white = m_whiteEngine.m_engineFile.Mid(m_whiteEngine.m_engineFile.ReverseFind('\\') + 1);
+	CString black = m_blackEngine.m_engineFile.Mid(m_blackEngine.m_engineFile.ReverseFind('\\') + 1);
+	//games played here need not replay one opening with the colours
+	//reversed, so they are counted one by one rather than in pairs
+	if(m_iHistory != m_matchResultPly || m_position.GetKey() != m_matchResultKey)
+	{
+		m_matchResultPly = m_iHistory;
+		m_matchResultKey = m_position.GetKey();
+		if(white == m_matchEngines[0] && black == m_matchEngines[1])
+		{
+			m_matchStats.AddGame(whiteHalfPoints,false);
+		}
+		else if(white == m_matchEngines[1] && black == m_matchEngines[0])
+		{
+			m_matchStats.AddGame(2 - whiteHalfPoints,false);
+		}
+		else
+		{
+			m_matchStats.Reset();
+			m_matchEngines[0] = white;
+			m_matchEngines[1] = black;
+			m_matchStats.AddGame(whiteHalfPoints,false);
+		}
+	}
+	CString str = "\n\n" + m_matchEngines[0] + " against " + m_matchEngines[1] + "\n";
+	str += m_matchStats.Format().c_str();
+	if(m_matchStats.GetSPRTResult() != SPRT_CONTINUE)
+		str += "\nThe test is decided, no more games are needed.";
+	return str;
+}
 
-					/*cb[m_point.x][m_point.y+3].SetPieceData(cb[m_point.x][m_point.y].GetPieceId(),cb[m_point.x][m_point.y].GetPieceColor(),cb[m_point.x][m_point.y].GetPieceType(),cb[m_point.x][m_point.y].GetPieceState());
-					cb[m_point.x][m_point.y].SetPieceData(-1,NONE,BLANK,PIECE_NOT_MOVING);
-					if(CheckKingMove(m_point.x,m_point.y+3,m_point.x,m_point.y+3) == false)
-					{
-						cb[m_point.x][m_point.y].SetPieceData(cb[m_point.x][m_point.y+3].GetPieceId(),cb[m_point.x][m_point.y+3].GetPieceColor(),cb[m_point.x][m_point.y+3].GetPieceType(),cb[m_point.x][m_point.y+3].GetPieceState());
-						cb[m_point.x][m_point.y+3].SetPieceData(-1,NONE,BLANK,PIECE_NOT_MOVING);
-						return false;
-					}
-					cb[m_point.x][m_point.y].SetPieceData(cb[m_point.x][m_point.y+3].GetPieceId(),cb[m_point.x][m_point.y+3].GetPieceColor(),cb[m_point.x][m_point.y+3].GetPieceType(),cb[m_point.x][m_point.y+3].GetPieceState());
-					cb[m_point.x][m_point.y+3].SetPieceData(-1,NONE,BLANK,PIECE_NOT_MOVING);*/
-
-					piececolor == BLACK?m_blackKingMovedFlag = true :	m_whiteKingMovedFlag = true;
-					//cb[m_point.x][m_point.y].GetPieceColor() == BLACK?m_blackRookRank1MovedFlag = true :	m_whiteRookRank1MovedFlag = true;
-					//m_SpecialAction = CASTLING;
-					m_castlingFlag = TRUE;
-					return true;
-				}
-			}
-			return false;
-			break;
-		default:
-			break;
-		}	 
+bool CNetChessView::CheckValidMove(int x,int y)
+{
+	//if( m_checkmove== FALSE)
+	//	return true;
+	int from = GetBoardSquare(m_point.x,m_point.y);
+	int piece = m_position.GetPiece(from);
+	CHESSMOVE move = m_position.FindMove(from,GetBoardSquare(x,y));
+	if(move == NULL_MOVE)
+		return false;
+	if(GetMoveFlag(move) == MOVEFLAG_ENPASSANT)
+	{
+		m_enpassentFlag = TRUE;
+	}
+	else if(GetMoveFlag(move) == MOVEFLAG_CASTLE)
+	{
+		m_castlingFlag = TRUE;
+	}
+	switch(piece)
+	{
+	case WHITE_KING:
+		m_whiteKingMovedFlag = true;
+		break;
+	case BLACK_KING:
+		m_blackKingMovedFlag = true;
+		break;
+	case WHITE_ROOK:
+		if(from == 0)
+			m_whiteRookRank1MovedFlag = true;
+		else if(from == 7)
+			m_whiteRookRank7MovedFlag = true;
+		break;
+	case BLACK_ROOK:
+		if(from == 56)
+			m_blackRookRank1MovedFlag = true;
+		else if(from == 63)
+			m_blackRookRank7MovedFlag = true;
+		break;
+	default:
+		break;
+	}
 	return true;
 }
  
@@ -6122,18 +5549,6 @@ int CNetChessView::OnLButtonUpAction(UINT nFlags, CPoint point)
 				rgn.CreateEllipticRgn(rect.left, rect.top, rect.right, rect.bottom);	
 				if(rgn.PtInRegion(point)&&rect != cb[m_point.x][m_point.y].GetRect())
 				{						
-					int flipflag = FALSE;
-					if(m_white_on_top == true)
-					{
-						m_white_on_top = false;
-						m_point.x = 7 - m_point.x;
-						m_point.y = 7 - m_point.y;
-						i = 7 - i;
-						j = 7 - j;						
-						FlipBoard();
-						flipflag = TRUE;						
-					}
-				
 					int piece_id;
 					COLOR_TYPE  piece_color;
 					PIECE_TYPE  piece_type;
@@ -6161,13 +5576,6 @@ int CNetChessView::OnLButtonUpAction(UINT nFlags, CPoint point)
 
 					if(piece_color == to_piece_color)
 					{						
-					
-						if(m_white_on_top == false && flipflag == TRUE)
-						{							
-							FlipBoard();
-							flipflag = FALSE;
-							m_white_on_top = true;
-						}
 						SetPaneText(MESSAGEPANE, "Invalid move! From piece color is same as to piece_color",1);
 						//if(m_demoFlag == FALSE)
 						//	AfxMessageBox("Invalid move! From piece color is same as to piece_color");
@@ -6200,82 +5608,25 @@ int CNetChessView::OnLButtonUpAction(UINT nFlags, CPoint point)
 						if(nFlags != 255)
 						{
 							bool checkstate = CheckCheckState(cb[m_point.x][m_point.y].GetPieceType(),cb[m_point.x][m_point.y].GetPieceColor(),i,j);
-							if(m_white_on_top == false)
+							//the history keeps absolute squares, whichever way up the board is shown
+							int from = GetBoardSquare(m_point.x,m_point.y);
+							int to = GetBoardSquare(i,j);
+							if(m_enpassentFlag == TRUE)
 							{
-								//if(m_SpecialAction == ENPASSENT)
-								if(m_enpassentFlag == TRUE)
-								{
-									m_History[m_iHistory].GetHistory(
-										piece_side,
-										from_piece_type, from_color_type,from_pieceid,
-										from_row_id,from_col_id, to_piecetype,
-										to_colortype,to_pieceid,to_row_id,
-										to_col_id);
-									m_History[++m_iHistory].SetHistory(BOTTOM,
-										piece_type,piece_color,piece_id,m_point.x,m_point.y,
-										to_piece_type,to_piece_color,to_piece_id,i,j); 									
-									if(checkstate == true)
-									{
-										m_checkFlag = TRUE;
-									}
-								}
-								else if(m_castlingFlag == TRUE)
-								{
-									  
-									m_History[++m_iHistory].SetHistory(BOTTOM,
-										piece_type,piece_color,piece_id,m_point.x,m_point.y,
-										to_piece_type,to_piece_color,to_piece_id,i,j); 
-	
-								}
-								else
-								{
-									m_History[++m_iHistory].SetHistory(BOTTOM,
-										piece_type,piece_color,piece_id,m_point.x,m_point.y,
-										to_piece_type,to_piece_color,to_piece_id,i,j);
-
-									if(checkstate == true)
-									{
-										m_checkFlag = TRUE;
-									}
-								}
+								//the pawn taken is beside the one moving
+								GetBoardCell(MakeSquare(SquareFile(to),SquareRank(from)),to_row_id,to_col_id);
 							}
-							else
+							m_History[++m_iHistory].SetHistory(BOTTOM,
+								piece_type,piece_color,piece_id,7-SquareRank(from),SquareFile(from),
+								to_piece_type,to_piece_color,to_piece_id,7-SquareRank(to),SquareFile(to));
+							if(checkstate == true && m_castlingFlag == FALSE)
 							{
-								if(m_enpassentFlag == TRUE)
-								{
-									m_History[m_iHistory].GetHistory(
-										piece_side,
-										from_piece_type, from_color_type,from_pieceid,
-										from_row_id,from_col_id, to_piecetype,
-										to_colortype,to_pieceid,to_row_id,
-										to_col_id);
-									m_History[++m_iHistory].SetHistory(BOTTOM,
-										piece_type,piece_color,piece_id,7-m_point.x,7-m_point.y,
-										to_piece_type,to_piece_color,to_piece_id,7-i,7-j);
-
-									if(checkstate == true)
-									{
-										m_checkFlag = TRUE;
-									}
-								}
-								else if(m_castlingFlag == TRUE)
-								{
-									m_History[++m_iHistory].SetHistory(BOTTOM,
-										piece_type,piece_color,piece_id,7-m_point.x,7-m_point.y,
-										to_piece_type,to_piece_color,to_piece_id,7-i,7-j);
-								}
-								else
-								{
-									m_History[++m_iHistory].SetHistory(BOTTOM,piece_type,piece_color,piece_id,7-m_point.x,7-m_point.y,
-										to_piece_type,to_piece_color,to_piece_id,7-i,7-j);
-								
-									if(checkstate == true)
-									{
-										m_checkFlag = TRUE;
-									}
-								}
+								m_checkFlag = TRUE;
 							}
 							m_topHistory = m_iHistory;
+							//moves the rules do not know (m_checkmove off) are played as plain moves
+							CHESSMOVE move = m_position.FindMove(from,to);
+							MakePositionMove(move != NULL_MOVE ? move : EncodeMove(from,to));
 						}						 
 						 
 						if(m_enpassentFlag == TRUE)
@@ -6318,17 +5669,7 @@ int CNetChessView::OnLButtonUpAction(UINT nFlags, CPoint point)
 							//writeMessage("CheckKingMove invalid move %d %d %c",m_point.x,m_point.y,cb[m_point.x][m_point.y].GetPieceId());
 							OnEditUndoAction(0);							
 							nFlags = 255;
-							if(m_white_on_top == false && flipflag == TRUE)
-							{
-								m_point.x = 7 - m_point.x;
-								m_point.y = 7 - m_point.y;
-								i = 7 - i;
-								j = 7 - j;
-								FlipBoard();
-								m_movedFromRect = m_movedToRect = 0;								
-								flipflag = FALSE;
-								m_white_on_top = true;
-							}
+							m_movedFromRect = m_movedToRect = 0;
 							SetPaneText(MESSAGEPANE,"Invalid move! King is on check after this move",1);
 							//if(m_demoFlag == FALSE)
 							//	AfxMessageBox("Invalid move! King is on check after this move");
@@ -6352,6 +5693,10 @@ int CNetChessView::OnLButtonUpAction(UINT nFlags, CPoint point)
 									foundflag = 1;
 							}					
 								
+							CHESSMOVE move = m_History[m_iHistory].GetMove();
+							int from = GetMoveFrom(move);
+							int to = GetMoveTo(move);
+							int promotion = MOVEFLAG_NORMAL;
 							if(foundflag == 1)
 							{								
 								int to_piece_id;
@@ -6377,4025 +5722,1815 @@ int CNetChessView::OnLButtonUpAction(UINT nFlags, CPoint point)
 									to_piece_id = dlg.m_piecked_piece;
 									to_piece_color = dlg.m_piece_color;
 									to_piece_type = dlg.m_piece_type;						 						 
-								}								
+								}
+								promotion = PieceType(PieceTypeToPosition(to_piece_type,to_piece_color));
 								cb[i][j].SetPieceState(PIECE_NOT_MOVING);
 							//	m_player_turn = m_player_turn == WHITE ? BLACK: WHITE;								
 								m_iHistory--;
-								if(m_white_on_top == false)
-								{
-									
-									m_History[++m_iHistory].SetHistory(BOTTOM,
-										from_piece_type, from_color_type,from_pieceid,
-										from_row_id,from_col_id,
-										to_piece_type,to_piece_color,to_piece_id,i,j);
-									m_promotionFlag = TRUE;
-								}
-								else
-								{
-									m_History[++m_iHistory].SetHistory(BOTTOM,
-										from_piece_type, from_color_type,from_pieceid,
-										7-from_row_id,7-from_col_id,
-										to_piece_type,to_piece_color,to_piece_id,7-i,7-j);
-									m_promotionFlag = TRUE;
-								}							
+								m_History[++m_iHistory].SetHistory(BOTTOM,
+									from_piece_type, from_color_type,from_pieceid,
+									from_row_id,from_col_id,
+									to_piece_type,to_piece_color,to_piece_id,7-SquareRank(to),SquareFile(to));
+								m_promotionFlag = TRUE;
+								//SetHistory dropped the promotion, the move sent on names the piece picked
+								m_position.UnmakeMove(move,m_History[m_iHistory].GetUndoInfo());
+								move = EncodeMove(from,to,promotion);
+								MakePositionMove(move);
 								SetMoveHistory();
-								m_topHistory = m_iHistory;
-								cb[i][j].SetPieceData(to_piece_id,to_piece_color,to_piece_type,PIECE_NOT_MOVING);
-
-								char data[30];
-								memset(data,-1,30);
-								data[0] = MOVE;
-								data[1] = m_white_on_top == false?FALSE:TRUE;
-								data[2] = (char)m_point.x;
-								data[3] = (char)m_point.y;
-	   							data[4] = i;
-								data[5] = j;
-								data[6] = 1;
-								memcpy(&data[7],&to_piece_id,4);
-								data[11] = to_piece_color;
-								data[12] = to_piece_type;
-								memcpy(&data[13],&m_whiteTime,4);
-								memcpy(&data[17],&m_blackTime,4);
-								//if(m_moveFlag == FALSE)
-								{
-									SendSockData((unsigned char*)data,21);
-								}								
-								/*else
-									SendToEngine((unsigned char*)data,13);*/
-								//m_moveFlag = FALSE;//move is done, so make it false							
-								m_movedFromRect = cb[m_point.x][m_point.y].GetRect();
-								m_movedToRect = cb[i][j].GetRect();
-							}
-						}
-						/************/
-						else if(nFlags != 255)//king move is not valid
-						{
-							SetMoveHistory();
-							char data[30];
-							memset(data,-1,25);
-							data[0] = MOVE;
-							data[1] = m_white_on_top == false?FALSE:TRUE;
-							data[2] = (char)m_point.x;
-							data[3] = (char)m_point.y;
-	   						data[4] = i;
-							data[5] = j;						
-							data[6] = 0;
-							//if(m_moveFlag == FALSE)
-							{							
-								SendSockData((unsigned char*)data,7);
-							}
-							//else
-							//	SendToEngine((unsigned char*)data,7);
-							m_moveFlag = FALSE;
-							m_movedFromRect = cb[m_point.x][m_point.y].GetRect();
-							m_movedToRect = cb[i][j].GetRect();
-						}						
-					}
-					else
-					{
-						
-						//writeMessage("%d %d %c is an invalid move to %d %d %c",
-						//	m_point.x,m_point.y,cb[m_point.x][m_point.y].GetPieceId(),i,j,cb[i][j].GetPieceId());
-						m_movedFromRect = m_movedToRect = 0;
-						if(flipflag == TRUE)
-						{
-							m_point.x = 7 - m_point.x;
-							//m_point.y = 7 - m_point.y;
-							i = 7 - i;
-							//j = 7 - j;
-							CString str;
-							str.Format("Invalid move! %c%d %c is an invalid move to %c%d %c",
-								'a'+ m_point.y,m_point.x+1,cb[m_point.x][m_point.y].GetPieceId(),
-								'a'+ j,i+1,cb[i][j].GetPieceId());
-							SetPaneText(MESSAGEPANE,str,1);
-							//if (m_demoFlag == FALSE)
-								//AfxMessageBox(str);
-							FlipBoard();
-							m_movedFromRect = m_movedToRect = 0;								
-							flipflag = FALSE;
-							m_white_on_top = true;
-						}
-						else
-						{
-							m_point.x = 7 - m_point.x;
-							//m_point.y = 7 - m_point.y;
-							i = 7 - i;
-							//j = 7 - j;*/
-							CString str;
-							str.Format("Invalid move! %c%d %c is an invalid move to %c%d %c",
-								'a'+ m_point.y,m_point.x+1,cb[m_point.x][m_point.y].GetPieceId(),
-								'a'+ j,i+1,cb[i][j].GetPieceId());
-							SetPaneText(MESSAGEPANE,str,1);
-							//if (m_demoFlag == FALSE)
-								//AfxMessageBox(str);
-						}
-						m_point.x = m_point.y = -1;
-						SetLearning(FALSE);
-						DrawBoard();	 
-						return -1;
-					}
-					CString lastMoveInfo = "";
-					if(m_checkFlag == TRUE)
-					{
-						lastMoveInfo = " Check! ";
-					}
-					else if(m_castlingFlag == TRUE)
-					{
-						lastMoveInfo = " Castling! " + lastMoveInfo;
-					}
-					else if(m_enpassentFlag == TRUE)
-					{					
-						lastMoveInfo = " En passent! " + lastMoveInfo;
-					}
-					lastMoveInfo = "MOVE: " + GetSingleMoveString(m_iHistory) + lastMoveInfo;
-					SetPaneText(MESSAGEPANE,lastMoveInfo,1);
-					m_History[m_iHistory].SetMoveInfo(lastMoveInfo);
-					CStringArray sa;
-					GetHistoryString(sa,1);					
-					if(sa.GetSize() > 0)
-					{
-						if(sa.GetSize() -1 == m_listctrl_movehistory.GetCount())
-						{
-							m_listctrl_movehistory.InsertString(-1,sa.GetAt(m_iHistory));
-							m_listctrl_movehistory.SetCurSel(m_iHistory);
-						}
-						else
-						{							
-							m_listctrl_movehistory.ResetContent();
-							for(int i=0;i<=m_iHistory;i++)
-							{
-								m_listctrl_movehistory.InsertString(-1,sa.GetAt(i));
-							}
-							m_listctrl_movehistory.SetCurSel(m_iHistory);							
-						}
-					}
-					if(piece_id == 'P' || piece_id == 'p' || to_piece_id != -1)
-					{
-						m_halfMoveCount = 1;
-					}
-					else
-					{
-						if(m_halfMoveCount >= 1)
-							m_halfMoveCount++;
-					}
-					m_History[m_iHistory].SetHalfMoveCount(m_halfMoveCount);
-					m_checkFlag = m_castlingFlag = m_enpassentFlag = m_promotionFlag =
-						m_ambiguousMoveRankFlag = m_ambiguousMoveFileFlag = FALSE;
-					if(m_white_on_top == false && flipflag == TRUE)
-					{
-						m_point.x = 7 - m_point.x;
-						m_point.y = 7 - m_point.y;
-						i = 7 - i;
-						j = 7 - j;
-						FlipBoard();
-						if(m_movedFromRect != 0)
-						{
-							m_movedFromRect = cb[m_point.x][m_point.y].GetRect();
-							m_movedToRect = cb[i][j].GetRect();
-						}
-						flipflag = FALSE;
-						m_white_on_top = true;
-					}
-					m_point.x = m_point.y = -1;
-					SetLearning(FALSE);
-					DrawBoard();
-					/*//IF white is the first move and not in network and ICS not connected
-					if(m_iHistory == 0 && m_blackAsEngineFlag == FALSE && m_pClientSocket == NULL && m_icsFlag == FALSE && m_optDlg.m_check_black_engine_auto_start == TRUE)
-					{
-						OnButtonBlackRadioButtonComputer();
-					}*/
-					return 0;
-				}
-			}
-		}
-	}
-	m_movedFromRect = m_movedToRect = 0;
-	m_point.x = m_point.y = -1;
-	SetLearning(FALSE);
-	DrawBoard();
-	return -1;
-}
-
-void CNetChessView::OnMouseMoveAction(UINT nFlags, CPoint point) 
-{
-	// TODO: Add your message handler code here and/or call default
-	if(m_mouseMoveFlag == false)
-		return;	 
-	if(((m_whiteAsEngineFlag ==TRUE && m_pieceSide == WHITE && m_whiteEngineOnlyAnalyze == FALSE) || 
-		(m_blackAsEngineFlag == TRUE && m_pieceSide ==BLACK && m_blackEngineOnlyAnalyze == FALSE)) )
-	{
-		//SetPaneText(MESSAGEPANE,"Connected to network and Engine is playing",0);
-		return;
-	}
-	 
-	CRect rect( point.x -25, point.y - 25, point.x + 25, point.y + 25);				  
-	m_moveRect = rect;	 
-	DrawBoard();	 
-}
-
-void CNetChessView::OnEditUndo() 
-{
-	// TODO: Add your command handler code here	
-	OnEditUndoAction(1);
- 	unsigned char msg[2];
-	msg[0]= UNDO;
-	msg[1]=1;
-	SendSockData((unsigned char*)msg,2);
-
-}
-void CNetChessView::OnEditUndoAction(int redraw)
-{
-	if(m_iHistory < 0)
-	{
-		return;
-	}
-	PIECE_SIDE piece_side;
-	PIECE_TYPE from_piece_type;
-	COLOR_TYPE from_color_type;
-	int from_pieceid;
-	int from_row_id;
-	int from_col_id;
-	PIECE_TYPE to_piece_type;
-	COLOR_TYPE to_color_type;
-	int to_pieceid;
-	int to_row_id;
-	int to_col_id;
-	if(m_pClientSocket == NULL)
-	{
-		m_player_turn = true;
-		m_pieceSide = m_pieceSide == WHITE ? BLACK: WHITE;
-	}
-	else
-	{
-		if(m_player_turn == true)
-		{
-			m_player_turn =false;
-		}
-		else
-		{
-			m_player_turn = true;
-		}
-	}
-	m_History[m_iHistory].GetHistory(
-		piece_side,
-		from_piece_type, from_color_type,from_pieceid,
-		from_row_id,from_col_id, to_piece_type,
-		to_color_type,to_pieceid,to_row_id,
-		to_col_id);	
-
-	if(m_white_on_top == false) 		 
-	{
-		cb[from_row_id][from_col_id].SetPieceData(
-			from_pieceid,from_color_type,from_piece_type,
-			PIECE_NOT_MOVING);
-
-		cb[to_row_id][to_col_id].SetPieceData(
-				to_pieceid,to_color_type,to_piece_type,
-				PIECE_NOT_MOVING);	 	 
-		if(m_History[m_iHistory].GetEnPassentFlag() == TRUE)			
-		{
-			PIECE_SIDE piece_side;
-			PIECE_TYPE from_piece_type;
-			COLOR_TYPE from_color_type;
-			int from_pieceid;
-			int from_row_id;
-			int from_col_id;
-			PIECE_TYPE to_piece_type;
-			COLOR_TYPE to_color_type;
-			int to_pieceid;
-			int to_row_id;
-			int to_col_id;
-			m_History[m_iHistory-1].GetHistory(
-				piece_side,
-				from_piece_type, from_color_type,from_pieceid,
-				from_row_id,from_col_id, to_piece_type,
-				to_color_type,to_pieceid,to_row_id,
-				to_col_id);
-			cb[to_row_id][to_col_id].SetPieceData(
-				from_pieceid,from_color_type,from_piece_type,
-				PIECE_NOT_MOVING);			
-		}
-		else if(m_History[m_iHistory].GetCastlingFlag() == TRUE)			
-		{
-			if(cb[from_row_id][from_col_id+1].GetPieceType() == ROOK)
-			{
-				cb[from_row_id][7].SetPieceData(cb[from_row_id][from_col_id+1].GetPieceId(),
-					cb[from_row_id][from_col_id+1].GetPieceColor(),
-					cb[from_row_id][from_col_id+1].GetPieceType(),
-					PIECE_NOT_MOVING);
-				cb[from_row_id][from_col_id+1].SetPieceData(-1,NONE,BLANK,PIECE_NOT_MOVING);
-			}
-			else if(cb[from_row_id][from_col_id-1].GetPieceType() == ROOK)
-			{
-				cb[from_row_id][0].SetPieceData(cb[from_row_id][from_col_id-1].GetPieceId(),
-					cb[from_row_id][from_col_id-1].GetPieceColor(),
-					cb[from_row_id][from_col_id-1].GetPieceType(),
-					PIECE_NOT_MOVING);
-				cb[from_row_id][from_col_id-1].SetPieceData(-1,NONE,BLANK,PIECE_NOT_MOVING);
-			}
-		}
-		else if(m_History[m_iHistory].GetPromotionFlag() == TRUE)
-		{
-			cb[to_row_id][to_col_id].SetPieceData(-1,NONE,BLANK,PIECE_NOT_MOVING);
-		}
-	}	
-	else
-	{
-		cb[7-from_row_id][7-from_col_id].SetPieceData(
-			from_pieceid,from_color_type,from_piece_type,
-			PIECE_NOT_MOVING);
-
-		cb[7-to_row_id][7-to_col_id].SetPieceData(
-				to_pieceid,to_color_type,to_piece_type,
-				PIECE_NOT_MOVING);	 	 
-		if(m_History[m_iHistory].GetEnPassentFlag() == TRUE)
-		{
-			PIECE_SIDE piece_side;
-			PIECE_TYPE from_piece_type;
-			COLOR_TYPE from_color_type;
-			int from_pieceid;
-			int from_row_id;
-			int from_col_id;
-			PIECE_TYPE to_piece_type;
-			COLOR_TYPE to_color_type;
-			int to_pieceid;
-			int to_row_id;
-			int to_col_id;
-			m_History[m_iHistory-1].GetHistory(
-				piece_side,
-				from_piece_type, from_color_type,from_pieceid,
-				from_row_id,from_col_id, to_piece_type,
-				to_color_type,to_pieceid,to_row_id,
-				to_col_id);
-			cb[7-to_row_id][7-to_col_id].SetPieceData(
-				from_pieceid,from_color_type,from_piece_type,
-				PIECE_NOT_MOVING);
-		}
-		else if(m_History[m_iHistory].GetCastlingFlag() == TRUE)
-		{
-			if(cb[7-from_row_id][7-from_col_id+1].GetPieceType() == ROOK)
-			{
-				cb[7-from_row_id][7].SetPieceData(cb[7-from_row_id][7-from_col_id+1].GetPieceId(),
-					cb[7-from_row_id][7-from_col_id+1].GetPieceColor(),
-					cb[7-from_row_id][7-from_col_id+1].GetPieceType(),
-					PIECE_NOT_MOVING);
-				cb[7-from_row_id][7-from_col_id+1].SetPieceData(-1,NONE,BLANK,PIECE_NOT_MOVING);
-			}
-			else if(cb[7-from_row_id][7-from_col_id-1].GetPieceType() == ROOK)
-			{
-				cb[7-from_row_id][0].SetPieceData(cb[7-from_row_id][7-from_col_id-1].GetPieceId(),
-					cb[7-from_row_id][7-from_col_id-1].GetPieceColor(),
-					cb[7-from_row_id][7-from_col_id-1].GetPieceType(),
-					PIECE_NOT_MOVING);
-				cb[7-from_row_id][7-from_col_id-1].SetPieceData(-1,NONE,BLANK,PIECE_NOT_MOVING);
-			}
-		}
-		else if(m_History[m_iHistory].GetPromotionFlag() == TRUE)
-		{
-			cb[7-to_row_id][7-to_col_id].SetPieceData(-1,NONE,BLANK,PIECE_NOT_MOVING);
-		}
-	}
-	
-	m_iHistory--;
-	GetMoveHistory();
-	if(redraw == 1)
-		DrawBoard();
-	int movecount = m_iHistory/2;
-	char side = m_pieceSide == WHITE ? 'w' : 'b';
-	CString str = GetPositionString('F',movecount,side);
-	if(m_whiteAsEngineFlag == TRUE)
-		SetEnginePosition(m_whiteEngine, str);
-	if(m_blackAsEngineFlag == TRUE)
-		SetEnginePosition(m_blackEngine, str);				
-	
-}
-
-void CNetChessView::OnEditRedo() 
-{
-	// TODO: Add your command handler code here	
-	OnEditRedoAction(1);
- 	unsigned char msg[2];
-	msg[0] = REDO;
-	msg[1] = 1;
-	SendSockData((unsigned char*)msg,2); 
-}
-
-void CNetChessView::OnEditRedoAction(int redraw)
-{
-	m_iHistory++;
-	if(m_iHistory > m_topHistory)
-	{
-		m_iHistory--;
-		return;
-	}
-	if(m_pClientSocket == NULL)
-	{
-		m_player_turn = true;
-		m_pieceSide = m_pieceSide == WHITE ? BLACK: WHITE;
-	}
-	else
-	{
-		if(m_player_turn == true)
-		{
-			m_player_turn =false;
-		}
-		else
-		{
-			m_player_turn = true;
-		}
-	}
-	GetMoveHistory();
-	PIECE_SIDE piece_side;
-	PIECE_TYPE from_piece_type;
-	COLOR_TYPE from_color_type;
-	int from_pieceid;
-	int from_row_id;
-	int from_col_id;
-	PIECE_TYPE to_piece_type;
-	COLOR_TYPE to_color_type;
-	int to_pieceid;
-	int to_row_id;
-	int to_col_id;
-
-	m_History[m_iHistory].GetHistory(
-		piece_side,
-		from_piece_type, from_color_type,from_pieceid,
-		from_row_id,from_col_id, to_piece_type,
-		to_color_type,to_pieceid,to_row_id,
-		to_col_id);
-	int SpecialAction  = m_History[m_iHistory].GetSpecialAction();
-	if(m_white_on_top == false)		 
-	{
-		cb[from_row_id][from_col_id].SetPieceData(
-				-1,NONE,BLANK,
-				//to_pieceid,to_color_type,to_piece_type,
-				PIECE_NOT_MOVING);	 	 
-		cb[to_row_id][to_col_id].SetPieceData(
-			from_pieceid,from_color_type,from_piece_type,
-			PIECE_NOT_MOVING);
-		m_movedFromRect = cb[from_row_id][from_col_id].GetRect();
-		m_movedToRect = cb[to_row_id][to_col_id].GetRect();
-		if(m_History[m_iHistory].GetEnPassentFlag() == TRUE)
-		{
-			PIECE_SIDE piece_side;
-			PIECE_TYPE from_piece_type;
-			COLOR_TYPE from_color_type;
-			int from_pieceid;
-			int from_row_id;
-			int from_col_id;
-			PIECE_TYPE to_piece_type;
-			COLOR_TYPE to_color_type;
-			int to_pieceid;
-			int to_row_id;
-			int to_col_id;
-			m_History[m_iHistory-1].GetHistory(
-				piece_side,
-				from_piece_type, from_color_type,from_pieceid,
-				from_row_id,from_col_id, to_piece_type,
-				to_color_type,to_pieceid,to_row_id,
-				to_col_id);
-				cb[to_row_id][to_col_id].SetPieceData(
-					-1,NONE,BLANK,				 
-					PIECE_NOT_MOVING);	 	 
-		}
-		else if(m_History[m_iHistory].GetCastlingFlag() == TRUE)
-		{
-			if(from_col_id < to_col_id)
-			{
-				cb[from_row_id][5].SetPieceData(cb[from_row_id][7].GetPieceId(),
-					cb[from_row_id][7].GetPieceColor(),
-					cb[from_row_id][7].GetPieceType(),
-					PIECE_NOT_MOVING);
-				cb[from_row_id][7].SetPieceData(-1,NONE,BLANK,PIECE_NOT_MOVING);
-			}
-			else //if(cb[to_row_id][to_col_id].GetPieceType() == KING)
-			{
-				cb[from_row_id][3].SetPieceData(cb[from_row_id][0].GetPieceId(),
-					cb[from_row_id][0].GetPieceColor(),
-					cb[from_row_id][0].GetPieceType(),
-					PIECE_NOT_MOVING);
-				cb[from_row_id][0].SetPieceData(-1,NONE,BLANK,PIECE_NOT_MOVING);
-			}
-		}
-		else if(m_History[m_iHistory].GetPromotionFlag() == TRUE)
-		{
-			cb[to_row_id][to_col_id].SetPieceData(
-			to_pieceid,to_color_type,to_piece_type,
-			PIECE_NOT_MOVING);
-		}
-		 
-	}	
-	else
-	{
-		cb[7-from_row_id][7-from_col_id].SetPieceData(
-				-1,NONE,BLANK,
-				//to_pieceid,to_color_type,to_piece_type,
-				PIECE_NOT_MOVING);
-		cb[7-to_row_id][7-to_col_id].SetPieceData(
-			from_pieceid,from_color_type,from_piece_type,
-			PIECE_NOT_MOVING);		 
-		m_movedFromRect = cb[7-from_row_id][7-from_col_id].GetRect();
-				m_movedToRect = cb[7-to_row_id][7-to_col_id].GetRect();
-		if(m_History[m_iHistory].GetEnPassentFlag() == TRUE)
-		{
-			PIECE_SIDE piece_side;
-			PIECE_TYPE from_piece_type;
-			COLOR_TYPE from_color_type;
-			int from_pieceid;
-			int from_row_id;
-			int from_col_id;
-			PIECE_TYPE to_piece_type;
-			COLOR_TYPE to_color_type;
-			int to_pieceid;
-			int to_row_id;
-			int to_col_id;
-			m_History[m_iHistory-1].GetHistory(
-				piece_side,
-				from_piece_type, from_color_type,from_pieceid,
-				from_row_id,from_col_id, to_piece_type,
-				to_color_type,to_pieceid,to_row_id,
-				to_col_id);
-			cb[7-to_row_id][7-to_col_id].SetPieceData(
-					-1,NONE,BLANK,				 
-					PIECE_NOT_MOVING);		
-		}
-		else if(m_History[m_iHistory].GetCastlingFlag() == TRUE)
-		{
-			if(7-from_col_id < 7-to_col_id)
-			{
-				cb[7-from_row_id][4].SetPieceData(cb[7-from_row_id][7].GetPieceId(),
-					cb[7-from_row_id][7].GetPieceColor(),
-					cb[7-from_row_id][7].GetPieceType(),
-					PIECE_NOT_MOVING);
-				cb[7-from_row_id][7].SetPieceData(-1,NONE,BLANK,PIECE_NOT_MOVING);
-			}
-			else //if(cb[to_row_id][to_col_id].GetPieceType() == KING)
-			{
-				cb[7-from_row_id][2].SetPieceData(cb[7-from_row_id][0].GetPieceId(),
-					cb[7-from_row_id][0].GetPieceColor(),
-					cb[7-from_row_id][0].GetPieceType(),
-					PIECE_NOT_MOVING);
-				cb[7-from_row_id][0].SetPieceData(-1,NONE,BLANK,PIECE_NOT_MOVING);
-			}
-		}
-		else if(m_History[m_iHistory].GetPromotionFlag() == TRUE)
-		{
-			cb[7-to_row_id][7-to_col_id].SetPieceData(
-			to_pieceid,to_color_type,to_piece_type,
-			PIECE_NOT_MOVING);
-		}
-	}
-	
-	if(redraw == 1)
-		DrawBoard();
-
-	int movecount = m_iHistory/2;
-	char side = m_pieceSide == WHITE ? 'w' : 'b';
-	CString str = GetPositionString('F',movecount,side);
-	if(m_whiteAsEngineFlag == TRUE)
-		SetEnginePosition(m_whiteEngine, str);
-	if(m_blackAsEngineFlag == TRUE)
-		SetEnginePosition(m_blackEngine, str);				
-}
-void CNetChessView::OnRButtonDownAction(UINT nFlags, CPoint point) 
-{
-	CPickPieceDlg dlg;	 
-	for(int i = 0; i < 8; i++)
-	{
-		for( int j = 0; j < 8; j++)
-		{
-			CRgn rgn;
-			CRect rect = cb[i][j].GetRect();
-			rgn.CreateEllipticRgn(rect.left, rect.top, rect.right, rect.bottom);
-			if(rgn.PtInRegion(point))// && m_player_turn == cb[i][j].GetPieceColor())
-			{	
-				int foundflag = 0;
-				if(m_pickPieceDlg->m_pickpiecetype  == 1 && m_pickPieceDlg->m_piecked_piece != -2)
-				{
-					foundflag = 1;
-				}					 
-				else
-				{
-					if(nFlags == 0)
-					{
-						if(dlg.DoModal()==IDOK)
-						{ 
-							if( dlg.m_piecked_piece != -2)
-								foundflag = 1;
-						}
-					}					
-				}
-				if(foundflag == 1)
-				{					
-					int piece_id;
-					COLOR_TYPE  piece_color;
-					PIECE_TYPE  piece_type;
-					STATE piece_state = PIECE_NOT_MOVING;
-					int to_piece_id;
-					COLOR_TYPE  to_piece_color;
-					PIECE_TYPE  to_piece_type;
-					STATE to_piece_state=PIECE_NOT_MOVING;
-					if(m_pickPieceDlg->m_pickpiecetype  == 1)
-					{
-						piece_id = m_pickPieceDlg->m_piecked_piece;
-						piece_color = m_pickPieceDlg->m_piece_color;
-						piece_type = m_pickPieceDlg->m_piece_type;						 						 
-						m_pickPieceDlg->m_pickpiecetype  = 0;
-					}
-					else
-					{
-						piece_id = dlg.m_piecked_piece;
-						piece_color = dlg.m_piece_color;
-						piece_type = dlg.m_piece_type;						 						 
-					}
-					cb[i][j].GetPieceData(to_piece_id,to_piece_color,to_piece_type,to_piece_state);	
-					cb[i][j].SetPieceState(PIECE_NOT_MOVING);
-					if(m_white_on_top == false)
-					{
-						m_History[++m_iHistory].SetHistory(BOTTOM,
-								piece_type,piece_color,piece_id,i,j,
-							to_piece_type,to_piece_color,to_piece_id,i,j);
-					}
-					else
-					{
-						m_History[++m_iHistory].SetHistory(BOTTOM,
-							piece_type,piece_color,piece_id,7-i,7-j,
-							to_piece_type,to_piece_color,to_piece_id,7-i,7-j);
-					}
-					m_topHistory = m_iHistory;
-					cb[i][j].SetPieceData(piece_id,piece_color,piece_type,PIECE_NOT_MOVING);
-					
-					char data[30];
-					memset(data,-1,30);					 
-					data[0] = MOVE;
-					data[1] = m_white_on_top == false?FALSE:TRUE;
-					data[2] = (char)i;
-					data[3] = (char)j;
-   					data[4] = i;
-					data[5] = j;						
-					data[6] = 2;
-					memcpy(&data[7],&piece_id,4);
-					data[11] = piece_color;
-					data[12] = piece_type;
-					memcpy(&data[13],&m_whiteTime,4);
-					memcpy(&data[17],&m_blackTime,4);
-					//if(m_moveFlag == FALSE)
-					//{					
-						SendSockData((unsigned char*)data,21);
-					//}
-					//else
-					//	SendToEngine((unsigned char*)data,13);
-//					m_moveFlag = FALSE;
-					SetMoveHistory();
-					DrawBoard();
-					return;	 
-					}
-			}
-		}
-	} 
-}
-void CNetChessView::OnRButtonDown(UINT nFlags, CPoint point) 
-{
-	// TODO: Add your message handler code here and/or call default
-	if(m_manualEditingFlag == FALSE)
-	{
-		SetPaneText(MESSAGEPANE,"Editing disabled",1);
-		return;
-	}
-	if(m_pClientSocket != NULL && 
-		((m_whiteAsEngineFlag ==TRUE && m_pieceSide == WHITE) || 
-		(m_blackAsEngineFlag == TRUE && m_pieceSide ==BLACK)) )
-	{
-		SetPaneText(MESSAGEPANE,"Connected to network and Engine is playing",0);
-		return;
-	}
-	OnRButtonDownAction(0,point);
-	//valid only for manual editing	
-	CView::OnRButtonDown(nFlags, point);
-}
-
-void CNetChessView::OnUpdateToolsServer(CCmdUI* pCmdUI) 
-{
-	// TODO: Add your command update UI handler code here
-	if(m_pServerSocket == NULL)
-	{
-		pCmdUI->SetCheck(0);	
-	}
-	else
-	{
-		pCmdUI->SetCheck(1);
-	}
-	
-}
-
-void CNetChessView::OnUpdateToolsClient(CCmdUI* pCmdUI) 
-{
-	// TODO: Add your command update UI handler code here
-	if(m_pClientSocket == NULL)
-	{
-		pCmdUI->SetCheck(0);	
-	}
-	else
-	{
-		pCmdUI->SetCheck(1);
-	}	
-}
-
-void CNetChessView::OnPrint(CDC* pDC, CPrintInfo* pInfo) 
-{
-	// TODO: Add your specialized code here and/or call the base class	
-
-	 CBitmap localbmp;
-	 localbmp.LoadBitmap(IDB_BITMAP_BASE);
-	 
-	 pDC->SelectObject(&localbmp); 
-	 
-	 COLORREF cr(RGB(216,207,169));    
-	 CBrush brush(cr);
-	 pDC->SelectObject(brush);
-	 CRect crect = pInfo->m_rectDraw;
-	 
-	 COLORREF bkcrRef;    
-	 COLORREF redcr(RGB(205,177,207));
- 
-	 CBrush redbrush;
-	 redbrush.CreateSolidBrush(redcr);
- 
-	 COLORREF redbluecr(RGB(192,192,192));
-	 CBrush redbluebrush;
-	 redbluebrush.CreateSolidBrush(redbluecr);
- 
-	 CBrush* pbrush = pDC->SelectObject(&redbluebrush);
- 
-	 pDC->Rectangle(crect.left, crect.top,
-	  crect.right, crect.right);
- 
-  
-	 COLORREF bluecr(RGB(205,177,207));//ball color
-	 CBrush bluebrush;
-	 bluebrush.CreateSolidBrush(bluecr);
- 
-	 COLORREF greencr(RGB(0,255,0));
-	 CBrush greenbrush;
-	 greenbrush.CreateSolidBrush(greencr);
- 
-	 pDC->SelectObject(bluebrush);
- 
-	 int m_width = crect.Width() / 10;
-	 pDC->Rectangle(crect.left + ((m_width * 3) /4), crect.top +((m_width * 3) /4),
-	  crect.right - ((m_width * 3) /4), crect.right -((m_width * 3) /4));
- 
-	 pbrush =  pDC->SelectObject(&redbluebrush);
- 
-	  int xstart = m_width, ystart = m_width;
- 
-	 for(int i = 0; i < 8; i++)
-	 {
-	  xstart = m_width;
-	  for( int j = 0; j < 8; j++)
-	  {
-	   CRect rect(xstart,ystart,xstart+m_width,ystart+m_width);
-     
-	   if(cb[i][j].GetColorType() == BLACK)
-	   {
-		CPoint pt(m_moveRect.left+25,m_moveRect.top+25);
-		if(rect.PtInRect(pt) == TRUE)
-		{
-		 bkcrRef = m_optDlg.m_crefBlackColor;
-		}           
-		if(m_movedFromRect == rect)
-		{
-		 COLORREF cr1(RGB(0,0,255));
-		 pDC->SetBkColor(cr1);
-		 CBrush brush1(cr1);      
-		 pDC->SelectObject(brush1); 
-		 pDC->FillRect(&rect,&brush1);
-		 CRect rect1(rect.left+4, rect.top + 4, rect.right -4, rect.bottom -4);
-		 CBrush brush(m_optDlg.m_crefBlackColor);
-		 pDC->SetBkColor(m_optDlg.m_crefBlackColor);
-		 pDC->SelectObject(brush); 
-		 pDC->FillRect(&rect1,&brush);
- 
-		}
-		else if(m_movedToRect == rect)
-		{
-		 COLORREF cr1(RGB(0,0,255));
-		 pDC->SetBkColor(cr1);
-		 CBrush brush1(cr1);      
-		 pDC->SelectObject(brush1); 
-		 pDC->FillRect(&rect,&brush1);
-		 CRect rect1(rect.left+4, rect.top + 4, rect.right -4, rect.bottom -4);
-		 CBrush brush(m_optDlg.m_crefBlackColor);
-		 pDC->SetBkColor(m_optDlg.m_crefBlackColor);
-		 pDC->SelectObject(brush); 
-		 pDC->FillRect(&rect1,&brush);
-		}
-		else
-		{
-		 CBrush brush(m_optDlg.m_crefBlackColor);
-		 pDC->SetBkColor(m_optDlg.m_crefBlackColor);
-		 pDC->SelectObject(brush); 
-		 pDC->FillRect(&rect,&brush);
-		}
-	   }
-	   else if(cb[i][j].GetColorType() == WHITE)
-	   {
-		CPoint pt(m_moveRect.left+25,m_moveRect.top+25);
-		if(rect.PtInRect(pt) == TRUE)
-		{
-		 bkcrRef = m_optDlg.m_crefWhiteColor ;
-		}
-		if(m_movedFromRect == rect)
-		{
-		 COLORREF cr1(RGB(0,0,255));
-		 pDC->SetBkColor(cr1);
-		 CBrush brush1(cr1);      
-		 pDC->SelectObject(brush1); 
-		 pDC->FillRect(&rect,&brush1);
-		 CRect rect1(rect.left +4, rect.top + 4, rect.right -4, rect.bottom -4);
-		 CBrush brush(m_optDlg.m_crefWhiteColor);
-		 pDC->SetBkColor(m_optDlg.m_crefWhiteColor);
-		 pDC->SelectObject(brush); 
-		 pDC->FillRect(&rect1,&brush);
- 
-		}
-		else if(m_movedToRect == rect)
-		{
-		 COLORREF cr1(RGB(0,0,255));
-		 pDC->SetBkColor(cr1);
-		 CBrush brush1(cr1);      
-		 pDC->SelectObject(brush1); 
-		 pDC->FillRect(&rect,&brush1);
-		 CRect rect1(rect.left +4, rect.top + 4, rect.right -4, rect.bottom -4);
-		 CBrush brush(m_optDlg.m_crefWhiteColor);
-		 pDC->SetBkColor(m_optDlg.m_crefWhiteColor);
-		 pDC->SelectObject(brush); 
-		 pDC->FillRect(&rect1,&brush);
- 
-		}    
-		else
-		{
-		 CBrush brush(m_optDlg.m_crefWhiteColor);
-		 pDC->SetBkColor(m_optDlg.m_crefWhiteColor);
-		 pDC->SelectObject(brush); 
-		 pDC->FillRect(&rect,&brush);
-		}
-	   }
-	   if(cb[i][j].GetPieceType() != BLANK && cb[i][j].GetPieceState() != PIECE_MOVING)
-	   {
-		int piece_id;
-		COLOR_TYPE  piece_color;
-		PIECE_TYPE  piece_type;
-		STATE piece_state;
-		cb[i][j].GetPieceData(piece_id,piece_color,piece_type,piece_state);
-		if(piece_id <= 0)
-		{
-		 break;
-		}
-		/*if(m_optDlg.m_boardFont == 1)
-		{
-				CBitmap bitmap;			
-				bitmap.LoadBitmap(GetBitmapId(piece_id));			 
-				CDC bmpdc;
-				bmpdc.CreateCompatibleDC(pDC);
-				bmpdc.SelectObject(&bitmap); 
-				BITMAP bmp;
-				bitmap.GetBitmap(&bmp);
-			
-				pDC->StretchBlt(rect.left+7,rect.top+7,m_squareWidth -15,m_squareWidth-15,&bmpdc,0,0,bmp.bmWidth,bmp.bmHeight,SRCCOPY); 
-		}
-		else
-		{					
-				CString piece;
-				if(GetPieceString(piece_id,piece) == 0)
-				{				
-					//CRect rct(rect.left+10,rect.top+10,rect.right-10,rect.bottom-10);
-					CFont *fnt = pDC->SelectObject(&m_optDlg.m_font);
-					pDC->DrawText(piece,rect,0);//DT_CENTER | DT_VCENTER);
-					//COLORREF white(RGB(255,255,255)), black(RGB(0,0,0));
-					//ldc->SetBkColor(TRANSPARENT);
-					//ldc->SetTextColor(piece_color == WHITE? white : black);
-					//ldc->TextOut(rect.left+5,rect.top+5,piece);
-					pDC->SelectObject(fnt);
-				}
-		}*/
-
-		CBitmap bitmap;
-		
-		bitmap.LoadBitmap(GetBitmapId(piece_id));    
-		CDC bmpdc;
-		bmpdc.CreateCompatibleDC(pDC);
-		bmpdc.SelectObject(&bitmap); 
- 
-		BITMAP bmp;
-		bitmap.GetBitmap(&bmp);
-		
-     
-		pDC->StretchBlt(rect.left+(m_width /6),(rect.top + m_width/6),(int)(m_width/1.5),(int)(m_width/1.5),&bmpdc,0,0,bmp.bmWidth,bmp.bmHeight,SRCCOPY); 
-	   }
-	   
-	   xstart += m_width;
-	  }  
-	  ystart += m_width;
-	 }
- 
-	 pDC->SetBkColor(redbluecr);
-	 for(int i=0;i<8;i++)
-	 {  
-	  if(m_LetterFlag == true)
-	  {
-	   if(m_white_on_top == false)
-	   {
-		pDC->TextOut(m_width * (i+1)+10,(m_width * 1)/ 3,(CString)((char)('a'+i)));
-		pDC->TextOut(m_width * (i+1)+10,crect.right - ((m_width * 2)/ 3), (char)('a'+i));
-	   }
-	   else
-	   {
-		pDC->TextOut(m_width * (i+1),(m_width * 2)/ 3,(CString)((char)('h'-i)));
-		pDC->TextOut(m_width * (i+1),crect.right - ((m_width * 2)/ 3), (char)('h'- i));
-	   }
-	  }
-	  if(m_NumberFlag == true)
-	  {
-	   if(m_white_on_top == false)
-	   {
-		pDC->TextOut((m_width * 1)/ 3, m_width * (i+1), (CString)((char)('8' - i)));
-		pDC->TextOut(crect.right - ((m_width * 2)/ 3), m_width * (i+1), (char)('8' - i));
-	   }
-	   else
-	   {
-		pDC->TextOut((m_width * 1)/ 3, m_width * (i+1), (CString)((char)('1' + i)));
-		pDC->TextOut(crect.right - ((m_width * 2)/ 3), m_width * (i+1), (char)('1' + i));
-	   }
-	  }
-	 }
-CView::OnPrint(pDC, pInfo);
-}
-
-void CNetChessView::OnTimer(UINT nIDEvent) 
-{
-	
-	static int count = 0;
-	static int state=1;	 
-	switch(nIDEvent)
-	{
-		case SHELL_ICON_TIMER_EVENT_ID:
-			{
-				NOTIFYICONDATA nicondata;
-				char data[64] = "NetChess by A.V.M.Rao";
-				 
-				nicondata.hWnd = AfxGetApp()->m_pMainWnd->GetSafeHwnd();
-				nicondata.uID = 10;
-				nicondata.uFlags = NIF_ICON |NIF_MESSAGE | NIF_TIP; 
-				nicondata.cbSize = sizeof(nicondata);
-				nicondata.uCallbackMessage = MY_MESSAGE_SHELLNOTIFY;
-				nicondata.hIcon = AfxGetApp()->LoadIcon(IDR_MAINFRAME);
-				strcpy(nicondata.szTip,data);				
-				if(state == 1)
-				{
-					nicondata.hIcon = AfxGetApp()->LoadIcon(IDR_MAINFRAME);
-					Shell_NotifyIcon(NIM_MODIFY,&nicondata);
-					state = 0;
-				}
-				else
-				{
-					nicondata.hIcon = AfxGetApp()->LoadIcon(IDI_ICON_MAINFRAME_OPPOSITE);
-					state = 1;
-					Shell_NotifyIcon(NIM_MODIFY,&nicondata);
-				}
-			}
-			break;
-		case PIECE_SIDE_TIMER_EVENT_ID:
-			{
-				//if ICS Timer is sarted or clock type is 
-				//CONVENTIONAL, ICS TYPE, MOVETIME use ICS Timer
-				if(m_icsFlag == TRUE)
-					/*||
-				   m_timeControlDlg.m_radio_clock_type == CONVENTIONAL ||
-				   m_timeControlDlg.m_radio_clock_type == ICSTYPE ||
-				   m_timeControlDlg.m_radio_clock_type == MOVETIME) //for ICS games it should be decremented*/
-					return;
-				//Update the Status bar with last move info 
-				//for every two seconds
-				if(count == 2)
-				{
-					count = 0;
-					if(m_iHistory > -1)
-					{
-						CString str = m_History[m_iHistory].GetMoveInfo();
-						if(!str.IsEmpty())
-							SetPaneText(MESSAGEPANE,str);
-					}
-				}
-				count++;
-				if(m_pauseclockFlag == TRUE)
-				{
-					m_elapsedTime++;
-					break;
-				}
-				//m_pClientSocket is NULL means the timer is only for 
-				//for the board
-				if(m_pClientSocket == NULL)
-				{
-					//my piece side is black and player turn is true
-					if(m_pieceSide == BLACK && m_player_turn == true)
-					{	
-
-						m_blackTime--;
-						if(m_blackTime >= 0)
-						{					
-							//set black time
-							CTime tb( m_blackTime);
-							CTime st(0);						
-							CTimeSpan ts = tb - st; 
-							CString str;
-							str.Format("%d:%d:%d",ts.GetHours(),ts.GetMinutes(),ts.GetSeconds());					 
-							SetPaneText(BLACKTIME,str);
-							if(m_blackTime == 0)
+								m_topHistory = m_iHistory;
+								cb[i][j].SetPieceData(to_piece_id,to_piece_color,to_piece_type,PIECE_NOT_MOVING);
+
+								char data[30];
+								memset(data,-1,30);
+								data[0] = MOVE;
+								data[1] = m_white_on_top == false?FALSE:TRUE;
+								data[2] = (char)m_point.x;
+								data[3] = (char)m_point.y;
+	   							data[4] = i;
+								data[5] = j;
+								data[6] = 1;
+								memcpy(&data[7],&to_piece_id,4);
+								data[11] = to_piece_color;
+								data[12] = to_piece_type;
+								memcpy(&data[13],&m_whiteTime,4);
+								memcpy(&data[17],&m_blackTime,4);
+								//if(m_moveFlag == FALSE)
+								{
+									SendSockData((unsigned char*)data,21);
+								}								
+								/*else
+									SendToEngine((unsigned char*)data,13);*/
+								//m_moveFlag = FALSE;//move is done, so make it false							
+								m_movedFromRect = cb[m_point.x][m_point.y].GetRect();
+								m_movedToRect = cb[i][j].GetRect();
+							}
+							//FindMove promoted to a queen, replay with the piece picked (a pawn if cancelled)
+							if(promotion != GetMoveFlag(move))
 							{
-								CString str;
-								str.Format("Black side timeout");					 
-								AfxMessageBox(str);
+								m_position.UnmakeMove(move,m_History[m_iHistory].GetUndoInfo());
+								MakePositionMove(EncodeMove(from,to,promotion));
 							}
 						}
-						/*CTime tb(time(0)  -  m_blackTime);						
-						CTime st(m_startTime+m_elapsedTime);
-						CTimeSpan ts = tb - st; 
-						m_blackTime++;
-						CString str;
-						str.Format("%d:%d:%d",ts.GetHours(),ts.GetMinutes(),ts.GetSeconds());					 
-						//str.Format("%d:%d:%d",t->tm_hour,t->tm_min,t->tm_sec);
-
-						SetPaneText(BLACKTIME,str);*/
-					}
-					else if(m_pieceSide == WHITE && m_player_turn == true)
-					{					 
-						m_whiteTime--;
-						if(m_whiteTime >=0)
+						/************/
+						else if(nFlags != 255)//king move is not valid
 						{
-							//set white
-							CTime tb(m_whiteTime);
-							CTime st(0);
-							CTimeSpan ts = tb - st; 
-							CString str;
-							str.Format("%d:%d:%d",ts.GetHours(),ts.GetMinutes(),ts.GetSeconds());					 
-							//str.Format("%d:%d:%d",t->tm_hour,t->tm_min,t->tm_sec);
-							SetPaneText(WHITETIME,str);
-							if(m_whiteTime == 0)
-							{
-								CString str;
-								str.Format("White side timeout");					 
-								//SetPaneText(MESSAGEPANE,str);
-								AfxMessageBox("White side timeout");
+							SetMoveHistory();
+							char data[30];
+							memset(data,-1,25);
+							data[0] = MOVE;
+							data[1] = m_white_on_top == false?FALSE:TRUE;
+							data[2] = (char)m_point.x;
+							data[3] = (char)m_point.y;
+	   						data[4] = i;
+							data[5] = j;						
+							data[6] = 0;
+							//if(m_moveFlag == FALSE)
+							{							
+								SendSockData((unsigned char*)data,7);
 							}
-						}
-						/*CTime tb( time(0)- m_whiteTime);
-						CTime st(m_startTime+ m_elapsedTime);						
-						CTimeSpan ts = tb - st; 												
-						m_whiteTime++;
-						CString str;
-						str.Format("%d:%d:%d",ts.GetHours(),ts.GetMinutes(),ts.GetSeconds());					 
-						SetPaneText(WHITETIME,str);*/
+							//else
+							//	SendToEngine((unsigned char*)data,7);
+							m_moveFlag = FALSE;
+							m_movedFromRect = cb[m_point.x][m_point.y].GetRect();
+							m_movedToRect = cb[i][j].GetRect();
+						}						
 					}
-				}
-				else //timer is client server
-				{
-					if(m_pieceSide == BLACK && m_player_turn == true || (m_pieceSide == WHITE && m_player_turn == false))
-					{	
-						m_blackTime--;
-						if(m_blackTime >= 0)
-						{					
-							//set black time
-							CTime tb( m_blackTime);
-							CTime st(0);						
-							CTimeSpan ts = tb - st; 
-							CString str;
-							str.Format("%d:%d:%d",ts.GetHours(),ts.GetMinutes(),ts.GetSeconds());					 
-							SetPaneText(BLACKTIME,str);
-						}
-						/*CTime tb(time(0)  -  m_blackTime);
-						CTime st(m_startTime+m_elapsedTime);
-						CTimeSpan ts = tb - st; 
-						m_blackTime++;
+					else
+					{
+						
+						//writeMessage("%d %d %c is an invalid move to %d %d %c",
+						//	m_point.x,m_point.y,cb[m_point.x][m_point.y].GetPieceId(),i,j,cb[i][j].GetPieceId());
+						m_movedFromRect = m_movedToRect = 0;
+						int from = GetBoardSquare(m_point.x,m_point.y);
+						int to = GetBoardSquare(i,j);
 						CString str;
-						str.Format("%d:%d:%d",ts.GetHours(),ts.GetMinutes(),ts.GetSeconds());					 
-						//str.Format("%d:%d:%d",t->tm_hour,t->tm_min,t->tm_sec);
-
-						SetPaneText(BLACKTIME,str);*/
+						str.Format("Invalid move! %c%d %c is an invalid move to %c%d %c",
+							'a'+SquareFile(from),SquareRank(from)+1,cb[m_point.x][m_point.y].GetPieceId(),
+							'a'+SquareFile(to),SquareRank(to)+1,cb[i][j].GetPieceId());
+						SetPaneText(MESSAGEPANE,str,1);
+						//if (m_demoFlag == FALSE)
+							//AfxMessageBox(str);
+						m_point.x = m_point.y = -1;
+						SetLearning(FALSE);
+						DrawBoard();	 
+						return -1;
 					}
-					else if(m_pieceSide == WHITE && m_player_turn == true || (m_pieceSide == BLACK && m_player_turn == false))
-					{	
-						m_whiteTime--;
-						if(m_whiteTime >=0)
-						{
-							//set white
-							CTime tb(m_whiteTime);
-							CTime st(0);
-							CTimeSpan ts = tb - st; 
-							CString str;
-							str.Format("%d:%d:%d",ts.GetHours(),ts.GetMinutes(),ts.GetSeconds());					 
-							//str.Format("%d:%d:%d",t->tm_hour,t->tm_min,t->tm_sec);
-							SetPaneText(WHITETIME,str);
-						}
-						/*CTime tb( time(0)- m_whiteTime);						
-						CTime st(m_startTime+m_elapsedTime);
-						CTimeSpan ts = tb - st; 
-						m_whiteTime++;
-						CString str;
-						str.Format("%d:%d:%d",ts.GetHours(),ts.GetMinutes(),ts.GetSeconds());					 
-						SetPaneText(WHITETIME,str);*/
+					CString lastMoveInfo = "";
+					if(m_checkFlag == TRUE)
+					{
+						lastMoveInfo = " Check! ";
 					}
-				}
-			}
-			break;
-		case DEMO_TIMER_EVENT_ID:
-			{
-				if(m_demoTotal <= m_topHistory && m_demoFlag == TRUE && m_pauseFlag == FALSE)
-				{				
-					m_demoTotal++;
-					OnEditRedoAction(1);
- 					unsigned char msg[2];
-					msg[0] = REDO;
-					msg[1] = 1;
-					SendSockData((unsigned char*)msg,2); 					
-				}
-				else if(m_pauseFlag != TRUE)
-				{
-					m_demoTotal = 0;
-					KillTimer(DEMO_TIMER_EVENT_ID);
-					m_demoFlag = FALSE;
-					unsigned char msg[1];
-					msg[0] = DEMO_END;
-					SendSockData(msg,1);
-					//CString result = "Demo over: Result-" + m_gameInfoDlg.m_edit_result;
-					//AfxMessageBox(result);
-					Sleep(5000);
-					OnFileLoadnextgame();
-					m_demoFlag = TRUE;
-					m_manualEditingFlag = FALSE;
-					OnEditMovefirst();
-					m_demoTotal = 0;
-
-					SetTimer(DEMO_TIMER_EVENT_ID_ALL, m_demoInterval * 1000, NULL);
-					
-				}	
-			}
-			break;
-		case DEMO_TIMER_EVENT_ID_ALL:
-		{
-			if (m_demoTotal <= m_topHistory && m_demoFlag == TRUE && m_pauseFlag == FALSE)
-			{
-				m_demoTotal++;
-				OnEditRedoAction(1);
-				unsigned char msg[2];
-				msg[0] = REDO;
-				msg[1] = 1;
-				SendSockData((unsigned char*)msg, 2);
-			}
-			else if (m_pauseFlag != TRUE)
-			{
-				m_demoTotal = 0;
-				KillTimer(DEMO_TIMER_EVENT_ID_ALL);
-				m_demoFlag = FALSE;
-				unsigned char msg[1];
-				msg[0] = DEMO_END;
-				SendSockData(msg, 1);
-				//CString result = "Demo over: Result-" + m_gameInfoDlg.m_edit_result;
-				//AfxMessageBox(result);
-				Sleep(5000);
-				OnFileLoadnextgame();
-				m_demoFlag = TRUE;
-				m_manualEditingFlag = FALSE;
-				OnEditMovefirst();
-				m_demoTotal = 0;
-				
-				SetTimer(DEMO_TIMER_EVENT_ID_ALL, m_demoInterval * 1000, NULL);
-
-			}
-		}
-		break;
-		case SAVE_TIMER_EVENT_ID:
-			{
-				if(!m_fileName.IsEmpty())
-					OnFileSave();				
-				/*char defaultBuf[40]="default";
-				char CurrentDir[255];
-				GetWindowsDirectory(CurrentDir,MAX_PATH);
-				strcat(CurrentDir,"\\NetChess.ini");
-				CStringArray ar;
-				CString str = GetHistoryString(ar,0);
-				str.Replace("\r","");	
-				str = str + "\n";
-				WritePrivateProfileString("NetChess","PGNFormat",str,CurrentDir);*/
-			}
-			break;
-		case ICS_TIMER:
-			{				 
-				if(m_icsFlag == TRUE ||
-				   m_timeControlDlg.m_radio_clock_type == CONVENTIONAL ||
-				   m_timeControlDlg.m_radio_clock_type == ICSTYPE ||
-				   m_timeControlDlg.m_radio_clock_type == MOVETIME)
-
-				{
-					
-					
-					if(m_pieceSide == WHITE && m_player_turn == true || (m_pieceSide == BLACK && m_player_turn == false))
+					else if(m_castlingFlag == TRUE)
 					{
-						m_whiteTime--;
-						if(m_whiteTime >=0)
+						lastMoveInfo = " Castling! " + lastMoveInfo;
+					}
+					else if(m_enpassentFlag == TRUE)
+					{					
+						lastMoveInfo = " En passent! " + lastMoveInfo;
+					}
+					lastMoveInfo = "MOVE: " + GetSingleMoveString(m_iHistory) + lastMoveInfo;
+					CString info = lastMoveInfo;
+					if(m_OpeningTree.IsOpen())
+						info += "  " + GetOpeningTreeString();
+					CString tablebase = GetTablebaseString();
+					if(!tablebase.IsEmpty())
+						info += "  " + tablebase;
+					SetPaneText(MESSAGEPANE,info,1);
+					m_History.SetMoveInfo(m_iHistory,lastMoveInfo);
+					CStringArray sa;
+					GetHistoryString(sa,1);					
+					if(sa.GetSize() > 0)
+					{
+						if(sa.GetSize() -1 == m_listctrl_movehistory.GetCount())
 						{
-							//set white
-							CTime tb(m_whiteTime);
-							CTime st(0);
-							CTimeSpan ts = tb - st; 
-							CString str;
-							str.Format("%d:%d:%d",ts.GetHours(),ts.GetMinutes(),ts.GetSeconds());					 
-							//str.Format("%d:%d:%d",t->tm_hour,t->tm_min,t->tm_sec);
-							SetPaneText(WHITETIME,str);
+							m_listctrl_movehistory.InsertString(-1,sa.GetAt(m_iHistory));
+							m_listctrl_movehistory.SetCurSel(m_iHistory);
+						}
+						else
+						{							
+							m_listctrl_movehistory.ResetContent();
+							for(int i=0;i<=m_iHistory;i++)
+							{
+								m_listctrl_movehistory.InsertString(-1,sa.GetAt(i));
+							}
+							m_listctrl_movehistory.SetCurSel(m_iHistory);							
 						}
 					}
-					else if(m_pieceSide == BLACK && m_player_turn == true || (m_pieceSide == WHITE && m_player_turn == false))
+					if(piece_id == 'P' || piece_id == 'p' || to_piece_id != -1)
 					{
-						m_blackTime--;
-						if(m_blackTime >= 0)
-						{					
-							//set black time
-							CTime tb( m_blackTime);
-							CTime st(0);						
-							CTimeSpan ts = tb - st; 
-							CString str;
-							str.Format("%d:%d:%d",ts.GetHours(),ts.GetMinutes(),ts.GetSeconds());					 
-							SetPaneText(BLACKTIME,str);
-						}
+						m_halfMoveCount = 1;
 					}
-
+					else
+					{
+						if(m_halfMoveCount >= 1)
+							m_halfMoveCount++;
+					}
+					m_History[m_iHistory].SetHalfMoveCount(m_halfMoveCount);
+					m_checkFlag = m_castlingFlag = m_enpassentFlag = m_promotionFlag =
+						m_ambiguousMoveRankFlag = m_ambiguousMoveFileFlag = FALSE;
+					m_point.x = m_point.y = -1;
+					SetLearning(FALSE);
+					DrawBoard();
+					if(!CheckDrawAdjudication())
+						CheckTablebaseAdjudication();
+					/*//IF white is the first move and not in network and ICS not connected
+					if(m_iHistory == 0 && m_blackAsEngineFlag == FALSE && m_pClientSocket == NULL && m_icsFlag == FALSE && m_optDlg.m_check_black_engine_auto_start == TRUE)
+					{
+						OnButtonBlackRadioButtonComputer();
+					}*/
+					return 0;
 				}
-
-				break;
-			}
-		default:
-			break;
-		 
-	}
-	CView::OnTimer(nIDEvent);
-}
-void CNetChessView::KillTimerEvent()
-{
-	 
-	KillTimer(SHELL_ICON_TIMER_EVENT_ID);
-	m_timerFlag = false;
-}
-
-int CNetChessView::OnFileNewAction()
-{
-	if(m_iHistory > -1)
-	{		 
-		int ret = AfxMessageBox("Do you want to save the playing game",MB_YESNOCANCEL);
-		if(ret == IDYES)
-		{
-			OnFileSave();			 
-		}
-		else if(ret == IDCANCEL)
-		{
-			return -1;
-		}
-	}
-	Initialize();
-//	OnInitialUpdate();
-	if(m_pieceSide == BLACK)
-	{
-		m_player_turn = false;
-	}
-	else
-	{
-		m_player_turn = true;
-	}
-	DrawBoard();	
-	return 0;
-}
-
-void CNetChessView::OnViewHistory() 
-{
-	 /*if(m_iHistory < 0)
-	 {
-		 AfxMessageBox("History not found");
-		 return;
-	 }*/
-	  CHistoryDlg dlg(this,m_History,m_iHistory);
-	  dlg.DoModal();
-}
-
-void CNetChessView::OnToolsWhiteontop() 
-{	
-}
-
-void CNetChessView::OnEditMovefirst() 
-{
-	// TODO: Add your command handler code here	
-	int total = m_iHistory;
-	for(int i=0;i<=total;i++)
-	{
-		OnEditUndoAction(0); 		
-	}
-	unsigned char msg[2];
-	msg[0] = MOVEFIRST;
-	msg[1] = 0;
-	SendSockData((unsigned char*)msg,2);
-	DrawBoard();
-}
-
-void CNetChessView::OnEditMovelast() 
-{
-	// TODO: Add your command handler code here	
-	int total = m_topHistory;
-	for(int i=0;i<=total;i++)
-	{
-		OnEditRedoAction(0); 		
-	}
-	unsigned char msg[2];
-	msg[0] = MOVELAST;
-	msg[1] = 0;
-	SendSockData((unsigned char*)msg,2);
-
-	DrawBoard();
-		 	
-}
-
-void CNetChessView::OnHelpHowtoplay() 
-{
-	CHowToPlayDlg dlg;
-	dlg.DoModal();
-	// TODO: Add your command handler code here*/ 
-
-	
-}
-
-void CNetChessView::OnToolsDisconnect() 
-{
-	// TODO: Add your command handler code here
-	 
-	if(m_pClientSocket == NULL)
-	{
-		AfxMessageBox("Not connected to network");
-		if(m_pServerSocket != NULL)
-		{
-			if(AfxMessageBox("Are you sure, you want to disconnect",MB_YESNO)==IDYES)
-			{
-				delete m_pServerSocket;
-				m_pServerSocket = NULL;
 			}
 		}
-		return;
-	}
-	if(m_pClientSocket != NULL)
-	{ 
-		if(AfxMessageBox("Are you sure, you want to disconnect",MB_YESNO)==IDYES)
-		{
-			m_pClientSocket->ShutDown(2);
-			m_pClientSocket->Close();
-			delete m_pClientSocket;
-			m_pClientSocket = NULL; 
-		}
-	}
-}
-
-void CNetChessView::OnEditProperties() 
-{
-	// TODO: Add your command handler code here
-	CPropertiesDlg dlg(this);
-	if(m_pServerSocket != NULL)
-	{
-		if(m_pClientSocket != NULL)
-		{
-			CString ipaddr;int port;
-			((CClientSocket*)m_pClientSocket)->GetInfo(ipaddr,port);
-			dlg.SetInfo(SERVER,ipaddr,port,((CServerSocket*)m_pServerSocket)->m_portnumber);
-		}
-		else
-		{
-			dlg.SetInfo(SERVER," ",0,((CServerSocket*)m_pServerSocket)->m_portnumber);			 
-		}
-	}
-	else if(m_pClientSocket != NULL)
-	{
-		CString ipaddr;int port;
-		((CClientSocket*)m_pClientSocket)->GetInfo(ipaddr,port);
-		dlg.SetInfo(CLIENT,ipaddr,port,0);
-	}
-	else
-	{
-		dlg.SetInfo(-1,"",0,0);
-	}
-	dlg.DoModal();	
-}
-
-
-void CNetChessView::OnToolsDraw() 
-{
-	// TODO: Add your command handler code here
-	if(AfxMessageBox("Do you want to send Draw request?",MB_YESNO) == IDYES)
-	{
-		unsigned char data[50];
-		data[0]=DRAW_REQUEST;
-		strcpy((char*)&data[1],m_edit_name.GetBuffer(0));
-		SendSockData(data,m_edit_name.GetLength()+2);	
-	}
-}
-
-void CNetChessView::OnToolsResign() 
-{
-	// TODO: Add your command handler code here
-	if(AfxMessageBox("Do you want to send Resign messge?",MB_YESNO) == IDYES)
-	{
-		unsigned char data[50];
-		data[0]=RESIGN_REQUEST;
-		strcpy((char*)&data[1],m_edit_name.GetBuffer(0));
-		SendSockData(data,m_edit_name.GetLength()+2);	
-		OnFileNewgame();
-		SendToEngine(data,m_edit_name.GetLength()+2);
-	}
-}
-void CNetChessView::SetPieceSide(COLOR_TYPE pieceside)
-{
-	m_pieceSide = pieceside;
-	if(m_pieceSide == WHITE)
-	{
-		m_player_turn = true;
-		m_white_on_top = false;
-		SetPaneText(PLAYERNAME,"WHITE");
-		m_gameInfoDlg.m_edit_white = m_edit_name;
-	}
-	else
-	{
-		m_player_turn = false;
-		//Initialize()
-//		OnInitialUpdate();
-		FlipBoard();
-		m_white_on_top = true;
-		SetPaneText(PLAYERNAME,"BLACK");	
-		m_gameInfoDlg.m_edit_black = m_edit_name;
 	}
-	m_blackTime = m_whiteTime =m_engineLevelDlg.m_edit_time_control == 0? 5*60: m_engineLevelDlg.m_edit_time_control*60;
-	m_elapsedTime = 0;
-	m_startTime = (int)time(0);
-	m_manualEditingFlag = FALSE;
-	m_demoFlag = FALSE;
+	m_movedFromRect = m_movedToRect = 0;
+	m_point.x = m_point.y = -1;
+	SetLearning(FALSE);
 	DrawBoard();
-
+	return -1;
 }
 
-COLOR_TYPE CNetChessView::GetPlayerSide()
+void CNetChessView::OnMouseMoveAction(UINT nFlags, CPoint point) 
 {
-	return m_pieceSide;
+	// TODO: Add your message handler code here and/or call default
+	if(m_mouseMoveFlag == false)
+		return;	 
+	if(((m_whiteAsEngineFlag ==TRUE && m_pieceSide == WHITE && m_whiteEngineOnlyAnalyze == FALSE) || 
+		(m_blackAsEngineFlag == TRUE && m_pieceSide ==BLACK && m_blackEngineOnlyAnalyze == FALSE)) )
+	{
+		//SetPaneText(MESSAGEPANE,"Connected to network and Engine is playing",0);
+		return;
+	}
+	 
+	CRect rect( point.x -25, point.y - 25, point.x + 25, point.y + 25);				  
+	m_moveRect = rect;	 
+	DrawBoard();	 
 }
 
-void CNetChessView::OnViewLostpieces() 
+void CNetChessView::OnEditUndo() 
 {
-	CLostPieceDlg dlg;
-	dlg.SetHistory(m_History,m_iHistory);
-	dlg.DoModal();
-}
+	// TODO: Add your command handler code here	
+	OnEditUndoAction(1);
+ 	unsigned char msg[2];
+	msg[0]= UNDO;
+	msg[1]=1;
+	SendSockData((unsigned char*)msg,2);
 
-void CNetChessView::OnFileFeed() 
+}
+void CNetChessView::OnEditUndoAction(int redraw)
 {
-//obsolete function/remove later
+	if(m_iHistory < 0)
+	{
+		return;
+	}
+	if(m_pClientSocket == NULL)
+	{
+		m_player_turn = true;
+		m_pieceSide = m_pieceSide == WHITE ? BLACK: WHITE;
+	}
+	else
+	{
+		if(m_player_turn == true)
+		{
+			m_player_turn =false;
+		}
+		else
+		{
+			m_player_turn = true;
+		}
+	}
+	m_History[m_iHistory].TakeBack(m_position);
+	SetBoardFromPosition();
+	
+	m_iHistory--;
+	GetMoveHistory();
+	if(redraw == 1)
+		DrawBoard();
+	int movecount = m_iHistory/2;
+	char side = m_pieceSide == WHITE ? 'w' : 'b';
+	CString str = GetPositionString('F',movecount,side);
+	if(m_whiteAsEngineFlag == TRUE)
+		SetEnginePosition(m_whiteEngine, str);
+	if(m_blackAsEngineFlag == TRUE)
+		SetEnginePosition(m_blackEngine, str);				
+	
 }
 
-void CNetChessView::OnToolsLearn() 
+void CNetChessView::OnEditRedo() 
 {
 	// TODO: Add your command handler code here	
+	OnEditRedoAction(1);
+ 	unsigned char msg[2];
+	msg[0] = REDO;
+	msg[1] = 1;
+	SendSockData((unsigned char*)msg,2); 
 }
 
-void CNetChessView::OnEditSetboard() 
+void CNetChessView::OnEditRedoAction(int redraw)
 {
+	m_iHistory++;
+	if(m_iHistory > m_topHistory)
+	{
+		m_iHistory--;
+		return;
+	}
+	if(m_pClientSocket == NULL)
+	{
+		m_player_turn = true;
+		m_pieceSide = m_pieceSide == WHITE ? BLACK: WHITE;
+	}
+	else
+	{
+		if(m_player_turn == true)
+		{
+			m_player_turn =false;
+		}
+		else
+		{
+			m_player_turn = true;
+		}
+	}
+	GetMoveHistory();
+	m_History[m_iHistory].Play(m_position);
+	SetBoardFromPosition();
+	SetMovedRects();
 	
-}
+	if(redraw == 1)
+		DrawBoard();
 
-void CNetChessView::OnRButtonUp(UINT nFlags, CPoint point) 
-{
-	// TODO: Add your message handler code here and/or call default
-	 
-	CView::OnRButtonUp(nFlags, point);
+	int movecount = m_iHistory/2;
+	char side = m_pieceSide == WHITE ? 'w' : 'b';
+	CString str = GetPositionString('F',movecount,side);
+	if(m_whiteAsEngineFlag == TRUE)
+		SetEnginePosition(m_whiteEngine, str);
+	if(m_blackAsEngineFlag == TRUE)
+		SetEnginePosition(m_blackEngine, str);				
 }
-bool CNetChessView::CheckCheckState(int piecetype, int piececolor,int x,int y)
+void CNetChessView::OnRButtonDownAction(UINT nFlags, CPoint point) 
 {
-	switch(piecetype)
+	CPickPieceDlg dlg;	 
+	for(int i = 0; i < 8; i++)
 	{
-	case PAWN:			
-			if(m_white_on_top == true)
-			{
-				if(piececolor == BLACK)
-				{
-					if(x-1>=0 && y-1>=0)
-					{
-						if(cb[x-1][y-1].GetPieceId() == KING_WHITE)
-						{						
-							return true;
-						}
-					}
-					if(x-1>=0&&y+1<8)
-					{
-						if(cb[x-1][y+1].GetPieceId() == KING_WHITE) 
-						{
-							return true;
-						}
-					}
-				}
-				else
-				{
-					if(x+1 <8 && y-1>=0)
-					{
-						if(cb[x+1][y-1].GetPieceId() == KING_BLACK)
-						{
-							return true;
-						}
-					}
-					if(x+1<8 && y+1 <8)
-					{
-						if(cb[x+1][y+1].GetPieceId() == KING_BLACK) 
-						{
-							return true;
-						}
-					}
-				}
-			}
-			else
+		for( int j = 0; j < 8; j++)
+		{
+			CRgn rgn;
+			CRect rect = cb[i][j].GetRect();
+			rgn.CreateEllipticRgn(rect.left, rect.top, rect.right, rect.bottom);
+			if(rgn.PtInRegion(point))// && m_player_turn == cb[i][j].GetPieceColor())
 			{	
-				if(piececolor == BLACK)
+				int foundflag = 0;
+				if(m_pickPieceDlg->m_pickpiecetype  == 1 && m_pickPieceDlg->m_piecked_piece != -2)
 				{
-					if(x+1<=7 && y-1 >=0)
-					{
-						if(cb[x+1][y-1].GetPieceId() == KING_WHITE)
-						{
-							return true;
-						}
-					}
-					if(x+1<=7&&y+1<=7)
-					{
-						if(cb[x+1][y+1].GetPieceId() == KING_WHITE) 					
-						{						
-							return true;
-						}
-					}					 
-				}
+					foundflag = 1;
+				}					 
 				else
 				{
-					if(x-1>=0&&y-1>=0)
-					{
-						if(cb[x-1][y-1].GetPieceId() == KING_BLACK)					
-						{						
-							return true;
-						}
-					}
-					if(x-1>=0 && y+1<=7)
-					{
-						if(cb[x-1][y+1].GetPieceId() == KING_BLACK) 
-						{						
-							return true;
-						}
-					}
-				}
-			}			 
-			return false;
-		case ROOK:
-			{			
-			int pieceid=0;
-			for(int i = x+1; i< 8; i++)
-			{
-				if((pieceid = cb[i][y].GetPieceId())  > 0)
-				{
-					if(piececolor == BLACK)
-					{
-						if(pieceid == KING_WHITE)
-						{
-							return true;
-						}
-					}
-					else
-					{
-						if(pieceid == KING_BLACK)
-						{
-							return true;
-						}
-					}
-					break;
-				}
-			}			 
-			for(int i = x-1; i > -1; i--)
-			{
-				if((pieceid = cb[i][y].GetPieceId())  > 0)
-				{
-					if(piececolor == BLACK)
-					{
-						if(pieceid == KING_WHITE)
-						{
-							return true;
-						}
-					}
-					else
-					{
-						if(pieceid == KING_BLACK)
-						{
-							return true;
-						}
-					}
-					break;
-				}
-			}			 
-			for(int i = y+1; i< 8; i++)
-			{
-				if((pieceid = cb[x][i].GetPieceId())  > 0)
-				{
-					if(piececolor == BLACK)
-					{
-						if(pieceid == KING_WHITE)
-						{
-							return true;
-						}
-					}
-					else
-					{
-						if(pieceid == KING_BLACK)
-						{
-							return true;
-						}
-					}
-					break;
-				}
-			}			 
-			for(int i = y-1; i > -1; i--)
-			{
-				if((pieceid = cb[x][i].GetPieceId())  > 0)
-				{
-					if(piececolor == BLACK)
-					{
-						if(pieceid == KING_WHITE)
-						{
-							return true;
-						}
-					}
-					else
+					if(nFlags == 0)
 					{
-						if(pieceid == KING_BLACK)
-						{
-							return true;
+						if(dlg.DoModal()==IDOK)
+						{ 
+							if( dlg.m_piecked_piece != -2)
+								foundflag = 1;
 						}
-					}
-					break;
+					}					
 				}
-			}			 
-			return false;
-			}
-			break;
-		case KNIGHT:			
-				if(piececolor == BLACK)
+				if(foundflag == 1)
 				{					
-					if(
-						(x-2 > -1 && y+1 < 8 && cb[x -2][y +1].GetPieceId()  == KING_WHITE) ||							 
-						(x-1 > -1 && y+2 < 8 && cb[x -1][y+2].GetPieceId()  == KING_WHITE) ||
-						(x+1 <8 && y+2 < 8 && cb[x +1][y+2].GetPieceId()  == KING_WHITE) ||
-						(x+2 <8 && y+1 < 8 && cb[x +2][y+1].GetPieceId()  == KING_WHITE) ||						 
-						(x+2 < 8 && y-1 > -1 && cb[x +2][y-1].GetPieceId()  == KING_WHITE) || 
-						(x+1 < 8 && y-2 > -1 && cb[x +1][y-2].GetPieceId()  == KING_WHITE) ||
-						(x-1 > -1 && y-2 > -1 && cb[x -1][y-2].GetPieceId()  == KING_WHITE) ||
-						(x-2 > -1 && y-1 > -1 && cb[x -2][y-1].GetPieceId()  == KING_WHITE))
-
-					{
-						return true;
-					}
-					else return false;
-				}
-				else
-				{
-					if(
-						(x-2 > -1 && y+1 < 8 && cb[x -2][y +1].GetPieceId()  == KING_BLACK) ||
-						(x-1 > -1 && y+2 < 8&& cb[x -1][y+2].GetPieceId()  == KING_BLACK) ||
-						(x+1 <8 && y+2 < 8 &&cb[x +1][y+2].GetPieceId()  == KING_BLACK) ||
-						(x+2 <8 && y+1 < 8 &&cb[x +2][y+1].GetPieceId()  == KING_BLACK) ||
-						(x+2 < 8 && y-1 > -1 &&cb[x +2][y-1].GetPieceId()  == KING_BLACK) ||
-						(x+1 < 8 && y-2 > -1 &&cb[x +1][y-2].GetPieceId()  == KING_BLACK) ||
-						(x-1 > -1 && y-2 > -1 &&cb[x -1][y-2].GetPieceId()  == KING_BLACK) ||
-						(x-2 > -1 && y-1 > -1 && cb[x -2][y-1].GetPieceId()  == KING_BLACK))
-
-					{
-						return true;
-					}
-					else return false;
-				}
-			break;
-		case BISHOP:
-			{			
-			int i=0,j=0,pieceid;
-			for(i = x+1,j=y+1; i< 8 && j < 8; i++,j++)
-			{
-				if((pieceid = cb[i][j].GetPieceId())  > 0)
-				{
-					if(piececolor == BLACK)
+					int piece_id;
+					COLOR_TYPE  piece_color;
+					PIECE_TYPE  piece_type;
+					STATE piece_state = PIECE_NOT_MOVING;
+					int to_piece_id;
+					COLOR_TYPE  to_piece_color;
+					PIECE_TYPE  to_piece_type;
+					STATE to_piece_state=PIECE_NOT_MOVING;
+					if(m_pickPieceDlg->m_pickpiecetype  == 1)
 					{
-						if(pieceid == KING_WHITE)
-						{
-							return true;
-						}
+						piece_id = m_pickPieceDlg->m_piecked_piece;
+						piece_color = m_pickPieceDlg->m_piece_color;
+						piece_type = m_pickPieceDlg->m_piece_type;						 						 
+						m_pickPieceDlg->m_pickpiecetype  = 0;
 					}
 					else
 					{
-						if(pieceid == KING_BLACK)
-						{
-							return true;
-						}
+						piece_id = dlg.m_piecked_piece;
+						piece_color = dlg.m_piece_color;
+						piece_type = dlg.m_piece_type;						 						 
 					}
-					break;
-				}
-			}			
-			i=0,j=0;
-			for(j=y-1,i=x-1; j> -1 && i > -1 ;i--,j--)
-			{
-				if((pieceid = cb[i][j].GetPieceId())  > 0)
-				{
-					if(piececolor == BLACK)
+					cb[i][j].GetPieceData(to_piece_id,to_piece_color,to_piece_type,to_piece_state);	
+					cb[i][j].SetPieceState(PIECE_NOT_MOVING);
+					if(m_white_on_top == false)
 					{
-						if(pieceid == KING_WHITE)
-						{
-							return true;
-						}
+						m_History[++m_iHistory].SetHistory(BOTTOM,
+								piece_type,piece_color,piece_id,i,j,
+							to_piece_type,to_piece_color,to_piece_id,i,j);
 					}
 					else
 					{
-						if(pieceid == KING_BLACK)
-						{
-							return true;
-						}
+						m_History[++m_iHistory].SetHistory(BOTTOM,
+							piece_type,piece_color,piece_id,7-i,7-j,
+							to_piece_type,to_piece_color,to_piece_id,7-i,7-j);
 					}
-					break;
+					m_topHistory = m_iHistory;
+					m_History.StorePosition(m_iHistory,m_position);
+					m_position.PutPiece(GetBoardSquare(i,j),PieceIdToPosition(piece_id));
+					cb[i][j].SetPieceData(piece_id,piece_color,piece_type,PIECE_NOT_MOVING);
+					
+					char data[30];
+					memset(data,-1,30);					 
+					data[0] = MOVE;
+					data[1] = m_white_on_top == false?FALSE:TRUE;
+					data[2] = (char)i;
+					data[3] = (char)j;
+   					data[4] = i;
+					data[5] = j;						
+					data[6] = 2;
+					memcpy(&data[7],&piece_id,4);
+					data[11] = piece_color;
+					data[12] = piece_type;
+					memcpy(&data[13],&m_whiteTime,4);
+					memcpy(&data[17],&m_blackTime,4);
+					//if(m_moveFlag == FALSE)
+					//{					
+						SendSockData((unsigned char*)data,21);
+					//}
+					//else
+					//	SendToEngine((unsigned char*)data,13);
+//					m_moveFlag = FALSE;
+					SetMoveHistory();
+					DrawBoard();
+					return;	 
+					}
+			}
+		}
+	} 
+}
+void CNetChessView::OnRButtonDown(UINT nFlags, CPoint point) 
+{
+	// TODO: Add your message handler code here and/or call default
+	if(m_manualEditingFlag == FALSE)
+	{
+		SetPaneText(MESSAGEPANE,"Editing disabled",1);
+		return;
+	}
+	if(m_pClientSocket != NULL && 
+		((m_whiteAsEngineFlag ==TRUE && m_pieceSide == WHITE) || 
+		(m_blackAsEngineFlag == TRUE && m_pieceSide ==BLACK)) )
+	{
+		SetPaneText(MESSAGEPANE,"Connected to network and Engine is playing",0);
+		return;
+	}
+	OnRButtonDownAction(0,point);
+	//valid only for manual editing	
+	CView::OnRButtonDown(nFlags, point);
+}
+
+void CNetChessView::OnUpdateToolsServer(CCmdUI* pCmdUI) 
+{
+	// TODO: Add your command update UI handler code here
+	if(m_pServerSocket == NULL)
+	{
+		pCmdUI->SetCheck(0);	
+	}
+	else
+	{
+		pCmdUI->SetCheck(1);
+	}
+	
+}
+
+void CNetChessView::OnUpdateToolsClient(CCmdUI* pCmdUI) 
+{
+	// TODO: Add your command update UI handler code here
+	if(m_pClientSocket == NULL)
+	{
+		pCmdUI->SetCheck(0);	
+	}
+	else
+	{
+		pCmdUI->SetCheck(1);
+	}	
+}
+
+void CNetChessView::OnPrint(CDC* pDC, CPrintInfo* pInfo) 
+{
+	// TODO: Add your specialized code here and/or call the base class	
+
+	 CBitmap localbmp;
+	 localbmp.LoadBitmap(IDB_BITMAP_BASE);
+	 
+	 pDC->SelectObject(&localbmp); 
+	 
+	 COLORREF cr(RGB(216,207,169));    
+	 CBrush brush(cr);
+	 pDC->SelectObject(brush);
+	 CRect crect = pInfo->m_rectDraw;
+	 
+	 COLORREF bkcrRef;    
+	 COLORREF redcr(RGB(205,177,207));
+ 
+	 CBrush redbrush;
+	 redbrush.CreateSolidBrush(redcr);
+ 
+	 COLORREF redbluecr(RGB(192,192,192));
+	 CBrush redbluebrush;
+	 redbluebrush.CreateSolidBrush(redbluecr);
+ 
+	 CBrush* pbrush = pDC->SelectObject(&redbluebrush);
+ 
+	 pDC->Rectangle(crect.left, crect.top,
+	  crect.right, crect.right);
+ 
+  
+	 COLORREF bluecr(RGB(205,177,207));//ball color
+	 CBrush bluebrush;
+	 bluebrush.CreateSolidBrush(bluecr);
+ 
+	 COLORREF greencr(RGB(0,255,0));
+	 CBrush greenbrush;
+	 greenbrush.CreateSolidBrush(greencr);
+ 
+	 pDC->SelectObject(bluebrush);
+ 
+	 int m_width = crect.Width() / 10;
+	 pDC->Rectangle(crect.left + ((m_width * 3) /4), crect.top +((m_width * 3) /4),
+	  crect.right - ((m_width * 3) /4), crect.right -((m_width * 3) /4));
+ 
+	 pbrush =  pDC->SelectObject(&redbluebrush);
+ 
+	  int xstart = m_width, ystart = m_width;
+ 
+	 for(int i = 0; i < 8; i++)
+	 {
+	  xstart = m_width;
+	  for( int j = 0; j < 8; j++)
+	  {
+	   CRect rect(xstart,ystart,xstart+m_width,ystart+m_width);
+     
+	   if(cb[i][j].GetColorType() == BLACK)
+	   {
+		CPoint pt(m_moveRect.left+25,m_moveRect.top+25);
+		if(rect.PtInRect(pt) == TRUE)
+		{
+		 bkcrRef = m_optDlg.m_crefBlackColor;
+		}           
+		if(m_movedFromRect == rect)
+		{
+		 COLORREF cr1(RGB(0,0,255));
+		 pDC->SetBkColor(cr1);
+		 CBrush brush1(cr1);      
+		 pDC->SelectObject(brush1); 
+		 pDC->FillRect(&rect,&brush1);
+		 CRect rect1(rect.left+4, rect.top + 4, rect.right -4, rect.bottom -4);
+		 CBrush brush(m_optDlg.m_crefBlackColor);
+		 pDC->SetBkColor(m_optDlg.m_crefBlackColor);
+		 pDC->SelectObject(brush); 
+		 pDC->FillRect(&rect1,&brush);
+ 
+		}
+		else if(m_movedToRect == rect)
+		{
+		 COLORREF cr1(RGB(0,0,255));
+		 pDC->SetBkColor(cr1);
+		 CBrush brush1(cr1);      
+		 pDC->SelectObject(brush1); 
+		 pDC->FillRect(&rect,&brush1);
+		 CRect rect1(rect.left+4, rect.top + 4, rect.right -4, rect.bottom -4);
+		 CBrush brush(m_optDlg.m_crefBlackColor);
+		 pDC->SetBkColor(m_optDlg.m_crefBlackColor);
+		 pDC->SelectObject(brush); 
+		 pDC->FillRect(&rect1,&brush);
+		}
+		else
+		{
+		 CBrush brush(m_optDlg.m_crefBlackColor);
+		 pDC->SetBkColor(m_optDlg.m_crefBlackColor);
+		 pDC->SelectObject(brush); 
+		 pDC->FillRect(&rect,&brush);
+		}
+	   }
+	   else if(cb[i][j].GetColorType() == WHITE)
+	   {
+		CPoint pt(m_moveRect.left+25,m_moveRect.top+25);
+		if(rect.PtInRect(pt) == TRUE)
+		{
+		 bkcrRef = m_optDlg.m_crefWhiteColor ;
+		}
+		if(m_movedFromRect == rect)
+		{
+		 COLORREF cr1(RGB(0,0,255));
+		 pDC->SetBkColor(cr1);
+		 CBrush brush1(cr1);      
+		 pDC->SelectObject(brush1); 
+		 pDC->FillRect(&rect,&brush1);
+		 CRect rect1(rect.left +4, rect.top + 4, rect.right -4, rect.bottom -4);
+		 CBrush brush(m_optDlg.m_crefWhiteColor);
+		 pDC->SetBkColor(m_optDlg.m_crefWhiteColor);
+		 pDC->SelectObject(brush); 
+		 pDC->FillRect(&rect1,&brush);
+ 
+		}
+		else if(m_movedToRect == rect)
+		{
+		 COLORREF cr1(RGB(0,0,255));
+		 pDC->SetBkColor(cr1);
+		 CBrush brush1(cr1);      
+		 pDC->SelectObject(brush1); 
+		 pDC->FillRect(&rect,&brush1);
+		 CRect rect1(rect.left +4, rect.top + 4, rect.right -4, rect.bottom -4);
+		 CBrush brush(m_optDlg.m_crefWhiteColor);
+		 pDC->SetBkColor(m_optDlg.m_crefWhiteColor);
+		 pDC->SelectObject(brush); 
+		 pDC->FillRect(&rect1,&brush);
+ 
+		}    
+		else
+		{
+		 CBrush brush(m_optDlg.m_crefWhiteColor);
+		 pDC->SetBkColor(m_optDlg.m_crefWhiteColor);
+		 pDC->SelectObject(brush); 
+		 pDC->FillRect(&rect,&brush);
+		}
+	   }
+	   if(cb[i][j].GetPieceType() != BLANK && cb[i][j].GetPieceState() != PIECE_MOVING)
+	   {
+		int piece_id;
+		COLOR_TYPE  piece_color;
+		PIECE_TYPE  piece_type;
+		STATE piece_state;
+		cb[i][j].GetPieceData(piece_id,piece_color,piece_type,piece_state);
+		if(piece_id <= 0)
+		{
+		 break;
+		}
+		/*if(m_optDlg.m_boardFont == 1)
+		{
+				CBitmap bitmap;			
+				bitmap.LoadBitmap(GetBitmapId(piece_id));			 
+				CDC bmpdc;
+				bmpdc.CreateCompatibleDC(pDC);
+				bmpdc.SelectObject(&bitmap); 
+				BITMAP bmp;
+				bitmap.GetBitmap(&bmp);
+			
+				pDC->StretchBlt(rect.left+7,rect.top+7,m_squareWidth -15,m_squareWidth-15,&bmpdc,0,0,bmp.bmWidth,bmp.bmHeight,SRCCOPY); 
+		}
+		else
+		{					
+				CString piece;
+				if(GetPieceString(piece_id,piece) == 0)
+				{				
+					//CRect rct(rect.left+10,rect.top+10,rect.right-10,rect.bottom-10);
+					CFont *fnt = pDC->SelectObject(&m_optDlg.m_font);
+					pDC->DrawText(piece,rect,0);//DT_CENTER | DT_VCENTER);
+					//COLORREF white(RGB(255,255,255)), black(RGB(0,0,0));
+					//ldc->SetBkColor(TRANSPARENT);
+					//ldc->SetTextColor(piece_color == WHITE? white : black);
+					//ldc->TextOut(rect.left+5,rect.top+5,piece);
+					pDC->SelectObject(fnt);
 				}
-			}			
-			i=0,j=0;
-			for(j=y-1,i=x+1; j> -1 && i < 8;i++,j--)
+		}*/
+
+		CBitmap bitmap;
+		
+		bitmap.LoadBitmap(GetBitmapId(piece_id));    
+		CDC bmpdc;
+		bmpdc.CreateCompatibleDC(pDC);
+		bmpdc.SelectObject(&bitmap); 
+ 
+		BITMAP bmp;
+		bitmap.GetBitmap(&bmp);
+		
+     
+		pDC->StretchBlt(rect.left+(m_width /6),(rect.top + m_width/6),(int)(m_width/1.5),(int)(m_width/1.5),&bmpdc,0,0,bmp.bmWidth,bmp.bmHeight,SRCCOPY); 
+	   }
+	   
+	   xstart += m_width;
+	  }  
+	  ystart += m_width;
+	 }
+ 
+	 pDC->SetBkColor(redbluecr);
+	 for(int i=0;i<8;i++)
+	 {  
+	  if(m_LetterFlag == true)
+	  {
+	   if(m_white_on_top == false)
+	   {
+		pDC->TextOut(m_width * (i+1)+10,(m_width * 1)/ 3,(CString)((char)('a'+i)));
+		pDC->TextOut(m_width * (i+1)+10,crect.right - ((m_width * 2)/ 3), (char)('a'+i));
+	   }
+	   else
+	   {
+		pDC->TextOut(m_width * (i+1),(m_width * 2)/ 3,(CString)((char)('h'-i)));
+		pDC->TextOut(m_width * (i+1),crect.right - ((m_width * 2)/ 3), (char)('h'- i));
+	   }
+	  }
+	  if(m_NumberFlag == true)
+	  {
+	   if(m_white_on_top == false)
+	   {
+		pDC->TextOut((m_width * 1)/ 3, m_width * (i+1), (CString)((char)('8' - i)));
+		pDC->TextOut(crect.right - ((m_width * 2)/ 3), m_width * (i+1), (char)('8' - i));
+	   }
+	   else
+	   {
+		pDC->TextOut((m_width * 1)/ 3, m_width * (i+1), (CString)((char)('1' + i)));
+		pDC->TextOut(crect.right - ((m_width * 2)/ 3), m_width * (i+1), (char)('1' + i));
+	   }
+	  }
+	 }
+CView::OnPrint(pDC, pInfo);
+}
+
+void CNetChessView::OnTimer(UINT nIDEvent) 
+{
+	
+	static int count = 0;
+	static int state=1;	 
+	switch(nIDEvent)
+	{
+		case SHELL_ICON_TIMER_EVENT_ID:
 			{
-				if((pieceid = cb[i][j].GetPieceId())  > 0)
+				NOTIFYICONDATA nicondata;
+				char data[64] = "NetChess by A.V.M.Rao";
+				 
+				nicondata.hWnd = AfxGetApp()->m_pMainWnd->GetSafeHwnd();
+				nicondata.uID = 10;
+				nicondata.uFlags = NIF_ICON |NIF_MESSAGE | NIF_TIP; 
+				nicondata.cbSize = sizeof(nicondata);
+				nicondata.uCallbackMessage = MY_MESSAGE_SHELLNOTIFY;
+				nicondata.hIcon = AfxGetApp()->LoadIcon(IDR_MAINFRAME);
+				strcpy(nicondata.szTip,data);				
+				if(state == 1)
 				{
-					if(piececolor == BLACK)
-					{
-						if(pieceid == KING_WHITE)
-						{
-							return true;
-						}
-					}
-					else
-					{
-						if(pieceid == KING_BLACK)
-						{
-							return true;
-						}
-					}
-					break;
+					nicondata.hIcon = AfxGetApp()->LoadIcon(IDR_MAINFRAME);
+					Shell_NotifyIcon(NIM_MODIFY,&nicondata);
+					state = 0;
 				}
-			}			
-			i=0,j=0;
-			for(j=y+1,i=x-1; j< 8 && i > -1;i--,j++)
-			{
-				if((pieceid = cb[i][j].GetPieceId())  > 0)
+				else
 				{
-					if(piececolor == BLACK)
-					{
-						if(pieceid == KING_WHITE)
-						{
-							return true;
-						}
-					}
-					else
-					{
-						if(pieceid == KING_BLACK)
-						{
-							return true;
-						}
-					}
-					break;
+					nicondata.hIcon = AfxGetApp()->LoadIcon(IDI_ICON_MAINFRAME_OPPOSITE);
+					state = 1;
+					Shell_NotifyIcon(NIM_MODIFY,&nicondata);
 				}
-			}			 
-			return false;
-			}			 
+			}
 			break;
-		case QUEEN:
-			{			
-			int i=0,j=0,pieceid;
-			for(i = x+1,j=y+1; i< 8 && j < 8; i++,j++)
-			{
-				if( (pieceid = cb[i][j].GetPieceId())  > 0)
-				{
-					if(piececolor == BLACK)
-					{
-						if(pieceid == KING_WHITE)
-						{
-							return true;
-						}
-					}
-					else
-					{
-						if(pieceid == KING_BLACK)
-						{
-							return true;
-						}
-					}
-					break;
-				}
-			}			
-			i=0,j=0;
-			for(j=y-1,i=x-1; j> -1 && i > -1 ;i--,j--)
-			{
-				if( (pieceid = cb[i][j].GetPieceId())  > 0)
-				{
-					if(piececolor == BLACK)
-					{
-						if(pieceid == KING_WHITE)
-						{
-							return true;
-						}
-					}
-					else
-					{
-						if(pieceid == KING_BLACK)
-						{
-							return true;
-						}
-					}
-					break;
-				}
-			}			
-			i=0,j=0;
-			for(j=y-1,i=x+1; j> -1 && i < 8;i++,j--)
+		case PIECE_SIDE_TIMER_EVENT_ID:
 			{
-				if((pieceid = cb[i][j].GetPieceId())  > 0)
+				//if ICS Timer is sarted or clock type is 
+				//CONVENTIONAL, ICS TYPE, MOVETIME use ICS Timer
+				if(m_icsFlag == TRUE)
+					/*||
+				   m_timeControlDlg.m_radio_clock_type == CONVENTIONAL ||
+				   m_timeControlDlg.m_radio_clock_type == ICSTYPE ||
+				   m_timeControlDlg.m_radio_clock_type == MOVETIME) //for ICS games it should be decremented*/
+					return;
+				//Update the Status bar with last move info 
+				//for every two seconds
+				if(count == 2)
 				{
-					if(cb[x][y].GetPieceColor() == BLACK)
-					{
-						if(pieceid == KING_WHITE)
-						{
-							return true;
-						}
-					}
-					else
+					count = 0;
+					if(m_iHistory > -1)
 					{
-						if(pieceid == KING_BLACK)
-						{
-							return true;
-						}
+						CString str = m_History.GetMoveInfo(m_iHistory);
+						if(!str.IsEmpty())
+							SetPaneText(MESSAGEPANE,str);
 					}
-					break;
 				}
-			}			
-			i=0,j=0;
-			for(j=y+1,i=x-1; j< 8 && i > -1;i--,j++)
-			{
-				if((pieceid = cb[i][j].GetPieceId())  > 0)
+				count++;
+				if(m_pauseclockFlag == TRUE)
 				{
-					if(piececolor == BLACK)
-					{
-						if(pieceid == KING_WHITE)
-						{
-							return true;
-						}
-					}
-					else
-					{
-						if(pieceid == KING_BLACK)
-						{
-							return true;
-						}
-					}
+					m_elapsedTime++;
 					break;
 				}
-			}			 
-			}			 
-			{
-			int pieceid = 0;
-			for(int i = x+1; i< 8; i++)
-			{
-				if( (pieceid = cb[i][y].GetPieceId())  > 0)
+				//m_pClientSocket is NULL means the timer is only for 
+				//for the board
+				if(m_pClientSocket == NULL)
 				{
-					if(piececolor == BLACK)
-					{
-						if(pieceid == KING_WHITE)
-						{
-							return true;
+					//my piece side is black and player turn is true
+					if(m_pieceSide == BLACK && m_player_turn == true)
+					{	
+
+						m_blackTime--;
+						if(m_blackTime >= 0)
+						{					
+							//set black time
+							CTime tb( m_blackTime);
+							CTime st(0);						
+							CTimeSpan ts = tb - st; 
+							CString str;
+							str.Format("%d:%d:%d",ts.GetHours(),ts.GetMinutes(),ts.GetSeconds());					 
+							SetPaneText(BLACKTIME,str);
+							if(m_blackTime == 0)
+							{
+								CString str;
+								str.Format("Black side timeout");					 
+								AfxMessageBox(str);
+							}
 						}
+						/*CTime tb(time(0)  -  m_blackTime);						
+						CTime st(m_startTime+m_elapsedTime);
+						CTimeSpan ts = tb - st; 
+						m_blackTime++;
+						CString str;
+						str.Format("%d:%d:%d",ts.GetHours(),ts.GetMinutes(),ts.GetSeconds());					 
+						//str.Format("%d:%d:%d",t->tm_hour,t->tm_min,t->tm_sec);
+
+						SetPaneText(BLACKTIME,str);*/
 					}
-					else
-					{
-						if(pieceid == KING_BLACK)
+					else if(m_pieceSide == WHITE && m_player_turn == true)
+					{					 
+						m_whiteTime--;
+						if(m_whiteTime >=0)
 						{
-							return true;
+							//set white
+							CTime tb(m_whiteTime);
+							CTime st(0);
+							CTimeSpan ts = tb - st; 
+							CString str;
+							str.Format("%d:%d:%d",ts.GetHours(),ts.GetMinutes(),ts.GetSeconds());					 
+							//str.Format("%d:%d:%d",t->tm_hour,t->tm_min,t->tm_sec);
+							SetPaneText(WHITETIME,str);
+							if(m_whiteTime == 0)
+							{
+								CString str;
+								str.Format("White side timeout");					 
+								//SetPaneText(MESSAGEPANE,str);
+								AfxMessageBox("White side timeout");
+							}
 						}
+						/*CTime tb( time(0)- m_whiteTime);
+						CTime st(m_startTime+ m_elapsedTime);						
+						CTimeSpan ts = tb - st; 												
+						m_whiteTime++;
+						CString str;
+						str.Format("%d:%d:%d",ts.GetHours(),ts.GetMinutes(),ts.GetSeconds());					 
+						SetPaneText(WHITETIME,str);*/
 					}
-					break;
 				}
-			}			 
-			for(int i = x-1; i > -1; i--)
-			{
-				if( (pieceid = cb[i][y].GetPieceId())  > 0)
+				else //timer is client server
 				{
-					if(piececolor == BLACK)
-					{
-						if(pieceid == KING_WHITE)
-						{
-							return true;
+					if(m_pieceSide == BLACK && m_player_turn == true || (m_pieceSide == WHITE && m_player_turn == false))
+					{	
+						m_blackTime--;
+						if(m_blackTime >= 0)
+						{					
+							//set black time
+							CTime tb( m_blackTime);
+							CTime st(0);						
+							CTimeSpan ts = tb - st; 
+							CString str;
+							str.Format("%d:%d:%d",ts.GetHours(),ts.GetMinutes(),ts.GetSeconds());					 
+							SetPaneText(BLACKTIME,str);
 						}
+						/*CTime tb(time(0)  -  m_blackTime);
+						CTime st(m_startTime+m_elapsedTime);
+						CTimeSpan ts = tb - st; 
+						m_blackTime++;
+						CString str;
+						str.Format("%d:%d:%d",ts.GetHours(),ts.GetMinutes(),ts.GetSeconds());					 
+						//str.Format("%d:%d:%d",t->tm_hour,t->tm_min,t->tm_sec);
+
+						SetPaneText(BLACKTIME,str);*/
 					}
-					else
-					{
-						if(pieceid == KING_BLACK)
+					else if(m_pieceSide == WHITE && m_player_turn == true || (m_pieceSide == BLACK && m_player_turn == false))
+					{	
+						m_whiteTime--;
+						if(m_whiteTime >=0)
 						{
-							return true;
+							//set white
+							CTime tb(m_whiteTime);
+							CTime st(0);
+							CTimeSpan ts = tb - st; 
+							CString str;
+							str.Format("%d:%d:%d",ts.GetHours(),ts.GetMinutes(),ts.GetSeconds());					 
+							//str.Format("%d:%d:%d",t->tm_hour,t->tm_min,t->tm_sec);
+							SetPaneText(WHITETIME,str);
 						}
+						/*CTime tb( time(0)- m_whiteTime);						
+						CTime st(m_startTime+m_elapsedTime);
+						CTimeSpan ts = tb - st; 
+						m_whiteTime++;
+						CString str;
+						str.Format("%d:%d:%d",ts.GetHours(),ts.GetMinutes(),ts.GetSeconds());					 
+						SetPaneText(WHITETIME,str);*/
 					}
-					break;
 				}
-			}			 
-			for(int i = y+1; i< 8; i++)
+			}
+			break;
+		case DEMO_TIMER_EVENT_ID:
 			{
-				if((pieceid = cb[x][i].GetPieceId())  > 0)
-				{
-					if(piececolor == BLACK)
-					{
-						if(pieceid == KING_WHITE)
-						{
-							return true;
-						}
-					}
-					else
-					{
-						if(pieceid == KING_BLACK)
-						{
-							return true;
-						}
-					}
-					break;
+				if(m_demoTotal <= m_topHistory && m_demoFlag == TRUE && m_pauseFlag == FALSE)
+				{				
+					m_demoTotal++;
+					OnEditRedoAction(1);
+ 					unsigned char msg[2];
+					msg[0] = REDO;
+					msg[1] = 1;
+					SendSockData((unsigned char*)msg,2); 					
 				}
-			}			 
-			for(int i = y-1; i > -1; i--)
+				else if(m_pauseFlag != TRUE)
+				{
+					m_demoTotal = 0;
+					KillTimer(DEMO_TIMER_EVENT_ID);
+					m_demoFlag = FALSE;
+					unsigned char msg[1];
+					msg[0] = DEMO_END;
+					SendSockData(msg,1);
+					//CString result = "Demo over: Result-" + m_gameInfoDlg.m_edit_result;
+					//AfxMessageBox(result);
+					Sleep(5000);
+					OnFileLoadnextgame();
+					m_demoFlag = TRUE;
+					m_manualEditingFlag = FALSE;
+					OnEditMovefirst();
+					m_demoTotal = 0;
+
+					SetTimer(DEMO_TIMER_EVENT_ID_ALL, m_demoInterval * 1000, NULL);
+					
+				}	
+			}
+			break;
+		case DEMO_TIMER_EVENT_ID_ALL:
+		{
+			if (m_demoTotal <= m_topHistory && m_demoFlag == TRUE && m_pauseFlag == FALSE)
+			{
+				m_demoTotal++;
+				OnEditRedoAction(1);
+				unsigned char msg[2];
+				msg[0] = REDO;
+				msg[1] = 1;
+				SendSockData((unsigned char*)msg, 2);
+			}
+			else if (m_pauseFlag != TRUE)
+			{
+				m_demoTotal = 0;
+				KillTimer(DEMO_TIMER_EVENT_ID_ALL);
+				m_demoFlag = FALSE;
+				unsigned char msg[1];
+				msg[0] = DEMO_END;
+				SendSockData(msg, 1);
+				//CString result = "Demo over: Result-" + m_gameInfoDlg.m_edit_result;
+				//AfxMessageBox(result);
+				Sleep(5000);
+				OnFileLoadnextgame();
+				m_demoFlag = TRUE;
+				m_manualEditingFlag = FALSE;
+				OnEditMovefirst();
+				m_demoTotal = 0;
+				
+				SetTimer(DEMO_TIMER_EVENT_ID_ALL, m_demoInterval * 1000, NULL);
+
+			}
+		}
+		break;
+		case SAVE_TIMER_EVENT_ID:
 			{
-				if( (pieceid = cb[x][i].GetPieceId())  > 0)
+				if(!m_fileName.IsEmpty())
+					OnFileSave();				
+				/*char defaultBuf[40]="default";
+				char CurrentDir[255];
+				GetWindowsDirectory(CurrentDir,MAX_PATH);
+				strcat(CurrentDir,"\\NetChess.ini");
+				CStringArray ar;
+				CString str = GetHistoryString(ar,0);
+				str.Replace("\r","");	
+				str = str + "\n";
+				WritePrivateProfileString("NetChess","PGNFormat",str,CurrentDir);*/
+			}
+			break;
+		case ICS_TIMER:
+			{				 
+				if(m_icsFlag == TRUE ||
+				   m_timeControlDlg.m_radio_clock_type == CONVENTIONAL ||
+				   m_timeControlDlg.m_radio_clock_type == ICSTYPE ||
+				   m_timeControlDlg.m_radio_clock_type == MOVETIME)
+
 				{
-					if(piececolor == BLACK)
+					
+					
+					if(m_pieceSide == WHITE && m_player_turn == true || (m_pieceSide == BLACK && m_player_turn == false))
 					{
-						if(pieceid == KING_WHITE)
+						m_whiteTime--;
+						if(m_whiteTime >=0)
 						{
-							return true;
+							//set white
+							CTime tb(m_whiteTime);
+							CTime st(0);
+							CTimeSpan ts = tb - st; 
+							CString str;
+							str.Format("%d:%d:%d",ts.GetHours(),ts.GetMinutes(),ts.GetSeconds());					 
+							//str.Format("%d:%d:%d",t->tm_hour,t->tm_min,t->tm_sec);
+							SetPaneText(WHITETIME,str);
 						}
 					}
-					else
+					else if(m_pieceSide == BLACK && m_player_turn == true || (m_pieceSide == WHITE && m_player_turn == false))
 					{
-						if(pieceid == KING_BLACK)
-						{
-							return true;
+						m_blackTime--;
+						if(m_blackTime >= 0)
+						{					
+							//set black time
+							CTime tb( m_blackTime);
+							CTime st(0);						
+							CTimeSpan ts = tb - st; 
+							CString str;
+							str.Format("%d:%d:%d",ts.GetHours(),ts.GetMinutes(),ts.GetSeconds());					 
+							SetPaneText(BLACKTIME,str);
 						}
 					}
-					break;
-				}
-			}			 
-			return false;
-			}
-			break;
-		case KING:			
-			return false;
-			break;
-		default:
-			break;
-		}	 
 
-	return false;
-}
-bool CNetChessView::CheckKingMove(int fromx, int fromy, int tox, int toy)
-{
-	if( m_checkmove == FALSE)
-		return true;
-	for(int i=0;i<8;i++)
-	{
-		for(int j = 0;j<8;j++)
-		{
-			if(cb[i][j].GetPieceId() > 0&& cb[tox][toy].GetPieceColor() != cb[i][j].GetPieceColor())
-			{
-				if(CheckCheckState(cb[i][j].GetPieceType(),cb[i][j].GetPieceColor() ,i,j) == true)
-				{
-					return false;
 				}
-			}
-		}
-	}
-	return true;
-}
-void CNetChessView::SetMoveHistory()
-{
-	unsigned int action = 0x0000;
-	action = m_blackKingMovedFlag == true? (action | 0x0020) : (action & 0xffff);	
-	action = m_whiteKingMovedFlag == true? (action | 0x0010) : (action & 0xffff);
-	action = m_blackRookRank1MovedFlag == true? (action | 0x0008): (action & 0xffff);
-	action = m_blackRookRank7MovedFlag == true?(action | 0x0004): (action & 0xffff);
-	action = m_whiteRookRank1MovedFlag == true?(action | 0x0002): (action & 0xffff);
-	action = m_whiteRookRank7MovedFlag == true?(action | 0x0001): (action & 0xffff);
-	action = m_checkFlag == TRUE? (action | 0x0040): (action & 0xffff);
-	action = m_castlingFlag == TRUE? (action | 0x0080): (action & 0xffff);
-	action = m_promotionFlag == TRUE? (action | 0x0100): (action & 0xffff);
-	action = m_enpassentFlag == TRUE? (action | 0x0200): (action & 0xffff);
-	action = m_ambiguousMoveFileFlag == TRUE? (action | 0x0400): (action & 0xffff);
-	action = m_ambiguousMoveRankFlag == TRUE? (action | 0x0800): (action & 0xffff);
-	m_History[m_iHistory].SetPieceMoveAction(action);
-	/*writeMessage("%d %d %d %d %d %d",m_blackKingMovedFlag,
-		m_whiteKingMovedFlag,m_blackRookRank1MovedFlag,	
-		m_blackRookRank7MovedFlag,	m_whiteRookRank1MovedFlag,
-		m_whiteRookRank7MovedFlag);*/
-}
-void CNetChessView::GetMoveHistory()
-{
-	if(m_iHistory < 0)
-	{
-		m_ambiguousMoveRankFlag = FALSE;
-		m_ambiguousMoveFileFlag = FALSE;
-		m_enpassentFlag = FALSE;
-		m_promotionFlag = FALSE;
-		m_castlingFlag  = FALSE ;
-		m_checkFlag     = FALSE;
-		m_blackKingMovedFlag = false;
-		m_whiteKingMovedFlag = false;
-		m_blackRookRank1MovedFlag = false;
-		m_blackRookRank7MovedFlag = false;
-		m_whiteRookRank1MovedFlag = false ;
-		m_whiteRookRank7MovedFlag = false;
-		return;
-	}
-	unsigned int action = m_History[m_iHistory].GetPieceMoveAction();
-	action = action & 0x0fff;
-	m_ambiguousMoveRankFlag = (0x0800 & action) ==0 ? FALSE : TRUE;
-	m_ambiguousMoveFileFlag = (0x0400 & action) == 0 ?FALSE : TRUE;
-	m_enpassentFlag = (0x0200 & action) == 0 ? FALSE: TRUE;
-	m_promotionFlag = (0x0100 & action) == 0 ? FALSE: TRUE;
-	m_castlingFlag  = (0x0080 & action) == 0 ? FALSE : TRUE;
-	m_checkFlag     = (0x0040 & action) == 0 ? FALSE : TRUE;
-	m_blackKingMovedFlag = (0x0020 & action) == 0 ? false: true;
-	m_whiteKingMovedFlag = (0x0010 & action) == 0 ? false : true;
-	m_blackRookRank1MovedFlag = (0x0008 & action) == 0 ? false : true;
-	m_blackRookRank7MovedFlag = (0x0004 & action) == 0 ? false : true;
-	m_whiteRookRank1MovedFlag = (0x0002 & action) == 0 ? false : true;
-	m_whiteRookRank7MovedFlag = (0x0001 & action) == 0 ? false : true;
-	/*writeMessage("%d %d %d %d %d %d",m_blackKingMovedFlag,
-		m_whiteKingMovedFlag,m_blackRookRank1MovedFlag,	
-		m_blackRookRank7MovedFlag,	m_whiteRookRank1MovedFlag,
-		m_whiteRookRank7MovedFlag);*/
+
+				break;
+			}
+		case ANALYSIS_TIMER_EVENT_ID:
+			ShowAnalysis();
+			break;
+		default:
+			break;
+		 
+	}
+	CView::OnTimer(nIDEvent);
+}
+void CNetChessView::KillTimerEvent()
+{
+	 
+	KillTimer(SHELL_ICON_TIMER_EVENT_ID);
+	m_timerFlag = false;
 }
 
-void CNetChessView::writeMessage(char *str,...)
+int CNetChessView::OnFileNewAction()
 {
-//#ifdef _DEBUG
-	if(m_optDlg.m_check_netchess_log == TRUE)
-	{
-		char arr[9999];
-		va_list va;     
-		va_start(va,str);
-		vsprintf(arr,str,va);
-		CString filename = ".\\" + m_edit_name + "_Log.txt";
-		FILE* fp=fopen(filename,"a+");
-		if(fp != NULL)
+	if(m_iHistory > -1)
+	{		 
+		int ret = AfxMessageBox("Do you want to save the playing game",MB_YESNOCANCEL);
+		if(ret == IDYES)
 		{
-			time_t t= time(0);
-			CTime ctime(t);			
-			
-			fprintf(fp,"%d/%d/%d %d:%d:%d: %s\n",
-				ctime.GetDay(),ctime.GetMonth(),ctime.GetYear(),
-				ctime.GetHour(),ctime.GetMinute(),ctime.GetSecond(),
-				arr);
-			fclose(fp);
+			OnFileSave();			 
+		}
+		else if(ret == IDCANCEL)
+		{
+			return -1;
 		}
 	}
-//#endif
+	Initialize();
+//	OnInitialUpdate();
+	if(m_pieceSide == BLACK)
+	{
+		m_player_turn = false;
+	}
+	else
+	{
+		m_player_turn = true;
+	}
+	DrawBoard();	
+	return 0;
 }
 
-void CNetChessView::OnEditCheckmove() 
+void CNetChessView::OnViewHistory() 
 {
-	// TODO: Add your command handler code here		
-	if(m_manualEditingFlag == TRUE)
-	{
-		m_checkmove = m_checkmove == TRUE ? FALSE: TRUE;
-		unsigned char data[50];
-		data[0]=CHECKLEGALMOVE;
-		data[1] = m_checkmove;
-		strcpy((char*)&data[2],m_edit_name.GetBuffer(0));
-		SendSockData(data,m_edit_name.GetLength()+2);	
-		if(m_checkmove == TRUE)
-			AfxMessageBox("Enabled checking valid move");
-		else
-			AfxMessageBox("Disabled checking valid move");
-	}
+	 /*if(m_iHistory < 0)
+	 {
+		 AfxMessageBox("History not found");
+		 return;
+	 }*/
+	  CHistoryDlg dlg(this,&m_History,m_iHistory);
+	  dlg.DoModal();
 }
 
+void CNetChessView::OnToolsWhiteontop() 
+{	
+}
 
-void CNetChessView::OnUpdateEditCheckmove(CCmdUI* pCmdUI) 
+void CNetChessView::OnEditMovefirst() 
 {
-	// TODO: Add your command update UI handler code here	
-	m_checkmove == TRUE ? pCmdUI->SetCheck(1) : pCmdUI->SetCheck(0);
-	m_manualEditingFlag == TRUE ? pCmdUI->Enable(TRUE) : pCmdUI->Enable(FALSE);
+	// TODO: Add your command handler code here	
+	GoToPly(-1);
+	unsigned char msg[2];
+	msg[0] = MOVEFIRST;
+	msg[1] = 0;
+	SendSockData((unsigned char*)msg,2);
+	DrawBoard();
+}
+
+void CNetChessView::OnEditMovelast() 
+{
+	// TODO: Add your command handler code here	
+	GoToPly(m_topHistory);
+	unsigned char msg[2];
+	msg[0] = MOVELAST;
+	msg[1] = 0;
+	SendSockData((unsigned char*)msg,2);
 
+	DrawBoard();
+		 	
 }
 
-void CNetChessView::OnEditManualeditEmpty() 
+void CNetChessView::OnHelpHowtoplay() 
+{
+	CHowToPlayDlg dlg;
+	dlg.DoModal();
+	// TODO: Add your command handler code here*/ 
+
+	
+}
+
+void CNetChessView::OnToolsDisconnect() 
 {
 	// TODO: Add your command handler code here
-	OnEditCopy();
-	if(m_manualEditingFlag == TRUE)
+	 
+	if(m_pClientSocket == NULL)
 	{
-		for ( int i = 0; i < 8; i++)
-		{	
-			for( int j = 0; j < 8; j++)
+		AfxMessageBox("Not connected to network");
+		if(m_pServerSocket != NULL)
+		{
+			if(AfxMessageBox("Are you sure, you want to disconnect",MB_YESNO)==IDYES)
 			{
-				cb[i][j].SetPieceData(-1,NONE,BLANK,PIECE_NOT_MOVING);				 
-			}	
+				delete m_pServerSocket;
+				m_pServerSocket = NULL;
+			}
 		}
-		m_iHistory = -1;
-		DrawBoard();
-		unsigned char data[1];
-		data[0] = MANUALEDITING_EMPTY;
-		SendSockData(data,1);
+		return;
 	}
-	else
-	{
-		AfxMessageBox("Editing disabled");
+	if(m_pClientSocket != NULL)
+	{ 
+		if(AfxMessageBox("Are you sure, you want to disconnect",MB_YESNO)==IDYES)
+		{
+			m_pClientSocket->ShutDown(2);
+			m_pClientSocket->Close();
+			delete m_pClientSocket;
+			m_pClientSocket = NULL; 
+		}
 	}
 }
 
-void CNetChessView::OnEditManualeditEnd() 
-{
-	// TODO: Add your command handler code here	
-}
-
-void CNetChessView::OnEditManualeditPlayerturn() 
+void CNetChessView::OnEditProperties() 
 {
 	// TODO: Add your command handler code here
-	if(m_manualEditingFlag == false)
-	{
-		AfxMessageBox("Editing disabled");
-		return;
-	}
-	
-	int ret = AfxMessageBox("Choose Player turn,White turn - Yes,Black turn - No",MB_YESNOCANCEL);
-	if(ret == IDYES)
+	CPropertiesDlg dlg(this);
+	if(m_pServerSocket != NULL)
 	{
-		if(m_pClientSocket == NULL)
+		if(m_pClientSocket != NULL)
 		{
-			m_player_turn = true;
-			m_pieceSide = WHITE;
+			CString ipaddr;int port;
+			((CClientSocket*)m_pClientSocket)->GetInfo(ipaddr,port);
+			dlg.SetInfo(SERVER,ipaddr,port,((CServerSocket*)m_pServerSocket)->m_portnumber);
 		}
 		else
 		{
-			unsigned char data[2];
-			data[0]=MANUALEDITING_PLAYER_TURN;
-			data[1] = false;
-			m_player_turn = true;			
-			SendSockData(data,2);		
+			dlg.SetInfo(SERVER," ",0,((CServerSocket*)m_pServerSocket)->m_portnumber);			 
 		}
 	}
-	else if(ret == IDCANCEL)
+	else if(m_pClientSocket != NULL)
 	{
-		return;
+		CString ipaddr;int port;
+		((CClientSocket*)m_pClientSocket)->GetInfo(ipaddr,port);
+		dlg.SetInfo(CLIENT,ipaddr,port,0);
 	}
 	else
 	{
-		if(m_pClientSocket == NULL)
-		{
-			m_player_turn = true;
-			m_pieceSide = BLACK;
-		}
-		else
-		{
-			unsigned char data[2];
-			data[0]=MANUALEDITING_PLAYER_TURN;
-			data[1] = true;
-			m_player_turn = false;			
-			SendSockData(data,2);		
-		}
+		dlg.SetInfo(-1,"",0,0);
 	}
+	dlg.DoModal();	
 }
 
-void CNetChessView::OnEditManualeditStart() 
+
+void CNetChessView::OnToolsDraw() 
 {
 	// TODO: Add your command handler code here
-	if(m_demoFlag == TRUE && m_pauseFlag == FALSE)
-	{
-		AfxMessageBox("Replay is in progress! Puase the demo to activate this feature");
-		return;
-	}
-	if(m_manualEditingFlag == false)
-	{
-		if(AfxMessageBox("Requesting for Manual editing. Proceed?",MB_YESNO) == IDNO)
-		{
-			return;
-		}
-	}
-	else
+	if(AfxMessageBox("Do you want to send Draw request?",MB_YESNO) == IDYES)
 	{
-		AfxMessageBox("Manual editing disabled");
+		unsigned char data[50];
+		data[0]=DRAW_REQUEST;
+		strcpy((char*)&data[1],m_edit_name.GetBuffer(0));
+		SendSockData(data,m_edit_name.GetLength()+2);	
 	}
-	if(m_pClientSocket == NULL)
+}
+
+void CNetChessView::OnToolsResign() 
+{
+	// TODO: Add your command handler code here
+	if(AfxMessageBox("Do you want to send Resign messge?",MB_YESNO) == IDYES)
 	{
-		m_manualEditingFlag = m_manualEditingFlag == TRUE ? FALSE: TRUE;
+		unsigned char data[50];
+		data[0]=RESIGN_REQUEST;
+		strcpy((char*)&data[1],m_edit_name.GetBuffer(0));
+		SendSockData(data,m_edit_name.GetLength()+2);	
+		OnFileNewgame();
+		SendToEngine(data,m_edit_name.GetLength()+2);
 	}
-	else
-	{
-		
-		if(m_manualEditingFlag == FALSE)
-		{
-			unsigned char data[50];
-			data[0]=MANUALEDITING_START;
-			strcpy((char*)&data[1],m_edit_name.GetBuffer(0));
-			SendSockData(data,m_edit_name.GetLength()+2);		
-		}
-		else
-		{
-			unsigned char data[2];;
-			m_manualEditingFlag = FALSE;
-			data[0]=MANUALEDITING_END;
-			SendSockData(data,m_edit_name.GetLength()+2);		
-		}
-		//data[1] = m_checkmove;		
+}
+void CNetChessView::SetPieceSide(COLOR_TYPE pieceside)
+{
+	m_pieceSide = pieceside;
+	if(m_pieceSide == WHITE)
+	{
+		m_player_turn = true;
+		m_white_on_top = false;
+		SetPaneText(PLAYERNAME,"WHITE");
+		m_gameInfoDlg.m_edit_white = m_edit_name;
+	}
+	else
+	{
+		m_player_turn = false;
+		//Initialize()
+//		OnInitialUpdate();
+		FlipBoard();
+		m_white_on_top = true;
+		SetPaneText(PLAYERNAME,"BLACK");	
+		m_gameInfoDlg.m_edit_black = m_edit_name;
 	}
+	m_blackTime = m_whiteTime =m_engineLevelDlg.m_edit_time_control == 0? 5*60: m_engineLevelDlg.m_edit_time_control*60;
+	m_elapsedTime = 0;
+	m_startTime = (int)time(0);
+	m_manualEditingFlag = FALSE;
+	m_demoFlag = FALSE;
+	DrawBoard();
+
 }
 
-void CNetChessView::OnUpdateEditManualeditStart(CCmdUI* pCmdUI) 
+COLOR_TYPE CNetChessView::GetPlayerSide()
 {
-	// TODO: Add your command update UI handler code here
-		m_manualEditingFlag == TRUE ? pCmdUI->SetCheck(1) : pCmdUI->SetCheck(0);
-		m_observerFlag == TRUE ? pCmdUI->Enable(FALSE) : pCmdUI->Enable(TRUE);
+	return m_pieceSide;
 }
 
-
-void CNetChessView::OnUpdateEditManualeditEmpty(CCmdUI* pCmdUI) 
+void CNetChessView::OnViewLostpieces() 
 {
-	// TODO: Add your command update UI handler code here
-	m_manualEditingFlag == TRUE ? pCmdUI->Enable(TRUE) : pCmdUI->Enable(FALSE);
+	CLostPieceDlg dlg;
+	dlg.SetHistory(&m_History,m_iHistory);
+	dlg.DoModal();
 }
 
-void CNetChessView::OnUpdateEditManualeditPlayerturn(CCmdUI* pCmdUI) 
+void CNetChessView::OnFileFeed() 
 {
-	// TODO: Add your command update UI handler code here
-	m_manualEditingFlag == TRUE ? pCmdUI->Enable(TRUE) : pCmdUI->Enable(FALSE);
+//obsolete function/remove later
 }
 
-void CNetChessView::OnUpdateEditMovefirst(CCmdUI* pCmdUI) 
+void CNetChessView::OnToolsLearn() 
 {
-	// TODO: Add your command update UI handler code here
-	m_manualEditingFlag == TRUE ? pCmdUI->Enable(TRUE) : pCmdUI->Enable(FALSE);
+	// TODO: Add your command handler code here	
 }
 
-void CNetChessView::OnUpdateEditMovelast(CCmdUI* pCmdUI) 
+void CNetChessView::OnEditSetboard() 
 {
-	// TODO: Add your command update UI handler code here
-	m_manualEditingFlag == TRUE ? pCmdUI->Enable(TRUE) : pCmdUI->Enable(FALSE);
+	
 }
 
-void CNetChessView::OnUpdateEditRedo(CCmdUI* pCmdUI) 
+void CNetChessView::OnRButtonUp(UINT nFlags, CPoint point) 
 {
-	// TODO: Add your command update UI handler code here
-	m_manualEditingFlag == TRUE ? pCmdUI->Enable(TRUE) : pCmdUI->Enable(FALSE);
+	// TODO: Add your message handler code here and/or call default
+	 
+	CView::OnRButtonUp(nFlags, point);
 }
-
-void CNetChessView::OnUpdateEditUndo(CCmdUI* pCmdUI) 
+bool CNetChessView::CheckCheckState(int piecetype, int piececolor,int x,int y)
 {
-	// TODO: Add your command update UI handler code here
-	m_manualEditingFlag == TRUE ? pCmdUI->Enable(TRUE) : pCmdUI->Enable(FALSE);
+	return m_position.GivesCheck(PieceTypeToPosition(piecetype,piececolor),GetBoardSquare(x,y));
 }
-
-void CNetChessView::OnUpdateViewDemo(CCmdUI* pCmdUI) 
+bool CNetChessView::CheckKingMove(int fromx, int fromy, int tox, int toy)
 {
-	// TODO: Add your command update UI handler code here
-	m_demoFlag == TRUE ? pCmdUI->SetCheck(1) : pCmdUI->SetCheck(0);
-	m_observerFlag == TRUE ? pCmdUI->Enable(FALSE) : pCmdUI->Enable(TRUE);
+	if( m_checkmove == FALSE)
+		return true;
+	//callers try the move on cb first, so test a position built from it
+	CPosition pos;
+	GetBoardPosition(pos);
+	return pos.IsInCheck(cb[tox][toy].GetPieceColor() == BLACK ? SIDE_BLACK : SIDE_WHITE) == false;
 }
-void CNetChessView::doPGNRead(CString file,char type)
+void CNetChessView::SetMoveHistory()
 {
-	m_fileReadFlag = TRUE;
-//	OnInitialUpdate();
-	unsigned char msg[2];
-	msg[0] = PGNFILE;
-	msg[1] = TRUE;
-	SendSockData(msg,2);
-	FILE *fp;
-	if(type == 'f')
+	unsigned int action = 0x0000;
+	action = m_blackKingMovedFlag == true? (action | 0x0020) : (action & 0xffff);	
+	action = m_whiteKingMovedFlag == true? (action | 0x0010) : (action & 0xffff);
+	action = m_blackRookRank1MovedFlag == true? (action | 0x0008): (action & 0xffff);
+	action = m_blackRookRank7MovedFlag == true?(action | 0x0004): (action & 0xffff);
+	action = m_whiteRookRank1MovedFlag == true?(action | 0x0002): (action & 0xffff);
+	action = m_whiteRookRank7MovedFlag == true?(action | 0x0001): (action & 0xffff);
+	action = m_checkFlag == TRUE? (action | 0x0040): (action & 0xffff);
+	action = m_castlingFlag == TRUE? (action | 0x0080): (action & 0xffff);
+	action = m_promotionFlag == TRUE? (action | 0x0100): (action & 0xffff);
+	action = m_enpassentFlag == TRUE? (action | 0x0200): (action & 0xffff);
+	action = m_ambiguousMoveFileFlag == TRUE? (action | 0x0400): (action & 0xffff);
+	action = m_ambiguousMoveRankFlag == TRUE? (action | 0x0800): (action & 0xffff);
+	m_History[m_iHistory].SetPieceMoveAction(action);
+	/*writeMessage("%d %d %d %d %d %d",m_blackKingMovedFlag,
+		m_whiteKingMovedFlag,m_blackRookRank1MovedFlag,	
+		m_blackRookRank7MovedFlag,	m_whiteRookRank1MovedFlag,
+		m_whiteRookRank7MovedFlag);*/
+}
+void CNetChessView::GetMoveHistory()
+{
+	if(m_iHistory < 0)
 	{
-		fp = fopen(file,"r");
-		if(fp == NULL)
-		{
-			CString str;
-			str.Format("Could not open the file %s",file);
-			AfxMessageBox(str);
-			return;
-		}
-
-		file = "";
-		int count = 0;
-		while(!feof(fp))
-		{
-			char c;
-			fscanf(fp,"%c",&c);
-			file += (CString)c;			
-			count++;
-			if(count > 15000)
-				break;
-		}
-		fclose(fp);
+		m_ambiguousMoveRankFlag = FALSE;
+		m_ambiguousMoveFileFlag = FALSE;
+		m_enpassentFlag = FALSE;
+		m_promotionFlag = FALSE;
+		m_castlingFlag  = FALSE ;
+		m_checkFlag     = FALSE;
+		m_blackKingMovedFlag = false;
+		m_whiteKingMovedFlag = false;
+		m_blackRookRank1MovedFlag = false;
+		m_blackRookRank7MovedFlag = false;
+		m_whiteRookRank1MovedFlag = false ;
+		m_whiteRookRank7MovedFlag = false;
+		return;
 	}
-	filterPGNFile(file);	
-	fp = fopen(".\\temp.pgn","w+");
-	fprintf(fp,file.GetBuffer(0));		
-	fclose(fp);
-	fp=fopen(".\\temp.pgn","r");	
-	char cstring1[255],cstring2[255],cstring3[255];
-	fscanf(fp,"%s",cstring1);	
-	while(strcmp(cstring1,"1.") != 0 && !feof(fp))
-	{
-		if(cstring1[0] == '[')
-		{
-			if(strcmp(&cstring1[1],"Event") == 0)
-			{
-				m_gameInfoDlg.m_edit_event = "";
-				while(!feof(fp))
-				{
-					char c;
-					fscanf(fp,"%c",&c);
-					if(c == ']')
-					{
-						break;
-					}
-					else if((c != '"') && (c != ' '))
-					{
-						m_gameInfoDlg.m_edit_event += c;
-					}
-				}				
-			}
-			else if(strcmp(&cstring1[1],"Site") == 0)
-			{
-				m_gameInfoDlg.m_edit_site = "";
-				while(!feof(fp))
-				{
-					char c;
-					fscanf(fp,"%c",&c);
-					if(c == ']')
-					{
-						break;
-					}
-					else if((c != '"') && (c != ' '))
-					{
-						m_gameInfoDlg.m_edit_site += c;
-					}
-				}				
-			}
-			else if(strcmp(&cstring1[1],"Date") == 0)
-			{
-				m_gameInfoDlg.m_edit_date = "";
-				while(!feof(fp))
-				{
-					char c;					
-					fscanf(fp,"%c",&c);
-					if(c == ']')
-					{
-						break;
-					}
-					else if((c != '"') && (c != ' '))
-					{
-						m_gameInfoDlg.m_edit_date += c;
-					}
-				}
-			}
-			else if(strcmp(&cstring1[1],"Round") == 0)
-			{
-				m_gameInfoDlg.m_edit_round = "";
-				while(!feof(fp))
-				{
-					char c;
-					fscanf(fp,"%c",&c);
-					if(c == ']')
-					{
-						break;
-					}
-					else if((c != '"') && (c != ' '))
-					{
-						m_gameInfoDlg.m_edit_round += c;
-					}
-				}
-			}
-			else if(strcmp(&cstring1[1],"White") == 0)
-			{
-				m_gameInfoDlg.m_edit_white = "";
-				while(!feof(fp))
-				{
-					char c;
-					fscanf(fp,"%c",&c);
-					if(c == ']')
-					{
-						break;
-					}
-					else if((c != '"') && (c != ' '))
-					{
-						m_gameInfoDlg.m_edit_white += c;
-					}
-				}
-			}
-			else if(strcmp(&cstring1[1],"Black") == 0)
-			{
-				m_gameInfoDlg.m_edit_black = "";
-				while(!feof(fp))
-				{
-					char c;
-					fscanf(fp,"%c",&c);
-					if(c == ']')
-					{
-						break;
-					}
-					else if((c != '"') && (c != ' '))
-					{
-						m_gameInfoDlg.m_edit_black += c;
-					}
-				}
-			}
-			else if(strcmp(&cstring1[1],"Result") == 0)
-			{
-				m_gameInfoDlg.m_edit_result = "";
-				while(!feof(fp))
-				{
-					char c;
-					fscanf(fp,"%c",&c);
-					if(c == ']')
-					{
-						break;
-					}
-					else if((c != '"') && (c != ' '))
-					{
-						m_gameInfoDlg.m_edit_result += c;
-					}
-				}
-			}
-			else if(strcmp(&cstring1[1],"FEN") == 0)
-			{
-				m_gameInfoDlg.m_edit_fenstring= "";
-				while(!feof(fp))
-				{
-					char c;
-					fscanf(fp,"%c",&c);
-					if(c == ']')
-					{
-						break;
-					}
-					else if(c != '"')
-					{
-						m_gameInfoDlg.m_edit_fenstring += c;
-					}
-				}				
-			}
-			else if(strcmp(&cstring1[1],"ECO") == 0)
-			{
-				m_gameInfoDlg.m_edit_eco= "";
-				while(!feof(fp))
-				{
-					char c;
-					fscanf(fp,"%c",&c);
-					if(c == ']')
-					{
-						break;
-					}
-					else if(c != '"')
-					{
-						m_gameInfoDlg.m_edit_eco += c;
-					}
-				}				
-			}
-			else if(strcmp(&cstring1[1],"PlyCount") == 0)
-			{
-				m_gameInfoDlg.m_edit_playcount= "";
-				while(!feof(fp))
-				{
-					char c;
-					fscanf(fp,"%c",&c);
-					if(c == ']')
-					{
-						break;
-					}
-					else if(c != '"')
-					{
-						m_gameInfoDlg.m_edit_playcount += c;
-					}
-				}				
-			}
-			else if(strcmp(&cstring1[1],"BlackElo") == 0)
-			{
-				m_gameInfoDlg.m_edit_blackelo= "";
-				while(!feof(fp))
-				{
-					char c;
-					fscanf(fp,"%c",&c);
-					if(c == ']')
-					{
-						break;
-					}
-					else if(c != '"')
-					{
-						m_gameInfoDlg.m_edit_blackelo += c;
-					}
-				}				
-			}
-			else if(strcmp(&cstring1[1],"WhiteElo") == 0)
-			{
-				m_gameInfoDlg.m_edit_whiteelo= "";
-				while(!feof(fp))
-				{
-					char c;
-					fscanf(fp,"%c",&c);
-					if(c == ']')
-					{
-						break;
-					}
-					else if(c != '"')
-					{
-						m_gameInfoDlg.m_edit_whiteelo += c;
-					}
-				}				
-			}
-			else if(strcmp(&cstring1[1],"EventDate") == 0)
-			{
-				m_gameInfoDlg.m_event_date= "";
-				while(!feof(fp))
-				{
-					char c;
-					fscanf(fp,"%c",&c);
-					if(c == ']')
-					{
-						break;
-					}
-					else if(c != '"')
-					{
-						m_gameInfoDlg.m_event_date += c;
-					}
-				}				
-			}
+	unsigned int action = m_History[m_iHistory].GetPieceMoveAction();
+	action = action & 0x0fff;
+	m_ambiguousMoveRankFlag = (0x0800 & action) ==0 ? FALSE : TRUE;
+	m_ambiguousMoveFileFlag = (0x0400 & action) == 0 ?FALSE : TRUE;
+	m_enpassentFlag = (0x0200 & action) == 0 ? FALSE: TRUE;
+	m_promotionFlag = (0x0100 & action) == 0 ? FALSE: TRUE;
+	m_castlingFlag  = (0x0080 & action) == 0 ? FALSE : TRUE;
+	m_checkFlag     = (0x0040 & action) == 0 ? FALSE : TRUE;
+	m_blackKingMovedFlag = (0x0020 & action) == 0 ? false: true;
+	m_whiteKingMovedFlag = (0x0010 & action) == 0 ? false : true;
+	m_blackRookRank1MovedFlag = (0x0008 & action) == 0 ? false : true;
+	m_blackRookRank7MovedFlag = (0x0004 & action) == 0 ? false : true;
+	m_whiteRookRank1MovedFlag = (0x0002 & action) == 0 ? false : true;
+	m_whiteRookRank7MovedFlag = (0x0001 & action) == 0 ? false : true;
+	/*writeMessage("%d %d %d %d %d %d",m_blackKingMovedFlag,
+		m_whiteKingMovedFlag,m_blackRookRank1MovedFlag,	
+		m_blackRookRank7MovedFlag,	m_whiteRookRank1MovedFlag,
+		m_whiteRookRank7MovedFlag);*/
+}
 
+void CNetChessView::writeMessage(char *str,...)
+{
+//#ifdef _DEBUG
+	if(m_optDlg.m_check_netchess_log == TRUE)
+	{
+		char arr[9999];
+		va_list va;     
+		va_start(va,str);
+		vsprintf(arr,str,va);
+		CString filename = ".\\" + m_edit_name + "_Log.txt";
+		FILE* fp=fopen(filename,"a+");
+		if(fp != NULL)
+		{
+			time_t t= time(0);
+			CTime ctime(t);			
+			
+			fprintf(fp,"%d/%d/%d %d:%d:%d: %s\n",
+				ctime.GetDay(),ctime.GetMonth(),ctime.GetYear(),
+				ctime.GetHour(),ctime.GetMinute(),ctime.GetSecond(),
+				arr);
+			fclose(fp);
 		}
-		memset(cstring1,'\0',255);
-		memset(cstring2,'\0',255);
-		memset(cstring3,'\0',255);
-		fscanf(fp,"%s",cstring1);
 	}
-	//Send Tag info
-	unsigned char data[500];
-	memset(data,'\0',500);
-	int count = 0;
-	data[count++] = GAMEINFO;
-	data[count++] = m_gameInfoDlg.m_edit_event.GetLength();
-	memcpy(&data[count],m_gameInfoDlg.m_edit_event.GetBuffer(0),m_gameInfoDlg.m_edit_event.GetLength());
-	count += m_gameInfoDlg.m_edit_event.GetLength();
-
-	data[count++] = m_gameInfoDlg.m_edit_site.GetLength();
-	memcpy(&data[count],m_gameInfoDlg.m_edit_site.GetBuffer(0),m_gameInfoDlg.m_edit_site.GetLength());
-	count += m_gameInfoDlg.m_edit_site.GetLength();
-
-	data[count++] = m_gameInfoDlg.m_edit_date.GetLength();
-	memcpy(&data[count],m_gameInfoDlg.m_edit_date.GetBuffer(0),m_gameInfoDlg.m_edit_date.GetLength());
-	count += m_gameInfoDlg.m_edit_date.GetLength();
-
-	data[count++] = m_gameInfoDlg.m_edit_round.GetLength();
-	memcpy(&data[count],m_gameInfoDlg.m_edit_round.GetBuffer(0),m_gameInfoDlg.m_edit_round.GetLength());
-	count += m_gameInfoDlg.m_edit_round.GetLength();
-
-	data[count++] = m_gameInfoDlg.m_edit_white.GetLength();
-	memcpy(&data[count],m_gameInfoDlg.m_edit_white.GetBuffer(0),m_gameInfoDlg.m_edit_white.GetLength());
-	count += m_gameInfoDlg.m_edit_white.GetLength();
-
-	data[count++] = m_gameInfoDlg.m_edit_black.GetLength();
-	memcpy(&data[count],m_gameInfoDlg.m_edit_black.GetBuffer(0),m_gameInfoDlg.m_edit_black.GetLength());
-	count += m_gameInfoDlg.m_edit_white.GetLength();
-
-	data[count++] = m_gameInfoDlg.m_edit_result.GetLength();
-	memcpy(&data[count],m_gameInfoDlg.m_edit_result.GetBuffer(0),m_gameInfoDlg.m_edit_result.GetLength());
-	count += m_gameInfoDlg.m_edit_result.GetLength();
-
-	data[count++] = m_gameInfoDlg.m_edit_fenstring.GetLength();
-	memcpy(&data[count],m_gameInfoDlg.m_edit_fenstring.GetBuffer(0),m_gameInfoDlg.m_edit_fenstring.GetLength());
-	count += m_gameInfoDlg.m_edit_fenstring.GetLength();
-
-	data[count++] = m_gameInfoDlg.m_edit_eco.GetLength();
-	memcpy(&data[count],m_gameInfoDlg.m_edit_eco.GetBuffer(0),m_gameInfoDlg.m_edit_eco.GetLength());
-	count += m_gameInfoDlg.m_edit_eco.GetLength();
-
-	data[count++] = m_gameInfoDlg.m_edit_playcount.GetLength();
-	memcpy(&data[count],m_gameInfoDlg.m_edit_playcount.GetBuffer(0),m_gameInfoDlg.m_edit_playcount.GetLength());
-	count += m_gameInfoDlg.m_edit_playcount.GetLength();
+//#endif
+}
 
-	data[count++] = m_gameInfoDlg.m_edit_blackelo.GetLength();
-	memcpy(&data[count],m_gameInfoDlg.m_edit_blackelo.GetBuffer(0),m_gameInfoDlg.m_edit_blackelo.GetLength());
-	count += m_gameInfoDlg.m_edit_blackelo.GetLength();
+void CNetChessView::OnEditCheckmove() 
+{
+	// TODO: Add your command handler code here		
+	if(m_manualEditingFlag == TRUE)
+	{
+		m_checkmove = m_checkmove == TRUE ? FALSE: TRUE;
+		unsigned char data[50];
+		data[0]=CHECKLEGALMOVE;
+		data[1] = m_checkmove;
+		strcpy((char*)&data[2],m_edit_name.GetBuffer(0));
+		SendSockData(data,m_edit_name.GetLength()+2);	
+		if(m_checkmove == TRUE)
+			AfxMessageBox("Enabled checking valid move");
+		else
+			AfxMessageBox("Disabled checking valid move");
+	}
+}
 
-	data[count++] = m_gameInfoDlg.m_edit_whiteelo.GetLength();
-	memcpy(&data[count],m_gameInfoDlg.m_edit_whiteelo.GetBuffer(0),m_gameInfoDlg.m_edit_whiteelo.GetLength());
-	count += m_gameInfoDlg.m_edit_whiteelo.GetLength();
 
-	data[count++] = m_gameInfoDlg.m_event_date.GetLength();
-	memcpy(&data[count],m_gameInfoDlg.m_event_date.GetBuffer(0),m_gameInfoDlg.m_event_date.GetLength());
-	count += m_gameInfoDlg.m_event_date.GetLength();
+void CNetChessView::OnUpdateEditCheckmove(CCmdUI* pCmdUI) 
+{
+	// TODO: Add your command update UI handler code here	
+	m_checkmove == TRUE ? pCmdUI->SetCheck(1) : pCmdUI->SetCheck(0);
+	m_manualEditingFlag == TRUE ? pCmdUI->Enable(TRUE) : pCmdUI->Enable(FALSE);
 
+}
 
-	SendSockData(data,count);
-	if(!m_gameInfoDlg.m_edit_fenstring.IsEmpty())
+void CNetChessView::OnEditManualeditEmpty() 
+{
+	// TODO: Add your command handler code here
+	OnEditCopy();
+	if(m_manualEditingFlag == TRUE)
 	{
-		doFENPositionRead(m_gameInfoDlg.m_edit_fenstring,'F');
-		unsigned char data[1024];
-		memset(data,'\0',1024);
-		data[0] = POSITION_DATA;
-		int count = 1;
-		for(int i=0;i<m_gameInfoDlg.m_edit_fenstring.GetLength();i++)
-		{
-			data[count++] = m_gameInfoDlg.m_edit_fenstring[i];
+		for ( int i = 0; i < 8; i++)
+		{	
+			for( int j = 0; j < 8; j++)
+			{
+				cb[i][j].SetPieceData(-1,NONE,BLANK,PIECE_NOT_MOVING);				 
+			}	
 		}
-		SendSockData(data,count);
+		m_iHistory = -1;
+		SetPositionFromBoard();
+		DrawBoard();
+		unsigned char data[1];
+		data[0] = MANUALEDITING_EMPTY;
+		SendSockData(data,1);
 	}
-
-	if(feof(fp))
+	else
 	{
-		fclose(fp);
-	//	if(type != 'f')
-		DeleteFile(".\\temp.pgn");
-		return;
+		AfxMessageBox("Editing disabled");
 	}
-	fscanf(fp,"%s%s",cstring2,cstring3);
-	if(strcmp(cstring1,"1.") == 0)
-	{
-		do
-		{
+}
 
-			/*(strcmp(cstring1,"1.")== 0)
-			{
-				writeMessage("*************************");
-				writeMessage("%s",GetHistoryString());
-				writeMessage("*************************");
-				Initialize();
-				OnInitialUpdate();
-				unsigned char msg[1];
-				msg[0] = PGNFILE;
-				SendSockData(msg,1);				
-			}*/
-			int ret = PGNMove(cstring2,WHITE);
-			if(ret == 1)
-			{
-				break;			
-			}
-			if( strcmp(cstring3,"1-0") == 0 ||
-				strcmp(cstring3,"0-1") == 0 ||
-				strcmp(cstring3,"1/2-1/2") == 0 ||
-				strcmp(cstring3,"*") == 0)
-			{
-				break;
-			}
-			Sleep(m_optDlg.m_edit_replay_interval*1000);
-			ret = PGNMove(cstring3,BLACK);			
-			if(ret == 1)
-			{
-				break;
-			}			
-			memset(cstring1,'\0',255);
-			memset(cstring2,'\0',255);
-			memset(cstring3,'\0',255);			
-			fscanf(fp,"%s%s%s",cstring1,cstring2,cstring3);
-			if(cstring1[0] == '[' || cstring2[0] == '[' || cstring3[0] == '[' ||
-				cstring1[0] == '*' || cstring2[0] == '*' ||
-				strcmp(cstring1,"1-0") == 0 ||
-				strcmp(cstring1,"0-1") == 0 ||
-				strcmp(cstring1,"1/2-1/2") == 0 ||
-				strcmp(cstring2,"1-0") == 0 ||
-				strcmp(cstring2,"0-1") == 0 ||
-				strcmp(cstring2,"1/2-1/2") == 0)				
-				break;
-			Sleep(m_optDlg.m_edit_replay_interval*1000);
+void CNetChessView::OnEditManualeditEnd() 
+{
+	// TODO: Add your command handler code here	
+}
 
-		}while(!feof(fp));
-		//Check for last move
-		int ret = PGNMove(cstring2,WHITE);
-		 ret = PGNMove(cstring3,BLACK);
+void CNetChessView::OnEditManualeditPlayerturn() 
+{
+	// TODO: Add your command handler code here
+	if(m_manualEditingFlag == false)
+	{
+		AfxMessageBox("Editing disabled");
+		return;
 	}
-	fclose(fp);
-	//if(type != 'f')
-	DeleteFile(".\\temp.pgn");
-	m_fileReadFlag = FALSE;
-	DrawBoard();
 	
-}
-void CNetChessView::filterPGNFile(CString& filedata)
-{
-	CString tempstr; 
-	for(int i=0; i<filedata.GetLength();i++)
+	int ret = AfxMessageBox("Choose Player turn,White turn - Yes,Black turn - No",MB_YESNOCANCEL);
+	if(ret == IDYES)
 	{
-		if(filedata[i] == ';' || filedata[i] == '%')
-		{
-			i++;
-			for(;i<filedata.GetLength() && filedata[i] != '\n';i++);
-		}
-		else if(filedata[i] == '{')
-		{
-			//get comment number
-			//comment number
-		/*	int lastindex;
-			for(int k=tempstr.GetLength()-1; tempstr[k] != '.' &&k>=0;k--);
-			lastindex = k;
-			for(;tempstr[k] != ' ' && k>=0;k--);*/
-			CString comment;
-			i++;
-			int count = 1;
-			for(;i <filedata.GetLength();i++)
-			{
-				if(filedata[i] == '}')
-				{
-					count--;
-					if(count == 0)
-						break;
-				}
-				else if(filedata[i] == '{')
-				{
-					count++;
-				}
-				comment+= filedata[i];
-			}
-			//i++;
-			//for(;i<filedata.GetLength() && filedata[i] != '}' ;i++);
-		}
-		else if(filedata[i] == '<')
+		if(m_pClientSocket == NULL)
 		{
-			i++;
-			for(;i<filedata.GetLength() && filedata[i] != '>';i++);
+			m_player_turn = true;
+			m_pieceSide = WHITE;
 		}
-		else if(filedata[i] == '(')
+		else
 		{
-			CString comment;
-			i++;
-			int count = 1;
-			for(;i <filedata.GetLength();i++)
-			{
-				if(filedata[i] == ')')
-				{
-					count--;
-					if(count == 0)
-					break;
-				}
-				else if(filedata[i] == '(')
-				{
-					count++;
-				}
-				comment += filedata[i];
-			}
-		}
-		else if(filedata[i] == '!' || filedata[i] == '?')
-		{   
-		//nothing
+			unsigned char data[2];
+			data[0]=MANUALEDITING_PLAYER_TURN;
+			data[1] = false;
+			m_player_turn = true;			
+			SendSockData(data,2);		
 		}
-		else if(filedata[i] == '$')
+	}
+	else if(ret == IDCANCEL)
+	{
+		return;
+	}
+	else
+	{
+		if(m_pClientSocket == NULL)
 		{
-			i++;
-			for(;filedata[i] != ' ' && filedata[i] != '\n';i++);
+			m_player_turn = true;
+			m_pieceSide = BLACK;
 		}
-		else if(filedata[i] == '[')
+		else
 		{
-			for(;i<filedata.GetLength() && filedata[i] != ']' ;i++)
-			tempstr += filedata[i];
-			if(i+1 < filedata.GetLength())
-				tempstr += filedata[i++];
-			tempstr += "\n";
+			unsigned char data[2];
+			data[0]=MANUALEDITING_PLAYER_TURN;
+			data[1] = true;
+			m_player_turn = false;			
+			SendSockData(data,2);		
 		}
-		else if(filedata[i] == '.' && (i+1 < filedata.GetLength() ? filedata[i+1] == '.' : 0) && (i+2 < filedata.GetLength() ? filedata[i+2] == '.' : 0))
-		{
-			int count = 0;
-			i--;
-			for(;i> -1 && filedata[i] != ' ' && filedata[i] != '\n';i--)
-			{
-				count++;    
-				tempstr = tempstr.Left(tempstr.GetLength()-1);
+	}
+}
 
-			}
-			i = i + count + 3;
+void CNetChessView::OnEditManualeditStart() 
+{
+	// TODO: Add your command handler code here
+	if(m_demoFlag == TRUE && m_pauseFlag == FALSE)
+	{
+		AfxMessageBox("Replay is in progress! Puase the demo to activate this feature");
+		return;
+	}
+	if(m_manualEditingFlag == false)
+	{
+		if(AfxMessageBox("Requesting for Manual editing. Proceed?",MB_YESNO) == IDNO)
+		{
+			return;
 		}
-		else if(filedata[i] == '.' && (i+1 < filedata.GetLength() ? filedata[i+1] != ' ' : 0))
+	}
+	else
+	{
+		AfxMessageBox("Manual editing disabled");
+	}
+	if(m_pClientSocket == NULL)
+	{
+		m_manualEditingFlag = m_manualEditingFlag == TRUE ? FALSE: TRUE;
+	}
+	else
+	{
+		
+		if(m_manualEditingFlag == FALSE)
 		{
-			tempstr += filedata[i];
-			tempstr += ' ';
+			unsigned char data[50];
+			data[0]=MANUALEDITING_START;
+			strcpy((char*)&data[1],m_edit_name.GetBuffer(0));
+			SendSockData(data,m_edit_name.GetLength()+2);		
 		}
 		else
 		{
-			tempstr += filedata[i];
+			unsigned char data[2];;
+			m_manualEditingFlag = FALSE;
+			data[0]=MANUALEDITING_END;
+			SendSockData(data,m_edit_name.GetLength()+2);		
 		}
+		//data[1] = m_checkmove;		
 	}
-	filedata = tempstr;
 }
-int CNetChessView::PGNMove(char cstring[255], int pieceside)
+
+void CNetChessView::OnUpdateEditManualeditStart(CCmdUI* pCmdUI) 
 {
-	m_checkFlag = m_castlingFlag = m_enpassentFlag = m_promotionFlag =
-	m_ambiguousMoveRankFlag = m_ambiguousMoveFileFlag = FALSE;
+	// TODO: Add your command update UI handler code here
+		m_manualEditingFlag == TRUE ? pCmdUI->SetCheck(1) : pCmdUI->SetCheck(0);
+		m_observerFlag == TRUE ? pCmdUI->Enable(FALSE) : pCmdUI->Enable(TRUE);
+}
 
-	int len = strlen(cstring);
-	if(m_white_on_top == true)//white is on top
-	{
-		switch(len)
-		{
-			case 2://pawn move
-				{
-					int to_i,to_j;
-					to_j = 7-(int)(cstring[0] - 'a');
-					to_i = 7-((int)('9' - cstring[1])-1);
-					if(pieceside == WHITE)
-					{
-						if(cb[to_i-1][to_j].GetPieceId() != -1)
-						{
-							m_point.x = to_i-1;
-							m_point.y = to_j;
-							m_mouseMoveFlag = true;
-							CRect rect=cb[to_i][to_j].GetRect();
-							CPoint pt(rect.left+10,rect.top+10);
-							OnLButtonUpAction(0,pt);
-						}
-						else if(cb[to_i-2][to_j].GetPieceId() != -1)
-						{
-							m_point.x = to_i-2;
-							m_point.y = to_j;
-							m_mouseMoveFlag = true;
-							CRect rect=cb[to_i][to_j].GetRect();
-							CPoint pt(rect.left+10,rect.top+10);
-							OnLButtonUpAction(0,pt);
-						}
-					}
-					else
-					{
-						if(cb[to_i+1][to_j].GetPieceId() != -1)
-						{
-							m_point.x = to_i+1;
-							m_point.y = to_j;
-							m_mouseMoveFlag = true;
-							CRect rect=cb[to_i][to_j].GetRect();
-							CPoint pt(rect.left+10,rect.top+10);
-							OnLButtonUpAction(0,pt);
-						}
-						else if(cb[to_i+2][to_j].GetPieceId() != -1)
-						{
-							m_point.x = to_i+2;
-							m_point.y = to_j;
-							m_mouseMoveFlag = true;
-							CRect rect=cb[to_i][to_j].GetRect();
-							CPoint pt(rect.left+10,rect.top+10);
-							OnLButtonUpAction(0,pt);
-						}
-					}
-				}	
-				break;
-			case 3://piece move
-				{
-					if(strcmp(cstring,"O-O")==0)
-					{
-						if(pieceside == WHITE)
-						{
-							m_point.x = 0;
-							m_point.y = 3;
-							int to_i = 0;
-							int to_j = 1;
-							m_mouseMoveFlag = true;
-							CRect rect=cb[to_i][to_j].GetRect();
-							CPoint pt(rect.left+10,rect.top+10);
-							OnLButtonUpAction(0,pt);
-						}
-						else
-						{
-							m_point.x = 7;
-							m_point.y = 3;
-							int to_i = 7;
-							int to_j = 1;
-							m_mouseMoveFlag = true;
-							CRect rect=cb[to_i][to_j].GetRect();
-							CPoint pt(rect.left+10,rect.top+10);
-							OnLButtonUpAction(0,pt);
-						}
-					}
-					else if((cstring[2] == '+') || (cstring[2] == '#'))
-					{
-						cstring[2] = '\0';
-						PGNMove(cstring, pieceside);
-					}
-					 else if((cstring[2] > 'A') && cstring[2] <='Z')
-					 {
-						  //junk move nove valid
-						  m_pickPieceDlg->m_pickpiecetype  = 1;
-						  char str[255];
-						  str[0]=cstring[2];    
-						  m_pickPieceDlg->m_piecked_piece=GetPieceType(str,pieceside,(int&)m_pickPieceDlg->m_piece_type);
-						  m_pickPieceDlg->m_piece_color=(COLOR_TYPE)pieceside;
-						  cstring[2] = '\0';
-						  PGNMove(cstring, pieceside);     
-					 }
-					else
-					{
-						int from_i,from_j,to_i,to_j;				
-						to_j = 7-(int)(cstring[1] - 'a');
-						to_i = 7-((int)('9' - cstring[2])-1);
-						if(GetPieceIndex(cstring,pieceside,to_i,to_j,from_i,from_j) == true)
-						{
-							m_point.x = from_i;
-							m_point.y = from_j;
-							m_mouseMoveFlag = true;
-							CRect rect=cb[to_i][to_j].GetRect();
-							CPoint pt(rect.left+10,rect.top+10);
-							OnLButtonUpAction(0,pt);
-						}
-					}
 
-				}			
-				break;
-			case 4://move with capture		
-			case 5:		
-				if((cstring[3] == '+') || (cstring[3] == '#'))
-				{
-					cstring[3] = '\0';
-					PGNMove(cstring, pieceside);					
-				}
-				else if((cstring[4] == '+') || (cstring[4] == '#'))
-				{
-					cstring[4] = '\0';
-					PGNMove(cstring, pieceside);
-				}
-				else if(cstring[2] == '=')
-				{
-					m_pickPieceDlg->m_pickpiecetype  = 1;
-					char str[255];
-					str[0]=cstring[3];				
-					m_pickPieceDlg->m_piecked_piece=GetPieceType(str,pieceside,(int&)m_pickPieceDlg->m_piece_type);
-					m_pickPieceDlg->m_piece_color=(COLOR_TYPE)pieceside;
-					cstring[2] = '\0';
-					PGNMove(cstring, pieceside);					
-				}
-				else if(strcmp(cstring,"O-O-O") == 0)
-				{
-					if(pieceside == WHITE)
-					{
-						m_point.x = 0;
-						m_point.y = 3;
-						int to_i = 0;
-						int to_j = 5;
-						m_mouseMoveFlag = true;
-						CRect rect=cb[to_i][to_j].GetRect();
-						CPoint pt(rect.left+10,rect.top+10);
-						OnLButtonUpAction(0,pt);
-					}
-					else
-					{
-						m_point.x = 7;
-						m_point.y = 3;
-						int to_i = 7;
-						int to_j = 5;
-						m_mouseMoveFlag = true;
-						CRect rect=cb[to_i][to_j].GetRect();
-						CPoint pt(rect.left+10,rect.top+10);
-						OnLButtonUpAction(0,pt);
-					}
-				}
-				else if(cstring[2] =='x')
-				{
-					int from_i,from_j,to_i,to_j;				
-					to_j= 7-(int)(cstring[3] - 'a');
-					to_i= 7-((int)('9' - cstring[4])-1);
-					if(GetPieceIndex(cstring,pieceside,to_i,to_j,from_i,from_j) == true)
-					{
-						m_point.x = from_i;
-						m_point.y = from_j;
-						m_mouseMoveFlag = true;
-						CRect rect=cb[to_i][to_j].GetRect();
-						CPoint pt(rect.left+10,rect.top+10);
-						OnLButtonUpAction(0,pt);
-					}
-				}
-				else if(cstring[3] =='x')
-				{
-					int to_i,to_j;				
-					to_j= 7-(int)(cstring[4] - 'a');
-					to_i= 7-((int)('9' - cstring[5])-1);
-					m_point.x = (int)(cstring[1] - 'a');
-					m_point.y = (int)('9' - cstring[2])-1;
-					m_mouseMoveFlag = true;
-					CRect rect=cb[to_i][to_j].GetRect();
-					CPoint pt(rect.left+10,rect.top+10);
-					OnLButtonUpAction(0,pt);				
-				}
-				else if(cstring[5] == 'q' || cstring[5] == 'Q')
-				{				
-					m_pickPieceDlg->m_pickpiecetype  = 1;
-					char str[255];
-					str[0]=cstring[4];				
-					m_pickPieceDlg->m_piecked_piece=GetPieceType(str,pieceside,(int&)m_pickPieceDlg->m_piece_type);
-					m_pickPieceDlg->m_piece_color=(COLOR_TYPE)pieceside;
-					cstring[5] = '\0';
-					PGNMove(cstring, pieceside);
-				}
-				else if(cstring[0] >='a' && cstring[0]<='h' &&
-						cstring[2] >='a' && cstring[2]<='h' &&
-						cstring[1] >='1' && cstring[1]<='8' &&
-						cstring[3] >='1' && cstring[2]<='8')
-				{
-					int to_i,to_j;				
-					to_j= 7-(int)(cstring[2] - 'a');
-					to_i= 7-((int)('9' - cstring[3])-1);
-					m_point.y= 7-(int)(cstring[0] - 'a');
-					m_point.x= 7-((int)('9' - cstring[1])-1);
-					m_mouseMoveFlag = true;
-					CRect rect=cb[to_i][to_j].GetRect();
-					CPoint pt(rect.left+10,rect.top+10);
-					OnLButtonUpAction(0,pt);
-					/*if(GetPieceIndex(cstring,pieceside,to_i,to_j,from_i,from_j) == true)
-					{
-						m_point.x = from_i;
-						m_point.y = from_j;
-						m_mouseMoveFlag = true;
-						CRect rect=cb[to_i][to_j].GetRect();
-						CPoint pt(rect.left+10,rect.top+10);
-						OnLButtonUpAction(0,pt);
-					}*/
-				}
-				else
-				{
-					int from_i,from_j,to_i,to_j;				
-					to_j= 7-(int)(cstring[2] - 'a');
-					to_i= 7-((int)('9' - cstring[3])-1);
-					if(GetPieceIndex(cstring,pieceside,to_i,to_j,from_i,from_j) == true)
-					{
-						m_point.x = from_i;
-						m_point.y = from_j;
-						m_mouseMoveFlag = true;
-						CRect rect=cb[to_i][to_j].GetRect();
-						CPoint pt(rect.left+10,rect.top+10);
-						OnLButtonUpAction(0,pt);
-					}
-				}
-			break;
-			case 6:
-				if((cstring[5] == '+') || (cstring[5] == '#'))
-				{
-					cstring[5] = '\0';
-					PGNMove(cstring, pieceside);
-				}
-				else if(cstring[4] == '=')
-				{
-					m_pickPieceDlg->m_pickpiecetype  = 1;
-					char str[255];
-					str[0]=cstring[5];				
-					m_pickPieceDlg->m_piecked_piece=GetPieceType(str,pieceside,(int&)m_pickPieceDlg->m_piece_type);
-					m_pickPieceDlg->m_piece_color=(COLOR_TYPE)pieceside;
-					cstring[4] = '\0';
-					PGNMove(cstring, pieceside);
-				}
-				break;
-			case 7:
-				if((cstring[6] == '+') || (cstring[6] == '#'))
-				{
-					cstring[6] = '\0';
-					PGNMove(cstring, pieceside);
-				}			
-				break;
-			default:
-				//cstring[7] = '\0';
-				//PGNMove(cstring, pieceside);
-				break;
-		}
-	}
-	else
+void CNetChessView::OnUpdateEditManualeditEmpty(CCmdUI* pCmdUI) 
+{
+	// TODO: Add your command update UI handler code here
+	m_manualEditingFlag == TRUE ? pCmdUI->Enable(TRUE) : pCmdUI->Enable(FALSE);
+}
+
+void CNetChessView::OnUpdateEditManualeditPlayerturn(CCmdUI* pCmdUI) 
+{
+	// TODO: Add your command update UI handler code here
+	m_manualEditingFlag == TRUE ? pCmdUI->Enable(TRUE) : pCmdUI->Enable(FALSE);
+}
+
+void CNetChessView::OnUpdateEditMovefirst(CCmdUI* pCmdUI) 
+{
+	// TODO: Add your command update UI handler code here
+	m_manualEditingFlag == TRUE ? pCmdUI->Enable(TRUE) : pCmdUI->Enable(FALSE);
+}
+
+void CNetChessView::OnUpdateEditMovelast(CCmdUI* pCmdUI) 
+{
+	// TODO: Add your command update UI handler code here
+	m_manualEditingFlag == TRUE ? pCmdUI->Enable(TRUE) : pCmdUI->Enable(FALSE);
+}
+
+void CNetChessView::OnUpdateEditRedo(CCmdUI* pCmdUI) 
+{
+	// TODO: Add your command update UI handler code here
+	m_manualEditingFlag == TRUE ? pCmdUI->Enable(TRUE) : pCmdUI->Enable(FALSE);
+}
+
+void CNetChessView::OnUpdateEditUndo(CCmdUI* pCmdUI) 
+{
+	// TODO: Add your command update UI handler code here
+	m_manualEditingFlag == TRUE ? pCmdUI->Enable(TRUE) : pCmdUI->Enable(FALSE);
+}
+
+void CNetChessView::OnUpdateViewDemo(CCmdUI* pCmdUI) 
+{
+	// TODO: Add your command update UI handler code here
+	m_demoFlag == TRUE ? pCmdUI->SetCheck(1) : pCmdUI->SetCheck(0);
+	m_observerFlag == TRUE ? pCmdUI->Enable(FALSE) : pCmdUI->Enable(TRUE);
+}
+//text of game index of the open PGN, FEN or EPD file
+CString CNetChessView::GetPGNGame(int index)
+{
+	unsigned int length;
+	const char *text = m_PGNIndex.GetGame(index,length);
+	if(text == NULL)
+		return CString("");
+	CString game(text,length);
+	if(m_PGNIndex.GetFormat() == GAMEINDEX_LINES)
+		game += "\r\n";
+	return game;
+}
+//stores the value of a PGN tag in the game info dialog
+void CNetChessView::SetPGNTag(CString name,CString value)
+{
+	if(name == "Event")
+		m_gameInfoDlg.m_edit_event = value;
+	else if(name == "Site")
+		m_gameInfoDlg.m_edit_site = value;
+	else if(name == "Date")
+		m_gameInfoDlg.m_edit_date = value;
+	else if(name == "Round")
+		m_gameInfoDlg.m_edit_round = value;
+	else if(name == "White")
+		m_gameInfoDlg.m_edit_white = value;
+	else if(name == "Black")
+		m_gameInfoDlg.m_edit_black = value;
+	else if(name == "Result")
+		m_gameInfoDlg.m_edit_result = value;
+	else if(name == "FEN")
+		m_gameInfoDlg.m_edit_fenstring = value;
+	else if(name == "ECO")
+		m_gameInfoDlg.m_edit_eco = value;
+	else if(name == "PlyCount")
+		m_gameInfoDlg.m_edit_playcount = value;
+	else if(name == "BlackElo")
+		m_gameInfoDlg.m_edit_blackelo = value;
+	else if(name == "WhiteElo")
+		m_gameInfoDlg.m_edit_whiteelo = value;
+	else if(name == "EventDate")
+		m_gameInfoDlg.m_event_date = value;
+}
+
+//NAG number of a "14" ($14) or "!?" token, 0 when it is neither
+static int GetNAGNumber(const char *text, int length)
+{
+	static const char *const glyphs[] = {"!","?","!!","??","!?","?!"};
+	for(int i = 0; i < 6; i++)
+	{
+		if((int)strlen(glyphs[i]) == length && strncmp(text,glyphs[i],length) == 0)
+			return i + 1;
+	}
+	int nag = 0;
+	for(int i = 0; i < length && i < 4 && text[i] >= '0' && text[i] <= '9'; i++)
+		nag = nag * 10 + text[i] - '0';
+	return nag <= 255 ? nag : 0;
+}
+
+void CNetChessView::doPGNRead(CString file,char type)
+{
+	m_fileReadFlag = TRUE;
+//	OnInitialUpdate();
+	unsigned char msg[2];
+	msg[0] = PGNFILE;
+	msg[1] = TRUE;
+	SendSockData(msg,2);
+	//type 'f' is a file name, otherwise file holds the PGN text
+	CPGNReader reader;
+	if(type == 'f')
 	{
-		switch(len)
+		if(reader.Open(file) == false)
 		{
-			case 2://pawn move
-				{
-					int to_i,to_j;
-					to_j = (int)(cstring[0] - 'a');
-					to_i = (int)('9' - cstring[1])-1;
-					if(pieceside == WHITE)
-					{
-						if(cb[to_i+1][to_j].GetPieceId() != -1)
-						{
-							m_point.x = to_i+1;
-							m_point.y = to_j;
-							m_mouseMoveFlag = true;
-							CRect rect=cb[to_i][to_j].GetRect();
-							CPoint pt(rect.left+10,rect.top+10);
-							OnLButtonUpAction(0,pt);
-						}
-						else if(cb[to_i+2][to_j].GetPieceId() != -1)
-						{
-							m_point.x = to_i+2;
-							m_point.y = to_j;
-							m_mouseMoveFlag = true;
-							CRect rect=cb[to_i][to_j].GetRect();
-							CPoint pt(rect.left+10,rect.top+10);
-							OnLButtonUpAction(0,pt);
-						}
-					}
-					else
-					{
-						if(cb[to_i-1][to_j].GetPieceId() != -1)
-						{
-							m_point.x = to_i-1;
-							m_point.y = to_j;
-							m_mouseMoveFlag = true;
-							CRect rect=cb[to_i][to_j].GetRect();
-							CPoint pt(rect.left+10,rect.top+10);
-							OnLButtonUpAction(0,pt);
-						}
-						else if(cb[to_i-2][to_j].GetPieceId() != -1)
-						{
-							m_point.x = to_i-2;
-							m_point.y = to_j;
-							m_mouseMoveFlag = true;
-							CRect rect=cb[to_i][to_j].GetRect();
-							CPoint pt(rect.left+10,rect.top+10);
-							OnLButtonUpAction(0,pt);
-						}
-					}
-				}	
-				break;
-			case 3://piece move
-				{
-					if(strcmp(cstring,"O-O")==0)
-					{
-						if(pieceside == WHITE)
-						{
-							m_point.x = 7;
-							m_point.y = 4;
-							int to_i = 7;
-							int to_j = 6;
-							m_mouseMoveFlag = true;
-							CRect rect=cb[to_i][to_j].GetRect();
-							CPoint pt(rect.left+10,rect.top+10);
-							OnLButtonUpAction(0,pt);
-						}
-						else
-						{
-							m_point.x = 0;
-							m_point.y = 4;
-							int to_i = 0;
-							int to_j = 6;
-							m_mouseMoveFlag = true;
-							CRect rect=cb[to_i][to_j].GetRect();
-							CPoint pt(rect.left+10,rect.top+10);
-							OnLButtonUpAction(0,pt);
-						}
-					}
-					else if((cstring[2] == '+') || (cstring[2] == '#'))
-					{
-						cstring[2] = '\0';
-						PGNMove(cstring, pieceside);
-					}
-					 else if((cstring[2] > 'A') && cstring[2] <='Z')
-					 {
-						  //junk move nove valid
-						  m_pickPieceDlg->m_pickpiecetype  = 1;
-						  char str[255];
-						  str[0]=cstring[2];    
-						  m_pickPieceDlg->m_piecked_piece=GetPieceType(str,pieceside,(int&)m_pickPieceDlg->m_piece_type);
-						  m_pickPieceDlg->m_piece_color=(COLOR_TYPE)pieceside;
-						  cstring[2] = '\0';
-						  PGNMove(cstring, pieceside);     
-					 }
-					else 
-					{
-						int from_i,from_j,to_i,to_j;				
-						to_j = (int)(cstring[1] - 'a');
-						to_i = (int)('9' - cstring[2])-1;
-						if(GetPieceIndex(cstring,pieceside,to_i,to_j,from_i,from_j) == true)
-						{
-							m_point.x = from_i;
-							m_point.y = from_j;
-							m_mouseMoveFlag = true;
-							CRect rect=cb[to_i][to_j].GetRect();
-							CPoint pt(rect.left+10,rect.top+10);
-							OnLButtonUpAction(0,pt);
-						}
-					}
-
-				}			
-				break;
-			case 4://move with capture		
-			case 5:		
-				if((cstring[3] == '+') || (cstring[3] == '#'))
-				{
-					cstring[3] = '\0';
-					PGNMove(cstring, pieceside);				
-				}
-				else if((cstring[4] == '+') || (cstring[4] == '#'))
-				{
-					cstring[4] = '\0';
-					PGNMove(cstring, pieceside);
-				}
-				else if(cstring[2] == '=')
-				{
-					m_pickPieceDlg->m_pickpiecetype  = 1;
-					char str[255];
-					str[0]=cstring[3];				
-					m_pickPieceDlg->m_piecked_piece=GetPieceType(str,pieceside,(int&)m_pickPieceDlg->m_piece_type);
-					m_pickPieceDlg->m_piece_color=(COLOR_TYPE)pieceside;
-					cstring[2] = '\0';
-					PGNMove(cstring, pieceside);					
-				}
-				else if(strcmp(cstring,"O-O-O") == 0)
-				{
-					if(pieceside == WHITE)
-					{
-						m_point.x = 7;
-						m_point.y = 4;
-						int to_i = 7;
-						int to_j = 2;
-						m_mouseMoveFlag = true;
-						CRect rect=cb[to_i][to_j].GetRect();
-						CPoint pt(rect.left+10,rect.top+10);
-						OnLButtonUpAction(0,pt);
-					}
-					else
-					{
-						m_point.x = 0;
-						m_point.y = 4;
-						int to_i = 0;
-						int to_j = 2;
-						m_mouseMoveFlag = true;
-						CRect rect=cb[to_i][to_j].GetRect();
-						CPoint pt(rect.left+10,rect.top+10);
-						OnLButtonUpAction(0,pt);
-					}
-				}
-				else if(cstring[2] =='x')
-				{
-					int from_i,from_j,to_i,to_j;				
-					to_j= (int)(cstring[3] - 'a');
-					to_i= (int)('9' - cstring[4])-1;
-					if(GetPieceIndex(cstring,pieceside,to_i,to_j,from_i,from_j) == true)
-					{
-						m_point.x = from_i;
-						m_point.y = from_j;
-						m_mouseMoveFlag = true;
-						CRect rect=cb[to_i][to_j].GetRect();
-						CPoint pt(rect.left+10,rect.top+10);
-						OnLButtonUpAction(0,pt);
-					}
-				}
-				else if(cstring[3] =='x')
-				{
-					int to_i,to_j;				
-					to_j= (int)(cstring[4] - 'a');
-					to_i= (int)('9' - cstring[5])-1;
-					m_point.x = (int)(cstring[1] - 'a');
-					m_point.y = (int)('9' - cstring[2])-1;
-					m_mouseMoveFlag = true;
-					CRect rect=cb[to_i][to_j].GetRect();
-					CPoint pt(rect.left+10,rect.top+10);
-					OnLButtonUpAction(0,pt);				
-				}
-				else if(cstring[5] == 'q' || cstring[5] == 'Q')
-				{				
-					m_pickPieceDlg->m_pickpiecetype  = 1;
-					char str[255];
-					str[0]=cstring[4];				
-					m_pickPieceDlg->m_piecked_piece=GetPieceType(str,pieceside,(int&)m_pickPieceDlg->m_piece_type);
-					m_pickPieceDlg->m_piece_color=(COLOR_TYPE)pieceside;
-					cstring[5] = '\0';
-					PGNMove(cstring, pieceside);
-				}
-				else if(cstring[0] >='a' && cstring[0]<='h' &&
-						cstring[2] >='a' && cstring[2]<='h' &&
-						cstring[1] >='1' && cstring[1]<='8' &&
-						cstring[3] >='1' && cstring[2]<='8')
-				{
-					int to_i,to_j;				
-					to_j= (int)(cstring[2] - 'a');
-					to_i= (int)('9' - cstring[3])-1;
-					m_point.y= (int)(cstring[0] - 'a');
-					m_point.x= (int)('9' - cstring[1])-1;
-					m_mouseMoveFlag = true;
-					CRect rect=cb[to_i][to_j].GetRect();
-					CPoint pt(rect.left+10,rect.top+10);
-					OnLButtonUpAction(0,pt);
-					/*if(GetPieceIndex(cstring,pieceside,to_i,to_j,from_i,from_j) == true)
-					{
-						m_point.x = from_i;
-						m_point.y = from_j;
-						m_mouseMoveFlag = true;
-						CRect rect=cb[to_i][to_j].GetRect();
-						CPoint pt(rect.left+10,rect.top+10);
-						OnLButtonUpAction(0,pt);
-					}*/
-				}
-				else
-				{
-					int from_i,from_j,to_i,to_j;				
-					to_j= (int)(cstring[2] - 'a');
-					to_i= (int)('9' - cstring[3])-1;				
-					
-					if(GetPieceIndex(cstring,pieceside,to_i,to_j,from_i,from_j) == true)
-					{
-						m_point.x = from_i;
-						m_point.y = from_j;
-						m_mouseMoveFlag = true;
-						CRect rect=cb[to_i][to_j].GetRect();
-						CPoint pt(rect.left+10,rect.top+10);
-						OnLButtonUpAction(0,pt);
-					}
-				}
-			break;
-			case 6:
-				if((cstring[5] == '+') || (cstring[5] == '#'))
-				{
-					cstring[5] = '\0';
-					PGNMove(cstring, pieceside);
-				}
-				else if(cstring[4] == '=')
-				{
-					m_pickPieceDlg->m_pickpiecetype  = 1;
-					char str[255];
-					str[0]=cstring[5];				
-					m_pickPieceDlg->m_piecked_piece=GetPieceType(str,pieceside,(int&)m_pickPieceDlg->m_piece_type);
-					m_pickPieceDlg->m_piece_color=(COLOR_TYPE)pieceside;
-					cstring[4] = '\0';
-					PGNMove(cstring, pieceside);
-				}
-				break;
-			case 7:
-				if((cstring[6] == '+') || (cstring[6] == '#'))
-				{
-					cstring[6] = '\0';
-					PGNMove(cstring, pieceside);
-				}			
-				break;
-			default:
-				//cstring[7] = '\0';
-				//PGNMove(cstring, pieceside);
-				break;
+			CString str;
+			str.Format("Could not open the file %s",file);
+			AfxMessageBox(str);
+			m_fileReadFlag = FALSE;
+			return;
 		}
 	}
-	return 0;
-}
-bool CNetChessView::GetPieceIndex(char cstring[255],int pieceside,int to_i,int to_j,int &from_i,int &from_j) 
-{
-
-	int piece_id;
-	COLOR_TYPE  piece_color;
-	PIECE_TYPE  piece_type;
-	STATE piece_state;	
-	PIECE_SIDE piece_side;
-	COLOR_TYPE  from_color_type;
-	PIECE_TYPE  from_piece_type;
-	int from_pieceid;
-	int to_pieceid;
-	COLOR_TYPE  to_colortype;
-	PIECE_TYPE  to_piecetype;
-	STATE to_piecestate = PIECE_NOT_MOVING;
-	int from_row_id, to_row_id;
-	int from_col_id, to_col_id;
-	int flipflag = FALSE;
-	if(m_white_on_top == true)
+	else
 	{
-		m_white_on_top = false;
-		to_i = 7 - to_i;
-		to_j = 7 - to_j;
-		FlipBoard();
-		flipflag = TRUE;						
+		reader.Attach(file,file.GetLength());
 	}
-	if(m_white_on_top == false)
+	if(reader.NextGame() == false)
 	{
-		if(strlen(cstring)>3)
-		{	
-			if(cstring[0] >='a' && cstring[0] <='z' && cstring[1] == 'x')
-			{
-				for(int i=0;i<8;i++)
-				{
-					int j=(int)(cstring[0]-'a');
-					m_point.x = i;
-					m_point.y = j;
-					int piecetype;
-					bool tempblackKingMoveFlag = m_blackKingMovedFlag;
-					bool tempwhiteKingMoveFlag = m_whiteKingMovedFlag;
-					if(cb[i][j].GetPieceId() == GetPieceType(cstring,pieceside,piecetype) && (CheckValidMove(to_i,to_j) == true))
-					{
-						from_i = i;
-						from_j = j;
-						cb[to_i][to_j].GetPieceData(piece_id,piece_color,piece_type,piece_state);
-						cb[to_i][to_j].SetPieceData(cb[from_i][from_j].GetPieceId(),cb[from_i][from_j].GetPieceColor(),cb[from_i][from_j].GetPieceType(),cb[from_i][from_j].GetPieceState());
-						cb[from_i][from_j].SetPieceData(-1,NONE,BLANK,PIECE_NOT_MOVING);
-						if(m_enpassentFlag == TRUE)
-						{							
-							m_History[m_iHistory].GetHistory(
-										piece_side,
-										from_piece_type, from_color_type,from_pieceid,
-										from_row_id,from_col_id, to_piecetype,
-										to_colortype,to_pieceid,to_row_id,
-										to_col_id);
-							cb[to_row_id][to_col_id].GetPieceData(piece_id,piece_color,piece_type,piece_state);
-							cb[to_row_id][to_col_id].SetPieceData(-1,NONE,BLANK,PIECE_NOT_MOVING);
-						}
-						if(CheckKingMove(to_i,to_j,to_i,to_j) == false)
-						{
-							if(m_enpassentFlag == TRUE)
-							{	
-								cb[from_i][from_j].SetPieceData(cb[to_i][to_j].GetPieceId(),cb[to_i][to_j].GetPieceColor(),cb[to_i][to_j].GetPieceType(),cb[to_i][to_j].GetPieceState());
-								cb[to_i][to_j].SetPieceData(-1,NONE,BLANK,PIECE_NOT_MOVING);
-								cb[to_row_id][to_col_id].SetPieceData(to_pieceid,to_colortype,to_piecetype,to_piecestate);
-							}
-							else
-							{
-								cb[from_i][from_j].SetPieceData(cb[to_i][to_j].GetPieceId(),cb[to_i][to_j].GetPieceColor(),cb[to_i][to_j].GetPieceType(),cb[to_i][to_j].GetPieceState());
-								cb[to_i][to_j].SetPieceData(piece_id,piece_color,piece_type,piece_state);
-							}
-							m_blackKingMovedFlag = tempblackKingMoveFlag;
-							m_whiteKingMovedFlag = tempwhiteKingMoveFlag;
-							continue;
-						}
-						if(m_enpassentFlag == TRUE)
-						{	
-							cb[from_i][from_j].SetPieceData(cb[to_i][to_j].GetPieceId(),cb[to_i][to_j].GetPieceColor(),cb[to_i][to_j].GetPieceType(),cb[to_i][to_j].GetPieceState());
-							cb[to_i][to_j].SetPieceData(-1,NONE,BLANK,PIECE_NOT_MOVING);
-							cb[to_row_id][to_col_id].SetPieceData(to_pieceid,to_colortype,to_piecetype,to_piecestate);								
-						}
-						else
-						{
-							cb[from_i][from_j].SetPieceData(cb[to_i][to_j].GetPieceId(),cb[to_i][to_j].GetPieceColor(),cb[to_i][to_j].GetPieceType(),cb[to_i][to_j].GetPieceState());
-							cb[to_i][to_j].SetPieceData(piece_id,piece_color,piece_type,piece_state);
-						}
-						m_blackKingMovedFlag = tempblackKingMoveFlag;
-						m_whiteKingMovedFlag = tempwhiteKingMoveFlag;
-						if(flipflag == TRUE)
-						{
-							m_white_on_top = true;
-							to_i = 7 - to_i;
-							to_j = 7 - to_j;
-							from_i = 7-from_i;
-							from_j = 7-from_j;
-							FlipBoard();
-							flipflag = FALSE;						
-						}						
-						return true;
-					}
-				}
-			}
-			else if(cstring[1] >='a' && cstring[1] <='z' && cstring[1] != 'x' &&cstring[3] != '+')
-			{
-				for(int i=0;i<8;i++)
-				{
-					int j = cstring[1]-'a';
-					m_point.x = i;
-					m_point.y = j;
-					int piecetype;
-					bool tempblackKingMoveFlag = m_blackKingMovedFlag;
-					bool tempwhiteKingMoveFlag = m_whiteKingMovedFlag;
-					
-					if(cb[i][j].GetPieceId() == GetPieceType(cstring,pieceside,piecetype)&& (CheckValidMove(to_i,to_j) == true))
-					{
-						from_i = i;
-						from_j = j;
-						cb[to_i][to_j].GetPieceData(piece_id,piece_color,piece_type,piece_state);
-						cb[to_i][to_j].SetPieceData(cb[from_i][from_j].GetPieceId(),cb[from_i][from_j].GetPieceColor(),cb[from_i][from_j].GetPieceType(),cb[from_i][from_j].GetPieceState());
-						cb[from_i][from_j].SetPieceData(-1,NONE,BLANK,PIECE_NOT_MOVING);
-						if(m_enpassentFlag == TRUE)
-						{							
-							m_History[m_iHistory].GetHistory(
-										piece_side,
-										from_piece_type, from_color_type,from_pieceid,
-										from_row_id,from_col_id, to_piecetype,
-										to_colortype,to_pieceid,to_row_id,
-										to_col_id);
-							cb[to_row_id][to_col_id].GetPieceData(piece_id,piece_color,piece_type,piece_state);
-							cb[to_row_id][to_col_id].SetPieceData(-1,NONE,BLANK,PIECE_NOT_MOVING);
-						}
-						if(CheckKingMove(to_i,to_j,to_i,to_j) == false)
-						{
-							if(m_enpassentFlag == TRUE)
-							{	
-								cb[from_i][from_j].SetPieceData(cb[to_i][to_j].GetPieceId(),cb[to_i][to_j].GetPieceColor(),cb[to_i][to_j].GetPieceType(),cb[to_i][to_j].GetPieceState());
-								cb[to_i][to_j].SetPieceData(-1,NONE,BLANK,PIECE_NOT_MOVING);
-								cb[to_row_id][to_col_id].SetPieceData(to_pieceid,to_colortype,to_piecetype,to_piecestate);								
-							}
-							else
-							{
-								cb[from_i][from_j].SetPieceData(cb[to_i][to_j].GetPieceId(),cb[to_i][to_j].GetPieceColor(),cb[to_i][to_j].GetPieceType(),cb[to_i][to_j].GetPieceState());
-								cb[to_i][to_j].SetPieceData(piece_id,piece_color,piece_type,piece_state);
-							}
-							
-							m_blackKingMovedFlag = tempblackKingMoveFlag;
-							m_whiteKingMovedFlag = tempwhiteKingMoveFlag;
-							continue;
-						}
-						if(m_enpassentFlag == TRUE)
-						{	
-							cb[from_i][from_j].SetPieceData(cb[to_i][to_j].GetPieceId(),cb[to_i][to_j].GetPieceColor(),cb[to_i][to_j].GetPieceType(),cb[to_i][to_j].GetPieceState());
-							cb[to_i][to_j].SetPieceData(-1,NONE,BLANK,PIECE_NOT_MOVING);
-							cb[to_row_id][to_col_id].SetPieceData(to_pieceid,to_colortype,to_piecetype,to_piecestate);								
-						}
-						else
-						{
-							cb[from_i][from_j].SetPieceData(cb[to_i][to_j].GetPieceId(),cb[to_i][to_j].GetPieceColor(),cb[to_i][to_j].GetPieceType(),cb[to_i][to_j].GetPieceState());
-							cb[to_i][to_j].SetPieceData(piece_id,piece_color,piece_type,piece_state);
-						}
-						
-						m_blackKingMovedFlag = tempblackKingMoveFlag;
-						m_whiteKingMovedFlag = tempwhiteKingMoveFlag;
+		m_fileReadFlag = FALSE;
+		return;
+	}
+	PGNTOKEN tok;
+	int token = reader.NextToken(tok);
+	for(;token == PGN_TAG;token = reader.NextToken(tok))
+		SetPGNTag(CString(tok.text,tok.length),CString(tok.value,tok.valueLength));
+	//Send Tag info
+	unsigned char data[500];
+	memset(data,'\0',500);
+	int count = 0;
+	data[count++] = GAMEINFO;
+	data[count++] = m_gameInfoDlg.m_edit_event.GetLength();
+	memcpy(&data[count],m_gameInfoDlg.m_edit_event.GetBuffer(0),m_gameInfoDlg.m_edit_event.GetLength());
+	count += m_gameInfoDlg.m_edit_event.GetLength();
 
-						if(flipflag == TRUE)
-						{
-							m_white_on_top = true;
-							to_i = 7 - to_i;
-							to_j = 7 - to_j;
-							from_i = 7-from_i;
-							from_j = 7-from_j;
-							FlipBoard();
-							flipflag = FALSE;						
-						}
-						return true;
-					}			
-				}
-			}
-			else if(cstring[1] >='1' && cstring[1] <='8' &&
-				cstring[0] >='a' && cstring[1] <='h')
-			{
-				int i = (int)('9'- cstring[1]) -1;
-				int j = cstring[0]-'a';
- 				m_point.x = i;
-				m_point.y = j;
-				int piecetype;
-				bool tempblackKingMoveFlag = m_blackKingMovedFlag;
-				bool tempwhiteKingMoveFlag = m_whiteKingMovedFlag;
-				if(cb[i][j].GetPieceId() == GetPieceType(cstring,pieceside,piecetype)&& (CheckValidMove(to_i,to_j) == true))
-				{
-					from_i = i;
-					from_j = j;
-					cb[to_i][to_j].GetPieceData(piece_id,piece_color,piece_type,piece_state);
-					cb[to_i][to_j].SetPieceData(cb[from_i][from_j].GetPieceId(),cb[from_i][from_j].GetPieceColor(),cb[from_i][from_j].GetPieceType(),cb[from_i][from_j].GetPieceState());
-					cb[from_i][from_j].SetPieceData(-1,NONE,BLANK,PIECE_NOT_MOVING);
-					if(m_enpassentFlag == TRUE)
-					{							
-						m_History[m_iHistory].GetHistory(
-									piece_side,
-									from_piece_type, from_color_type,from_pieceid,
-									from_row_id,from_col_id, to_piecetype,
-									to_colortype,to_pieceid,to_row_id,
-									to_col_id);
-						cb[to_row_id][to_col_id].GetPieceData(piece_id,piece_color,piece_type,piece_state);
-						cb[to_row_id][to_col_id].SetPieceData(-1,NONE,BLANK,PIECE_NOT_MOVING);
-					}
-					if(CheckKingMove(to_i,to_j,to_i,to_j) == false)
-					{
-						if(m_enpassentFlag == TRUE)
-						{	
-							cb[from_i][from_j].SetPieceData(cb[to_i][to_j].GetPieceId(),cb[to_i][to_j].GetPieceColor(),cb[to_i][to_j].GetPieceType(),cb[to_i][to_j].GetPieceState());
-							cb[to_i][to_j].SetPieceData(-1,NONE,BLANK,PIECE_NOT_MOVING);
-							cb[to_row_id][to_col_id].SetPieceData(to_pieceid,to_colortype,to_piecetype,to_piecestate);								
-						}
-						else
-						{
-							cb[from_i][from_j].SetPieceData(cb[to_i][to_j].GetPieceId(),cb[to_i][to_j].GetPieceColor(),cb[to_i][to_j].GetPieceType(),cb[to_i][to_j].GetPieceState());
-							cb[to_i][to_j].SetPieceData(piece_id,piece_color,piece_type,piece_state);
-						}
-						m_blackKingMovedFlag = tempblackKingMoveFlag;
-						m_whiteKingMovedFlag = tempwhiteKingMoveFlag;
-						return false;
-					}
-					if(m_enpassentFlag == TRUE)
-					{	
-						cb[from_i][from_j].SetPieceData(cb[to_i][to_j].GetPieceId(),cb[to_i][to_j].GetPieceColor(),cb[to_i][to_j].GetPieceType(),cb[to_i][to_j].GetPieceState());
-						cb[to_i][to_j].SetPieceData(-1,NONE,BLANK,PIECE_NOT_MOVING);
-						cb[to_row_id][to_col_id].SetPieceData(to_pieceid,to_colortype,to_piecetype,to_piecestate);								
-					}
-					else
-					{
-						cb[from_i][from_j].SetPieceData(cb[to_i][to_j].GetPieceId(),cb[to_i][to_j].GetPieceColor(),cb[to_i][to_j].GetPieceType(),cb[to_i][to_j].GetPieceState());
-						cb[to_i][to_j].SetPieceData(piece_id,piece_color,piece_type,piece_state);
-					}
-					
-					m_blackKingMovedFlag = tempblackKingMoveFlag;
-					m_whiteKingMovedFlag = tempwhiteKingMoveFlag;
-					if(flipflag == TRUE)
-					{
-						m_white_on_top = true;
-						to_i = 7 - to_i;
-						to_j = 7 - to_j;
-						from_i = 7-from_i;
-						from_j = 7-from_j;
-						FlipBoard();
-						flipflag = FALSE;						
-					}
-					return true;
-				}		
-			}
-			else if(cstring[1] >='1' && cstring[1] <='8')
-			{
-				for(int j=0;j<8;j++)
-				{
-					int i = (int)('9'- cstring[1]) -1;
- 					m_point.x = i;
-					m_point.y = j;
-					int piecetype;
-					bool tempblackKingMoveFlag = m_blackKingMovedFlag;
-					bool tempwhiteKingMoveFlag = m_whiteKingMovedFlag;
-					if(cb[i][j].GetPieceId() == GetPieceType(cstring,pieceside,piecetype)&& (CheckValidMove(to_i,to_j) == true))
-					{
-						from_i = i;
-						from_j = j;
-						cb[to_i][to_j].GetPieceData(piece_id,piece_color,piece_type,piece_state);
-						cb[to_i][to_j].SetPieceData(cb[from_i][from_j].GetPieceId(),cb[from_i][from_j].GetPieceColor(),cb[from_i][from_j].GetPieceType(),cb[from_i][from_j].GetPieceState());
-						cb[from_i][from_j].SetPieceData(-1,NONE,BLANK,PIECE_NOT_MOVING);
-						if(m_enpassentFlag == TRUE)
-						{							
-							m_History[m_iHistory].GetHistory(
-										piece_side,
-										from_piece_type, from_color_type,from_pieceid,
-										from_row_id,from_col_id, to_piecetype,
-										to_colortype,to_pieceid,to_row_id,
-										to_col_id);
-							cb[to_row_id][to_col_id].GetPieceData(piece_id,piece_color,piece_type,piece_state);
-							cb[to_row_id][to_col_id].SetPieceData(-1,NONE,BLANK,PIECE_NOT_MOVING);
-						}
-						if(CheckKingMove(to_i,to_j,to_i,to_j) == false)
-						{
-							if(m_enpassentFlag == TRUE)
-							{	
-								cb[from_i][from_j].SetPieceData(cb[to_i][to_j].GetPieceId(),cb[to_i][to_j].GetPieceColor(),cb[to_i][to_j].GetPieceType(),cb[to_i][to_j].GetPieceState());
-								cb[to_i][to_j].SetPieceData(-1,NONE,BLANK,PIECE_NOT_MOVING);
-								cb[to_row_id][to_col_id].SetPieceData(to_pieceid,to_colortype,to_piecetype,to_piecestate);								
-							}
-							else
-							{
-								cb[from_i][from_j].SetPieceData(cb[to_i][to_j].GetPieceId(),cb[to_i][to_j].GetPieceColor(),cb[to_i][to_j].GetPieceType(),cb[to_i][to_j].GetPieceState());
-								cb[to_i][to_j].SetPieceData(piece_id,piece_color,piece_type,piece_state);
-							}
-							m_blackKingMovedFlag = tempblackKingMoveFlag;
-							m_whiteKingMovedFlag = tempwhiteKingMoveFlag;
-							continue;
-						}
-						if(m_enpassentFlag == TRUE)
-						{	
-							cb[from_i][from_j].SetPieceData(cb[to_i][to_j].GetPieceId(),cb[to_i][to_j].GetPieceColor(),cb[to_i][to_j].GetPieceType(),cb[to_i][to_j].GetPieceState());
-							cb[to_i][to_j].SetPieceData(-1,NONE,BLANK,PIECE_NOT_MOVING);
-							cb[to_row_id][to_col_id].SetPieceData(to_pieceid,to_colortype,to_piecetype,to_piecestate);								
-						}
-						else
-						{
-							cb[from_i][from_j].SetPieceData(cb[to_i][to_j].GetPieceId(),cb[to_i][to_j].GetPieceColor(),cb[to_i][to_j].GetPieceType(),cb[to_i][to_j].GetPieceState());
-							cb[to_i][to_j].SetPieceData(piece_id,piece_color,piece_type,piece_state);
-						}
-						
-						m_blackKingMovedFlag = tempblackKingMoveFlag;
-						m_whiteKingMovedFlag = tempwhiteKingMoveFlag;
-						if(flipflag == TRUE)
-						{
-							m_white_on_top = true;
-							to_i = 7 - to_i;
-							to_j = 7 - to_j;
-							from_i = 7-from_i;
-							from_j = 7-from_j;
-							FlipBoard();
-							flipflag = FALSE;						
-						}
-						return true;
-					}		
-				}
-			}
-			else
-				for(int i=0;i<8;i++)
-				{
-					for(int j=0;j<8;j++)
-					{
-						m_point.x = i;
-						m_point.y = j;
-						int piecetype;
-						bool tempblackKingMoveFlag = m_blackKingMovedFlag;
-						bool tempwhiteKingMoveFlag = m_whiteKingMovedFlag;
-						if(cb[i][j].GetPieceId() == GetPieceType(cstring,pieceside,piecetype)&& (CheckValidMove(to_i,to_j) == true))
-						{
-							from_i = i;
-							from_j = j;
-							cb[to_i][to_j].GetPieceData(piece_id,piece_color,piece_type,piece_state);
-							cb[to_i][to_j].SetPieceData(cb[from_i][from_j].GetPieceId(),cb[from_i][from_j].GetPieceColor(),cb[from_i][from_j].GetPieceType(),cb[from_i][from_j].GetPieceState());
-							cb[from_i][from_j].SetPieceData(-1,NONE,BLANK,PIECE_NOT_MOVING);
-							if(m_enpassentFlag == TRUE)
-						{							
-							m_History[m_iHistory].GetHistory(
-										piece_side,
-										from_piece_type, from_color_type,from_pieceid,
-										from_row_id,from_col_id, to_piecetype,
-										to_colortype,to_pieceid,to_row_id,
-										to_col_id);
-							cb[to_row_id][to_col_id].GetPieceData(piece_id,piece_color,piece_type,piece_state);
-							cb[to_row_id][to_col_id].SetPieceData(-1,NONE,BLANK,PIECE_NOT_MOVING);
-						}
-						if(CheckKingMove(to_i,to_j,to_i,to_j) == false)
-						{
-							if(m_enpassentFlag == TRUE)
-							{	
-								cb[from_i][from_j].SetPieceData(cb[to_i][to_j].GetPieceId(),cb[to_i][to_j].GetPieceColor(),cb[to_i][to_j].GetPieceType(),cb[to_i][to_j].GetPieceState());
-								cb[to_i][to_j].SetPieceData(-1,NONE,BLANK,PIECE_NOT_MOVING);
-								cb[to_row_id][to_col_id].SetPieceData(to_pieceid,to_colortype,to_piecetype,to_piecestate);								
-							}
-							else
-							{
-								cb[from_i][from_j].SetPieceData(cb[to_i][to_j].GetPieceId(),cb[to_i][to_j].GetPieceColor(),cb[to_i][to_j].GetPieceType(),cb[to_i][to_j].GetPieceState());
-								cb[to_i][to_j].SetPieceData(piece_id,piece_color,piece_type,piece_state);
-							}
-							m_blackKingMovedFlag = tempblackKingMoveFlag;
-							m_whiteKingMovedFlag = tempwhiteKingMoveFlag;
-							continue;
-						}
-						if(m_enpassentFlag == TRUE)
-						{	
-							cb[from_i][from_j].SetPieceData(cb[to_i][to_j].GetPieceId(),cb[to_i][to_j].GetPieceColor(),cb[to_i][to_j].GetPieceType(),cb[to_i][to_j].GetPieceState());
-							cb[to_i][to_j].SetPieceData(-1,NONE,BLANK,PIECE_NOT_MOVING);
-							cb[to_row_id][to_col_id].SetPieceData(to_pieceid,to_colortype,to_piecetype,to_piecestate);								
-						}
-						else
-						{
-							cb[from_i][from_j].SetPieceData(cb[to_i][to_j].GetPieceId(),cb[to_i][to_j].GetPieceColor(),cb[to_i][to_j].GetPieceType(),cb[to_i][to_j].GetPieceState());
-							cb[to_i][to_j].SetPieceData(piece_id,piece_color,piece_type,piece_state);
-						}
-						
-						m_blackKingMovedFlag = tempblackKingMoveFlag;
-						m_whiteKingMovedFlag = tempwhiteKingMoveFlag;
-							if(flipflag == TRUE)
-							{
-								m_white_on_top = true;
-								to_i = 7 - to_i;
-								to_j = 7 - to_j;
-								from_i = 7-from_i;
-								from_j = 7-from_j;
-								FlipBoard();
-								flipflag = FALSE;						
-							}
-							return true;
-						}
-					}
-				}
-		}
-		else
-		{
-			for(int i=0;i<8;i++)
-			{
-				for(int j=0;j<8;j++)
-				{
-					m_point.x = i;
-					m_point.y = j;
-					int piecetype;
-					bool tempblackKingMoveFlag = m_blackKingMovedFlag;
-					bool tempwhiteKingMoveFlag = m_whiteKingMovedFlag;
-		
-					if(cb[i][j].GetPieceId() == GetPieceType(cstring,pieceside,piecetype)&& (CheckValidMove(to_i,to_j) == true))
-					{
+	data[count++] = m_gameInfoDlg.m_edit_site.GetLength();
+	memcpy(&data[count],m_gameInfoDlg.m_edit_site.GetBuffer(0),m_gameInfoDlg.m_edit_site.GetLength());
+	count += m_gameInfoDlg.m_edit_site.GetLength();
 
-						from_i = i;
-						from_j = j;
-						cb[to_i][to_j].GetPieceData(piece_id,piece_color,piece_type,piece_state);
-						cb[to_i][to_j].SetPieceData(cb[from_i][from_j].GetPieceId(),cb[from_i][from_j].GetPieceColor(),cb[from_i][from_j].GetPieceType(),cb[from_i][from_j].GetPieceState());
-						cb[from_i][from_j].SetPieceData(-1,NONE,BLANK,PIECE_NOT_MOVING);
-						if(m_enpassentFlag == TRUE)
-						{							
-							m_History[m_iHistory].GetHistory(
-										piece_side,
-										from_piece_type, from_color_type,from_pieceid,
-										from_row_id,from_col_id, to_piecetype,
-										to_colortype,to_pieceid,to_row_id,
-										to_col_id);
-							cb[to_row_id][to_col_id].GetPieceData(piece_id,piece_color,piece_type,piece_state);
-							cb[to_row_id][to_col_id].SetPieceData(-1,NONE,BLANK,PIECE_NOT_MOVING);
-						}
-						if(CheckKingMove(to_i,to_j,to_i,to_j) == false)
-						{
-							if(m_enpassentFlag == TRUE)
-							{	
-								cb[from_i][from_j].SetPieceData(cb[to_i][to_j].GetPieceId(),cb[to_i][to_j].GetPieceColor(),cb[to_i][to_j].GetPieceType(),cb[to_i][to_j].GetPieceState());
-								cb[to_i][to_j].SetPieceData(-1,NONE,BLANK,PIECE_NOT_MOVING);
-								cb[to_row_id][to_col_id].SetPieceData(to_pieceid,to_colortype,to_piecetype,to_piecestate);								
-							}
-							else
-							{
-								cb[from_i][from_j].SetPieceData(cb[to_i][to_j].GetPieceId(),cb[to_i][to_j].GetPieceColor(),cb[to_i][to_j].GetPieceType(),cb[to_i][to_j].GetPieceState());
-								cb[to_i][to_j].SetPieceData(piece_id,piece_color,piece_type,piece_state);
-							}
-							m_blackKingMovedFlag = tempblackKingMoveFlag;
-							m_whiteKingMovedFlag = tempwhiteKingMoveFlag;
-							continue;
-						}
-						if(m_enpassentFlag == TRUE)
-						{	
-							cb[from_i][from_j].SetPieceData(cb[to_i][to_j].GetPieceId(),cb[to_i][to_j].GetPieceColor(),cb[to_i][to_j].GetPieceType(),cb[to_i][to_j].GetPieceState());
-							cb[to_i][to_j].SetPieceData(-1,NONE,BLANK,PIECE_NOT_MOVING);
-							cb[to_row_id][to_col_id].SetPieceData(to_pieceid,to_colortype,to_piecetype,to_piecestate);								
-						}
-						else
-						{
-							cb[from_i][from_j].SetPieceData(cb[to_i][to_j].GetPieceId(),cb[to_i][to_j].GetPieceColor(),cb[to_i][to_j].GetPieceType(),cb[to_i][to_j].GetPieceState());
-							cb[to_i][to_j].SetPieceData(piece_id,piece_color,piece_type,piece_state);
-						}
-						
-						m_blackKingMovedFlag = tempblackKingMoveFlag;
-						m_whiteKingMovedFlag = tempwhiteKingMoveFlag;
-						if(flipflag == TRUE)
-						{
-							m_white_on_top = true;
-							to_i = 7 - to_i;
-							to_j = 7 - to_j;
-							from_i = 7-from_i;
-							from_j = 7-from_j;
-							FlipBoard();
-							flipflag = FALSE;
+	data[count++] = m_gameInfoDlg.m_edit_date.GetLength();
+	memcpy(&data[count],m_gameInfoDlg.m_edit_date.GetBuffer(0),m_gameInfoDlg.m_edit_date.GetLength());
+	count += m_gameInfoDlg.m_edit_date.GetLength();
 
-						}
-						return true;
-					}
-				}
-			}
+	data[count++] = m_gameInfoDlg.m_edit_round.GetLength();
+	memcpy(&data[count],m_gameInfoDlg.m_edit_round.GetBuffer(0),m_gameInfoDlg.m_edit_round.GetLength());
+	count += m_gameInfoDlg.m_edit_round.GetLength();
+
+	data[count++] = m_gameInfoDlg.m_edit_white.GetLength();
+	memcpy(&data[count],m_gameInfoDlg.m_edit_white.GetBuffer(0),m_gameInfoDlg.m_edit_white.GetLength());
+	count += m_gameInfoDlg.m_edit_white.GetLength();
+
+	data[count++] = m_gameInfoDlg.m_edit_black.GetLength();
+	memcpy(&data[count],m_gameInfoDlg.m_edit_black.GetBuffer(0),m_gameInfoDlg.m_edit_black.GetLength());
+	count += m_gameInfoDlg.m_edit_white.GetLength();
+
+	data[count++] = m_gameInfoDlg.m_edit_result.GetLength();
+	memcpy(&data[count],m_gameInfoDlg.m_edit_result.GetBuffer(0),m_gameInfoDlg.m_edit_result.GetLength());
+	count += m_gameInfoDlg.m_edit_result.GetLength();
+
+	data[count++] = m_gameInfoDlg.m_edit_fenstring.GetLength();
+	memcpy(&data[count],m_gameInfoDlg.m_edit_fenstring.GetBuffer(0),m_gameInfoDlg.m_edit_fenstring.GetLength());
+	count += m_gameInfoDlg.m_edit_fenstring.GetLength();
+
+	data[count++] = m_gameInfoDlg.m_edit_eco.GetLength();
+	memcpy(&data[count],m_gameInfoDlg.m_edit_eco.GetBuffer(0),m_gameInfoDlg.m_edit_eco.GetLength());
+	count += m_gameInfoDlg.m_edit_eco.GetLength();
+
+	data[count++] = m_gameInfoDlg.m_edit_playcount.GetLength();
+	memcpy(&data[count],m_gameInfoDlg.m_edit_playcount.GetBuffer(0),m_gameInfoDlg.m_edit_playcount.GetLength());
+	count += m_gameInfoDlg.m_edit_playcount.GetLength();
+
+	data[count++] = m_gameInfoDlg.m_edit_blackelo.GetLength();
+	memcpy(&data[count],m_gameInfoDlg.m_edit_blackelo.GetBuffer(0),m_gameInfoDlg.m_edit_blackelo.GetLength());
+	count += m_gameInfoDlg.m_edit_blackelo.GetLength();
+
+	data[count++] = m_gameInfoDlg.m_edit_whiteelo.GetLength();
+	memcpy(&data[count],m_gameInfoDlg.m_edit_whiteelo.GetBuffer(0),m_gameInfoDlg.m_edit_whiteelo.GetLength());
+	count += m_gameInfoDlg.m_edit_whiteelo.GetLength();
+
+	data[count++] = m_gameInfoDlg.m_event_date.GetLength();
+	memcpy(&data[count],m_gameInfoDlg.m_event_date.GetBuffer(0),m_gameInfoDlg.m_event_date.GetLength());
+	count += m_gameInfoDlg.m_event_date.GetLength();
+
+
+	SendSockData(data,count);
+	if(!m_gameInfoDlg.m_edit_fenstring.IsEmpty())
+	{
+		doFENPositionRead(m_gameInfoDlg.m_edit_fenstring,'F');
+		unsigned char data[1024];
+		memset(data,'\0',1024);
+		data[0] = POSITION_DATA;
+		int count = 1;
+		for(int i=0;i<m_gameInfoDlg.m_edit_fenstring.GetLength();i++)
+		{
+			data[count++] = m_gameInfoDlg.m_edit_fenstring[i];
 		}
+		SendSockData(data,count);
 	}
-	/*else
+
+	//the main line is played through the board, comments and variations
+	//are put on it once it is in the record
+	m_PGNAnnotations.RemoveAll();
+	m_PGNAnnotationMoves.RemoveAll();
+	int firstply = m_iHistory + 1;
+	int moves = 0;
+	int pieceside = m_position.GetSide() == SIDE_WHITE ? WHITE : BLACK;
+	BOOL failed = FALSE;
+	for(;token != PGN_END;token = reader.NextToken(tok))
 	{
-		if(strlen(cstring)>3)
+		if(token == PGN_SAN && failed == FALSE)
 		{
-			if(cstring[0] >='a' && cstring[0] <='z' && cstring[1] == 'x')
-			{
-				for(int i=0;i<8;i++)
-				{
-					int j=(int)(cstring[0]-'a');
-					m_point.x = 7-i;
-					m_point.y = 7-j;
-					int piecetype;
-					if(cb[7-i][7-j].GetPieceId() == GetPieceType(cstring,pieceside,piecetype)&& CheckValidMove(to_i,to_j) == true)
-					{
-						from_i = 7-i;
-						from_j = 7-j;
-						return true;
-					}
-				}
-			}
-			else if(cstring[1] >='a' && cstring[1] <='z' && cstring[1] != 'x' &&cstring[3] != '+')
-			{
-				for(int i=0;i<8;i++)
-				{
-					int j = cstring[1]-'a';
-					m_point.x = 7-i;
-					m_point.y = 7-j;
-					int piecetype;
-					if(cb[7-i][7-j].GetPieceId() == GetPieceType(cstring,pieceside,piecetype)&& CheckValidMove(to_i,to_j) == true)
-					{
-						from_i = 7-i;
-						from_j = 7-j;
-						return true;
-					}			
-				}
-			}
-			else if(cstring[1] >='1' && cstring[1] <='8')
+			char cstring[255];
+			int len = min(tok.length,254);
+			memcpy(cstring,tok.text,len);
+			cstring[len] = '\0';
+			if(moves > 0)
+				Sleep(m_optDlg.m_edit_replay_interval*1000);
+			int ply = m_iHistory;
+			PGNMove(cstring,pieceside);
+			if(m_iHistory == ply)
 			{
-				for(int j=0;j<8;j++)
-				{
-					int i = (int)('9'- cstring[1]) -1;
-					m_point.x = 7-i;
-					m_point.y = 7-j;
-					int piecetype;
-					if(cb[7-i][7-j].GetPieceId() == GetPieceType(cstring,pieceside,piecetype)&& CheckValidMove(to_i,to_j) == true)
-					{
-						from_i = 7-i;
-						from_j = 7-j;
-						return true;
-					}			
-				}
+				writeMessage("PGN move %d %s could not be played",moves/2 + 1,cstring);
+				failed = TRUE;
 			}
-			else
-				for(int i=0;i<8;i++)
-				{
-					for(int j=0;j<8;j++)
-					{
-						m_point.x = 7-i;
-						m_point.y = 7-j;
-						int piecetype;
-						if(cb[7-i][7-j].GetPieceId() == GetPieceType(cstring,pieceside,piecetype)&& CheckValidMove(to_i,to_j) == true)
-						{
-							from_i = 7-i;
-							from_j = 7-j;
-							return true;
-						}
-					}
-				}
+			moves++;
+			pieceside = pieceside == WHITE ? BLACK : WHITE;
 		}
-		else
+		else if(token == PGN_COMMENT)
 		{
-			for(int i=0;i<8;i++)
-			{
-				for(int j=0;j<8;j++)
-				{
-					m_point.x = 7-i;
-					m_point.y = 7-j;
-					int piecetype;
-					if(cb[7-i][7-j].GetPieceId() == GetPieceType(cstring,pieceside,piecetype)&& CheckValidMove(to_i,to_j) == true)
-					{
-						from_i = 7-i;
-						from_j = 7-j;
-						return true;
-					}
-				}
-			}
+			m_PGNAnnotations.Add("{" + CString(tok.text,tok.length));
+			m_PGNAnnotationMoves.Add(moves);
 		}
-	}*/
-	return false;
+		else if(token == PGN_NAG && moves > 0)
+		{
+			CString nag;
+			nag.Format("$%d",GetNAGNumber(tok.text,tok.length));
+			m_PGNAnnotations.Add(nag);
+			m_PGNAnnotationMoves.Add(moves);
+		}
+		else if(token == PGN_VARIATION_START)
+		{
+			const char *text = tok.text + 1;
+			int depth = 1;
+			while(depth > 0 && (token = reader.NextToken(tok)) != PGN_END)
+				depth += token == PGN_VARIATION_START ? 1 : token == PGN_VARIATION_END ? -1 : 0;
+			m_PGNAnnotations.Add("(" + CString(text,(int)(tok.text - text)));
+			m_PGNAnnotationMoves.Add(moves);
+			if(token == PGN_END)
+				break;
+		}
+	}
+	SetPGNAnnotations(firstply);
+	m_fileReadFlag = FALSE;
+	DrawBoard();
+	
 }
-int CNetChessView::GetPieceType(char cstring[255],int piececolor,int &piecetype)
+//puts the comments, NAGs and variations doPGNRead collected on the plies
+//read from firstply on
+void CNetChessView::SetPGNAnnotations(int firstply)
 {
-	switch(cstring[0])
+	for(int i=0;i<m_PGNAnnotations.GetSize();i++)
 	{
-		case 'N':
-			if(piececolor == WHITE)
-			{
-				piecetype = KNIGHT;
-				return KNIGHT_WHITE;
-
-			}
-			else
-			{
-				piecetype = KNIGHT;
-				return KNIGHT_BLACK;
-			}
-			break;
-		case 'K':
-			if(piececolor == WHITE)
-			{
-				piecetype = KING;
-				return KING_WHITE;
-			}
-			else
-			{
-				piecetype = KING;
-				return KING_BLACK;
-			}
-			break;
-		case 'R':
-			if(piececolor == WHITE)
-			{
-				piecetype = ROOK;
-				return ROOK_WHITE;
-			}
-			else
-			{
-				piecetype = ROOK;
-				return ROOK_BLACK;
-			}
-			break;
-		case 'B':
-			if(piececolor == WHITE)
-			{
-				piecetype = BISHOP;
-				return BISHOP_WHITE;
-			}
-			else
-			{
-				piecetype = BISHOP;
-				return BISHOP_BLACK;
-			}
-			break;
-		case 'Q':
-			if(piececolor == WHITE)
-			{
-				piecetype = QUEEN;
-				return QUEEN_WHITE;
-			}
-			else
-			{
-				piecetype = QUEEN;
-				return QUEEN_BLACK;
-			}
-			break;
-		default:
+		CString text = m_PGNAnnotations[i];
+		//the move the annotation follows, firstply - 1 before the first one
+		int ply = firstply + m_PGNAnnotationMoves[i] - 1;
+		if(ply > m_topHistory)
+			continue;
+		if(text[0] == '{')
 		{
-			if(cstring[1] != 'x')
-			{
-				int j = (int)(cstring[0]-'a');
-				int i = (int)('9'-cstring[1])-1;
-				piecetype = cb[i][j].GetPieceType();
-				return cb[i][j].GetPieceId();
-			}
-			else
-			{
-				if(piececolor == WHITE)
-				{
-					piecetype = PAWN;
-					return PAWN_WHITE;
-				}
-				else
-				{
-					piecetype = PAWN;
-					return PAWN_BLACK;
-				}
-			}
+			m_History.SetComment(ply,text.Mid(1));
+		}
+		else if(text[0] == '$')
+		{
+			if(ply >= firstply)
+				m_History.SetNAG(ply,atoi(text.Mid(1)));
+		}
+		else if(ply >= firstply)
+		{
+			CPosition pos;
+			int k = m_History.RestorePosition(ply,pos);
+			if(k < 0)
+				continue;
+			for(;k < ply;k++)
+				m_History[k].Play(pos);
+			if(!m_History.AddVariation(ply,pos,text.Mid(1)))
+				writeMessage("Variation at ply %d has a move that could not be played: %s",ply + 1,(LPCTSTR)text.Mid(1));
 		}
 	}
+	m_PGNAnnotations.RemoveAll();
+	m_PGNAnnotationMoves.RemoveAll();
 }
-void CNetChessView::doFENRead(CString file,char type)
+
+//NAG, comment and variations of the move at ply as PGN, pos is the
+//position before it
+CString CNetChessView::GetPGNAnnotation(int ply, CPosition &pos)
 {
-//	OnInitialUpdate();
+	CString str;
+	if(m_History.GetNAG(ply) > 0)
+		str.Format(" $%d",m_History.GetNAG(ply));
+	if(m_History.GetComment(ply).GetLength() > 0)
+		str += " {" + m_History.GetComment(ply) + "}";
+	str += m_History.GetVariationString(ply,pos);
+	return str;
+}
+//Plays the SAN move cstring for pieceside through the board. The move is
+//resolved on m_position by ParseSAN; nothing is played when it is not legal.
+int CNetChessView::PGNMove(char cstring[255], int pieceside)
+{
+	m_checkFlag = m_castlingFlag = m_enpassentFlag = m_promotionFlag =
+	m_ambiguousMoveRankFlag = m_ambiguousMoveFileFlag = FALSE;
 
-	if(m_white_on_top == true)
-	{		
-		FlipBoard();
-		m_white_on_top = false;
+	CPosition pos = m_position;
+	pos.SetSide(pieceside == WHITE ? SIDE_WHITE : SIDE_BLACK);
+	CHESSMOVE move = ParseSAN(pos,cstring);
+	if(move == NULL_MOVE)
+		return -1;
+	if(IsPromotionMove(move))
+	{
+		//the piece is taken from the dialog the mouse path would show
+		m_pickPieceDlg->m_pickpiecetype = 1;
+		m_pickPieceDlg->m_piecked_piece = g_positionPieceIds[MakePiece(pos.GetSide(),GetPromotionType(move))];
+		GetPieceInfo(m_pickPieceDlg->m_piecked_piece,m_pickPieceDlg->m_piece_color,m_pickPieceDlg->m_piece_type);
 	}
+	PGNMoveSquares(GetMoveFrom(move),GetMoveTo(move));
+	return 0;
+}
+
+//plays from -> to through the normal mouse path
+void CNetChessView::PGNMoveSquares(int from, int to)
+{
+	int from_i,from_j,to_i,to_j;
+	GetBoardCell(from,from_i,from_j);
+	GetBoardCell(to,to_i,to_j);
+	m_point.x = from_i;
+	m_point.y = from_j;
+	m_mouseMoveFlag = true;
+	CRect rect=cb[to_i][to_j].GetRect();
+	CPoint pt(rect.left+10,rect.top+10);
+	OnLButtonUpAction(0,pt);
+}
+
+void CNetChessView::doFENRead(CString file,char type)
+{
+//	OnInitialUpdate();
 
 	unsigned char msg[2];
 	msg[0] = PGNFILE;
@@ -10518,38 +7653,14 @@ void CNetChessView::doFENRead(CString file,char type)
 			}
 		
 		}
-		int pos_count = -1;
-		int from_i,from_j, to_i,to_j;
-		for(int i=0;i<8;i++)
-		{
-			for(int j=0;j<8;j++)
-			{
-				pos_count++;			
-				if(pos_count == from_pos)
-				{
-					from_i = i;
-					from_j = j;
-				}
-				if(pos_count == to_pos)
-				{
-					to_i = i;
-					to_j = j;
-				}
-			}
-		}
 		if((from_type == 'p' && to_type == 'q') || (from_type == 'P' && to_type == 'Q'))
 		{			
 			m_pickPieceDlg->m_pickpiecetype  = 1;			
 			m_pickPieceDlg->m_piecked_piece= to_type;
 			GetPieceInfo(to_type,m_pickPieceDlg->m_piece_color,m_pickPieceDlg->m_piece_type);
 		}
-		
-		m_point.x = from_i;
-		m_point.y = from_j;
-		m_mouseMoveFlag = true;
-		CRect rect=cb[to_i][to_j].GetRect();
-		CPoint pt(rect.left+10,rect.top+10);
-		OnLButtonUpAction(0,pt);
+		//board strings run from a8 to h1
+		PGNMoveSquares(MakeSquare(from_pos % 8,7 - from_pos / 8),MakeSquare(to_pos % 8,7 - to_pos / 8));
 		Sleep(m_optDlg.m_edit_replay_interval*1000);
 	}
 	DrawBoard();
@@ -10557,53 +7668,17 @@ void CNetChessView::doFENRead(CString file,char type)
 
 void CNetChessView::doFENPositionRead(CString filedata,char type)
 {
-	if(m_white_on_top == true)
-	{
-		FlipBoard();
-		m_white_on_top = false;
-	}
-	for ( int i = 0; i < 8; i++)
-	{	
-		for( int j = 0; j < 8; j++)
-		{
-			cb[i][j].SetPieceData(-1,NONE,BLANK,PIECE_NOT_MOVING);
-			 
-		}	
-	}
-	
-	int i=0;
-	int j=0;
-
-	char file[1024],side[2],castlingInfo[5],enpassentInfo[3];
-	
-	memset(file,'\0',1024);
-	sscanf(filedata.GetBuffer(0),"%s%s%s%s",file,side,castlingInfo,
-		enpassentInfo);
-	
-	for(int k=0;k < (int)strlen(file) && file[k] != ' ';k++)
+	CPosition pos;
+	if(pos.SetFEN(filedata.GetBuffer(0)) == false)
 	{
-		if(file[k] >= '1' && file[k] < '9')
-		{
-			int total = (int)(file[k] - '0');
-			for(int count=0;count<total;count++,j++)
-			{
-				cb[i][j].SetPieceData(-1,NONE,BLANK,PIECE_NOT_MOVING);				
-			}			
-		}
-		else if(file[k] == '/')
-		{
-			j=0;
-			i++;
-		}
-		else if(file[k] != ' ')
-		{
-			COLOR_TYPE ct;
-			PIECE_TYPE pt;
-			GetPieceInfo(file[k],ct,pt);
-			cb[i][j].SetPieceData(file[k],ct,pt,PIECE_NOT_MOVING);
-			j++;
-		}
+		SetPaneText(MESSAGEPANE,"Invalid FEN position",1);
+		return;
 	}
+	m_position = pos;
+	SetBoardFromPosition();
+	char side[2];
+	side[0] = pos.GetSide() == SIDE_WHITE ? 'w' : 'b';
+	side[1] = '\0';
 	//set piece side	
 	if(side[0] == 'w')
 	{
@@ -10642,33 +7717,13 @@ void CNetChessView::doFENPositionRead(CString filedata,char type)
 	}
 
 	//set flags
-	m_blackKingMovedFlag = true;
-	m_whiteKingMovedFlag = true;
-	m_blackRookRank1MovedFlag = true;
-	m_whiteRookRank1MovedFlag = true;
-	m_blackRookRank7MovedFlag = true;
-	m_whiteRookRank7MovedFlag = true;
-	CString str = castlingInfo;
-	if(str.Find("K")>=0)
-	{
-		m_whiteKingMovedFlag = false;
-		m_whiteRookRank1MovedFlag = false;
-	}
-	if(str.Find("Q")>=0)
-	{
-		m_whiteKingMovedFlag = false;
-		m_whiteRookRank1MovedFlag = false;
-	}
-	if(str.Find("k")>=0)
-	{
-		m_blackKingMovedFlag = false;
-		m_blackRookRank7MovedFlag = false;
-	}
-	if(str.Find("q")>=0)
-	{
-		m_blackKingMovedFlag = false;
-		m_blackRookRank1MovedFlag = false;
-	}	
+	int castling = pos.GetCastling();
+	m_whiteKingMovedFlag = (castling & (CASTLE_WHITE_KING | CASTLE_WHITE_QUEEN)) == 0;
+	m_whiteRookRank7MovedFlag = (castling & CASTLE_WHITE_KING) == 0;
+	m_whiteRookRank1MovedFlag = (castling & CASTLE_WHITE_QUEEN) == 0;
+	m_blackKingMovedFlag = (castling & (CASTLE_BLACK_KING | CASTLE_BLACK_QUEEN)) == 0;
+	m_blackRookRank7MovedFlag = (castling & CASTLE_BLACK_KING) == 0;
+	m_blackRookRank1MovedFlag = (castling & CASTLE_BLACK_QUEEN) == 0;
 	//set enpassent availability, it will take some time
 	DrawBoard();
 }
@@ -10938,15 +7993,7 @@ void CNetChessView::OnViewDemoGoto()
 }
 void CNetChessView::MoveTo(int pos)
 {	
-	int total = m_iHistory;
-	for(int i=0;i<=total;i++)
-	{
-		OnEditUndoAction(0); 			
-	}
-	for(int i=1;i<=pos;i++)
-	{
-		OnEditRedoAction(0);				
-	}
+	GoToPly(pos - 1);
 	m_demoTotal = pos;
 	unsigned char msg[2];
 	msg[0] = GOTO;
@@ -11073,58 +8120,45 @@ void CNetChessView::CheckAmbiguousMove(int ini,int inj)
 {	
 	if(m_checkmove == FALSE)
 		return;
-	CPoint pt = m_point;
-	for(int i=0;i<8;i++)
+	//look for another piece of the same kind that can also reach ini,inj
+	CPosition pos = m_position;
+	int from = GetBoardSquare(m_point.x,m_point.y);
+	int to = GetBoardSquare(ini,inj);
+	int piece = pos.GetPiece(from);
+	if(piece == NO_PIECE)
+		return;
+	pos.SetSide(PieceSide(piece));
+	CMoveList list;
+	GenerateLegalMoves(pos,list);
+	for(int k = 0;k<list.GetSize();k++)
 	{
-		for(int j=0;j<8;j++)
-		{			
-			m_point.x = i;
-			m_point.y = j;
-			if(cb[i][j].GetPieceId() == cb[pt.x][pt.y].GetPieceId() && 
-				cb[i][j].GetPieceId() != -1)				
-			{				
-				if(i == pt.x && j == pt.y)
-					continue;
-				bool tempblackKingMoveFlag = m_blackKingMovedFlag;
-				bool tempwhiteKingMoveFlag = m_whiteKingMovedFlag;
-				if(CheckValidMove(ini,inj) == true)
-				{
-					m_blackKingMovedFlag = tempblackKingMoveFlag;
-					m_whiteKingMovedFlag = tempwhiteKingMoveFlag;
-
-					if(i == pt.x)
-					{
-						m_ambiguousMoveFileFlag = TRUE;
-
-					}
-					else if(j == pt.y)
-					{
-						m_ambiguousMoveRankFlag = TRUE;
-					}
-					else
-					{
-						m_ambiguousMoveFileFlag = TRUE;
-					}
-					m_point = pt;
-					return;
-				}
-			}
+		int other = GetMoveFrom(list[k]);
+		if(GetMoveTo(list[k]) != to || other == from || pos.GetPiece(other) != piece)
+			continue;
+		if(SquareRank(other) == SquareRank(from))
+		{
+			m_ambiguousMoveFileFlag = TRUE;
+		}
+		else if(SquareFile(other) == SquareFile(from))
+		{
+			m_ambiguousMoveRankFlag = TRUE;
+		}
+		else
+		{
+			m_ambiguousMoveFileFlag = TRUE;
 		}
+		return;
 	}
-	m_point = pt;
 }
 
 void CNetChessView::OnFileGotopgngame() 
 {
 	// TODO: Add your command handler code here
-	if(m_PGNFileData.GetSize() <=0)
+	if((int)m_PGNIndex.GetCount() <=0)
 		return;
 	CGoToPGNGameDlg dlg;
 	dlg.m_PGNFileIndex=m_PGNFileIndex;
-	for(int i=0;i<m_PGNFileData.GetSize();i++)
-	{
-		dlg.m_PGNFileData.Add(m_PGNFileData.GetAt(i));		
-	}
+	dlg.m_PGNIndex = &m_PGNIndex;
 	if(dlg.DoModal() ==IDOK)
 	{
 		m_PGNFileIndex = dlg.m_PGNFileIndex;
@@ -11137,19 +8171,19 @@ void CNetChessView::OnFileLoadfirstgame()
 	// TODO: Add your command handler code here
 	BeginWaitCursor();
 	m_PGNFileIndex=0;
-	if(m_PGNFileData.GetSize() > 0 && m_PGNFileIndex >= 0)
+	if((int)m_PGNIndex.GetCount() > 0 && m_PGNFileIndex >= 0)
 	{
 		Initialize();
-		doPGNRead(m_PGNFileData.GetAt(m_PGNFileIndex),'s');
+		doPGNRead(GetPGNGame(m_PGNFileIndex),'s');
 		if(m_iHistory > -1)
 		{
 			CString str;		
-			str.Format("Loaded %d/%d PGN game",m_PGNFileIndex+1,m_PGNFileData.GetSize());
+			str.Format("Loaded %d/%d PGN game",m_PGNFileIndex+1,(int)m_PGNIndex.GetCount());
 			SetPaneText(MESSAGEPANE,str,1);
 		}
 		else
 		{
-			CString filedata = m_PGNFileData.GetAt(m_PGNFileIndex);
+			CString filedata = GetPGNGame(m_PGNFileIndex);
 			doFENPositionRead(filedata,'F');
 			unsigned char data[1024];
 			memset(data,'\0',1024);
@@ -11161,7 +8195,7 @@ void CNetChessView::OnFileLoadfirstgame()
 			}
 			SendSockData(data,count);
 			CString str;		
-			str.Format("Loaded %d/%d Position",m_PGNFileIndex+1,m_PGNFileData.GetSize());
+			str.Format("Loaded %d/%d Position",m_PGNFileIndex+1,(int)m_PGNIndex.GetCount());
 			SetPaneText(MESSAGEPANE,str,1);
 		}
 	}
@@ -11173,23 +8207,23 @@ void CNetChessView::OnFileLoadnextgame()
 	// TODO: Add your command handler code here
 	BeginWaitCursor();
 	m_PGNFileIndex++;
-	if(m_PGNFileData.GetSize() < m_PGNFileIndex)
+	if((int)m_PGNIndex.GetCount() < m_PGNFileIndex)
 	{
-		m_PGNFileIndex = m_PGNFileData.GetSize();
+		m_PGNFileIndex = (int)m_PGNIndex.GetCount();
 	}
-	if(m_PGNFileData.GetSize() > m_PGNFileIndex && m_PGNFileIndex >=0 )
+	if((int)m_PGNIndex.GetCount() > m_PGNFileIndex && m_PGNFileIndex >=0 )
 	{
 		Initialize();		
-		doPGNRead(m_PGNFileData.GetAt(m_PGNFileIndex),'s');
+		doPGNRead(GetPGNGame(m_PGNFileIndex),'s');
 		if(m_iHistory > -1)
 		{
 			CString str;		
-			str.Format("Loaded %d/%d PGN game",m_PGNFileIndex+1,m_PGNFileData.GetSize());
+			str.Format("Loaded %d/%d PGN game",m_PGNFileIndex+1,(int)m_PGNIndex.GetCount());
 			SetPaneText(MESSAGEPANE,str,1);
 		}
 		else
 		{
-			CString filedata = m_PGNFileData.GetAt(m_PGNFileIndex);
+			CString filedata = GetPGNGame(m_PGNFileIndex);
 			doFENPositionRead(filedata,'F');
 			unsigned char data[1024];
 			memset(data,'\0',1024);
@@ -11201,7 +8235,7 @@ void CNetChessView::OnFileLoadnextgame()
 			}
 			SendSockData(data,count);
 			CString str;		
-			str.Format("Loaded %d/%d Position",m_PGNFileIndex+1,m_PGNFileData.GetSize());
+			str.Format("Loaded %d/%d Position",m_PGNFileIndex+1,(int)m_PGNIndex.GetCount());
 			SetPaneText(MESSAGEPANE,str,1);
 		}
 	}
@@ -11216,123 +8250,40 @@ void CNetChessView::OnFileOpenpgnfile()
 	{
 		DrawBoard();
 		BeginWaitCursor();
-		m_PGNFileIndex=-1;;
-		m_PGNFileData.RemoveAll();
+		m_PGNFileIndex=-1;
 		CString file = fdialog.GetPathName(); 	
-		FILE *fp = fopen(file,"r");
-		if(fp == NULL)
+		CString s ="Loading file " + file;
+		SetPaneText(MESSAGEPANE,s,1);		
+		//FEN and EPD files hold one position per line
+		CString ext = fdialog.GetFileExt();
+		int format = ext.CompareNoCase("FEN") == 0 || ext.CompareNoCase("EPD") == 0 ? GAMEINDEX_LINES : GAMEINDEX_PGN;
+		if(m_PGNIndex.Open(file,format) == false)
 		{
+			EndWaitCursor();
 			CString str;
 			str.Format("Could not open the file %s",file);
 			AfxMessageBox(str);
 			return;
 		}
-		CString tempstr = "";
-		CString s ="Loading file " + file;
-		SetPaneText(MESSAGEPANE,s,1);		
-		if(fdialog.GetFileExt() == "FEN" || fdialog.GetFileExt() == "fen")
-		{
-			while(!feof(fp))
-			{
-				char c;
-				fscanf(fp,"%c",&c);
-				if(c == '\n')
-				{	
-					if(tempstr.GetLength() > 0)
-					{
-						tempstr += (CString)"\r\n";						
-						m_PGNFileData.Add(tempstr);
-						tempstr = "";
-					}
-				}
-				else
-				{
-					tempstr += c;
-				}
-			}
-		}
-		else if(fdialog.GetFileExt() == "EPD" || fdialog.GetFileExt() == "epd")
-		{
-			while(!feof(fp))
-			{
-				char c;
-				fscanf(fp,"%c",&c);
-				if(c == '\n')
-				{						
-					if(tempstr.GetLength() > 0)
-					{
-						tempstr += (CString)"\r\n";						
-						m_PGNFileData.Add(tempstr);
-						tempstr = "";
-					}
-				}
-				else
-				{
-					tempstr += c;
-				}
-			}
-		}
-		else
-		{
-			while(!feof(fp))
-			{
-				char str[255];
-				fscanf(fp,"%s",str);
-				if(str[0] == '*' ||
-					strcmp(str,"0-1") == 0 ||
-					strcmp(str,"1-0") == 0 ||
-					strcmp(str,"1/2-1/2") == 0)
-				{
-					tempstr += (CString)str + "\r\n";
-					m_PGNFileData.Add(tempstr);
-					tempstr = "";
-				}
-				else
-				{
-					if(str[strlen(str)-1] == ']')
-					{
-						tempstr += (CString)str + (CString)"\r\n";
-					}
-					else
-					{     
-					  if(tempstr.IsEmpty())
-					  {
-						   if(str[0] == '[' || str[0] == '1')
-						   {
-							tempstr += (CString)str + (CString)" ";
-						   }
-						   else
-						   {
-							tempstr = m_PGNFileData.GetAt(m_PGNFileData.GetSize()-1);
-							tempstr += (CString)str;
-							m_PGNFileData.RemoveAt(m_PGNFileData.GetSize()-1,1);
-						   }
-					  }
-					  else
-					  {
-							tempstr += (CString)str + (CString)" ";
-					  }
-					}
-				}
-			}		
-		}
+		m_PGNFilePath = file;
+		m_GameBase.Close();
+		m_OpeningTree.Close();
 		CString str;
-		str.Format("Loaded %d games/positions",m_PGNFileData.GetSize(),fdialog.GetPathName());
+		str.Format("Loaded %d games/positions from %s",(int)m_PGNIndex.GetCount(),fdialog.GetPathName());
 		SetPaneText(MESSAGEPANE,str,1);
-		fclose(fp);
 		EndWaitCursor();
 	}
 	/*****************************************
 	 **** This is used for tsting PGN files***
 	 **** do not delete***********************
 	 *****************************************/
-	/*int total = m_PGNFileData.GetSize();	
+	/*int total = m_PGNIndex.GetCount();	
 	for(int i=0;i<total;i++)
 	{
 		char str[1000];;
 		sprintf(str,"Testing game %d from file %s",i,fdialog.GetPathName());
 		writeMessage(str);
-		//doPGNRead(m_PGNFileData.GetAt(i),'s');
+		//doPGNRead(GetPGNGame(i),'s');
 		OnFileLoadnextgame();
 		//Sleep(00);
 	}*/
@@ -11342,19 +8293,19 @@ void CNetChessView::OnFileReloadthepgngame()
 {
 	// TODO: Add your command handler code here
 	BeginWaitCursor();
-	if(m_PGNFileData.GetSize() > 0 && m_PGNFileIndex != -1)
+	if((int)m_PGNIndex.GetCount() > 0 && m_PGNFileIndex != -1)
 	{
 		Initialize();
-		doPGNRead(m_PGNFileData.GetAt(m_PGNFileIndex),'s');
+		doPGNRead(GetPGNGame(m_PGNFileIndex),'s');
 		if(m_iHistory > -1)
 		{
 			CString str;		
-			str.Format("Loaded %d/%d PGN game",m_PGNFileIndex+1,m_PGNFileData.GetSize());
+			str.Format("Loaded %d/%d PGN game",m_PGNFileIndex+1,(int)m_PGNIndex.GetCount());
 			SetPaneText(MESSAGEPANE,str,1);
 		}
 		else
 		{
-			CString filedata = m_PGNFileData.GetAt(m_PGNFileIndex);
+			CString filedata = GetPGNGame(m_PGNFileIndex);
 			doFENPositionRead(filedata,'F');
 			unsigned char data[1024];
 			memset(data,'\0',1024);
@@ -11366,7 +8317,7 @@ void CNetChessView::OnFileReloadthepgngame()
 			}
 			SendSockData(data,count);
 			CString str;		
-			str.Format("Loaded %d/%d Position",m_PGNFileIndex+1,m_PGNFileData.GetSize());
+			str.Format("Loaded %d/%d Position",m_PGNFileIndex+1,(int)m_PGNIndex.GetCount());
 			SetPaneText(MESSAGEPANE,str,1);
 		}
 	}
@@ -11380,19 +8331,19 @@ void CNetChessView::OnFileLoadprevpgngame()
 	m_PGNFileIndex--;
 	if(m_PGNFileIndex <0)
 		m_PGNFileIndex = 0;
-	if(m_PGNFileData.GetSize() > 0 && m_PGNFileIndex != -1)
+	if((int)m_PGNIndex.GetCount() > 0 && m_PGNFileIndex != -1)
 	{
 		Initialize();
-		doPGNRead(m_PGNFileData.GetAt(m_PGNFileIndex),'s');
+		doPGNRead(GetPGNGame(m_PGNFileIndex),'s');
 		if(m_iHistory > -1)
 		{
 			CString str;		
-			str.Format("Loaded %d/%d PGN game",m_PGNFileIndex+1,m_PGNFileData.GetSize());
+			str.Format("Loaded %d/%d PGN game",m_PGNFileIndex+1,(int)m_PGNIndex.GetCount());
 			SetPaneText(MESSAGEPANE,str,1);
 		}
 		else
 		{
-			CString filedata = m_PGNFileData.GetAt(m_PGNFileIndex);
+			CString filedata = GetPGNGame(m_PGNFileIndex);
 			doFENPositionRead(filedata,'F');
 			unsigned char data[1024];
 			memset(data,'\0',1024);
@@ -11404,7 +8355,7 @@ void CNetChessView::OnFileLoadprevpgngame()
 			}
 			SendSockData(data,count);
 			CString str;		
-			str.Format("Loaded %d/%d Position",m_PGNFileIndex+1,m_PGNFileData.GetSize());
+			str.Format("Loaded %d/%d Position",m_PGNFileIndex+1,(int)m_PGNIndex.GetCount());
 			SetPaneText(MESSAGEPANE,str,1);
 		}
 	}
@@ -11415,20 +8366,20 @@ void CNetChessView::OnFileLoadlastgame()
 	// TODO: Add your command handler code here
 		// TODO: Add your command handler code here
 	BeginWaitCursor();
-	m_PGNFileIndex=m_PGNFileData.GetSize()-1;
+	m_PGNFileIndex=(int)m_PGNIndex.GetCount()-1;
 	if(m_PGNFileIndex >= 0)
 	{
 		Initialize();
-		doPGNRead(m_PGNFileData.GetAt(m_PGNFileIndex),'s');
+		doPGNRead(GetPGNGame(m_PGNFileIndex),'s');
 		if(m_iHistory > -1)
 		{
 			CString str;		
-			str.Format("Loaded %d/%d PGN game",m_PGNFileIndex+1,m_PGNFileData.GetSize());
+			str.Format("Loaded %d/%d PGN game",m_PGNFileIndex+1,(int)m_PGNIndex.GetCount());
 			SetPaneText(MESSAGEPANE,str,1);
 		}
 		else
 		{
-			CString filedata = m_PGNFileData.GetAt(m_PGNFileIndex);
+			CString filedata = GetPGNGame(m_PGNFileIndex);
 			doFENPositionRead(filedata,'F');
 			unsigned char data[1024];
 			memset(data,'\0',1024);
@@ -11440,7 +8391,7 @@ void CNetChessView::OnFileLoadlastgame()
 			}
 			SendSockData(data,count);
 			CString str;		
-			str.Format("Loaded %d/%d Position",m_PGNFileIndex+1,m_PGNFileData.GetSize());
+			str.Format("Loaded %d/%d Position",m_PGNFileIndex+1,(int)m_PGNIndex.GetCount());
 			SetPaneText(MESSAGEPANE,str,1);
 		}
 	}
@@ -11451,7 +8402,7 @@ void CNetChessView::OnUpdateFileLoadlastgame(CCmdUI* pCmdUI)
 {
 	// TODO: Add your command update UI handler code here
 	m_observerFlag == TRUE ? pCmdUI->Enable(FALSE) : pCmdUI->Enable(TRUE);	
-	m_PGNFileData.GetSize() > 0 ? pCmdUI->Enable(TRUE) : pCmdUI->Enable(FALSE);
+	(int)m_PGNIndex.GetCount() > 0 ? pCmdUI->Enable(TRUE) : pCmdUI->Enable(FALSE);
 	
 }
 
@@ -11638,7 +8589,7 @@ void CNetChessView::OnUpdateFileGotopgngame(CCmdUI* pCmdUI)
 {
 	// TODO: Add your command update UI handler code here	
 	m_observerFlag == TRUE ? pCmdUI->Enable(FALSE) : pCmdUI->Enable(TRUE);
-	m_PGNFileData.GetSize() > 0 ? pCmdUI->Enable(TRUE) : pCmdUI->Enable(FALSE);
+	(int)m_PGNIndex.GetCount() > 0 ? pCmdUI->Enable(TRUE) : pCmdUI->Enable(FALSE);
 
 }
 
@@ -11646,21 +8597,21 @@ void CNetChessView::OnUpdateFileLoadfirstgame(CCmdUI* pCmdUI)
 {
 	// TODO: Add your command update UI handler code here
 	m_observerFlag == TRUE ? pCmdUI->Enable(FALSE) : pCmdUI->Enable(TRUE);
-	m_PGNFileData.GetSize() > 0 ? pCmdUI->Enable(TRUE) : pCmdUI->Enable(FALSE);
+	(int)m_PGNIndex.GetCount() > 0 ? pCmdUI->Enable(TRUE) : pCmdUI->Enable(FALSE);
 }
 
 void CNetChessView::OnUpdateFileLoadnextgame(CCmdUI* pCmdUI) 
 {
 	// TODO: Add your command update UI handler code here
 	m_observerFlag == TRUE ? pCmdUI->Enable(FALSE) : pCmdUI->Enable(TRUE);
-	m_PGNFileData.GetSize() > 0 ? pCmdUI->Enable(TRUE) : pCmdUI->Enable(FALSE);
+	(int)m_PGNIndex.GetCount() > 0 ? pCmdUI->Enable(TRUE) : pCmdUI->Enable(FALSE);
 }
 
 void CNetChessView::OnUpdateFileLoadprevpgngame(CCmdUI* pCmdUI) 
 {
 	// TODO: Add your command update UI handler code here
 	m_observerFlag == TRUE ? pCmdUI->Enable(FALSE) : pCmdUI->Enable(TRUE);
-	m_PGNFileData.GetSize() > 0 ? pCmdUI->Enable(TRUE) : pCmdUI->Enable(FALSE);
+	(int)m_PGNIndex.GetCount() > 0 ? pCmdUI->Enable(TRUE) : pCmdUI->Enable(FALSE);
 }
 
 
@@ -11680,7 +8631,7 @@ void CNetChessView::OnUpdateFileReloadthepgngame(CCmdUI* pCmdUI)
 {
 	// TODO: Add your command update UI handler code here
 	m_observerFlag == TRUE ? pCmdUI->Enable(FALSE) : pCmdUI->Enable(TRUE);
-	m_PGNFileData.GetSize() > 0 ? pCmdUI->Enable(TRUE) : pCmdUI->Enable(FALSE);	
+	(int)m_PGNIndex.GetCount() > 0 ? pCmdUI->Enable(TRUE) : pCmdUI->Enable(FALSE);	
 }
 
 void CNetChessView::OnUpdateFileSubmitpgndata(CCmdUI* pCmdUI) 
@@ -11710,14 +8661,6 @@ void CNetChessView::OnUpdateViewDemoGoto(CCmdUI* pCmdUI)
 void CNetChessView::OnFileSaveboard() 
 {
 	// TODO: Add your command handler code here
-	int flipflag = FALSE;
-	if(m_white_on_top == true)
-	{
-		flipflag = TRUE;
-		FlipBoard();
-		m_white_on_top = false;
-	}
-
 	CFileDialog fdialog(FALSE);
 	CString boardstate="";
 	if(fdialog.DoModal() == IDOK)
@@ -11751,12 +8694,6 @@ void CNetChessView::OnFileSaveboard()
 		fprintf(fp,"%s",boardstate.GetBuffer(0));
 		fclose(fp);
 	}
-	if(flipflag == TRUE)
-	{
-		flipflag = FALSE;
-		FlipBoard();
-		m_white_on_top = true;
-	}
 }
 
 void CNetChessView::OnUpdateFileSaveboard(CCmdUI* pCmdUI) 
@@ -11843,6 +8780,78 @@ void CNetChessView::OnUpdateViewObserverslist(CCmdUI* pCmdUI)
 	m_pServerSocket == NULL ? pCmdUI->Enable(0) : pCmdUI->Enable(1);
 }
 
+//only the first few bad games are listed in the message window
+#define CHECKPGN_MAX_LISTED	100
+//games a move of a book made from a PGN file is played in at least
+#define BOOK_MIN_GAMES	2
+
+//state of a CPGNPipeline run started from the view on a worker thread
+struct PIPELINEPROGRESS
+{
+	CNetChessView *view;
+	CPGNPipeline *pipeline;
+	const char *action;
+	int listed;
+	DWORD start;
+	DWORD shown;
+	//the file run, or the opening tree built from it when tree is set and
+	//the Polyglot book made from the tree when book is also set
+	const char *path;
+	int format;
+	COpeningTree *tree;
+	const char *book;
+	BOOL ok;
+};
+
+//games done, share of the file read and speed of a pipeline run
+static CString GetPipelineProgressString(const char *action, CPGNPipeline &pipeline, DWORD start)
+{
+	double seconds = max(GetTickCount() - start,1) / 1000.0;
+	CString str;
+	str.Format("%s %u games, %d%%, %.1f MB/s, %.0f games/s",action,pipeline.GetGames(),
+		pipeline.GetSize() > 0 ? (int)(pipeline.GetBytes() * 100 / pipeline.GetSize()) : 0,
+		pipeline.GetBytes() / seconds / (1024 * 1024),pipeline.GetGames() / seconds);
+	return str;
+}
+
+//called on the worker thread, so the view is told by posted messages
+static void PipelineGame(const PGNGAMERESULT &result, void *param)
+{
+	PIPELINEPROGRESS *progress = (PIPELINEPROGRESS *)param;
+	if(result.error != PGNERROR_NONE && progress->listed < CHECKPGN_MAX_LISTED)
+	{
+		progress->listed++;
+		CString str;
+		str.Format("Game %u line %u column %u: %s '%s'",result.game+1,result.errorLine,
+			result.errorColumn,CPGNPipeline::GetErrorString(result.error),result.errorText);
+		progress->view->PostProgress(str,PROGRESS_LOG);
+	}
+	DWORD now = GetTickCount();
+	if(now - progress->shown >= 500)
+	{
+		progress->shown = now;
+		progress->view->PostProgress(GetPipelineProgressString(progress->action,*progress->pipeline,
+			progress->start),(int)progress->pipeline->GetGames());
+	}
+}
+
+//the worker thread of a pipeline run, see RunWorker
+static void RunPipeline(void *param)
+{
+	PIPELINEPROGRESS *progress = (PIPELINEPROGRESS *)param;
+	if(progress->tree == NULL)
+		progress->ok = progress->pipeline->Run(progress->path,progress->format,0,PipelineGame,progress);
+	else
+	{
+		progress->ok = progress->tree->Open(progress->path,*progress->pipeline,0,PipelineGame,progress);
+		if(progress->ok && progress->book != NULL)
+			progress->ok = CPolyglotBook::Build(*progress->tree,progress->book,BOOK_MIN_GAMES);
+	}
+}
+
+//Converts the whole loaded file to the format of the file named in the
+//dialog. The games are read, replayed and written by a CPGNPipeline on
+//every core; the board is not used.
 void CNetChessView::OnFileConvert() 
 {
 	// TODO: Add your command handler code here
@@ -11851,43 +8860,54 @@ void CNetChessView::OnFileConvert()
 		AfxMessageBox("This feature is not supported in Client/Server mode!");
 		return;
 	}
-	//OnFileOpenpgnfile();
-	if( m_PGNFileData.GetSize() <= 0 )
+	if( (int)m_PGNIndex.GetCount() <= 0 || m_PGNFilePath.IsEmpty())
 	{
 		AfxMessageBox("No files are loaded");
 		return;
 	}
-	CString m_backupfileName="";
-	if(m_fileName.GetLength() > 0)
-	{
-		m_backupfileName = m_fileName;
-		m_optDlg.m_check_auto_save = FALSE;
-		KillTimer(SAVE_TIMER_EVENT_ID);
-	}
 
 	CConvertDlg dlg;
-	if(dlg.DoModal() ==IDOK)
+	if(dlg.DoModal() !=IDOK)
+		return;
+	CString ext = dlg.m_edit_filename.Right(3);
+	int output = ext.CompareNoCase("FEN") == 0 ? PGNOUTPUT_FEN :
+		ext.CompareNoCase("EPD") == 0 ? PGNOUTPUT_EPD : PGNOUTPUT_PGN;
+	FILE *fp = fopen(dlg.m_edit_filename,"w");
+	if(fp == NULL)
 	{
-		CleanWindow();
-		m_convertFlag = TRUE;
-		int total = m_PGNFileData.GetSize();	
-		m_PGNFileIndex = 0;
-		for(int i=0;i<total;i++)
-		{
-			CString str;
-			str.Format("Converting %d game and saving in %s filefile %s",i,dlg.m_edit_filename);
-			SetPaneText(MESSAGEPANE,str,1);			
-			OnFileLoadnextgame();
-			m_fileName.Format("%s%d.%s",
-				dlg.m_edit_filename.Left(dlg.m_edit_filename.GetLength() - 4),
-				m_PGNFileIndex+1,dlg.m_edit_filename.Right(3));
-			OnFileSave();			
-		}
 		CString str;
-		str.Format("Converted %d/%d games",m_PGNFileIndex,total);
-		SetPaneText(MESSAGEPANE,str,1);
+		str.Format("Could not open the file %s",dlg.m_edit_filename);
+		AfxMessageBox(str);
+		return;
 	}
+	int index = m_PGNFileIndex;
+	m_PGNFileIndex = 0;
+	m_convertFlag = TRUE;
+	DrawBoard();
+	CPGNPipeline pipeline;
+	pipeline.SetOutput(output,fp);
+	PIPELINEPROGRESS progress = {this,&pipeline,"Converted",0,GetTickCount(),GetTickCount(),
+		m_PGNFilePath,m_PGNIndex.GetFormat(),NULL,NULL,FALSE};
+	RunWorker(RunPipeline,&progress);
+	BOOL ok = progress.ok;
+	fclose(fp);
 	m_convertFlag = FALSE;
+	m_PGNFileIndex = index;
+	if(!ok)
+	{
+		CString str;
+		str.Format("Could not open the file %s",m_PGNFilePath);
+		AfxMessageBox(str);
+	}
+	else
+	{
+		double seconds = max(GetTickCount() - progress.start,1) / 1000.0;
+		CString str;
+		str.Format("Converted %u games in %.1f s (%.0f games/s), %u left out with errors, to %s",
+			pipeline.GetGames() - pipeline.GetErrors(),seconds,pipeline.GetGames() / seconds,
+			pipeline.GetErrors(),dlg.m_edit_filename);
+		SetPaneText(MESSAGEPANE,str,1);
+	}
 	DrawBoard();
 }
 
@@ -11900,18 +8920,473 @@ void CNetChessView::OnEditComment()
 		return;
 	}
 	CCommentDlg dlg;
-	dlg.m_edit_comment = m_History[m_iHistory].GetComment();
+	dlg.m_edit_comment = m_History.GetComment(m_iHistory);
 	if(dlg.DoModal() == IDOK)
 	{
-		m_History[m_iHistory].SetComment(dlg.m_edit_comment.GetBuffer(0));
+		m_History.SetComment(m_iHistory,dlg.m_edit_comment);
+	}
+}
+
+//milliseconds an engine searches each position of a game being annotated
+#define ANNOTATE_MOVE_TIME		1000
+//and waits for the move past that
+#define ANNOTATE_MOVE_MARGIN	1000
+
+//a CGameAnnotator run on a worker thread while the view shows its progress
+struct ANNOTATERUN
+{
+	CNetChessView *view;
+	CGameAnnotator *annotator;
+	CPosition start;
+	std::vector<CHESSMOVE> moves;
+	int threads;
+	DWORD startTime;
+	BOOL started;
+};
+
+//called on a pool thread, so the view is told by a posted message
+static void AnnotateProgress(int done, int count, void *param)
+{
+	ANNOTATERUN *run = (ANNOTATERUN *)param;
+	CString str;
+	str.Format("Annotating: %d of %d positions, %.1f s",done,count,(GetTickCount() - run->startTime) / 1000.0);
+	run->view->PostProgress(str,done);
+}
+
+//the worker thread of the annotation, see RunWorker
+static void AnnotateGame(void *param)
+{
+	ANNOTATERUN *run = (ANNOTATERUN *)param;
+	run->started = run->annotator->Run(run->start,run->moves,run->threads);
+}
+
+//Evaluates every ply of the game with the engine of either side (or one
+//picked for it), one engine process per core, and adds the evaluation and
+//the engine's line to the comment of each move, with a NAG for the
+//inaccuracies, mistakes and blunders.
+void CNetChessView::OnEditAnnotategame() 
+{
+	ENGINECONFIG config;
+	CEngine &engine = m_whiteEngine.m_engineFile.GetLength() > 0 ? m_whiteEngine : m_blackEngine;
+	if(engine.m_engineFile.GetLength() > 0)
+	{
+		config.command = (LPCTSTR)engine.m_engineFile;
+		int protocol = engine.m_engineConfigDlg.m_chessProtocol;
+		config.protocol = protocol == UCI_I || protocol == UCI_II ? ENGINEPROTOCOL_UCI :
+			protocol == WB_I || protocol == WB_II ? ENGINEPROTOCOL_WINBOARD : ENGINEPROTOCOL_AUTO;
+	}
+	else
+	{
+		CFileDialog fdialog(TRUE,"exe",NULL,OFN_FILEMUSTEXIST | OFN_HIDEREADONLY,"Engines (*.exe)|*.exe||");
+		if(fdialog.DoModal() != IDOK)
+			return;
+		config.command = (LPCTSTR)fdialog.GetPathName();
+		config.protocol = ENGINEPROTOCOL_AUTO;
+	}
+	config.name = config.command;
+
+	//the moves from the start of the record up to a manual edit
+	ANNOTATERUN run;
+	if(m_History.RestorePosition(0,run.start) != 0)
+	{
+		AfxMessageBox("Move history not available");
+		return;
+	}
+	for(int i = 0; i <= m_topHistory && m_History[i].IsManualEdit() == FALSE; i++)
+		run.moves.push_back(m_History[i].GetMove());
+	if(run.moves.empty())
+	{
+		AfxMessageBox("Move history not available");
+		return;
+	}
+
+	CGameAnnotator annotator;
+	annotator.SetEngine(config);
+	ENGINELIMITS limits;
+	memset(&limits,0,sizeof(limits));
+	limits.moveTime = ANNOTATE_MOVE_TIME;
+	annotator.SetLimits(limits,ANNOTATE_MOVE_TIME + ANNOTATE_MOVE_MARGIN);
+	annotator.SetProgressProc(AnnotateProgress,&run);
+	run.view = this;
+	run.annotator = &annotator;
+	run.threads = max((int)std::thread::hardware_concurrency(),1);
+	run.startTime = GetTickCount();
+	run.started = FALSE;
+	SetPaneText(MESSAGEPANE,"Annotating the game",0);
+	RunWorker(AnnotateGame,&run);
+	if(run.started == FALSE)
+	{
+		CString str;
+		str.Format("Could not start %s",config.command.c_str());
+		AfxMessageBox(str);
+		return;
+	}
+
+	//merged with the comments the moves have
+	int marked = 0;
+	for(int i = 0; i < (int)run.moves.size(); i++)
+	{
+		PLYANNOTATION annotation;
+		annotator.GetAnnotation(i,annotation);
+		if(annotation.nag > 0)
+		{
+			m_History.SetNAG(i,annotation.nag);
+			marked++;
+		}
+		if(annotation.comment.empty())
+			continue;
+		CString comment = m_History.GetComment(i);
+		if(comment.GetLength() > 0)
+			comment += " ";
+		m_History.SetComment(i,comment + annotation.comment.c_str());
 	}
+	CString str;
+	str.Format("Annotated %d plies in %.1f s with %d engines, %d moves marked",(int)run.moves.size(),
+		(GetTickCount() - run.startTime) / 1000.0,run.threads,marked);
+	SetPaneText(MESSAGEPANE,str,1);
+	DrawBoard();
+}
+
+void CNetChessView::OnUpdateEditAnnotategame(CCmdUI* pCmdUI) 
+{
+	pCmdUI->Enable(m_topHistory >= 0);
 }
 
 void CNetChessView::OnUpdateFileConvert(CCmdUI* pCmdUI) 
 {
 	// TODO: Add your command update UI handler code here
 	m_observerFlag == TRUE ? pCmdUI->Enable(FALSE) : pCmdUI->Enable(TRUE);	
-	m_PGNFileData.GetSize() > 0 ? pCmdUI->Enable(TRUE) : pCmdUI->Enable(FALSE);	
+	(int)m_PGNIndex.GetCount() > 0 ? pCmdUI->Enable(TRUE) : pCmdUI->Enable(FALSE);	
+}
+
+//moves of the opening tree shown after a move
+#define OPENINGTREE_SHOWN	4
+
+void CNetChessView::OnFileCheckpgnfile() 
+{
+	if(m_PGNIndex.GetCount() <= 0 || m_PGNFilePath.IsEmpty())
+	{
+		AfxMessageBox("No files are loaded");
+		return;
+	}
+	SetPaneText(MESSAGEPANE,"Checking " + m_PGNFilePath,1);
+	CPGNPipeline pipeline;
+	PIPELINEPROGRESS progress = {this,&pipeline,"Checked",0,GetTickCount(),GetTickCount(),
+		m_PGNFilePath,m_PGNIndex.GetFormat(),NULL,NULL,FALSE};
+	RunWorker(RunPipeline,&progress);
+	BOOL ok = progress.ok;
+	DWORD elapsed = GetTickCount() - progress.start;
+	if(!ok)
+	{
+		CString str;
+		str.Format("Could not open the file %s",m_PGNFilePath);
+		AfxMessageBox(str);
+		return;
+	}
+	CString str;
+	str.Format("Checked %u games, %u with errors, in %.1f s",pipeline.GetGames(),
+		pipeline.GetErrors(),elapsed/1000.0);
+	SetPaneText(MESSAGEPANE,str,1);
+}
+
+void CNetChessView::OnUpdateFileCheckpgnfile(CCmdUI* pCmdUI) 
+{
+	pCmdUI->Enable(m_PGNIndex.GetCount() > 0);
+}
+
+//a CGameBase built on a worker thread while the view shows its progress
+struct GAMEBASERUN
+{
+	CNetChessView *view;
+	CGameBase *base;
+	CString path;
+	DWORD startTime;
+	BOOL opened;
+};
+
+//called on the worker thread, so the view is told by a posted message
+static void GameBaseProgress(unsigned int games, unsigned long long offset, unsigned long long size, void *param)
+{
+	GAMEBASERUN *run = (GAMEBASERUN *)param;
+	CString str;
+	str.Format("Building the game database: %u games, %.0f%%, %.1f s",games,
+		size > 0 ? 100.0 * offset / size : 100.0,(GetTickCount() - run->startTime) / 1000.0);
+	run->view->PostProgress(str,(int)games);
+}
+
+//the worker thread of the database build, see RunWorker
+static void OpenGameBase(void *param)
+{
+	GAMEBASERUN *run = (GAMEBASERUN *)param;
+	run->opened = run->base->Open(run->path,GameBaseProgress,run) ? TRUE : FALSE;
+}
+
+//Looks the board position up in the database of the loaded PGN file, which
+//is built the first time. The games found are browsed in the Goto Game
+//dialog and the one picked is loaded at the ply where it reached the position.
+void CNetChessView::OnFileFindposition() 
+{
+	if(m_PGNIndex.GetCount() <= 0 || m_PGNFilePath.IsEmpty() || m_PGNIndex.GetFormat() != GAMEINDEX_PGN)
+	{
+		AfxMessageBox("No PGN files are loaded");
+		return;
+	}
+	if(!m_GameBase.IsOpen())
+	{
+		GAMEBASERUN run;
+		run.view = this;
+		run.base = &m_GameBase;
+		run.path = m_PGNFilePath;
+		run.startTime = GetTickCount();
+		run.opened = FALSE;
+		SetPaneText(MESSAGEPANE,"Building the game database of " + m_PGNFilePath,1);
+		RunWorker(OpenGameBase,&run);
+		if(run.opened == FALSE)
+		{
+			CString str;
+			str.Format("Could not build the game database of %s",m_PGNFilePath);
+			AfxMessageBox(str);
+			return;
+		}
+	}
+	BeginWaitCursor();
+	std::vector<GAMEBASEHIT> hits;
+	DWORD start = GetTickCount();
+	unsigned long long total = m_GameBase.FindPosition(m_position.GetKey(),hits);
+	DWORD elapsed = GetTickCount() - start;
+	EndWaitCursor();
+	CString str;
+	str.Format("%u of %u games reached this position (%u ms)",(unsigned int)total,m_GameBase.GetCount(),elapsed);
+	SetPaneText(MESSAGEPANE,str,1);
+	if(hits.empty())
+		return;
+	CGoToPGNGameDlg dlg;
+	dlg.m_PGNIndex = &m_PGNIndex;
+	dlg.m_hits = &hits;
+	if(dlg.DoModal() ==IDOK)
+	{
+		const GAMEBASEHIT &hit = hits[dlg.m_PGNFileIndex];
+		m_PGNFileIndex = (int)hit.game;
+		OnFileReloadthepgngame();
+		if(m_iHistory > -1)
+			GoToPly((int)hit.ply - 1);
+	}
+}
+
+void CNetChessView::OnUpdateFileFindposition(CCmdUI* pCmdUI) 
+{
+	pCmdUI->Enable(m_PGNIndex.GetCount() > 0 && m_PGNIndex.GetFormat() == GAMEINDEX_PGN);
+}
+
+//Switches the opening tree of the loaded PGN file on or off, building it on
+//all cores the first time. While it is on every move shows the moves played
+//from the new position.
+void CNetChessView::OnFileOpeningtree() 
+{
+	if(m_OpeningTree.IsOpen())
+	{
+		m_OpeningTree.Close();
+		SetPaneText(MESSAGEPANE,"Opening tree is off",1);
+		return;
+	}
+	if(m_PGNIndex.GetCount() <= 0 || m_PGNFilePath.IsEmpty() || m_PGNIndex.GetFormat() != GAMEINDEX_PGN)
+	{
+		AfxMessageBox("No PGN files are loaded");
+		return;
+	}
+	SetPaneText(MESSAGEPANE,"Opening tree of " + m_PGNFilePath,1);
+	CPGNPipeline pipeline;
+	PIPELINEPROGRESS progress = {this,&pipeline,"Read",0,GetTickCount(),GetTickCount(),
+		m_PGNFilePath,GAMEINDEX_PGN,&m_OpeningTree,NULL,FALSE};
+	RunWorker(RunPipeline,&progress);
+	BOOL ok = progress.ok;
+	if(!ok)
+	{
+		CString str;
+		str.Format("Could not build the opening tree of %s",m_PGNFilePath);
+		AfxMessageBox(str);
+		return;
+	}
+	SetPaneText(MESSAGEPANE,GetOpeningTreeString(),1);
+}
+
+void CNetChessView::OnUpdateFileOpeningtree(CCmdUI* pCmdUI) 
+{
+	pCmdUI->Enable(m_OpeningTree.IsOpen() || (m_PGNIndex.GetCount() > 0 && m_PGNIndex.GetFormat() == GAMEINDEX_PGN));
+	pCmdUI->SetCheck(m_OpeningTree.IsOpen());
+}
+
+//"Tree: 1234 games, e4 560 54% 2450, ..." for the board position: the
+//most played moves with their games, the score of the side playing them
+//and the average rating of who played them
+CString CNetChessView::GetOpeningTreeString()
+{
+	std::vector<OPENINGTREEENTRY> moves;
+	unsigned int games = m_OpeningTree.Find(m_position.GetKey(),moves);
+	CString str;
+	str.Format("Tree: %u games",games);
+	CPosition pos = m_position;
+	for(int i = 0; i < (int)moves.size() && i < OPENINGTREE_SHOWN; i++)
+	{
+		char san[MAX_SAN];
+		FormatSAN(pos,moves[i].move,san);
+		CString move;
+		move.Format(", %s %u %d%%",san,moves[i].games,
+			moves[i].scored > 0 ? (int)((50 * moves[i].points + moves[i].scored / 2) / moves[i].scored) : 0);
+		str += move;
+		if(moves[i].rated > 0)
+		{
+			move.Format(" %u",(unsigned int)(moves[i].ratings / moves[i].rated));
+			str += move;
+		}
+	}
+	return str;
+}
+
+//Switches the opening book on or off. A PGN file is made into <file>.bin
+//from its opening tree first, keeping the moves played in at least
+//BOOK_MIN_GAMES games.
+void CNetChessView::OnFileOpeningbook() 
+{
+	if(m_book.IsOpen())
+	{
+		m_book.Close();
+		SetPaneText(MESSAGEPANE,"Opening book is off",1);
+		return;
+	}
+	CFileDialog fdialog(TRUE,"bin",NULL,OFN_FILEMUSTEXIST | OFN_HIDEREADONLY,
+		"Polyglot books (*.bin)|*.bin|PGN files (*.pgn)|*.pgn|All files (*.*)|*.*||");
+	if(fdialog.DoModal() != IDOK)
+		return;
+	CString file = fdialog.GetPathName();
+	if(fdialog.GetFileExt() == "PGN" || fdialog.GetFileExt() == "pgn")
+	{
+		CString book = file.Left(file.GetLength() - 3) + "bin";
+		SetPaneText(MESSAGEPANE,"Opening book from " + file,1);
+		COpeningTree tree;
+		CPGNPipeline pipeline;
+		PIPELINEPROGRESS progress = {this,&pipeline,"Read",0,GetTickCount(),GetTickCount(),
+			file,GAMEINDEX_PGN,&tree,book,FALSE};
+		RunWorker(RunPipeline,&progress);
+		BOOL ok = progress.ok;
+		if(!ok)
+		{
+			CString str;
+			str.Format("Could not build an opening book from %s",file);
+			AfxMessageBox(str);
+			return;
+		}
+		file = book;
+	}
+	if(!m_book.Open(file))
+	{
+		CString str;
+		str.Format("%s is not a Polyglot book",file);
+		AfxMessageBox(str);
+		return;
+	}
+	CString str;
+	str.Format("Opening book %s, %I64u moves",file,m_book.GetCount());
+	SetPaneText(MESSAGEPANE,str,1);
+}
+
+void CNetChessView::OnUpdateFileOpeningbook(CCmdUI* pCmdUI) 
+{
+	pCmdUI->SetCheck(m_book.IsOpen());
+}
+
+//Switches the endgame tablebases on or off. Picking any table file uses
+//every table in its folder.
+void CNetChessView::OnFileTablebases() 
+{
+	if(m_tablebase.IsOpen())
+	{
+		m_tablebase.Close();
+		SetPaneText(MESSAGEPANE,"Tablebases are off",1);
+		return;
+	}
+	CFileDialog fdialog(TRUE,"nctb",NULL,OFN_FILEMUSTEXIST | OFN_HIDEREADONLY,
+		"Tablebases (*.nctb)|*.nctb||");
+	if(fdialog.DoModal() != IDOK)
+		return;
+	CString file = fdialog.GetPathName();
+	m_tablebase.SetPath(file.Left(file.ReverseFind('\\')));
+	CString info = GetTablebaseString();
+	SetPaneText(MESSAGEPANE,info.IsEmpty() ? "Tablebases in " + (CString)m_tablebase.GetPath() : info,1);
+}
+
+void CNetChessView::OnUpdateFileTablebases(CCmdUI* pCmdUI) 
+{
+	pCmdUI->SetCheck(m_tablebase.IsOpen());
+}
+
+//"TB: White wins, DTZ 23, Qd5" for the board position: the result, the
+//plies to the next capture or pawn move and the move that keeps it.
+//Empty when the position is not in the tables.
+CString CNetChessView::GetTablebaseString()
+{
+	if(!m_tablebase.IsOpen())
+		return "";
+	CPosition pos = m_position;
+	int wdl, dtz;
+	CHESSMOVE move = m_tablebase.GetBestMove(pos,wdl,dtz);
+	if(move == NULL_MOVE && !m_tablebase.ProbeDTZ(pos,wdl,dtz))
+		return "";
+	CString str;
+	if(wdl == TBWDL_DRAW)
+		str = "TB: draw";
+	else
+		str.Format("TB: %s wins, DTZ %d",(wdl == TBWDL_WIN) == (pos.GetSide() == SIDE_WHITE) ? "White" : "Black",dtz);
+	if(move != NULL_MOVE)
+	{
+		char san[MAX_SAN];
+		FormatSAN(pos,move,san);
+		str += ", ";
+		str += san;
+	}
+	return str;
+}
+
+//Plays a move of the book for the engine to move instead of asking it,
+//move being what the engine would have been sent. A WinBoard engine is
+//put in force mode and sent both moves so its board stays in step; a UCI
+//engine is sent the whole game with its next move anyway.
+BOOL CNetChessView::PlayBookMove(CEngine &engine,CString move)
+{
+	if(!m_book.IsOpen())
+		return FALSE;
+	CHESSMOVE bookmove = m_book.PickMove(m_position,(rand() << 1 | (rand() & 1)) & 0xffff);
+	if(bookmove == NULL_MOVE)
+		return FALSE;
+	char str[8];
+	FormatLongAlgebraic(bookmove,str);
+	if(engine.m_engineConfigDlg.m_chessProtocol == WB_I ||
+		engine.m_engineConfigDlg.m_chessProtocol == WB_II)
+	{
+		if(engine.m_forceFlag == FALSE)
+		{
+			engine.WriteToEngine("force");
+			engine.m_forceFlag = TRUE;
+		}
+		engine.WriteToEngine(move);
+		engine.WriteToEngine(str);
+	}
+	PostEngineMessage(CHECK_MOVE,str);
+	return TRUE;
+}
+
+//sends the engine to move the opponent's move, or plays its book move
+void CNetChessView::WriteEngineMove(CEngine &engine,CString move)
+{
+	if(PlayBookMove(engine,move))
+		return;
+	engine.WriteToEngine(move);
+	//out of book, the engine in force mode has to be told to think
+	if(engine.m_forceFlag == TRUE)
+	{
+		engine.WriteToEngine("go");
+		engine.m_forceFlag = FALSE;
+	}
 }
 void CNetChessView::CleanWindow()
 {
@@ -11959,7 +9434,7 @@ BOOL CNetChessView::OnCommand(WPARAM wParam,LPARAM lParam)
 				text.Replace("\r\n"," ");
 				text.Replace("\n", " ");
 				text.Replace("\t", " ");
-				m_History[m_iHistory].SetComment(text);
+				m_History.SetComment(m_iHistory,text);
 				SetPaneText(MESSAGEPANE,"Comment set to recent played move",1);
 			}
 			else
@@ -12508,7 +9983,10 @@ void CNetChessView::OnToolsWhiteengineLog()
 	dlg->m_pEngine = &m_whiteEngine;
 	//dlg.DoModal();
 	if(m_whiteEngine.m_engineFile.GetLength() > 0)
-		dlg->SetWindowText("WHITE: " + m_whiteEngine.m_engineFile);
+	{
+		dlg->m_title = "WHITE: " + m_whiteEngine.m_engineFile;
+		dlg->SetWindowText(dlg->m_title);
+	}
 	dlg->ShowWindow(SW_SHOW);
 	dlg->UpdateData(FALSE);
 	/*CEngineLogDlg dlg;
@@ -12533,7 +10011,10 @@ void CNetChessView::OnToolsBlackengineLog()
 	dlg->m_edit_engine_log = m_blackEngine.m_engineLog;
 	dlg->m_pEngine = &m_blackEngine;
 	if(m_blackEngine.m_engineFile.GetLength() > 0)
-		dlg->SetWindowText("BLACK: " +m_blackEngine.m_engineFile);
+	{
+		dlg->m_title = "BLACK: " + m_blackEngine.m_engineFile;
+		dlg->SetWindowText(dlg->m_title);
+	}
 	//dlg.DoModal();
 	dlg->ShowWindow(SW_SHOW);
 	dlg->UpdateData(FALSE);
@@ -13247,42 +10728,23 @@ void CNetChessView::OnUpdateViewLearning(CCmdUI* pCmdUI)
 }
 void CNetChessView::SetLearning(int flag)
 {
-	int flipflag = FALSE;
-	if(m_white_on_top == true)
-	{
-		m_white_on_top = false;
-		m_point.x = 7 - m_point.x;
-		m_point.y = 7 - m_point.y;
-		FlipBoard();
-		flipflag = TRUE;						
-	}
 	if(flag == TRUE)	
 	{
-		for(int i=0;i<8;i++)
+		//mark every legal destination of the selected piece
+		CPosition pos = m_position;
+		int from = GetBoardSquare(m_point.x,m_point.y);
+		if(pos.GetPiece(from) == NO_PIECE)
+			return;
+		pos.SetSide(PieceSide(pos.GetPiece(from)));
+		CMoveList list;
+		GenerateLegalMoves(pos,list);
+		for(int k = 0;k<list.GetSize();k++)
 		{
-			for(int j = 0;j<8;j++)
+			if(GetMoveFrom(list[k]) == from)
 			{
-				if(cb[i][j].GetPieceColor() != cb[m_point.x][m_point.y].GetPieceColor())
-				{
-					bool tempblackKingMoveFlag = m_blackKingMovedFlag;
-					bool tempwhiteKingMoveFlag = m_whiteKingMovedFlag;
-					if(flipflag == TRUE)
-					{
-						if(CheckValidMove(i,j) == true)
-						{
-							cb[7-i][7-j].SetLearningFlag( TRUE );
-						}
-					}
-					else
-					{
-						if(CheckValidMove(i,j) == true)
-						{
-							cb[i][j].SetLearningFlag( TRUE );
-						}
-					}
-					m_blackKingMovedFlag = tempblackKingMoveFlag;
-					m_whiteKingMovedFlag = tempwhiteKingMoveFlag;
-				}
+				int i,j;
+				GetBoardCell(GetMoveTo(list[k]),i,j);
+				cb[i][j].SetLearningFlag( TRUE );
 			}
 		}
 	}
@@ -13296,13 +10758,6 @@ void CNetChessView::SetLearning(int flag)
 			}
 		}
 	}
-	if(flipflag == TRUE)
-	{
-		m_white_on_top = true;
-		m_point.x = 7 - m_point.x;
-		m_point.y = 7 - m_point.y;		
-		FlipBoard();		
-	}
 }
 
 void CNetChessView::OnEditEntermove() 
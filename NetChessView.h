@@ -11,8 +11,15 @@
 
 #include "resource.h"
 #include "ChessBoard.h"
+#include "MoveGen.h"
 #include "Options.h"
 #include "History.h"
+#include "GameIndex.h"
+#include "GameBase.h"
+#include "OpeningTree.h"
+#include "PolyglotBook.h"
+#include "Tablebase.h"
+#include "MatchStats.h"
 #include "PickPieceDlg.h"
 #include "NetChessDoc.h"
 #include "Engine.h"
@@ -25,6 +32,7 @@
 #include "TimeControlDlg.h"
 #include "GroupButton.h"
 #include "ICSMessageChatDlg.h"
+class CPGNPipeline;
 typedef CTypedPtrList<CPtrList,CAsyncSocket*> CClientSocketList;
 
 //ICS Style format
@@ -131,7 +139,8 @@ public:
 	bool m_timerFlag;	 
 	COptions m_optDlg;
 	CChessBoard cb[16][16];
-	CHistory  m_History[MAXHISTORY];
+	CPosition m_position;
+	CGameRecord m_History;
 	int m_iHistory; 
 	CPickPieceDlg *m_pickPieceDlg;
 	int m_checkmove;
@@ -146,8 +155,28 @@ public:
 	int m_blackAsEngineFlag;
 	int m_mailClientFlag;
 	CString m_fileName;
-	CStringArray m_PGNFileData;
+	CGameIndex m_PGNIndex;
+	//database of m_PGNFilePath, opened by the first position search
+	CGameBase m_GameBase;
+	//opening tree of m_PGNFilePath while it is switched on
+	COpeningTree m_OpeningTree;
+	//book the engines play from while it is switched on
+	CPolyglotBook m_book;
+	//endgame tables in the folder picked, while switched on
+	CTablebase m_tablebase;
+	//results of the engine against engine games between m_matchEngines,
+	//counted for the first of them
+	CMatchStats m_matchStats;
+	CString m_matchEngines[2];
+	//ply and position of the last result counted
+	int m_matchResultPly;
+	BITBOARD m_matchResultKey;
+	CString m_PGNFilePath;
 	int m_PGNFileIndex;
+	//comments ("{...") and variations ("(...") doPGNRead finds in the
+	//movetext, with the number of moves read before each
+	CStringArray m_PGNAnnotations;
+	CArray<int,int> m_PGNAnnotationMoves;
 	//CString m_PGNEvent,m_PGNSite, m_PGNRound, m_PGNDate, m_PGNWhite,m_PGNBlack, m_PGNResult, m_FENString;
 	CPGNGameInfoDlg m_gameInfoDlg;
 	int  m_observerFlag;
@@ -185,6 +214,19 @@ public:
 	void HandleData(unsigned char* data, int length, int flag);
 	void SendSockData(unsigned char *data,int length);
 	bool CheckValidMove(int,int);
+	int GetBoardSquare(int i, int j);
+	void GetBoardCell(int sq, int &i, int &j);
+	void GetBoardPosition(CPosition &pos);
+	void SetPositionFromBoard();
+	void SetBoardFromPosition();
+	void MakePositionMove(CHESSMOVE move);
+	void SetMovedRects();
+	void GoToPly(int ply);
+	int GetRepetitionCount();
+	BOOL CheckDrawAdjudication();
+	void CheckTablebaseAdjudication();
+	CString RecordMatchResult(int whiteHalfPoints,CString text);
+	void ShowAnalysis();
 	void KillTimerEvent();
 	void OnEditRedoAction(int redraw);
 	void OnEditUndoAction(int redraw);
@@ -208,7 +250,13 @@ public:
 	void ConnectToICSServer();
 	BOOL OnCommand(WPARAM wParam,LPARAM lParam);
 	void OnMessageColorData(WPARAM wParam,LPARAM lParam);
-	void OnMyEngineMessage(WPARAM wParam,LPARAM lParam);
+	void OnMyEngineMessage(int command,CString text);
+	void PostEngineMessage(int command,CString text);
+	afx_msg LRESULT OnEngineMessage(WPARAM wParam,LPARAM lParam);
+	afx_msg LRESULT OnEngineData(WPARAM wParam,LPARAM lParam);
+	void PostProgress(CString text,int done);
+	afx_msg LRESULT OnProgressMessage(WPARAM wParam,LPARAM lParam);
+	void RunWorker(void (*proc)(void *),void *param);
 	void OnLButtonDownAction(UINT nFlags, CPoint point);
 	int OnLButtonUpAction(UINT nFlags, CPoint point);
 	void OnRButtonDownAction(UINT nFlags, CPoint point);
@@ -222,10 +270,12 @@ public:
 	void GetMoveHistory();
 	void writeMessage(char *str,...);
 	void doPGNRead(CString file,char type);
-	void filterPGNFile(CString& filedata);
+	void SetPGNTag(CString name,CString value);
+	CString GetPGNGame(int index);
+	void SetPGNAnnotations(int firstply);
+	CString GetPGNAnnotation(int ply, CPosition &pos);
 	int PGNMove(char cstring[255], int pieceside);
-	bool GetPieceIndex(char type[255],int pieceside,int to_i,int to_j,int &from_i,int &from_j) ;
-	int GetPieceType(char type[255],int piececolor,int&);
+	void PGNMoveSquares(int from, int to);
 	void doFENRead(CString file,char type);
 	void MoveTo(int pos);
 	CString GetFileSaveString();
@@ -238,6 +288,10 @@ public:
 	void RemoveFromObserverList(CAsyncSocket*);
 	void GetPieceInfo(int PieceId, COLOR_TYPE &ct, PIECE_TYPE &pt);
 	CString GetSingleMoveString(int i);
+	CString GetOpeningTreeString();
+	CString GetTablebaseString();
+	BOOL PlayBookMove(CEngine &engine,CString move);
+	void WriteEngineMove(CEngine &engine,CString move);
 	CString GetPositionHistoryString(int);
 	void doEPDRead(CString file,char type);
 	void doFENPositionRead(CString file,char type);
@@ -374,6 +428,18 @@ protected:
 	afx_msg void OnFileConvert();
 	afx_msg void OnEditComment();
 	afx_msg void OnUpdateFileConvert(CCmdUI* pCmdUI);
+	afx_msg void OnFileCheckpgnfile();
+	afx_msg void OnUpdateFileCheckpgnfile(CCmdUI* pCmdUI);
+	afx_msg void OnFileFindposition();
+	afx_msg void OnUpdateFileFindposition(CCmdUI* pCmdUI);
+	afx_msg void OnFileOpeningtree();
+	afx_msg void OnUpdateFileOpeningtree(CCmdUI* pCmdUI);
+	afx_msg void OnFileOpeningbook();
+	afx_msg void OnUpdateFileOpeningbook(CCmdUI* pCmdUI);
+	afx_msg void OnFileTablebases();
+	afx_msg void OnUpdateFileTablebases(CCmdUI* pCmdUI);
+	afx_msg void OnEditAnnotategame();
+	afx_msg void OnUpdateEditAnnotategame(CCmdUI* pCmdUI);
 	afx_msg void OnFileLoadlastgame();
 	afx_msg void OnUpdateFileLoadlastgame(CCmdUI* pCmdUI);
 	afx_msg void OnEditCopyepd();
@@ -0,0 +1,451 @@
+// OpeningTree.cpp : move statistics of the positions in a PGN file
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <mutex>
+#include <string>
+
+#include "OpeningTree.h"
+#include "San.h"
+
+static const char g_treeMagic[4] = {'N', 'C', 'O', 'T'};
+#define OPENINGTREE_VERSION		2
+//entries a worker gathers before it sorts them into a run
+#define OPENINGTREE_RUN			(256 * 1024)
+//entries read from each run at a time while merging
+#define OPENINGTREE_MERGE_BUFFER	8192
+#define OPENINGTREE_BUCKET_BITS	16
+#define OPENINGTREE_BUCKETS		(1 << OPENINGTREE_BUCKET_BITS)
+
+//shared by the workers of a build
+struct TREEBUILD
+{
+	std::mutex lock;
+	FILE *fp;
+	//entry offsets of the sorted runs in fp, with the end of the last one
+	std::vector<unsigned long long> runs;
+	std::vector<std::vector<OPENINGTREEENTRY> > entries;
+};
+
+//one sorted run being merged
+struct TREERUN
+{
+	unsigned long long next;
+	unsigned long long end;
+	std::vector<OPENINGTREEENTRY> buffer;
+	size_t pos;
+};
+
+static bool EntryLess(const OPENINGTREEENTRY &a, const OPENINGTREEENTRY &b)
+{
+	if(a.key != b.key)
+		return a.key < b.key;
+	return a.move < b.move;
+}
+
+static bool SameEntry(const OPENINGTREEENTRY &a, const OPENINGTREEENTRY &b)
+{
+	return a.key == b.key && a.move == b.move;
+}
+
+static bool MorePlayed(const OPENINGTREEENTRY &a, const OPENINGTREEENTRY &b)
+{
+	return a.games > b.games;
+}
+
+static void AddEntry(OPENINGTREEENTRY &to, const OPENINGTREEENTRY &from)
+{
+	to.games += from.games;
+	to.scored += from.scored;
+	to.points += from.points;
+	to.rated += from.rated;
+	to.ratings += from.ratings;
+}
+
+static bool Seek(FILE *fp, unsigned long long offset)
+{
+#if defined(_WIN32)
+	return _fseeki64(fp, (long long)offset, SEEK_SET) == 0;
+#else
+	return fseeko(fp, (off_t)offset, SEEK_SET) == 0;
+#endif
+}
+
+//sorts entries, adds up the ones for the same move and writes them as a run
+static void FlushRun(TREEBUILD &build, std::vector<OPENINGTREEENTRY> &entries)
+{
+	if(entries.empty())
+		return;
+	std::sort(entries.begin(), entries.end(), EntryLess);
+	size_t kept = 0;
+	for(size_t i = 0; i < entries.size(); i++)
+	{
+		if(kept > 0 && entries[kept - 1].key == entries[i].key && entries[kept - 1].move == entries[i].move)
+			AddEntry(entries[kept - 1], entries[i]);
+		else
+			entries[kept++] = entries[i];
+	}
+	{
+		std::lock_guard<std::mutex> lock(build.lock);
+		fwrite(&entries[0], sizeof(OPENINGTREEENTRY), kept, build.fp);
+		build.runs.push_back(build.runs.back() + kept);
+	}
+	entries.clear();
+}
+
+//Replays the main line of a game on a worker thread and adds an entry
+//for each of its first OPENINGTREE_MAX_PLIES moves. The moves before a bad
+//one are kept.
+static void TreeGame(const char *text, unsigned int length, PGNGAMERESULT &result, int worker, void *param)
+{
+	TREEBUILD *build = (TREEBUILD *)param;
+	std::vector<OPENINGTREEENTRY> &entries = build->entries[worker];
+	size_t first = entries.size();
+	CPosition pos;
+	pos.SetStartPosition();
+	UNDOINFO undo;
+	int gameResult = RESULT_UNKNOWN;
+	unsigned int ratings[2] = {0, 0};
+	int depth = 0;
+
+	CPGNReader reader;
+	reader.Attach(text, length);
+	reader.NextGame();
+	PGNTOKEN token;
+	int type;
+	while(result.error == PGNERROR_NONE && (type = reader.NextToken(token)) != PGN_END)
+	{
+		if(type == PGN_TAG)
+		{
+			if(token.value == NULL)
+				continue;
+			std::string value(token.value, token.valueLength);
+			if(token.length == 8 && strncmp(token.text, "WhiteElo", 8) == 0)
+				ratings[SIDE_WHITE] = (unsigned int)atoi(value.c_str());
+			else if(token.length == 8 && strncmp(token.text, "BlackElo", 8) == 0)
+				ratings[SIDE_BLACK] = (unsigned int)atoi(value.c_str());
+			else if(token.length == 6 && strncmp(token.text, "Result", 6) == 0)
+				gameResult = CGameIndex::ParseResult(token.value, token.valueLength);
+			else if(token.length == 3 && strncmp(token.text, "FEN", 3) == 0 && !pos.SetFEN(value.c_str()))
+				CPGNPipeline::SetError(result, PGNERROR_BAD_FEN, text, token);
+		}
+		else if(type == PGN_RESULT && gameResult == RESULT_UNKNOWN)
+		{
+			gameResult = CGameIndex::ParseResult(token.text, token.length);
+		}
+		else if(type == PGN_VARIATION_START)
+		{
+			depth++;
+		}
+		else if(type == PGN_VARIATION_END && depth > 0)
+		{
+			depth--;
+		}
+		else if(type == PGN_SAN && depth == 0 && result.plies < OPENINGTREE_MAX_PLIES)
+		{
+			char san[16];
+			int n = token.length < (int)sizeof(san) - 1 ? token.length : (int)sizeof(san) - 1;
+			memcpy(san, token.text, n);
+			san[n] = '\0';
+			CHESSMOVE move = ParseSAN(pos, san);
+			if(move == NULL_MOVE)
+			{
+				CPGNPipeline::SetError(result, PGNERROR_BAD_MOVE, text, token);
+				break;
+			}
+			OPENINGTREEENTRY entry;
+			memset(&entry, 0, sizeof(entry));
+			entry.key = pos.GetKey();
+			entry.move = move;
+			//the side to move until the result is known
+			entry.reserved = (unsigned short)pos.GetSide();
+			entry.games = 1;
+			entries.push_back(entry);
+			pos.MakeMove(move, undo);
+			result.plies++;
+		}
+	}
+	result.key = pos.GetKey();
+	for(size_t i = first; i < entries.size(); i++)
+	{
+		OPENINGTREEENTRY &entry = entries[i];
+		int side = entry.reserved;
+		entry.reserved = 0;
+		if(gameResult != RESULT_UNKNOWN)
+		{
+			entry.scored = 1;
+			if(gameResult == RESULT_DRAW)
+				entry.points = 1;
+			else if((gameResult == RESULT_WHITE_WINS) == (side == SIDE_WHITE))
+				entry.points = 2;
+		}
+		if(ratings[side] > 0)
+		{
+			entry.rated = 1;
+			entry.ratings = ratings[side];
+		}
+	}
+	//a move played again from a repeated position counts for the game once
+	std::sort(entries.begin() + first, entries.end(), EntryLess);
+	entries.erase(std::unique(entries.begin() + first, entries.end(), SameEntry), entries.end());
+	if(entries.size() >= OPENINGTREE_RUN)
+		FlushRun(*build, entries);
+}
+
+static bool FillRun(FILE *fp, TREERUN &run)
+{
+	run.pos = 0;
+	run.buffer.clear();
+	if(run.next == run.end)
+		return false;
+	size_t count = run.end - run.next < OPENINGTREE_MERGE_BUFFER ? (size_t)(run.end - run.next) : OPENINGTREE_MERGE_BUFFER;
+	run.buffer.resize(count);
+	if(!Seek(fp, run.next * sizeof(OPENINGTREEENTRY)) ||
+		fread(&run.buffer[0], sizeof(OPENINGTREEENTRY), count, fp) != count)
+	{
+		run.buffer.clear();
+		return false;
+	}
+	run.next += count;
+	return true;
+}
+
+//Merges the runs into fp, adding up the entries for the same move that
+//ended up in different runs. Fills buckets and the entry count.
+static bool MergeRuns(TREEBUILD &build, FILE *fp, std::vector<unsigned long long> &buckets,
+	OPENINGTREEHEADER &header)
+{
+	std::vector<TREERUN> merge(build.runs.size() - 1);
+	std::vector<unsigned int> heap;
+	for(size_t i = 0; i < merge.size(); i++)
+	{
+		merge[i].next = build.runs[i];
+		merge[i].end = build.runs[i + 1];
+		if(FillRun(build.fp, merge[i]))
+			heap.push_back((unsigned int)i);
+	}
+	//smallest entry on top
+	struct RunGreater
+	{
+		std::vector<TREERUN> *runs;
+		bool operator()(unsigned int a, unsigned int b) const
+		{
+			TREERUN &ra = (*runs)[a];
+			TREERUN &rb = (*runs)[b];
+			return EntryLess(rb.buffer[rb.pos], ra.buffer[ra.pos]);
+		}
+	} greater = {&merge};
+	std::make_heap(heap.begin(), heap.end(), greater);
+
+	buckets.assign(OPENINGTREE_BUCKETS + 1, 0);
+	unsigned int nextBucket = 0;
+	header.entries = 0;
+	OPENINGTREEENTRY current;
+	bool pending = false;
+	while(!heap.empty())
+	{
+		std::pop_heap(heap.begin(), heap.end(), greater);
+		TREERUN &run = merge[heap.back()];
+		const OPENINGTREEENTRY &entry = run.buffer[run.pos];
+		if(pending && current.key == entry.key && current.move == entry.move)
+		{
+			AddEntry(current, entry);
+		}
+		else
+		{
+			if(pending)
+			{
+				fwrite(&current, sizeof(current), 1, fp);
+				header.entries++;
+			}
+			unsigned int bucket = (unsigned int)(entry.key >> (64 - OPENINGTREE_BUCKET_BITS));
+			while(nextBucket <= bucket)
+				buckets[nextBucket++] = header.entries;
+			current = entry;
+			pending = true;
+		}
+		if(++run.pos < run.buffer.size() || FillRun(build.fp, run))
+			std::push_heap(heap.begin(), heap.end(), greater);
+		else
+			heap.pop_back();
+	}
+	if(pending)
+	{
+		fwrite(&current, sizeof(current), 1, fp);
+		header.entries++;
+	}
+	while(nextBucket <= OPENINGTREE_BUCKETS)
+		buckets[nextBucket++] = header.entries;
+	return ferror(build.fp) == 0;
+}
+
+COpeningTree::COpeningTree()
+{
+	memset(&m_header, 0, sizeof(m_header));
+}
+
+//The workers sort what they gather into runs on a scratch file; the runs
+//are merged into the tree once every game is read.
+bool COpeningTree::Build(const char *path, const char *treepath, CPGNPipeline &pipeline,
+	int threads, PGNRESULTPROC proc, void *param)
+{
+	OPENINGTREEHEADER header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, g_treeMagic, sizeof(header.magic));
+	header.version = OPENINGTREE_VERSION;
+	header.plies = OPENINGTREE_MAX_PLIES;
+	if(!CGameIndex::GetSourceStamp(path, header.sourceSize, header.sourceTime))
+		return false;
+
+	char runpath[1024];
+	sprintf(runpath, "%.1000s~", treepath);
+	TREEBUILD build;
+	build.fp = fopen(runpath, "w+b");
+	if(build.fp == NULL)
+		return false;
+	build.runs.push_back(0);
+	threads = CPGNPipeline::GetThreadCount(threads);
+	build.entries.resize(threads);
+	pipeline.SetGameProc(TreeGame, &build);
+	bool ok = pipeline.Run(path, GAMEINDEX_PGN, threads, proc, param);
+	pipeline.SetGameProc(NULL, NULL);
+	for(int i = 0; i < threads; i++)
+		FlushRun(build, build.entries[i]);
+	header.games = pipeline.GetGames();
+
+	FILE *fp = ok ? fopen(treepath, "wb") : NULL;
+	if(fp == NULL)
+	{
+		fclose(build.fp);
+		remove(runpath);
+		return false;
+	}
+	fwrite(&header, sizeof(header), 1, fp);
+	std::vector<unsigned long long> buckets;
+	ok = MergeRuns(build, fp, buckets, header);
+	fclose(build.fp);
+	remove(runpath);
+	header.buckets = sizeof(header) + header.entries * sizeof(OPENINGTREEENTRY);
+	fwrite(&buckets[0], sizeof(unsigned long long), buckets.size(), fp);
+	fseek(fp, 0, SEEK_SET);
+	fwrite(&header, sizeof(header), 1, fp);
+	if(ferror(fp) != 0)
+		ok = false;
+	if(fclose(fp) != 0)
+		ok = false;
+	if(!ok)
+		remove(treepath);
+	return ok;
+}
+
+bool COpeningTree::Load(const char *treepath)
+{
+	Close();
+	if(!m_file.Open(treepath))
+		return false;
+	const OPENINGTREEHEADER *header = (const OPENINGTREEHEADER *)m_file.Map(0, sizeof(OPENINGTREEHEADER));
+	if(header == NULL || m_file.GetSize() < sizeof(OPENINGTREEHEADER) ||
+		memcmp(header->magic, g_treeMagic, sizeof(header->magic)) != 0 ||
+		header->version != OPENINGTREE_VERSION || header->plies != OPENINGTREE_MAX_PLIES ||
+		header->buckets != sizeof(OPENINGTREEHEADER) + header->entries * sizeof(OPENINGTREEENTRY) ||
+		header->buckets + (OPENINGTREE_BUCKETS + 1) * sizeof(unsigned long long) != m_file.GetSize())
+	{
+		Close();
+		return false;
+	}
+	m_header = *header;
+	const unsigned long long *buckets = (const unsigned long long *)m_file.Map(m_header.buckets,
+		(OPENINGTREE_BUCKETS + 1) * sizeof(unsigned long long));
+	if(buckets == NULL)
+	{
+		Close();
+		return false;
+	}
+	m_buckets.assign(buckets, buckets + OPENINGTREE_BUCKETS + 1);
+	return true;
+}
+
+bool COpeningTree::Open(const char *path, CPGNPipeline &pipeline, int threads,
+	PGNRESULTPROC proc, void *param)
+{
+	char treepath[1024];
+	sprintf(treepath, "%.1000s.nctree", path);
+	unsigned long long size;
+	long long time;
+	if(!CGameIndex::GetSourceStamp(path, size, time))
+		return false;
+	if(!Load(treepath) || m_header.sourceSize != size || m_header.sourceTime != time)
+	{
+		Close();
+		if(!Build(path, treepath, pipeline, threads, proc, param) || !Load(treepath))
+		{
+			Close();
+			return false;
+		}
+	}
+	return true;
+}
+
+void COpeningTree::Close()
+{
+	m_file.Close();
+	memset(&m_header, 0, sizeof(m_header));
+	m_buckets.clear();
+}
+
+//A bucket holds a few hundred entries at most, so a lookup maps one small
+//view and does a binary search in it.
+unsigned int COpeningTree::Find(BITBOARD key, std::vector<OPENINGTREEENTRY> &moves)
+{
+	moves.clear();
+	if(!IsOpen())
+		return 0;
+	unsigned int bucket = (unsigned int)(key >> (64 - OPENINGTREE_BUCKET_BITS));
+	unsigned long long low = m_buckets[bucket], high = m_buckets[bucket + 1];
+	if(low == high)
+		return 0;
+	const OPENINGTREEENTRY *entries = (const OPENINGTREEENTRY *)m_file.Map(sizeof(OPENINGTREEHEADER) +
+		low * sizeof(OPENINGTREEENTRY), (size_t)(high - low) * sizeof(OPENINGTREEENTRY));
+	if(entries == NULL)
+		return 0;
+	size_t count = (size_t)(high - low);
+	size_t found = 0;
+	while(count > 0)
+	{
+		size_t half = count / 2;
+		if(entries[found + half].key < key)
+		{
+			found += half + 1;
+			count -= half + 1;
+		}
+		else
+		{
+			count = half;
+		}
+	}
+	unsigned int games = 0;
+	for(; found < high - low && entries[found].key == key; found++)
+	{
+		moves.push_back(entries[found]);
+		games += entries[found].games;
+	}
+	std::stable_sort(moves.begin(), moves.end(), MorePlayed);
+	return games;
+}
+
+size_t COpeningTree::GetEntries(unsigned long long first, OPENINGTREEENTRY *entries, size_t count)
+{
+	if(!IsOpen() || first >= m_header.entries)
+		return 0;
+	if(count > m_header.entries - first)
+		count = (size_t)(m_header.entries - first);
+	const OPENINGTREEENTRY *view = (const OPENINGTREEENTRY *)m_file.Map(sizeof(OPENINGTREEHEADER) +
+		first * sizeof(OPENINGTREEENTRY), count * sizeof(OPENINGTREEENTRY));
+	if(view == NULL)
+		return 0;
+	memcpy(entries, view, count * sizeof(OPENINGTREEENTRY));
+	return count;
+}
@@ -0,0 +1,85 @@
+// OpeningTree.h : move statistics of the positions in a PGN file
+//
+// Like Position.h this file has no MFC dependency. The tree is written
+// next to a PGN file as <file>.nctree by a CPGNPipeline run, so the games
+// are read on all cores, and is rebuilt when the file changes. It holds
+// one entry per position and move played from it, sorted by the Zobrist
+// key of the position, and is looked at through a memory mapping.
+/////////////////////////////////////////////////////////////////////////////
+
+#if !defined(OPENINGTREE_H)
+#define OPENINGTREE_H
+
+#include <vector>
+
+#include "MappedFile.h"
+#include "PGNPipeline.h"
+
+//main line plies of a game that go in the tree
+#define OPENINGTREE_MAX_PLIES	60
+
+struct OPENINGTREEHEADER
+{
+	char magic[4];
+	unsigned int version;
+	unsigned long long sourceSize;
+	long long sourceTime;
+	unsigned int games;
+	unsigned int plies;
+	unsigned long long entries;
+	//file offset of the bucket table, the entries start after the header
+	unsigned long long buckets;
+};
+
+//a move played from the position with key
+struct OPENINGTREEENTRY
+{
+	BITBOARD key;
+	CHESSMOVE move;
+	unsigned short reserved;
+	unsigned int games;
+	//games with a result, and the half points the side making the move
+	//scored in them
+	unsigned int scored;
+	unsigned int points;
+	//games where the player making the move had a rating, and their sum
+	unsigned int rated;
+	unsigned int reserved2;
+	unsigned long long ratings;
+};
+
+class COpeningTree
+{
+private:
+	CMappedFile m_file;
+	OPENINGTREEHEADER m_header;
+	//index of the first entry of every bucket, and the entry count at the end
+	std::vector<unsigned long long> m_buckets;
+
+	bool Load(const char *treepath);
+
+public:
+	COpeningTree();
+
+	//Opens the tree of the PGN file at path, building it with pipeline
+	//(see CPGNPipeline::Run for threads, proc and param) when it is missing
+	//or older than the file.
+	bool Open(const char *path, CPGNPipeline &pipeline, int threads = 0,
+		PGNRESULTPROC proc = NULL, void *param = NULL);
+	void Close();
+	bool IsOpen() const							{ return m_file.IsOpen(); }
+	unsigned int GetGames() const				{ return IsOpen() ? m_header.games : 0; }
+	unsigned long long GetEntries() const		{ return IsOpen() ? m_header.entries : 0; }
+
+	//Replaces moves with the moves played from the position with key, the
+	//most played first. Returns the number of games that went on from it.
+	unsigned int Find(BITBOARD key, std::vector<OPENINGTREEENTRY> &moves);
+	//copies the entries from index first on, in key order, to entries, at
+	//most count of them, and returns how many were copied
+	size_t GetEntries(unsigned long long first, OPENINGTREEENTRY *entries, size_t count);
+
+	static bool Build(const char *path, const char *treepath, CPGNPipeline &pipeline,
+		int threads, PGNRESULTPROC proc, void *param);
+};
+
+#endif
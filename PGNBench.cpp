@@ -0,0 +1,102 @@
+// PGNBench.cpp : throughput of the PGN reader
+//
+// Not part of the NetChess project, build it on its own:
+//   g++ -O2 -o pgnbench PGNBench.cpp PGNReader.cpp MappedFile.cpp San.cpp Position.cpp MoveGen.cpp Zobrist.cpp
+//   cl /O2 /EHsc PGNBench.cpp PGNReader.cpp MappedFile.cpp San.cpp Position.cpp MoveGen.cpp Zobrist.cpp
+//
+// Usage:
+//   pgnbench file.pgn            tokenize every game
+//   pgnbench -replay file.pgn    also play the main line of every game
+// Reports games and bytes per second. With -replay, games with a move that
+// does not resolve are counted and the first few are listed.
+/////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "PGNReader.h"
+#include "San.h"
+
+static double ElapsedSeconds(clock_t start)
+{
+	return (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+int main(int argc, char *argv[])
+{
+	bool replay = argc >= 3 && strcmp(argv[1], "-replay") == 0;
+	if(argc != (replay ? 3 : 2))
+	{
+		fprintf(stderr, "usage: pgnbench [-replay] file.pgn\n");
+		return 2;
+	}
+	const char *path = argv[argc - 1];
+	CPGNReader reader;
+	if(!reader.Open(path))
+	{
+		fprintf(stderr, "cannot open %s\n", path);
+		return 2;
+	}
+
+	unsigned long long games = 0, tokens = 0, moves = 0;
+	int errors = 0;
+	CPosition pos;
+	clock_t start = clock();
+	while(reader.NextGame())
+	{
+		PGNTOKEN token;
+		int type;
+		bool failed = false;
+		pos.SetStartPosition();
+		games++;
+		while((type = reader.NextToken(token)) != PGN_END)
+		{
+			tokens++;
+			if(!replay)
+				continue;
+			if(type == PGN_TAG && token.length == 3 && strncmp(token.text, "FEN", 3) == 0)
+			{
+				char fen[128];
+				int n = token.valueLength < (int)sizeof(fen) - 1 ? token.valueLength : (int)sizeof(fen) - 1;
+				memcpy(fen, token.value, n);
+				fen[n] = '\0';
+				failed = !pos.SetFEN(fen);
+			}
+			else if(type == PGN_VARIATION_START)
+			{
+				for(int depth = 1; depth > 0 && (type = reader.NextToken(token)) != PGN_END; tokens++)
+					depth += type == PGN_VARIATION_START ? 1 : type == PGN_VARIATION_END ? -1 : 0;
+			}
+			else if(type == PGN_SAN && !failed)
+			{
+				char san[16];
+				int n = token.length < (int)sizeof(san) - 1 ? token.length : (int)sizeof(san) - 1;
+				memcpy(san, token.text, n);
+				san[n] = '\0';
+				CHESSMOVE move = ParseSAN(pos, san);
+				if(move == NULL_MOVE)
+				{
+					if(errors++ < 10)
+						printf("game %llu at offset %llu: %s does not resolve\n", games, reader.GetGameOffset(), san);
+					failed = true;
+					continue;
+				}
+				UNDOINFO undo;
+				pos.MakeMove(move, undo);
+				moves++;
+			}
+		}
+	}
+	double seconds = ElapsedSeconds(start);
+	if(seconds <= 0)
+		seconds = 1e-6;
+
+	double bytes = (double)reader.GetSize();
+	printf("%llu games, %llu tokens, %.1f MB in %.3f s\n", games, tokens, bytes / 1048576, seconds);
+	printf("%.0f games/s, %.1f MB/s\n", games / seconds, bytes / 1048576 / seconds);
+	if(replay)
+		printf("%llu moves played, %.0f moves/s, %d game(s) with errors\n", moves, moves / seconds, errors);
+	return errors ? 1 : 0;
+}
@@ -0,0 +1,98 @@
+// PGNCheck.cpp : checks every game of a PGN, FEN or EPD file in parallel
+//
+// Not part of the NetChess project, build it on its own:
+//   g++ -O2 -pthread -o pgncheck PGNCheck.cpp PGNPipeline.cpp PGNReader.cpp MappedFile.cpp San.cpp Position.cpp MoveGen.cpp Zobrist.cpp
+//   cl /O2 /EHsc PGNCheck.cpp PGNPipeline.cpp PGNReader.cpp MappedFile.cpp San.cpp Position.cpp MoveGen.cpp Zobrist.cpp
+//
+// Usage:
+//   pgncheck [-threads n] [-scale] file.pgn
+// Replays every game, variations included, and lists the ones that fail as
+// "file:line:column: game n: error 'token'". Files ending in .fen or .epd
+// are read as one position per line. With -scale the file is checked
+// with 1, 2, 4 ... threads up to n (default one per core) and the speed of
+// each run is reported.
+/////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+
+#include "PGNPipeline.h"
+
+struct CHECKREPORT
+{
+	const char *path;
+	bool quiet;
+};
+
+static void ReportGame(const PGNGAMERESULT &result, void *param)
+{
+	CHECKREPORT *report = (CHECKREPORT *)param;
+	if(result.error == PGNERROR_NONE || report->quiet)
+		return;
+	printf("%s:%u:%u: game %u: %s '%s'\n", report->path, result.errorLine, result.errorColumn,
+		result.game + 1, CPGNPipeline::GetErrorString(result.error), result.errorText);
+}
+
+//checks path once, returns the wall clock seconds or a negative value
+static double Check(CPGNPipeline &pipeline, const char *path, int threads, bool quiet)
+{
+	CHECKREPORT report = {path, quiet};
+	const char *ext = strrchr(path, '.');
+	int format = ext != NULL && (strcmp(ext, ".fen") == 0 || strcmp(ext, ".FEN") == 0 ||
+		strcmp(ext, ".epd") == 0 || strcmp(ext, ".EPD") == 0) ? GAMEINDEX_LINES : GAMEINDEX_PGN;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	if(!pipeline.Run(path, format, threads, ReportGame, &report))
+		return -1;
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char *argv[])
+{
+	int threads = 0;
+	bool scale = false;
+	int arg = 1;
+	for(; arg < argc - 1; arg++)
+	{
+		if(strcmp(argv[arg], "-threads") == 0 && arg + 1 < argc - 1)
+			threads = atoi(argv[++arg]);
+		else if(strcmp(argv[arg], "-scale") == 0)
+			scale = true;
+		else
+			break;
+	}
+	if(arg != argc - 1 || threads < 0)
+	{
+		fprintf(stderr, "usage: pgncheck [-threads n] [-scale] file.pgn\n");
+		return 2;
+	}
+	const char *path = argv[arg];
+	if(threads == 0)
+		threads = (int)std::thread::hardware_concurrency() > 0 ? (int)std::thread::hardware_concurrency() : 1;
+
+	CPGNPipeline pipeline;
+	double single = 0;
+	for(int n = scale ? 1 : threads;; n = n * 2 < threads ? n * 2 : threads)
+	{
+		double seconds = Check(pipeline, path, n, scale && n != threads);
+		if(seconds < 0)
+		{
+			fprintf(stderr, "pgncheck: cannot read %s\n", path);
+			return 2;
+		}
+		if(n == 1)
+			single = seconds;
+		if(seconds <= 0)
+			seconds = 1e-6;
+		printf("%2d thread(s): %u games, %u with errors, %.2f s, %.1f MB/s, %.0f games/s",
+			n, pipeline.GetGames(), pipeline.GetErrors(), seconds,
+			pipeline.GetBytes() / seconds / (1024 * 1024), pipeline.GetGames() / seconds);
+		if(single > 0)
+			printf(", x%.2f", single / seconds);
+		printf("\n");
+		if(n == threads)
+			break;
+	}
+	return pipeline.GetErrors() ? 1 : 0;
+}
@@ -0,0 +1,127 @@
+// PGNConvert.cpp : converts a PGN, FEN or EPD file on all cores
+//
+// Not part of the NetChess project, build it on its own:
+//   g++ -O2 -pthread -o pgnconvert PGNConvert.cpp PGNPipeline.cpp PGNReader.cpp MappedFile.cpp San.cpp Position.cpp MoveGen.cpp Zobrist.cpp
+//   cl /O2 /EHsc PGNConvert.cpp PGNPipeline.cpp PGNReader.cpp MappedFile.cpp San.cpp Position.cpp MoveGen.cpp Zobrist.cpp
+//
+// Usage:
+//   pgnconvert [-threads n] input output...
+// The format of every file comes from its extension (.pgn, .fen or .epd).
+// A game becomes a PGN game with its moves in standard SAN, or the FEN/EPD
+// of every position of its main line; a FEN or EPD line becomes a game
+// starting from that position. Games that do not replay are reported and
+// left out. Progress goes to stderr about once a second.
+/////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+
+#include "PGNPipeline.h"
+
+struct CONVERTREPORT
+{
+	const char *path;
+	CPGNPipeline *pipeline;
+	std::chrono::steady_clock::time_point start;
+	std::chrono::steady_clock::time_point shown;
+};
+
+static double Seconds(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+//PGN_OUTPUT of a file name, -1 when the extension is not known
+static int GetOutputType(const char *path)
+{
+	const char *ext = strrchr(path, '.');
+	if(ext == NULL)
+		return -1;
+	if(strcmp(ext, ".pgn") == 0 || strcmp(ext, ".PGN") == 0)
+		return PGNOUTPUT_PGN;
+	if(strcmp(ext, ".fen") == 0 || strcmp(ext, ".FEN") == 0)
+		return PGNOUTPUT_FEN;
+	if(strcmp(ext, ".epd") == 0 || strcmp(ext, ".EPD") == 0)
+		return PGNOUTPUT_EPD;
+	return -1;
+}
+
+static void ReportGame(const PGNGAMERESULT &result, void *param)
+{
+	CONVERTREPORT *report = (CONVERTREPORT *)param;
+	if(result.error != PGNERROR_NONE)
+	{
+		fprintf(stderr, "%s:%u:%u: game %u: %s '%s'\n", report->path, result.errorLine, result.errorColumn,
+			result.game + 1, CPGNPipeline::GetErrorString(result.error), result.errorText);
+	}
+	if(Seconds(report->shown) < 1)
+		return;
+	report->shown = std::chrono::steady_clock::now();
+	CPGNPipeline *pipeline = report->pipeline;
+	double seconds = Seconds(report->start);
+	fprintf(stderr, "%u games, %.0f%%, %.1f MB/s, %.0f games/s\n", pipeline->GetGames(),
+		pipeline->GetSize() ? 100.0 * pipeline->GetBytes() / pipeline->GetSize() : 0.0,
+		pipeline->GetBytes() / seconds / (1024 * 1024), pipeline->GetGames() / seconds);
+}
+
+int main(int argc, char *argv[])
+{
+	int threads = 0;
+	int arg = 1;
+	if(arg + 1 < argc && strcmp(argv[arg], "-threads") == 0)
+	{
+		threads = atoi(argv[arg + 1]);
+		arg += 2;
+	}
+	if(argc - arg < 2 || threads < 0 || GetOutputType(argv[arg]) < 0)
+	{
+		fprintf(stderr, "usage: pgnconvert [-threads n] input output...\n");
+		return 2;
+	}
+	const char *input = argv[arg++];
+	int format = GetOutputType(input) == PGNOUTPUT_PGN ? GAMEINDEX_PGN : GAMEINDEX_LINES;
+
+	CPGNPipeline pipeline;
+	FILE *outputs[PGNOUTPUT_COUNT] = {NULL};
+	for(; arg < argc; arg++)
+	{
+		int type = GetOutputType(argv[arg]);
+		if(type < 0 || outputs[type] != NULL)
+		{
+			fprintf(stderr, "pgnconvert: %s is not a new .pgn, .fen or .epd file\n", argv[arg]);
+			return 2;
+		}
+		outputs[type] = fopen(argv[arg], "w");
+		if(outputs[type] == NULL)
+		{
+			fprintf(stderr, "pgnconvert: cannot write %s\n", argv[arg]);
+			return 2;
+		}
+		pipeline.SetOutput(type, outputs[type]);
+	}
+
+	CONVERTREPORT report;
+	report.path = input;
+	report.pipeline = &pipeline;
+	report.start = report.shown = std::chrono::steady_clock::now();
+	bool ok = pipeline.Run(input, format, threads, ReportGame, &report);
+	for(int i = 0; i < PGNOUTPUT_COUNT; i++)
+	{
+		if(outputs[i] != NULL)
+			fclose(outputs[i]);
+	}
+	if(!ok)
+	{
+		fprintf(stderr, "pgnconvert: cannot read %s\n", input);
+		return 2;
+	}
+	double seconds = Seconds(report.start);
+	if(seconds <= 0)
+		seconds = 1e-6;
+	printf("%u games, %u left out, %.2f s, %.1f MB/s, %.0f games/s\n", pipeline.GetGames(),
+		pipeline.GetErrors(), seconds, pipeline.GetBytes() / seconds / (1024 * 1024),
+		pipeline.GetGames() / seconds);
+	return pipeline.GetErrors() ? 1 : 0;
+}
@@ -0,0 +1,639 @@
+// PGNPipeline.cpp : parallel parsing, validation and conversion of game files
+//
+
+#include <stdio.h>
+#include <string.h>
+
+#include "PGNPipeline.h"
+#include "PGNReader.h"
+#include "San.h"
+
+//a batch is handed to a worker once it holds this many bytes or games
+#define PGNBATCH_BYTES		(256 * 1024)
+#define PGNBATCH_GAMES		512
+//deepest variation nesting and longest line replayed
+#define PGNCHECK_MAX_PLIES	2048
+#define PGNCHECK_MAX_DEPTH	64
+//movetext lines are written no longer than this
+#define PGN_LINE_LENGTH		79
+
+CPGNPipeline::CPGNPipeline()
+{
+	m_batches = m_inFlight = m_maxInFlight = 0;
+	m_splitDone = m_cancel = m_openFailed = false;
+	m_path = NULL;
+	m_format = GAMEINDEX_PGN;
+	for(int i = 0; i < PGNOUTPUT_COUNT; i++)
+		m_outputs[i] = NULL;
+	m_gameProc = NULL;
+	m_gameParam = NULL;
+	m_size = m_bytes = 0;
+	m_games = m_errors = 0;
+}
+
+const char *CPGNPipeline::GetErrorString(int error)
+{
+	switch(error)
+	{
+		case PGNERROR_NONE:
+			return "ok";
+		case PGNERROR_BAD_FEN:
+			return "FEN tag is not a legal position";
+		case PGNERROR_BAD_MOVE:
+			return "move is not legal or not understood";
+		case PGNERROR_EMPTY_VARIATION:
+			return "variation before the first move";
+		case PGNERROR_TOO_LONG:
+			return "line or nesting too long";
+	}
+	return "unknown error";
+}
+
+void CPGNPipeline::SetError(PGNGAMERESULT &result, int error, const char *game, const PGNTOKEN &token)
+{
+	result.error = error;
+	result.errorOffset = result.offset + (token.text - game);
+	result.errorLine = result.line;
+	const char *linestart = game;
+	for(const char *p = game; p < token.text; p++)
+	{
+		if(*p == '\n')
+		{
+			result.errorLine++;
+			linestart = p + 1;
+		}
+	}
+	result.errorColumn = (unsigned int)(token.text - linestart) + 1;
+	int n = token.length < (int)sizeof(result.errorText) - 1 ? token.length : (int)sizeof(result.errorText) - 1;
+	memcpy(result.errorText, token.text, n);
+	result.errorText[n] = '\0';
+}
+
+//Appends a movetext word, starting a new line rather than going past
+//PGN_LINE_LENGTH with it and the follow characters the caller adds to it.
+//space is false straight after "(".
+static void AppendWord(std::string &out, size_t &linestart, bool &space, const char *text, int length, int follow = 0)
+{
+	if(space)
+	{
+		if(out.size() - linestart + 1 + length + follow > PGN_LINE_LENGTH)
+		{
+			out += '\n';
+			linestart = out.size();
+		}
+		else
+		{
+			out += ' ';
+		}
+	}
+	out.append(text, length);
+	space = true;
+}
+
+//ends a variation, a line may break before the ")"
+static void CloseVariation(std::string &out, size_t &linestart)
+{
+	if(out.size() - linestart + 1 > PGN_LINE_LENGTH)
+	{
+		out += '\n';
+		linestart = out.size();
+	}
+	out += ')';
+}
+
+//pos as a FEN line and as an EPD line with its clocks as operations
+static void AppendPosition(const CPosition &pos, std::string *fen, std::string *epd, const char *ops = NULL, int opsLength = 0)
+{
+	if(fen == NULL && epd == NULL)
+		return;
+	char buf[128];
+	int n = pos.GetFEN(buf, sizeof(buf));
+	if(fen != NULL)
+	{
+		fen->append(buf, n);
+		*fen += '\n';
+	}
+	if(epd != NULL)
+	{
+		//the first four fields are the same
+		int fields = 0, k;
+		for(k = 0; k < n && fields < 4; k++)
+			fields += buf[k] == ' ';
+		epd->append(buf, k - 1);
+		if(opsLength > 0)
+			n = sprintf(buf, " %.*s\n", opsLength, ops);
+		else
+			n = sprintf(buf, " hmvc %d; fmvn %d;\n", pos.GetHalfMoveClock(), pos.GetFullMoveNumber());
+		epd->append(buf, n);
+	}
+}
+
+//The moves of the line being read are kept on a stack. "(" takes back the
+//last move and remembers it, ")" takes the variation back and replays it.
+//The game is written out again as it is read, with every move in standard
+//SAN and the move numbers redone; a game with an error is taken back out.
+void CPGNPipeline::CheckGame(const char *text, unsigned int length, PGNGAMERESULT &result,
+	std::string **outputs)
+{
+	CHESSMOVE moves[PGNCHECK_MAX_PLIES];
+	UNDOINFO undo[PGNCHECK_MAX_PLIES];
+	int frames[PGNCHECK_MAX_DEPTH];
+	CHESSMOVE frameMoves[PGNCHECK_MAX_DEPTH];
+	int count = 0, depth = 0;
+	CPosition pos;
+	pos.SetStartPosition();
+	result.plies = 0;
+	result.error = PGNERROR_NONE;
+
+	std::string *pgn = outputs != NULL ? outputs[PGNOUTPUT_PGN] : NULL;
+	std::string *fen = outputs != NULL ? outputs[PGNOUTPUT_FEN] : NULL;
+	std::string *epd = outputs != NULL ? outputs[PGNOUTPUT_EPD] : NULL;
+	size_t marks[PGNOUTPUT_COUNT];
+	for(int i = 0; i < PGNOUTPUT_COUNT; i++)
+		marks[i] = outputs != NULL && outputs[i] != NULL ? outputs[i]->size() : 0;
+	size_t linestart = 0;
+	bool movetext = false, space = false, number = true;
+	const char *gameResult = "*";
+	int gameResultLength = 1;
+
+	CPGNReader reader;
+	reader.Attach(text, length);
+	reader.NextGame();
+	PGNTOKEN token;
+	int type;
+	while(result.error == PGNERROR_NONE && (type = reader.NextToken(token)) != PGN_END)
+	{
+		if(type != PGN_TAG && !movetext)
+		{
+			movetext = true;
+			if(pgn != NULL)
+			{
+				*pgn += '\n';
+				linestart = pgn->size();
+			}
+			AppendPosition(pos, fen, epd);
+		}
+		if(type == PGN_TAG)
+		{
+			if(token.length == 3 && strncmp(token.text, "FEN", 3) == 0 && token.value != NULL)
+			{
+				char fentag[128];
+				int n = token.valueLength < (int)sizeof(fentag) - 1 ? token.valueLength : (int)sizeof(fentag) - 1;
+				memcpy(fentag, token.value, n);
+				fentag[n] = '\0';
+				if(!pos.SetFEN(fentag))
+					SetError(result, PGNERROR_BAD_FEN, text, token);
+			}
+			if(pgn != NULL)
+			{
+				*pgn += '[';
+				pgn->append(token.text, token.length);
+				*pgn += " \"";
+				if(token.value != NULL)
+					pgn->append(token.value, token.valueLength);
+				*pgn += "\"]\n";
+			}
+		}
+		else if(type == PGN_SAN)
+		{
+			char san[16];
+			int n = token.length < (int)sizeof(san) - 1 ? token.length : (int)sizeof(san) - 1;
+			memcpy(san, token.text, n);
+			san[n] = '\0';
+			CHESSMOVE move = ParseSAN(pos, san);
+			if(move == NULL_MOVE)
+			{
+				SetError(result, PGNERROR_BAD_MOVE, text, token);
+			}
+			else if(count == PGNCHECK_MAX_PLIES)
+			{
+				SetError(result, PGNERROR_TOO_LONG, text, token);
+			}
+			else
+			{
+				if(pgn != NULL)
+				{
+					if(pos.GetSide() == SIDE_WHITE || number)
+					{
+						n = sprintf(san, pos.GetSide() == SIDE_WHITE ? "%d." : "%d...", pos.GetFullMoveNumber());
+						AppendWord(*pgn, linestart, space, san, n);
+					}
+					n = FormatSAN(pos, move, san);
+					AppendWord(*pgn, linestart, space, san, n);
+					number = false;
+				}
+				pos.MakeMove(move, undo[count]);
+				moves[count++] = move;
+				if(depth == 0)
+				{
+					result.plies++;
+					AppendPosition(pos, fen, epd);
+				}
+			}
+		}
+		else if(type == PGN_VARIATION_START)
+		{
+			if(count == 0 || (depth > 0 && count == frames[depth - 1]))
+			{
+				SetError(result, PGNERROR_EMPTY_VARIATION, text, token);
+			}
+			else if(depth == PGNCHECK_MAX_DEPTH)
+			{
+				SetError(result, PGNERROR_TOO_LONG, text, token);
+			}
+			else
+			{
+				count--;
+				pos.UnmakeMove(moves[count], undo[count]);
+				frames[depth] = count;
+				frameMoves[depth++] = moves[count];
+				if(pgn != NULL)
+				{
+					//with room for the move number that follows it
+					AppendWord(*pgn, linestart, space, "(", 1, 7);
+					space = false;
+					number = true;
+				}
+			}
+		}
+		else if(type == PGN_VARIATION_END && depth > 0)
+		{
+			depth--;
+			while(count > frames[depth])
+			{
+				count--;
+				pos.UnmakeMove(moves[count], undo[count]);
+			}
+			pos.MakeMove(frameMoves[depth], undo[count]);
+			moves[count++] = frameMoves[depth];
+			if(pgn != NULL)
+			{
+				CloseVariation(*pgn, linestart);
+				number = true;
+			}
+		}
+		else if(type == PGN_NAG && pgn != NULL)
+		{
+			char nag[16];
+			int n = sprintf(nag, "%s%.*s", token.text[-1] == '$' ? "$" : "", token.length < 8 ? token.length : 8, token.text);
+			AppendWord(*pgn, linestart, space, nag, n);
+		}
+		else if(type == PGN_COMMENT && pgn != NULL)
+		{
+			//a ";" comment that holds a "}" has to stay one
+			if(memchr(token.text, '}', token.length) != NULL)
+			{
+				AppendWord(*pgn, linestart, space, ";", 1, token.length);
+				pgn->append(token.text, token.length);
+				*pgn += '\n';
+				linestart = pgn->size();
+				space = false;
+			}
+			else
+			{
+				AppendWord(*pgn, linestart, space, "{", 1, token.length + 1);
+				pgn->append(token.text, token.length);
+				*pgn += '}';
+			}
+			number = true;
+		}
+		else if(type == PGN_RESULT)
+		{
+			gameResult = token.text;
+			gameResultLength = token.length;
+		}
+	}
+	//a game cut short inside a variation still reports its main line
+	while(result.error == PGNERROR_NONE && depth > 0)
+	{
+		depth--;
+		while(count > frames[depth])
+		{
+			count--;
+			pos.UnmakeMove(moves[count], undo[count]);
+		}
+		pos.MakeMove(frameMoves[depth], undo[count]);
+		moves[count++] = frameMoves[depth];
+		if(pgn != NULL)
+			CloseVariation(*pgn, linestart);
+	}
+	result.key = pos.GetKey();
+	if(result.error != PGNERROR_NONE)
+	{
+		for(int i = 0; i < PGNOUTPUT_COUNT; i++)
+		{
+			if(outputs != NULL && outputs[i] != NULL)
+				outputs[i]->resize(marks[i]);
+		}
+		return;
+	}
+	if(!movetext)
+	{
+		if(pgn != NULL)
+		{
+			*pgn += '\n';
+			linestart = pgn->size();
+		}
+		AppendPosition(pos, fen, epd);
+	}
+	if(pgn != NULL)
+	{
+		AppendWord(*pgn, linestart, space, gameResult, gameResultLength);
+		*pgn += "\n\n";
+	}
+}
+
+//A FEN or EPD line. EPD operations after the four position fields are
+//kept when the line is written as EPD again.
+void CPGNPipeline::CheckPosition(const char *text, unsigned int length, PGNGAMERESULT &result,
+	std::string **outputs)
+{
+	result.plies = 0;
+	result.error = PGNERROR_NONE;
+	while(length > 0 && (text[length - 1] == '\r' || text[length - 1] == '\n' || text[length - 1] == ' '))
+		length--;
+	char line[256];
+	unsigned int n = length < sizeof(line) - 1 ? length : (unsigned int)sizeof(line) - 1;
+	memcpy(line, text, n);
+	line[n] = '\0';
+	CPosition pos;
+	if(!pos.SetFEN(line))
+	{
+		PGNTOKEN token;
+		memset(&token, 0, sizeof(token));
+		token.text = text;
+		token.length = (int)length;
+		SetError(result, PGNERROR_BAD_FEN, text, token);
+		return;
+	}
+	result.key = pos.GetKey();
+	if(outputs == NULL)
+		return;
+	//skip the four position fields, clocks are not operations
+	const char *ops = line;
+	for(int fields = 0; fields < 4 && *ops; fields++)
+	{
+		while(*ops == ' ')
+			ops++;
+		while(*ops && *ops != ' ')
+			ops++;
+	}
+	while(*ops == ' ')
+		ops++;
+	int opsLength = *ops >= '0' && *ops <= '9' ? 0 : (int)strlen(ops);
+	AppendPosition(pos, outputs[PGNOUTPUT_FEN], outputs[PGNOUTPUT_EPD], ops, opsLength);
+	std::string *pgn = outputs[PGNOUTPUT_PGN];
+	if(pgn != NULL)
+	{
+		char fen[128];
+		pos.GetFEN(fen, sizeof(fen));
+		*pgn += "[SetUp \"1\"]\n[FEN \"";
+		*pgn += fen;
+		*pgn += "\"]\n\n*\n\n";
+	}
+}
+
+void CPGNPipeline::Cancel()
+{
+	std::lock_guard<std::mutex> lock(m_lock);
+	m_cancel = true;
+	m_changed.notify_all();
+}
+
+//queues batch for the workers, waiting while too many are in flight
+bool CPGNPipeline::Submit(PGNBATCH *batch)
+{
+	std::unique_lock<std::mutex> lock(m_lock);
+	while(m_inFlight >= m_maxInFlight && !m_cancel)
+		m_changed.wait(lock);
+	if(m_cancel)
+	{
+		delete batch;
+		return false;
+	}
+	batch->sequence = m_batches++;
+	m_inFlight++;
+	m_queue.push_back(batch);
+	m_changed.notify_all();
+	return true;
+}
+
+//Finds the game boundaries: a tag line after movetext starts a new PGN
+//game, comments are followed so a '[' inside one does not count. In a FEN
+//or EPD file every line that is not blank is a game. The file is looked
+//at through a moving window like CPGNReader does.
+void CPGNPipeline::Split()
+{
+	CMappedFile file;
+	if(!file.Open(m_path))
+	{
+		std::lock_guard<std::mutex> lock(m_lock);
+		m_openFailed = m_splitDone = true;
+		m_changed.notify_all();
+		return;
+	}
+	unsigned long long size = file.GetSize();
+	{
+		std::lock_guard<std::mutex> lock(m_lock);
+		m_size = size;
+	}
+	unsigned long long viewOffset = 0, viewEnd = 0;
+	const char *view = NULL;
+	unsigned long long gameStart = 0, p = 0;
+	unsigned int line = 1, gameLine = 1, game = 0;
+	bool movetext = false, content = false, linestart = true, newline = false;
+	bool lines = m_format == GAMEINDEX_LINES;
+	char comment = 0;
+	PGNBATCH *batch = new PGNBATCH;
+	batch->firstGame = 0;
+	for(;;)
+	{
+		bool end = p >= size;
+		if(!end && p >= viewEnd)
+		{
+			//keep the whole current game in view
+			if(p - gameStart >= PGN_WINDOW - PGN_MAX_GAME)
+				gameStart = p;
+			viewOffset = gameStart;
+			view = file.Map(viewOffset, PGN_WINDOW);
+			if(view == NULL)
+				break;
+			viewEnd = viewOffset + PGN_WINDOW < size ? viewOffset + PGN_WINDOW : size;
+		}
+		char c = end ? '[' : view[p - viewOffset];
+		if(end || (lines ? newline : c == '[' && linestart && movetext && comment == 0))
+		{
+			if(content || (end && !batch->starts.empty()))
+			{
+				if(content)
+				{
+					batch->starts.push_back((unsigned int)batch->text.size());
+					batch->offsets.push_back(gameStart);
+					batch->lines.push_back(gameLine);
+					const char *text = view + (gameStart - viewOffset);
+					batch->text.insert(batch->text.end(), text, text + (size_t)(p - gameStart));
+					game++;
+				}
+				if(end || batch->text.size() >= PGNBATCH_BYTES || batch->starts.size() >= PGNBATCH_GAMES)
+				{
+					//Submit deletes the batch once cancelled
+					if(!Submit(batch))
+					{
+						batch = NULL;
+						break;
+					}
+					batch = new PGNBATCH;
+					batch->firstGame = game;
+				}
+			}
+			if(end)
+				break;
+			gameStart = p;
+			gameLine = line;
+			movetext = content = false;
+		}
+		newline = c == '\n';
+		//only PGN has comments, EPD operations end with ';'
+		if(comment != 0)
+		{
+			if(c == comment)
+				comment = 0;
+		}
+		else if(!lines && c == '{')
+		{
+			comment = '}';
+		}
+		else if(!lines && (c == ';' || (c == '%' && linestart)))
+		{
+			comment = '\n';
+		}
+		if(c == '\n')
+			line++;
+		if(c != ' ' && c != '\t' && c != '\r' && c != '\n')
+		{
+			content = true;
+			//anything but a tag line at the start of a line is movetext
+			if(linestart && c != '[')
+				movetext = true;
+			linestart = false;
+		}
+		else if(c == '\n')
+		{
+			linestart = true;
+		}
+		p++;
+	}
+	delete batch;
+	std::lock_guard<std::mutex> lock(m_lock);
+	m_splitDone = true;
+	m_changed.notify_all();
+}
+
+void CPGNPipeline::Work(int worker)
+{
+	for(;;)
+	{
+		PGNBATCH *batch;
+		{
+			std::unique_lock<std::mutex> lock(m_lock);
+			while(m_queue.empty() && !m_splitDone && !m_cancel)
+				m_changed.wait(lock);
+			if(m_queue.empty() || m_cancel)
+				return;
+			batch = m_queue.front();
+			m_queue.pop_front();
+		}
+		unsigned int games = (unsigned int)batch->starts.size();
+		batch->results.resize(games);
+		std::string *outputs[PGNOUTPUT_COUNT];
+		for(int i = 0; i < PGNOUTPUT_COUNT; i++)
+			outputs[i] = m_outputs[i] != NULL ? &batch->output[i] : NULL;
+		for(unsigned int i = 0; i < games; i++)
+		{
+			unsigned int start = batch->starts[i];
+			unsigned int end = i + 1 < games ? batch->starts[i + 1] : (unsigned int)batch->text.size();
+			PGNGAMERESULT &result = batch->results[i];
+			memset(&result, 0, sizeof(result));
+			result.game = batch->firstGame + i;
+			result.offset = batch->offsets[i];
+			result.line = batch->lines[i];
+			if(m_gameProc != NULL)
+				m_gameProc(&batch->text[start], end - start, result, worker, m_gameParam);
+			else if(m_format == GAMEINDEX_LINES)
+				CheckPosition(&batch->text[start], end - start, result, outputs);
+			else
+				CheckGame(&batch->text[start], end - start, result, outputs);
+		}
+		std::lock_guard<std::mutex> lock(m_lock);
+		m_done[batch->sequence] = batch;
+		m_changed.notify_all();
+	}
+}
+
+int CPGNPipeline::GetThreadCount(int threads)
+{
+	if(threads <= 0)
+		threads = (int)std::thread::hardware_concurrency();
+	return threads > 0 ? threads : 1;
+}
+
+bool CPGNPipeline::Run(const char *path, int format, int threads, PGNRESULTPROC proc, void *param)
+{
+	threads = GetThreadCount(threads);
+	m_path = path;
+	m_format = format;
+	m_batches = m_inFlight = 0;
+	m_maxInFlight = 4 * threads;
+	m_splitDone = m_cancel = m_openFailed = false;
+	m_size = m_bytes = 0;
+	m_games = m_errors = 0;
+
+	std::thread splitter(&CPGNPipeline::Split, this);
+	std::vector<std::thread> workers;
+	for(int i = 0; i < threads; i++)
+		workers.push_back(std::thread(&CPGNPipeline::Work, this, i));
+
+	//collect the batches in the order they were split
+	for(unsigned int next = 0;; next++)
+	{
+		PGNBATCH *batch;
+		{
+			std::unique_lock<std::mutex> lock(m_lock);
+			while(m_done.find(next) == m_done.end() && !m_cancel && !(m_splitDone && next >= m_batches))
+				m_changed.wait(lock);
+			if(m_cancel || m_done.find(next) == m_done.end())
+				break;
+			batch = m_done[next];
+			m_done.erase(next);
+			m_inFlight--;
+			m_changed.notify_all();
+		}
+		for(int i = 0; i < PGNOUTPUT_COUNT; i++)
+		{
+			if(m_outputs[i] != NULL && !batch->output[i].empty())
+				fwrite(batch->output[i].data(), 1, batch->output[i].size(), m_outputs[i]);
+		}
+		m_bytes += batch->text.size();
+		for(size_t i = 0; i < batch->results.size(); i++)
+		{
+			m_games++;
+			if(batch->results[i].error != PGNERROR_NONE)
+				m_errors++;
+			if(proc != NULL)
+				proc(batch->results[i], param);
+		}
+		delete batch;
+	}
+
+	splitter.join();
+	for(size_t i = 0; i < workers.size(); i++)
+		workers[i].join();
+	std::map<unsigned int, PGNBATCH *>::iterator it;
+	for(it = m_done.begin(); it != m_done.end(); ++it)
+		delete it->second;
+	m_done.clear();
+	for(size_t i = 0; i < m_queue.size(); i++)
+		delete m_queue[i];
+	m_queue.clear();
+	return !m_openFailed;
+}
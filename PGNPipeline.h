@@ -0,0 +1,135 @@
+// PGNPipeline.h : parallel parsing, validation and conversion of game files
+//
+// Like Position.h this file has no MFC dependency. A splitter thread finds
+// the game boundaries and hands batches of games to one worker per core;
+// each worker replays its games, variations included, on its own
+// CPosition and writes them out in the formats asked for. Results and
+// output come back on the calling thread in file order.
+/////////////////////////////////////////////////////////////////////////////
+
+#if !defined(PGNPIPELINE_H)
+#define PGNPIPELINE_H
+
+#include <stdio.h>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Position.h"
+#include "GameIndex.h"
+#include "PGNReader.h"
+
+enum PGN_ERROR {PGNERROR_NONE, PGNERROR_BAD_FEN, PGNERROR_BAD_MOVE,
+			PGNERROR_EMPTY_VARIATION, PGNERROR_TOO_LONG};
+
+//formats a game can be written in: the game itself with its moves in
+//standard SAN, or the position before every main line move and after the
+//last one as FEN or EPD
+enum PGN_OUTPUT {PGNOUTPUT_PGN, PGNOUTPUT_FEN, PGNOUTPUT_EPD, PGNOUTPUT_COUNT};
+
+struct PGNGAMERESULT
+{
+	unsigned int game;
+	//where the game starts, lines and columns count from 1
+	unsigned long long offset;
+	unsigned int line;
+	//main line moves, and the position after them
+	int plies;
+	BITBOARD key;
+	//the token at fault when error is not PGNERROR_NONE
+	int error;
+	unsigned long long errorOffset;
+	unsigned int errorLine;
+	unsigned int errorColumn;
+	char errorText[16];
+};
+
+typedef void (*PGNRESULTPROC)(const PGNGAMERESULT &result, void *param);
+//replays one game on worker thread worker (0 .. threads - 1), text is not
+//nul terminated
+typedef void (*PGNGAMEPROC)(const char *text, unsigned int length, PGNGAMERESULT &result,
+	int worker, void *param);
+
+//text of consecutive games, copied out of the file by the splitter
+struct PGNBATCH
+{
+	unsigned int sequence;
+	unsigned int firstGame;
+	std::vector<char> text;
+	std::vector<unsigned int> starts;
+	std::vector<unsigned long long> offsets;
+	std::vector<unsigned int> lines;
+	std::vector<PGNGAMERESULT> results;
+	std::string output[PGNOUTPUT_COUNT];
+};
+
+class CPGNPipeline
+{
+private:
+	std::mutex m_lock;
+	std::condition_variable m_changed;
+	std::deque<PGNBATCH *> m_queue;
+	std::map<unsigned int, PGNBATCH *> m_done;
+	unsigned int m_batches;
+	unsigned int m_inFlight;
+	unsigned int m_maxInFlight;
+	bool m_splitDone;
+	bool m_cancel;
+	bool m_openFailed;
+	const char *m_path;
+	int m_format;
+	FILE *m_outputs[PGNOUTPUT_COUNT];
+	PGNGAMEPROC m_gameProc;
+	void *m_gameParam;
+	unsigned long long m_size;
+	unsigned long long m_bytes;
+	unsigned int m_games;
+	unsigned int m_errors;
+
+	void Split();
+	void Work(int worker);
+	bool Submit(PGNBATCH *batch);
+
+public:
+	CPGNPipeline();
+
+	//Every game read is also written to fp in the output format, by the
+	//calling thread and in file order. Games with errors are left out.
+	void SetOutput(int output, FILE *fp)	{ m_outputs[output] = fp; }
+	//Games are handed to proc on the worker threads instead of being
+	//checked, for callers that gather something else from them. Only for
+	//PGN files, outputs are not written.
+	void SetGameProc(PGNGAMEPROC proc, void *param)	{ m_gameProc = proc; m_gameParam = param; }
+
+	//Checks every game of path, a GAMEINDEX_FORMAT file, with threads
+	//workers (0 = one per core) and calls proc for each, in file order, on
+	//the calling thread. False when the file cannot be read.
+	bool Run(const char *path, int format, int threads, PGNRESULTPROC proc, void *param);
+	//may be called from proc to stop early
+	void Cancel();
+
+	//progress, the counts so far while Run is going
+	unsigned long long GetSize() const		{ return m_size; }
+	unsigned long long GetBytes() const		{ return m_bytes; }
+	unsigned int GetGames() const			{ return m_games; }
+	unsigned int GetErrors() const			{ return m_errors; }
+
+	//Replays one PGN game, text need not be nul terminated. The game is
+	//appended to outputs[PGN_OUTPUT] for each of them that is not NULL.
+	static void CheckGame(const char *text, unsigned int length, PGNGAMERESULT &result,
+		std::string **outputs = NULL);
+	//same for a FEN or EPD line
+	static void CheckPosition(const char *text, unsigned int length, PGNGAMERESULT &result,
+		std::string **outputs = NULL);
+	static const char *GetErrorString(int error);
+	//marks token of game as the error and works out its line and column
+	static void SetError(PGNGAMERESULT &result, int error, const char *game, const PGNTOKEN &token);
+	//workers Run starts for threads, 0 being one per core
+	static int GetThreadCount(int threads);
+};
+
+#endif
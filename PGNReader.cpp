@@ -0,0 +1,255 @@
+// PGNReader.cpp : streaming tokenizer for PGN files
+//
+
+#include <string.h>
+
+#include "PGNReader.h"
+
+static bool IsSpace(char c)
+{
+	return c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '\f' || c == '\v';
+}
+
+static bool IsDigit(char c)
+{
+	return c >= '0' && c <= '9';
+}
+
+//characters a SAN, move number or result token is made of
+static bool IsSymbol(char c)
+{
+	return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || IsDigit(c) ||
+		c == '_' || c == '+' || c == '#' || c == '=' || c == ':' || c == '-' || c == '/';
+}
+
+CPGNReader::CPGNReader()
+{
+	m_data = m_end = m_pos = m_game = NULL;
+	m_viewOffset = 0;
+	m_inMovetext = false;
+	m_gameDone = true;
+	m_depth = 0;
+}
+
+bool CPGNReader::Open(const char *path)
+{
+	Close();
+	if(!m_file.Open(path))
+		return false;
+	if(m_file.GetSize() > 0 && !MoveView(NULL))
+	{
+		Close();
+		return false;
+	}
+	return true;
+}
+
+void CPGNReader::Attach(const char *data, size_t size)
+{
+	Close();
+	m_data = m_pos = m_game = data;
+	m_end = data + size;
+}
+
+void CPGNReader::Close()
+{
+	m_file.Close();
+	m_data = m_end = m_pos = m_game = NULL;
+	m_viewOffset = 0;
+	m_gameDone = true;
+}
+
+unsigned long long CPGNReader::GetSize() const
+{
+	return m_file.IsOpen() ? m_file.GetSize() : (unsigned long long)(m_end - m_data);
+}
+
+//maps the window starting at pos, the start of the file for NULL
+bool CPGNReader::MoveView(const char *pos)
+{
+	unsigned long long offset = pos == NULL ? 0 : m_viewOffset + (pos - m_data);
+	const char *data = m_file.Map(offset, PGN_WINDOW);
+	if(data == NULL)
+		return false;
+	unsigned long long end = offset + PGN_WINDOW;
+	if(end > m_file.GetSize())
+		end = m_file.GetSize();
+	m_data = m_pos = m_game = data;
+	m_end = data + (size_t)(end - offset);
+	m_viewOffset = offset;
+	return true;
+}
+
+void CPGNReader::SkipSpace()
+{
+	while(m_pos < m_end && IsSpace(*m_pos))
+		m_pos++;
+}
+
+bool CPGNReader::NextGame()
+{
+	PGNTOKEN token;
+	while(NextToken(token) != PGN_END)
+		;
+	SkipSpace();
+	if(m_file.IsOpen() && m_end - m_pos < PGN_MAX_GAME &&
+		m_viewOffset + (m_end - m_data) < m_file.GetSize())
+	{
+		if(!MoveView(m_pos))
+			return false;
+	}
+	m_game = m_pos;
+	m_inMovetext = false;
+	m_depth = 0;
+	m_gameDone = m_pos >= m_end;
+	return !m_gameDone;
+}
+
+int CPGNReader::NextToken(PGNTOKEN &token)
+{
+	token.value = NULL;
+	token.valueLength = 0;
+	while(!m_gameDone)
+	{
+		SkipSpace();
+		if(m_pos >= m_end)
+			break;
+		const char *start = m_pos;
+		char c = *m_pos;
+		//escape lines are left to other programs
+		if(c == '%' && (m_pos == m_data || m_pos[-1] == '\n'))
+		{
+			while(m_pos < m_end && *m_pos != '\n')
+				m_pos++;
+			continue;
+		}
+		if(c == '[')
+		{
+			//tags after the movetext belong to the next game
+			if(m_inMovetext)
+				break;
+			m_pos++;
+			SkipSpace();
+			token.text = m_pos;
+			while(m_pos < m_end && IsSymbol(*m_pos))
+				m_pos++;
+			token.length = (int)(m_pos - token.text);
+			while(m_pos < m_end && *m_pos != '"' && *m_pos != ']' && *m_pos != '\n')
+				m_pos++;
+			if(m_pos < m_end && *m_pos == '"')
+			{
+				token.value = ++m_pos;
+				while(m_pos < m_end && *m_pos != '"' && *m_pos != '\n')
+					m_pos += *m_pos == '\\' && m_pos + 1 < m_end ? 2 : 1;
+				token.valueLength = (int)(m_pos - token.value);
+			}
+			while(m_pos < m_end && *m_pos != ']' && *m_pos != '\n')
+				m_pos++;
+			if(m_pos < m_end && *m_pos == ']')
+				m_pos++;
+			token.type = PGN_TAG;
+			return token.type;
+		}
+		m_inMovetext = true;
+		if(c == '{' || c == ';')
+		{
+			char end = c == '{' ? '}' : '\n';
+			token.text = ++m_pos;
+			while(m_pos < m_end && *m_pos != end)
+				m_pos++;
+			token.length = (int)(m_pos - token.text);
+			if(m_pos < m_end)
+				m_pos++;
+			token.type = PGN_COMMENT;
+			return token.type;
+		}
+		token.text = m_pos;
+		token.length = 1;
+		if(c == '(')
+		{
+			m_pos++;
+			m_depth++;
+			token.type = PGN_VARIATION_START;
+			return token.type;
+		}
+		if(c == ')')
+		{
+			m_pos++;
+			if(m_depth == 0)
+				continue;
+			m_depth--;
+			token.type = PGN_VARIATION_END;
+			return token.type;
+		}
+		if(c == '*')
+		{
+			m_pos++;
+			token.type = PGN_RESULT;
+		}
+		else if(c == '$' || c == '!' || c == '?')
+		{
+			//"$14", or the "!?" style NAGs left as they are
+			if(c == '$')
+			{
+				token.text = ++m_pos;
+				while(m_pos < m_end && IsDigit(*m_pos))
+					m_pos++;
+			}
+			else
+			{
+				while(m_pos < m_end && (*m_pos == '!' || *m_pos == '?'))
+					m_pos++;
+			}
+			token.length = (int)(m_pos - token.text);
+			token.type = PGN_NAG;
+			return token.type;
+		}
+		else if(IsSymbol(c))
+		{
+			while(m_pos < m_end && IsSymbol(*m_pos))
+				m_pos++;
+			token.length = (int)(m_pos - start);
+			if(IsDigit(c))
+			{
+				if((token.length == 3 && (strncmp(start, "1-0", 3) == 0 || strncmp(start, "0-1", 3) == 0)) ||
+					(token.length == 7 && strncmp(start, "1/2-1/2", 7) == 0))
+				{
+					token.type = PGN_RESULT;
+				}
+				else if(c == '0' && token.length >= 3 && start[1] == '-')
+				{
+					//castling written with zeros
+					token.type = PGN_SAN;
+					return token.type;
+				}
+				else
+				{
+					while(m_pos < m_end && *m_pos == '.')
+						m_pos++;
+					token.type = PGN_MOVENUMBER;
+					return token.type;
+				}
+			}
+			else
+			{
+				token.type = PGN_SAN;
+				return token.type;
+			}
+		}
+		else
+		{
+			//'.', '<' ... and anything else outside the grammar
+			m_pos++;
+			continue;
+		}
+		//a result at the top level ends the game
+		if(m_depth == 0)
+			m_gameDone = true;
+		return token.type;
+	}
+	m_gameDone = true;
+	token.text = m_pos;
+	token.length = 0;
+	token.type = PGN_END;
+	return token.type;
+}
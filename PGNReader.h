@@ -0,0 +1,73 @@
+// PGNReader.h : streaming tokenizer for PGN files
+//
+// Like Position.h this file has no MFC dependency. Tokens point into the
+// mapped file (or the attached buffer) and are not copied; they stay valid
+// until the next call to NextGame.
+/////////////////////////////////////////////////////////////////////////////
+
+#if !defined(PGNREADER_H)
+#define PGNREADER_H
+
+#include "MappedFile.h"
+
+//bytes of the file in view at a time
+#define PGN_WINDOW			(32 * 1024 * 1024)
+//a game starting closer than this to the end of the view moves the view
+//to it, so no game longer than this is cut short
+#define PGN_MAX_GAME		(1024 * 1024)
+
+enum PGN_TOKEN {PGN_END, PGN_TAG, PGN_MOVENUMBER, PGN_SAN, PGN_NAG, PGN_COMMENT,
+			PGN_VARIATION_START, PGN_VARIATION_END, PGN_RESULT};
+
+struct PGNTOKEN
+{
+	int type;
+	//tag name, move, comment without its delimiters, NAG without the '$'
+	const char *text;
+	int length;
+	//tag value without the quotes, escapes left in
+	const char *value;
+	int valueLength;
+};
+
+class CPGNReader
+{
+private:
+	CMappedFile m_file;
+	//view of the file starting at m_viewOffset, or the attached buffer
+	const char *m_data;
+	const char *m_end;
+	unsigned long long m_viewOffset;
+	const char *m_pos;
+	const char *m_game;
+	bool m_inMovetext;
+	bool m_gameDone;
+	int m_depth;
+
+	bool MoveView(const char *pos);
+	void SkipSpace();
+
+public:
+	CPGNReader();
+
+	bool Open(const char *path);
+	void Attach(const char *data, size_t size);
+	void Close();
+	unsigned long long GetSize() const;
+
+	//Steps over what is left of the current game to the start of the next
+	//one, false at the end of the file.
+	bool NextGame();
+	//next token of the current game, PGN_END after its result or when the
+	//tags of the next game start
+	int NextToken(PGNTOKEN &token);
+
+	//file offset of the current game and, once NextToken returned PGN_END,
+	//the number of bytes it takes
+	unsigned long long GetGameOffset() const	{ return m_viewOffset + (m_game - m_data); }
+	unsigned long long GetGameLength() const	{ return (unsigned long long)(m_pos - m_game); }
+	//bytes read so far
+	unsigned long long GetOffset() const		{ return m_viewOffset + (m_pos - m_data); }
+};
+
+#endif
@@ -0,0 +1,122 @@
+// PGNTree.cpp : move statistics of a position from the games of a PGN file
+//
+// Not part of the NetChess project, build it on its own:
+//   g++ -O2 -pthread -o pgntree PGNTree.cpp OpeningTree.cpp PGNPipeline.cpp GameIndex.cpp PGNReader.cpp MappedFile.cpp San.cpp Position.cpp MoveGen.cpp Zobrist.cpp
+//   cl /O2 /EHsc PGNTree.cpp OpeningTree.cpp PGNPipeline.cpp GameIndex.cpp PGNReader.cpp MappedFile.cpp San.cpp Position.cpp MoveGen.cpp Zobrist.cpp
+//
+// Usage:
+//   pgntree [-threads n] file.pgn [fen]
+//   pgntree -bench n file.pgn
+// Opens the <file>.nctree opening tree of the file, building it on all
+// cores first when it is missing or stale, and lists the moves played from
+// the position (the start position by default) with their games, score
+// and average rating. -bench looks up the positions of n random walks
+// down the tree and reports the average time of a lookup.
+/////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+
+#include "OpeningTree.h"
+#include "San.h"
+
+static unsigned int g_seed = 1;
+
+static unsigned int NextRandom()
+{
+	g_seed = g_seed * 1103515245 + 12345;
+	return (g_seed >> 16) & 0x7fff;
+}
+
+static double Seconds(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char *argv[])
+{
+	int threads = 0, bench = 0;
+	int arg = 1;
+	for(; arg + 1 < argc && argv[arg][0] == '-'; arg += 2)
+	{
+		if(strcmp(argv[arg], "-threads") == 0)
+			threads = atoi(argv[arg + 1]);
+		else if(strcmp(argv[arg], "-bench") == 0)
+			bench = atoi(argv[arg + 1]);
+		else
+			break;
+	}
+	if(arg >= argc || argc - arg > 2 || threads < 0 || bench < 0)
+	{
+		fprintf(stderr, "usage: pgntree [-threads n] file.pgn [fen]\n");
+		fprintf(stderr, "       pgntree -bench n file.pgn\n");
+		return 2;
+	}
+	CPosition pos;
+	pos.SetStartPosition();
+	if(arg + 1 < argc && !pos.SetFEN(argv[arg + 1]))
+	{
+		fprintf(stderr, "bad FEN: %s\n", argv[arg + 1]);
+		return 2;
+	}
+
+	COpeningTree tree;
+	CPGNPipeline pipeline;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	if(!tree.Open(argv[arg], pipeline, threads))
+	{
+		fprintf(stderr, "%s: cannot open or build the opening tree\n", argv[arg]);
+		return 1;
+	}
+	printf("%u games, %llu moves, opened in %.3f s\n", tree.GetGames(), tree.GetEntries(), Seconds(start));
+
+	std::vector<OPENINGTREEENTRY> moves;
+	if(bench > 0)
+	{
+		//walk down the tree picking a move at random, weighted by its games
+		unsigned long long lookups = 0, found = 0;
+		double elapsed = 0;
+		CPosition root = pos;
+		for(int i = 0; i < bench; i++)
+		{
+			pos = root;
+			UNDOINFO undo;
+			for(;;)
+			{
+				start = std::chrono::steady_clock::now();
+				unsigned int games = tree.Find(pos.GetKey(), moves);
+				elapsed += Seconds(start);
+				lookups++;
+				found += moves.size();
+				if(games == 0)
+					break;
+				unsigned int pick = (NextRandom() << 15 | NextRandom()) % games;
+				size_t k = 0;
+				while(pick >= moves[k].games)
+					pick -= moves[k++].games;
+				pos.MakeMove(moves[k].move, undo);
+			}
+		}
+		printf("%llu lookups, %.1f moves per position, %.3f us per lookup\n", lookups,
+			(double)found / lookups, elapsed * 1e6 / lookups);
+		return 0;
+	}
+
+	start = std::chrono::steady_clock::now();
+	unsigned int games = tree.Find(pos.GetKey(), moves);
+	double elapsed = Seconds(start);
+	printf("%u games went on from the position, found in %.3f ms\n", games, elapsed * 1e3);
+	for(size_t i = 0; i < moves.size(); i++)
+	{
+		char san[MAX_SAN];
+		FormatSAN(pos, moves[i].move, san);
+		printf("%-8s %8u  %5.1f%%", san, moves[i].games,
+			moves[i].scored > 0 ? 50.0 * moves[i].points / moves[i].scored : 0.0);
+		if(moves[i].rated > 0)
+			printf("  %4u", (unsigned int)(moves[i].ratings / moves[i].rated));
+		printf("\n");
+	}
+	return 0;
+}
@@ -0,0 +1,146 @@
+// Perft.cpp : command line node counter for the move generator
+//
+// Not part of the NetChess project, build it on its own:
+//   g++ -O2 -o perft Perft.cpp Position.cpp MoveGen.cpp Zobrist.cpp
+//   cl /O2 /EHsc Perft.cpp Position.cpp MoveGen.cpp Zobrist.cpp
+//
+// Usage:
+//   perft depth [fen]             count nodes from fen (default start position)
+//   perft -divide depth [fen]     also print the count below each root move
+//   perft -suite file [maxdepth]  run a suite such as perftsuite.epd, one
+//                                 position per line: <fen> ;D1 20 ;D2 400 ...
+// Reports nodes per second and exits with 1 if any suite count does not match.
+/////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "MoveGen.h"
+
+static const char g_startFEN[] = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+
+static void FormatMove(CHESSMOVE move, char *buf)
+{
+	static const char promotion[] = " nbrq";
+	int from = GetMoveFrom(move);
+	int to = GetMoveTo(move);
+	buf[0] = (char)('a' + SquareFile(from));
+	buf[1] = (char)('1' + SquareRank(from));
+	buf[2] = (char)('a' + SquareFile(to));
+	buf[3] = (char)('1' + SquareRank(to));
+	buf[4] = IsPromotionMove(move) ? promotion[GetPromotionType(move)] : 0;
+	buf[5] = 0;
+}
+
+static double ElapsedSeconds(clock_t start)
+{
+	return (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+static void PrintSpeed(unsigned long long nodes, double seconds)
+{
+	if(seconds > 0)
+		printf("%llu nodes in %.3f s, %.0f nps\n", nodes, seconds, nodes / seconds);
+	else
+		printf("%llu nodes\n", nodes);
+}
+
+static int RunPerft(const char *fen, int depth, bool divide)
+{
+	CPosition pos;
+	if(!pos.SetFEN(fen))
+	{
+		fprintf(stderr, "invalid FEN: %s\n", fen);
+		return 2;
+	}
+	clock_t start = clock();
+	unsigned long long nodes = 0;
+	if(divide && depth > 0)
+	{
+		CMoveList list;
+		GenerateLegalMoves(pos, list);
+		for(int i = 0; i < list.GetSize(); i++)
+		{
+			char name[6];
+			UNDOINFO undo;
+			pos.MakeMove(list[i], undo);
+			unsigned long long count = Perft(pos, depth - 1);
+			pos.UnmakeMove(list[i], undo);
+			FormatMove(list[i], name);
+			printf("%s: %llu\n", name, count);
+			nodes += count;
+		}
+	}
+	else
+	{
+		nodes = Perft(pos, depth);
+	}
+	PrintSpeed(nodes, ElapsedSeconds(start));
+	return 0;
+}
+
+static int RunSuite(const char *filename, int maxdepth)
+{
+	FILE *fp = fopen(filename, "r");
+	if(fp == NULL)
+	{
+		fprintf(stderr, "cannot open %s\n", filename);
+		return 2;
+	}
+	char line[1024];
+	int failures = 0;
+	unsigned long long total = 0;
+	clock_t start = clock();
+	while(fgets(line, sizeof(line), fp))
+	{
+		char *field = strchr(line, ';');
+		if(field == NULL)
+			continue;
+		*field++ = 0;
+		CPosition pos;
+		if(!pos.SetFEN(line))
+		{
+			fprintf(stderr, "invalid FEN: %s\n", line);
+			failures++;
+			continue;
+		}
+		while(field != NULL)
+		{
+			int depth;
+			unsigned long long expected;
+			if(sscanf(field, " D%d %llu", &depth, &expected) == 2 && depth <= maxdepth)
+			{
+				unsigned long long nodes = Perft(pos, depth);
+				total += nodes;
+				if(nodes != expected)
+				{
+					printf("FAIL %s depth %d: %llu, expected %llu\n", line, depth, nodes, expected);
+					failures++;
+				}
+			}
+			field = strchr(field, ';');
+			if(field != NULL)
+				field++;
+		}
+	}
+	fclose(fp);
+	PrintSpeed(total, ElapsedSeconds(start));
+	printf("%d failure(s)\n", failures);
+	return failures ? 1 : 0;
+}
+
+int main(int argc, char *argv[])
+{
+	if(argc >= 3 && strcmp(argv[1], "-suite") == 0)
+		return RunSuite(argv[2], argc >= 4 ? atoi(argv[3]) : 64);
+	if(argc >= 3 && strcmp(argv[1], "-divide") == 0)
+		return RunPerft(argc >= 4 ? argv[3] : g_startFEN, atoi(argv[2]), true);
+	if(argc >= 2)
+		return RunPerft(argc >= 3 ? argv[2] : g_startFEN, atoi(argv[1]), false);
+	fprintf(stderr, "usage: perft depth [fen]\n"
+		"       perft -divide depth [fen]\n"
+		"       perft -suite file [maxdepth]\n");
+	return 2;
+}
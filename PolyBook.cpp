@@ -0,0 +1,157 @@
+// PolyBook.cpp : builds and probes Polyglot opening books
+//
+// Not part of the NetChess project, build it on its own:
+//   g++ -O2 -pthread -o polybook PolyBook.cpp PolyglotBook.cpp OpeningTree.cpp PGNPipeline.cpp GameIndex.cpp PGNReader.cpp MappedFile.cpp San.cpp Position.cpp MoveGen.cpp Zobrist.cpp
+//   cl /O2 /EHsc PolyBook.cpp PolyglotBook.cpp OpeningTree.cpp PGNPipeline.cpp GameIndex.cpp PGNReader.cpp MappedFile.cpp San.cpp Position.cpp MoveGen.cpp Zobrist.cpp
+//
+// Usage:
+//   polybook [-threads n] [-min n] file.pgn [book.bin]
+//   polybook book.bin [fen]
+//   polybook -bench n book.bin
+// Given a PGN file, writes the moves of its opening tree (built on all
+// cores when it is missing or stale) played in at least n games (1 by
+// default) as a book, <file>.bin by default. Given a book, lists the book
+// moves of the position (the start position by default) with their weight
+// and learn fields. -bench plays n games from the book, picking the moves
+// at random by weight, and reports the average time of a lookup.
+/////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <string>
+
+#include "PolyglotBook.h"
+#include "San.h"
+
+static unsigned int g_seed = 1;
+
+static unsigned int NextRandom()
+{
+	g_seed = g_seed * 1103515245 + 12345;
+	return (g_seed >> 16) & 0x7fff;
+}
+
+static double Seconds(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static bool IsPGNFile(const char *path)
+{
+	size_t length = strlen(path);
+	return length > 4 && (strcmp(path + length - 4, ".pgn") == 0 || strcmp(path + length - 4, ".PGN") == 0);
+}
+
+static int BuildBook(const char *path, const char *bookpath, int threads, unsigned int minGames)
+{
+	std::string book;
+	if(bookpath == NULL)
+	{
+		book.assign(path, strlen(path) - 4);
+		book += ".bin";
+		bookpath = book.c_str();
+	}
+	COpeningTree tree;
+	CPGNPipeline pipeline;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	if(!tree.Open(path, pipeline, threads))
+	{
+		fprintf(stderr, "%s: cannot open or build the opening tree\n", path);
+		return 1;
+	}
+	printf("%u games, %llu moves, opened in %.3f s\n", tree.GetGames(), tree.GetEntries(), Seconds(start));
+	start = std::chrono::steady_clock::now();
+	if(!CPolyglotBook::Build(tree, bookpath, minGames))
+	{
+		fprintf(stderr, "%s: cannot write the book\n", bookpath);
+		return 1;
+	}
+	CPolyglotBook polyglot;
+	polyglot.Open(bookpath);
+	printf("%s: %llu entries, written in %.3f s\n", bookpath, polyglot.GetCount(), Seconds(start));
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	int threads = 0, minGames = 1, bench = 0;
+	int arg = 1;
+	for(; arg + 1 < argc && argv[arg][0] == '-'; arg += 2)
+	{
+		if(strcmp(argv[arg], "-threads") == 0)
+			threads = atoi(argv[arg + 1]);
+		else if(strcmp(argv[arg], "-min") == 0)
+			minGames = atoi(argv[arg + 1]);
+		else if(strcmp(argv[arg], "-bench") == 0)
+			bench = atoi(argv[arg + 1]);
+		else
+			break;
+	}
+	if(arg >= argc || argc - arg > 2 || threads < 0 || minGames < 1 || bench < 0)
+	{
+		fprintf(stderr, "usage: polybook [-threads n] [-min n] file.pgn [book.bin]\n");
+		fprintf(stderr, "       polybook book.bin [fen]\n");
+		fprintf(stderr, "       polybook -bench n book.bin\n");
+		return 2;
+	}
+	if(IsPGNFile(argv[arg]))
+		return BuildBook(argv[arg], arg + 1 < argc ? argv[arg + 1] : NULL, threads, (unsigned int)minGames);
+
+	CPosition pos;
+	pos.SetStartPosition();
+	if(arg + 1 < argc && !pos.SetFEN(argv[arg + 1]))
+	{
+		fprintf(stderr, "bad FEN: %s\n", argv[arg + 1]);
+		return 2;
+	}
+	CPolyglotBook book;
+	if(!book.Open(argv[arg]))
+	{
+		fprintf(stderr, "%s: not a Polyglot book\n", argv[arg]);
+		return 1;
+	}
+	printf("%llu entries\n", book.GetCount());
+
+	if(bench > 0)
+	{
+		unsigned long long lookups = 0, plies = 0;
+		double elapsed = 0;
+		CPosition root = pos;
+		for(int i = 0; i < bench; i++)
+		{
+			pos = root;
+			UNDOINFO undo;
+			for(;;)
+			{
+				std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+				CHESSMOVE move = book.PickMove(pos, NextRandom() << 1 | (NextRandom() & 1));
+				elapsed += Seconds(start);
+				lookups++;
+				if(move == NULL_MOVE)
+					break;
+				pos.MakeMove(move, undo);
+				plies++;
+			}
+		}
+		printf("%llu lookups, %.1f book plies per game, %.3f us per lookup\n", lookups,
+			(double)plies / bench, elapsed * 1e6 / lookups);
+		return 0;
+	}
+
+	std::vector<BOOKMOVE> moves;
+	book.Find(pos, moves);
+	unsigned int total = 0;
+	for(size_t i = 0; i < moves.size(); i++)
+		total += moves[i].weight;
+	printf("%u book moves\n", (unsigned int)moves.size());
+	for(size_t i = 0; i < moves.size(); i++)
+	{
+		char san[MAX_SAN];
+		FormatSAN(pos, moves[i].move, san);
+		printf("%-8s %5u  %5.1f%%  %u\n", san, moves[i].weight,
+			total > 0 ? 100.0 * moves[i].weight / total : 0.0, moves[i].learn);
+	}
+	return 0;
+}
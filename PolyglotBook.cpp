@@ -0,0 +1,291 @@
+// PolyglotBook.cpp : Polyglot opening books
+//
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+
+#include "PolyglotBook.h"
+
+//entries per sampled key; a lookup maps two blocks and searches them
+#define POLYGLOT_BLOCK			256
+//entries mapped at a time while the keys are sampled or the tree is read
+#define POLYGLOT_SCAN			(1024 * 1024)
+#define POLYGLOT_BUILD_BUFFER	8192
+
+static BITBOARD ReadBig64(const unsigned char *p)
+{
+	BITBOARD value = 0;
+	for(int i = 0; i < 8; i++)
+		value = value << 8 | p[i];
+	return value;
+}
+
+static unsigned int ReadBig32(const unsigned char *p)
+{
+	return (unsigned int)p[0] << 24 | (unsigned int)p[1] << 16 | (unsigned int)p[2] << 8 | p[3];
+}
+
+static void WriteBig(unsigned char *p, unsigned long long value, int bytes)
+{
+	for(int i = bytes - 1; i >= 0; i--)
+	{
+		p[i] = (unsigned char)value;
+		value >>= 8;
+	}
+}
+
+static void ReadEntry(const unsigned char *p, POLYGLOTENTRY &entry)
+{
+	entry.key = ReadBig64(p);
+	entry.move = (unsigned short)(p[8] << 8 | p[9]);
+	entry.weight = (unsigned short)(p[10] << 8 | p[11]);
+	entry.learn = ReadBig32(p + 12);
+}
+
+static bool Heavier(const BOOKMOVE &a, const BOOKMOVE &b)
+{
+	return a.weight > b.weight;
+}
+
+static bool HeavierEntry(const POLYGLOTENTRY &a, const POLYGLOTENTRY &b)
+{
+	return a.weight > b.weight;
+}
+
+CPolyglotBook::CPolyglotBook()
+{
+	m_count = 0;
+}
+
+bool CPolyglotBook::Open(const char *path)
+{
+	Close();
+	if(!m_file.Open(path))
+		return false;
+	if(m_file.GetSize() % POLYGLOT_ENTRY_SIZE != 0)
+	{
+		Close();
+		return false;
+	}
+	m_count = m_file.GetSize() / POLYGLOT_ENTRY_SIZE;
+	m_blocks.reserve((size_t)((m_count + POLYGLOT_BLOCK - 1) / POLYGLOT_BLOCK));
+	for(unsigned long long first = 0; first < m_count; first += POLYGLOT_SCAN)
+	{
+		unsigned long long count = m_count - first < POLYGLOT_SCAN ? m_count - first : POLYGLOT_SCAN;
+		const unsigned char *view = (const unsigned char *)m_file.Map(first * POLYGLOT_ENTRY_SIZE,
+			(size_t)count * POLYGLOT_ENTRY_SIZE);
+		if(view == NULL)
+		{
+			Close();
+			return false;
+		}
+		for(unsigned long long i = 0; i < count; i += POLYGLOT_BLOCK)
+			m_blocks.push_back(ReadBig64(view + i * POLYGLOT_ENTRY_SIZE));
+	}
+	return true;
+}
+
+void CPolyglotBook::Close()
+{
+	m_file.Close();
+	m_count = 0;
+	m_blocks.clear();
+}
+
+//The first entry with the key is in the block before the first block that
+//starts at or after the key, or at the start of that block, so a lookup
+//maps those two blocks and does a binary search in them. The run of
+//entries for the key can go on past them.
+int CPolyglotBook::Find(CPosition &pos, std::vector<BOOKMOVE> &moves)
+{
+	moves.clear();
+	if(!IsOpen() || m_count == 0)
+		return 0;
+	BITBOARD key = pos.GetKey();
+	size_t block = std::lower_bound(m_blocks.begin(), m_blocks.end(), key) - m_blocks.begin();
+	if(block > 0)
+		block--;
+	unsigned long long low = (unsigned long long)block * POLYGLOT_BLOCK;
+	unsigned long long high = low + 2 * POLYGLOT_BLOCK;
+	if(high > m_count)
+		high = m_count;
+	const unsigned char *view = (const unsigned char *)m_file.Map(low * POLYGLOT_ENTRY_SIZE,
+		(size_t)(high - low) * POLYGLOT_ENTRY_SIZE);
+	if(view == NULL)
+		return 0;
+	size_t count = (size_t)(high - low);
+	size_t found = 0;
+	while(count > 0)
+	{
+		size_t half = count / 2;
+		if(ReadBig64(view + (found + half) * POLYGLOT_ENTRY_SIZE) < key)
+		{
+			found += half + 1;
+			count -= half + 1;
+		}
+		else
+		{
+			count = half;
+		}
+	}
+	for(unsigned long long next = low + found; next < m_count; next++)
+	{
+		if(next == high)
+		{
+			low = next;
+			high = low + POLYGLOT_BLOCK < m_count ? low + POLYGLOT_BLOCK : m_count;
+			view = (const unsigned char *)m_file.Map(low * POLYGLOT_ENTRY_SIZE,
+				(size_t)(high - low) * POLYGLOT_ENTRY_SIZE);
+			if(view == NULL)
+				break;
+		}
+		POLYGLOTENTRY entry;
+		ReadEntry(view + (size_t)(next - low) * POLYGLOT_ENTRY_SIZE, entry);
+		if(entry.key != key)
+			break;
+		BOOKMOVE move;
+		move.move = FromPolyglotMove(pos, entry.move);
+		if(move.move == NULL_MOVE)
+			continue;
+		move.weight = entry.weight;
+		move.learn = entry.learn;
+		moves.push_back(move);
+	}
+	std::stable_sort(moves.begin(), moves.end(), Heavier);
+	return (int)moves.size();
+}
+
+CHESSMOVE CPolyglotBook::PickMove(CPosition &pos, unsigned int random)
+{
+	std::vector<BOOKMOVE> moves;
+	if(Find(pos, moves) == 0)
+		return NULL_MOVE;
+	unsigned int total = 0;
+	for(size_t i = 0; i < moves.size(); i++)
+		total += moves[i].weight;
+	//a book of weightless entries picks any of them
+	if(total == 0)
+		return moves[random % moves.size()].move;
+	unsigned int pick = (unsigned int)((unsigned long long)(random & 0xffff) * total >> 16);
+	for(size_t i = 0; i < moves.size(); i++)
+	{
+		if(pick < moves[i].weight)
+			return moves[i].move;
+		pick -= moves[i].weight;
+	}
+	return moves[0].move;
+}
+
+unsigned short CPolyglotBook::ToPolyglotMove(CHESSMOVE move)
+{
+	int from = GetMoveFrom(move);
+	int to = GetMoveTo(move);
+	if(GetMoveFlag(move) == MOVEFLAG_CASTLE)
+		to = to > from ? from + 3 : from - 4;
+	int promotion = IsPromotionMove(move) ? GetPromotionType(move) : 0;
+	return (unsigned short)(to | from << 6 | promotion << 12);
+}
+
+CHESSMOVE CPolyglotBook::FromPolyglotMove(CPosition &pos, unsigned short move)
+{
+	int from = (move >> 6) & 63;
+	int to = move & 63;
+	int promotion = (move >> 12) & 7;
+	int piece = pos.GetPiece(from);
+	if(piece == NO_PIECE || promotion > PT_QUEEN)
+		return NULL_MOVE;
+	if(PieceType(piece) == PT_KING && pos.GetPiece(to) == MakePiece(PieceSide(piece), PT_ROOK))
+		to = to > from ? from + 2 : from - 2;
+	return pos.FindMove(from, to, promotion != 0 ? promotion : PT_QUEEN);
+}
+
+//writes the entries of one position, heaviest first
+static bool WritePosition(FILE *fp, std::vector<POLYGLOTENTRY> &entries, unsigned long long &written)
+{
+	std::stable_sort(entries.begin(), entries.end(), HeavierEntry);
+	for(size_t i = 0; i < entries.size(); i++)
+	{
+		unsigned char buf[POLYGLOT_ENTRY_SIZE];
+		WriteBig(buf, entries[i].key, 8);
+		WriteBig(buf + 8, entries[i].move, 2);
+		WriteBig(buf + 10, entries[i].weight, 2);
+		WriteBig(buf + 12, entries[i].learn, 4);
+		if(fwrite(buf, POLYGLOT_ENTRY_SIZE, 1, fp) != 1)
+			return false;
+		written++;
+	}
+	entries.clear();
+	return true;
+}
+
+//Turns the tree entries of one position into book entries. The tree has
+//them in key order, so the book comes out sorted as it is written.
+static bool AddPosition(FILE *fp, const std::vector<OPENINGTREEENTRY> &moves, unsigned int minGames,
+	std::vector<POLYGLOTENTRY> &entries, unsigned long long &written)
+{
+	unsigned long long heaviest = 0;
+	for(size_t i = 0; i < moves.size(); i++)
+	{
+		unsigned long long weight = (unsigned long long)moves[i].points + moves[i].games - moves[i].scored;
+		if(moves[i].games >= minGames && weight > heaviest)
+			heaviest = weight;
+	}
+	for(size_t i = 0; i < moves.size(); i++)
+	{
+		if(moves[i].games < minGames)
+			continue;
+		unsigned long long weight = (unsigned long long)moves[i].points + moves[i].games - moves[i].scored;
+		if(heaviest > 0xffff)
+			weight = weight * 0xffff / heaviest;
+		if(weight == 0)
+			continue;
+		POLYGLOTENTRY entry;
+		entry.key = moves[i].key;
+		entry.move = CPolyglotBook::ToPolyglotMove(moves[i].move);
+		entry.weight = (unsigned short)weight;
+		entry.learn = moves[i].games;
+		entries.push_back(entry);
+	}
+	return WritePosition(fp, entries, written);
+}
+
+bool CPolyglotBook::Build(COpeningTree &tree, const char *bookpath, unsigned int minGames)
+{
+	if(!tree.IsOpen())
+		return false;
+	FILE *fp = fopen(bookpath, "wb");
+	if(fp == NULL)
+		return false;
+	std::vector<OPENINGTREEENTRY> buffer(POLYGLOT_BUILD_BUFFER);
+	std::vector<OPENINGTREEENTRY> moves;
+	std::vector<POLYGLOTENTRY> entries;
+	unsigned long long written = 0;
+	bool ok = true;
+	for(unsigned long long first = 0; ok && first < tree.GetEntries(); )
+	{
+		size_t count = tree.GetEntries(first, &buffer[0], buffer.size());
+		if(count == 0)
+		{
+			ok = false;
+			break;
+		}
+		for(size_t i = 0; ok && i < count; i++)
+		{
+			if(!moves.empty() && moves[0].key != buffer[i].key)
+			{
+				ok = AddPosition(fp, moves, minGames, entries, written);
+				moves.clear();
+			}
+			moves.push_back(buffer[i]);
+		}
+		first += count;
+	}
+	if(ok && !moves.empty())
+		ok = AddPosition(fp, moves, minGames, entries, written);
+	if(fclose(fp) != 0)
+		ok = false;
+	if(!ok)
+		remove(bookpath);
+	return ok;
+}
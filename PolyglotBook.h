@@ -0,0 +1,73 @@
+// PolyglotBook.h : Polyglot opening books
+//
+// Like Position.h this file has no MFC dependency. A Polyglot book is a
+// file of 16 byte big-endian entries sorted by the key of the position,
+// and CPosition::GetKey() is the Polyglot key, so a book is looked up in
+// place through a memory mapping. Books are built from the opening tree of
+// a PGN file.
+/////////////////////////////////////////////////////////////////////////////
+
+#if !defined(POLYGLOTBOOK_H)
+#define POLYGLOTBOOK_H
+
+#include <vector>
+
+#include "MappedFile.h"
+#include "OpeningTree.h"
+
+#define POLYGLOT_ENTRY_SIZE		16
+
+//a book entry, in host byte order
+struct POLYGLOTENTRY
+{
+	BITBOARD key;
+	//bits 0-5 to square, bits 6-11 from square, bits 12-14 promotion piece;
+	//castling is the king taking its own rook
+	unsigned short move;
+	unsigned short weight;
+	unsigned int learn;
+};
+
+//a book move legal in the position it was looked up for
+struct BOOKMOVE
+{
+	CHESSMOVE move;
+	unsigned short weight;
+	unsigned int learn;
+};
+
+class CPolyglotBook
+{
+private:
+	CMappedFile m_file;
+	unsigned long long m_count;
+	//key of the first entry of every POLYGLOT_BLOCK entries
+	std::vector<BITBOARD> m_blocks;
+
+public:
+	CPolyglotBook();
+
+	bool Open(const char *path);
+	void Close();
+	bool IsOpen() const							{ return m_file.IsOpen(); }
+	unsigned long long GetCount() const			{ return m_count; }
+
+	//Replaces moves with the book moves of pos, the heaviest first. Entries
+	//whose move is not legal in pos are skipped. Returns the number of moves.
+	int Find(CPosition &pos, std::vector<BOOKMOVE> &moves);
+	//book move of pos picked at random in proportion to the weights, with
+	//random a number from 0 to 0xffff; NULL_MOVE when pos is not in the book
+	CHESSMOVE PickMove(CPosition &pos, unsigned int random);
+
+	static unsigned short ToPolyglotMove(CHESSMOVE move);
+	//legal move of pos for a book move, NULL_MOVE when there is none
+	static CHESSMOVE FromPolyglotMove(CPosition &pos, unsigned short move);
+
+	//Writes the moves of tree played in at least minGames games as a book.
+	//The weight of a move is the half points its side scored, with games
+	//without a result counted as draws, scaled to 16 bits per position, and
+	//learn holds the number of games it was played in.
+	static bool Build(COpeningTree &tree, const char *bookpath, unsigned int minGames = 1);
+};
+
+#endif
@@ -0,0 +1,619 @@
+// Position.cpp : implementation of the CPosition class
+//
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "Position.h"
+
+enum RAY_DIRECTION {RAY_NORTH, RAY_EAST, RAY_NORTHEAST, RAY_NORTHWEST,
+			RAY_SOUTH, RAY_WEST, RAY_SOUTHEAST, RAY_SOUTHWEST};
+
+static BITBOARD g_knightAttacks[64];
+static BITBOARD g_kingAttacks[64];
+static BITBOARD g_pawnAttacks[2][64];
+static BITBOARD g_rays[8][64];
+static BITBOARD g_between[64][64];
+static int g_castlingMask[64];
+
+static const char g_pieceChars[] = "PNBRQKpnbrqk";
+
+static void InitAttackTables()
+{
+	static const int rayFile[8] = { 0, 1, 1, -1,  0, -1,  1, -1};
+	static const int rayRank[8] = { 1, 0, 1,  1, -1,  0, -1, -1};
+	static const int knightFile[8] = { 1, 2, 2, 1, -1, -2, -2, -1};
+	static const int knightRank[8] = { 2, 1, -1, -2, -2, -1, 1, 2};
+
+	memset(g_between, 0, sizeof(g_between));
+	for(int sq = 0; sq < 64; sq++)
+	{
+		int file = SquareFile(sq);
+		int rank = SquareRank(sq);
+		g_knightAttacks[sq] = g_kingAttacks[sq] = 0;
+		g_pawnAttacks[SIDE_WHITE][sq] = g_pawnAttacks[SIDE_BLACK][sq] = 0;
+		for(int i = 0; i < 8; i++)
+		{
+			int f = file + knightFile[i];
+			int r = rank + knightRank[i];
+			if(f >= 0 && f < 8 && r >= 0 && r < 8)
+				g_knightAttacks[sq] |= SquareBit(MakeSquare(f, r));
+			f = file + rayFile[i];
+			r = rank + rayRank[i];
+			if(f >= 0 && f < 8 && r >= 0 && r < 8)
+				g_kingAttacks[sq] |= SquareBit(MakeSquare(f, r));
+		}
+		if(rank < 7)
+		{
+			if(file > 0) g_pawnAttacks[SIDE_WHITE][sq] |= SquareBit(sq + 7);
+			if(file < 7) g_pawnAttacks[SIDE_WHITE][sq] |= SquareBit(sq + 9);
+		}
+		if(rank > 0)
+		{
+			if(file > 0) g_pawnAttacks[SIDE_BLACK][sq] |= SquareBit(sq - 9);
+			if(file < 7) g_pawnAttacks[SIDE_BLACK][sq] |= SquareBit(sq - 7);
+		}
+		for(int dir = 0; dir < 8; dir++)
+		{
+			BITBOARD ray = 0;
+			int f = file + rayFile[dir];
+			int r = rank + rayRank[dir];
+			while(f >= 0 && f < 8 && r >= 0 && r < 8)
+			{
+				int to = MakeSquare(f, r);
+				g_between[sq][to] = ray;
+				ray |= SquareBit(to);
+				f += rayFile[dir];
+				r += rayRank[dir];
+			}
+			g_rays[dir][sq] = ray;
+		}
+		g_castlingMask[sq] = CASTLE_WHITE_KING | CASTLE_WHITE_QUEEN | CASTLE_BLACK_KING | CASTLE_BLACK_QUEEN;
+	}
+	g_castlingMask[0] &= ~CASTLE_WHITE_QUEEN;
+	g_castlingMask[4] &= ~(CASTLE_WHITE_KING | CASTLE_WHITE_QUEEN);
+	g_castlingMask[7] &= ~CASTLE_WHITE_KING;
+	g_castlingMask[56] &= ~CASTLE_BLACK_QUEEN;
+	g_castlingMask[60] &= ~(CASTLE_BLACK_KING | CASTLE_BLACK_QUEEN);
+	g_castlingMask[63] &= ~CASTLE_BLACK_KING;
+}
+
+//tables are filled before main() so lookups never need a guard
+static struct CAttackTableInit
+{
+	CAttackTableInit() { InitAttackTables(); }
+} g_attackTableInit;
+
+//attacks along one ray stopping at (and including) the first blocker
+static inline BITBOARD RayAttacks(int dir, int sq, BITBOARD occupied)
+{
+	BITBOARD attacks = g_rays[dir][sq];
+	BITBOARD blockers = attacks & occupied;
+	if(blockers)
+	{
+		int blocker = dir < RAY_SOUTH ? FirstSquare(blockers) : LastSquare(blockers);
+		attacks ^= g_rays[dir][blocker];
+	}
+	return attacks;
+}
+
+BITBOARD CPosition::KnightAttacks(int sq)
+{
+	return g_knightAttacks[sq];
+}
+
+BITBOARD CPosition::KingAttacks(int sq)
+{
+	return g_kingAttacks[sq];
+}
+
+BITBOARD CPosition::PawnAttacks(int side, int sq)
+{
+	return g_pawnAttacks[side][sq];
+}
+
+BITBOARD CPosition::BishopAttacks(int sq, BITBOARD occupied)
+{
+	return RayAttacks(RAY_NORTHEAST, sq, occupied) | RayAttacks(RAY_NORTHWEST, sq, occupied) |
+		RayAttacks(RAY_SOUTHEAST, sq, occupied) | RayAttacks(RAY_SOUTHWEST, sq, occupied);
+}
+
+BITBOARD CPosition::RookAttacks(int sq, BITBOARD occupied)
+{
+	return RayAttacks(RAY_NORTH, sq, occupied) | RayAttacks(RAY_EAST, sq, occupied) |
+		RayAttacks(RAY_SOUTH, sq, occupied) | RayAttacks(RAY_WEST, sq, occupied);
+}
+
+BITBOARD CPosition::Between(int from, int to)
+{
+	return g_between[from][to];
+}
+
+CPosition::CPosition()
+{
+	Clear();
+}
+
+void CPosition::Clear()
+{
+	memset(m_pieces, 0, sizeof(m_pieces));
+	m_occupied[SIDE_WHITE] = m_occupied[SIDE_BLACK] = 0;
+	m_all = 0;
+	memset(m_board, NO_PIECE, sizeof(m_board));
+	m_side = SIDE_WHITE;
+	m_castling = 0;
+	m_epSquare = NO_SQUARE;
+	m_halfMoveClock = 0;
+	m_fullMoveNumber = 1;
+	m_key = ZobristWhiteToMove();
+}
+
+void CPosition::SetStartPosition()
+{
+	SetFEN("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1");
+}
+
+void CPosition::PutPiece(int sq, int piece)
+{
+	if(m_board[sq] != NO_PIECE)
+		RemovePiece(sq);
+	if(piece == NO_PIECE)
+		return;
+	BITBOARD bit = SquareBit(sq);
+	m_board[sq] = (unsigned char)piece;
+	m_pieces[piece] |= bit;
+	m_occupied[PieceSide(piece)] |= bit;
+	m_all |= bit;
+	m_key ^= ZobristPiece(piece, sq);
+}
+
+void CPosition::RemovePiece(int sq)
+{
+	int piece = m_board[sq];
+	if(piece == NO_PIECE)
+		return;
+	BITBOARD bit = SquareBit(sq);
+	m_board[sq] = NO_PIECE;
+	m_pieces[piece] &= ~bit;
+	m_occupied[PieceSide(piece)] &= ~bit;
+	m_all &= ~bit;
+	m_key ^= ZobristPiece(piece, sq);
+}
+
+void CPosition::SetSide(int side)
+{
+	if(side != m_side)
+		m_key ^= ZobristWhiteToMove();
+	m_side = side;
+}
+
+void CPosition::SetCastling(int castling)
+{
+	m_key ^= ZobristCastling(m_castling ^ castling);
+	m_castling = castling;
+}
+
+bool CPosition::SetFEN(const char *fen)
+{
+	Clear();
+	if(fen == NULL)
+		return false;
+	const char *p = fen;
+	while(*p == ' ')
+		p++;
+	int file = 0, rank = 7;
+	for(; *p && *p != ' '; p++)
+	{
+		if(*p == '/')
+		{
+			file = 0;
+			rank--;
+		}
+		else if(*p >= '1' && *p <= '8')
+		{
+			file += *p - '0';
+		}
+		else
+		{
+			const char *pc = strchr(g_pieceChars, *p);
+			if(pc == NULL || file > 7 || rank < 0)
+			{
+				Clear();
+				return false;
+			}
+			PutPiece(MakeSquare(file, rank), (int)(pc - g_pieceChars));
+			file++;
+		}
+	}
+	while(*p == ' ')
+		p++;
+	if(*p == 'b')
+		m_side = SIDE_BLACK;
+	if(*p)
+		p++;
+	while(*p == ' ')
+		p++;
+	for(; *p && *p != ' '; p++)
+	{
+		switch(*p)
+		{
+		case 'K': m_castling |= CASTLE_WHITE_KING; break;
+		case 'Q': m_castling |= CASTLE_WHITE_QUEEN; break;
+		case 'k': m_castling |= CASTLE_BLACK_KING; break;
+		case 'q': m_castling |= CASTLE_BLACK_QUEEN; break;
+		default: break;
+		}
+	}
+	while(*p == ' ')
+		p++;
+	if(*p >= 'a' && *p <= 'h' && p[1] >= '1' && p[1] <= '8')
+	{
+		m_epSquare = MakeSquare(p[0] - 'a', p[1] - '1');
+		p += 2;
+	}
+	else if(*p == '-')
+	{
+		p++;
+	}
+	//the clocks are optional, EPD lines stop after the en passant field
+	while(*p == ' ')
+		p++;
+	if(*p >= '0' && *p <= '9')
+	{
+		m_halfMoveClock = atoi(p);
+		while(*p && *p != ' ')
+			p++;
+		while(*p == ' ')
+			p++;
+		if(*p >= '1' && *p <= '9')
+			m_fullMoveNumber = atoi(p);
+	}
+	m_key = ComputeKey();
+	return true;
+}
+
+int CPosition::GetFEN(char *buf, int size) const
+{
+	char fen[100];
+	int n = 0;
+	for(int rank = 7; rank >= 0; rank--)
+	{
+		int empty = 0;
+		for(int file = 0; file < 8; file++)
+		{
+			int piece = m_board[MakeSquare(file, rank)];
+			if(piece == NO_PIECE)
+			{
+				empty++;
+				continue;
+			}
+			if(empty > 0)
+				fen[n++] = (char)('0' + empty);
+			empty = 0;
+			fen[n++] = g_pieceChars[piece];
+		}
+		if(empty > 0)
+			fen[n++] = (char)('0' + empty);
+		if(rank > 0)
+			fen[n++] = '/';
+	}
+	fen[n++] = ' ';
+	fen[n++] = m_side == SIDE_WHITE ? 'w' : 'b';
+	fen[n++] = ' ';
+	if(m_castling == 0)
+		fen[n++] = '-';
+	if(m_castling & CASTLE_WHITE_KING) fen[n++] = 'K';
+	if(m_castling & CASTLE_WHITE_QUEEN) fen[n++] = 'Q';
+	if(m_castling & CASTLE_BLACK_KING) fen[n++] = 'k';
+	if(m_castling & CASTLE_BLACK_QUEEN) fen[n++] = 'q';
+	fen[n++] = ' ';
+	if(m_epSquare == NO_SQUARE)
+	{
+		fen[n++] = '-';
+	}
+	else
+	{
+		fen[n++] = (char)('a' + SquareFile(m_epSquare));
+		fen[n++] = (char)('1' + SquareRank(m_epSquare));
+	}
+	n += sprintf(&fen[n], " %d %d", m_halfMoveClock, m_fullMoveNumber);
+	if(buf == NULL || size <= 0)
+		return n;
+	if(n >= size)
+		n = size - 1;
+	memcpy(buf, fen, n);
+	buf[n] = '\0';
+	return n;
+}
+
+int CPosition::GetKingSquare(int side) const
+{
+	BITBOARD king = m_pieces[MakePiece(side, PT_KING)];
+	return king ? FirstSquare(king) : NO_SQUARE;
+}
+
+//Polyglot key of the position. As in Polyglot the en passant file only
+//counts when a pawn of the side to move can actually capture there.
+BITBOARD CPosition::GetKey() const
+{
+	BITBOARD key = m_key;
+	if(m_epSquare != NO_SQUARE && (PawnAttacks(m_side ^ 1, m_epSquare) & GetPieces(m_side, PT_PAWN)))
+		key ^= ZobristEnPassant(SquareFile(m_epSquare));
+	return key;
+}
+
+//m_key built from scratch, GetKey() is kept equal to this incrementally
+BITBOARD CPosition::ComputeKey() const
+{
+	BITBOARD key = ZobristCastling(m_castling);
+	if(m_side == SIDE_WHITE)
+		key ^= ZobristWhiteToMove();
+	for(int sq = 0; sq < 64; sq++)
+	{
+		if(m_board[sq] != NO_PIECE)
+			key ^= ZobristPiece(m_board[sq], sq);
+	}
+	return key;
+}
+
+BITBOARD CPosition::GetPieceAttacks(int piece, int sq) const
+{
+	switch(PieceType(piece))
+	{
+	case PT_PAWN:	return g_pawnAttacks[PieceSide(piece)][sq];
+	case PT_KNIGHT:	return g_knightAttacks[sq];
+	case PT_BISHOP:	return BishopAttacks(sq, m_all);
+	case PT_ROOK:	return RookAttacks(sq, m_all);
+	case PT_QUEEN:	return BishopAttacks(sq, m_all) | RookAttacks(sq, m_all);
+	case PT_KING:	return g_kingAttacks[sq];
+	default:		break;
+	}
+	return 0;
+}
+
+//pieces of side that attack sq
+BITBOARD CPosition::GetAttackers(int sq, int side) const
+{
+	BITBOARD queens = m_pieces[MakePiece(side, PT_QUEEN)];
+	return (g_pawnAttacks[side ^ 1][sq] & m_pieces[MakePiece(side, PT_PAWN)]) |
+		(g_knightAttacks[sq] & m_pieces[MakePiece(side, PT_KNIGHT)]) |
+		(g_kingAttacks[sq] & m_pieces[MakePiece(side, PT_KING)]) |
+		(BishopAttacks(sq, m_all) & (m_pieces[MakePiece(side, PT_BISHOP)] | queens)) |
+		(RookAttacks(sq, m_all) & (m_pieces[MakePiece(side, PT_ROOK)] | queens));
+}
+
+bool CPosition::IsSquareAttacked(int sq, int side) const
+{
+	return GetAttackers(sq, side) != 0;
+}
+
+bool CPosition::IsInCheck(int side) const
+{
+	int king = GetKingSquare(side);
+	if(king == NO_SQUARE)
+		return false;
+	return IsSquareAttacked(king, side ^ 1);
+}
+
+//true when piece standing on sq attacks the opposing king
+bool CPosition::GivesCheck(int piece, int sq) const
+{
+	if(piece == NO_PIECE)
+		return false;
+	return (GetPieceAttacks(piece, sq) & m_pieces[MakePiece(PieceSide(piece) ^ 1, PT_KING)]) != 0;
+}
+
+//Neither side can ever mate: bare kings, one minor piece, or only bishops
+//that all stand on squares of the same colour.
+bool CPosition::IsInsufficientMaterial() const
+{
+	const BITBOARD dark = 0xAA55AA55AA55AA55ULL;
+	if(m_pieces[WHITE_PAWN] | m_pieces[BLACK_PAWN] | m_pieces[WHITE_ROOK] | m_pieces[BLACK_ROOK] |
+		m_pieces[WHITE_QUEEN] | m_pieces[BLACK_QUEEN])
+		return false;
+	BITBOARD knights = m_pieces[WHITE_KNIGHT] | m_pieces[BLACK_KNIGHT];
+	BITBOARD bishops = m_pieces[WHITE_BISHOP] | m_pieces[BLACK_BISHOP];
+	if(BitCount(knights | bishops) <= 1)
+		return true;
+	return knights == 0 && ((bishops & dark) == 0 || (bishops & ~dark) == 0);
+}
+
+//Checks the move against the piece on its from square rather than the side
+//to move, so the view can ask about either colour (learning mode).
+bool CPosition::IsPseudoLegalMove(CHESSMOVE move) const
+{
+	int from = GetMoveFrom(move);
+	int to = GetMoveTo(move);
+	int flag = GetMoveFlag(move);
+	int piece = m_board[from];
+	if(piece == NO_PIECE || from == to)
+		return false;
+	int side = PieceSide(piece);
+	BITBOARD tobit = SquareBit(to);
+	if(m_occupied[side] & tobit)
+		return false;
+	if(m_board[to] != NO_PIECE && PieceType(m_board[to]) == PT_KING)
+		return false;
+
+	if(PieceType(piece) == PT_PAWN)
+	{
+		int forward = side == SIDE_WHITE ? 8 : -8;
+		int lastrank = side == SIDE_WHITE ? 7 : 0;
+		if(flag == MOVEFLAG_ENPASSANT)
+		{
+			return to == m_epSquare && (g_pawnAttacks[side][from] & tobit) &&
+				m_board[to - forward] == MakePiece(side ^ 1, PT_PAWN);
+		}
+		if(flag == MOVEFLAG_DOUBLEPUSH)
+		{
+			int startrank = side == SIDE_WHITE ? 1 : 6;
+			return SquareRank(from) == startrank && to == from + 2 * forward &&
+				m_board[from + forward] == NO_PIECE && m_board[to] == NO_PIECE;
+		}
+		if((SquareRank(to) == lastrank) != IsPromotionMove(move))
+			return false;
+		if(flag != MOVEFLAG_NORMAL && !IsPromotionMove(move))
+			return false;
+		if(to == from + forward)
+			return m_board[to] == NO_PIECE;
+		return (g_pawnAttacks[side][from] & tobit & m_occupied[side ^ 1]) != 0;
+	}
+
+	if(flag == MOVEFLAG_CASTLE)
+	{
+		if(PieceType(piece) != PT_KING)
+			return false;
+		int home = side == SIDE_WHITE ? 4 : 60;
+		int rook = MakePiece(side, PT_ROOK);
+		int right, rooksq;
+		if(from != home)
+			return false;
+		if(to == home + 2)
+		{
+			right = side == SIDE_WHITE ? CASTLE_WHITE_KING : CASTLE_BLACK_KING;
+			rooksq = home + 3;
+		}
+		else if(to == home - 2)
+		{
+			right = side == SIDE_WHITE ? CASTLE_WHITE_QUEEN : CASTLE_BLACK_QUEEN;
+			rooksq = home - 4;
+		}
+		else
+			return false;
+		if((m_castling & right) == 0 || m_board[rooksq] != rook)
+			return false;
+		if(g_between[from][rooksq] & m_all)
+			return false;
+		//the king may not castle out of or through check
+		int pass = (from + to) / 2;
+		return !IsSquareAttacked(from, side ^ 1) && !IsSquareAttacked(pass, side ^ 1);
+	}
+
+	if(flag != MOVEFLAG_NORMAL)
+		return false;
+	return (GetPieceAttacks(piece, from) & tobit) != 0;
+}
+
+bool CPosition::IsLegalMove(CHESSMOVE move)
+{
+	if(!IsPseudoLegalMove(move))
+		return false;
+	int side = PieceSide(m_board[GetMoveFrom(move)]);
+	UNDOINFO undo;
+	MakeMove(move, undo);
+	bool legal = !IsInCheck(side);
+	UnmakeMove(move, undo);
+	return legal;
+}
+
+//Builds the flagged move for a from/to pair, or NULL_MOVE when illegal.
+CHESSMOVE CPosition::FindMove(int from, int to, int promotiontype)
+{
+	int piece = m_board[from];
+	if(piece == NO_PIECE)
+		return NULL_MOVE;
+	int side = PieceSide(piece);
+	int flag = MOVEFLAG_NORMAL;
+	if(PieceType(piece) == PT_PAWN)
+	{
+		if(SquareRank(to) == (side == SIDE_WHITE ? 7 : 0))
+			flag = promotiontype;
+		else if(to == m_epSquare && SquareFile(to) != SquareFile(from))
+			flag = MOVEFLAG_ENPASSANT;
+		else if(to - from == 16 || from - to == 16)
+			flag = MOVEFLAG_DOUBLEPUSH;
+	}
+	else if(PieceType(piece) == PT_KING && (to - from == 2 || from - to == 2))
+	{
+		flag = MOVEFLAG_CASTLE;
+	}
+	CHESSMOVE move = EncodeMove(from, to, flag);
+	return IsLegalMove(move) ? move : NULL_MOVE;
+}
+
+void CPosition::MakeMove(CHESSMOVE move, UNDOINFO &undo)
+{
+	int from = GetMoveFrom(move);
+	int to = GetMoveTo(move);
+	int flag = GetMoveFlag(move);
+	int piece = m_board[from];
+
+	undo.captured = NO_PIECE;
+	undo.castling = (unsigned char)m_castling;
+	undo.epSquare = (unsigned char)m_epSquare;
+	undo.reserved = 0;
+	undo.halfMoveClock = (unsigned short)m_halfMoveClock;
+	undo.key = m_key;
+	if(piece == NO_PIECE)
+		return;
+	int side = PieceSide(piece);
+
+	if(flag == MOVEFLAG_ENPASSANT)
+	{
+		int capsq = side == SIDE_WHITE ? to - 8 : to + 8;
+		undo.captured = m_board[capsq];
+		RemovePiece(capsq);
+	}
+	else if(m_board[to] != NO_PIECE)
+	{
+		undo.captured = m_board[to];
+		RemovePiece(to);
+	}
+	RemovePiece(from);
+	PutPiece(to, IsPromotionMove(move) ? MakePiece(side, GetPromotionType(move)) : piece);
+	if(flag == MOVEFLAG_CASTLE)
+	{
+		int rookfrom = to > from ? to + 1 : to - 2;
+		int rookto = to > from ? to - 1 : to + 1;
+		PutPiece(rookto, m_board[rookfrom]);
+		RemovePiece(rookfrom);
+	}
+
+	int castling = m_castling & g_castlingMask[from] & g_castlingMask[to];
+	m_key ^= ZobristCastling(m_castling ^ castling);
+	m_castling = castling;
+	m_epSquare = flag == MOVEFLAG_DOUBLEPUSH ? (from + to) / 2 : NO_SQUARE;
+	if(PieceType(piece) == PT_PAWN || undo.captured != NO_PIECE)
+		m_halfMoveClock = 0;
+	else
+		m_halfMoveClock++;
+	if(side == SIDE_BLACK)
+		m_fullMoveNumber++;
+	SetSide(side ^ 1);
+}
+
+void CPosition::UnmakeMove(CHESSMOVE move, const UNDOINFO &undo)
+{
+	int from = GetMoveFrom(move);
+	int to = GetMoveTo(move);
+	int flag = GetMoveFlag(move);
+	int piece = m_board[to];
+	if(piece == NO_PIECE)
+		return;
+	int side = PieceSide(piece);
+
+	if(flag == MOVEFLAG_CASTLE)
+	{
+		int rookfrom = to > from ? to + 1 : to - 2;
+		int rookto = to > from ? to - 1 : to + 1;
+		PutPiece(rookfrom, m_board[rookto]);
+		RemovePiece(rookto);
+	}
+	RemovePiece(to);
+	PutPiece(from, IsPromotionMove(move) ? MakePiece(side, PT_PAWN) : piece);
+	if(undo.captured != NO_PIECE)
+	{
+		int capsq = to;
+		if(flag == MOVEFLAG_ENPASSANT)
+			capsq = side == SIDE_WHITE ? to - 8 : to + 8;
+		PutPiece(capsq, undo.captured);
+	}
+
+	m_castling = undo.castling;
+	m_epSquare = undo.epSquare;
+	m_halfMoveClock = undo.halfMoveClock;
+	if(side == SIDE_BLACK)
+		m_fullMoveNumber--;
+	m_side = side;
+	m_key = undo.key;
+}
@@ -0,0 +1,209 @@
+// Position.h : interface of the CPosition class
+//
+// Bitboard representation of a chess position. This file and Position.cpp
+// do not depend on MFC so the rules can be built and checked on any platform.
+// Squares are absolute: 0 = a1, 7 = h1, 56 = a8, 63 = h8.
+/////////////////////////////////////////////////////////////////////////////
+
+#if !defined(POSITION_H)
+#define POSITION_H
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+typedef unsigned __int64 BITBOARD;
+#else
+typedef unsigned long long BITBOARD;
+#endif
+
+typedef unsigned short CHESSMOVE;
+
+enum POSITION_SIDE {SIDE_WHITE, SIDE_BLACK};
+
+enum POSITION_PIECE_TYPE {PT_PAWN, PT_KNIGHT, PT_BISHOP, PT_ROOK, PT_QUEEN, PT_KING};
+
+enum POSITION_PIECE {WHITE_PAWN, WHITE_KNIGHT, WHITE_BISHOP, WHITE_ROOK, WHITE_QUEEN, WHITE_KING,
+			BLACK_PAWN, BLACK_KNIGHT, BLACK_BISHOP, BLACK_ROOK, BLACK_QUEEN, BLACK_KING,
+			NO_PIECE};
+
+enum CASTLING_RIGHTS {CASTLE_WHITE_KING = 1, CASTLE_WHITE_QUEEN = 2,
+			CASTLE_BLACK_KING = 4, CASTLE_BLACK_QUEEN = 8};
+
+//move flags stored in the top four bits of a CHESSMOVE
+enum MOVE_FLAG {MOVEFLAG_NORMAL, MOVEFLAG_PROMOTE_KNIGHT, MOVEFLAG_PROMOTE_BISHOP,
+			MOVEFLAG_PROMOTE_ROOK, MOVEFLAG_PROMOTE_QUEEN,
+			MOVEFLAG_ENPASSANT, MOVEFLAG_CASTLE, MOVEFLAG_DOUBLEPUSH};
+
+#define NO_SQUARE	64
+#define NULL_MOVE	0
+
+inline int MakeSquare(int file, int rank)		{ return rank * 8 + file; }
+inline int SquareFile(int sq)					{ return sq & 7; }
+inline int SquareRank(int sq)					{ return sq >> 3; }
+inline BITBOARD SquareBit(int sq)				{ return (BITBOARD)1 << sq; }
+
+inline int MakePiece(int side, int type)		{ return side * 6 + type; }
+inline int PieceSide(int piece)					{ return piece >= BLACK_PAWN ? SIDE_BLACK : SIDE_WHITE; }
+inline int PieceType(int piece)					{ return piece >= BLACK_PAWN ? piece - BLACK_PAWN : piece; }
+
+// 16 bit move: bits 0-5 from square, bits 6-11 to square, bits 12-15 MOVE_FLAG
+inline CHESSMOVE EncodeMove(int from, int to, int flag = MOVEFLAG_NORMAL)
+{
+	return (CHESSMOVE)(from | (to << 6) | (flag << 12));
+}
+inline int GetMoveFrom(CHESSMOVE move)			{ return move & 63; }
+inline int GetMoveTo(CHESSMOVE move)			{ return (move >> 6) & 63; }
+inline int GetMoveFlag(CHESSMOVE move)			{ return move >> 12; }
+inline bool IsPromotionMove(CHESSMOVE move)
+{
+	return GetMoveFlag(move) >= MOVEFLAG_PROMOTE_KNIGHT && GetMoveFlag(move) <= MOVEFLAG_PROMOTE_QUEEN;
+}
+//piece type a promotion move turns the pawn into
+inline int GetPromotionType(CHESSMOVE move)		{ return GetMoveFlag(move); }
+
+inline int BitCount(BITBOARD bb)
+{
+#if defined(_MSC_VER)
+	bb = bb - ((bb >> 1) & 0x5555555555555555ULL);
+	bb = (bb & 0x3333333333333333ULL) + ((bb >> 2) & 0x3333333333333333ULL);
+	bb = (bb + (bb >> 4)) & 0x0f0f0f0f0f0f0f0fULL;
+	return (int)((bb * 0x0101010101010101ULL) >> 56);
+#else
+	return __builtin_popcountll(bb);
+#endif
+}
+
+//index of the least significant set bit, bb must not be empty
+inline int FirstSquare(BITBOARD bb)
+{
+#if defined(_MSC_VER)
+	unsigned long index;
+	if(_BitScanForward(&index, (unsigned long)bb))
+		return (int)index;
+	_BitScanForward(&index, (unsigned long)(bb >> 32));
+	return (int)index + 32;
+#else
+	return __builtin_ctzll(bb);
+#endif
+}
+
+//index of the most significant set bit, bb must not be empty
+inline int LastSquare(BITBOARD bb)
+{
+#if defined(_MSC_VER)
+	unsigned long index;
+	if(_BitScanReverse(&index, (unsigned long)(bb >> 32)))
+		return (int)index + 32;
+	_BitScanReverse(&index, (unsigned long)bb);
+	return (int)index;
+#else
+	return 63 - __builtin_clzll(bb);
+#endif
+}
+
+inline int PopFirstSquare(BITBOARD &bb)
+{
+	int sq = FirstSquare(bb);
+	bb &= bb - 1;
+	return sq;
+}
+
+//Polyglot Random64 table, see Zobrist.cpp
+extern const BITBOARD g_zobristKeys[781];
+
+inline BITBOARD ZobristPiece(int piece, int sq)
+{
+	return g_zobristKeys[64 * (2 * PieceType(piece) + (PieceSide(piece) == SIDE_WHITE)) + sq];
+}
+inline BITBOARD ZobristCastling(int castling)
+{
+	BITBOARD key = 0;
+	for(int i = 0; i < 4; i++)
+	{
+		if(castling & (1 << i))
+			key ^= g_zobristKeys[768 + i];
+	}
+	return key;
+}
+inline BITBOARD ZobristEnPassant(int file)		{ return g_zobristKeys[772 + file]; }
+inline BITBOARD ZobristWhiteToMove()			{ return g_zobristKeys[780]; }
+
+//state needed to take back a move with CPosition::UnmakeMove
+struct UNDOINFO
+{
+	unsigned char captured;
+	unsigned char castling;
+	unsigned char epSquare;
+	unsigned char reserved;
+	unsigned short halfMoveClock;
+	BITBOARD key;
+};
+
+class CPosition
+{
+private:
+	BITBOARD m_pieces[12];
+	BITBOARD m_occupied[2];
+	BITBOARD m_all;
+	unsigned char m_board[64];
+	int m_side;
+	int m_castling;
+	int m_epSquare;
+	int m_halfMoveClock;
+	int m_fullMoveNumber;
+	BITBOARD m_key;
+
+public:
+	CPosition();
+
+	void Clear();
+	void SetStartPosition();
+	bool SetFEN(const char *fen);
+	int GetFEN(char *buf, int size) const;
+
+	void PutPiece(int sq, int piece);
+	void RemovePiece(int sq);
+	int GetPiece(int sq) const					{ return m_board[sq]; }
+	BITBOARD GetPieces(int piece) const			{ return m_pieces[piece]; }
+	BITBOARD GetPieces(int side, int type) const { return m_pieces[MakePiece(side, type)]; }
+	BITBOARD GetOccupied(int side) const		{ return m_occupied[side]; }
+	BITBOARD GetOccupied() const				{ return m_all; }
+
+	int GetSide() const							{ return m_side; }
+	void SetSide(int side);
+	int GetCastling() const						{ return m_castling; }
+	void SetCastling(int castling);
+	int GetEpSquare() const						{ return m_epSquare; }
+	void SetEpSquare(int sq)					{ m_epSquare = sq; }
+	int GetHalfMoveClock() const				{ return m_halfMoveClock; }
+	void SetHalfMoveClock(int count)			{ m_halfMoveClock = count; }
+	int GetFullMoveNumber() const				{ return m_fullMoveNumber; }
+	void SetFullMoveNumber(int number)			{ m_fullMoveNumber = number; }
+	int GetKingSquare(int side) const;
+
+	BITBOARD GetKey() const;
+	BITBOARD ComputeKey() const;
+
+	BITBOARD GetPieceAttacks(int piece, int sq) const;
+	BITBOARD GetAttackers(int sq, int side) const;
+	bool IsSquareAttacked(int sq, int side) const;
+	bool IsInCheck(int side) const;
+	bool IsInCheck() const						{ return IsInCheck(m_side); }
+	bool GivesCheck(int piece, int sq) const;
+	bool IsInsufficientMaterial() const;
+
+	bool IsPseudoLegalMove(CHESSMOVE move) const;
+	bool IsLegalMove(CHESSMOVE move);
+	CHESSMOVE FindMove(int from, int to, int promotiontype = PT_QUEEN);
+
+	void MakeMove(CHESSMOVE move, UNDOINFO &undo);
+	void UnmakeMove(CHESSMOVE move, const UNDOINFO &undo);
+
+	static BITBOARD KnightAttacks(int sq);
+	static BITBOARD KingAttacks(int sq);
+	static BITBOARD PawnAttacks(int side, int sq);
+	static BITBOARD BishopAttacks(int sq, BITBOARD occupied);
+	static BITBOARD RookAttacks(int sq, BITBOARD occupied);
+	static BITBOARD Between(int from, int to);
+};
+
+#endif
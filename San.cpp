@@ -0,0 +1,222 @@
+// San.cpp : standard algebraic notation for CPosition moves
+//
+
+#include <string.h>
+
+#include "San.h"
+
+static const char g_pieceLetters[] = "PNBRQK";
+
+static int PieceLetterType(char c)
+{
+	switch(c)
+	{
+	case 'P':	return PT_PAWN;
+	case 'N':	return PT_KNIGHT;
+	case 'B':	return PT_BISHOP;
+	case 'R':	return PT_ROOK;
+	case 'Q':	return PT_QUEEN;
+	case 'K':	return PT_KING;
+	}
+	return -1;
+}
+
+//squares of a file or rank, all squares for -1
+static BITBOARD FileSquares(int file)
+{
+	return file < 0 ? ~(BITBOARD)0 : 0x0101010101010101ULL << file;
+}
+
+static BITBOARD RankSquares(int rank)
+{
+	return rank < 0 ? ~(BITBOARD)0 : 0xFFULL << (8 * rank);
+}
+
+//Pieces of type that could move to to. Sliders, knights and kings attack
+//the same squares they are attacked from; pawns are found by looking back.
+static BITBOARD GetOrigins(const CPosition &pos, int side, int type, int to, bool capture)
+{
+	int piece = MakePiece(side, type);
+	BITBOARD pieces = pos.GetPieces(piece);
+	if(type != PT_PAWN)
+		return pos.GetPieceAttacks(piece, to) & pieces;
+	if(capture)
+		return CPosition::PawnAttacks(side ^ 1, to) & pieces;
+	int back = side == SIDE_WHITE ? -8 : 8;
+	int from = to + back;
+	if(from < 0 || from > 63)
+		return 0;
+	if(pieces & SquareBit(from))
+		return SquareBit(from);
+	int startrank = side == SIDE_WHITE ? 1 : 6;
+	if(pos.GetPiece(from) == NO_PIECE && from + back >= 0 && from + back < 64 &&
+		SquareRank(from + back) == startrank)
+		return pieces & SquareBit(from + back);
+	return 0;
+}
+
+//The candidates are taken from the attack tables and each is checked with
+//CPosition::FindMove, so only legal moves match. A move that fits more than
+//one legal move is not SAN and gives NULL_MOVE.
+CHESSMOVE ParseSAN(CPosition &pos, const char *san)
+{
+	int side = pos.GetSide();
+	int len = (int)strlen(san);
+	while(len > 0 && (san[len - 1] == '+' || san[len - 1] == '#' || san[len - 1] == '!' || san[len - 1] == '?'))
+		len--;
+	if(len < 2)
+		return NULL_MOVE;
+
+	if((san[0] == 'O' || san[0] == '0') && san[1] == '-' && len >= 3 && san[2] == san[0])
+	{
+		int home = side == SIDE_WHITE ? 4 : 60;
+		if(pos.GetPiece(home) != MakePiece(side, PT_KING))
+			return NULL_MOVE;
+		return pos.FindMove(home, len >= 5 ? home - 2 : home + 2, PT_QUEEN);
+	}
+
+	int type = PT_PAWN;
+	int promotion = PT_QUEEN;
+	const char *p = san;
+	const char *end = san + len;
+	if(san[0] >= 'A' && san[0] <= 'Z')
+	{
+		type = PieceLetterType(san[0]);
+		if(type <= PT_PAWN)
+			return NULL_MOVE;
+		p++;
+	}
+	//"e8=Q", "e8Q" or long algebraic "e7e8q"
+	if(type == PT_PAWN && end - p >= 3)
+	{
+		char c = end[-1];
+		if(c >= 'a' && c <= 'z' && end[-2] >= '1' && end[-2] <= '8')
+			c = (char)(c - 'a' + 'A');
+		if(PieceLetterType(c) > PT_PAWN && PieceLetterType(c) < PT_KING)
+		{
+			promotion = PieceLetterType(c);
+			end -= end[-2] == '=' ? 2 : 1;
+		}
+	}
+	//the destination is the last file/rank pair, anything before it disambiguates
+	const char *dest = end - 2;
+	if(dest < p || dest[0] < 'a' || dest[0] > 'h' || dest[1] < '1' || dest[1] > '8')
+		return NULL_MOVE;
+	int to = MakeSquare(dest[0] - 'a', dest[1] - '1');
+	int file = -1, rank = -1;
+	bool capture = false;
+	for(; p < dest; p++)
+	{
+		if(*p >= 'a' && *p <= 'h')
+			file = *p - 'a';
+		else if(*p >= '1' && *p <= '8')
+			rank = *p - '1';
+		else if(*p == 'x' || *p == ':')
+			capture = true;
+		else if(*p != '-')
+			return NULL_MOVE;
+	}
+
+	BITBOARD origins;
+	if(type == PT_PAWN && file != -1 && rank != -1)
+	{
+		//a full origin square names whatever stands there ("e2e4", "g1f3")
+		origins = SquareBit(MakeSquare(file, rank)) & pos.GetOccupied(side);
+	}
+	else
+	{
+		if(type == PT_PAWN && file != -1 && file != SquareFile(to))
+			capture = true;
+		origins = GetOrigins(pos, side, type, to, type == PT_PAWN && capture);
+		origins &= FileSquares(file) & RankSquares(rank);
+	}
+	CHESSMOVE found = NULL_MOVE;
+	while(origins)
+	{
+		CHESSMOVE move = pos.FindMove(PopFirstSquare(origins), to, promotion);
+		if(move == NULL_MOVE)
+			continue;
+		if(found != NULL_MOVE)
+			return NULL_MOVE;
+		found = move;
+	}
+	return found;
+}
+
+int FormatSAN(CPosition &pos, CHESSMOVE move, char *buf)
+{
+	int n = 0;
+	int from = GetMoveFrom(move);
+	int to = GetMoveTo(move);
+	int piece = pos.GetPiece(from);
+	int type = PieceType(piece);
+	if(GetMoveFlag(move) == MOVEFLAG_CASTLE)
+	{
+		strcpy(buf, to > from ? "O-O" : "O-O-O");
+		n = to > from ? 3 : 5;
+	}
+	else
+	{
+		bool capture = pos.GetPiece(to) != NO_PIECE || GetMoveFlag(move) == MOVEFLAG_ENPASSANT;
+		if(type == PT_PAWN)
+		{
+			if(capture)
+				buf[n++] = (char)('a' + SquareFile(from));
+		}
+		else
+		{
+			buf[n++] = g_pieceLetters[type];
+			//other pieces of the same kind with a legal move to the square
+			BITBOARD others = GetOrigins(pos, PieceSide(piece), type, to, capture) & ~SquareBit(from);
+			bool samefile = false, samerank = false, ambiguous = false;
+			while(others)
+			{
+				int other = PopFirstSquare(others);
+				if(!pos.IsLegalMove(EncodeMove(other, to)))
+					continue;
+				ambiguous = true;
+				samefile |= SquareFile(other) == SquareFile(from);
+				samerank |= SquareRank(other) == SquareRank(from);
+			}
+			if(ambiguous && (!samefile || samerank))
+				buf[n++] = (char)('a' + SquareFile(from));
+			if(ambiguous && samefile)
+				buf[n++] = (char)('1' + SquareRank(from));
+		}
+		if(capture)
+			buf[n++] = 'x';
+		buf[n++] = (char)('a' + SquareFile(to));
+		buf[n++] = (char)('1' + SquareRank(to));
+		if(IsPromotionMove(move))
+		{
+			buf[n++] = '=';
+			buf[n++] = g_pieceLetters[GetPromotionType(move)];
+		}
+	}
+	UNDOINFO undo;
+	pos.MakeMove(move, undo);
+	if(pos.IsInCheck())
+	{
+		CMoveList replies;
+		buf[n++] = GenerateLegalMoves(pos, replies) ? '+' : '#';
+	}
+	pos.UnmakeMove(move, undo);
+	buf[n] = '\0';
+	return n;
+}
+
+int FormatLongAlgebraic(CHESSMOVE move, char *buf)
+{
+	static const char promotion[] = " nbrq";
+	int from = GetMoveFrom(move);
+	int to = GetMoveTo(move);
+	int n = 0;
+	buf[n++] = (char)('a' + SquareFile(from));
+	buf[n++] = (char)('1' + SquareRank(from));
+	buf[n++] = (char)('a' + SquareFile(to));
+	buf[n++] = (char)('1' + SquareRank(to));
+	if(IsPromotionMove(move))
+		buf[n++] = promotion[GetPromotionType(move)];
+	buf[n] = '\0';
+	return n;
+}
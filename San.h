@@ -0,0 +1,25 @@
+// San.h : standard algebraic notation for CPosition moves
+//
+// Like Position.h this file has no MFC dependency.
+/////////////////////////////////////////////////////////////////////////////
+
+#if !defined(SAN_H)
+#define SAN_H
+
+#include "MoveGen.h"
+
+//longest SAN such as "Qa1xb2+" or "exd8=Q#", plus the nul
+#define MAX_SAN		8
+
+//legal move of the side to move named by san ("Nbd7", "exd8=Q+", "O-O",
+//or long algebraic "e2e4"), NULL_MOVE when there is none
+CHESSMOVE ParseSAN(CPosition &pos, const char *san);
+
+//writes move (legal in pos) as SAN to buf, returns its length
+int FormatSAN(CPosition &pos, CHESSMOVE move, char *buf);
+
+//writes move as long algebraic notation ("e2e4", "e7e8q") to buf, as
+//engines take it, returns its length
+int FormatLongAlgebraic(CHESSMOVE move, char *buf);
+
+#endif
@@ -0,0 +1,94 @@
+// SanBench.cpp : speed of the SAN parser and generator
+//
+// Not part of the NetChess project, build it on its own:
+//   g++ -O2 -o sanbench SanBench.cpp San.cpp Position.cpp MoveGen.cpp Zobrist.cpp
+//   cl /O2 /EHsc SanBench.cpp San.cpp Position.cpp MoveGen.cpp Zobrist.cpp
+//
+// Usage:
+//   sanbench [games] [rounds]
+// Plays random games (default 1000) and stores every position with the
+// move played in it. Each round writes all the moves as SAN with FormatSAN,
+// then reads them back with ParseSAN. Moves that do not come back as
+// themselves are counted as errors.
+/////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "San.h"
+
+//random games stop here, most of them end well before
+#define SANBENCH_MAX_PLIES	300
+
+static unsigned int g_seed = 1;
+
+static unsigned int NextRandom()
+{
+	g_seed = g_seed * 1103515245 + 12345;
+	return (g_seed >> 16) & 0x7fff;
+}
+
+static double ElapsedSeconds(clock_t start)
+{
+	return (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+int main(int argc, char *argv[])
+{
+	int games = argc >= 2 ? atoi(argv[1]) : 1000;
+	int rounds = argc >= 3 ? atoi(argv[2]) : 10;
+	if(games <= 0 || rounds <= 0)
+	{
+		fprintf(stderr, "usage: sanbench [games] [rounds]\n");
+		return 2;
+	}
+	CPosition *positions = new CPosition[(size_t)games * SANBENCH_MAX_PLIES];
+	CHESSMOVE *moves = new CHESSMOVE[(size_t)games * SANBENCH_MAX_PLIES];
+	int count = 0;
+	for(int game = 0; game < games; game++)
+	{
+		CPosition pos;
+		pos.SetStartPosition();
+		for(int ply = 0; ply < SANBENCH_MAX_PLIES; ply++)
+		{
+			CMoveList list;
+			if(GenerateLegalMoves(pos, list) == 0 || pos.IsInsufficientMaterial())
+				break;
+			positions[count] = pos;
+			moves[count] = list[NextRandom() % list.GetSize()];
+			UNDOINFO undo;
+			pos.MakeMove(moves[count++], undo);
+		}
+	}
+	char (*sans)[MAX_SAN] = new char[count][MAX_SAN];
+
+	int errors = 0;
+	double format = 0, parse = 0;
+	for(int round = 0; round < rounds; round++)
+	{
+		clock_t start = clock();
+		for(int i = 0; i < count; i++)
+			FormatSAN(positions[i], moves[i], sans[i]);
+		format += ElapsedSeconds(start);
+
+		start = clock();
+		for(int i = 0; i < count; i++)
+		{
+			if(ParseSAN(positions[i], sans[i]) != moves[i])
+				errors++;
+		}
+		parse += ElapsedSeconds(start);
+	}
+	double total = (double)count * rounds;
+	printf("%d games, %d moves, %d rounds\n", games, count, rounds);
+	printf("FormatSAN: %10.0f moves/s\n", format > 0 ? total / format : 0);
+	printf("ParseSAN:  %10.0f moves/s\n", parse > 0 ? total / parse : 0);
+	if(errors)
+		printf("%d move(s) did not read back\n", errors);
+	delete [] positions;
+	delete [] moves;
+	delete [] sans;
+	return errors ? 1 : 0;
+}
@@ -64,7 +64,8 @@ enum ENGINE_COMMANDS  { CHECKMATE,
 			RESIGN_WHITE, RESIGN_BLACK,
 			TELLOPPONENT_WHITE, TELLOPPONENT_BLACK,
 			TELLOTHERS_WHITE, TELLOTHERS_BLACK,
-			HINT_BLACK, HINT_WHITE
+			HINT_BLACK, HINT_WHITE,
+			ENGINE_EXITED
 
 };
 
@@ -82,15 +83,23 @@ enum CHESS_PROTOCOL {WB_I=1,WB_II,UCI_I,UCI_II,NOPROTOCOL};
 #define CLIENT 1
 #define SERVER 2
 #define OTHER	3
-#define MAXHISTORY 400
 #define ID_MY_MESSAGE_COLORDATA WM_USER + 1
 #define ID_MY_MESSAGE_ENGINE	 WM_USER + 2
+#define ID_MY_MESSAGE_ENGINE_DATA	 WM_USER + 3
+#define ID_MY_MESSAGE_PROGRESS	 WM_USER + 4
+//wParam of ID_MY_MESSAGE_PROGRESS for a line of the message window rather
+//than the message pane
+#define PROGRESS_LOG	-1
 #define SHELL_ICON_TIMER_EVENT_ID	1000
 #define PIECE_SIDE_TIMER_EVENT_ID	1001
 #define DEMO_TIMER_EVENT_ID			1002
 #define SAVE_TIMER_EVENT_ID			1003
 #define ICS_TIMER					1004
 #define DEMO_TIMER_EVENT_ID_ALL		1005
+#define ANALYSIS_TIMER_EVENT_ID		1006
+//milliseconds between redraws of the engines' analysis, however fast
+//they send it
+#define ANALYSIS_REFRESH_INTERVAL	250
 
 #define ROOK_WHITE           'R'
 #define KNIGHT_WHITE         'N'
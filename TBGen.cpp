@@ -0,0 +1,429 @@
+// TBGen.cpp : builds and probes NetChess endgame tablebases
+//
+// Not part of the NetChess project, build it on its own:
+//   g++ -O2 -o tbgen TBGen.cpp Tablebase.cpp MappedFile.cpp Position.cpp MoveGen.cpp San.cpp Zobrist.cpp
+//   cl /O2 /EHsc TBGen.cpp Tablebase.cpp MappedFile.cpp Position.cpp MoveGen.cpp San.cpp Zobrist.cpp
+//
+// Usage:
+//   tbgen [-path dir] name...
+//   tbgen [-path dir] -probe fen
+//   tbgen [-path dir] -bench n name
+// Builds the tables named ("KQvK", "KRvKP"), and the smaller ones a
+// capture or promotion leads to first, in dir (the current directory by
+// default). Tables of four pieces take minutes, five pieces are in reach
+// of the prober but too slow to build here. -probe prints the result, DTZ
+// and best move of a position; -bench probes n random positions of a
+// table and reports the average time of a probe and the cache hits.
+//
+// Positions are solved by going over the unsolved ones until none
+// changes, first for the result and then for the DTZ. An en passant
+// capture after a double push is only seen by the prober, so tables with
+// pawns on both sides can be off in a few positions.
+/////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <string>
+
+#include "Tablebase.h"
+#include "MoveGen.h"
+#include "San.h"
+
+//solving states of a position
+enum TBGEN_STATE {STATE_NONE, STATE_UNKNOWN, STATE_LOSS, STATE_DRAW, STATE_WIN};
+
+#define DTZ_UNKNOWN		255
+
+static unsigned int g_seed = 1;
+
+static unsigned int NextRandom()
+{
+	g_seed = g_seed * 1103515245 + 12345;
+	return (g_seed >> 16) & 0x7fff;
+}
+
+static double Seconds(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static std::string GetTablePath(const std::string &path, const char *name)
+{
+	std::string file = path;
+	if(!file.empty() && file[file.size() - 1] != '/' && file[file.size() - 1] != '\\')
+		file += '/';
+	return file + name + ".nctb";
+}
+
+static bool FileExists(const std::string &path)
+{
+	FILE *fp = fopen(path.c_str(), "rb");
+	if(fp == NULL)
+		return false;
+	fclose(fp);
+	return true;
+}
+
+static int GetMaterialValue(const unsigned char *pieces, int count, int side)
+{
+	static const int values[6] = {1, 3, 3, 5, 9, 0};
+	int value = 0;
+	for(int i = 0; i < count; i++)
+	{
+		if(PieceSide(pieces[i]) == side)
+			value += values[PieceType(pieces[i])];
+	}
+	return value;
+}
+
+//name of a material with the stronger side as white
+static std::string GetCanonicalName(CPosition &pos)
+{
+	char name[TABLEBASE_MAX_PIECES + 8], flipped[TABLEBASE_MAX_PIECES + 8];
+	unsigned char pieces[TABLEBASE_MAX_PIECES];
+	CTablebase::GetName(pos, false, name);
+	CTablebase::GetName(pos, true, flipped);
+	int count = CTablebase::ParseName(name, pieces);
+	int white = GetMaterialValue(pieces, count, SIDE_WHITE);
+	int black = GetMaterialValue(pieces, count, SIDE_BLACK);
+	if(white < black || (white == black && strcmp(name, flipped) < 0))
+		return flipped;
+	return name;
+}
+
+static bool IsZeroing(const CPosition &pos, CHESSMOVE move)
+{
+	return pos.GetPiece(GetMoveTo(move)) != NO_PIECE || GetMoveFlag(move) == MOVEFLAG_ENPASSANT ||
+		PieceType(pos.GetPiece(GetMoveFrom(move))) == PT_PAWN;
+}
+
+//a capture or promotion leaves the table for a smaller one
+static bool LeavesTable(const CPosition &pos, CHESSMOVE move)
+{
+	return pos.GetPiece(GetMoveTo(move)) != NO_PIECE || GetMoveFlag(move) == MOVEFLAG_ENPASSANT ||
+		IsPromotionMove(move);
+}
+
+static bool BuildTable(const std::string &path, const char *name, CTablebase &tablebase);
+
+//Builds the tables the moves of a table lead to when they are missing:
+//a capture of a piece other than a king, a promotion, or both at once.
+static bool BuildSubtables(const std::string &path, const unsigned char *pieces, int count, CTablebase &tablebase)
+{
+	for(int captured = -1; captured < count; captured++)
+	{
+		if(captured >= 0 && PieceType(pieces[captured]) == PT_KING)
+			continue;
+		for(int pawn = -1; pawn < count; pawn++)
+		{
+			if(pawn >= 0 && (PieceType(pieces[pawn]) != PT_PAWN || pawn == captured ||
+				(captured >= 0 && PieceSide(pieces[pawn]) == PieceSide(pieces[captured]))))
+				continue;
+			for(int promotion = PT_KNIGHT; promotion <= PT_QUEEN; promotion++)
+			{
+				if((captured < 0 && pawn < 0) || (pawn < 0 && promotion > PT_KNIGHT))
+					continue;
+				//the squares do not matter for the name
+				CPosition pos;
+				pos.Clear();
+				int sq = 0;
+				for(int k = 0; k < count; k++)
+				{
+					if(k != captured)
+						pos.PutPiece(sq++, k == pawn ? MakePiece(PieceSide(pieces[k]), promotion) : pieces[k]);
+				}
+				if(BitCount(pos.GetOccupied()) == 2)
+					continue;
+				std::string sub = GetCanonicalName(pos);
+				if(!FileExists(GetTablePath(path, sub.c_str())) && !BuildTable(path, sub.c_str(), tablebase))
+					return false;
+			}
+		}
+	}
+	return true;
+}
+
+static bool BuildTable(const std::string &path, const char *name, CTablebase &tablebase)
+{
+	unsigned char pieces[TABLEBASE_MAX_PIECES];
+	int count = CTablebase::ParseName(name, pieces);
+	if(count < 3)
+	{
+		fprintf(stderr, "%s: not a table name\n", name);
+		return false;
+	}
+	if(!BuildSubtables(path, pieces, count, tablebase))
+		return false;
+	//the prober remembers the tables that were missing
+	tablebase.SetPath(path.c_str());
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	unsigned long long positions = CTablebase::GetPositionCount(pieces, count);
+	std::vector<unsigned char> state((size_t)positions, STATE_NONE);
+	std::vector<unsigned char> dtz((size_t)positions, DTZ_UNKNOWN);
+	//a move out of the table to a draw, so the position is not lost
+	std::vector<bool> drawExit((size_t)positions, false);
+	CPosition pos;
+	CMoveList list;
+	unsigned long long legal = 0;
+
+	//mates, stalemates, and wins by a capture or promotion
+	for(unsigned long long i = 0; i < positions; i++)
+	{
+		if(!CTablebase::SetIndex(pos, pieces, count, i))
+			continue;
+		legal++;
+		int moves = GenerateLegalMoves(pos, list);
+		if(moves == 0)
+		{
+			state[i] = pos.IsInCheck() ? STATE_LOSS : STATE_DRAW;
+			if(state[i] == STATE_LOSS)
+				dtz[i] = 0;
+			continue;
+		}
+		state[i] = STATE_UNKNOWN;
+		for(int m = 0; m < moves; m++)
+		{
+			if(!LeavesTable(pos, list[m]))
+				continue;
+			UNDOINFO undo;
+			pos.MakeMove(list[m], undo);
+			int entry = tablebase.Probe(pos);
+			pos.UnmakeMove(list[m], undo);
+			if(entry == TBENTRY_NONE)
+			{
+				fprintf(stderr, "%s: a table it leads to is missing\n", name);
+				return false;
+			}
+			if(entry >= TBENTRY_LOSS)
+			{
+				state[i] = STATE_WIN;
+				dtz[i] = 1;
+				break;
+			}
+			if(entry == TBENTRY_DRAW)
+				drawExit[i] = true;
+		}
+	}
+
+	//results: a win when a move gets to a lost position, a loss when every
+	//move gets to a won one, and a draw for what is left
+	int passes = 0;
+	for(bool changed = true; changed; passes++)
+	{
+		changed = false;
+		for(unsigned long long i = 0; i < positions; i++)
+		{
+			if(state[i] != STATE_UNKNOWN || !CTablebase::SetIndex(pos, pieces, count, i))
+				continue;
+			int moves = GenerateLegalMoves(pos, list);
+			bool allWon = !drawExit[i];
+			for(int m = 0; m < moves; m++)
+			{
+				if(LeavesTable(pos, list[m]))
+					continue;
+				UNDOINFO undo;
+				pos.MakeMove(list[m], undo);
+				int child = state[(size_t)CTablebase::GetIndex(pos, pieces, count, false)];
+				pos.UnmakeMove(list[m], undo);
+				if(child == STATE_LOSS)
+				{
+					state[i] = STATE_WIN;
+					changed = true;
+					break;
+				}
+				if(child != STATE_WIN)
+					allWon = false;
+			}
+			if(state[i] == STATE_UNKNOWN && allWon)
+			{
+				state[i] = STATE_LOSS;
+				changed = true;
+			}
+		}
+	}
+	unsigned long long wins = 0, losses = 0, draws = 0;
+	for(size_t i = 0; i < state.size(); i++)
+	{
+		if(state[i] == STATE_UNKNOWN)
+			state[i] = STATE_DRAW;
+		wins += state[i] == STATE_WIN;
+		losses += state[i] == STATE_LOSS;
+		draws += state[i] == STATE_DRAW;
+	}
+
+	//DTZ level by level: a win is k plies from zeroing when a move that
+	//does not zero gets to a loss k - 1 plies from it, and a loss is as
+	//far as the slowest of its moves once they are all known
+	int level = 1;
+	for(bool unsolved = true; unsolved && level <= TABLEBASE_MAX_DTZ; level++)
+	{
+		unsolved = false;
+		for(int side = 0; side < 2; side++)
+		{
+			for(unsigned long long i = 0; i < positions; i++)
+			{
+				int wanted = side == 0 ? STATE_WIN : STATE_LOSS;
+				if(state[i] != wanted || dtz[i] != DTZ_UNKNOWN || !CTablebase::SetIndex(pos, pieces, count, i))
+					continue;
+				int moves = GenerateLegalMoves(pos, list);
+				int slowest = 0;
+				bool known = true;
+				for(int m = 0; m < moves && dtz[i] == DTZ_UNKNOWN; m++)
+				{
+					bool zero = IsZeroing(pos, list[m]);
+					if(LeavesTable(pos, list[m]) || (zero && wanted == STATE_LOSS))
+					{
+						slowest = slowest > 1 ? slowest : 1;
+						continue;
+					}
+					UNDOINFO undo;
+					pos.MakeMove(list[m], undo);
+					size_t child = (size_t)CTablebase::GetIndex(pos, pieces, count, false);
+					pos.UnmakeMove(list[m], undo);
+					if(wanted == STATE_WIN)
+					{
+						if(state[child] == STATE_LOSS && (zero ? level == 1 : dtz[child] == level - 1))
+							dtz[i] = (unsigned char)level;
+					}
+					else if(dtz[child] == DTZ_UNKNOWN)
+					{
+						known = false;
+						break;
+					}
+					else
+					{
+						int plies = zero ? 1 : dtz[child] + 1;
+						slowest = slowest > plies ? slowest : plies;
+					}
+				}
+				if(wanted == STATE_LOSS && known)
+					dtz[i] = (unsigned char)(slowest < TABLEBASE_MAX_DTZ ? slowest : TABLEBASE_MAX_DTZ);
+				if(dtz[i] == DTZ_UNKNOWN)
+					unsolved = true;
+			}
+		}
+	}
+
+	std::vector<unsigned char> entries((size_t)positions, TBENTRY_NONE);
+	int longest = 0;
+	for(size_t i = 0; i < entries.size(); i++)
+	{
+		int plies = dtz[i] == DTZ_UNKNOWN ? TABLEBASE_MAX_DTZ : dtz[i];
+		if(state[i] == STATE_WIN)
+			entries[i] = (unsigned char)(TBENTRY_WIN + (plies > 0 ? plies : 1) - 1);
+		else if(state[i] == STATE_LOSS)
+			entries[i] = (unsigned char)(TBENTRY_LOSS + plies);
+		else if(state[i] == STATE_DRAW)
+			entries[i] = TBENTRY_DRAW;
+		if(state[i] == STATE_WIN && plies > longest)
+			longest = plies;
+	}
+	std::string file = GetTablePath(path, name);
+	if(!CTablebase::Write(file.c_str(), pieces, count, entries))
+	{
+		fprintf(stderr, "%s: cannot write the table\n", file.c_str());
+		return false;
+	}
+	printf("%s: %llu positions, %llu wins, %llu draws, %llu losses, longest DTZ %d, %d passes, %.1f s\n",
+		name, legal, wins, draws, losses, longest, passes, Seconds(start));
+	return true;
+}
+
+static const char *GetResultName(int wdl)
+{
+	return wdl == TBWDL_WIN ? "win" : wdl == TBWDL_LOSS ? "loss" : "draw";
+}
+
+int main(int argc, char *argv[])
+{
+	std::string path = ".";
+	const char *fen = NULL;
+	int bench = 0;
+	int arg = 1;
+	for(; arg + 1 < argc && argv[arg][0] == '-'; arg += 2)
+	{
+		if(strcmp(argv[arg], "-path") == 0)
+			path = argv[arg + 1];
+		else if(strcmp(argv[arg], "-probe") == 0)
+			fen = argv[arg + 1];
+		else if(strcmp(argv[arg], "-bench") == 0)
+			bench = atoi(argv[arg + 1]);
+		else
+			break;
+	}
+	if((fen == NULL && arg >= argc) || (fen != NULL && arg < argc) || (bench > 0 && argc - arg != 1) || bench < 0)
+	{
+		fprintf(stderr, "usage: tbgen [-path dir] name...\n");
+		fprintf(stderr, "       tbgen [-path dir] -probe fen\n");
+		fprintf(stderr, "       tbgen [-path dir] -bench n name\n");
+		return 2;
+	}
+	CTablebase tablebase;
+	tablebase.SetPath(path.c_str());
+
+	if(fen != NULL)
+	{
+		CPosition pos;
+		if(!pos.SetFEN(fen))
+		{
+			fprintf(stderr, "bad FEN: %s\n", fen);
+			return 2;
+		}
+		int wdl, dtz;
+		if(!tablebase.ProbeDTZ(pos, wdl, dtz))
+		{
+			fprintf(stderr, "the position is not in the tables\n");
+			return 1;
+		}
+		printf("%s, DTZ %d\n", GetResultName(wdl), dtz);
+		CHESSMOVE move = tablebase.GetBestMove(pos, wdl, dtz);
+		if(move != NULL_MOVE)
+		{
+			char san[MAX_SAN];
+			FormatSAN(pos, move, san);
+			printf("best move %s\n", san);
+		}
+		return 0;
+	}
+
+	if(bench > 0)
+	{
+		unsigned char pieces[TABLEBASE_MAX_PIECES];
+		int count = CTablebase::ParseName(argv[arg], pieces);
+		if(count == 0)
+		{
+			fprintf(stderr, "%s: not a table name\n", argv[arg]);
+			return 2;
+		}
+		unsigned long long positions = CTablebase::GetPositionCount(pieces, count);
+		std::vector<CPosition> sample;
+		while((int)sample.size() < bench)
+		{
+			CPosition pos;
+			unsigned long long index = ((unsigned long long)NextRandom() << 30 |
+				(unsigned long long)NextRandom() << 15 | NextRandom()) % positions;
+			if(CTablebase::SetIndex(pos, pieces, count, index))
+				sample.push_back(pos);
+		}
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		int missing = 0;
+		for(size_t i = 0; i < sample.size(); i++)
+			missing += tablebase.Probe(sample[i]) == TBENTRY_NONE;
+		double elapsed = Seconds(start);
+		printf("%d probes, %.3f us per probe, %llu cache hits, %llu misses\n", bench, elapsed * 1e6 / bench,
+			tablebase.GetCacheHits(), tablebase.GetCacheMisses());
+		if(missing)
+			printf("%d position(s) were not found\n", missing);
+		return missing ? 1 : 0;
+	}
+
+	for(; arg < argc; arg++)
+	{
+		if(!BuildTable(path, argv[arg], tablebase))
+			return 1;
+	}
+	return 0;
+}
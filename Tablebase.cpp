@@ -0,0 +1,496 @@
+// Tablebase.cpp : endgame tablebase probing
+//
+
+#include <stdio.h>
+#include <string.h>
+
+#include "Tablebase.h"
+#include "MoveGen.h"
+
+static const char g_tablebaseMagic[4] = {'N', 'C', 'T', 'B'};
+#define TABLEBASE_VERSION		1
+
+static const char g_tablebaseLetters[] = "PNBRQK";
+
+//index of a square of the a1-d1-d4 triangle, -1 off it
+static const int g_triangle[64] =
+{
+	 0,  1,  2,  3, -1, -1, -1, -1,
+	-1,  4,  5,  6, -1, -1, -1, -1,
+	-1, -1,  7,  8, -1, -1, -1, -1,
+	-1, -1, -1,  9, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1
+};
+
+static const int g_triangleSquares[10] = {0, 1, 2, 3, 9, 10, 11, 18, 19, 27};
+
+static bool HasPawns(const unsigned char *pieces, int count)
+{
+	for(int i = 0; i < count; i++)
+	{
+		if(PieceType(pieces[i]) == PT_PAWN)
+			return true;
+	}
+	return false;
+}
+
+static int GetKingSquares(const unsigned char *pieces, int count)
+{
+	return HasPawns(pieces, count) ? 32 : 10;
+}
+
+static int FlipDiagonal(int sq)
+{
+	return (sq >> 3) | ((sq & 7) << 3);
+}
+
+//Orders entries from the best for the side to move to the worst: the
+//fastest win first and the slowest loss before a quick one.
+static int GetEntryScore(int entry)
+{
+	if(entry >= TBENTRY_LOSS)
+		return -1000 + (entry - TBENTRY_LOSS);
+	if(entry >= TBENTRY_WIN)
+		return 1000 - (entry - TBENTRY_WIN);
+	return 0;
+}
+
+CTablebase::CTablebase()
+{
+	m_cacheBlocks = TABLEBASE_CACHE_BLOCKS;
+	m_hits = m_misses = 0;
+}
+
+CTablebase::~CTablebase()
+{
+	Close();
+}
+
+void CTablebase::SetPath(const char *path)
+{
+	Close();
+	std::lock_guard<std::mutex> lock(m_lock);
+	m_path = path;
+}
+
+void CTablebase::Close()
+{
+	std::lock_guard<std::mutex> lock(m_lock);
+	for(std::map<std::string, TABLEBASEFILE*>::iterator it = m_tables.begin(); it != m_tables.end(); ++it)
+		delete it->second;
+	m_tables.clear();
+	m_cache.clear();
+	m_cached.clear();
+	m_path.clear();
+	m_hits = m_misses = 0;
+}
+
+void CTablebase::SetCacheSize(size_t blocks)
+{
+	std::lock_guard<std::mutex> lock(m_lock);
+	m_cacheBlocks = blocks > 0 ? blocks : 1;
+	while(m_cache.size() > m_cacheBlocks)
+	{
+		m_cached.erase(m_cache.back().key);
+		m_cache.pop_back();
+	}
+}
+
+//Opens the table with name the first time it is asked for. A missing or
+//bad file is remembered as NULL so it is not looked for again.
+TABLEBASEFILE *CTablebase::GetTable(const char *name)
+{
+	std::map<std::string, TABLEBASEFILE*>::iterator it = m_tables.find(name);
+	if(it != m_tables.end())
+		return it->second;
+	TABLEBASEFILE *table = new TABLEBASEFILE;
+	table->id = (unsigned int)m_tables.size();
+	std::string path = m_path;
+	if(!path.empty() && path[path.size() - 1] != '/' && path[path.size() - 1] != '\\')
+		path += '/';
+	path += name;
+	path += ".nctb";
+	const TABLEBASEHEADER *header = NULL;
+	if(table->file.Open(path.c_str()))
+		header = (const TABLEBASEHEADER *)table->file.Map(0, sizeof(TABLEBASEHEADER));
+	if(header == NULL || table->file.GetSize() < sizeof(TABLEBASEHEADER) ||
+		memcmp(header->magic, g_tablebaseMagic, sizeof(header->magic)) != 0 ||
+		header->version != TABLEBASE_VERSION || header->count > TABLEBASE_MAX_PIECES ||
+		header->blockSize == 0 || header->positions != GetPositionCount(header->pieces, header->count) ||
+		header->blocks != (header->positions + header->blockSize - 1) / header->blockSize)
+	{
+		delete table;
+		m_tables[name] = NULL;
+		return NULL;
+	}
+	table->header = *header;
+	const unsigned long long *offsets = (const unsigned long long *)table->file.Map(sizeof(TABLEBASEHEADER),
+		(size_t)(table->header.blocks + 1) * sizeof(unsigned long long));
+	if(offsets == NULL || offsets[table->header.blocks] != table->file.GetSize())
+	{
+		delete table;
+		m_tables[name] = NULL;
+		return NULL;
+	}
+	table->offsets.assign(offsets, offsets + table->header.blocks + 1);
+	m_tables[name] = table;
+	return table;
+}
+
+//Blocks are run-length coded as (run - 1, entry) byte pairs. A block read
+//goes to the front of the cache and the least recently used one drops
+//out of the back.
+int CTablebase::ReadEntry(TABLEBASEFILE *table, unsigned long long index)
+{
+	if(index >= table->header.positions)
+		return TBENTRY_NONE;
+	unsigned long long block = index / table->header.blockSize;
+	unsigned long long key = (unsigned long long)table->id << 40 | block;
+	std::map<unsigned long long, std::list<TABLEBASEBLOCK>::iterator>::iterator it = m_cached.find(key);
+	if(it != m_cached.end())
+	{
+		m_hits++;
+		m_cache.splice(m_cache.begin(), m_cache, it->second);
+		return m_cache.front().entries[(size_t)(index % table->header.blockSize)];
+	}
+	m_misses++;
+	unsigned long long first = block * table->header.blockSize;
+	size_t count = (size_t)(table->header.positions - first < table->header.blockSize ?
+		table->header.positions - first : table->header.blockSize);
+	size_t length = (size_t)(table->offsets[block + 1] - table->offsets[block]);
+	const unsigned char *data = (const unsigned char *)table->file.Map(table->offsets[block], length);
+	if(data == NULL)
+		return TBENTRY_NONE;
+	TABLEBASEBLOCK decoded;
+	decoded.key = key;
+	decoded.entries.reserve(count);
+	for(size_t i = 0; i + 1 < length; i += 2)
+		decoded.entries.insert(decoded.entries.end(), (size_t)data[i] + 1, data[i + 1]);
+	if(decoded.entries.size() != count)
+		return TBENTRY_NONE;
+	m_cache.push_front(decoded);
+	m_cached[key] = m_cache.begin();
+	while(m_cache.size() > m_cacheBlocks)
+	{
+		m_cached.erase(m_cache.back().key);
+		m_cache.pop_back();
+	}
+	return m_cache.front().entries[(size_t)(index - first)];
+}
+
+int CTablebase::GetParentEntry(int entry, bool zeroing)
+{
+	if(entry == TBENTRY_NONE || entry == TBENTRY_DRAW)
+		return entry;
+	int dtz;
+	if(entry >= TBENTRY_LOSS)
+	{
+		dtz = zeroing ? 1 : entry - TBENTRY_LOSS + 1;
+		return TBENTRY_WIN + (dtz < TABLEBASE_MAX_DTZ ? dtz : TABLEBASE_MAX_DTZ) - 1;
+	}
+	dtz = zeroing ? 1 : entry - TBENTRY_WIN + 2;
+	return TBENTRY_LOSS + (dtz < TABLEBASE_MAX_DTZ ? dtz : TABLEBASE_MAX_DTZ);
+}
+
+//Looks pos up in the table of its material, or of the material with the
+//colours swapped. When an en passant capture is possible the position is
+//not in the table, and its moves are looked up instead.
+int CTablebase::ProbeEntry(CPosition &pos)
+{
+	int count = BitCount(pos.GetOccupied());
+	if(count > TABLEBASE_MAX_PIECES || pos.GetCastling() != 0)
+		return TBENTRY_NONE;
+	CMoveList list;
+	int moves = 0;
+	bool enpassant = false;
+	if(pos.GetEpSquare() != NO_SQUARE)
+	{
+		moves = GenerateLegalMoves(pos, list);
+		for(int i = 0; i < moves; i++)
+			enpassant |= GetMoveFlag(list[i]) == MOVEFLAG_ENPASSANT;
+	}
+	if(enpassant)
+	{
+		int best = TBENTRY_NONE;
+		for(int i = 0; i < moves; i++)
+		{
+			CHESSMOVE move = list[i];
+			bool zeroing = pos.GetPiece(GetMoveTo(move)) != NO_PIECE ||
+				PieceType(pos.GetPiece(GetMoveFrom(move))) == PT_PAWN;
+			UNDOINFO undo;
+			pos.MakeMove(move, undo);
+			int entry = GetParentEntry(ProbeEntry(pos), zeroing);
+			pos.UnmakeMove(move, undo);
+			if(entry == TBENTRY_NONE)
+				return TBENTRY_NONE;
+			if(best == TBENTRY_NONE || GetEntryScore(entry) > GetEntryScore(best))
+				best = entry;
+		}
+		return best;
+	}
+	if(count == 2)
+		return TBENTRY_DRAW;
+	char name[TABLEBASE_MAX_PIECES + 2];
+	bool flip = false;
+	GetName(pos, false, name);
+	TABLEBASEFILE *table = GetTable(name);
+	if(table == NULL)
+	{
+		flip = true;
+		GetName(pos, true, name);
+		table = GetTable(name);
+	}
+	if(table == NULL)
+		return TBENTRY_NONE;
+	return ReadEntry(table, GetIndex(pos, table->header.pieces, table->header.count, flip));
+}
+
+int CTablebase::Probe(CPosition &pos)
+{
+	std::lock_guard<std::mutex> lock(m_lock);
+	if(m_path.empty())
+		return TBENTRY_NONE;
+	return ProbeEntry(pos);
+}
+
+bool CTablebase::ProbeWDL(CPosition &pos, int &wdl)
+{
+	int dtz;
+	return ProbeDTZ(pos, wdl, dtz);
+}
+
+bool CTablebase::ProbeDTZ(CPosition &pos, int &wdl, int &dtz)
+{
+	int entry = Probe(pos);
+	if(entry == TBENTRY_NONE)
+		return false;
+	if(entry >= TBENTRY_LOSS)
+	{
+		wdl = TBWDL_LOSS;
+		dtz = entry - TBENTRY_LOSS;
+	}
+	else if(entry >= TBENTRY_WIN)
+	{
+		wdl = TBWDL_WIN;
+		dtz = entry - TBENTRY_WIN + 1;
+	}
+	else
+	{
+		wdl = TBWDL_DRAW;
+		dtz = 0;
+	}
+	return true;
+}
+
+CHESSMOVE CTablebase::GetBestMove(CPosition &pos, int &wdl, int &dtz)
+{
+	CMoveList list;
+	int moves = GenerateLegalMoves(pos, list);
+	CHESSMOVE best = NULL_MOVE;
+	int bestEntry = TBENTRY_NONE;
+	{
+		std::lock_guard<std::mutex> lock(m_lock);
+		if(m_path.empty())
+			return NULL_MOVE;
+		for(int i = 0; i < moves; i++)
+		{
+			CHESSMOVE move = list[i];
+			bool zeroing = pos.GetPiece(GetMoveTo(move)) != NO_PIECE ||
+				PieceType(pos.GetPiece(GetMoveFrom(move))) == PT_PAWN;
+			UNDOINFO undo;
+			pos.MakeMove(move, undo);
+			int entry = GetParentEntry(ProbeEntry(pos), zeroing);
+			pos.UnmakeMove(move, undo);
+			if(entry == TBENTRY_NONE)
+				return NULL_MOVE;
+			if(best == NULL_MOVE || GetEntryScore(entry) > GetEntryScore(bestEntry))
+			{
+				best = move;
+				bestEntry = entry;
+			}
+		}
+	}
+	if(best == NULL_MOVE)
+		return NULL_MOVE;
+	if(bestEntry >= TBENTRY_LOSS)
+	{
+		wdl = TBWDL_LOSS;
+		dtz = bestEntry - TBENTRY_LOSS;
+	}
+	else if(bestEntry >= TBENTRY_WIN)
+	{
+		wdl = TBWDL_WIN;
+		dtz = bestEntry - TBENTRY_WIN + 1;
+	}
+	else
+	{
+		wdl = TBWDL_DRAW;
+		dtz = 0;
+	}
+	return best;
+}
+
+int CTablebase::GetName(const CPosition &pos, bool flip, char *buf)
+{
+	int n = 0;
+	for(int i = 0; i < 2; i++)
+	{
+		int side = flip ? SIDE_BLACK - i : SIDE_WHITE + i;
+		if(i == 1)
+			buf[n++] = 'v';
+		for(int type = PT_KING; type >= PT_PAWN; type--)
+		{
+			int pieces = BitCount(pos.GetPieces(side, type));
+			for(int k = 0; k < pieces; k++)
+				buf[n++] = g_tablebaseLetters[type];
+		}
+	}
+	buf[n] = '\0';
+	return BitCount(pos.GetOccupied());
+}
+
+int CTablebase::ParseName(const char *name, unsigned char *pieces)
+{
+	int count = 0, side = SIDE_WHITE;
+	bool king = false;
+	for(const char *p = name; *p != '\0'; p++)
+	{
+		if(*p == 'v' && side == SIDE_WHITE && king)
+		{
+			side = SIDE_BLACK;
+			king = false;
+			continue;
+		}
+		const char *letter = strchr(g_tablebaseLetters, *p);
+		if(letter == NULL || count == TABLEBASE_MAX_PIECES)
+			return 0;
+		int type = (int)(letter - g_tablebaseLetters);
+		//the king comes first and once
+		if((type == PT_KING) == king)
+			return 0;
+		king = true;
+		pieces[count++] = (unsigned char)MakePiece(side, type);
+	}
+	return side == SIDE_BLACK && king ? count : 0;
+}
+
+unsigned long long CTablebase::GetPositionCount(const unsigned char *pieces, int count)
+{
+	if(count < 2)
+		return 0;
+	unsigned long long positions = 2 * GetKingSquares(pieces, count);
+	for(int i = 1; i < count; i++)
+		positions *= 64;
+	return positions;
+}
+
+unsigned long long CTablebase::GetIndex(const CPosition &pos, const unsigned char *pieces, int count, bool flip)
+{
+	int squares[TABLEBASE_MAX_PIECES];
+	BITBOARD taken = 0;
+	if(count < 2)
+		return ~0ULL;
+	for(int i = 0; i < count; i++)
+	{
+		int piece = flip ? MakePiece(SIDE_BLACK - PieceSide(pieces[i]), PieceType(pieces[i])) : pieces[i];
+		BITBOARD bb = pos.GetPieces(piece) & ~taken;
+		if(bb == 0)
+			return ~0ULL;
+		int sq = FirstSquare(bb);
+		taken |= SquareBit(sq);
+		squares[i] = flip ? sq ^ 56 : sq;
+	}
+	bool pawns = HasPawns(pieces, count);
+	int mirror = SquareFile(squares[0]) > 3 ? 7 : 0;
+	if(!pawns && SquareRank(squares[0]) > 3)
+		mirror |= 56;
+	for(int i = 0; i < count; i++)
+		squares[i] ^= mirror;
+	if(!pawns && SquareRank(squares[0]) > SquareFile(squares[0]))
+	{
+		for(int i = 0; i < count; i++)
+			squares[i] = FlipDiagonal(squares[i]);
+	}
+	unsigned long long index = pawns ? SquareRank(squares[0]) * 4 + SquareFile(squares[0]) : g_triangle[squares[0]];
+	for(int i = 1; i < count; i++)
+		index = index * 64 + squares[i];
+	int side = flip ? SIDE_BLACK - pos.GetSide() : pos.GetSide();
+	return index * 2 + side;
+}
+
+bool CTablebase::SetIndex(CPosition &pos, const unsigned char *pieces, int count, unsigned long long index)
+{
+	int squares[TABLEBASE_MAX_PIECES];
+	int side = (int)(index & 1);
+	index >>= 1;
+	for(int i = count - 1; i > 0; i--)
+	{
+		squares[i] = (int)(index & 63);
+		index >>= 6;
+	}
+	if(HasPawns(pieces, count))
+		squares[0] = index < 32 ? MakeSquare((int)index & 3, (int)index >> 2) : NO_SQUARE;
+	else
+		squares[0] = index < 10 ? g_triangleSquares[index] : NO_SQUARE;
+	if(squares[0] == NO_SQUARE)
+		return false;
+	pos.Clear();
+	for(int i = 0; i < count; i++)
+	{
+		if(pos.GetPiece(squares[i]) != NO_PIECE)
+			return false;
+		if(PieceType(pieces[i]) == PT_PAWN && (SquareRank(squares[i]) == 0 || SquareRank(squares[i]) == 7))
+			return false;
+		pos.PutPiece(squares[i], pieces[i]);
+	}
+	pos.SetSide(side);
+	return !pos.IsInCheck(SIDE_BLACK - side);
+}
+
+bool CTablebase::Write(const char *path, const unsigned char *pieces, int count,
+	const std::vector<unsigned char> &entries)
+{
+	TABLEBASEHEADER header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, g_tablebaseMagic, sizeof(header.magic));
+	header.version = TABLEBASE_VERSION;
+	memcpy(header.pieces, pieces, count);
+	header.count = (unsigned char)count;
+	header.blockSize = TABLEBASE_BLOCK;
+	header.positions = GetPositionCount(pieces, count);
+	if(entries.size() != header.positions)
+		return false;
+	header.blocks = (header.positions + TABLEBASE_BLOCK - 1) / TABLEBASE_BLOCK;
+	std::vector<unsigned long long> offsets;
+	std::vector<unsigned char> data;
+	unsigned long long start = sizeof(header) + (header.blocks + 1) * sizeof(unsigned long long);
+	for(size_t first = 0; first < entries.size(); first += TABLEBASE_BLOCK)
+	{
+		offsets.push_back(start + data.size());
+		size_t end = first + TABLEBASE_BLOCK < entries.size() ? first + TABLEBASE_BLOCK : entries.size();
+		for(size_t i = first; i < end; )
+		{
+			size_t run = 1;
+			while(i + run < end && run < 256 && entries[i + run] == entries[i])
+				run++;
+			data.push_back((unsigned char)(run - 1));
+			data.push_back(entries[i]);
+			i += run;
+		}
+	}
+	offsets.push_back(start + data.size());
+	FILE *fp = fopen(path, "wb");
+	if(fp == NULL)
+		return false;
+	bool ok = fwrite(&header, sizeof(header), 1, fp) == 1 &&
+		fwrite(&offsets[0], sizeof(unsigned long long), offsets.size(), fp) == offsets.size() &&
+		fwrite(&data[0], 1, data.size(), fp) == data.size();
+	if(fclose(fp) != 0)
+		ok = false;
+	if(!ok)
+		remove(path);
+	return ok;
+}
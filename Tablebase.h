@@ -0,0 +1,134 @@
+// Tablebase.h : endgame tablebase probing
+//
+// Like Position.h this file has no MFC dependency. As with Syzygy tables
+// there is one file per material, named by it ("KQvKR.nctb"), that holds
+// for every position the result for the side to move and the distance to
+// the next capture or pawn move (DTZ) with best play. Files are read in
+// compressed blocks, and the blocks last used are kept decompressed.
+// TBGen.cpp builds the tables.
+/////////////////////////////////////////////////////////////////////////////
+
+#if !defined(TABLEBASE_H)
+#define TABLEBASE_H
+
+#include <list>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "MappedFile.h"
+#include "Position.h"
+
+#define TABLEBASE_MAX_PIECES	5
+//positions per compressed block, and blocks kept decompressed
+#define TABLEBASE_BLOCK			32768
+#define TABLEBASE_CACHE_BLOCKS	64
+
+//result for the side to move
+enum TABLEBASE_WDL {TBWDL_LOSS, TBWDL_DRAW, TBWDL_WIN};
+
+//One byte per position: TBENTRY_NONE where no legal position has the
+//index, TBENTRY_DRAW, TBENTRY_WIN + dtz - 1 for a win in dtz plies and
+//TBENTRY_LOSS + dtz for a loss, mated being a loss in 0. The 50 move rule
+//is not taken into account.
+#define TBENTRY_NONE		0
+#define TBENTRY_DRAW		1
+#define TBENTRY_WIN			2
+#define TBENTRY_LOSS		129
+#define TABLEBASE_MAX_DTZ	126
+
+struct TABLEBASEHEADER
+{
+	char magic[4];
+	unsigned int version;
+	//CPosition pieces in the order of the name: white's king, white's
+	//other pieces, black's king, black's other pieces
+	unsigned char pieces[TABLEBASE_MAX_PIECES + 1];
+	unsigned char count;
+	unsigned char reserved;
+	unsigned int blockSize;
+	unsigned long long positions;
+	//the offsets of blocks + 1 blocks follow the header
+	unsigned long long blocks;
+};
+
+//an opened table file
+struct TABLEBASEFILE
+{
+	CMappedFile file;
+	TABLEBASEHEADER header;
+	std::vector<unsigned long long> offsets;
+	unsigned int id;
+};
+
+//a decompressed block in the cache
+struct TABLEBASEBLOCK
+{
+	unsigned long long key;
+	std::vector<unsigned char> entries;
+};
+
+class CTablebase
+{
+private:
+	std::string m_path;
+	//tables by name, NULL for a material without a file
+	std::map<std::string, TABLEBASEFILE*> m_tables;
+	//most recently used first
+	std::list<TABLEBASEBLOCK> m_cache;
+	std::map<unsigned long long, std::list<TABLEBASEBLOCK>::iterator> m_cached;
+	size_t m_cacheBlocks;
+	unsigned long long m_hits;
+	unsigned long long m_misses;
+	std::mutex m_lock;
+
+	TABLEBASEFILE *GetTable(const char *name);
+	int ReadEntry(TABLEBASEFILE *table, unsigned long long index);
+	int ProbeEntry(CPosition &pos);
+
+public:
+	CTablebase();
+	~CTablebase();
+
+	//directory of the table files, the tables are opened as they are needed
+	void SetPath(const char *path);
+	const char *GetPath() const					{ return m_path.c_str(); }
+	bool IsOpen() const							{ return !m_path.empty(); }
+	void Close();
+	void SetCacheSize(size_t blocks);
+	unsigned long long GetCacheHits() const		{ return m_hits; }
+	unsigned long long GetCacheMisses() const	{ return m_misses; }
+
+	//Returns the entry of pos, TBENTRY_NONE when there is no table for it.
+	//Positions with castling rights are not in the tables; an en passant
+	//capture is looked at one move deeper.
+	int Probe(CPosition &pos);
+	bool ProbeWDL(CPosition &pos, int &wdl);
+	bool ProbeDTZ(CPosition &pos, int &wdl, int &dtz);
+	//Move keeping the result of pos, the fastest way to a capture or pawn
+	//move when winning and the slowest when losing. NULL_MOVE when pos is
+	//not in the tables or has no moves.
+	CHESSMOVE GetBestMove(CPosition &pos, int &wdl, int &dtz);
+
+	//writes the name of the material of pos ("KQvKR") to buf, which holds
+	//the number of pieces + 2 characters, with the colours swapped when
+	//flip is set, returns the number of pieces
+	static int GetName(const CPosition &pos, bool flip, char *buf);
+	//pieces of a name, returns their number, 0 for a bad name
+	static int ParseName(const char *name, unsigned char *pieces);
+	static unsigned long long GetPositionCount(const unsigned char *pieces, int count);
+	//Index of pos in the table of pieces, with the colours swapped when
+	//flip is set. Mirroring puts white's king on the a-d files, and for
+	//tables without pawns on the a1-d1-d4 triangle.
+	static unsigned long long GetIndex(const CPosition &pos, const unsigned char *pieces, int count, bool flip);
+	//Sets pos to the position with index, returns false when it is not a
+	//legal position.
+	static bool SetIndex(CPosition &pos, const unsigned char *pieces, int count, unsigned long long index);
+	static bool Write(const char *path, const unsigned char *pieces, int count,
+		const std::vector<unsigned char> &entries);
+	//entry of the position before move, given the entry after it
+	static int GetParentEntry(int entry, bool zeroing);
+};
+
+#endif
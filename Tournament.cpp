@@ -0,0 +1,429 @@
+// Tournament.cpp : engine against engine games played without the board
+//
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <algorithm>
+#include <thread>
+
+#include "Tournament.h"
+#include "MoveGen.h"
+#include "PGNReader.h"
+#include "San.h"
+
+//PGN movetext lines are kept shorter than this
+#define PGN_LINE_LENGTH		80
+
+CTournament::CTournament()
+{
+	memset(&m_timeControl, 0, sizeof(m_timeControl));
+	m_margin = 0;
+	m_maxMoves = 0;
+	m_event = "NetChess tournament";
+	m_gameProc = NULL;
+	m_gameParam = NULL;
+	m_next = 0;
+	m_stopped = false;
+	m_played = 0;
+}
+
+void CTournament::AddEngine(const TOURNAMENTENGINE &engine)
+{
+	m_engines.push_back(engine);
+	TOURNAMENTENGINE &added = m_engines.back();
+	added.games = added.wins = added.draws = added.losses = 0;
+}
+
+void CTournament::SetGameProc(TOURNAMENTGAMEPROC proc, void *param)
+{
+	m_gameProc = proc;
+	m_gameParam = param;
+}
+
+//a position where both sides have one king
+static bool HasKings(const CPosition &pos)
+{
+	return BitCount(pos.GetPieces(WHITE_KING)) == 1 && BitCount(pos.GetPieces(BLACK_KING)) == 1;
+}
+
+bool CTournament::LoadOpenings(const char *path, int plies)
+{
+	m_openings.clear();
+	size_t length = strlen(path);
+	if(length > 4 && (strcmp(path + length - 4, ".pgn") == 0 || strcmp(path + length - 4, ".PGN") == 0))
+	{
+		CPGNReader reader;
+		if(!reader.Open(path))
+			return false;
+		while(reader.NextGame())
+		{
+			TOURNAMENTOPENING opening;
+			opening.start.SetStartPosition();
+			CPosition pos = opening.start;
+			UNDOINFO undo;
+			bool bad = false;
+			int depth = 0;
+			PGNTOKEN token;
+			int type;
+			while(!bad && (type = reader.NextToken(token)) != PGN_END)
+			{
+				if(type == PGN_TAG && token.value != NULL && token.length == 3 && strncmp(token.text, "FEN", 3) == 0)
+				{
+					std::string value(token.value, token.valueLength);
+					bad = !opening.start.SetFEN(value.c_str()) || !HasKings(opening.start);
+					pos = opening.start;
+				}
+				else if(type == PGN_VARIATION_START)
+					depth++;
+				else if(type == PGN_VARIATION_END && depth > 0)
+					depth--;
+				else if(type == PGN_SAN && depth == 0 && (plies == 0 || (int)opening.moves.size() < plies))
+				{
+					char san[16];
+					int n = token.length < (int)sizeof(san) - 1 ? token.length : (int)sizeof(san) - 1;
+					memcpy(san, token.text, n);
+					san[n] = '\0';
+					CHESSMOVE move = ParseSAN(pos, san);
+					if(move == NULL_MOVE)
+						bad = true;
+					else
+					{
+						pos.MakeMove(move, undo);
+						opening.moves.push_back(move);
+					}
+				}
+			}
+			if(!bad)
+				m_openings.push_back(opening);
+		}
+		return !m_openings.empty();
+	}
+
+	FILE *fp = fopen(path, "r");
+	if(fp == NULL)
+		return false;
+	char line[1024];
+	while(fgets(line, sizeof(line), fp) != NULL)
+	{
+		if(line[0] == '#' || line[0] == '\r' || line[0] == '\n' || line[0] == '\0')
+			continue;
+		TOURNAMENTOPENING opening;
+		if(opening.start.SetFEN(line) && HasKings(opening.start))
+			m_openings.push_back(opening);
+	}
+	fclose(fp);
+	return !m_openings.empty();
+}
+
+void CTournament::Schedule(int type, int rounds, int games)
+{
+	m_games.clear();
+	int pairs = (games + 1) / 2;
+	int opening = 0;
+	int count = (int)m_engines.size();
+	for(int round = 1; round <= rounds; round++)
+	{
+		for(int first = 0; first < count; first++)
+		{
+			for(int second = first + 1; second < count; second++)
+			{
+				if(type == SCHEDULE_GAUNTLET && first > 0)
+					break;
+				for(int pair = 0; pair < pairs; pair++, opening++)
+				{
+					for(int reversed = 0; reversed < 2; reversed++)
+					{
+						TOURNAMENTGAME game;
+						game.number = (int)m_games.size() + 1;
+						game.round = round;
+						game.white = reversed ? second : first;
+						game.black = reversed ? first : second;
+						game.opening = m_openings.empty() ? -1 : opening % (int)m_openings.size();
+						game.result = RESULT_UNKNOWN;
+						game.openingPlies = 0;
+						m_games.push_back(game);
+					}
+				}
+			}
+		}
+	}
+}
+
+void CTournament::Run(int threads)
+{
+	m_next = 0;
+	m_stopped = false;
+	m_played = 0;
+	std::vector<std::thread> workers;
+	for(int i = 0; i < threads; i++)
+		workers.push_back(std::thread(&CTournament::Work, this));
+	for(size_t i = 0; i < workers.size(); i++)
+		workers[i].join();
+}
+
+void CTournament::Work()
+{
+	for(;;)
+	{
+		int next = m_next++;
+		if(next >= (int)m_games.size() || m_stopped)
+			break;
+		TOURNAMENTGAME &game = m_games[next];
+		PlayGame(game);
+
+		std::lock_guard<std::mutex> lock(m_lock);
+		TOURNAMENTENGINE &white = m_engines[game.white];
+		TOURNAMENTENGINE &black = m_engines[game.black];
+		white.games++;
+		black.games++;
+		if(game.result == RESULT_WHITE_WINS)
+		{
+			white.wins++;
+			black.losses++;
+		}
+		else if(game.result == RESULT_BLACK_WINS)
+		{
+			white.losses++;
+			black.wins++;
+		}
+		else
+		{
+			white.draws++;
+			black.draws++;
+		}
+		m_played++;
+		if(m_gameProc != NULL)
+			m_gameProc(game, m_gameParam);
+	}
+}
+
+const char *CTournament::GetResultString(int result)
+{
+	switch(result)
+	{
+	case RESULT_WHITE_WINS:
+		return "1-0";
+	case RESULT_BLACK_WINS:
+		return "0-1";
+	case RESULT_DRAW:
+		return "1/2-1/2";
+	default:
+		return "*";
+	}
+}
+
+int CTournament::GetGameEnd(CPosition &pos, const std::vector<BITBOARD> &keys, std::string &reason)
+{
+	CMoveList list;
+	if(GenerateLegalMoves(pos, list) == 0)
+	{
+		if(!pos.IsInCheck())
+		{
+			reason = "Draw by stalemate";
+			return RESULT_DRAW;
+		}
+		reason = pos.GetSide() == SIDE_WHITE ? "Black mates" : "White mates";
+		return pos.GetSide() == SIDE_WHITE ? RESULT_BLACK_WINS : RESULT_WHITE_WINS;
+	}
+	if(pos.IsInsufficientMaterial())
+	{
+		reason = "Draw by insufficient mating material";
+		return RESULT_DRAW;
+	}
+	if(pos.GetHalfMoveClock() >= 100)
+	{
+		reason = "Draw by fifty moves rule";
+		return RESULT_DRAW;
+	}
+	//the same position twice before, with the same side to move, since the
+	//last capture or pawn move
+	int repeated = 0;
+	int last = (int)keys.size() - 1;
+	for(int i = last - 2; i >= 0 && i >= last - pos.GetHalfMoveClock(); i -= 2)
+	{
+		if(keys[i] == keys[last] && ++repeated == 2)
+		{
+			reason = "Draw by 3-fold repetition";
+			return RESULT_DRAW;
+		}
+	}
+	return RESULT_UNKNOWN;
+}
+
+void CTournament::PlayGame(TOURNAMENTGAME &game)
+{
+	CEnginePlayer players[2];
+	const TOURNAMENTENGINE *engines[2] = {&m_engines[game.white], &m_engines[game.black]};
+	game.moves.clear();
+	game.result = RESULT_UNKNOWN;
+	for(int side = SIDE_WHITE; side <= SIDE_BLACK && game.result == RESULT_UNKNOWN; side++)
+	{
+		if(!players[side].Start(*engines[side]))
+		{
+			game.result = side == SIDE_WHITE ? RESULT_BLACK_WINS : RESULT_WHITE_WINS;
+			game.reason = engines[side]->name + " could not be started";
+		}
+	}
+
+	CPosition start;
+	start.SetStartPosition();
+	if(game.opening >= 0)
+	{
+		start = m_openings[game.opening].start;
+		game.moves = m_openings[game.opening].moves;
+	}
+	game.openingPlies = (int)game.moves.size();
+	CPosition pos = start;
+	UNDOINFO undo;
+	std::vector<BITBOARD> keys;
+	keys.push_back(pos.GetKey());
+	for(size_t i = 0; i < game.moves.size(); i++)
+	{
+		pos.MakeMove(game.moves[i], undo);
+		keys.push_back(pos.GetKey());
+	}
+
+	const TIMECONTROL &tc = m_timeControl;
+	ENGINELIMITS limits;
+	memset(&limits, 0, sizeof(limits));
+	limits.moveTime = tc.moveTime;
+	limits.depth = tc.depth;
+	limits.nodes = tc.nodes;
+	int clocks[2] = {tc.base, tc.base};
+	int moves[2] = {0, 0};
+	ENGINESEARCH search;
+	while(game.result == RESULT_UNKNOWN)
+	{
+		game.result = GetGameEnd(pos, keys, game.reason);
+		if(game.result != RESULT_UNKNOWN)
+			break;
+		if(m_maxMoves > 0 && (int)game.moves.size() - game.openingPlies >= 2 * m_maxMoves)
+		{
+			game.result = RESULT_DRAW;
+			game.reason = "Draw by adjudication";
+			break;
+		}
+		int side = pos.GetSide();
+		int timeout = -1;
+		if(tc.base > 0)
+		{
+			limits.time[SIDE_WHITE] = clocks[SIDE_WHITE];
+			limits.time[SIDE_BLACK] = clocks[SIDE_BLACK];
+			limits.increment[SIDE_WHITE] = limits.increment[SIDE_BLACK] = tc.increment;
+			limits.movesToGo = tc.moves > 0 ? tc.moves - moves[side] % tc.moves : 0;
+			timeout = clocks[side] + m_margin;
+		}
+		else if(tc.moveTime > 0)
+			timeout = tc.moveTime + m_margin + ENGINE_STOP_TIMEOUT;
+		players[side].Go(start, game.moves, limits, timeout, search);
+		if(search.reply == ENGINEREPLY_MOVE && tc.base > 0 && search.elapsed > clocks[side] + m_margin)
+			search.reply = ENGINEREPLY_TIMEOUT;
+		if(search.reply != ENGINEREPLY_MOVE)
+		{
+			const std::string &name = engines[side]->name;
+			game.result = side == SIDE_WHITE ? RESULT_BLACK_WINS : RESULT_WHITE_WINS;
+			switch(search.reply)
+			{
+			case ENGINEREPLY_RESIGN:
+				game.reason = name + " resigns";
+				break;
+			case ENGINEREPLY_TIMEOUT:
+				game.reason = name + " loses on time";
+				break;
+			case ENGINEREPLY_EXITED:
+				game.reason = name + " disconnects";
+				break;
+			default:
+				game.reason = name + " makes an illegal move: " + search.text;
+				break;
+			}
+			break;
+		}
+		if(tc.base > 0)
+		{
+			clocks[side] += tc.increment - search.elapsed;
+			if(tc.moves > 0 && ++moves[side] % tc.moves == 0)
+				clocks[side] += tc.base;
+		}
+		pos.MakeMove(search.move, undo);
+		game.moves.push_back(search.move);
+		keys.push_back(pos.GetKey());
+	}
+
+	const char *result = GetResultString(game.result);
+	for(int side = SIDE_WHITE; side <= SIDE_BLACK; side++)
+	{
+		players[side].SetResult(result, game.reason.c_str());
+		players[side].Stop();
+	}
+}
+
+std::string CTournament::FormatPGN(const TOURNAMENTGAME &game) const
+{
+	char buf[256];
+	std::string pgn;
+	time_t now = time(NULL);
+	struct tm *date = localtime(&now);
+	sprintf(buf, "[Event \"%s\"]\n[Site \"?\"]\n[Date \"%04d.%02d.%02d\"]\n[Round \"%d\"]\n",
+		m_event.c_str(), date->tm_year + 1900, date->tm_mon + 1, date->tm_mday, game.round);
+	pgn += buf;
+	pgn += "[White \"" + m_engines[game.white].name + "\"]\n";
+	pgn += "[Black \"" + m_engines[game.black].name + "\"]\n";
+	pgn += std::string("[Result \"") + GetResultString(game.result) + "\"]\n";
+
+	CPosition pos;
+	pos.SetStartPosition();
+	if(game.opening >= 0)
+		pos = m_openings[game.opening].start;
+	CPosition start;
+	start.SetStartPosition();
+	if(pos.GetKey() != start.GetKey())
+	{
+		char fen[100];
+		pos.GetFEN(fen, sizeof(fen));
+		pgn += std::string("[FEN \"") + fen + "\"]\n[SetUp \"1\"]\n";
+	}
+	const TIMECONTROL &tc = m_timeControl;
+	if(tc.base > 0)
+	{
+		int n = tc.moves > 0 ? sprintf(buf, "%d/", tc.moves) : 0;
+		n += sprintf(buf + n, "%g", tc.base / 1000.0);
+		if(tc.increment > 0)
+			sprintf(buf + n, "+%g", tc.increment / 1000.0);
+		pgn += std::string("[TimeControl \"") + buf + "\"]\n";
+	}
+	sprintf(buf, "[PlyCount \"%d\"]\n\n", (int)game.moves.size());
+	pgn += buf;
+
+	std::string line;
+	UNDOINFO undo;
+	for(size_t i = 0; i < game.moves.size(); i++)
+	{
+		int n = 0;
+		if(pos.GetSide() == SIDE_WHITE || i == 0)
+			n = sprintf(buf, pos.GetSide() == SIDE_WHITE ? "%d. " : "%d... ", pos.GetFullMoveNumber());
+		n += FormatSAN(pos, game.moves[i], buf + n);
+		if((int)i + 1 == game.openingPlies)
+			n += sprintf(buf + n, " {book}");
+		pos.MakeMove(game.moves[i], undo);
+		if(!line.empty() && line.size() + 1 + n >= PGN_LINE_LENGTH)
+		{
+			pgn += line + "\n";
+			line.clear();
+		}
+		if(!line.empty())
+			line += ' ';
+		line += buf;
+	}
+	std::string end = "{" + game.reason + "} " + GetResultString(game.result);
+	if(!line.empty() && line.size() + 1 + end.size() >= PGN_LINE_LENGTH)
+	{
+		pgn += line + "\n";
+		line.clear();
+	}
+	if(!line.empty())
+		line += ' ';
+	pgn += line + end + "\n\n";
+	return pgn;
+}
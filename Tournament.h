@@ -0,0 +1,128 @@
+// Tournament.h : engine against engine games played without the board
+//
+// Like Position.h this file has no MFC dependency. The games of a round
+// robin or gauntlet are handed out to worker threads, each of which plays
+// one game at a time between two engines it starts for that game, keeps
+// the clocks and ends the game by the rules. Results come back through a
+// procedure called on one thread at a time.
+/////////////////////////////////////////////////////////////////////////////
+
+#if !defined(TOURNAMENT_H)
+#define TOURNAMENT_H
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "EnginePlayer.h"
+#include "GameIndex.h"
+
+enum TOURNAMENT_SCHEDULE {SCHEDULE_ROUNDROBIN, SCHEDULE_GAUNTLET};
+
+//an engine taking part and its score so far
+struct TOURNAMENTENGINE : public ENGINECONFIG
+{
+	int games;
+	int wins;
+	int draws;
+	int losses;
+};
+
+struct TOURNAMENTOPENING
+{
+	CPosition start;
+	std::vector<CHESSMOVE> moves;
+};
+
+//In milliseconds, and 0 when not used: base time for moves moves (for
+//the whole game when moves is 0) and the increment, or a fixed time,
+//depth or node count per move.
+struct TIMECONTROL
+{
+	int moves;
+	int base;
+	int increment;
+	int moveTime;
+	int depth;
+	unsigned long long nodes;
+};
+
+struct TOURNAMENTGAME
+{
+	//from 1, in the order of the schedule
+	int number;
+	int round;
+	int white;
+	int black;
+	int opening;
+	//a GAMEINDEX_RESULT once the game is played; moves start with the
+	//opening's
+	int result;
+	std::string reason;
+	std::vector<CHESSMOVE> moves;
+	int openingPlies;
+};
+
+typedef void (*TOURNAMENTGAMEPROC)(const TOURNAMENTGAME &game, void *param);
+
+class CTournament
+{
+private:
+	std::vector<TOURNAMENTENGINE> m_engines;
+	std::vector<TOURNAMENTOPENING> m_openings;
+	std::vector<TOURNAMENTGAME> m_games;
+	TIMECONTROL m_timeControl;
+	//milliseconds over its clock an engine may take before it loses on time
+	int m_margin;
+	//full moves after which a game is drawn, 0 for no limit
+	int m_maxMoves;
+	std::string m_event;
+	TOURNAMENTGAMEPROC m_gameProc;
+	void *m_gameParam;
+	std::atomic<int> m_next;
+	std::atomic<bool> m_stopped;
+	std::mutex m_lock;
+	int m_played;
+
+	void Work();
+	void PlayGame(TOURNAMENTGAME &game);
+
+public:
+	CTournament();
+
+	void AddEngine(const TOURNAMENTENGINE &engine);
+	//Reads start positions from an EPD or FEN file, or the first plies
+	//(all when 0) of the main line of every game of a PGN file. Games are
+	//played from them in turn, each by both colours.
+	bool LoadOpenings(const char *path, int plies);
+	void SetTimeControl(const TIMECONTROL &timeControl)	{ m_timeControl = timeControl; }
+	void SetTimeMargin(int margin)						{ m_margin = margin; }
+	void SetMaxMoves(int moves)							{ m_maxMoves = moves; }
+	void SetEvent(const char *event)					{ m_event = event; }
+	void SetGameProc(TOURNAMENTGAMEPROC proc, void *param);
+
+	//Every engine meets every other, or the first meets all the others,
+	//games times (rounded up to even) in every round: in pairs of games
+	//with the same opening and the colours reversed.
+	void Schedule(int type, int rounds, int games);
+	//Plays the games on threads threads, returns once they are over.
+	void Run(int threads);
+	//no more games are started, those being played are finished
+	void Stop()											{ m_stopped = true; }
+
+	int GetEngineCount() const							{ return (int)m_engines.size(); }
+	const TOURNAMENTENGINE &GetEngine(int i) const		{ return m_engines[i]; }
+	int GetGameCount() const							{ return (int)m_games.size(); }
+	int GetOpeningCount() const							{ return (int)m_openings.size(); }
+	int GetPlayed() const								{ return m_played; }
+
+	//the game in PGN, its moves in SAN
+	std::string FormatPGN(const TOURNAMENTGAME &game) const;
+	static const char *GetResultString(int result);
+	//Result of the game in pos, reached through the positions with keys,
+	//RESULT_UNKNOWN while it goes on.
+	static int GetGameEnd(CPosition &pos, const std::vector<BITBOARD> &keys, std::string &reason);
+};
+
+#endif
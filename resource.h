@@ -404,6 +404,12 @@
 #define ID_TOOLS_MAILTO                 32933
 #define ID_TOOLS_MAILFROM               32934
 #define ID_REPLAY_REPLAYALL             32937
+#define ID_FILE_CHECKPGNFILE            32938
+#define ID_FILE_FINDPOSITION            32939
+#define ID_FILE_OPENINGTREE             32940
+#define ID_FILE_OPENINGBOOK             32941
+#define ID_FILE_TABLEBASES              32942
+#define ID_EDIT_ANNOTATEGAME            32943
 
 // Next default values for new objects
 // 
@@ -411,7 +417,7 @@
 #ifndef APSTUDIO_READONLY_SYMBOLS
 #define _APS_3D_CONTROLS                     1
 #define _APS_NEXT_RESOURCE_VALUE        219
-#define _APS_NEXT_COMMAND_VALUE         32938
+#define _APS_NEXT_COMMAND_VALUE         32944
 #define _APS_NEXT_CONTROL_VALUE         1271
 #define _APS_NEXT_SYMED_VALUE           101
 #endif